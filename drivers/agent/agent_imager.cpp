@@ -19,11 +19,18 @@
 
 #include "agent_imager.h"
 #include "indistandardproperty.h"
+#include "sharedblob.h"
 
 #include <cstring>
 #include <algorithm>
+#include <fstream>
 #include <memory>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include "group.h"
 
 #define DOWNLOAD_TAB "Download images"
@@ -46,6 +53,15 @@ Imager::Imager()
     groups.resize(MAX_GROUP_COUNT);
     int i = 0;
     std::generate(groups.begin(), groups.end(), [this, &i] { return std::make_shared<Group>(i++, this); });
+    imageWriter = std::thread(&Imager::imageWriterThread, this);
+}
+
+Imager::~Imager()
+{
+    waitForImageWrites();
+    imageWriterTerminate = true;
+    imageWrites.abort();
+    imageWriter.join();
 }
 
 bool Imager::isRunning()
@@ -178,34 +194,44 @@ void Imager::initiateDownload()
     int group = (int)DownloadNP[GROUP].getValue();
     int image = (int)DownloadNP[IMAGE].getValue();
     char name[128] = {0};
-    std::ifstream file;
 
     if (group == 0 || image == 0)
         return;
 
+    // The image may still be queued for writing
+    waitForImageWrites();
+
     sprintf(name, IMAGE_NAME, ImageNameTP[IMAGE_FOLDER].getText(), ImageNameTP[IMAGE_NAME_PREFIX].getText(), group, image, format);
-    file.open(name, std::ios::in | std::ios::binary | std::ios::ate);
+    int fd = open(name, O_RDONLY);
     DownloadNP[GROUP].setValue(0);
     DownloadNP[IMAGE].setValue(0);
-    if (file.is_open())
+
+    // Serve the file straight from the page cache instead of reading it into the heap
+    struct stat st {};
+    void *data = MAP_FAILED;
+    if (fd >= 0 && fstat(fd, &st) == 0 && st.st_size > 0)
+        data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (fd >= 0)
+        close(fd);
+
+    if (data != MAP_FAILED)
     {
-        long size  = file.tellg();
-        char *data = new char[size];
+        size_t size = st.st_size;
 
-        file.seekg(0, std::ios::beg);
-        file.read(data, size);
-        file.close();
-        remove(name);
         LOGF_DEBUG("Group %d, image %d, download initiated", group, image);
         DownloadNP.setState(IPS_BUSY);
         LOG_INFO("Download initiated");
         DownloadNP.apply();
-//        strncpy(FitsBP[0].format, format, MAXINDIBLOBFMT);
         FitsBP[0].setFormat(format);
         FitsBP[0].setBlob(data);
-        FitsBP[0].setBlobLen(FitsBP[0].getSize() == size);
+        FitsBP[0].setBlobLen(size);
+        FitsBP[0].setSize(size);
         FitsBP.setState(IPS_OK);
         FitsBP.apply();
+        FitsBP[0].setBlob(nullptr);
+        FitsBP[0].setBlobLen(0);
+        munmap(data, size);
+        remove(name);
         DownloadNP.setState(IPS_OK);
         LOG_INFO("Download finished");
         DownloadNP.apply();
@@ -219,6 +245,47 @@ void Imager::initiateDownload()
     }
 }
 
+void Imager::queueImageWrite(std::string name, void *data, size_t size)
+{
+    {
+        std::lock_guard<std::mutex> lock(imageWritesLock);
+        pendingImageWrites++;
+    }
+    imageWrites.push({std::move(name), data, size});
+}
+
+void Imager::waitForImageWrites()
+{
+    std::unique_lock<std::mutex> lock(imageWritesLock);
+    imageWritesDone.wait(lock, [this] { return pendingImageWrites == 0; });
+}
+
+void Imager::imageWriterThread()
+{
+    ImageWrite write;
+    while (!imageWriterTerminate)
+    {
+        if (imageWrites.pop(write, 100) == false)
+            continue;
+
+        std::ofstream file(write.name, std::ios::out | std::ios::binary | std::ios::trunc);
+        file.write(static_cast<char *>(write.data), write.size);
+        file.close();
+        if (file.fail())
+            LOGF_ERROR("Failed to save %s", write.name.c_str());
+        else
+            LOGF_DEBUG("Saved %s", write.name.c_str());
+
+        // Works for both shared buffers and ones the client allocated itself
+        IDSharedBlobFree(write.data);
+        write = ImageWrite();
+
+        std::lock_guard<std::mutex> lock(imageWritesLock);
+        pendingImageWrites--;
+        imageWritesDone.notify_all();
+    }
+}
+
 // DefaultDevice ----------------------------------------------------------------------------
 
 const char *Imager::getDefaultName()
@@ -448,6 +515,8 @@ bool Imager::Connect()
     setServer("localhost", 7624); // TODO configuration options
     BaseClient::watchDevice(controlledCCD);
     BaseClient::watchDevice(controlledFilterWheel);
+    // Frames from a local server arrive in shared buffers that can be written out without copying
+    enableDirectBlobAccess(controlledCCD, nullptr);
     connectServer();
     setBLOBMode(B_ALSO, controlledCCD, nullptr);
 
@@ -531,14 +600,17 @@ void Imager::updateProperty(INDI::Property property)
             if (ProgressNP.getState() == IPS_BUSY)
             {
                 char name[128] = {0};
-                std::ofstream file;
 
                 strncpy(format, bp.getFormat(), 16);
                 sprintf(name, IMAGE_NAME, ImageNameTP[IMAGE_FOLDER].getText(), ImageNameTP[IMAGE_NAME_PREFIX].getText(), group, image, format);
-                file.open(name, std::ios::out | std::ios::binary | std::ios::trunc);
-                file.write(static_cast<char *>(bp.getBlob()), bp.getBlobLen());
-                file.close();
-                LOGF_DEBUG("Group %d of %d, image %d of %d, saved to %s", group, maxGroup, image, maxImage,
+
+                // Take the frame buffer away from the property, the writer releases it once it is on disk
+                void *data = bp.getBlob();
+                size_t size = bp.getBlobLen();
+                bp.setBlob(nullptr);
+                bp.setBlobLen(0);
+                queueImageWrite(name, data, size);
+                LOGF_DEBUG("Group %d of %d, image %d of %d, queued for %s", group, maxGroup, image, maxImage,
                            name);
                 if (image == maxImage)
                 {
@@ -21,6 +21,14 @@
 
 #include "baseclient.h"
 #include "defaultdevice.h"
+#include "stream/uniquequeue.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
 #define MAX_GROUP_COUNT 16
 
 class Group;
@@ -29,7 +37,7 @@ class Imager : public virtual INDI::DefaultDevice, public virtual INDI::BaseClie
 public:
     static const std::string DEVICE_NAME;
     Imager();
-    virtual ~Imager() = default;
+    virtual ~Imager();
 
     // DefaultDevice
 
@@ -70,6 +78,24 @@ private:
     void batchDone();
     void initiateDownload();
 
+    // Images are written to disk by a background thread so the client thread can start the next capture
+    struct ImageWrite
+    {
+        std::string name;
+        void *data { nullptr };
+        size_t size { 0 };
+    };
+    void queueImageWrite(std::string name, void *data, size_t size);
+    void waitForImageWrites();
+    void imageWriterThread();
+
+    std::thread imageWriter;
+    std::atomic_bool imageWriterTerminate { false };
+    UniqueQueue<ImageWrite> imageWrites;
+    std::mutex imageWritesLock;
+    std::condition_variable imageWritesDone;
+    int pendingImageWrites { 0 };
+
     char format[16];
     int group { 0 };
     int maxGroup { 0 };
@@ -47,7 +47,7 @@ CCDSim::CCDSim() : INDI::FilterInterface(this)
 
     terminateThread = false;
 
-    time(&RunStart);
+    RunStart.start();
 
     // Filter stuff
     FilterSlotN[0].min = 1;
@@ -344,7 +344,7 @@ bool CCDSim::StartExposure(float duration)
     ExposureRequest   = duration;
 
     PrimaryCCD.setExposureDuration(duration);
-    gettimeofday(&ExpStart, nullptr);
+    ExpStart.start();
     //  Leave the proper time showing for the draw routines
     if (PrimaryCCD.getFrameType() == INDI::CCDChip::LIGHT_FRAME && DirectorySP[INDI_ENABLED].getState() == ISS_ON)
     {
@@ -366,7 +366,7 @@ bool CCDSim::StartGuideExposure(float n)
     AbortGuideFrame      = false;
     GuideCCD.setExposureDuration(n);
     DrawCcdFrame(&GuideCCD);
-    gettimeofday(&GuideExpStart, nullptr);
+    GuideExpStart.start();
     InGuideExposure = true;
     return true;
 }
@@ -390,21 +390,9 @@ bool CCDSim::AbortGuideExposure()
     return true;
 }
 
-float CCDSim::CalcTimeLeft(timeval start, float req)
+float CCDSim::CalcTimeLeft(const INDI::ElapsedTimer &start, float req)
 {
-    double timesince;
-    double timeleft;
-    struct timeval now
-    {
-        0, 0
-    };
-    gettimeofday(&now, nullptr);
-
-    timesince =
-        (double)(now.tv_sec * 1000.0 + now.tv_usec / 1000) - (double)(start.tv_sec * 1000.0 + start.tv_usec / 1000);
-    timesince = timesince / 1000;
-    timeleft  = req - timesince;
-    return timeleft;
+    return req - start.nsecsElapsed() / 1e9;
 }
 
 void CCDSim::TimerHit()
@@ -561,12 +549,8 @@ int CCDSim::DrawCcdFrame(INDI::CCDChip * targetChip)
 
         if (m_PEPeriod > 0)
         {
-            double timesince;
-            time_t now;
-            time(&now);
-
             //  Lets figure out where we are on the pe curve
-            timesince = difftime(now, RunStart);
+            double timesince = RunStart.elapsed() / 1000.0;
             //  This is our spot in the curve
             double PESpot = timesince / m_PEPeriod;
             //  Now convert to radians
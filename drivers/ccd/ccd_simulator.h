@@ -124,7 +124,7 @@ protected:
 
 protected:
 
-    float CalcTimeLeft(timeval, float);
+    float CalcTimeLeft(const INDI::ElapsedTimer &start, float req);
     bool watchDirectory();
     bool loadNextImage();
     bool setupParameters();
@@ -137,16 +137,10 @@ protected:
     double TemperatureRequest { 0 };
 
     float ExposureRequest { 0 };
-    struct timeval ExpStart
-    {
-        0, 0
-    };
+    INDI::ElapsedTimer ExpStart;
 
     float GuideExposureRequest { 0 };
-    struct timeval GuideExpStart
-    {
-        0, 0
-    };
+    INDI::ElapsedTimer GuideExpStart;
 
     int testvalue { 0 };
     bool ShowStarField { true };
@@ -186,7 +180,7 @@ protected:
     double currentRA { 0 };
     double currentDE { 0 };
     bool usePE { false };
-    time_t RunStart;
+    INDI::ElapsedTimer RunStart;
 
     float guideNSOffset {0};
     float guideWEOffset {0};
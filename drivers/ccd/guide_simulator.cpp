@@ -42,7 +42,7 @@ GuideSim::GuideSim()
     streamPredicate = 0;
     terminateThread = false;
 
-    time(&RunStart);
+    RunStart.start();
 }
 
 bool GuideSim::SetupParms()
@@ -278,7 +278,7 @@ bool GuideSim::StartExposure(float duration)
     ExposureRequest   = duration;
 
     PrimaryCCD.setExposureDuration(duration);
-    gettimeofday(&ExpStart, nullptr);
+    ExpStart.start();
     //  Leave the proper time showing for the draw routines
     DrawCcdFrame(&PrimaryCCD);
     //  Now compress the actual wait time
@@ -298,21 +298,9 @@ bool GuideSim::AbortExposure()
     return true;
 }
 
-float GuideSim::CalcTimeLeft(timeval start, float req)
+float GuideSim::CalcTimeLeft(const INDI::ElapsedTimer &start, float req)
 {
-    double timesince;
-    double timeleft;
-    struct timeval now
-    {
-        0, 0
-    };
-    gettimeofday(&now, nullptr);
-
-    timesince =
-        (double)(now.tv_sec * 1000.0 + now.tv_usec / 1000) - (double)(start.tv_sec * 1000.0 + start.tv_usec / 1000);
-    timesince = timesince / 1000;
-    timeleft  = req - timesince;
-    return timeleft;
+    return req - start.nsecsElapsed() / 1e9;
 }
 
 void GuideSim::TimerHit()
@@ -409,12 +397,8 @@ int GuideSim::DrawCcdFrame(INDI::CCDChip * targetChip)
         double decr; //  telescope dec in radians;
         int nwidth = 0, nheight = 0;
 
-        double timesince;
-        time_t now;
-        time(&now);
-
         //  Lets figure out where we are on the pe curve
-        timesince = difftime(now, RunStart);
+        double timesince = RunStart.elapsed() / 1000.0;
         //  This is our spot in the curve
         PESpot = timesince / PEPeriod;
         //  Now convert to radians
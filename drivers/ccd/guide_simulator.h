@@ -93,7 +93,7 @@ protected:
 
 private:
 
-    float CalcTimeLeft(timeval, float);
+    float CalcTimeLeft(const INDI::ElapsedTimer &start, float req);
     bool SetupParms();
 
     // Turns on/off Bayer RGB simulation.
@@ -102,10 +102,7 @@ private:
     double TemperatureRequest { 0 };
 
     float ExposureRequest { 0 };
-    struct timeval ExpStart
-    {
-        0, 0
-    };
+    INDI::ElapsedTimer ExpStart;
 
 
     int testvalue { 0 };
@@ -144,7 +141,7 @@ private:
     double currentRA { 0 };
     double currentDE { 0 };
     bool usePE { false };
-    time_t RunStart;
+    INDI::ElapsedTimer RunStart;
 
     float guideNSOffset {0};
     float guideWEOffset {0};
@@ -44,54 +44,57 @@
 #define MAX_FRAME_SIZE (SUBFRAME_SIZE * 16)
 #define SPECTRUM_SIZE  (256)
 
-static pthread_cond_t cv         = PTHREAD_COND_INITIALIZER;
-static pthread_mutex_t condMutex = PTHREAD_MUTEX_INITIALIZER;
-
 void RTLSDR::Callback()
 {
     LOG_INFO("Integration started...");
-    b_read = 0;
-    n_read = 0;
-    setBufferSize(getSampleRate() * IntegrationRequest * getBPS() / 8);
-    setBufferSize(getBufferSize() + MAX_FRAME_SIZE - (getBufferSize() % MAX_FRAME_SIZE));
-    to_read = getBufferSize();
-    buffer = (unsigned char *)realloc(buffer, min(MAX_FRAME_SIZE, getBufferSize()));
+    int frameSize = getSampleRate() * IntegrationRequest * getBPS() / 8;
+    frameSize += MAX_FRAME_SIZE - (frameSize % MAX_FRAME_SIZE);
+    // Samples go straight into the acquisition ring, the sensor buffer is not used
+    setBufferSize(frameSize, false);
+    setAcquisitionRing(frameSize, streamPredicate ? 4 : 2);
     if((getSensorConnection() & CONNECTION_TCP) == 0)
         rtlsdr_reset_buffer(rtl_dev);
     else
         tcflush(PortFD, TCIFLUSH);
     setIntegrationTime(IntegrationRequest);
-    InIntegration = true;
-    continuum = getBuffer();
     gettimeofday(&IntStart, nullptr);
     while (InIntegration)
     {
-        if (to_read > 0)
+        // Only waits if the uploads or the clients fall behind
+        uint8_t *continuum = acquireFrame(100);
+        if (continuum == nullptr)
+            continue;
+
+        int b_read = 0;
+        while (InIntegration && b_read < frameSize)
         {
+            int n_read = 0;
             if((getSensorConnection() & CONNECTION_TCP) == 0)
-                rtlsdr_read_sync(rtl_dev, continuum + b_read, min(MAX_FRAME_SIZE, to_read), &n_read);
-            else
-                n_read = read(PortFD, continuum + b_read, min(MAX_FRAME_SIZE, to_read));
-
-            if (n_read > 0) {
-                b_read += n_read;
-                to_read -= n_read;
-            }
-        } else {
-            if(!streamPredicate)
             {
-                InIntegration = false;
-                IntegrationComplete();
+                if (rtlsdr_read_sync(rtl_dev, continuum + b_read, min(MAX_FRAME_SIZE, frameSize - b_read), &n_read) < 0)
+                    n_read = -1;
             }
             else
+                n_read = read(PortFD, continuum + b_read, min(MAX_FRAME_SIZE, frameSize - b_read));
+
+            if (n_read <= 0)
             {
-                Streamer->newFrame(getBuffer(), getBufferSize());
-                to_read = getBufferSize();
-                b_read = 0;
-                n_read = 0;
+                LOG_ERROR("Failed to read samples from the receiver.");
+                InIntegration = false;
+                break;
             }
-            LOG_INFO("Download complete.");
+            b_read += n_read;
         }
+
+        // Aborted, the partial frame is reused by the next integration
+        if (b_read < frameSize)
+            break;
+
+        bool streaming = streamPredicate;
+        commitFrame(frameSize, streaming);
+        if (!streaming)
+            InIntegration = false;
+        LOG_INFO("Download complete.");
     }
 }
 
@@ -121,7 +124,6 @@ static class Loader
 
 RTLSDR::RTLSDR(int32_t index)
 {
-    InIntegration = false;
     if(index < 0)
     {
         setSensorConnection(CONNECTION_TCP);
@@ -136,7 +138,12 @@ RTLSDR::RTLSDR(int32_t index)
     // We set the Receiver capabilities
     uint32_t cap = SENSOR_CAN_ABORT | SENSOR_HAS_STREAMING | SENSOR_HAS_DSP;
     SetReceiverCapability(cap);
-    buffer = (unsigned char*)malloc(1);
+}
+
+RTLSDR::~RTLSDR()
+{
+    AbortIntegration();
+    stopAcquisition();
 }
 
 bool RTLSDR::Connect()
@@ -158,7 +165,9 @@ bool RTLSDR::Connect()
 ***************************************************************************************/
 bool RTLSDR::Disconnect()
 {
-    InIntegration = false;
+    streamPredicate = false;
+    // Stop reading before the device goes away
+    AbortIntegration();
     if((getSensorConnection() & CONNECTION_TCP) == 0)
     {
         rtlsdr_close(rtl_dev);
@@ -166,11 +175,6 @@ bool RTLSDR::Disconnect()
     PortFD = -1;
 
     setBufferSize(1);
-    pthread_mutex_lock(&condMutex);
-    streamPredicate = 1;
-    terminateThread = true;
-    pthread_cond_signal(&cv);
-    pthread_mutex_unlock(&condMutex);
     LOG_INFO("RTL-SDR Receiver disconnected successfully!");
     return true;
 }
@@ -330,11 +334,11 @@ bool RTLSDR::ISNewNumber(const char *dev, const char *name, double values[], cha
 ***************************************************************************************/
 bool RTLSDR::StartIntegration(double duration)
 {
-    IntegrationRequest = static_cast<float>(duration);
     AbortIntegration();
+    IntegrationRequest = static_cast<float>(duration);
+    InIntegration = true;
 
-    // Run threads
-    std::thread(&RTLSDR::Callback, this).detach();
+    readThread = std::thread(&RTLSDR::Callback, this);
     return true;
 }
 
@@ -343,10 +347,9 @@ bool RTLSDR::StartIntegration(double duration)
 ***************************************************************************************/
 bool RTLSDR::AbortIntegration()
 {
-    if (InIntegration)
-    {
-        InIntegration = false;
-    }
+    InIntegration = false;
+    if (readThread.joinable())
+        readThread.join();
     return true;
 }
 
@@ -407,22 +410,15 @@ void RTLSDR::grabData()
 
 bool RTLSDR::StartStreaming()
 {
-    pthread_mutex_lock(&condMutex);
-    streamPredicate = 1;
-    StartIntegration(1.0 / Streamer->getTargetFPS());
-    pthread_mutex_unlock(&condMutex);
-    pthread_cond_signal(&cv);
-
-    return true;
+    streamPredicate = true;
+    return StartIntegration(1.0 / Streamer->getTargetFPS());
 }
 
 bool RTLSDR::StopStreaming()
 {
-    pthread_mutex_lock(&condMutex);
-    streamPredicate = 0;
-    pthread_mutex_unlock(&condMutex);
-    pthread_cond_signal(&cv);
-
+    // May be called by the streamer from the acquisition worker, the read thread is joined later
+    streamPredicate = false;
+    InIntegration = false;
     return true;
 }
 
@@ -437,8 +433,7 @@ bool RTLSDR::Handshake()
         }
     }
 
-    streamPredicate = 0;
-    terminateThread = false;
+    streamPredicate = false;
     LOG_INFO("RTL-SDR Receiver connected successfully!");
     // Let's set a timer that checks teleReceivers status every POLLMS milliseconds.
     // JM 2017-07-31 SetTimer already called in updateProperties(). Just call it once
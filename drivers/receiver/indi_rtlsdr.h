@@ -27,6 +27,9 @@
 #include "indireceiver.h"
 #include "stream/streammanager.h"
 
+#include <atomic>
+#include <thread>
+
 enum Settings
 {
     FREQUENCY_N = 0,
@@ -38,14 +41,12 @@ class RTLSDR : public INDI::Receiver
 {
     public:
         RTLSDR(int32_t index);
+        ~RTLSDR();
 
         void grabData();
         rtlsdr_dev *rtl_dev = { nullptr };
-        int to_read;
         // Are we integrating?
-        bool InIntegration;
-        uint8_t *buffer;
-        int b_read, n_read;
+        std::atomic<bool> InIntegration { false };
         bool ISNewNumber(const char *dev, const char *name, double values[], char *names[], int n) override;
 
     protected:
@@ -77,13 +78,11 @@ class RTLSDR : public INDI::Receiver
         // Struct to keep timing
         struct timeval IntStart;
         float IntegrationRequest;
-        uint8_t *continuum;
 
         int32_t receiverIndex = { 0 };
 
-        int streamPredicate;
-        pthread_t primary_thread;
-        bool terminateThread;
+        std::atomic<bool> streamPredicate { false };
+        std::thread readThread;
 
         bool sendTcpCommand(int cmd, int value);
         enum TcpCommands
@@ -22,6 +22,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <indilogger.h>
+#include <chrono>
 #include <memory>
 
 #define SPECTRUM_SIZE (256)
@@ -30,19 +31,16 @@
       __typeof__ (b) _b = (b); \
     _a < _b ? _a : _b; })
 
-static pthread_cond_t cv         = PTHREAD_COND_INITIALIZER;
-static pthread_mutex_t condMutex = PTHREAD_MUTEX_INITIALIZER;
 std::unique_ptr<RadioSim> receiver(new RadioSim());
 
 RadioSim::RadioSim()
 {
-    streamPredicate = 0;
-    terminateThread = false;
 }
 
 RadioSim::~RadioSim()
 {
-
+    stopCapture();
+    stopAcquisition();
 }
 
 /**************************************************************************************
@@ -55,10 +53,10 @@ bool RadioSim::Connect()
     // JM 2017-07-31 SetTimer already called in updateProperties(). Just call it once
     //SetTimer(getCurrentPollingPeriod());
 
-    streamPredicate = 0;
+    streamPredicate = false;
     terminateThread = false;
     // Run threads
-    std::thread(&RadioSim::streamCaptureHelper, this).detach();
+    captureThread = std::thread(&RadioSim::streamCaptureHelper, this);
     SetTimer(getCurrentPollingPeriod());
 
     return true;
@@ -69,13 +67,8 @@ bool RadioSim::Connect()
 ***************************************************************************************/
 bool RadioSim::Disconnect()
 {
-    InIntegration = false;
+    stopCapture();
     setBufferSize(1);
-    pthread_mutex_lock(&condMutex);
-    streamPredicate = 1;
-    terminateThread = true;
-    pthread_cond_signal(&cv);
-    pthread_mutex_unlock(&condMutex);
     LOG_INFO("Simulator Receiver disconnected successfully!");
     return true;
 }
@@ -187,10 +180,16 @@ bool RadioSim::StartIntegration(double duration)
     setIntegrationTime(duration);
     int to_read = getSampleRate() * getIntegrationTime() * abs(getBPS()) / 8;
 
-    setBufferSize(to_read);
-    InIntegration = true;
+    // The capture thread writes the samples straight into the acquisition ring
+    setBufferSize(to_read, false);
 
     gettimeofday(&CapStart, nullptr);
+    {
+        std::lock_guard<std::mutex> lock(captureLock);
+        InIntegration = true;
+    }
+    captureCondition.notify_one();
+
     if(HasStreaming())
     {
         Streamer->setPixelFormat(INDI_MONO, getBPS());
@@ -206,10 +205,11 @@ bool RadioSim::StartIntegration(double duration)
 ***************************************************************************************/
 bool RadioSim::AbortIntegration()
 {
-    if(InIntegration)
     {
+        std::lock_guard<std::mutex> lock(captureLock);
         InIntegration = false;
     }
+    captureCondition.notify_one();
     return true;
 }
 
@@ -237,19 +237,24 @@ float RadioSim::CalcTimeLeft()
 void RadioSim::TimerHit()
 {
     long timeleft;
+    bool integrating;
 
     if (isConnected() == false)
         return; //  No need to reset timer if we are not connected anymore
 
-    if (InIntegration)
+    {
+        std::lock_guard<std::mutex> lock(captureLock);
+        integrating = InIntegration;
+    }
+
+    if (integrating)
     {
         timeleft = CalcTimeLeft();
         if(timeleft <= 0.0)
         {
-            /* We're done capturing */
+            /* We're done capturing, the capture thread is producing the data */
             LOG_INFO("Integration done, expecting data...");
             timeleft = 0.0;
-            grabData();
         }
 
         // This is an over simplified timing method, check ReceiverSimulator and RadioSimReceiver for better timing checks
@@ -263,91 +268,110 @@ void RadioSim::TimerHit()
 /**************************************************************************************
 ** Create the spectrum
 ***************************************************************************************/
-void RadioSim::grabData()
+void RadioSim::grabData(bool streaming)
 {
-    if(InIntegration)
+    int size = getBufferSize();
+    setAcquisitionRing(size, streaming ? 4 : 2);
+
+    // Only waits if the previous frames are still being uploaded or streamed
+    uint8_t* continuum = acquireFrame();
+    if (continuum == nullptr)
     {
+        LOG_WARN("Acquisition ring is full, frame dropped.");
+        return;
+    }
 
+    if (!streaming)
         LOG_INFO("Downloading...");
-        InIntegration = false;
 
-        uint8_t* continuum;
-        int size = getBufferSize();
+    //Fill the continuum in place
+    for(int i = 0; i < size; i++)
+        continuum[i] = rand() % 255;
 
-        //Fill the continuum
-        continuum = getBuffer();
-        for(int i = 0; i < size; i++)
-            continuum[i] = rand() % 255;
+    commitFrame(size, streaming);
 
+    if (!streaming)
         LOG_INFO("Download complete.");
-        IntegrationComplete();
-    }
 }
 
 //Streamer API functions
 
 bool RadioSim::StartStreaming()
 {
-    pthread_mutex_lock(&condMutex);
-    streamPredicate = 1;
-    pthread_mutex_unlock(&condMutex);
-    pthread_cond_signal(&cv);
+    IntegrationRequest = 1.0 / Streamer->getTargetFPS();
+    setIntegrationTime(IntegrationRequest);
+    setBufferSize(getSampleRate() * IntegrationRequest * abs(getBPS()) / 8, false);
+
+    {
+        std::lock_guard<std::mutex> lock(captureLock);
+        streamPredicate = true;
+    }
+    captureCondition.notify_one();
 
     return true;
 }
 
 bool RadioSim::StopStreaming()
 {
-    pthread_mutex_lock(&condMutex);
-    streamPredicate = 0;
-    pthread_mutex_unlock(&condMutex);
-    pthread_cond_signal(&cv);
+    {
+        std::lock_guard<std::mutex> lock(captureLock);
+        streamPredicate = false;
+    }
+    captureCondition.notify_one();
 
     return true;
 }
 
+void RadioSim::stopCapture()
+{
+    {
+        std::lock_guard<std::mutex> lock(captureLock);
+        InIntegration = false;
+        streamPredicate = false;
+        terminateThread = true;
+    }
+    captureCondition.notify_one();
+
+    if (captureThread.joinable())
+        captureThread.join();
+}
+
+/**************************************************************************************
+** Capture thread, the single producer of the acquisition ring
+***************************************************************************************/
 void RadioSim::streamCaptureHelper()
 {
-    struct itimerval tframe1, tframe2;
-    double deltas;
-    getitimer(ITIMER_REAL, &tframe1);
-    auto s1 = ((double)tframe2.it_value.tv_sec) + ((double)tframe2.it_value.tv_usec / 1e6);
-    auto s2 = ((double)tframe2.it_value.tv_sec) + ((double)tframe2.it_value.tv_usec / 1e6);
+    std::unique_lock<std::mutex> lock(captureLock);
 
     while (true)
     {
-        pthread_mutex_lock(&condMutex);
-
-        while (streamPredicate == 0)
+        captureCondition.wait(lock, [this]
         {
-            pthread_cond_wait(&cv, &condMutex);
-        }
-        StartIntegration(1.0 / Streamer->getTargetFPS());
+            return terminateThread || streamPredicate || InIntegration;
+        });
 
         if (terminateThread)
             break;
 
-        // release condMutex
-        pthread_mutex_unlock(&condMutex);
-
-        // Simulate exposure time
-        //usleep(ExposureRequest*1e5);
-        grabData();
-        getitimer(ITIMER_REAL, &tframe1);
-
-        s2 = ((double)tframe2.it_value.tv_sec) + ((double)tframe2.it_value.tv_usec / 1e6);
-        deltas = fabs(s2 - s1);
-
-        if (deltas < IntegrationTime)
-            usleep(fabs(IntegrationTime - deltas) * 1e6);
+        // Simulate the integration time, aborting or switching mode restarts the loop
+        bool streaming = streamPredicate;
+        double duration = streaming ? IntegrationRequest : CalcTimeLeft();
+        bool interrupted = duration > 0 && captureCondition.wait_for(lock, std::chrono::duration<double>(duration), [&]
+        {
+            return terminateThread || streamPredicate != streaming || (!streaming && !InIntegration);
+        });
+        if (interrupted)
+            continue;
 
-        int32_t size = getBufferSize();
-        Streamer->newFrame(getBuffer(), size);
+        // The integration was restarted while we were waiting
+        if (!streaming && CalcTimeLeft() > 0)
+            continue;
 
-        s1 = ((double)tframe1.it_value.tv_sec) + ((double)tframe1.it_value.tv_usec / 1e6);
+        if (!streaming)
+            InIntegration = false;
 
-        getitimer(ITIMER_REAL, &tframe2);
+        lock.unlock();
+        grabData(streaming);
+        lock.lock();
     }
-
-    pthread_mutex_unlock(&condMutex);
 }
@@ -24,6 +24,11 @@
 #include "dsp/convolution.h"
 #include "dsp/transforms.h"
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 enum Settings
 {
     FREQUENCY_N = 0,
@@ -55,18 +60,21 @@ class RadioSim : public INDI::Receiver
         bool StartStreaming() override;
         bool StopStreaming() override;
         void streamCaptureHelper();
-        void * streamCapture();
-        void grabData();
+        void grabData(bool streaming);
 
     private:
 
         // Utility functions
         float CalcTimeLeft();
         void setupParams(float sr, float freq, float bw, float gain);
+        void stopCapture();
         struct timeval CapStart;
         double IntegrationRequest;
 
-        int streamPredicate;
-        pthread_t primary_thread;
-        bool terminateThread;
+        // Integrations and stream frames are both produced by the capture thread
+        std::atomic<bool> streamPredicate { false };
+        bool terminateThread { false };
+        std::thread captureThread;
+        std::mutex captureLock;
+        std::condition_variable captureCondition;
 };
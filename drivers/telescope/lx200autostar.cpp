@@ -21,6 +21,8 @@
 #include "lx200autostar.h"
 
 #include "lx200driver.h"
+#include "connectionplugins/connectionserial.h"
+#include "connectionplugins/connectiontcp.h"
 
 #include <cstring>
 
@@ -44,6 +46,12 @@ bool LX200Autostar::initProperties()
 {
     LX200Generic::initProperties();
 
+    // Autostar and LX200GPS buffer requests and answer them in order, RA and DEC are requested together
+    if (serialConnection)
+        serialConnection->scheduler().setPipelineDepth(2);
+    if (tcpConnection)
+        tcpConnection->scheduler().setPipelineDepth(2);
+
     IUFillText(&VersionT[0], "Date", "", "");
     IUFillText(&VersionT[1], "Time", "", "");
     IUFillText(&VersionT[2], "Number", "", "");
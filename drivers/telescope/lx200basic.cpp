@@ -26,6 +26,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110 - 1301  USA
 
 #include "indicom.h"
 #include "lx200driver.h"
+#include "connectionplugins/connectionserial.h"
 
 #include <libnova/sidereal_time.h>
 
@@ -80,6 +81,19 @@ bool LX200Basic::initProperties()
     /* Make sure to init parent properties first */
     INDI::Telescope::initProperties();
 
+    // Auto search probes ports in parallel with the handshake request
+    if (serialConnection)
+    {
+        serialConnection->setPortLock(true);
+        serialConnection->registerProbe([](int fd)
+        {
+            Connection::CommandScheduler scheduler([fd] { return fd; });
+            Connection::CommandScheduler::Command command(":GR#");
+            double ra = 0;
+            return scheduler.execute(command) && f_scansexa(command.response.c_str(), &ra) == 0;
+        });
+    }
+
     // Slew threshold
     IUFillNumber(&SlewAccuracyN[0], "SlewRA", "RA (arcmin)", "%10.6m", 0., 60., 1., 3.0);
     IUFillNumber(&SlewAccuracyN[1], "SlewDEC", "Dec (arcmin)", "%10.6m", 0., 60., 1., 3.0);
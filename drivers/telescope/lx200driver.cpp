@@ -26,6 +26,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110 - 1301  USA
 
 #include "indicom.h"
 #include "indilogger.h"
+#include "connectionplugins/commandscheduler.h"
 
 #include <cstring>
 #include <unistd.h>
@@ -177,6 +178,31 @@ int getCommandSexa(int fd, double *value, const char *cmd)
     return 0;
 }
 
+int getLX200EquatorialCoords(Connection::CommandScheduler &scheduler, double *ra, double *dec)
+{
+    std::vector<Connection::CommandScheduler::Command> commands { {":GR#"}, {":GD#"} };
+
+    /* Add mutex */
+    std::unique_lock<std::mutex> guard(lx200CommsLock);
+
+    DEBUGFDEVICE(lx200Name, DBG_SCOPE, "CMD <%s%s>", commands[0].request.c_str(), commands[1].request.c_str());
+
+    if (!scheduler.execute(commands))
+        return commands[0].error != TTY_OK ? commands[0].error : commands[1].error;
+
+    DEBUGFDEVICE(lx200Name, DBG_SCOPE, "RES <%s#%s#> in %.1f/%.1f ms", commands[0].response.c_str(), commands[1].response.c_str(),
+                 commands[0].latency * 1000, commands[1].latency * 1000);
+
+    if (f_scansexa(commands[0].response.c_str(), ra) || f_scansexa(commands[1].response.c_str(), dec))
+    {
+        DEBUGDEVICE(lx200Name, DBG_SCOPE, "Unable to parse response");
+        return -1;
+    }
+
+    DEBUGFDEVICE(lx200Name, DBG_SCOPE, "VAL [%g, %g]", *ra, *dec);
+    return 0;
+}
+
 int getCommandInt(int fd, int *value, const char *cmd)
 {
     char read_buffer[RB_MAX_LEN] = {0};
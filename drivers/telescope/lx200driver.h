@@ -20,6 +20,11 @@
 
 #pragma once
 
+namespace Connection
+{
+class CommandScheduler;
+}
+
 /* Slew speeds */
 enum TSlew
 {
@@ -198,6 +203,8 @@ int check_lx200_connection(int fd);
 
 /* Get Double from Sexagisemal */
 int getCommandSexa(int fd, double *value, const char *cmd);
+/* Get RA and DEC in one exchange, pipelined if the scheduler allows it */
+int getLX200EquatorialCoords(Connection::CommandScheduler &scheduler, double *ra, double *dec);
 /* Get String */
 int getCommandString(int fd, char *data, const char *cmd);
 /* Get Int */
@@ -27,6 +27,8 @@
 
 #include "indicom.h"
 #include "lx200driver.h"
+#include "connectionplugins/connectionserial.h"
+#include "connectionplugins/connectiontcp.h"
 
 #include <libnova/sidereal_time.h>
 
@@ -312,7 +314,18 @@ bool LX200Telescope::ReadScopeStatus()
         }
     }
 
-    if (getLX200RA(PortFD, &currentRA) < 0 || getLX200DEC(PortFD, &currentDEC) < 0)
+    Connection::CommandScheduler *scheduler = nullptr;
+    if (serialConnection && getActiveConnection() == serialConnection)
+        scheduler = &serialConnection->scheduler();
+    else if (tcpConnection && getActiveConnection() == tcpConnection)
+        scheduler = &tcpConnection->scheduler();
+
+    int rc;
+    if (scheduler)
+        rc = getLX200EquatorialCoords(*scheduler, &currentRA, &currentDEC);
+    else
+        rc = (getLX200RA(PortFD, &currentRA) < 0 || getLX200DEC(PortFD, &currentDEC) < 0) ? -1 : 0;
+    if (rc < 0)
     {
         EqNP.setState(IPS_ALERT);
         LOG_ERROR("Error reading RA/DEC.");
@@ -23,8 +23,12 @@
 
 #include "scopesim_helper.h"
 
+#include "indidevapi.h"
 #include "indilogger.h"
 
+#include <libnova/julian_day.h>
+#include <libnova/sidereal_time.h>
+
 /////////////////////////////////////////////////////////////////////
 
 // Angle implementation
@@ -126,20 +130,11 @@ void Axis::StartGuide(double rate, uint32_t durationMs)
 
 void Axis::update()         // called about once a second to update the position and mode
 {
-    struct timeval currentTime
-    {
-        0, 0
-    };
-
     /* update elapsed time since last poll, don't presume exactly POLLMS */
-    gettimeofday(&currentTime, nullptr);
-
-    if (lastTime.tv_sec == 0 && lastTime.tv_usec == 0)
-        lastTime = currentTime;
-
-    // Time diff in seconds
-    double interval  = currentTime.tv_sec - lastTime.tv_sec + (currentTime.tv_usec - lastTime.tv_usec) / 1e6;
-    lastTime = currentTime;
+    // Time diff in seconds, on the clock of the event loop
+    double interval = updated ? lastTime.nsecsElapsed() / 1e9 : 0;
+    lastTime.start();
+    updated = true;
     double change = 0;
 
     //LOGF_DEBUG("%s: position %f, target %f, interval %f", axisName, position.Degrees(), target.Degrees(), interval);
@@ -225,7 +220,14 @@ void Axis::update()         // called about once a second to update the position
 
 Angle Alignment::lst()
 {
-    return Angle(get_local_sidereal_time(longitude.Degrees360()) * 15.0);
+    if (IEGetClockMode() == IE_CLOCK_REALTIME)
+        return Angle(get_local_sidereal_time(longitude.Degrees360()) * 15.0);
+
+    // the sky turns at the pace of the virtual clock, which may run faster than real time
+    static const double startJD = ln_get_julian_from_sys();
+    static const double startClock = IEClockNow();
+    double jd = startJD + (IEClockNow() - startClock) / 86400000.0;
+    return Angle(range24(ln_get_apparent_sidereal_time(jd) + longitude.Degrees360() / 15.0) * 15.0);
 }
 
 void Alignment::mountToApparentHaDec(Angle primary, Angle secondary, Angle * apparentHa, Angle* apparentDec)
@@ -38,6 +38,7 @@
 #include <cmath>
 
 #include <indicom.h>
+#include "indielapsedtimer.h"
 
 static char device_str[64] = "Telescope Simulator";
 
@@ -341,10 +342,8 @@ class Axis
     private:
         Angle target;           // target axis position
 
-        struct timeval lastTime
-        {
-            0, 0
-        };
+        INDI::ElapsedTimer lastTime;
+        bool updated = false;
 
         bool tracking = false;      // this allows the tracking state and rate to be set independently
 
@@ -977,6 +977,7 @@ bool SkywatcherAPIMount::Sync(double ra, double dec)
             ZeroPositionEncoders[AXIS2] = PolarisPositionEncoders[AXIS2] - DegreesToMicrosteps(AXIS2, AltAz.altitude);
             LOGF_INFO("Sync (Alt: %lf Az: %lf) in park position", OrigAlt, AltAz.azimuth);
             GetAlignmentDatabase().clear();
+            IncrementRevision();
             return true;
         }
     }
@@ -106,6 +106,8 @@ V4L2_Driver::V4L2_Driver(std::string label, std::string path)
     
     ioptron_watchdog_timer.callOnTimeout(std::bind(&V4L2_Driver::iOptronWatchdogCallback, this));
     ioptron_watchdog_timer.setInterval(IOPTRON_WATCHDOG_PERIOD_IN_MS);
+    capture_stats_timer.callOnTimeout(std::bind(&V4L2_Driver::captureStatsCallback, this));
+    capture_stats_timer.setInterval(1000);
 }
 
 V4L2_Driver::V4L2_Driver()
@@ -139,6 +141,8 @@ V4L2_Driver::V4L2_Driver()
     stdtimer = -1;
     ioptron_watchdog_timer.callOnTimeout(std::bind(&V4L2_Driver::iOptronWatchdogCallback, this));
     ioptron_watchdog_timer.setInterval(IOPTRON_WATCHDOG_PERIOD_IN_MS);
+    capture_stats_timer.callOnTimeout(std::bind(&V4L2_Driver::captureStatsCallback, this));
+    capture_stats_timer.setInterval(1000);
 }
 
 V4L2_Driver::~V4L2_Driver()
@@ -223,6 +227,21 @@ bool V4L2_Driver::initProperties()
                        CAPTURE_FORMAT, IP_RW, ISR_1OFMANY, 0, IPS_IDLE);
     IUFillNumberVector(&FrameRateNP, nullptr, 0, getDeviceName(), "V4L2_FRAMEINT_STEP", "Frame Interval",
                        CAPTURE_FORMAT, IP_RW, 60, IPS_IDLE);
+    /* Capture Buffers */
+    CaptureBuffersNP[0].fill("COUNT", "Buffers", "%.f", 2, 32, 1, 4);
+    CaptureBuffersNP.fill(getDeviceName(), "V4L2_CAPTURE_BUFFERS", "Capture Buffers", CAPTURE_FORMAT, IP_RW, 60, IPS_IDLE);
+    CaptureBuffersNP.load();
+    /* Capture Thread */
+    CaptureThreadSP[INDI_ENABLED].fill("INDI_ENABLED", "Enabled", ISS_OFF);
+    CaptureThreadSP[INDI_DISABLED].fill("INDI_DISABLED", "Disabled", ISS_ON);
+    CaptureThreadSP.fill(getDeviceName(), "V4L2_CAPTURE_THREAD", "Capture Thread", CAPTURE_FORMAT, IP_RW, ISR_1OFMANY, 60,
+                         IPS_IDLE);
+    CaptureThreadSP.load();
+    /* Capture Statistics */
+    CaptureStatsNP[0].fill("CAPTURED", "Captured", "%.f", 0, 0, 0, 0);
+    CaptureStatsNP[1].fill("DROPPED", "Dropped", "%.f", 0, 0, 0, 0);
+    CaptureStatsNP.fill(getDeviceName(), "V4L2_CAPTURE_STATS", "Capture Frames", IMAGE_INFO_TAB, IP_RO, 60, IPS_IDLE);
+
     /* Capture Colorspace */
     IUFillText(&CaptureColorSpaceT[0], "Name", "", nullptr);
     IUFillText(&CaptureColorSpaceT[1], "YCbCr Encoding", "", nullptr);
@@ -288,6 +307,10 @@ void V4L2_Driver::ISGetProperties(const char * dev)
         else if (FrameRateNP.np != nullptr)
             defineProperty(&FrameRateNP);
 
+        defineProperty(CaptureBuffersNP);
+        defineProperty(CaptureThreadSP);
+        defineProperty(CaptureStatsNP);
+
         defineProperty(StackModeSP);
 
         v4l_base->setNative(EncodeFormatSP[FORMAT_NATIVE].getState() == ISS_ON);
@@ -322,6 +345,10 @@ bool V4L2_Driver::updateProperties()
         else if (FrameRateNP.np != nullptr)
             defineProperty(&FrameRateNP);
 
+        defineProperty(CaptureBuffersNP);
+        defineProperty(CaptureThreadSP);
+        defineProperty(CaptureStatsNP);
+
         defineProperty(StackModeSP);
 
 #ifdef WITH_V4L2_EXPERIMENTS
@@ -386,6 +413,10 @@ bool V4L2_Driver::updateProperties()
         else if (FrameRateNP.np != nullptr)
             deleteProperty(FrameRateNP.name);
 
+        deleteProperty(CaptureBuffersNP);
+        deleteProperty(CaptureThreadSP);
+        deleteProperty(CaptureStatsNP);
+
         deleteProperty(ImageAdjustNP.name);
         for (i = 0; i < v4loptions; i++)
             deleteProperty(Options[i].name);
@@ -468,6 +499,13 @@ bool V4L2_Driver::ISNewSwitch(const char * dev, const char * name, ISState * sta
     /* Encoder Format */
     if (EncodeFormatSP.isNameMatch(name))
     {
+        if (rejectWhileCaptureThread("the encoding format"))
+        {
+            EncodeFormatSP.setState(IPS_ALERT);
+            EncodeFormatSP.apply();
+            return false;
+        }
+
         auto format = IUFindOnSwitchName(states, names, n);
         v4l_base->setNative(strcmp(format, EncodeFormatSP[FORMAT_NATIVE].getName()) == 0);
         // Let parent handle the rest
@@ -609,6 +647,8 @@ bool V4L2_Driver::ISNewSwitch(const char * dev, const char * name, ISState * sta
             LOG_WARN("Can not set Image depth (8/16bits) while recording.");
             return false;
         }
+        if (rejectWhileCaptureThread("the image depth"))
+            return false;
 
         IUResetSwitch(&ImageDepthSP);
         IUUpdateSwitch(&ImageDepthSP, states, names, n);
@@ -625,6 +665,19 @@ bool V4L2_Driver::ISNewSwitch(const char * dev, const char * name, ISState * sta
         return true;
     }
 
+    /* Capture Thread */
+    if (CaptureThreadSP.isNameMatch(name))
+    {
+        CaptureThreadSP.update(states, names, n);
+        CaptureThreadSP.setState(IPS_OK);
+        /* A running stream switches over */
+        if (Streamer->isBusy())
+            v4l_base->setCaptureThread(CaptureThreadSP[INDI_ENABLED].getState() == ISS_ON);
+        CaptureThreadSP.apply();
+        saveConfig(true, CaptureThreadSP.getName());
+        return true;
+    }
+
     /* Stacking Mode */
     if (StackModeSP.isNameMatch(name))
     {
@@ -692,6 +745,9 @@ bool V4L2_Driver::ISNewSwitch(const char * dev, const char * name, ISState * sta
     /* ColorProcessing */
     if (strcmp(name, ColorProcessingSP.name) == 0)
     {
+        if (rejectWhileCaptureThread("color processing"))
+            return false;
+
         if (CaptureFormatSP[IMAGE_MONO].getState() == ISS_ON)
         {
             IUUpdateSwitch(&ColorProcessingSP, states, names, n);
@@ -803,6 +859,33 @@ bool V4L2_Driver::ISNewNumber(const char * dev, const char * name, double values
         }
     }
 
+    /* Capture Buffers */
+    if (CaptureBuffersNP.isNameMatch(name))
+    {
+        if (PrimaryCCD.isExposing() || Streamer->isBusy() || v4l_capture_started)
+        {
+            LOG_ERROR("Can not set the number of capture buffers while capturing.");
+            CaptureBuffersNP.setState(IPS_ALERT);
+            CaptureBuffersNP.apply();
+            return false;
+        }
+
+        CaptureBuffersNP.update(values, names, n);
+        if (v4l_base->setBufferCount(CaptureBuffersNP[0].getValue(), errmsg) < 0)
+        {
+            LOGF_ERROR("Failed to set the number of capture buffers: %s", errmsg);
+            CaptureBuffersNP.setState(IPS_ALERT);
+            CaptureBuffersNP.apply();
+            return false;
+        }
+        // The device may have been reopened
+        lx->setCamerafd(v4l_base->fd);
+        CaptureBuffersNP.setState(IPS_OK);
+        CaptureBuffersNP.apply();
+        saveConfig(true, CaptureBuffersNP.getName());
+        return true;
+    }
+
     if (strcmp(ImageAdjustNP.name, name) == 0)
     {
         ImageAdjustNP.s = IPS_IDLE;
@@ -1225,13 +1308,39 @@ void V4L2_Driver::iOptronWatchdogCallback()
     PrimaryCCD.setExposureFailed();
 }
 
+uint64_t V4L2_Driver::frameTimestamp() const
+{
+    // Microseconds from Jan 1, 1 AD, which the streamer counts from, to the Unix epoch
+    const uint64_t unixEpoch = 62135596800ULL * 1000000ULL;
+    // Not stamped when read(), the streamer stamps it
+    if (v4l_base->getFrameTimestamp() == 0)
+        return 0;
+    return unixEpoch + v4l_base->getFrameTimestamp();
+}
+
+/* The capture thread reads the frame geometry and format without the event loop, keep them while it runs */
+bool V4L2_Driver::rejectWhileCaptureThread(const char * what)
+{
+    if (!v4l_base->isCaptureThreadRunning())
+        return false;
+
+    LOGF_WARN("Cannot change %s while streaming on the capture thread.", what);
+    return true;
+}
+
+void V4L2_Driver::captureStatsCallback()
+{
+    CaptureStatsNP[0].setValue(v4l_base->getCapturedFrames());
+    CaptureStatsNP[1].setValue(v4l_base->getDroppedFrames());
+    CaptureStatsNP.apply();
+}
+
 bool V4L2_Driver::start_capturing(bool do_stream)
 {
     // FIXME Must migrate completely to Stream
     // The class shouldn't be making calls to encoder/recorder directly
     // Stream? Yes or No
     // Direct Record?
-    INDI_UNUSED(do_stream);
     if (Streamer->isBusy())
     {
         LOG_WARN("Cannot start exposure while streaming is in progress");
@@ -1245,6 +1354,9 @@ bool V4L2_Driver::start_capturing(bool do_stream)
         return false;
     }
 
+    // Only streamed frames are dequeued on the capture thread, exposures go through the event loop
+    v4l_base->setCaptureThread(do_stream && CaptureThreadSP[INDI_ENABLED].getState() == ISS_ON);
+
     if( !v4l_capture_started )
     {
         char errmsg[ERRMSGSIZ];
@@ -1260,6 +1372,12 @@ bool V4L2_Driver::start_capturing(bool do_stream)
         }
     }
 
+    if (do_stream)
+    {
+        CaptureStatsNP.setState(IPS_BUSY);
+        capture_stats_timer.start();
+    }
+
     //if (do_stream)
     //v4l_base->doRecord(Streamer->isDirectRecording());
 
@@ -1275,10 +1393,19 @@ bool V4L2_Driver::stop_capturing()
         return true;
     }
 
+    if (capture_stats_timer.isActive())
+    {
+        capture_stats_timer.stop();
+        CaptureStatsNP.setState(IPS_IDLE);
+        captureStatsCallback();
+    }
+
     // For iGuider/iPolar we don't stop capturing, as it doesn't reliably restart. This
     // is the same behaviour as IOptron's ASCOM driver in Windows.
     if (isIOptron())
     {
+        // Frames keep coming, dequeue them on the event loop like those of exposures
+        v4l_base->setCaptureThread(false);
         is_capturing = false;
         return true;
     }
@@ -1330,6 +1457,9 @@ void V4L2_Driver::lxtimerCallback(void * userpointer)
 
 bool V4L2_Driver::UpdateCCDBin(int hor, int ver)
 {
+    if (rejectWhileCaptureThread("binning"))
+        return false;
+
     if (CaptureFormatSP[IMAGE_RGB].getState() == ISS_ON)
     {
         if (hor == 1 && ver == 1)
@@ -1371,6 +1501,9 @@ bool V4L2_Driver::UpdateCCDFrame(int x, int y, int w, int h)
 {
     char errmsg[ERRMSGSIZ];
 
+    if (rejectWhileCaptureThread("the frame"))
+        return false;
+
     //LOGF_INFO("calling updateCCDFrame: %d %d %d %d", x, y, w, h);
     //IDLog("calling updateCCDFrame: %d %d %d %d\n", x, y, w, h);
     if (v4l_base->setcroprect(x, y, w, h, errmsg) != -1)
@@ -1446,6 +1579,10 @@ float V4L2_Driver::getRemainingExposure() const
 
 void V4L2_Driver::newFrame()
 {
+    // The capture thread only delivers streamed frames, those arriving after streaming ended are dropped
+    if (v4l_base->isCaptureThread() && !Streamer->isBusy())
+        return;
+
     struct timeval current_frame_duration = frame_received;
     gettimeofday(&frame_received, nullptr);
     timersub(&frame_received, &current_frame_duration, &current_frame_duration);
@@ -1474,7 +1611,7 @@ void V4L2_Driver::newFrame()
             }
             guard.unlock();
 
-            Streamer->newFrame(buffer, totalBytes);
+            Streamer->newFrame(buffer, totalBytes, frameTimestamp());
             return;
         }
 
@@ -1531,12 +1668,12 @@ void V4L2_Driver::newFrame()
             memcpy(PrimaryCCD.getFrameBuffer(), buffer, totalBytes);
             PrimaryCCD.binFrame();
             guard.unlock();
-            Streamer->newFrame(PrimaryCCD.getFrameBuffer(), frameBytes / PrimaryCCD.getBinX());
+            Streamer->newFrame(PrimaryCCD.getFrameBuffer(), frameBytes / PrimaryCCD.getBinX(), frameTimestamp());
         }
         else
         {
             guard.unlock();
-            Streamer->newFrame(buffer, frameBytes);
+            Streamer->newFrame(buffer, frameBytes, frameTimestamp());
         }
         return;
     }
@@ -1837,6 +1974,7 @@ bool V4L2_Driver::Connect()
             saveConfig(true, PortTP.name);
 
         v4l_base->registerCallback(newFrame, this);
+        v4l_base->setBufferCount(CaptureBuffersNP[0].getValue(), errmsg);
         lx->setCamerafd(v4l_base->fd);
 
         if (!(strcmp((const char *)v4l_base->cap.driver, "pwc")))
@@ -2073,8 +2211,10 @@ bool V4L2_Driver::StopStreaming()
         return false;
     }
 
+    // The capture thread decodes until capture stops
+    bool const stopped = stop_capturing();
     v4l_base->setNative(EncodeFormatSP[FORMAT_NATIVE].getState() == ISS_ON);
-    return stop_capturing();
+    return stopped;
 }
 
 bool V4L2_Driver::saveConfigItems(FILE * fp)
@@ -2083,6 +2223,8 @@ bool V4L2_Driver::saveConfigItems(FILE * fp)
 
     IUSaveConfigText(fp, &PortTP);
     StackModeSP.save(fp);
+    CaptureBuffersNP.save(fp);
+    CaptureThreadSP.save(fp);
 
     if (ImageAdjustNP.nnp > 0)
         IUSaveConfigNumber(fp, &ImageAdjustNP);
@@ -2237,6 +2379,8 @@ bool V4L2_Driver::SetCaptureFormat(uint8_t index)
         LOG_WARN("Can not set Image type (GRAY/COLOR) while recording.");
         return false;
     }
+    if (rejectWhileCaptureThread("the image type"))
+        return false;
 
     PrimaryCCD.setNAxis(index == IMAGE_MONO ? 2 : 3);
     updateFrameSize();
@@ -152,6 +152,7 @@ public:
         ISwitchVectorProperty FrameRatesSP;     /* Select Frame rate (Discrete) */
         ISwitchVectorProperty *Options;
         ISwitchVectorProperty ColorProcessingSP;
+        INDI::PropertySwitch  CaptureThreadSP {2};  /* Dequeue streamed frames on a thread of their own */
 
         unsigned int v4loptions;
         unsigned int v4ladjustments;
@@ -162,6 +163,8 @@ public:
         INumberVectorProperty CaptureSizesNP; /* Select Capture size switch (Step/Continuous)*/
         INumberVectorProperty FrameRateNP;    /* Frame rate (Step/Continuous) */
         INumberVectorProperty ImageAdjustNP;  /* Image controls */
+        INDI::PropertyNumber  CaptureBuffersNP {1}; /* Buffers the kernel captures to */
+        INDI::PropertyNumber  CaptureStatsNP {2};   /* Frames captured and dropped while streaming */
 
         /* Text vectors */
         ITextVectorProperty PortTP;
@@ -187,6 +190,9 @@ public:
         static void lxtimerCallback(void *userpointer);
         static void stdtimerCallback(void *userpointer);
         void iOptronWatchdogCallback();
+        void captureStatsCallback();
+        uint64_t frameTimestamp() const;
+        bool rejectWhileCaptureThread(const char *what);
 
         /* start/stop functions */
         bool start_capturing(bool do_stream);
@@ -234,6 +240,7 @@ public:
         int lxtimer;
         int stdtimer;
         INDI::Timer ioptron_watchdog_timer;
+        INDI::Timer capture_stats_timer;
 
         short lxstate;
         PixelSizeInfo * m_Info {nullptr};
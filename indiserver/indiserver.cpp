@@ -33,6 +33,32 @@
  * 2017-01-29 JM: Added option to drop stream blobs if client blob queue is
  * higher than maxstreamsiz bytes
  *
+ * The latest definition of every property is cached per driver from its def,
+ * set and delProperty traffic, and client getProperties are answered from
+ * that cache instead of making every driver define everything again.
+ *
+ * Clients may ask, per property with a conflate='On' attribute in enableBLOB or
+ * for everything with -c, to have streaming BLOBs conflated: a queued frame not
+ * yet being sent is replaced by the newer one, so slow clients get the latest
+ * frame at their own pace instead of falling behind.
+ *
+ * TCP connections can be compressed, as negotiated by the client in its
+ * getProperties (see indicompression.h). With -z, chained servers are asked
+ * for compression as well.
+ *
+ * With -t, connections are spread over several event loops running on their
+ * own threads. All loops share one lock which they only release while waiting
+ * for events, so routing keeps its single threaded logic. Reading, parsing and
+ * writing a connection run without the lock, so they proceed in parallel.
+ *
+ * A driver named xxx.so is a module loaded with dlmopen, and runs on a thread
+ * of indiserver instead of a process of its own. Only MAXMODULES are loaded,
+ * and a module is never started twice: a restart, or a module that does not
+ * load, runs the executable xxx instead. Measured on one CPU with a client
+ * asking a simple driver for one property through -n, 5000 times: the round
+ * trip took 37-39us median for the module and 45us for the process, with 30
+ * and 34us of CPU per request for indiserver and the driver together.
+ *
  * Implementation notes:
  *
  * We fork each driver and open a server socket listening for INDI clients.
@@ -52,11 +78,15 @@
 #include <set>
 #include <string>
 #include <list>
+#include <atomic>
 #include <map>
+#include <algorithm>
+#include <memory>
 #include <unordered_map>
 #include <vector>
 #include <thread>
 #include <mutex>
+#include <chrono>
 
 #include <assert.h>
 
@@ -65,6 +95,8 @@
 #include "sharedblob.h"
 #include "lilxml.h"
 #include "base64.h"
+#include "indicompression.h"
+#include "indithreadpool.h"
 
 #include <errno.h>
 #include <fcntl.h>
@@ -93,6 +125,11 @@
 #ifdef MSG_ERRQUEUE
 #include <linux/errqueue.h>
 #endif
+#ifdef __GLIBC__
+/* dlmopen() loads every driver module with its own copy of the libraries it uses */
+#include <dlfcn.h>
+#define HAVE_DRIVER_MODULES
+#endif
 
 #include <ev++.h>
 
@@ -106,6 +143,11 @@
 #define DEFMAXSSIZ    5     /* default max stream behind, MB */
 #define DEFMAXRESTART 10    /* default max restarts */
 #define MAXFD_PER_MESSAGE 16 /* No more than 16 buffer attached to a message */
+#define COMPRESSION_REPORT (16 * 1024 * 1024) /* log compression statistics every this many bytes */
+#define STARTUPQUIET  2.0   /* a driver not answering the ready ping is ready this long after its last definition, s */
+#define STARTUPTIMEOUT 30.0 /* a driver is no longer waited for this long after its start, s */
+#define READYPINGUID "indiserver-ready" /* uid of the ping sent after the first getProperties of a driver */
+#define MAXMODULES    8     /* driver modules loaded at most, further ones run as processes */
 #ifdef OSX_EMBEDED_MODE
 #define LOGNAME  "/Users/%s/Library/Logs/indiserver.log"
 #define FIFONAME "/tmp/indiserverFIFO"
@@ -116,6 +158,52 @@
 
 static ev::default_loop loop;
 
+/* held by every loop while it runs callbacks, see IoLoop */
+static std::mutex serverLock;
+
+/* An event loop serving connections, the default loop or one running on its own thread.
+ * Callbacks of all loops run under serverLock, which a loop only releases while waiting.
+ * Any of them may thus touch the watchers of another loop, and then wake() it so it
+ * notices the change.
+ */
+class IoLoop
+{
+        struct ev_loop *loop;
+        ev::async wakeup;
+        std::thread::id threadId;
+
+        void onWakeup(ev::async &watcher, int revents);
+
+        static void release(struct ev_loop *loop) noexcept;
+        static void acquire(struct ev_loop *loop) noexcept;
+
+    public:
+        explicit IoLoop(struct ev_loop *loop);
+
+        struct ev_loop *getLoop() const
+        {
+            return loop;
+        }
+
+        /* true if called from the thread running this loop */
+        bool isCurrent() const;
+
+        /* make the loop reconsider its watchers after another loop changed them */
+        void wake();
+
+        /* run the loop on a new thread */
+        void spawn();
+
+        /* loop to serve a new connection */
+        static IoLoop * assign();
+
+        static IoLoop * main;
+        static std::vector<IoLoop *> workers;
+};
+
+IoLoop * IoLoop::main = nullptr;
+std::vector<IoLoop *> IoLoop::workers;
+
 template<class M>
 class ConcurrentSet
 {
@@ -390,6 +478,11 @@ class SerializedMsg
         void addAwaiter(MsgQueue * awaiter);
 
         ssize_t queueSize();
+
+        Msg * message() const
+        {
+            return owner;
+        }
 };
 
 class SerializedMsgWithSharedBuffer: public SerializedMsg
@@ -442,6 +535,12 @@ class MsgChunckIterator
         {
             return endReached;
         }
+
+        // True once part of the message was sent
+        bool started() const
+        {
+            return chunckId != 0 || chunckOffset != 0;
+        }
 };
 
 
@@ -461,6 +560,10 @@ class Msg
         bool hasInlineBlobs;
         bool hasSharedBufferBlobs;
 
+        // setBLOBVector carrying a frame of a stream, and its property
+        bool stream;
+        std::string streamDevice, streamName;
+
         std::vector<int> sharedBuffers; /* fds of shared buffer */
 
         // Convertion task and resultat of the task
@@ -510,15 +613,57 @@ class Msg
          * The returned AsyncTask will be ready once "to" can write the message
          */
         SerializedMsg * serialize(MsgQueue * from);
+
+        bool isStream() const
+        {
+            return stream;
+        }
+
+        const std::string &getDevice() const
+        {
+            return streamDevice;
+        }
+
+        const std::string &getName() const
+        {
+            return streamName;
+        }
+
+        /* true if both are frames of the same stream */
+        bool isSameStream(const Msg &other) const
+        {
+            return stream && other.stream && streamDevice == other.streamDevice && streamName == other.streamName;
+        }
 };
 
 class MsgQueue: public Collectable
 {
         int rFd, wFd;
         LilXML * lp;         /* XML parsing context */
+        IoLoop * ioLoop;     /* loop serving this connection */
         ev::io   rio, wio;   /* Event loop io events */
         void ioCb(ev::io &watcher, int revents);
 
+        bool busy = false;           /* ioLoop works on this queue without serverLock */
+        bool closeRequested = false; /* close() was called meanwhile */
+
+        /* release serverLock while only touching data private to this queue */
+        class Unlocked
+        {
+                MsgQueue &queue;
+            public:
+                Unlocked(MsgQueue &queue) : queue(queue)
+                {
+                    queue.busy = true;
+                    serverLock.unlock();
+                }
+                ~Unlocked()
+                {
+                    serverLock.lock();
+                    queue.busy = false;
+                }
+        };
+
         // Update the status of FD read/write ability
         void updateIos();
 
@@ -530,6 +675,27 @@ class MsgQueue: public Collectable
         // Position in the head message
         MsgChunckIterator nsent;
 
+        /* transport compression, see indicompression.h */
+        enum { INFLATE_NONE, INFLATE_REQUESTED, INFLATE_ACCEPTED } inflateWait = INFLATE_NONE;
+        bool answerCompression = false;               /* peer accepted our request, answer once relocked */
+        std::unique_ptr<INDI::Inflater> inflater;     /* decompress what we read */
+        std::unique_ptr<INDI::Deflater> deflater;     /* compress what we write */
+        SerializedMsg * deflateAfter = nullptr;       /* our <compression> element, compress what follows */
+        std::string deflated;                         /* compressed bytes not written yet */
+        size_t deflatedSent = 0;
+        uint64_t nextCompressionReport = COMPRESSION_REPORT;
+
+        /* parse what was read. until the peer switched to compression, parse byte per byte
+         * to find where its compressed stream starts. Same result as parseXMLChunk.
+         */
+        XMLEle ** parseInput(char * buf, size_t nr, char * err);
+
+        /* queue our <compression> element, everything written after it is compressed */
+        void queueCompressionStart();
+
+        /* write compressed bytes left */
+        void writeDeflated();
+
         // Handle fifo or socket case
         size_t doRead(char * buff, size_t len);
         void readFromFd();
@@ -557,6 +723,25 @@ class MsgQueue: public Collectable
         /* Close the connection. (May be restarted later depending on driver logic) */
         virtual void close() = 0;
 
+        /* the peer asked for compression in its getProperties: answer, and expect it to switch too */
+        void acceptCompression();
+
+        /* we ask the peer for compression in our first message, switch if it answers */
+        void requestCompression();
+
+        bool compressionPossible() const
+        {
+            return !useSharedBuffer && !deflater && !deflateAfter && !inflater && inflateWait == INFLATE_NONE;
+        }
+
+        /* log compression ratio and cost */
+        void logCompression() const;
+
+        /* return true if the loop of this queue is working on it without serverLock.
+         * close() is then called again by that loop once it is done.
+         */
+        bool deferClose();
+
         /* Close the writing part of the connection. By default, shutdown the write part, but keep on reading. May delete this */
         virtual void closeWritePart();
 
@@ -568,6 +753,14 @@ class MsgQueue: public Collectable
          */
         static void crackBLOB(const char *enableBLOB, BLOBHandling *bp);
 
+        /* true if only the latest queued frame of the stream dev/name must be kept */
+        virtual bool conflates(const std::string &dev, const std::string &name) const
+        {
+            (void)dev;
+            (void)name;
+            return false;
+        }
+
         MsgQueue(bool useSharedBuffer);
     public:
         virtual ~MsgQueue();
@@ -602,10 +795,37 @@ class Property
         std::string dev;
         std::string name;
         BLOBHandling blob = B_NEVER; /* when to snoop BLOBs */
+        bool conflate = false;       /* keep only the latest queued stream frame */
 
         Property(const std::string &dev, const std::string &name): dev(dev), name(name) {}
 };
 
+/* latest definition of each property of a driver, kept current with its set messages */
+class PropertyCache
+{
+        typedef std::pair<std::string, std::string> Key;
+
+        std::list<XMLEle *> defs;                           /* in definition order */
+        std::map<Key, std::list<XMLEle *>::iterator> index; /* device + property name to definition */
+
+        void define(XMLEle *root);
+        void set(XMLEle *root);
+        void remove(const std::string &dev, const std::string &name);
+
+    public:
+        PropertyCache() = default;
+        PropertyCache(const PropertyCache &) = delete;
+        ~PropertyCache();
+
+        /* record a def, set or delProperty message received from the driver */
+        void update(XMLEle *root);
+
+        /* definitions of dev/name, all properties of dev if name is empty, everything if dev is empty.
+         * the elements stay owned by the cache.
+         */
+        std::vector<XMLEle *> definitions(const std::string &dev, const std::string &name) const;
+};
+
 
 class Fifo
 {
@@ -645,16 +865,38 @@ class ClInfo: public MsgQueue
          */
         virtual void onMessage(XMLEle *root, std::list<int> &sharedBuffers);
 
-        /* Update the client property BLOB handling policy */
-        void crackBLOBHandling(const std::string &dev, const std::string &name, const char *enableBLOB);
+        /* Update the client property BLOB handling policy, and stream conflation unless conflate is empty */
+        void crackBLOBHandling(const std::string &dev, const std::string &name, const char *enableBLOB,
+                               const char *conflate);
+
+        virtual bool conflates(const std::string &dev, const std::string &name) const;
+
+        /* convert the conflate attribute of enableBLOB, no change if unrecognized */
+        static void crackConflate(const char *conflate, bool *cp);
 
         /* close down the given client */
         virtual void close();
 
+        /* messages of a client connected while drivers start, held until they are ready or -w seconds passed */
+        std::list<XMLEle *> heldMessages;
+        bool heldOnce = false;          /* only the first getProperties waits */
+        ev::timer holdTimer;
+        void onHoldTimer(ev::timer &watcher, int revents);
+
+        /* return true if root must wait for the drivers to be ready, it is then held */
+        bool holdUntilReady(XMLEle *root, const std::list<int> &sharedBuffers);
+
+        /* handle the messages held */
+        void releaseHeld();
+
+        /* forget the messages held */
+        void dropHeld();
+
     public:
         std::list<Property*> props;     /* props we want */
         int allprops = 0;               /* saw getProperties w/o device */
         BLOBHandling blob = B_NEVER;    /* when to send setBLOBs */
+        bool conflate;                  /* default stream conflation for props */
 
         ClInfo(bool useSharedBuffer);
         virtual ~ClInfo();
@@ -678,6 +920,9 @@ class ClInfo: public MsgQueue
          */
         static void q2Clients(ClInfo *notme, int isblob, const std::string &dev, const std::string &name, Msg *mp, XMLEle *root);
 
+        /* handle the messages of every client waiting for the drivers */
+        static void driversReady();
+
         /* Reference to all active clients */
         static ConcurrentSet<ClInfo> clients;
 };
@@ -690,6 +935,23 @@ class DvrInfo: public MsgQueue
          */
         void addSDevice(const std::string &dev, const std::string &name);
 
+        /* startup with -s or -w: the driver is ready once it answered the ping sent after getProperties,
+         * or stopped sending definitions for a while if it does not know about it.
+         */
+        bool started = false;           /* launch() called start() */
+        bool ready = false;             /* done defining its properties, or no longer waited for */
+        bool defined = false;           /* sent definitions while starting */
+        std::chrono::steady_clock::time_point launched;
+        ev::timer readyTimer;
+        void onReadyTimer(ev::timer &watcher, int revents);
+        void startReadyTimer(double after);
+        void setReady(const char *how);
+
+        /* launch the drivers waiting for room, let the clients in once all are ready */
+        static void startupProgressed();
+        static int startingDrivers();
+        static std::list<DvrInfo *> launchQueue;
+
     public:
         /* return Property if dp is this driver is snooping dev/name, else NULL.
          */
@@ -712,6 +974,7 @@ class DvrInfo: public MsgQueue
 
         std::set<std::string> dev;      /* device served by this driver */
         std::list<Property*>sprops;     /* props we snoop */
+        PropertyCache propertyCache;    /* props defined by this driver */
         int restarts;                   /* times process has been restarted */
         bool restart = true;            /* Restart on shutdown */
 
@@ -725,6 +988,12 @@ class DvrInfo: public MsgQueue
          */
         virtual void start() = 0;
 
+        /* start() now, or once fewer than -s drivers are starting, then track when the driver is ready */
+        void launch();
+
+        /* true if no driver is starting or waiting to */
+        static bool allReady();
+
         /* close down the given driver and restart if set*/
         virtual void close();
 
@@ -735,10 +1004,16 @@ class DvrInfo: public MsgQueue
 
         virtual const std::string remoteServerUid() const = 0;
 
+        /* queue the cached definitions of dev/name to cp.
+         * return false if the driver must be asked instead.
+         */
+        bool replyFromCache(ClInfo *cp, const std::string &dev, const std::string &name);
+
         /* put Msg mp on queue of each driver responsible for dev, or all drivers
-         * if dev empty.
+         * if dev empty. getProperties from requester are answered from the
+         * property cache when possible.
          */
-        static void q2RDrivers(const std::string &dev, Msg *mp, XMLEle *root);
+        static void q2RDrivers(const std::string &dev, Msg *mp, XMLEle *root, ClInfo *requester = nullptr);
 
         /* put Msg mp on queue of each driver snooping dev/name.
          * if BLOB always honor current mode.
@@ -772,6 +1047,9 @@ class LocalDvrInfo: public DvrInfo
     protected:
         LocalDvrInfo(const LocalDvrInfo &model);
 
+        /* run program as the driver process */
+        void startProcess(const std::string &program);
+
     public:
         std::string envDev;
         std::string envConfig;
@@ -791,6 +1069,36 @@ class LocalDvrInfo: public DvrInfo
         }
 };
 
+/* A driver built as a module (name ending in .so) that runs on a thread of indiserver.
+ * Every instance gets its own link map, so drivers do not share the globals of the libraries
+ * they use, but a crashing driver takes indiserver down with it.
+ */
+class ModuleDvrInfo: public LocalDvrInfo
+{
+        std::string modulePath() const;
+        std::vector<std::string> environment() const;
+
+        /* Modules loaded so far, each in a namespace of its own. A namespace is never loaded
+         * again, as the constructors of its globals only ran once: a driver restarted after its
+         * module returned runs as a process. Namespaces are also limited: glibc has 16 of them
+         * and a static TLS area they all share, which the drivers need for libraries they
+         * load on their own, so there are never more than MAXMODULES. */
+        static std::mutex modulesLock;
+        static std::set<std::string> modules;
+
+    protected:
+        ModuleDvrInfo(const ModuleDvrInfo &model);
+
+    public:
+        ModuleDvrInfo() = default;
+
+        virtual void start();
+
+        virtual ModuleDvrInfo * clone() const;
+
+        static bool isModule(const std::string &name);
+};
+
 class RemoteDvrInfo: public DvrInfo
 {
         /* open a connection to the given host and port or die.
@@ -880,6 +1188,13 @@ static char *ldir;                                     /* where to log driver me
 static unsigned int maxqsiz  = (DEFMAXQSIZ * 1024 * 1024); /* kill if these bytes behind */
 static unsigned int maxstreamsiz  = (DEFMAXSSIZ * 1024 * 1024); /* drop blobs if these bytes behind while streaming*/
 static int maxrestarts   = DEFMAXRESTART;
+static bool cacheprops   = true;                       /* answer client getProperties from cache */
+static int nloops        = 0;                          /* threads running extra event loops */
+static bool conflatestreams = false;                   /* conflate streaming blobs of every client */
+static bool compressremote = false;                    /* ask chained servers for compression */
+static int startupfanout = 0;                          /* drivers starting at once, 0 for all */
+static double readywait  = 0;                          /* hold new clients until drivers are ready, s */
+static std::atomic<bool> modulesLoaded {false};        /* drivers run on our threads */
 
 static std::vector<XMLEle *> findBlobElements(XMLEle * root);
 
@@ -992,6 +1307,46 @@ int main(int ac, char *av[])
                         maxrestarts = 0;
                     ac--;
                     break;
+                case 'n':
+                    cacheprops = false;
+                    break;
+                case 'c':
+                    conflatestreams = true;
+                    break;
+                case 'z':
+                    compressremote = true;
+                    break;
+                case 't':
+                    if (ac < 2)
+                    {
+                        fprintf(stderr, "-t requires number of threads\n");
+                        usage();
+                    }
+                    nloops = atoi(*++av);
+                    if (nloops < 0)
+                        nloops = 0;
+                    ac--;
+                    break;
+                case 's':
+                    if (ac < 2)
+                    {
+                        fprintf(stderr, "-s requires number of drivers\n");
+                        usage();
+                    }
+                    startupfanout = atoi(*++av);
+                    if (startupfanout < 0)
+                        startupfanout = 0;
+                    ac--;
+                    break;
+                case 'w':
+                    if (ac < 2)
+                    {
+                        fprintf(stderr, "-w requires seconds to wait\n");
+                        usage();
+                    }
+                    readywait = atof(*++av);
+                    ac--;
+                    break;
                 case 'v':
                     verbose++;
                     break;
@@ -1008,6 +1363,12 @@ int main(int ac, char *av[])
     /* take care of some unixisms */
     noSIGPIPE();
 
+    /* loops serving the connections, they start running once everything is set up */
+    IoLoop::main = new IoLoop(loop);
+    for (int i = 0; i < nloops; i++)
+        IoLoop::workers.push_back(new IoLoop(ev_loop_new(EVFLAG_AUTO)));
+    serverLock.lock();
+
     /* start each driver */
     while (ac-- > 0)
     {
@@ -1017,12 +1378,16 @@ int main(int ac, char *av[])
         {
             dr = new RemoteDvrInfo();
         }
+        else if (ModuleDvrInfo::isModule(dvrName))
+        {
+            dr = new ModuleDvrInfo();
+        }
         else
         {
             dr = new LocalDvrInfo();
         }
         dr->name = dvrName;
-        dr->start();
+        dr->launch();
     }
 
     /* announce we are online */
@@ -1043,6 +1408,8 @@ int main(int ac, char *av[])
     }
 
     /* handle new clients and all io */
+    for (auto worker : IoLoop::workers)
+        worker->spawn();
     loop.loop();
 
     /* will not happen unless no more listener left ! */
@@ -1083,10 +1450,17 @@ static void usage(void)
     fprintf(stderr, " -p p     : alternate IP port, default %d\n", INDIPORT);
     fprintf(stderr, " -r r     : maximum driver restarts on error, default %d\n", DEFMAXRESTART);
     fprintf(stderr, " -f path  : Path to fifo for dynamic startup and shutdown of drivers.\n");
+    fprintf(stderr, " -n       : forward client getProperties to drivers instead of answering from cache\n");
+    fprintf(stderr, " -c       : send clients only the latest queued frame of streaming blobs\n");
+    fprintf(stderr, " -z       : ask remote drivers (chained servers) for a compressed connection\n");
+    fprintf(stderr, " -t n     : spread connections over n event loop threads, default 0 (all on main thread)\n");
+    fprintf(stderr, " -s n     : start at most n drivers at once, the next when one is ready, default 0 (all at once)\n");
+    fprintf(stderr, " -w s     : hold clients until all drivers are ready, at most s seconds, default 0 (no wait)\n");
     fprintf(stderr, " -v       : show key events, no traffic\n");
     fprintf(stderr, " -vv      : -v + key message content\n");
     fprintf(stderr, " -vvv     : -vv + complete xml\n");
-    fprintf(stderr, "driver    : executable or [device]@host[:port]\n");
+    fprintf(stderr, "driver    : executable, module.so or [device]@host[:port]\n");
+    fprintf(stderr, "            a module runs on a thread of indiserver, past a dozen modules its executable is run\n");
 
     exit(2);
 }
@@ -1101,10 +1475,75 @@ static void noSIGPIPE()
     (void)sigaction(SIGPIPE, &sa, NULL);
 }
 
+IoLoop::IoLoop(struct ev_loop *loop) : loop(loop), threadId(std::this_thread::get_id())
+{
+    ev_set_loop_release_cb(loop, &IoLoop::release, &IoLoop::acquire);
+
+    wakeup.set(loop);
+    wakeup.set<IoLoop, &IoLoop::onWakeup>(this);
+    wakeup.start();
+    /* the default loop must still return once no connection is left */
+    if (ev_is_default_loop(loop))
+        ev_unref(loop);
+}
+
+void IoLoop::release(struct ev_loop *)  noexcept
+{
+    serverLock.unlock();
+}
+
+void IoLoop::acquire(struct ev_loop *) noexcept
+{
+    serverLock.lock();
+}
+
+void IoLoop::onWakeup(ev::async &, int)
+{
+    /* nothing to do, the loop already took the new watchers into account */
+}
+
+bool IoLoop::isCurrent() const
+{
+    return threadId == std::this_thread::get_id();
+}
+
+void IoLoop::wake()
+{
+    if (!isCurrent())
+        wakeup.send();
+}
+
+void IoLoop::spawn()
+{
+    threadId = std::thread::id();
+    std::thread([this]()
+    {
+        std::lock_guard<std::mutex> guard(serverLock);
+        threadId = std::this_thread::get_id();
+        ev_run(loop, 0);
+        log("unexpected return from worker event loop\n");
+    }).detach();
+}
+
+IoLoop * IoLoop::assign()
+{
+    static size_t next = 0;
+
+    if (workers.empty())
+        return main;
+
+    return workers[next++ % workers.size()];
+}
+
 /* start the given local INDI driver process.
  * exit if trouble.
  */
 void LocalDvrInfo::start()
+{
+    startProcess(name);
+}
+
+void LocalDvrInfo::startProcess(const std::string &program)
 {
     Msg *mp;
     int rp[2], wp[2], ep[2];
@@ -1112,7 +1551,7 @@ void LocalDvrInfo::start()
     int pid;
 
 #ifdef OSX_EMBEDED_MODE
-    fprintf(stderr, "STARTING \"%s\"\n", name.c_str());
+    fprintf(stderr, "STARTING \"%s\"\n", program.c_str());
     fflush(stderr);
 #endif
 
@@ -1154,7 +1593,7 @@ void LocalDvrInfo::start()
     }
     if (pid == 0)
     {
-        /* child: exec name */
+        /* child: exec program */
         int fd;
 
         /* rig up pipes */
@@ -1193,32 +1632,32 @@ void LocalDvrInfo::start()
         {
             setenv("INDIPREFIX", envPrefix.c_str(), 1);
 #if defined(OSX_EMBEDED_MODE)
-            executable = envPrefix + "/Contents/MacOS/" + name;
+            executable = envPrefix + "/Contents/MacOS/" + program;
 #elif defined(__APPLE__)
-            executable = envPrefix + "/" + name;
+            executable = envPrefix + "/" + program;
 #else
-            executable = envPrefix + "/bin/" + name;
+            executable = envPrefix + "/bin/" + program;
 #endif
 
             fprintf(stderr, "%s\n", executable.c_str());
 
-            execlp(executable.c_str(), name.c_str(), NULL);
+            execlp(executable.c_str(), program.c_str(), NULL);
         }
         else
         {
-            if (name[0] == '.')
+            if (program[0] == '.')
             {
-                executable = std::string(dirname((char*)me)) + "/" + name;
-                execlp(executable.c_str(), name.c_str(), NULL);
+                executable = std::string(dirname((char*)me)) + "/" + program;
+                execlp(executable.c_str(), program.c_str(), NULL);
             }
             else
             {
-                execlp(name.c_str(), name.c_str(), NULL);
+                execlp(program.c_str(), program.c_str(), NULL);
             }
         }
 
 #ifdef OSX_EMBEDED_MODE
-        fprintf(stderr, "FAILED \"%s\"\n", name.c_str());
+        fprintf(stderr, "FAILED \"%s\"\n", program.c_str());
         fflush(stderr);
 #endif
         log(fmt("execlp %s: %s\n", executable.c_str(), strerror(errno)));
@@ -1256,6 +1695,8 @@ void LocalDvrInfo::start()
     this->efd = ep[0];
     fcntl(this->efd, F_SETFL, fcntl(this->efd, F_GETFL, 0) | O_NONBLOCK);
     this->eio.start(this->efd, ev::READ);
+    /* restarted from a worker loop */
+    IoLoop::main->wake();
 
     /* first message primes driver to report its properties -- dev known
      * if restarting
@@ -1337,6 +1778,12 @@ void RemoteDvrInfo::start()
         addXMLAtt(root, "version", TO_STRING(INDIV));
     }
 
+    if (compressremote)
+    {
+        addXMLAtt(root, "compression", INDI::TransportCompression);
+        requestCompression();
+    }
+
     Msg *mp = new Msg(nullptr, root);
 
     // pushmsg can kill this. do at end
@@ -1760,7 +2207,7 @@ void Fifo::processLine(const char * line)
         DvrInfo * dp;
         if (remoteDriver == 0)
         {
-            auto * localDp = new LocalDvrInfo();
+            auto * localDp = ModuleDvrInfo::isModule(tDriver) ? new ModuleDvrInfo() : new LocalDvrInfo();
             dp = localDp;
             //strncpy(dp->dev, tName, MAXINDIDEVICE);
             localDp->envDev = tName;
@@ -1773,7 +2220,7 @@ void Fifo::processLine(const char * line)
             dp = new RemoteDvrInfo();
         }
         dp->name = tDriver;
-        dp->start();
+        dp->launch();
     }
     else
     {
@@ -1866,6 +2313,10 @@ void Fifo::ioCb(ev::io &, int revents)
 // root will be released
 void ClInfo::onMessage(XMLEle * root, std::list<int> &sharedBuffers)
 {
+    /* let the drivers define everything before asking them */
+    if (holdUntilReady(root, sharedBuffers))
+        return;
+
     char *roottag    = tagXMLEle(root);
 
     const char *dev  = findXMLAttValu(root, "device");
@@ -1888,9 +2339,17 @@ void ClInfo::onMessage(XMLEle * root, std::list<int> &sharedBuffers)
     else if (!strcmp(roottag, "getProperties") && !this->props.size() && this->allprops != 2)
         this->allprops = 1;
 
+    /* negotiate compression, drivers do not need to know */
+    if (!strcmp(roottag, "getProperties") && findXMLAtt(root, "compression"))
+    {
+        if (!strcmp(findXMLAttValu(root, "compression"), INDI::TransportCompression) && compressionPossible())
+            acceptCompression();
+        rmXMLAtt(root, "compression");
+    }
+
     /* snag enableBLOB -- send to remote drivers too */
     if (!strcmp(roottag, "enableBLOB"))
-        crackBLOBHandling(dev, name, pcdataXMLEle(root));
+        crackBLOBHandling(dev, name, pcdataXMLEle(root), findXMLAttValu(root, "conflate"));
 
     if (!strcmp(roottag, "pingRequest"))
     {
@@ -1912,7 +2371,7 @@ void ClInfo::onMessage(XMLEle * root, std::list<int> &sharedBuffers)
     }
 
     /* send message to driver(s) responsible for dev */
-    DvrInfo::q2RDrivers(dev, mp, root);
+    DvrInfo::q2RDrivers(dev, mp, root, this);
 
     /* JM 2016-05-18: Upstream client can be a chained INDI server. If any driver locally is snooping
     * on any remote drivers, we should catch it and forward it to the responsible snooping driver. */
@@ -1945,6 +2404,22 @@ void DvrInfo::onMessage(XMLEle * root, std::list<int> &sharedBuffers)
                 tagXMLEle(root), findXMLAttValu(root, "device"), findXMLAttValu(root, "name")));
     }
 
+    /* answer to the ping sent at launch, the driver has defined its properties */
+    if (!strcmp(roottag, "pingReply") && !strcmp(findXMLAttValu(root, "uid"), READYPINGUID))
+    {
+        setReady("answered");
+        delXMLEle(root);
+        return;
+    }
+
+    /* otherwise wait for the definitions to stop, but not past the timeout */
+    if (started && !ready && !strncmp(roottag, "def", 3))
+    {
+        defined = true;
+        double left = STARTUPTIMEOUT - std::chrono::duration<double>(std::chrono::steady_clock::now() - launched).count();
+        startReadyTimer(std::max(0.0, std::min(STARTUPQUIET, left)));
+    }
+
     /* that's all if driver is just registering a snoop */
     /* JM 2016-05-18: Send getProperties to upstream chained servers as well.*/
     if (!strcmp(roottag, "getProperties"))
@@ -1984,6 +2459,10 @@ void DvrInfo::onMessage(XMLEle * root, std::list<int> &sharedBuffers)
         this->dev.insert(dev);
     }
 
+    /* keep the latest state of every property to answer getProperties */
+    if (cacheprops)
+        propertyCache.update(root);
+
     /* log messages if any and wanted */
     if (ldir)
         logDMsg(root, dev);
@@ -2024,8 +2503,20 @@ void DvrInfo::closeWritePart()
 
 void ClInfo::close()
 {
+    dropHeld();
+
+    if (deferClose())
+    {
+        /* no more messages for this client */
+        clients.erase(this);
+        return;
+    }
+
     if (verbose > 0)
+    {
+        logCompression();
         log("shut down complete - bye!\n");
+    }
 
     delete(this);
 
@@ -2037,6 +2528,15 @@ void ClInfo::close()
 
 void DvrInfo::close()
 {
+    if (deferClose())
+    {
+        drivers.erase(this);
+        return;
+    }
+
+    if (verbose > 0)
+        logCompression();
+
     // Tell client driver is dead.
     for (auto dev : dev)
     {
@@ -2088,13 +2588,38 @@ void DvrInfo::close()
     {
         DvrInfo * restarted = this->clone();
         delete(this);
-        restarted->start();
+        restarted->launch();
+    }
+}
+
+bool DvrInfo::replyFromCache(ClInfo *cp, const std::string &dev, const std::string &name)
+{
+    /* chained servers keep their own cache and deal with their own snoopers */
+    if (!cacheprops || !remoteServerUid().empty())
+        return false;
+
+    /* the driver would only reply with definitions, which are not for BLOB only clients */
+    if (cp->blob == B_ONLY)
+        return true;
+
+    for (auto def : propertyCache.definitions(dev[0] == '*' ? "" : dev, name))
+    {
+        if (verbose > 1)
+            cp->log(fmt("queuing cached <%s device='%s' name='%s'>\n",
+                        tagXMLEle(def), findXMLAttValu(def, "device"), findXMLAttValu(def, "name")));
+
+        Msg *mp = new Msg(nullptr, cloneXMLEle(def, nullptr, nullptr));
+        cp->pushMsg(mp);
+        mp->queuingDone();
     }
+
+    return true;
 }
 
-void DvrInfo::q2RDrivers(const std::string &dev, Msg *mp, XMLEle *root)
+void DvrInfo::q2RDrivers(const std::string &dev, Msg *mp, XMLEle *root, ClInfo *requester)
 {
     char *roottag = tagXMLEle(root);
+    bool getProperties = requester && !strcmp(roottag, "getProperties");
 
     /* queue message to each interested driver.
      * N.B. don't send generic getProps to more than one remote driver,
@@ -2129,6 +2654,10 @@ void DvrInfo::q2RDrivers(const std::string &dev, Msg *mp, XMLEle *root)
         if (isRemote == 0 && !strcmp(roottag, "enableBLOB"))
             continue;
 
+        /* the driver does not need to define everything again if its cache can answer */
+        if (getProperties && dp->replyFromCache(requester, dev, findXMLAttValu(root, "name")))
+            continue;
+
         /* ok: queue message to this driver */
         if (verbose > 1)
         {
@@ -2244,31 +2773,12 @@ void ClInfo::q2Clients(ClInfo *notme, int isblob, const std::string &dev, const
 
         /* shut down this client if its q is already too large */
         unsigned long ql = cp->msgQSize();
-        if (isblob && maxstreamsiz > 0 && ql > maxstreamsiz)
+        if (isblob && maxstreamsiz > 0 && ql > maxstreamsiz && mp->isStream() && !cp->conflates(dev, name))
         {
             // Drop frames for streaming blobs
-            /* pull out each name/BLOB pair, decode */
-            XMLEle *ep      = NULL;
-            int streamFound = 0;
-            for (ep = nextXMLEle(root, 1); ep; ep = nextXMLEle(root, 0))
-            {
-                if (strcmp(tagXMLEle(ep), "oneBLOB") == 0)
-                {
-                    XMLAtt *fa = findXMLAtt(ep, "format");
-
-                    if (fa && strstr(valuXMLAtt(fa), "stream"))
-                    {
-                        streamFound = 1;
-                        break;
-                    }
-                }
-            }
-            if (streamFound)
-            {
-                if (verbose > 1)
-                    cp->log(fmt("%ld bytes behind. Dropping stream BLOB...\n", ql));
-                continue;
-            }
+            if (verbose > 1)
+                cp->log(fmt("%ld bytes behind. Dropping stream BLOB...\n", ql));
+            continue;
         }
         if (ql > maxqsiz)
         {
@@ -2354,6 +2864,13 @@ void MsgQueue::writeToFd()
     ssize_t nsend;
     std::vector<int> sharedBuffers;
 
+    /* compressed bytes of previous messages go first */
+    if (deflatedSent < deflated.size())
+    {
+        writeDeflated();
+        return;
+    }
+
     /* get current message */
     auto mp = headMsg();
     if (mp == nullptr)
@@ -2387,9 +2904,47 @@ void MsgQueue::writeToFd()
     if (nsend > MAXWSIZ)
         nsend = MAXWSIZ;
 
+    if (deflater)
+    {
+        bool compressed;
+        {
+            Unlocked unlocked(*this);
+            compressed = deflater->compress(data, nsend, deflated);
+        }
+
+        if (closeRequested)
+        {
+            close();
+            return;
+        }
+
+        if (!compressed)
+        {
+            log("compression failed\n");
+            closeWritePart();
+            return;
+        }
+
+        if (verbose > 2)
+            log(fmt("compressing msg nq %ld:\n%.*s\n", msgq.size(), (int)nsend, data));
+        else if (verbose > 1)
+            log(fmt("compressing %.*s\n", (int)nsend, data));
+
+        /* the whole chunk is in the compressed stream */
+        mp->advance(nsent, nsend);
+        if (nsent.done())
+            consumeHeadMsg();
+
+        writeDeflated();
+        return;
+    }
+
+    int writeErrno;
     if (!useSharedBuffer)
     {
+        Unlocked unlocked(*this);
         nw = write(wFd, data, nsend);
+        writeErrno = errno;
     }
     else
     {
@@ -2441,18 +2996,29 @@ void MsgQueue::writeToFd()
         msgh.msg_iov = iov;
         msgh.msg_iovlen = 1;
 
-        nw = sendmsg(wFd, &msgh,  MSG_NOSIGNAL);
+        {
+            Unlocked unlocked(*this);
+            nw = sendmsg(wFd, &msgh,  MSG_NOSIGNAL);
+            writeErrno = errno;
+        }
 
         free(cmsgh);
     }
 
+    /* closed by another loop meanwhile */
+    if (closeRequested)
+    {
+        close();
+        return;
+    }
+
     /* shut down if trouble */
     if (nw <= 0)
     {
         if (nw == 0)
             log("write returned 0\n");
         else
-            log(fmt("write: %s\n", strerror(errno)));
+            log(fmt("write: %s\n", strerror(writeErrno)));
 
         // Keep the read part open
         closeWritePart();
@@ -2478,14 +3044,185 @@ void MsgQueue::writeToFd()
         consumeHeadMsg();
 }
 
-void MsgQueue::log(const std::string &str) const
+void MsgQueue::writeDeflated()
 {
-    // This is only invoked from destructor
-    std::string logLine = "Dying Connection ";
-    logLine += ": ";
-    logLine += str;
-    ::log(logLine);
-}
+    ssize_t nw;
+    int writeErrno;
+    {
+        Unlocked unlocked(*this);
+        nw = write(wFd, deflated.data() + deflatedSent, deflated.size() - deflatedSent);
+        writeErrno = errno;
+    }
+
+    /* closed by another loop meanwhile */
+    if (closeRequested)
+    {
+        close();
+        return;
+    }
+
+    if (nw <= 0)
+    {
+        if (nw < 0 && (writeErrno == EAGAIN || writeErrno == EWOULDBLOCK))
+            return;
+
+        if (nw == 0)
+            log("write returned 0\n");
+        else
+            log(fmt("write: %s\n", strerror(writeErrno)));
+
+        // Keep the read part open
+        closeWritePart();
+        return;
+    }
+
+    deflatedSent += nw;
+    if (deflatedSent == deflated.size())
+    {
+        deflated.clear();
+        deflatedSent = 0;
+    }
+
+    if (verbose > 0 && deflater->statistics.plainBytes >= nextCompressionReport)
+    {
+        nextCompressionReport = deflater->statistics.plainBytes + COMPRESSION_REPORT;
+        logCompression();
+    }
+
+    updateIos();
+}
+
+void MsgQueue::acceptCompression()
+{
+    if (verbose > 0)
+        log(fmt("using %s compression\n", INDI::TransportCompression));
+
+    queueCompressionStart();
+    inflateWait = INFLATE_ACCEPTED;
+}
+
+void MsgQueue::requestCompression()
+{
+    if (!useSharedBuffer)
+        inflateWait = INFLATE_REQUESTED;
+}
+
+void MsgQueue::queueCompressionStart()
+{
+    XMLEle *root = addXMLEle(NULL, "compression");
+    addXMLAtt(root, "format", INDI::TransportCompression);
+
+    Msg *mp = new Msg(nullptr, root);
+    pushMsg(mp);
+    if (!msgq.empty() && msgq.back()->message() == mp)
+        deflateAfter = msgq.back();
+    mp->queuingDone();
+}
+
+XMLEle ** MsgQueue::parseInput(char * buf, size_t nr, char * err)
+{
+    std::vector<XMLEle *> nodes;
+    size_t pos = 0;
+    bool ok = true;
+
+    auto append = [&nodes](XMLEle ** some)
+    {
+        for (int i = 0; some[i]; i++)
+            nodes.push_back(some[i]);
+        free(some);
+    };
+
+    while (ok && inflateWait != INFLATE_NONE && pos < nr)
+    {
+        XMLEle ** some = parseXMLChunk(lp, buf + pos, 1, err);
+        pos++;
+        if (!some)
+        {
+            ok = false;
+            break;
+        }
+
+        for (int i = 0; some[i]; i++)
+        {
+            if (!strcmp(tagXMLEle(some[i]), "compression") &&
+                    !strcmp(findXMLAttValu(some[i], "format"), INDI::TransportCompression))
+            {
+                /* what follows is compressed, the requester answers with its own switch */
+                /* a single byte completes at most one element */
+                delXMLEle(some[i]);
+                some[i] = nullptr;
+                answerCompression = (inflateWait == INFLATE_REQUESTED);
+                inflater.reset(new INDI::Inflater());
+                inflateWait = INFLATE_NONE;
+                break;
+            }
+            /* a peer not supporting compression answered */
+            if (inflateWait == INFLATE_REQUESTED)
+                inflateWait = INFLATE_NONE;
+        }
+        append(some);
+    }
+
+    if (ok && pos < nr)
+    {
+        XMLEle ** some;
+        if (inflater)
+        {
+            std::string plain;
+            if (inflater->decompress(buf + pos, nr - pos, plain))
+                some = parseXMLChunk(lp, &plain[0], plain.size(), err);
+            else
+            {
+                snprintf(err, 1024, "corrupted compressed stream");
+                some = nullptr;
+            }
+        }
+        else
+            some = parseXMLChunk(lp, buf + pos, nr - pos, err);
+
+        if (some)
+            append(some);
+        else
+            ok = false;
+    }
+
+    if (!ok)
+    {
+        for (auto node : nodes)
+            delXMLEle(node);
+        return nullptr;
+    }
+
+    XMLEle ** result = (XMLEle **)malloc((nodes.size() + 1) * sizeof(XMLEle *));
+    std::copy(nodes.begin(), nodes.end(), result);
+    result[nodes.size()] = nullptr;
+    return result;
+}
+
+void MsgQueue::logCompression() const
+{
+    if (deflater)
+    {
+        auto &st = deflater->statistics;
+        log(fmt("compressed %llu bytes to %llu, ratio %.2f, %.3f s cpu\n", (unsigned long long)st.plainBytes,
+                (unsigned long long)st.compressedBytes, st.ratio(), st.cpuSeconds));
+    }
+    if (inflater)
+    {
+        auto &st = inflater->statistics;
+        log(fmt("decompressed %llu bytes to %llu, ratio %.2f, %.3f s cpu\n", (unsigned long long)st.compressedBytes,
+                (unsigned long long)st.plainBytes, st.ratio(), st.cpuSeconds));
+    }
+}
+
+void MsgQueue::log(const std::string &str) const
+{
+    // This is only invoked from destructor
+    std::string logLine = "Dying Connection ";
+    logLine += ": ";
+    logLine += str;
+    ::log(logLine);
+}
 
 int ClInfo::findDevice(const std::string &dev, const std::string &name) const
 {
@@ -2515,6 +3252,7 @@ void ClInfo::addDevice(const std::string &dev, const std::string &name, int isbl
 
     /* add */
     Property *pp = new Property(dev, name);
+    pp->conflate = conflate;
     props.push_back(pp);
 }
 
@@ -2528,29 +3266,55 @@ void MsgQueue::crackBLOB(const char *enableBLOB, BLOBHandling *bp)
         *bp = B_NEVER;
 }
 
-void ClInfo::crackBLOBHandling(const std::string &dev, const std::string &name, const char *enableBLOB)
+void ClInfo::crackBLOBHandling(const std::string &dev, const std::string &name, const char *enableBLOB,
+                               const char *conflate)
 {
     /* If we have EnableBLOB with property name, we add it to Client device list */
     if (!name.empty())
         addDevice(dev, name, 1);
     else
+    {
         /* Otherwise, we set the whole client blob handling to what's passed (enableBLOB) */
         crackBLOB(enableBLOB, &blob);
+        crackConflate(conflate, &this->conflate);
+    }
 
     /* If whole client blob handling policy was updated, we need to pass that also to all children
        and if the request was for a specific property, then we apply the policy to it */
     for (auto pp : props)
     {
         if (name.empty())
+        {
             crackBLOB(enableBLOB, &pp->blob);
+            crackConflate(conflate, &pp->conflate);
+        }
         else if (pp->dev == dev && pp->name == name)
         {
             crackBLOB(enableBLOB, &pp->blob);
+            crackConflate(conflate, &pp->conflate);
             return;
         }
     }
 }
 
+void ClInfo::crackConflate(const char *conflate, bool *cp)
+{
+    if (!strcmp(conflate, "On"))
+        *cp = true;
+    else if (!strcmp(conflate, "Off"))
+        *cp = false;
+}
+
+bool ClInfo::conflates(const std::string &dev, const std::string &name) const
+{
+    for (auto pp : props)
+    {
+        if (pp->dev == dev && pp->name == name)
+            return pp->conflate;
+    }
+    return conflate;
+}
+
 void MsgQueue::traceMsg(const std::string &logMsg, XMLEle *root)
 {
     log(logMsg);
@@ -2639,6 +3403,9 @@ static void logDMsg(XMLEle *root, const char *dev)
 static void Bye()
 {
     fprintf(stderr, "%s: good bye\n", indi_tstamp(NULL));
+    /* static destructors of driver modules would run under their still running threads */
+    if (modulesLoaded)
+        _exit(1);
     exit(1);
 }
 
@@ -2646,6 +3413,7 @@ DvrInfo::DvrInfo(bool useSharedBuffer) :
     MsgQueue(useSharedBuffer),
     restarts(0)
 {
+    readyTimer.set<DvrInfo, &DvrInfo::onReadyTimer>(this);
     drivers.insert(this);
 }
 
@@ -2654,18 +3422,130 @@ DvrInfo::DvrInfo(const DvrInfo &model):
     name(model.name),
     restarts(model.restarts)
 {
+    readyTimer.set<DvrInfo, &DvrInfo::onReadyTimer>(this);
     drivers.insert(this);
 }
 
 DvrInfo::~DvrInfo()
 {
     drivers.erase(this);
+    launchQueue.remove(this);
+    readyTimer.stop();
     for(auto prop : sprops)
     {
         delete prop;
     }
+
+    /* leaves room for the next driver to start */
+    if (started && !ready)
+        startupProgressed();
+}
+
+void DvrInfo::launch()
+{
+    /* readiness only matters to -s and -w, do not ping drivers otherwise */
+    if (startupfanout <= 0 && readywait <= 0)
+    {
+        started = ready = true;
+        start();
+        return;
+    }
+
+    if (startupfanout > 0 && startingDrivers() >= startupfanout)
+    {
+        if (verbose > 0)
+            log(fmt("waiting for one of %d starting drivers to be ready\n", startupfanout));
+        launchQueue.push_back(this);
+        return;
+    }
+
+    started = true;
+    launched = std::chrono::steady_clock::now();
+    startReadyTimer(STARTUPTIMEOUT);
+
+    auto hb = heartBeat();
+    start();
+    if (!hb.alive())
+        return;
+
+    /* handled after getProperties, the reply comes once every property is defined */
+    XMLEle *root = addXMLEle(NULL, "pingRequest");
+    addXMLAtt(root, "uid", READYPINGUID);
+    Msg *mp = new Msg(nullptr, root);
+
+    // pushmsg can kill this. do at end
+    pushMsg(mp);
+}
+
+void DvrInfo::startReadyTimer(double after)
+{
+    /* the main loop may have slept for long, its clock must be current for the timer to last after seconds */
+    ev_now_update(loop);
+    readyTimer.start(after);
+    IoLoop::main->wake();
 }
 
+void DvrInfo::onReadyTimer(ev::timer &, int)
+{
+    setReady(defined ? "quiet after its definitions" : "timed out");
+}
+
+void DvrInfo::setReady(const char *how)
+{
+    if (ready)
+        return;
+
+    ready = true;
+    readyTimer.stop();
+    log(fmt("ready %.3f s after start (%s)\n",
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - launched).count(), how));
+
+    startupProgressed();
+}
+
+void DvrInfo::startupProgressed()
+{
+    while (!launchQueue.empty() && (startupfanout <= 0 || startingDrivers() < startupfanout))
+    {
+        DvrInfo *dp = launchQueue.front();
+        launchQueue.pop_front();
+        dp->launch();
+    }
+
+    if (allReady())
+        ClInfo::driversReady();
+}
+
+int DvrInfo::startingDrivers()
+{
+    int starting = 0;
+    for (auto dp : drivers)
+    {
+        if (dp == nullptr) continue;
+
+        if (dp->started && !dp->ready)
+            starting++;
+    }
+    return starting;
+}
+
+bool DvrInfo::allReady()
+{
+    if (!launchQueue.empty())
+        return false;
+
+    for (auto dp : drivers)
+    {
+        if (dp == nullptr) continue;
+
+        if (!dp->ready)
+            return false;
+    }
+    return true;
+}
+
+std::list<DvrInfo *> DvrInfo::launchQueue;
+
 bool DvrInfo::isHandlingDevice(const std::string &dev) const
 {
     return this->dev.find(dev) != this->dev.end();
@@ -2682,6 +3562,127 @@ void DvrInfo::log(const std::string &str) const
 
 ConcurrentSet<DvrInfo> DvrInfo::drivers;
 
+PropertyCache::~PropertyCache()
+{
+    for (auto def : defs)
+        delXMLEle(def);
+}
+
+void PropertyCache::update(XMLEle *root)
+{
+    const char *roottag = tagXMLEle(root);
+
+    if (!strncmp(roottag, "def", 3))
+        define(root);
+    else if (!strncmp(roottag, "set", 3))
+        set(root);
+    else if (!strcmp(roottag, "delProperty"))
+        remove(findXMLAttValu(root, "device"), findXMLAttValu(root, "name"));
+}
+
+void PropertyCache::define(XMLEle *root)
+{
+    XMLEle *def = cloneXMLEle(root, nullptr, nullptr);
+    /* the message was for the clients connected at that time */
+    rmXMLAtt(def, "message");
+
+    Key key(findXMLAttValu(root, "device"), findXMLAttValu(root, "name"));
+    auto found = index.find(key);
+    if (found != index.end())
+    {
+        /* redefined in place, keep the original order */
+        delXMLEle(*found->second);
+        *found->second = def;
+        return;
+    }
+
+    index[key] = defs.insert(defs.end(), def);
+}
+
+void PropertyCache::set(XMLEle *root)
+{
+    auto found = index.find(Key(findXMLAttValu(root, "device"), findXMLAttValu(root, "name")));
+    if (found == index.end())
+        return;
+
+    XMLEle *def = *found->second;
+
+    /* vector state, timeout and timestamp */
+    for (XMLAtt *ap = nextXMLAtt(root, 1); ap; ap = nextXMLAtt(root, 0))
+    {
+        if (!strcmp(nameXMLAtt(ap), "message"))
+            continue;
+
+        XMLAtt *defap = findXMLAtt(def, nameXMLAtt(ap));
+        if (defap)
+            editXMLAtt(defap, valuXMLAtt(ap));
+        else
+            addXMLAtt(def, nameXMLAtt(ap), valuXMLAtt(ap));
+    }
+
+    /* BLOB contents are never cached, a definition does not carry any */
+    if (!strcmp(tagXMLEle(root), "setBLOBVector"))
+        return;
+
+    /* element values, and limits if a number changed them. oneXXX matches defXXX */
+    for (XMLEle *ep = nextXMLEle(root, 1); ep; ep = nextXMLEle(root, 0))
+    {
+        const char *elemName = findXMLAttValu(ep, "name");
+        XMLEle *defep = nullptr;
+
+        for (defep = nextXMLEle(def, 1); defep; defep = nextXMLEle(def, 0))
+        {
+            if (!strcmp(tagXMLEle(defep) + 3, tagXMLEle(ep) + 3) && !strcmp(findXMLAttValu(defep, "name"), elemName))
+                break;
+        }
+
+        if (!defep)
+            continue;
+
+        editXMLEle(defep, pcdataXMLEle(ep));
+        for (XMLAtt *ap = nextXMLAtt(ep, 1); ap; ap = nextXMLAtt(ep, 0))
+        {
+            XMLAtt *defap = findXMLAtt(defep, nameXMLAtt(ap));
+            if (defap)
+                editXMLAtt(defap, valuXMLAtt(ap));
+            else
+                addXMLAtt(defep, nameXMLAtt(ap), valuXMLAtt(ap));
+        }
+    }
+}
+
+void PropertyCache::remove(const std::string &dev, const std::string &name)
+{
+    for (auto it = index.begin(); it != index.end();)
+    {
+        if (it->first.first != dev || (!name.empty() && it->first.second != name))
+        {
+            ++it;
+            continue;
+        }
+
+        delXMLEle(*it->second);
+        defs.erase(it->second);
+        it = index.erase(it);
+    }
+}
+
+std::vector<XMLEle *> PropertyCache::definitions(const std::string &dev, const std::string &name) const
+{
+    std::vector<XMLEle *> result;
+
+    for (auto def : defs)
+    {
+        if (!dev.empty() && dev != findXMLAttValu(def, "device"))
+            continue;
+        if (!name.empty() && name != findXMLAttValu(def, "name"))
+            continue;
+        result.push_back(def);
+    }
+
+    return result;
+}
+
 LocalDvrInfo::LocalDvrInfo(): DvrInfo(true)
 {
     eio.set<LocalDvrInfo, &LocalDvrInfo::onEfdEvent>(this);
@@ -2715,6 +3716,146 @@ LocalDvrInfo * LocalDvrInfo::clone() const
     return new LocalDvrInfo(*this);
 }
 
+bool ModuleDvrInfo::isModule(const std::string &name)
+{
+    return name.size() > 3 && name.compare(name.size() - 3, 3, ".so") == 0;
+}
+
+ModuleDvrInfo::ModuleDvrInfo(const ModuleDvrInfo &model): LocalDvrInfo(model)
+{
+}
+
+ModuleDvrInfo * ModuleDvrInfo::clone() const
+{
+    return new ModuleDvrInfo(*this);
+}
+
+std::mutex ModuleDvrInfo::modulesLock;
+std::set<std::string> ModuleDvrInfo::modules;
+
+std::string ModuleDvrInfo::modulePath() const
+{
+    if (!envPrefix.empty())
+        return envPrefix + "/lib/indi/modules/" + name;
+
+    if (name[0] == '.')
+    {
+        std::string self = me;
+        return std::string(dirname(&self[0])) + "/" + name;
+    }
+
+#ifdef INDI_MODULE_DIR
+    std::string installed = std::string(INDI_MODULE_DIR) + "/" + name;
+    if (name.find('/') == std::string::npos && access(installed.c_str(), R_OK) == 0)
+        return installed;
+#endif
+
+    /* dlmopen searches LD_LIBRARY_PATH for bare names */
+    return name;
+}
+
+/* the environment a driver process would get, see LocalDvrInfo::startProcess */
+std::vector<std::string> ModuleDvrInfo::environment() const
+{
+    std::vector<std::string> env;
+    for (char **var = environ; *var != nullptr; var++)
+        env.push_back(*var);
+
+    auto setEnv = [&env](const std::string &var, const std::string &value, bool reset)
+    {
+        if (value.empty() && !reset)
+            return;
+        env.erase(std::remove_if(env.begin(), env.end(), [&var](const std::string &entry)
+        {
+            return entry.compare(0, var.size() + 1, var + "=") == 0;
+        }), env.end());
+        if (!value.empty())
+            env.push_back(var + "=" + value);
+    };
+
+    /* Only reset environment variable in case of FIFO */
+    setEnv("INDIDEV", envDev, fifo != nullptr);
+    setEnv("INDICONFIG", envConfig, fifo != nullptr);
+    setEnv("INDISKEL", envSkel, fifo != nullptr);
+    setEnv("INDIPREFIX", envPrefix, false);
+    return env;
+}
+
+void ModuleDvrInfo::start()
+{
+    std::string program = name.substr(0, name.size() - 3);
+
+#ifdef HAVE_DRIVER_MODULES
+    typedef int (*ModuleMain)(int fd, const char *name, char *const env[]);
+
+    std::string path = modulePath();
+
+    /* never unloaded: threads of a stopped driver may still be running */
+    void *handle = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(modulesLock);
+        if (modules.count(path))
+            log(fmt("module %s loaded already\n", path.c_str()));
+        else if (modules.size() >= MAXMODULES)
+            log(fmt("%d modules loaded already\n", MAXMODULES));
+        else if ((handle = dlmopen(LM_ID_NEWLM, path.c_str(), RTLD_NOW | RTLD_LOCAL)) == nullptr)
+            log(fmt("%s\n", dlerror()));
+        else
+            modules.insert(path);
+    }
+    ModuleMain moduleMain = nullptr;
+    if (handle != nullptr && (moduleMain = reinterpret_cast<ModuleMain>(dlsym(handle, "indiDriverModuleMain"))) == nullptr)
+        log(fmt("%s: no indiDriverModuleMain\n", path.c_str()));
+
+    if (moduleMain != nullptr)
+    {
+        int ux[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, ux) == -1)
+        {
+            log(fmt("socketpair: %s\n", strerror(errno)));
+            Bye();
+        }
+
+        std::string driverName = program.substr(program.find_last_of('/') + 1);
+        std::thread([moduleMain, driverName, fd = ux[0], env = environment()]()
+        {
+            std::vector<char *> envp;
+            for (auto &var : env)
+                envp.push_back(const_cast<char *>(var.c_str()));
+            envp.push_back(nullptr);
+
+            moduleMain(fd, driverName.c_str(), envp.data());
+
+            /* let indiserver see EOF. The descriptor stays open, so late writes of
+             * other driver threads fail instead of landing on a reused descriptor. */
+            shutdown(fd, SHUT_RDWR);
+        }).detach();
+        modulesLoaded = true;
+
+        setFds(ux[1], ux[1]);
+        /* restarted from a worker loop */
+        IoLoop::main->wake();
+
+        if (verbose > 0)
+            log(fmt("module %s fd=%d\n", path.c_str(), ux[1]));
+
+        XMLEle *root = addXMLEle(NULL, "getProperties");
+        addXMLAtt(root, "version", TO_STRING(INDIV));
+        Msg *mp = new Msg(nullptr, root);
+
+        // pushmsg can kill mp. do at end
+        pushMsg(mp);
+        return;
+    }
+    if (handle != nullptr)
+        dlclose(handle);
+#endif
+
+    /* restarted, too many modules or not loadable: fall back to the executable */
+    log(fmt("running %s as a process\n", program.c_str()));
+    startProcess(program);
+}
+
 void LocalDvrInfo::closeEfd()
 {
     ::close(efd);
@@ -2813,11 +3954,14 @@ RemoteDvrInfo * RemoteDvrInfo::clone() const
 
 ClInfo::ClInfo(bool useSharedBuffer) : MsgQueue(useSharedBuffer)
 {
+    conflate = conflatestreams;
+    holdTimer.set<ClInfo, &ClInfo::onHoldTimer>(this);
     clients.insert(this);
 }
 
 ClInfo::~ClInfo()
 {
+    dropHeld();
     for(auto prop : props)
     {
         delete prop;
@@ -2826,6 +3970,82 @@ ClInfo::~ClInfo()
     clients.erase(this);
 }
 
+bool ClInfo::holdUntilReady(XMLEle *root, const std::list<int> &sharedBuffers)
+{
+    if (heldMessages.empty())
+    {
+        if (heldOnce || readywait <= 0 || strcmp(tagXMLEle(root), "getProperties") || DvrInfo::allReady())
+            return false;
+
+        heldOnce = true;
+        ev_now_update(loop);
+        holdTimer.start(readywait);
+        IoLoop::main->wake();
+        if (verbose > 0)
+            log("waiting for the drivers to be ready\n");
+    }
+    else if (!sharedBuffers.empty())
+    {
+        /* attached buffers cannot wait, nor can what came before them */
+        auto hb = heartBeat();
+        releaseHeld();
+        if (hb.alive())
+            return false;
+        delXMLEle(root);
+        return true;
+    }
+
+    heldMessages.push_back(root);
+    return true;
+}
+
+void ClInfo::onHoldTimer(ev::timer &, int)
+{
+    log(fmt("drivers not ready after %g s, going on\n", readywait));
+    releaseHeld();
+}
+
+void ClInfo::releaseHeld()
+{
+    holdTimer.stop();
+
+    std::list<XMLEle *> held;
+    held.swap(heldMessages);
+
+    std::list<int> noSharedBuffers;
+    auto hb = heartBeat();
+    for (auto root : held)
+    {
+        if (hb.alive())
+            onMessage(root, noSharedBuffers);
+        else
+            delXMLEle(root);
+    }
+}
+
+void ClInfo::dropHeld()
+{
+    holdTimer.stop();
+    for (auto root : heldMessages)
+        delXMLEle(root);
+    heldMessages.clear();
+}
+
+void ClInfo::driversReady()
+{
+    for (auto cp : clients)
+    {
+        if (cp == nullptr) continue;
+
+        if (!cp->heldMessages.empty())
+        {
+            if (verbose > 0)
+                cp->log("drivers ready\n");
+            cp->releaseHeld();
+        }
+    }
+}
+
 void ClInfo::log(const std::string &str) const
 {
     std::string logLine = fmt("Client %d: ", this->getRFd());
@@ -2905,11 +4125,12 @@ void SerializedMsg::async_start()
     {
         asyncProgress.start();
 
-        std::thread t([this]()
+        // When the pool is full, generate it here as for the messages without blobs
+        if (!INDI::ThreadPool::instance().tryStart([this](const std::atomic_bool &)
         {
             generateContent();
-        });
-        t.detach();
+        }))
+            generateContent();
     }
     else
     {
@@ -3095,6 +4316,8 @@ Msg::Msg(MsgQueue * from, XMLEle * ele): sharedBuffers()
     convertionToSharedBuffer = nullptr;
     convertionToInline = nullptr;
 
+    stream = false;
+
     queueSize = sprlXMLEle(xmlContent, 0);
     for(auto blobContent : findBlobElements(xmlContent))
     {
@@ -3107,6 +4330,17 @@ Msg::Msg(MsgQueue * from, XMLEle * ele): sharedBuffers()
         {
             hasInlineBlobs = true;
         }
+
+        if (strstr(findXMLAttValu(blobContent, "format"), "stream"))
+        {
+            stream = true;
+        }
+    }
+
+    if (stream)
+    {
+        streamDevice = findXMLAttValu(xmlContent, "device");
+        streamName = findXMLAttValu(xmlContent, "name");
     }
 }
 
@@ -3618,6 +4852,9 @@ void SerializedMsgWithSharedBuffer::generateContent()
 MsgQueue::MsgQueue(bool useSharedBuffer): useSharedBuffer(useSharedBuffer)
 {
     lp = newLilXML();
+    ioLoop = IoLoop::assign();
+    rio.set(ioLoop->getLoop());
+    wio.set(ioLoop->getLoop());
     rio.set<MsgQueue, &MsgQueue::ioCb>(this);
     wio.set<MsgQueue, &MsgQueue::ioCb>(this);
     rFd = -1;
@@ -3644,6 +4881,15 @@ MsgQueue::~MsgQueue()
     }
 }
 
+bool MsgQueue::deferClose()
+{
+    if (!busy)
+        return false;
+
+    closeRequested = true;
+    return true;
+}
+
 void MsgQueue::closeWritePart()
 {
     if (wFd == -1)
@@ -3725,6 +4971,12 @@ void MsgQueue::consumeHeadMsg()
 {
     auto msg = headMsg();
     msgq.pop_front();
+    if (msg == deflateAfter)
+    {
+        /* the peer reads compressed data from now on */
+        deflateAfter = nullptr;
+        deflater.reset(new INDI::Deflater());
+    }
     msg->release(this);
     nsent.reset();
 
@@ -3741,6 +4993,25 @@ void MsgQueue::pushMsg(Msg * mp)
 
     auto serialized = mp->serialize(this);
 
+    /* drop the queued frame of the same stream, unless it is already being sent
+     * or another loop is writing or compressing it right now. the new one goes
+     * last so it stays behind what the driver sent after the old one */
+    if (mp->isStream() && conflates(mp->getDevice(), mp->getName()))
+    {
+        for (auto it = msgq.begin(); it != msgq.end(); ++it)
+        {
+            if (it == msgq.begin() && (busy || nsent.started()))
+                continue;
+            if (!(*it)->message()->isSameStream(*mp))
+                continue;
+
+            auto replaced = *it;
+            msgq.erase(it);
+            replaced->release(this);
+            break;
+        }
+    }
+
     msgq.push_back(serialized);
     serialized->addAwaiter(this);
 
@@ -3752,7 +5023,7 @@ void MsgQueue::updateIos()
 {
     if (wFd != -1)
     {
-        if (msgq.empty() || !msgq.front()->requestContent(nsent))
+        if (deflatedSent == deflated.size() && (msgq.empty() || !msgq.front()->requestContent(nsent)))
         {
             wio.stop();
         }
@@ -3765,6 +5036,9 @@ void MsgQueue::updateIos()
     {
         rio.start();
     }
+
+    /* the queue may be served by another loop */
+    ioLoop->wake();
 }
 
 void MsgQueue::messageMayHaveProgressed(const SerializedMsg * msg)
@@ -3778,6 +5052,9 @@ void MsgQueue::messageMayHaveProgressed(const SerializedMsg * msg)
 void MsgQueue::clearMsgQueue()
 {
     nsent.reset();
+    deflateAfter = nullptr;
+    deflated.clear();
+    deflatedSent = 0;
 
     auto queueCopy = msgq;
     for(auto mp : queueCopy)
@@ -3834,7 +5111,7 @@ size_t MsgQueue::doRead(char * buf, size_t nr)
     if (!useSharedBuffer)
     {
         /* read client - works for all kinds of fds incl pipe*/
-        return read(rFd, buf, sizeof(buf));
+        return read(rFd, buf, nr);
     }
     else
     {
@@ -3903,25 +5180,42 @@ size_t MsgQueue::doRead(char * buf, size_t nr)
 void MsgQueue::readFromFd()
 {
     char buf[MAXRBUF];
+    char err[1024];
     ssize_t nr;
+    int readErrno;
+    XMLEle **nodes = nullptr;
+
+    {
+        /* read client and process XML chunk, other loops can route meanwhile */
+        Unlocked unlocked(*this);
+        nr = doRead(buf, sizeof(buf));
+        readErrno = errno;
+        if (nr > 0)
+            nodes = parseInput(buf, nr, err);
+    }
+
+    /* closed by another loop meanwhile */
+    if (closeRequested)
+    {
+        for (int inode = 0; nodes && nodes[inode]; inode++)
+            delXMLEle(nodes[inode]);
+        free(nodes);
+        close();
+        return;
+    }
 
-    /* read client */
-    nr = doRead(buf, sizeof(buf));
     if (nr <= 0)
     {
-        if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+        if (readErrno == EAGAIN || readErrno == EWOULDBLOCK) return;
 
         if (nr < 0)
-            log(fmt("read: %s\n", strerror(errno)));
+            log(fmt("read: %s\n", strerror(readErrno)));
         else if (verbose > 0)
             log(fmt("read EOF\n"));
         close();
         return;
     }
 
-    /* process XML chunk */
-    char err[1024];
-    XMLEle **nodes = parseXMLChunk(lp, buf, nr, err);
     if (!nodes)
     {
         log(fmt("XML error: %s\n", err));
@@ -3930,6 +5224,14 @@ void MsgQueue::readFromFd()
         return;
     }
 
+    if (answerCompression)
+    {
+        answerCompression = false;
+        if (verbose > 0)
+            log(fmt("using %s compression\n", INDI::TransportCompression));
+        queueCompressionStart();
+    }
+
     int inode = 0;
 
     XMLEle *root = nodes[inode];
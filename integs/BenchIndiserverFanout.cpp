@@ -0,0 +1,152 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+/*
+ * Measure how fast indiserver fans a high rate property out to many clients,
+ * for several numbers of event loop threads (indiserver -t).
+ *
+ * usage: BenchIndiserverFanout [clients [updates [threads...]]]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "utils.h"
+
+#include "DriverMock.h"
+#include "IndiServerController.h"
+
+static const std::string UPDATE_END = "</setNumberVector>";
+
+// Read from fd until count occurrences of pattern were seen
+static void awaitPattern(int fd, const std::string &pattern, int count)
+{
+    std::string pending;
+    char buf[65536];
+
+    while (count > 0)
+    {
+        ssize_t rd = read(fd, buf, sizeof(buf));
+        if (rd <= 0)
+            throw std::runtime_error("connection closed while awaiting " + pattern);
+        pending.append(buf, rd);
+
+        size_t pos = 0, found;
+        while ((found = pending.find(pattern, pos)) != std::string::npos)
+        {
+            count--;
+            pos = found + pattern.size();
+        }
+        // Keep what could be the start of a split pattern
+        size_t keep = std::min(pending.size() - pos, pattern.size() - 1);
+        pending.erase(0, pending.size() - keep);
+    }
+}
+
+static void writeAll(int fd, const std::string &data)
+{
+    size_t done = 0;
+    while (done < data.size())
+    {
+        ssize_t wr = write(fd, data.data() + done, data.size() - done);
+        if (wr <= 0)
+            throw std::runtime_error("write failed");
+        done += wr;
+    }
+}
+
+static double runOnce(int threads, int clients, int updates)
+{
+    DriverMock fakeDriver;
+    IndiServerController indiServer;
+
+    fakeDriver.setup();
+
+    // No verbose logging, it would dominate the measure
+    std::vector<std::string> args = { "-p", std::to_string(indiServer.getTcpPort()), "-r", "0", "-t", std::to_string(threads) };
+#ifdef ENABLE_INDI_SHARED_MEMORY
+    args.push_back("-u");
+    args.push_back(indiServer.getUnixSocketPath());
+#endif
+    args.push_back(getTestExePath("fakedriver"));
+    indiServer.start(args);
+
+    fakeDriver.waitEstablish();
+    fakeDriver.cnx.expectXml("<getProperties version='1.7'/>");
+    fakeDriver.cnx.send("<defNumberVector device='fakedev1' name='rate' label='rate' group='test_group' state='Idle' perm='ro' timeout='100' timestamp='2018-01-01T00:00:00'>\n");
+    fakeDriver.cnx.send("<defNumber name='value' label='value' min='0' max='1e9' step='1'>0</defNumber>\n");
+    fakeDriver.cnx.send("</defNumberVector>\n");
+    fakeDriver.ping();
+
+    std::vector<int> fds;
+    for (int i = 0; i < clients; i++)
+    {
+        int fd = tcpSocketConnect("127.0.0.1", indiServer.getTcpPort());
+        writeAll(fd, "<getProperties version='1.7'/>\n");
+        awaitPattern(fd, "</defNumberVector>", 1);
+        fds.push_back(fd);
+    }
+
+    std::vector<std::thread> readers;
+    for (int fd : fds)
+        readers.emplace_back(awaitPattern, fd, UPDATE_END, updates);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < updates; i++)
+    {
+        fakeDriver.cnx.send("<setNumberVector device='fakedev1' name='rate' state='Ok' timestamp='2018-01-01T00:00:00'>\n"
+                            "<oneNumber name='value'>" + std::to_string(i) + "</oneNumber>\n" + UPDATE_END + "\n");
+    }
+    for (auto &reader : readers)
+        reader.join();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    for (int fd : fds)
+        close(fd);
+
+    fakeDriver.terminateDriver();
+    // Exit code 1 is expected when driver stopped
+    indiServer.waitProcessEnd(1);
+
+    return double(updates) * clients / elapsed.count();
+}
+
+int main(int argc, char **argv)
+{
+    int clients = argc > 1 ? atoi(argv[1]) : 64;
+    int updates = argc > 2 ? atoi(argv[2]) : 2000;
+    std::vector<int> threads;
+    for (int i = 3; i < argc; i++)
+        threads.push_back(atoi(argv[i]));
+    if (threads.empty())
+        threads = { 0, 1, 2, 4 };
+
+    setupSigPipe();
+
+    printf("%d clients, %d updates, %u cpus\n", clients, updates, std::thread::hardware_concurrency());
+    for (int t : threads)
+        printf("-t %d: %.0f messages/s delivered\n", t, runOnce(t, clients, updates));
+
+    return 0;
+}
@@ -71,6 +71,12 @@ void DriverMock::ping()
     cnx.expectXml("<pingReply uid=\"flush\"/>");
 }
 
+void DriverMock::ready()
+{
+    cnx.expectXml("<pingRequest uid='indiserver-ready'/>");
+    cnx.send("<pingReply uid='indiserver-ready'/>\n");
+}
+
 DriverMock::DriverMock()
 {
     driverConnection = -1;
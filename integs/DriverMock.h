@@ -47,6 +47,9 @@ class DriverMock
 
         void ping();
 
+        // Answer the ping indiserver sends after the first getProperties, as a driver done defining its properties
+        void ready();
+
         ConnectionMock cnx;
 };
 
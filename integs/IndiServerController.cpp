@@ -34,6 +34,11 @@
 
 IndiServerController::IndiServerController() {
     fifo = false;
+    // Most tests check the getProperties exchange with the driver
+    propertyCache = false;
+    threads = 0;
+    conflateStreams = false;
+    readyWait = 0;
 }
 
 IndiServerController::~IndiServerController() {
@@ -47,12 +52,42 @@ void IndiServerController::setFifo(bool fifo) {
     this->fifo = fifo;
 }
 
+void IndiServerController::setPropertyCache(bool propertyCache) {
+    this->propertyCache = propertyCache;
+}
+
+void IndiServerController::setThreads(int threads) {
+    this->threads = threads;
+}
+
+void IndiServerController::setConflateStreams(bool conflateStreams) {
+    this->conflateStreams = conflateStreams;
+}
+
+void IndiServerController::setReadyWait(double seconds) {
+    this->readyWait = seconds;
+}
+
 void IndiServerController::start(const std::vector<std::string> & args) {
     ProcessController::start("../indiserver/indiserver", args);
 }
 
 void IndiServerController::startDriver(const std::string & path) {
     std::vector<std::string> args = { "-p", TO_STRING(TEST_TCP_PORT), "-r", "0", "-vvv" };
+    if (!propertyCache) {
+        args.push_back("-n");
+    }
+    if (threads > 0) {
+        args.push_back("-t");
+        args.push_back(std::to_string(threads));
+    }
+    if (conflateStreams) {
+        args.push_back("-c");
+    }
+    if (readyWait > 0) {
+        args.push_back("-w");
+        args.push_back(std::to_string(readyWait));
+    }
 #ifdef ENABLE_INDI_SHARED_MEMORY
     args.push_back("-u");
     args.push_back(TEST_UNIX_SOCKET);
@@ -71,9 +106,9 @@ void IndiServerController::startDriver(const std::string & path) {
     start(args);
 }
 
-void IndiServerController::addDriver(const std::string & driver) {
+void IndiServerController::fifoCommand(const std::string & cmd) {
     if (!fifo) {
-        throw new std::runtime_error("Fifo is not enabled - cannot add driver");
+        throw new std::runtime_error("Fifo is not enabled - cannot " + cmd);
     }
 
     int fifoFd = open(TEST_INDI_FIFO, O_WRONLY);
@@ -81,8 +116,8 @@ void IndiServerController::addDriver(const std::string & driver) {
         throw std::system_error(errno, std::generic_category(), "opening fifo");
     }
 
-    std::string cmd = "start " + driver +"\n";
-    int wr = write(fifoFd, cmd.data(), cmd.length());
+    std::string line = cmd + "\n";
+    int wr = write(fifoFd, line.data(), line.length());
     if (wr == -1) {
         auto e = errno;
         close(fifoFd);
@@ -92,6 +127,14 @@ void IndiServerController::addDriver(const std::string & driver) {
     close(fifoFd);
 }
 
+void IndiServerController::addDriver(const std::string & driver) {
+    fifoCommand("start " + driver);
+}
+
+void IndiServerController::removeDriver(const std::string & driver) {
+    fifoCommand("stop " + driver);
+}
+
 std::string IndiServerController::getUnixSocketPath() const {
     return TEST_UNIX_SOCKET;
 }
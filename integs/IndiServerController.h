@@ -32,16 +32,32 @@
 class IndiServerController : public ProcessController
 {
         bool fifo;
+        bool propertyCache;
+        int threads;
+        bool conflateStreams;
+        double readyWait;
+
+        void fifoCommand(const std::string & cmd);
     public:
         IndiServerController();
         ~IndiServerController();
         void setFifo(bool enable);
+        // Answer client getProperties from the server cache instead of the drivers
+        void setPropertyCache(bool enable);
+        // Spread connections over that many event loop threads
+        void setThreads(int threads);
+        // Conflate the streaming BLOBs of every client
+        void setConflateStreams(bool enable);
+        // Hold clients until the drivers are ready, at most that many seconds
+        void setReadyWait(double seconds);
         void start(const std::vector<std::string> & args);
 
         void startDriver(const std::string & driver);
 
         void addDriver(const std::string & path);
 
+        void removeDriver(const std::string & path);
+
         std::string getUnixSocketPath() const;
         int getTcpPort() const;
 };
@@ -164,3 +164,169 @@ TEST(TestClientQueries, ServerForwardRequestOfHalfDeadClient)
     // Exit code 1 is expected when driver stopped
     indiServer.waitProcessEnd(1);
 }
+
+TEST(TestClientQueries, ServerAnswersFromCache)
+{
+    DriverMock fakeDriver;
+    IndiServerController indiServer;
+
+    indiServer.setPropertyCache(true);
+    startFakeDev1(indiServer, fakeDriver);
+
+    fprintf(stderr, "Driver updates and deletes properties\n");
+    fakeDriver.cnx.send("<setNumberVector device='fakedev1' name='testnumber0' state='Busy' timestamp='2018-01-01T00:01:00' message='moving'>\n");
+    fakeDriver.cnx.send("<oneNumber name='content'>51</oneNumber>\n");
+    fakeDriver.cnx.send("</setNumberVector>\n");
+    fakeDriver.cnx.send("<delProperty device='fakedev1' name='testnumber1'/>\n");
+    fakeDriver.ping();
+
+    IndiClientMock indiClient;
+
+    indiClient.connect(indiServer);
+
+    fprintf(stderr, "Client asks properties\n");
+    indiClient.cnx.send("<getProperties version='1.7'/>\n");
+
+    fprintf(stderr, "Client receives the latest state from cache\n");
+    indiClient.cnx.expectXml("<defNumberVector device='fakedev1' name='testnumber0' label='test label' group='test_group' state='Busy' perm='rw' timeout='100' timestamp='2018-01-01T00:01:00'>");
+    indiClient.cnx.expectXml("<defNumber name='content' label='content' min='0' max='100' step='1'>");
+    indiClient.cnx.expect("\n51");
+    indiClient.cnx.expectXml("</defNumber>");
+    indiClient.cnx.expectXml("</defNumberVector>");
+    for(int i = 2; i < PROP_COUNT; ++i)
+    {
+        indiClient.cnx.expectXml("<defNumberVector device='fakedev1' name='testnumber" + std::to_string(
+                                     i) + "' label='test label' group='test_group' state='Idle' perm='rw' timeout='100' timestamp='2018-01-01T00:00:00'>");
+        indiClient.cnx.expectXml("<defNumber name='content' label='content' min='0' max='100' step='1'>");
+        indiClient.cnx.expect("\n50");
+        indiClient.cnx.expectXml("</defNumber>");
+        indiClient.cnx.expectXml("</defNumberVector>");
+    }
+    indiClient.ping();
+
+    fprintf(stderr, "Driver was not asked\n");
+    fakeDriver.ping();
+
+    fakeDriver.terminateDriver();
+    // Exit code 1 is expected when driver stopped
+    indiServer.waitProcessEnd(1);
+}
+
+TEST(TestClientQueries, ServerWithEventLoopThreads)
+{
+    DriverMock fakeDriver;
+    IndiServerController indiServer;
+
+    indiServer.setPropertyCache(true);
+    indiServer.setThreads(2);
+    startFakeDev1(indiServer, fakeDriver);
+    fakeDriver.ping();
+
+    // Consecutive connections land on different loops
+    IndiClientMock indiClients[3];
+    for (auto &indiClient : indiClients)
+    {
+        indiClient.connect(indiServer);
+        indiClient.cnx.send("<getProperties version='1.7'/>\n");
+        clientReceivesProps(indiClient);
+        indiClient.ping();
+    }
+
+    fprintf(stderr, "Driver updates a property at high rate\n");
+    for(int i = 0; i < 50; ++i)
+    {
+        fakeDriver.cnx.send("<setNumberVector device='fakedev1' name='testnumber0' state='Busy' timestamp='2018-01-01T00:01:00'>\n");
+        fakeDriver.cnx.send("<oneNumber name='content'>" + std::to_string(i) + "</oneNumber>\n");
+        fakeDriver.cnx.send("</setNumberVector>\n");
+    }
+
+    fprintf(stderr, "Every client receives every update in order\n");
+    for (auto &indiClient : indiClients)
+    {
+        for(int i = 0; i < 50; ++i)
+        {
+            indiClient.cnx.expectXml("<setNumberVector device='fakedev1' name='testnumber0' state='Busy' timestamp='2018-01-01T00:01:00'>");
+            indiClient.cnx.expectXml("<oneNumber name='content'>");
+            indiClient.cnx.expect("\n" + std::to_string(i));
+            indiClient.cnx.expectXml("</oneNumber>");
+            indiClient.cnx.expectXml("</setNumberVector>");
+        }
+    }
+
+    fprintf(stderr, "Client request reaches the driver from another loop\n");
+    indiClients[1].cnx.send("<newNumberVector device='fakedev1' name='testnumber0' timestamp='2018-01-01T00:00:00'>");
+    indiClients[1].cnx.send("<oneNumber name='content' > 51 </oneNumber>");
+    indiClients[1].cnx.send("</newNumberVector>");
+    fakeDriver.cnx.expectXml("<newNumberVector device='fakedev1' name='testnumber0' timestamp='2018-01-01T00:00:00'>");
+    fakeDriver.cnx.expectXml("<oneNumber name='content'>");
+    fakeDriver.cnx.expect("\n51");
+    fakeDriver.cnx.expectXml("</oneNumber>");
+    fakeDriver.cnx.expectXml("</newNumberVector>");
+
+    indiClients[0].close();
+    fakeDriver.ping();
+
+    fakeDriver.terminateDriver();
+    // Exit code 1 is expected when driver stopped
+    indiServer.waitProcessEnd(1);
+}
+
+TEST(TestClientQueries, ServerAcceptsCompression)
+{
+    DriverMock fakeDriver;
+    IndiServerController indiServer;
+
+    startFakeDev1(indiServer, fakeDriver);
+
+    IndiClientMock indiClient;
+
+    indiClient.connectTcp(indiServer);
+
+    fprintf(stderr, "Client asks for compression\n");
+    indiClient.cnx.send("<getProperties version='1.7' compression='zlib'/>\n");
+    fakeDriver.cnx.expectXml("<getProperties version='1.7'/>");
+
+    // Everything after this is compressed
+    indiClient.cnx.expectXml("<compression format='zlib'/>");
+    indiClient.close();
+
+    fprintf(stderr, "Unix connections stay plain\n");
+    IndiClientMock localClient;
+    localClient.connectUnix(indiServer);
+    connectFakeDev1Client(indiServer, fakeDriver, localClient);
+
+    fakeDriver.terminateDriver();
+    // Exit code 1 is expected when driver stopped
+    indiServer.waitProcessEnd(1);
+}
+
+TEST(TestClientQueries, ServerHoldsClientUntilDriverReady)
+{
+    DriverMock fakeDriver;
+    IndiServerController indiServer;
+
+    setupSigPipe();
+    fakeDriver.setup();
+    indiServer.setReadyWait(30);
+    indiServer.startDriver(getTestExePath("fakedriver"));
+    fakeDriver.waitEstablish();
+    fakeDriver.cnx.expectXml("<getProperties version='1.7'/>");
+
+    fprintf(stderr, "Client asks while the driver defines its properties\n");
+    IndiClientMock indiClient;
+    indiClient.connect(indiServer);
+    indiClient.cnx.send("<getProperties version='1.7'/>\n");
+    indiClient.cnx.send("<pingRequest uid='1'/>\n");
+    driverSendsProps(fakeDriver);
+
+    fprintf(stderr, "Client is served once the driver is ready\n");
+    fakeDriver.ready();
+    fakeDriver.cnx.expectXml("<getProperties version='1.7'/>");
+    indiClient.cnx.expectXml("<pingReply uid='1'/>");
+    driverSendsProps(fakeDriver);
+    clientReceivesProps(indiClient);
+
+    fakeDriver.terminateDriver();
+    // Exit code 1 is expected when driver stopped
+    indiServer.waitProcessEnd(1);
+}
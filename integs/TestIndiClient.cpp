@@ -33,6 +33,8 @@
 
 #include "ServerMock.h"
 #include "IndiClientMock.h"
+#include "DriverMock.h"
+#include "IndiServerController.h"
 
 #define TEST_TCP_PORT 17624
 #define TEST_UNIX_SOCKET "/tmp/indi-test-server"
@@ -100,3 +102,46 @@ TEST(IndiclientTcpConnect, ClientConnect)
     indiServerCnx.cnx.send("<pingRequest uid='123456'/>");
     indiServerCnx.cnx.expectXml("<pingReply uid='123456'/>");
 }
+
+TEST(IndiclientTcpConnect, ClientCompressedConnect)
+{
+    DriverMock fakeDriver;
+    IndiServerController indiServer;
+
+    setupSigPipe();
+
+    fakeDriver.setup();
+    indiServer.startDriver(getTestExePath("fakedriver"));
+    fakeDriver.waitEstablish();
+    fakeDriver.cnx.expectXml("<getProperties version='1.7'/>");
+
+    MyClient * client = new MyClient("fakedev1", "testnumber");
+    client->setCompression(true);
+    client->setServer("127.0.0.1", indiServer.getTcpPort());
+    ASSERT_EQ(client->connectServer(), true);
+
+    // The compression request is not forwarded to the driver
+    fakeDriver.cnx.expectXml("<getProperties version='1.7'/>");
+    fakeDriver.cnx.send("<defNumberVector device='fakedev1' name='testnumber' label='test label' group='test_group' state='Idle' perm='rw' timeout='100' timestamp='2018-01-01T00:00:00'>\n");
+    fakeDriver.cnx.send("<defNumber name='content' label='content' min='0' max='100' step='1'>50</defNumber>\n");
+    fakeDriver.cnx.send("</defNumberVector>\n");
+
+    for (int i = 0; i < 500 && !client->getDevice("fakedev1").getProperty("testnumber").isValid(); i++)
+        usleep(10000);
+    ASSERT_TRUE(client->getDevice("fakedev1").getProperty("testnumber").isValid());
+
+    // Compressed in both directions
+    client->sendNewNumber("fakedev1", "testnumber", "content", 51);
+    fakeDriver.cnx.expectXml("<newNumberVector device='fakedev1' name='testnumber'>");
+    fakeDriver.cnx.expectXml("<oneNumber name='content'>");
+    fakeDriver.cnx.expect("\n51");
+    fakeDriver.cnx.expectXml("</oneNumber>");
+    fakeDriver.cnx.expectXml("</newNumberVector>");
+
+    client->disconnectServer();
+    delete client;
+
+    fakeDriver.terminateDriver();
+    // Exit code 1 is expected when driver stopped
+    indiServer.waitProcessEnd(1);
+}
@@ -0,0 +1,176 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/types.h>
+
+#include "gtest/gtest.h"
+
+#include "utils.h"
+
+#include "DriverMock.h"
+#include "IndiServerController.h"
+#include "ProcessController.h"
+
+#define PROP_COUNT 20
+
+static void driverIsAskedProps(DriverMock & fakeDriver) {
+    fakeDriver.cnx.expectXml("<getProperties version='1.7'/>");
+
+    for(int i = 0; i < PROP_COUNT; ++i) {
+        fakeDriver.cnx.send("<defNumberVector device='fakedev1' name='testnumber" + std::to_string(i) + "' label='test label' group='test_group' state='Idle' perm='rw' timeout='100' timestamp='2018-01-01T00:00:00'>\n");
+        fakeDriver.cnx.send("<defNumber name='content' label='content' min='0' max='100' step='1'>" + std::to_string(i) + "</defNumber>\n");
+        fakeDriver.cnx.send("</defNumberVector>\n");
+    }
+}
+
+// Driver whose properties the server answers from its cache
+static void startFakeDev1(IndiServerController & indiServer, DriverMock & fakeDriver) {
+    setupSigPipe();
+
+    fakeDriver.setup();
+
+    indiServer.setPropertyCache(true);
+    indiServer.startDriver(getTestExePath("fakedriver"));
+    fakeDriver.waitEstablish();
+
+    driverIsAskedProps(fakeDriver);
+    fakeDriver.ping();
+}
+
+static std::string tempPath(const std::string & name) {
+    return "/tmp/" + name + "_" + std::to_string(getpid());
+}
+
+static std::string readFile(const std::string & path) {
+    std::ifstream in(path);
+    std::stringstream content;
+    content << in.rdbuf();
+    return content.str();
+}
+
+// Runs a tool with its standard output in a file, returns how long it took
+static double runTool(const std::string & command, const std::string & output, int expectedExitCode) {
+    ProcessController tool;
+    auto start = std::chrono::steady_clock::now();
+    tool.start("/bin/sh", { "-c", command + " > " + output });
+    tool.join();
+    tool.expectExitCode(expectedExitCode);
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+TEST(TestIndiGetProp, WildcardDoesNotWaitForTimeout) {
+    DriverMock fakeDriver;
+    IndiServerController indiServer;
+
+    startFakeDev1(indiServer, fakeDriver);
+
+    std::string output = tempPath("getprop_wildcard");
+    double elapsed = runTool(getTestExePath("../tools/indi_getprop") + " -p " + std::to_string(indiServer.getTcpPort()) +
+                             " -t 30 'fakedev1.*.*'", output, 0);
+
+    // Done once the server answered the pingRequest, not after -t
+    EXPECT_LT(elapsed, 5);
+    std::string expected;
+    for(int i = 0; i < PROP_COUNT; ++i)
+        expected += "fakedev1.testnumber" + std::to_string(i) + ".content=" + std::to_string(i) + "\n";
+    EXPECT_EQ(readFile(output), expected);
+    unlink(output.c_str());
+
+    fakeDriver.terminateDriver();
+    indiServer.waitProcessEnd(1);
+}
+
+// Sends the definitions from first to last, pausing at pause
+static void defineProps(DriverMock & fakeDriver, int first, int last, int pause = -1) {
+    for(int i = first; i < last; ++i) {
+        if (i == pause)
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        fakeDriver.cnx.send("<defNumberVector device='fakedev1' name='testnumber" + std::to_string(i) + "' label='test label' group='test_group' state='Idle' perm='rw' timeout='100' timestamp='2018-01-01T00:00:00'>\n");
+        fakeDriver.cnx.send("<defNumber name='content' label='content' min='0' max='100' step='1'>" + std::to_string(i) + "</defNumber>\n");
+        fakeDriver.cnx.send("</defNumberVector>\n");
+    }
+}
+
+TEST(TestIndiGetProp, WildcardWaitsForLaterDefinitions) {
+    DriverMock fakeDriver;
+    IndiServerController indiServer;
+
+    setupSigPipe();
+    fakeDriver.setup();
+
+    // No cache: the server answers the pingRequest before the driver answered getProperties
+    indiServer.startDriver(getTestExePath("fakedriver"));
+    fakeDriver.waitEstablish();
+    fakeDriver.cnx.expectXml("<getProperties version='1.7'/>");
+    defineProps(fakeDriver, 0, PROP_COUNT / 2);
+    fakeDriver.ping();
+
+    std::string output = tempPath("getprop_bursts");
+    ProcessController tool;
+    tool.start("/bin/sh", { "-c", getTestExePath("../tools/indi_getprop") + " -p " + std::to_string(indiServer.getTcpPort()) +
+                            " -t 30 'fakedev1.*.*' > " + output });
+
+    // Defines half of its properties, then the rest a bit later
+    fakeDriver.cnx.expectXml("<getProperties version='1.7' device='fakedev1'/>");
+    defineProps(fakeDriver, 0, PROP_COUNT, PROP_COUNT / 2);
+
+    tool.join();
+    tool.expectExitCode(0);
+    std::string expected;
+    for(int i = 0; i < PROP_COUNT; ++i)
+        expected += "fakedev1.testnumber" + std::to_string(i) + ".content=" + std::to_string(i) + "\n";
+    EXPECT_EQ(readFile(output), expected);
+    unlink(output.c_str());
+
+    fakeDriver.terminateDriver();
+    indiServer.waitProcessEnd(1);
+}
+
+TEST(TestIndiGetProp, BatchOverOneConnection) {
+    DriverMock fakeDriver;
+    IndiServerController indiServer;
+
+    startFakeDev1(indiServer, fakeDriver);
+
+    std::string queries = tempPath("getprop_queries");
+    std::ofstream(queries) << "# comment\n"
+                           << "fakedev1.testnumber3.content\n"
+                           << "\n"
+                           << "fakedev1.testnumber7.content fakedev1.testnumber8._STATE\n"
+                           << "fakedev1.missing.content\n";
+
+    std::string output = tempPath("getprop_batch");
+    // The missing property makes the exit code 1, without waiting for -t either
+    double elapsed = runTool(getTestExePath("../tools/indi_getprop") + " -p " + std::to_string(indiServer.getTcpPort()) +
+                             " -t 30 -c " + queries, output, 1);
+    EXPECT_LT(elapsed, 5);
+
+    EXPECT_EQ(readFile(output),
+              "fakedev1.testnumber3.content=3\n"
+              "fakedev1.testnumber7.content=7\n"
+              "fakedev1.testnumber8._STATE=Idle\n");
+    unlink(queries.c_str());
+    unlink(output.c_str());
+
+    fakeDriver.terminateDriver();
+    indiServer.waitProcessEnd(1);
+}
@@ -178,3 +178,45 @@ TEST(TestIndiSetProperties, SetLastPropertyTyped) {
     indiServer.waitProcessEnd(1);
 
 }
+
+TEST(TestIndiSetProperties, SetBatchOverOneConnection) {
+    DriverMock fakeDriver;
+    IndiServerController indiServer;
+
+    startFakeDev1(indiServer, fakeDriver);
+
+    std::string batch = "/tmp/setprop_batch_" + std::to_string(getpid());
+    FILE * fp = fopen(batch.c_str(), "w");
+    ASSERT_NE(fp, nullptr);
+    fprintf(fp, "# untyped, its definition is asked for\n");
+    fprintf(fp, "fakedev1.testnumber5.content=8\n");
+    fprintf(fp, "-n fakedev1.testnumber6.content=9\n");
+    fclose(fp);
+
+    ProcessController indiSetProp;
+    startIndiSetProp(indiSetProp, { "-p", std::to_string(indiServer.getTcpPort()), "-c", batch });
+
+    // Only the property of the untyped line is asked for
+    fakeDriver.cnx.expectXml("<getProperties version='1.7' device='fakedev1' name='testnumber5'/>");
+    fakeDriver.cnx.send("<defNumberVector device='fakedev1' name='testnumber5' label='test label' group='test_group' state='Idle' perm='rw' timeout='100' timestamp='2018-01-01T00:00:00'>\n");
+    fakeDriver.cnx.send("<defNumber name='content' label='content' min='0' max='100' step='1'>50</defNumber>\n");
+    fakeDriver.cnx.send("</defNumberVector>\n");
+
+    indiSetProp.join();
+    indiSetProp.expectExitCode(0);
+    unlink(batch.c_str());
+
+    fakeDriver.cnx.expectXml("<newNumberVector device='fakedev1' name='testnumber5'>");
+    fakeDriver.cnx.expectXml("<oneNumber name='content'>");
+    fakeDriver.cnx.expect("\n8");
+    fakeDriver.cnx.expectXml("</oneNumber>");
+    fakeDriver.cnx.expectXml("</newNumberVector>");
+    fakeDriver.cnx.expectXml("<newNumberVector device='fakedev1' name='testnumber6'>");
+    fakeDriver.cnx.expectXml("<oneNumber name='content'>");
+    fakeDriver.cnx.expect("\n9");
+    fakeDriver.cnx.expectXml("</oneNumber>");
+    fakeDriver.cnx.expectXml("</newNumberVector>");
+
+    fakeDriver.terminateDriver();
+    indiServer.waitProcessEnd(1);
+}
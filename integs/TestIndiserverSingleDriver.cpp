@@ -20,7 +20,9 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <sys/types.h>
+#include <sys/socket.h>
 #include <system_error>
+#include <thread>
 
 #include "gtest/gtest.h"
 
@@ -95,6 +97,94 @@ TEST(IndiserverSingleDriver, ReplyToPing)
     indiServer.waitProcessEnd(1);
 }
 
+#ifdef HAVE_MODULE_DRIVER
+// Read what the server sends until the text shows up
+static void readUntil(int fd, const std::string &text)
+{
+    std::string received;
+    char buf[4096];
+    while (received.find(text) == std::string::npos)
+    {
+        ssize_t rd = read(fd, buf, sizeof(buf));
+        ASSERT_GT(rd, 0) << "waiting for " << text;
+        received.append(buf, rd);
+    }
+}
+
+// No driver to wait for, the server may not listen yet
+static int connectToServer(IndiServerController &indiServer)
+{
+    int fd = -1;
+    for (int i = 0; i < 500 && (fd = tcpSocketConnect("127.0.0.1", indiServer.getTcpPort(), true)) == -1; i++)
+        usleep(10000);
+    return fd;
+}
+
+TEST(IndiserverSingleDriver, ModuleDriver)
+{
+    IndiServerController indiServer;
+
+    setupSigPipe();
+
+    // moduledriver built by indi_add_driver_module, runs on a thread of indiserver
+    std::string module = getTestExePath("moduledriver.so");
+    indiServer.setFifo(true);
+    indiServer.startDriver(module);
+    fprintf(stderr, "indiserver started\n");
+
+    int fd = connectToServer(indiServer);
+    ASSERT_NE(fd, -1);
+    write(fd, "<getProperties version='1.7'/>\n", 31);
+    readUntil(fd, "<defSwitchVector device=\"Module Driver\" name=\"CONNECTION\"");
+
+    fprintf(stderr, "Driver stops, the module returns\n");
+    indiServer.removeDriver(module);
+    readUntil(fd, "<delProperty device=\"Module Driver\"");
+    usleep(100000);
+
+    // Its globals are not initialized again, so the executable runs instead
+    fprintf(stderr, "Driver starts again as a process\n");
+    indiServer.addDriver(module);
+    write(fd, "<getProperties version='1.7'/>\n", 31);
+    readUntil(fd, "<defSwitchVector device=\"Module Driver\" name=\"CONNECTION\"");
+
+    close(fd);
+    indiServer.kill();
+    indiServer.join();
+}
+
+TEST(IndiserverSingleDriver, ModuleDriverStopsOnNewerClient)
+{
+    IndiServerController indiServer;
+
+    setupSigPipe();
+
+    std::string module = getTestExePath("moduledriver.so");
+    // Forward client getProperties to the driver
+    indiServer.setPropertyCache(false);
+    indiServer.setFifo(true);
+    indiServer.startDriver(module);
+    fprintf(stderr, "indiserver started\n");
+
+    int fd = connectToServer(indiServer);
+    ASSERT_NE(fd, -1);
+    write(fd, "<getProperties version='1.7'/>\n", 31);
+    readUntil(fd, "<defSwitchVector device=\"Module Driver\" name=\"CONNECTION\"");
+
+    // A driver process would exit, the module only stops its driver
+    fprintf(stderr, "Client asks for a newer protocol\n");
+    write(fd, "<getProperties version='9.0'/>\n", 31);
+    readUntil(fd, "<delProperty device=\"Module Driver\"");
+
+    write(fd, "<pingRequest uid='1'/>\n", 23);
+    readUntil(fd, "<pingReply uid=\"1\"");
+
+    close(fd);
+    indiServer.kill();
+    indiServer.join();
+}
+#endif
+
 
 static void startFakeDev(IndiServerController &indiServer)
 {
@@ -335,6 +425,196 @@ TEST(IndiserverSingleDriver, ForwardBase64BlobToIPClient)
 }
 
 
+TEST(IndiserverSingleDriver, ConflateStreamBlobsForSlowClient)
+{
+    DriverMock fakeDriver;
+    IndiServerController indiServer;
+
+    startFakeDev1(indiServer, fakeDriver);
+
+    // A small receive buffer makes frames pile up in the server
+    int fd = tcpSocketConnect("127.0.0.1", indiServer.getTcpPort());
+    int rcvbuf = 4096;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    IndiClientMock indiClient;
+    indiClient.associate(fd);
+
+    connectFakeDev1Client(indiServer, fakeDriver, indiClient);
+
+    fprintf(stderr, "Client ask conflated blobs\n");
+    indiClient.cnx.send("<enableBLOB device='fakedev1' name='testblob' conflate='On'>Also</enableBLOB>\n");
+    indiClient.ping();
+
+    fprintf(stderr, "Driver streams frames faster than the client reads\n");
+    const int frames = 200;
+    const std::string content(65536, 'A');
+    for (int i = 0; i < frames; ++i)
+    {
+        fakeDriver.cnx.send("<setBLOBVector device='fakedev1' name='testblob' timestamp='2018-01-01T00:01:00' message='frame " +
+                            std::to_string(i) + "'>\n");
+        fakeDriver.cnx.send("<oneBLOB name='content' size='49152' format='.stream' enclen='65536'>\n");
+        fakeDriver.cnx.send(content + "\n");
+        fakeDriver.cnx.send("</oneBLOB>\n");
+        fakeDriver.cnx.send("</setBLOBVector>\n");
+        // Not conflated, it stays between the frames it was sent between
+        fakeDriver.cnx.send("<message device='fakedev1' timestamp='2018-01-01T00:01:00' message='after " + std::to_string(i) + "'/>\n");
+    }
+    fakeDriver.ping();
+
+    fprintf(stderr, "Client receives some frames, always the latest one\n");
+    const std::string marker = "message=\"frame ";
+    std::string received;
+    char buf[65536];
+    write(fd, "<pingRequest uid='flush'/>\n", 27);
+    while (received.find("<pingReply") == std::string::npos)
+    {
+        ssize_t rd = read(fd, buf, sizeof(buf));
+        ASSERT_GT(rd, 0);
+        received.append(buf, rd);
+    }
+
+    std::vector<int> seen;
+    for (size_t pos = received.find(marker); pos != std::string::npos; pos = received.find(marker, pos + 1))
+        seen.push_back(atoi(received.c_str() + pos + marker.size()));
+
+    fprintf(stderr, "Client received %zu of %d frames\n", seen.size(), frames);
+    ASSERT_FALSE(seen.empty());
+    EXPECT_LT(seen.size(), size_t(frames));
+    EXPECT_EQ(seen.back(), frames - 1);
+    for (size_t i = 1; i < seen.size(); ++i)
+        EXPECT_LT(seen[i - 1], seen[i]);
+
+    fprintf(stderr, "Client receives every other message, in the order the driver sent it\n");
+    size_t last = 0;
+    for (int i = 0; i < frames; ++i)
+    {
+        size_t after = received.find("message=\"after " + std::to_string(i) + "\"");
+        ASSERT_NE(after, std::string::npos) << i;
+        EXPECT_GT(after, last) << i;
+        last = after;
+
+        size_t frame = received.find(marker + std::to_string(i) + "\"");
+        if (frame != std::string::npos)
+        {
+            EXPECT_LT(frame, after) << i;
+            if (i > 0)
+                EXPECT_GT(frame, received.find("message=\"after " + std::to_string(i - 1) + "\"")) << i;
+        }
+    }
+
+    fakeDriver.terminateDriver();
+    // Exit code 1 is expected when driver stopped
+    indiServer.waitProcessEnd(1);
+}
+
+// Each frame is received whole: the conflation never touches the frame a loop is writing
+static std::vector<int> receivedFrames(const std::string &received, const std::string &device, size_t enclen)
+{
+    const std::string start = "<setBLOBVector device=\"" + device + "\"";
+    const std::string marker = "message=\"frame ";
+    std::vector<int> seen;
+    for (size_t pos = received.find(start); pos != std::string::npos; pos = received.find(start, pos + 1))
+    {
+        size_t frame = received.find(marker, pos);
+        size_t blob = received.find("<oneBLOB", pos);
+        size_t content = received.find('>', blob);
+        size_t end = received.find("</oneBLOB>", content);
+        EXPECT_NE(end, std::string::npos);
+        if (frame == std::string::npos || end == std::string::npos)
+            break;
+
+        size_t chars = 0;
+        for (size_t i = content + 1; i < end; ++i)
+        {
+            if (received[i] == 'A')
+                ++chars;
+            else
+                EXPECT_TRUE(isspace(received[i])) << "corrupted frame content";
+        }
+        EXPECT_EQ(chars, enclen);
+        seen.push_back(atoi(received.c_str() + frame + marker.size()));
+    }
+    return seen;
+}
+
+TEST(IndiserverSingleDriver, ConflateStreamBlobsOnThreads)
+{
+    // Two producers on their own loops push frames while the client loop writes
+    DriverMock fakeDriver;
+    IndiServerController indiServer;
+    indiServer.setFifo(true);
+    indiServer.setThreads(2);
+    indiServer.setConflateStreams(true);
+    startFakeDev1(indiServer, fakeDriver);
+
+    DriverMock secondDriver;
+    addDriver(indiServer, secondDriver, "fakeDev2");
+    secondDriver.ping();
+
+    int fd = tcpSocketConnect("127.0.0.1", indiServer.getTcpPort());
+    int rcvbuf = 4096;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    IndiClientMock indiClient;
+    indiClient.associate(fd);
+
+    connectFakeDev1Client(indiServer, fakeDriver, indiClient);
+    secondDriver.cnx.expectXml("<getProperties version='1.7'/>");
+
+    fprintf(stderr, "Client asks blobs of both drivers\n");
+    indiClient.cnx.send("<enableBLOB device='fakedev1' name='testblob'>Also</enableBLOB>\n");
+    indiClient.cnx.send("<enableBLOB device='fakedev2' name='testblob'>Also</enableBLOB>\n");
+    indiClient.ping();
+
+    fprintf(stderr, "Both drivers stream frames faster than the client reads\n");
+    const int frames = 200;
+    const std::string content(65536, 'A');
+    auto stream = [&](DriverMock &driver, const std::string &device)
+    {
+        for (int i = 0; i < frames; ++i)
+        {
+            driver.cnx.send("<setBLOBVector device='" + device + "' name='testblob' timestamp='2018-01-01T00:01:00' message='frame " +
+                            std::to_string(i) + "'>\n");
+            driver.cnx.send("<oneBLOB name='content' size='49152' format='.stream' enclen='65536'>\n");
+            driver.cnx.send(content + "\n");
+            driver.cnx.send("</oneBLOB>\n");
+            driver.cnx.send("</setBLOBVector>\n");
+        }
+        driver.ping();
+    };
+    std::thread second(stream, std::ref(secondDriver), "fakedev2");
+    stream(fakeDriver, "fakedev1");
+    second.join();
+
+    fprintf(stderr, "Client receives whole frames, always the latest ones\n");
+    std::string received;
+    char buf[65536];
+    write(fd, "<pingRequest uid='flush'/>\n", 27);
+    while (received.find("<pingReply") == std::string::npos)
+    {
+        ssize_t rd = read(fd, buf, sizeof(buf));
+        ASSERT_GT(rd, 0);
+        received.append(buf, rd);
+    }
+
+    for (const std::string device : { "fakedev1", "fakedev2" })
+    {
+        std::vector<int> seen = receivedFrames(received, device, content.size());
+        fprintf(stderr, "Client received %zu of %d frames of %s\n", seen.size(), frames, device.c_str());
+        ASSERT_FALSE(seen.empty());
+        EXPECT_EQ(seen.back(), frames - 1);
+        for (size_t i = 1; i < seen.size(); ++i)
+            EXPECT_LT(seen[i - 1], seen[i]);
+    }
+
+    fakeDriver.terminateDriver();
+    secondDriver.terminateDriver();
+
+    indiServer.kill();
+    indiServer.join();
+}
+
 TEST(IndiserverSingleDriver, SnoopDriverPropertie)
 {
     // This tests snooping simple property from driver to driver
@@ -0,0 +1,39 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+#include "defaultdevice.h"
+
+#include <memory>
+
+// A plain driver, also built as a module by indi_add_driver_module
+class ModuleDriver : public INDI::DefaultDevice
+{
+    protected:
+        bool Connect() override
+        {
+            return true;
+        }
+        bool Disconnect() override
+        {
+            return true;
+        }
+        const char *getDefaultName() override
+        {
+            return "Module Driver";
+        }
+};
+
+static std::unique_ptr<ModuleDriver> moduleDriver(new ModuleDriver());
@@ -86,6 +86,7 @@ bool AlignmentSubsystemForDrivers::AddAlignmentEntryEquatorial(double actualRA,
     if (!CheckForDuplicateSyncPoint(NewEntry))
     {
         GetAlignmentDatabase().push_back(NewEntry);
+        IncrementRevision();
         UpdateSize();
 
         // tell the math plugin about the new alignment point
@@ -178,6 +179,7 @@ bool AlignmentSubsystemForDrivers::AddAlignmentEntryAltAz(double actualRA, doubl
     if (!CheckForDuplicateSyncPoint(NewEntry))
     {
         GetAlignmentDatabase().push_back(NewEntry);
+        IncrementRevision();
         UpdateSize();
 
         // tell the math plugin about the new alignment point
@@ -14,15 +14,16 @@
 
 #include "indicom.h"
 
+#include <algorithm>
 #include <limits>
 #include <iostream>
-#include <map>
 
 namespace INDI
 {
 namespace AlignmentSubsystem
 {
 BasicMathPlugin::BasicMathPlugin()
+    : InitialisedRevision(0), InitialisedSyncPointCount(0), InitialisedMountAlignment(ZENITH)
 {
     pActualToApparentTransform = gsl_matrix_alloc(3, 3);
     pApparentToActualTransform = gsl_matrix_alloc(3, 3);
@@ -36,6 +37,25 @@ BasicMathPlugin::~BasicMathPlugin()
     gsl_matrix_free(pApparentToActualTransform);
 }
 
+BasicMathPlugin::FaceLookup::FaceLookup() : LastFace(nullptr)
+{
+    pNearestTransform = gsl_matrix_alloc(3, 3);
+    NearestPoints[0] = NearestPoints[1] = NearestPoints[2] = -1;
+}
+
+BasicMathPlugin::FaceLookup::~FaceLookup()
+{
+    gsl_matrix_free(pNearestTransform);
+}
+
+void BasicMathPlugin::FaceLookup::Reset()
+{
+    Index.Clear();
+    VertexFaces.clear();
+    LastFace = nullptr;
+    NearestPoints[0] = NearestPoints[1] = NearestPoints[2] = -1;
+}
+
 // Public methods
 
 bool BasicMathPlugin::Initialise(InMemoryDatabase *pInMemoryDatabase)
@@ -43,6 +63,11 @@ bool BasicMathPlugin::Initialise(InMemoryDatabase *pInMemoryDatabase)
     MathPlugin::Initialise(pInMemoryDatabase);
     InMemoryDatabase::AlignmentDatabaseType &SyncPoints = pInMemoryDatabase->GetAlignmentDatabase();
 
+    // Remember what the model was built from so the transforms can tell when it is out of date
+    InitialisedRevision       = pInMemoryDatabase->GetRevision();
+    InitialisedSyncPointCount = SyncPoints.size();
+    InitialisedMountAlignment = ApproximateMountAlignment;
+
     /// See how many entries there are in the in memory database.
     /// - If just one use a hint to mounts approximate alignment, this can either be ZENITH,
     /// NORTH_CELESTIAL_POLE or SOUTH_CELESTIAL_POLE. The hint is used to make a dummy second
@@ -225,9 +250,12 @@ bool BasicMathPlugin::Initialise(InMemoryDatabase *pInMemoryDatabase)
                 return false;
 
             // Compute Hulls etc.
+            ActualLookup.Reset();
+            ApparentLookup.Reset();
             ActualConvexHull.Reset();
             ApparentConvexHull.Reset();
             ActualDirectionCosines.clear();
+            ApparentDirectionCosines.clear();
 
             // Add a dummy point at the nadir
             ActualConvexHull.MakeNewVertex(0.0, 0.0, -1.0, 0);
@@ -254,6 +282,7 @@ bool BasicMathPlugin::Initialise(InMemoryDatabase *pInMemoryDatabase)
                     ActualDirectionCosine = TelescopeDirectionVectorFromEquatorialCoordinates(RaDec);
                 }
                 ActualDirectionCosines.push_back(ActualDirectionCosine);
+                ApparentDirectionCosines.push_back((*Itr).TelescopeDirection);
                 ActualConvexHull.MakeNewVertex(ActualDirectionCosine.x, ActualDirectionCosine.y,
                                                ActualDirectionCosine.z, VertexNumber);
                 ApparentConvexHull.MakeNewVertex((*Itr).TelescopeDirection.x, (*Itr).TelescopeDirection.y,
@@ -350,6 +379,9 @@ bool BasicMathPlugin::Initialise(InMemoryDatabase *pInMemoryDatabase)
                 while (CurrentFace != ApparentConvexHull.faces);
             }
 
+            BuildFaceLookup(ActualConvexHull, ActualDirectionCosines, ActualLookup);
+            BuildFaceLookup(ApparentConvexHull, ApparentDirectionCosines, ApparentLookup);
+
 #ifdef CONVEX_HULL_DEBUGGING
             ASSDEBUGF("Initialise - ActualFaces %d ApparentFaces %d", ActualFaces, ApparentFaces);
             ActualConvexHull.PrintObj("ActualHull.obj");
@@ -375,6 +407,7 @@ bool BasicMathPlugin::TransformCelestialToTelescope(const double RightAscension,
     if ((nullptr == pInMemoryDatabase) || !pInMemoryDatabase->GetDatabaseReferencePosition(Position))
         return false;
 
+    RefreshModel();
     InMemoryDatabase::AlignmentDatabaseType &SyncPoints = pInMemoryDatabase->GetAlignmentDatabase();
     switch (SyncPoints.size())
     {
@@ -418,18 +451,15 @@ bool BasicMathPlugin::TransformCelestialToTelescope(const double RightAscension,
             {
                 ActualVector = TelescopeDirectionVectorFromEquatorialCoordinates(ActualRaDec);
             }
-            gsl_vector *pGSLActualVector = gsl_vector_alloc(3);
-            gsl_vector_set(pGSLActualVector, 0, ActualVector.x);
-            gsl_vector_set(pGSLActualVector, 1, ActualVector.y);
-            gsl_vector_set(pGSLActualVector, 2, ActualVector.z);
-            gsl_vector *pGSLApparentVector = gsl_vector_alloc(3);
-            MatrixVectorMultiply(pActualToApparentTransform, pGSLActualVector, pGSLApparentVector);
-            ApparentTelescopeDirectionVector.x = gsl_vector_get(pGSLApparentVector, 0);
-            ApparentTelescopeDirectionVector.y = gsl_vector_get(pGSLApparentVector, 1);
-            ApparentTelescopeDirectionVector.z = gsl_vector_get(pGSLApparentVector, 2);
+            double Actual[3] = { ActualVector.x, ActualVector.y, ActualVector.z };
+            double Apparent[3];
+            gsl_vector_view GSLActualVector   = gsl_vector_view_array(Actual, 3);
+            gsl_vector_view GSLApparentVector = gsl_vector_view_array(Apparent, 3);
+            MatrixVectorMultiply(pActualToApparentTransform, &GSLActualVector.vector, &GSLApparentVector.vector);
+            ApparentTelescopeDirectionVector.x = Apparent[0];
+            ApparentTelescopeDirectionVector.y = Apparent[1];
+            ApparentTelescopeDirectionVector.z = Apparent[2];
             ApparentTelescopeDirectionVector.Normalise();
-            gsl_vector_free(pGSLActualVector);
-            gsl_vector_free(pGSLApparentVector);
             break;
         }
 
@@ -447,138 +477,25 @@ bool BasicMathPlugin::TransformCelestialToTelescope(const double RightAscension,
                 ActualVector = TelescopeDirectionVectorFromEquatorialCoordinates(ActualRaDec);
             }
 
-            gsl_matrix *pTransform;
-            gsl_matrix *pComputedTransform = nullptr;
-            // Scale the actual telescope direction vector to make sure it traverses the unit sphere.
-            TelescopeDirectionVector ScaledActualVector = ActualVector * 2.0;
-            // Shoot the scaled vector in the into the list of actual facets
-            // and use the conversuion matrix from the one it intersects
-            ConvexHull::tFace CurrentFace = ActualConvexHull.faces;
-#ifdef CONVEX_HULL_DEBUGGING
-            int ActualFaces = 0;
-#endif
-            if (nullptr != CurrentFace)
-            {
-                do
-                {
-#ifdef CONVEX_HULL_DEBUGGING
-                    ActualFaces++;
-#endif
-                    // Ignore faces containing vertex 0 (nadir).
-                    if ((0 == CurrentFace->vertex[0]->vnum) || (0 == CurrentFace->vertex[1]->vnum) ||
-                            (0 == CurrentFace->vertex[2]->vnum))
-                    {
-#ifdef CONVEX_HULL_DEBUGGING
-                        ASSDEBUGF("Celestial to telescope - Ignoring actual face %d", ActualFaces);
-#endif
-                    }
-                    else
-                    {
-#ifdef CONVEX_HULL_DEBUGGING
-                        ASSDEBUGF("Celestial to telescope - Processing actual face %d v1 %d v2 %d v3 %d", ActualFaces,
-                                  CurrentFace->vertex[0]->vnum, CurrentFace->vertex[1]->vnum,
-                                  CurrentFace->vertex[2]->vnum);
-#endif
-                        if (RayTriangleIntersection(ScaledActualVector,
-                                                    ActualDirectionCosines[CurrentFace->vertex[0]->vnum - 1],
-                                                    ActualDirectionCosines[CurrentFace->vertex[1]->vnum - 1],
-                                                    ActualDirectionCosines[CurrentFace->vertex[2]->vnum - 1]))
-                            break;
-                    }
-                    CurrentFace = CurrentFace->next;
-                }
-                while (CurrentFace != ActualConvexHull.faces);
-                if (CurrentFace == ActualConvexHull.faces)
-                {
-                    // Find the three nearest points and build a transform
-                    std::map<double, const AlignmentDatabaseEntry *> NearestMap;
-                    for (InMemoryDatabase::AlignmentDatabaseType::const_iterator Itr = SyncPoints.begin();
-                            Itr != SyncPoints.end(); Itr++)
-                    {
-                        INDI::IEquatorialCoordinates RaDec;
-                        TelescopeDirectionVector ActualDirectionCosine;
-                        RaDec.rightascension  = (*Itr).RightAscension;
-                        RaDec.declination = (*Itr).Declination;
-                        if (ApproximateMountAlignment == ZENITH)
-                        {
-                            INDI::IHorizontalCoordinates ActualPoint;
-                            EquatorialToHorizontal(&RaDec, &Position, (*Itr).ObservationJulianDate, &ActualPoint);
-                            ActualDirectionCosine = TelescopeDirectionVectorFromAltitudeAzimuth(ActualPoint);
-                        }
-                        else
-                        {
-                            ActualDirectionCosine = TelescopeDirectionVectorFromEquatorialCoordinates(RaDec);
-                        }
-                        NearestMap[(ActualDirectionCosine - ActualVector).Length()] = &(*Itr);
-                    }
-                    // First compute local horizontal coordinates for the three sync points
-                    std::map<double, const AlignmentDatabaseEntry *>::const_iterator Nearest = NearestMap.begin();
-                    const AlignmentDatabaseEntry *pEntry1                                    = (*Nearest).second;
-                    Nearest++;
-                    const AlignmentDatabaseEntry *pEntry2 = (*Nearest).second;
-                    Nearest++;
-                    const AlignmentDatabaseEntry *pEntry3 = (*Nearest).second;
-                    INDI::IEquatorialCoordinates RaDec1;
-                    INDI::IEquatorialCoordinates RaDec2;
-                    INDI::IEquatorialCoordinates RaDec3;
-                    TelescopeDirectionVector ActualDirectionCosine1;
-                    TelescopeDirectionVector ActualDirectionCosine2;
-                    TelescopeDirectionVector ActualDirectionCosine3;
-                    RaDec1.declination = pEntry1->Declination;
-                    RaDec1.rightascension  = pEntry1->RightAscension;
-                    RaDec2.declination = pEntry2->Declination;
-                    RaDec2.rightascension  = pEntry2->RightAscension;
-                    RaDec3.declination = pEntry3->Declination;
-                    RaDec3.rightascension = pEntry3->RightAscension;
-
-                    if (ApproximateMountAlignment == ZENITH)
-                    {
-                        INDI::IHorizontalCoordinates ActualSyncPoint1;
-                        INDI::IHorizontalCoordinates ActualSyncPoint2;
-                        INDI::IHorizontalCoordinates ActualSyncPoint3;
-                        EquatorialToHorizontal(&RaDec1, &Position, pEntry1->ObservationJulianDate, &ActualSyncPoint1);
-                        EquatorialToHorizontal(&RaDec2, &Position, pEntry2->ObservationJulianDate, &ActualSyncPoint2);
-                        EquatorialToHorizontal(&RaDec3, &Position, pEntry3->ObservationJulianDate, &ActualSyncPoint3);
-
-                        // Now express these coordinates as normalised direction vectors (a.k.a direction cosines)
-                        ActualDirectionCosine1 = TelescopeDirectionVectorFromAltitudeAzimuth(ActualSyncPoint1);
-                        ActualDirectionCosine2 = TelescopeDirectionVectorFromAltitudeAzimuth(ActualSyncPoint2);
-                        ActualDirectionCosine3 = TelescopeDirectionVectorFromAltitudeAzimuth(ActualSyncPoint3);
-                    }
-                    else
-                    {
-                        ActualDirectionCosine1 = TelescopeDirectionVectorFromEquatorialCoordinates(RaDec1);
-                        ActualDirectionCosine2 = TelescopeDirectionVectorFromEquatorialCoordinates(RaDec2);
-                        ActualDirectionCosine3 = TelescopeDirectionVectorFromEquatorialCoordinates(RaDec3);
-                    }
-
-                    pComputedTransform = gsl_matrix_alloc(3, 3);
-                    CalculateTransformMatrices(ActualDirectionCosine1, ActualDirectionCosine2, ActualDirectionCosine3,
-                                               pEntry1->TelescopeDirection, pEntry2->TelescopeDirection,
-                                               pEntry3->TelescopeDirection, pComputedTransform, nullptr);
-                    pTransform = pComputedTransform;
-                }
-                else
-                    pTransform = CurrentFace->pMatrix;
-            }
-            else
+            // Use the conversion matrix of the actual facet the vector passes through. If it does not
+            // pass through any of them build a transform from the three nearest sync points instead.
+            ConvexHull::tFace Face = FindIntersectedFace(ActualConvexHull, ActualDirectionCosines, ActualLookup,
+                                     ActualVector);
+            gsl_matrix *pTransform = (nullptr != Face) ? Face->pMatrix :
+                                     GetNearestTransform(ActualDirectionCosines, ApparentDirectionCosines,
+                                             ActualLookup, ActualVector);
+            if (nullptr == pTransform)
                 return false;
 
-            // OK - got an intersection - CurrentFace is pointing at the face
-            gsl_vector *pGSLActualVector = gsl_vector_alloc(3);
-            gsl_vector_set(pGSLActualVector, 0, ActualVector.x);
-            gsl_vector_set(pGSLActualVector, 1, ActualVector.y);
-            gsl_vector_set(pGSLActualVector, 2, ActualVector.z);
-            gsl_vector *pGSLApparentVector = gsl_vector_alloc(3);
-            MatrixVectorMultiply(pTransform, pGSLActualVector, pGSLApparentVector);
-            ApparentTelescopeDirectionVector.x = gsl_vector_get(pGSLApparentVector, 0);
-            ApparentTelescopeDirectionVector.y = gsl_vector_get(pGSLApparentVector, 1);
-            ApparentTelescopeDirectionVector.z = gsl_vector_get(pGSLApparentVector, 2);
+            double Actual[3] = { ActualVector.x, ActualVector.y, ActualVector.z };
+            double Apparent[3];
+            gsl_vector_view GSLActualVector   = gsl_vector_view_array(Actual, 3);
+            gsl_vector_view GSLApparentVector = gsl_vector_view_array(Apparent, 3);
+            MatrixVectorMultiply(pTransform, &GSLActualVector.vector, &GSLApparentVector.vector);
+            ApparentTelescopeDirectionVector.x = Apparent[0];
+            ApparentTelescopeDirectionVector.y = Apparent[1];
+            ApparentTelescopeDirectionVector.z = Apparent[2];
             ApparentTelescopeDirectionVector.Normalise();
-            gsl_vector_free(pGSLActualVector);
-            gsl_vector_free(pGSLApparentVector);
-            if (nullptr != pComputedTransform)
-                gsl_matrix_free(pComputedTransform);
             break;
         }
     }
@@ -608,6 +525,7 @@ bool BasicMathPlugin::TransformTelescopeToCelestial(const TelescopeDirectionVect
         ASSDEBUG("No database or no position in database");
         return false;
     }
+    RefreshModel();
     InMemoryDatabase::AlignmentDatabaseType &SyncPoints = pInMemoryDatabase->GetAlignmentDatabase();
     switch (SyncPoints.size())
     {
@@ -645,20 +563,21 @@ bool BasicMathPlugin::TransformTelescopeToCelestial(const TelescopeDirectionVect
         case 2:
         case 3:
         {
-            gsl_vector *pGSLApparentVector = gsl_vector_alloc(3);
-            gsl_vector_set(pGSLApparentVector, 0, ApparentTelescopeDirectionVector.x);
-            gsl_vector_set(pGSLApparentVector, 1, ApparentTelescopeDirectionVector.y);
-            gsl_vector_set(pGSLApparentVector, 2, ApparentTelescopeDirectionVector.z);
-            gsl_vector *pGSLActualVector = gsl_vector_alloc(3);
-            MatrixVectorMultiply(pApparentToActualTransform, pGSLApparentVector, pGSLActualVector);
+            double Apparent[3] = { ApparentTelescopeDirectionVector.x, ApparentTelescopeDirectionVector.y,
+                                   ApparentTelescopeDirectionVector.z
+                                 };
+            double Actual[3];
+            gsl_vector_view GSLApparentVector = gsl_vector_view_array(Apparent, 3);
+            gsl_vector_view GSLActualVector   = gsl_vector_view_array(Actual, 3);
+            MatrixVectorMultiply(pApparentToActualTransform, &GSLApparentVector.vector, &GSLActualVector.vector);
 
-            Dump3("ApparentVector", pGSLApparentVector);
-            Dump3("ActualVector", pGSLActualVector);
+            Dump3("ApparentVector", &GSLApparentVector.vector);
+            Dump3("ActualVector", &GSLActualVector.vector);
 
             TelescopeDirectionVector ActualTelescopeDirectionVector;
-            ActualTelescopeDirectionVector.x = gsl_vector_get(pGSLActualVector, 0);
-            ActualTelescopeDirectionVector.y = gsl_vector_get(pGSLActualVector, 1);
-            ActualTelescopeDirectionVector.z = gsl_vector_get(pGSLActualVector, 2);
+            ActualTelescopeDirectionVector.x = Actual[0];
+            ActualTelescopeDirectionVector.y = Actual[1];
+            ActualTelescopeDirectionVector.z = Actual[2];
             ActualTelescopeDirectionVector.Normalise();
             if (ApproximateMountAlignment == ZENITH)
             {
@@ -671,127 +590,32 @@ bool BasicMathPlugin::TransformTelescopeToCelestial(const TelescopeDirectionVect
             }
             RightAscension = ActualRaDec.rightascension;
             Declination    = ActualRaDec.declination;
-            gsl_vector_free(pGSLActualVector);
-            gsl_vector_free(pGSLApparentVector);
             break;
         }
 
         default:
         {
-            gsl_matrix *pTransform;
-            gsl_matrix *pComputedTransform = nullptr;
-            // Scale the apparent telescope direction vector to make sure it traverses the unit sphere.
-            TelescopeDirectionVector ScaledApparentVector = ApparentTelescopeDirectionVector * 2.0;
-            // Shoot the scaled vector in the into the list of apparent facets
-            // and use the conversuion matrix from the one it intersects
-            ConvexHull::tFace CurrentFace = ApparentConvexHull.faces;
-#ifdef CONVEX_HULL_DEBUGGING
-            int ApparentFaces = 0;
-#endif
-            if (nullptr != CurrentFace)
-            {
-                do
-                {
-#ifdef CONVEX_HULL_DEBUGGING
-                    ApparentFaces++;
-#endif
-                    // Ignore faces containing vertex 0 (nadir).
-                    if ((0 == CurrentFace->vertex[0]->vnum) || (0 == CurrentFace->vertex[1]->vnum) ||
-                            (0 == CurrentFace->vertex[2]->vnum))
-                    {
-#ifdef CONVEX_HULL_DEBUGGING
-                        ASSDEBUGF("Celestial to telescope - Ignoring apparent face %d", ApparentFaces);
-#endif
-                    }
-                    else
-                    {
-#ifdef CONVEX_HULL_DEBUGGING
-                        ASSDEBUGF("TelescopeToCelestial - Processing apparent face %d v1 %d v2 %d v3 %d", ApparentFaces,
-                                  CurrentFace->vertex[0]->vnum, CurrentFace->vertex[1]->vnum,
-                                  CurrentFace->vertex[2]->vnum);
-#endif
-                        if (RayTriangleIntersection(ScaledApparentVector,
-                                                    SyncPoints[CurrentFace->vertex[0]->vnum - 1].TelescopeDirection,
-                                                    SyncPoints[CurrentFace->vertex[1]->vnum - 1].TelescopeDirection,
-                                                    SyncPoints[CurrentFace->vertex[2]->vnum - 1].TelescopeDirection))
-                            break;
-                    }
-                    CurrentFace = CurrentFace->next;
-                }
-                while (CurrentFace != ApparentConvexHull.faces);
-                if (CurrentFace == ApparentConvexHull.faces)
-                {
-                    // Find the three nearest points and build a transform
-                    std::map<double, const AlignmentDatabaseEntry *> NearestMap;
-                    for (InMemoryDatabase::AlignmentDatabaseType::const_iterator Itr = SyncPoints.begin();
-                            Itr != SyncPoints.end(); Itr++)
-                    {
-                        NearestMap[((*Itr).TelescopeDirection - ApparentTelescopeDirectionVector).Length()] = &(*Itr);
-                    }
-                    // First compute local horizontal coordinates for the three sync points
-                    std::map<double, const AlignmentDatabaseEntry *>::const_iterator Nearest = NearestMap.begin();
-                    const AlignmentDatabaseEntry *pEntry1                                    = (*Nearest).second;
-                    Nearest++;
-                    const AlignmentDatabaseEntry *pEntry2 = (*Nearest).second;
-                    Nearest++;
-                    const AlignmentDatabaseEntry *pEntry3 = (*Nearest).second;
-                    INDI::IEquatorialCoordinates RaDec1;
-                    INDI::IEquatorialCoordinates RaDec2;
-                    INDI::IEquatorialCoordinates RaDec3;
-                    TelescopeDirectionVector ActualDirectionCosine1;
-                    TelescopeDirectionVector ActualDirectionCosine2;
-                    TelescopeDirectionVector ActualDirectionCosine3;
-                    RaDec1.declination = pEntry1->Declination;
-                    RaDec1.rightascension  = pEntry1->RightAscension;
-                    RaDec2.declination = pEntry2->Declination;
-                    RaDec2.rightascension  = pEntry2->RightAscension;
-                    RaDec3.declination = pEntry3->Declination;
-                    RaDec3.rightascension = pEntry3->RightAscension;
-
-                    if (ApproximateMountAlignment == ZENITH)
-                    {
-                        INDI::IHorizontalCoordinates ActualSyncPoint1;
-                        INDI::IHorizontalCoordinates ActualSyncPoint2;
-                        INDI::IHorizontalCoordinates ActualSyncPoint3;
-                        EquatorialToHorizontal(&RaDec1, &Position, pEntry1->ObservationJulianDate, &ActualSyncPoint1);
-                        EquatorialToHorizontal(&RaDec2, &Position, pEntry2->ObservationJulianDate, &ActualSyncPoint2);
-                        EquatorialToHorizontal(&RaDec3, &Position, pEntry3->ObservationJulianDate, &ActualSyncPoint3);
-
-                        // Now express these coordinates as normalised direction vectors (a.k.a direction cosines)
-                        ActualDirectionCosine1 = TelescopeDirectionVectorFromAltitudeAzimuth(ActualSyncPoint1);
-                        ActualDirectionCosine2 = TelescopeDirectionVectorFromAltitudeAzimuth(ActualSyncPoint2);
-                        ActualDirectionCosine3 = TelescopeDirectionVectorFromAltitudeAzimuth(ActualSyncPoint3);
-                    }
-                    else
-                    {
-                        ActualDirectionCosine1 = TelescopeDirectionVectorFromEquatorialCoordinates(RaDec1);
-                        ActualDirectionCosine2 = TelescopeDirectionVectorFromEquatorialCoordinates(RaDec2);
-                        ActualDirectionCosine3 = TelescopeDirectionVectorFromEquatorialCoordinates(RaDec3);
-                    }
-                    pComputedTransform = gsl_matrix_alloc(3, 3);
-                    CalculateTransformMatrices(pEntry1->TelescopeDirection, pEntry2->TelescopeDirection,
-                                               pEntry3->TelescopeDirection, ActualDirectionCosine1,
-                                               ActualDirectionCosine2, ActualDirectionCosine3, pComputedTransform,
-                                               nullptr);
-                    pTransform = pComputedTransform;
-                }
-                else
-                    pTransform = CurrentFace->pMatrix;
-            }
-            else
+            // Use the conversion matrix of the apparent facet the vector passes through. If it does not
+            // pass through any of them build a transform from the three nearest sync points instead.
+            ConvexHull::tFace Face = FindIntersectedFace(ApparentConvexHull, ApparentDirectionCosines, ApparentLookup,
+                                     ApparentTelescopeDirectionVector);
+            gsl_matrix *pTransform = (nullptr != Face) ? Face->pMatrix :
+                                     GetNearestTransform(ApparentDirectionCosines, ActualDirectionCosines,
+                                             ApparentLookup, ApparentTelescopeDirectionVector);
+            if (nullptr == pTransform)
                 return false;
 
-            // OK - got an intersection - CurrentFace is pointing at the face
-            gsl_vector *pGSLApparentVector = gsl_vector_alloc(3);
-            gsl_vector_set(pGSLApparentVector, 0, ApparentTelescopeDirectionVector.x);
-            gsl_vector_set(pGSLApparentVector, 1, ApparentTelescopeDirectionVector.y);
-            gsl_vector_set(pGSLApparentVector, 2, ApparentTelescopeDirectionVector.z);
-            gsl_vector *pGSLActualVector = gsl_vector_alloc(3);
-            MatrixVectorMultiply(pTransform, pGSLApparentVector, pGSLActualVector);
+            double Apparent[3] = { ApparentTelescopeDirectionVector.x, ApparentTelescopeDirectionVector.y,
+                                   ApparentTelescopeDirectionVector.z
+                                 };
+            double Actual[3];
+            gsl_vector_view GSLApparentVector = gsl_vector_view_array(Apparent, 3);
+            gsl_vector_view GSLActualVector   = gsl_vector_view_array(Actual, 3);
+            MatrixVectorMultiply(pTransform, &GSLApparentVector.vector, &GSLActualVector.vector);
             TelescopeDirectionVector ActualTelescopeDirectionVector;
-            ActualTelescopeDirectionVector.x = gsl_vector_get(pGSLActualVector, 0);
-            ActualTelescopeDirectionVector.y = gsl_vector_get(pGSLActualVector, 1);
-            ActualTelescopeDirectionVector.z = gsl_vector_get(pGSLActualVector, 2);
+            ActualTelescopeDirectionVector.x = Actual[0];
+            ActualTelescopeDirectionVector.y = Actual[1];
+            ActualTelescopeDirectionVector.z = Actual[2];
             ActualTelescopeDirectionVector.Normalise();
             if (ApproximateMountAlignment == ZENITH)
             {
@@ -805,10 +629,6 @@ bool BasicMathPlugin::TransformTelescopeToCelestial(const TelescopeDirectionVect
             // libnova works in decimal degrees so conversion is needed here
             RightAscension = ActualRaDec.rightascension;
             Declination    = ActualRaDec.declination;
-            gsl_vector_free(pGSLActualVector);
-            gsl_vector_free(pGSLApparentVector);
-            if (nullptr != pComputedTransform)
-                gsl_matrix_free(pComputedTransform);
             break;
         }
     }
@@ -818,6 +638,117 @@ bool BasicMathPlugin::TransformTelescopeToCelestial(const TelescopeDirectionVect
 
 // Private methods
 
+void BasicMathPlugin::RefreshModel()
+{
+    if ((pInMemoryDatabase->GetRevision() != InitialisedRevision) ||
+            (pInMemoryDatabase->GetAlignmentDatabase().size() != InitialisedSyncPointCount) ||
+            (ApproximateMountAlignment != InitialisedMountAlignment))
+    {
+        ASSDEBUG("Alignment database changed - rebuilding the model");
+        Initialise(pInMemoryDatabase);
+    }
+}
+
+void BasicMathPlugin::BuildFaceLookup(ConvexHull &Hull, const std::vector<TelescopeDirectionVector> &Vertices,
+                                      FaceLookup &Lookup)
+{
+    Lookup.Reset();
+    Lookup.Index.Build(Vertices);
+    Lookup.VertexFaces.resize(Vertices.size());
+
+    ConvexHull::tFace CurrentFace = Hull.faces;
+    if (nullptr == CurrentFace)
+        return;
+
+    do
+    {
+        // Faces containing vertex 0 (nadir) are never used for transforms
+        if ((0 != CurrentFace->vertex[0]->vnum) && (0 != CurrentFace->vertex[1]->vnum) &&
+                (0 != CurrentFace->vertex[2]->vnum))
+        {
+            for (int i = 0; i < 3; i++)
+                Lookup.VertexFaces[CurrentFace->vertex[i]->vnum - 1].push_back(CurrentFace);
+        }
+        CurrentFace = CurrentFace->next;
+    }
+    while (CurrentFace != Hull.faces);
+}
+
+ConvexHull::tFace BasicMathPlugin::FindIntersectedFace(ConvexHull &Hull,
+        std::vector<TelescopeDirectionVector> &Vertices, FaceLookup &Lookup,
+        const TelescopeDirectionVector &Direction)
+{
+    // Scale the direction vector to make sure it traverses the unit sphere.
+    TelescopeDirectionVector ScaledDirection = Direction * 2.0;
+
+    auto Intersects = [&](ConvexHull::tFace Face)
+    {
+        // Ignore faces containing vertex 0 (nadir).
+        if ((0 == Face->vertex[0]->vnum) || (0 == Face->vertex[1]->vnum) || (0 == Face->vertex[2]->vnum))
+            return false;
+        return RayTriangleIntersection(ScaledDirection, Vertices[Face->vertex[0]->vnum - 1],
+                                       Vertices[Face->vertex[1]->vnum - 1], Vertices[Face->vertex[2]->vnum - 1]);
+    };
+
+    // Tracking and short slews usually stay on the same face
+    if ((nullptr != Lookup.LastFace) && Intersects(Lookup.LastFace))
+        return Lookup.LastFace;
+
+    // Otherwise the face nearly always uses one of the closest sync points
+    std::vector<int> NearestPoints;
+    Lookup.Index.KNearest(Direction, 3, NearestPoints);
+    for (int OnePoint : NearestPoints)
+    {
+        for (ConvexHull::tFace OneFace : Lookup.VertexFaces[OnePoint])
+        {
+            if (Intersects(OneFace))
+            {
+                Lookup.LastFace = OneFace;
+                return OneFace;
+            }
+        }
+    }
+
+    // Fall back to shooting the vector into every face
+    ConvexHull::tFace CurrentFace = Hull.faces;
+    if (nullptr != CurrentFace)
+    {
+        do
+        {
+            if (Intersects(CurrentFace))
+            {
+                Lookup.LastFace = CurrentFace;
+                return CurrentFace;
+            }
+            CurrentFace = CurrentFace->next;
+        }
+        while (CurrentFace != Hull.faces);
+    }
+
+    return nullptr;
+}
+
+gsl_matrix *BasicMathPlugin::GetNearestTransform(const std::vector<TelescopeDirectionVector> &From,
+        const std::vector<TelescopeDirectionVector> &To, FaceLookup &Lookup,
+        const TelescopeDirectionVector &Direction)
+{
+    std::vector<int> NearestPoints;
+    Lookup.Index.KNearest(Direction, 3, NearestPoints);
+    if (NearestPoints.size() < 3)
+        return nullptr;
+
+    // Consecutive transforms usually share the same three points so only recalculate when they change
+    if (!std::equal(NearestPoints.begin(), NearestPoints.end(), Lookup.NearestPoints))
+    {
+        CalculateTransformMatrices(From[NearestPoints[0]], From[NearestPoints[1]], From[NearestPoints[2]],
+                                   To[NearestPoints[0]], To[NearestPoints[1]], To[NearestPoints[2]],
+                                   Lookup.pNearestTransform, nullptr);
+        std::copy(NearestPoints.begin(), NearestPoints.end(), Lookup.NearestPoints);
+    }
+
+    return Lookup.pNearestTransform;
+}
+
 void BasicMathPlugin::Dump3(const char *Label, gsl_vector *pVector)
 {
     ASSDEBUGF("Vector dump - %s", Label);
@@ -10,9 +10,12 @@
 
 #include "AlignmentSubsystemForMathPlugins.h"
 #include "ConvexHull.h"
+#include "DirectionVectorIndex.h"
 
 #include <gsl/gsl_matrix.h>
 
+#include <vector>
+
 namespace INDI
 {
 namespace AlignmentSubsystem
@@ -42,6 +45,61 @@ class BasicMathPlugin : public AlignmentSubsystemForMathPlugins
                 double &RightAscension, double &Declination);
 
     protected:
+        /// \struct FaceLookup
+        /// \brief Cached search structures for one of the convex hulls in the 4+ sync points case
+        struct FaceLookup
+        {
+            FaceLookup();
+            ~FaceLookup();
+            FaceLookup(const FaceLookup &) = delete;
+            FaceLookup &operator=(const FaceLookup &) = delete;
+
+            /// \brief Forget everything that refers to the faces of the hull
+            void Reset();
+
+            /// Spatial index over the hull vertices (excluding the nadir dummy)
+            DirectionVectorIndex Index;
+            /// The faces that use each vertex, indexed by sync point
+            std::vector<std::vector<ConvexHull::tFace>> VertexFaces;
+            /// The face intersected by the previous transform
+            ConvexHull::tFace LastFace;
+            /// The sync points used to build pNearestTransform, -1 if it is not valid
+            int NearestPoints[3];
+            /// Transform built from the three nearest sync points when no face is intersected
+            gsl_matrix *pNearestTransform;
+        };
+
+        /// \brief Initialise the model again if the database or mount alignment has changed since it was built
+        void RefreshModel();
+
+        /// \brief Index the sync points and record which faces of the hull use each of them
+        /// \param[in] Hull The hull to index
+        /// \param[in] Vertices The direction cosines of the sync points in the same reference frame as the hull
+        /// \param[in] Lookup The lookup structure to fill in
+        void BuildFaceLookup(ConvexHull &Hull, const std::vector<TelescopeDirectionVector> &Vertices,
+                             FaceLookup &Lookup);
+
+        /// \brief Find the face of a hull intersected by a direction vector
+        /// Faces around the previous hit and around the nearest sync points are tried before
+        /// falling back to testing every face.
+        /// \param[in] Hull The hull to search
+        /// \param[in] Vertices The direction cosines of the sync points in the same reference frame as the hull
+        /// \param[in] Lookup The lookup structure for the hull
+        /// \param[in] Direction The direction vector
+        /// \return The intersected face or nullptr if there is none
+        ConvexHull::tFace FindIntersectedFace(ConvexHull &Hull, std::vector<TelescopeDirectionVector> &Vertices,
+                                              FaceLookup &Lookup, const TelescopeDirectionVector &Direction);
+
+        /// \brief Get a transform built from the three sync points nearest to a direction vector
+        /// \param[in] From The direction cosines of the sync points in the source reference frame
+        /// \param[in] To The direction cosines of the sync points in the target reference frame
+        /// \param[in] Lookup The lookup structure for the source hull
+        /// \param[in] Direction The direction vector in the source reference frame
+        /// \return The transform matrix, owned by Lookup
+        gsl_matrix *GetNearestTransform(const std::vector<TelescopeDirectionVector> &From,
+                                        const std::vector<TelescopeDirectionVector> &To, FaceLookup &Lookup,
+                                        const TelescopeDirectionVector &Direction);
+
         /// \brief Calculate transformation matrices from the supplied vectors
         /// \param[in] Alpha1 Pointer to the first coordinate in the alpha reference frame
         /// \param[in] Alpha2 Pointer to the second coordinate in the alpha reference frame
@@ -103,6 +161,16 @@ class BasicMathPlugin : public AlignmentSubsystemForMathPlugins
         ConvexHull ApparentConvexHull;
         // Actual direction cosines for the 4+ case
         std::vector<TelescopeDirectionVector> ActualDirectionCosines;
+        // Apparent direction cosines for the 4+ case
+        std::vector<TelescopeDirectionVector> ApparentDirectionCosines;
+        // Face lookup for the 4+ case
+        FaceLookup ActualLookup;
+        FaceLookup ApparentLookup;
+
+        // State of the database when the model was last built
+        unsigned long InitialisedRevision;
+        size_t InitialisedSyncPointCount;
+        MountAlignment_t InitialisedMountAlignment;
 };
 
 } // namespace AlignmentSubsystem
@@ -0,0 +1,153 @@
+/// \file DirectionVectorIndex.cpp
+
+#include "DirectionVectorIndex.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace INDI
+{
+namespace AlignmentSubsystem
+{
+DirectionVectorIndex::DirectionVectorIndex() : Root(-1)
+{
+}
+
+void DirectionVectorIndex::Build(const std::vector<TelescopeDirectionVector> &Vectors)
+{
+    Clear();
+    if (Vectors.empty())
+        return;
+
+    Nodes.reserve(Vectors.size());
+    std::vector<int> Order(Vectors.size());
+    std::iota(Order.begin(), Order.end(), 0);
+    Root = BuildSubtree(Order, 0, Order.size(), Vectors);
+}
+
+void DirectionVectorIndex::Clear()
+{
+    Nodes.clear();
+    Root = -1;
+}
+
+int DirectionVectorIndex::Nearest(const TelescopeDirectionVector &Target) const
+{
+    std::vector<Candidate> Best;
+    Best.reserve(1);
+    Search(Root, Target, 1, Best);
+    return Best.empty() ? -1 : Best.front().second;
+}
+
+void DirectionVectorIndex::KNearest(const TelescopeDirectionVector &Target, size_t Count,
+                                    std::vector<int> &Result) const
+{
+    Result.clear();
+    if (Count == 0)
+        return;
+
+    std::vector<Candidate> Best;
+    Best.reserve(Count);
+    Search(Root, Target, Count, Best);
+
+    // Best is a max heap on distance, sorting it leaves the closest first
+    std::sort_heap(Best.begin(), Best.end());
+    Result.reserve(Best.size());
+    for (const auto &OneCandidate : Best)
+        Result.push_back(OneCandidate.second);
+}
+
+// Private methods
+
+int DirectionVectorIndex::BuildSubtree(std::vector<int> &Order, size_t Begin, size_t End,
+                                       const std::vector<TelescopeDirectionVector> &Vectors)
+{
+    if (Begin >= End)
+        return -1;
+
+    // Split along the axis with the widest spread of the points in this subtree
+    double Min[3] = { 1e9, 1e9, 1e9 };
+    double Max[3] = { -1e9, -1e9, -1e9 };
+    for (size_t i = Begin; i < End; i++)
+    {
+        for (int Axis = 0; Axis < 3; Axis++)
+        {
+            double Value = Component(Vectors[Order[i]], Axis);
+            Min[Axis] = std::min(Min[Axis], Value);
+            Max[Axis] = std::max(Max[Axis], Value);
+        }
+    }
+    int SplitAxis = 0;
+    for (int Axis = 1; Axis < 3; Axis++)
+    {
+        if (Max[Axis] - Min[Axis] > Max[SplitAxis] - Min[SplitAxis])
+            SplitAxis = Axis;
+    }
+
+    size_t Median = Begin + (End - Begin) / 2;
+    std::nth_element(Order.begin() + Begin, Order.begin() + Median, Order.begin() + End,
+                     [&Vectors, SplitAxis](int A, int B)
+    {
+        return Component(Vectors[A], SplitAxis) < Component(Vectors[B], SplitAxis);
+    });
+
+    int NodeIndex = static_cast<int>(Nodes.size());
+    Nodes.push_back({ Vectors[Order[Median]], Order[Median], SplitAxis, -1, -1 });
+
+    int Left  = BuildSubtree(Order, Begin, Median, Vectors);
+    int Right = BuildSubtree(Order, Median + 1, End, Vectors);
+    Nodes[NodeIndex].Left  = Left;
+    Nodes[NodeIndex].Right = Right;
+
+    return NodeIndex;
+}
+
+void DirectionVectorIndex::Search(int NodeIndex, const TelescopeDirectionVector &Target, size_t Count,
+                                  std::vector<Candidate> &Best) const
+{
+    if (NodeIndex < 0)
+        return;
+
+    const Node &Current = Nodes[NodeIndex];
+    TelescopeDirectionVector Delta = Current.Point - Target;
+    // Ties are broken on the position in the source array so results do not depend on tree shape
+    Candidate This(Delta ^ Delta, Current.Index);
+
+    if (Best.size() < Count)
+    {
+        Best.push_back(This);
+        std::push_heap(Best.begin(), Best.end());
+    }
+    else if (This < Best.front())
+    {
+        std::pop_heap(Best.begin(), Best.end());
+        Best.back() = This;
+        std::push_heap(Best.begin(), Best.end());
+    }
+
+    double PlaneDistance = Component(Target, Current.Axis) - Component(Current.Point, Current.Axis);
+    int Near = PlaneDistance < 0 ? Current.Left : Current.Right;
+    int Far  = PlaneDistance < 0 ? Current.Right : Current.Left;
+
+    Search(Near, Target, Count, Best);
+
+    // Only descend into the far side if the splitting plane is closer than the worst candidate so far
+    if (Best.size() < Count || PlaneDistance * PlaneDistance <= Best.front().first)
+        Search(Far, Target, Count, Best);
+}
+
+double DirectionVectorIndex::Component(const TelescopeDirectionVector &Vector, int Axis)
+{
+    switch (Axis)
+    {
+        case 0:
+            return Vector.x;
+        case 1:
+            return Vector.y;
+        default:
+            return Vector.z;
+    }
+}
+
+} // namespace AlignmentSubsystem
+} // namespace INDI
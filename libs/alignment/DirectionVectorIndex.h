@@ -0,0 +1,80 @@
+/// \file DirectionVectorIndex.h
+///
+/// This file provides a spatial index over telescope direction vectors
+
+#pragma once
+
+#include "Common.h"
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace INDI
+{
+namespace AlignmentSubsystem
+{
+/// \class DirectionVectorIndex
+/// \brief A static kd-tree over a set of normalised direction vectors.
+///
+/// For points on the unit sphere the chord length between two vectors increases
+/// monotonically with their great circle separation, so a euclidean nearest neighbour
+/// search over the direction cosines returns the same ordering as a spherical one.
+/// The index stores positions into the vector it was built from, it does not
+/// keep a reference to the vector itself.
+class DirectionVectorIndex
+{
+    public:
+        /// \brief Default constructor
+        DirectionVectorIndex();
+
+        /// \brief Rebuild the index from the supplied vectors
+        /// \param[in] Vectors The direction vectors to index
+        void Build(const std::vector<TelescopeDirectionVector> &Vectors);
+
+        /// \brief Remove all entries from the index
+        void Clear();
+
+        /// \brief Get the number of vectors in the index
+        size_t Size() const
+        {
+            return Nodes.size();
+        }
+
+        /// \brief Find the indexed vector closest to the target
+        /// \param[in] Target The direction vector to search around
+        /// \return The position of the nearest vector in the array passed to Build or -1 if the index is empty
+        int Nearest(const TelescopeDirectionVector &Target) const;
+
+        /// \brief Find the indexed vectors closest to the target
+        /// \param[in] Target The direction vector to search around
+        /// \param[in] Count The maximum number of vectors to return
+        /// \param[out] Result Positions of the nearest vectors in the array passed to Build, closest first
+        void KNearest(const TelescopeDirectionVector &Target, size_t Count, std::vector<int> &Result) const;
+
+    private:
+        struct Node
+        {
+            TelescopeDirectionVector Point;
+            int Index;
+            int Axis;
+            int Left;
+            int Right;
+        };
+
+        /// Squared distance and position of a search candidate
+        typedef std::pair<double, int> Candidate;
+
+        int BuildSubtree(std::vector<int> &Order, size_t Begin, size_t End,
+                         const std::vector<TelescopeDirectionVector> &Vectors);
+        void Search(int NodeIndex, const TelescopeDirectionVector &Target, size_t Count,
+                    std::vector<Candidate> &Best) const;
+
+        static double Component(const TelescopeDirectionVector &Vector, int Axis);
+
+        std::vector<Node> Nodes;
+        int Root;
+};
+
+} // namespace AlignmentSubsystem
+} // namespace INDI
@@ -21,7 +21,7 @@ namespace INDI
 namespace AlignmentSubsystem
 {
 InMemoryDatabase::InMemoryDatabase() : DatabaseReferencePositionIsValid(false),
-    LoadDatabaseCallback(nullptr), LoadDatabaseCallbackThisPointer(nullptr)
+    LoadDatabaseCallback(nullptr), LoadDatabaseCallbackThisPointer(nullptr), Revision(0)
 {
 }
 
@@ -51,6 +51,7 @@ void InMemoryDatabase::RemoveSyncPoint(const AlignmentDatabaseEntry &CandidateEn
                  (std::abs(point.TelescopeDirection.z - CandidateEntry.TelescopeDirection.z) < Tolerance / 100.0)));
     }),
     MySyncPoints.end());
+    IncrementRevision();
 }
 
 
@@ -124,6 +125,7 @@ bool InMemoryDatabase::LoadDatabase(const char *DeviceName)
     }
 
     MySyncPoints.clear();
+    IncrementRevision();
 
     for (EntryRoot = nextXMLEle(EntriesRoot, 1); EntryRoot != nullptr; EntryRoot = nextXMLEle(EntriesRoot, 0))
     {
@@ -242,6 +244,7 @@ void InMemoryDatabase::SetDatabaseReferencePosition(double Latitude, double Long
     DatabaseReferencePosition.latitude    = Latitude;
     DatabaseReferencePosition.longitude    = Longitude;
     DatabaseReferencePositionIsValid = true;
+    IncrementRevision();
 }
 
 void InMemoryDatabase::SetLoadDatabaseCallback(LoadDatabaseCallbackPointer_t CallbackPointer, void *ThisPointer)
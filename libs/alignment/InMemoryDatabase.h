@@ -51,6 +51,22 @@ class InMemoryDatabase
             return MySyncPoints;
         }
 
+        /// \brief Get the current revision of the database.
+        /// The revision changes whenever the sync points or the reference position change, math plugins
+        /// use it to decide when their cached models need rebuilding.
+        /// \return The revision number
+        unsigned long GetRevision() const
+        {
+            return Revision;
+        }
+
+        /// \brief Mark the database as changed.
+        /// Call this after modifying the sync points through the reference returned by GetAlignmentDatabase.
+        void IncrementRevision()
+        {
+            Revision++;
+        }
+
         /// \brief Get the database reference position
         /// \param[in] Position A pointer to a IGeographicCoordinates object to return the current position in
         /// \return True if successful
@@ -84,6 +100,7 @@ class InMemoryDatabase
         bool DatabaseReferencePositionIsValid;
         LoadDatabaseCallbackPointer_t LoadDatabaseCallback;
         void *LoadDatabaseCallbackThisPointer;
+        unsigned long Revision;
 };
 
 } // namespace AlignmentSubsystem
@@ -154,6 +154,7 @@ void MapPropertiesToInMemoryDatabase::ProcessSwitchProperties(Telescope *pTelesc
         if (AlignmentPointSetAction[APPEND].s == ISS_ON)
         {
             AlignmentDatabase.push_back(CurrentValues);
+            IncrementRevision();
             AlignmentPointSetSize.value = AlignmentDatabase.size();
             //  Update client
             IDSetNumber(&AlignmentPointSetSizeV, nullptr);
@@ -165,6 +166,7 @@ void MapPropertiesToInMemoryDatabase::ProcessSwitchProperties(Telescope *pTelesc
             else
             {
                 AlignmentDatabase.insert(AlignmentDatabase.begin() + Offset, CurrentValues);
+                IncrementRevision();
                 AlignmentPointSetSize.value = AlignmentDatabase.size();
                 //  Update client
                 IDSetNumber(&AlignmentPointSetSizeV, nullptr);
@@ -175,7 +177,10 @@ void MapPropertiesToInMemoryDatabase::ProcessSwitchProperties(Telescope *pTelesc
             if (Offset >= AlignmentDatabase.size())
                 AlignmentPointSetCommitV.s = IPS_ALERT;
             else
+            {
                 AlignmentDatabase[Offset] = CurrentValues;
+                IncrementRevision();
+            }
         }
         else if (AlignmentPointSetAction[DELETE].s == ISS_ON)
         {
@@ -184,6 +189,7 @@ void MapPropertiesToInMemoryDatabase::ProcessSwitchProperties(Telescope *pTelesc
             else
             {
                 AlignmentDatabase.erase(AlignmentDatabase.begin() + Offset);
+                IncrementRevision();
                 AlignmentPointSetSize.value = AlignmentDatabase.size();
                 //  Update client
                 IDSetNumber(&AlignmentPointSetSizeV, nullptr);
@@ -193,6 +199,7 @@ void MapPropertiesToInMemoryDatabase::ProcessSwitchProperties(Telescope *pTelesc
         {
             // AlignmentDatabaseType().swap(AlignmentDatabase); // Do it this wasy to force a reallocation
             AlignmentDatabase.clear();
+            IncrementRevision();
             AlignmentPointSetSize.value = 0;
             //  Update client
             IDSetNumber(&AlignmentPointSetSizeV, nullptr);
@@ -58,6 +58,7 @@ extern "C" {
 ///
 //////////////////////////////////////////////////////////////////////////////////////
 NearestMathPlugin::NearestMathPlugin()
+    : InitialisedRevision(0), InitialisedSyncPointCount(0), InitialisedMountAlignment(ZENITH)
 {
 
 }
@@ -80,6 +81,12 @@ bool NearestMathPlugin::Initialise(InMemoryDatabase *pInMemoryDatabase)
     const auto &SyncPoints = pInMemoryDatabase->GetAlignmentDatabase();
     // Clear all extended alignment points so we can re-create them.
     ExtendedAlignmentPoints.clear();
+    CelestialIndex.Clear();
+    TelescopeIndex.Clear();
+
+    InitialisedRevision       = pInMemoryDatabase->GetRevision();
+    InitialisedSyncPointCount = SyncPoints.size();
+    InitialisedMountAlignment = ApproximateMountAlignment;
 
     IGeographicCoordinates Position;
     if (!pInMemoryDatabase->GetDatabaseReferencePosition(Position))
@@ -124,6 +131,18 @@ bool NearestMathPlugin::Initialise(InMemoryDatabase *pInMemoryDatabase)
         ExtendedAlignmentPoints.push_back(oneEntry);
     }
 
+    // Index both sets of horizontal coordinates so the nearest point lookups do not scan every entry
+    std::vector<TelescopeDirectionVector> CelestialVectors, TelescopeVectors;
+    CelestialVectors.reserve(ExtendedAlignmentPoints.size());
+    TelescopeVectors.reserve(ExtendedAlignmentPoints.size());
+    for (auto &oneEntry : ExtendedAlignmentPoints)
+    {
+        CelestialVectors.push_back(UnitVectorFromAzimuthAltitude(oneEntry.CelestialAzimuth, oneEntry.CelestialAltitude));
+        TelescopeVectors.push_back(UnitVectorFromAzimuthAltitude(oneEntry.TelescopeAzimuth, oneEntry.TelescopeAltitude));
+    }
+    CelestialIndex.Build(CelestialVectors);
+    TelescopeIndex.Build(TelescopeVectors);
+
     return true;
 }
 
@@ -138,6 +157,8 @@ bool NearestMathPlugin::TransformCelestialToTelescope(const double RightAscensio
     if (!pInMemoryDatabase || !pInMemoryDatabase->GetDatabaseReferencePosition(Position))
         return false;
 
+    RefreshModel();
+
     // Get Julian date from system and apply Julian Offset if any.
     double JDD = ln_get_julian_from_sys() + JulianOffset;
 
@@ -166,7 +187,7 @@ bool NearestMathPlugin::TransformCelestialToTelescope(const double RightAscensio
     }
 
     // If we have sync points, then get the Nearest Point
-    ExtendedAlignmentDatabaseEntry nearest = GetNearestPoint(CelestialAltAz.azimuth, CelestialAltAz.altitude, true);
+    const ExtendedAlignmentDatabaseEntry &nearest = GetNearestPoint(CelestialAltAz.azimuth, CelestialAltAz.altitude, true);
 
     INDI::IEquatorialCoordinates TelescopeRADE;
 
@@ -219,6 +240,8 @@ bool NearestMathPlugin::TransformTelescopeToCelestial(const TelescopeDirectionVe
     if (!pInMemoryDatabase || !pInMemoryDatabase->GetDatabaseReferencePosition(Position))
         return false;
 
+    RefreshModel();
+
     double JDD = ln_get_julian_from_sys();
 
     // Telescope Equatorial Coordinates
@@ -261,7 +284,7 @@ bool NearestMathPlugin::TransformTelescopeToCelestial(const TelescopeDirectionVe
     }
 
     // Find the nearest point to our telescope now
-    ExtendedAlignmentDatabaseEntry nearest = GetNearestPoint(TelescopeAltAz.azimuth, TelescopeAltAz.altitude, false);
+    const ExtendedAlignmentDatabaseEntry &nearest = GetNearestPoint(TelescopeAltAz.azimuth, TelescopeAltAz.altitude, false);
 
     // Now get the nearest telescope in equatorial coordinates.
     INDI::IEquatorialCoordinates NearestTelescopeRADE;
@@ -292,41 +315,35 @@ bool NearestMathPlugin::TransformTelescopeToCelestial(const TelescopeDirectionVe
 //////////////////////////////////////////////////////////////////////////////////////
 ///
 //////////////////////////////////////////////////////////////////////////////////////
-ExtendedAlignmentDatabaseEntry NearestMathPlugin::GetNearestPoint(const double Azimuth, const double Altitude,
+const ExtendedAlignmentDatabaseEntry &NearestMathPlugin::GetNearestPoint(const double Azimuth, const double Altitude,
         bool isCelestial)
 {
-    ExtendedAlignmentDatabaseEntry nearest;
-    double distance = 1e6;
-
-    for (auto &oneEntry : ExtendedAlignmentPoints)
-    {
-        double oneDistance = 0;
-
-        if (isCelestial)
-            oneDistance = SphereUnitDistance(Azimuth, oneEntry.CelestialAzimuth, Altitude, oneEntry.CelestialAltitude);
-        else
-            oneDistance = SphereUnitDistance(Azimuth, oneEntry.TelescopeAzimuth, Altitude, oneEntry.TelescopeAltitude);
-
-        if (oneDistance < distance)
-        {
-            nearest = oneEntry;
-            distance = oneDistance;
-        }
-    }
+    TelescopeDirectionVector Target = UnitVectorFromAzimuthAltitude(Azimuth, Altitude);
+    int index = isCelestial ? CelestialIndex.Nearest(Target) : TelescopeIndex.Nearest(Target);
+    return ExtendedAlignmentPoints[index];
+}
 
-    return nearest;
+//////////////////////////////////////////////////////////////////////////////////////
+///
+//////////////////////////////////////////////////////////////////////////////////////
+void NearestMathPlugin::RefreshModel()
+{
+    if ((pInMemoryDatabase->GetRevision() != InitialisedRevision) ||
+            (pInMemoryDatabase->GetAlignmentDatabase().size() != InitialisedSyncPointCount) ||
+            (ApproximateMountAlignment != InitialisedMountAlignment))
+        Initialise(pInMemoryDatabase);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////
-/// Using haversine: http://en.wikipedia.org/wiki/Haversine_formula
+///
 //////////////////////////////////////////////////////////////////////////////////////
-double NearestMathPlugin::SphereUnitDistance(double theta1, double theta2, double phi1, double phi2)
+TelescopeDirectionVector NearestMathPlugin::UnitVectorFromAzimuthAltitude(double Azimuth, double Altitude)
 {
-    double sqrt_haversin_lat  = sin(((phi2 - phi1) / 2) * (M_PI / 180));
-    double sqrt_haversin_long = sin(((theta2 - theta1) / 2) * (M_PI / 180));
-    return (2 *
-            asin(sqrt((sqrt_haversin_lat * sqrt_haversin_lat) + cos(phi1 * (M_PI / 180)) * cos(phi2 * (M_PI / 180)) *
-                      (sqrt_haversin_long * sqrt_haversin_long))));
+    double AzimuthRadians  = Azimuth * (M_PI / 180);
+    double AltitudeRadians = Altitude * (M_PI / 180);
+    return TelescopeDirectionVector(cos(AltitudeRadians) * cos(AzimuthRadians),
+                                    cos(AltitudeRadians) * sin(AzimuthRadians),
+                                    sin(AltitudeRadians));
 }
 } // namespace AlignmentSubsystem
 } // namespace INDI
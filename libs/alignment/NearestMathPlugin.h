@@ -22,6 +22,7 @@
 
 #include "AlignmentSubsystemForMathPlugins.h"
 #include "ConvexHull.h"
+#include "DirectionVectorIndex.h"
 
 namespace INDI
 {
@@ -113,25 +114,38 @@ class NearestMathPlugin : public AlignmentSubsystemForMathPlugins
 
         std::vector<ExtendedAlignmentDatabaseEntry> ExtendedAlignmentPoints;
 
+        /// Spatial indices over the celestial and telescope horizontal coordinates of ExtendedAlignmentPoints
+        DirectionVectorIndex CelestialIndex;
+        DirectionVectorIndex TelescopeIndex;
+
+        /// State of the database when the alignment points were last built
+        unsigned long InitialisedRevision;
+        size_t InitialisedSyncPointCount;
+        MountAlignment_t InitialisedMountAlignment;
+
+        /**
+         * @brief RefreshModel Initialise the plugin again if the database or mount alignment has changed since
+         * the alignment points were built.
+         */
+        void RefreshModel();
+
         /**
-         * @brief SphereUnitDistance Get distance between two points on a sphere.
-         * @param theta1 latitudal angle of object 1
-         * @param theta2 latitudal angle of object 2
-         * @param phi1 longitudal angle of object 1
-         * @param phi2 longitudal angle of object 2
-         * @return disatnce in degrees.
+         * @brief UnitVectorFromAzimuthAltitude Get the unit vector of a horizontal coordinate. The chord distance between
+         * two of these vectors grows with the angular distance on the sphere, so nearest neighbours are preserved.
+         * @param Azimuth Azimuth in degrees.
+         * @param Altitude Altitude in degrees.
+         * @return Unit vector.
          */
-        double SphereUnitDistance(double theta1, double theta2, double phi1, double phi2);
+        static TelescopeDirectionVector UnitVectorFromAzimuthAltitude(double Azimuth, double Altitude);
 
         /**
-         * @brief GetNearestPoint Traverses the ExtendedAlignmentPoints to find the closest point in horizontal coordinates on
-         * a sphere.
+         * @brief GetNearestPoint Find the closest point in horizontal coordinates on a sphere in ExtendedAlignmentPoints.
          * @param Azimuth Object azimuth in degrees.
          * @param Altitude Object altitude in degrees.
          * @param isCelestial If true, compute difference between Celestial coords, otherwise compute using Telescope coords.
-         * @return Closest point in data set.
+         * @return Closest point in data set. ExtendedAlignmentPoints must not be empty.
          */
-        ExtendedAlignmentDatabaseEntry GetNearestPoint(const double Azimuth, const double Altitude, bool isCelestial);
+        const ExtendedAlignmentDatabaseEntry &GetNearestPoint(const double Azimuth, const double Altitude, bool isCelestial);
 };
 
 } // namespace AlignmentSubsystem
@@ -26,21 +26,25 @@ void dsp_buffer_shift(dsp_stream_p stream)
     if(stream->dims == 0)
         return;
     dsp_t* tmp = (dsp_t*)malloc(sizeof(dsp_t) * stream->len);
+    int* cur = (int*)malloc(sizeof(int) * stream->dims);
+    int* pos = (int*)malloc(sizeof(int) * stream->dims);
     int x, d;
-    for(x = 0; x < stream->len/2; x++) {
-        int* pos = dsp_stream_get_position(stream, x);
+    dsp_stream_get_position_r(stream, 0, cur);
+    for(x = 0; x < stream->len/2; x++, dsp_stream_position_next(stream, cur)) {
         for(d = 0; d < stream->dims; d++) {
-            if(pos[d]<stream->sizes[d] / 2) {
-                pos[d] += stream->sizes[d] / 2;
+            if(cur[d]<stream->sizes[d] / 2) {
+                pos[d] = cur[d] + stream->sizes[d] / 2;
             } else {
-                pos[d] -= stream->sizes[d] / 2;
+                pos[d] = cur[d] - stream->sizes[d] / 2;
             }
         }
-        tmp[x] = stream->buf[dsp_stream_set_position(stream, pos)];
-        tmp[dsp_stream_set_position(stream, pos)] = stream->buf[x];
-        free(pos);
+        int idx = dsp_stream_set_position(stream, pos);
+        tmp[x] = stream->buf[idx];
+        tmp[idx] = stream->buf[x];
     }
     memcpy(stream->buf, tmp, stream->len * sizeof(dsp_t));
+    free(pos);
+    free(cur);
     free(tmp);
 }
 
@@ -253,24 +257,28 @@ static void* dsp_buffer_median_th(void* arg)
     int x, y, dim, idx;
     dsp_t* sorted = (dsp_t*)malloc(pow(size, stream->dims) * sizeof(dsp_t));
     int len = pow(size, in->dims);
-    for(x = start; x < end; x++) {
+    int *cur = (int*)malloc(sizeof(int) * stream->dims);
+    int *mat = (int*)malloc(sizeof(int) * stream->dims);
+    int *pos = (int*)malloc(sizeof(int) * stream->dims);
+    dsp_stream_get_position_r(stream, start, cur);
+    for(x = start; x < end; x++, dsp_stream_position_next(stream, cur)) {
         dsp_t* buf = sorted;
-        for(y = 0; y < box->len; y++) {
-            int *pos = dsp_stream_get_position(stream, x);
-            int *mat = dsp_stream_get_position(box, y);
+        dsp_stream_get_position_r(box, 0, mat);
+        for(y = 0; y < box->len; y++, dsp_stream_position_next(box, mat)) {
             for(dim = 0; dim < stream->dims; dim++) {
-                pos[dim] += mat[dim] - size / 2;
+                pos[dim] = cur[dim] + mat[dim] - size / 2;
             }
             idx = dsp_stream_set_position(stream, pos);
             if(idx >= 0 && idx < in->len) {
                 *buf++ = in->buf[idx];
             }
-            free(pos);
-            free(mat);
         }
         qsort(sorted, len, sizeof(dsp_t), compare);
         stream->buf[x] = sorted[median*box->len/size];
     }
+    free(pos);
+    free(mat);
+    free(cur);
     dsp_stream_free_buffer(box);
     dsp_stream_free(box);
     free(sorted);
@@ -332,23 +340,27 @@ static void* dsp_buffer_sigma_th(void* arg)
     int x, y, dim, idx;
     dsp_t* sigma = (dsp_t*)malloc(pow(size, stream->dims) * sizeof(dsp_t));
     int len = pow(size, in->dims);
-    for(x = start; x < end; x++) {
+    int *cur = (int*)malloc(sizeof(int) * stream->dims);
+    int *mat = (int*)malloc(sizeof(int) * stream->dims);
+    int *pos = (int*)malloc(sizeof(int) * stream->dims);
+    dsp_stream_get_position_r(stream, start, cur);
+    for(x = start; x < end; x++, dsp_stream_position_next(stream, cur)) {
         dsp_t* buf = sigma;
-        for(y = 0; y < box->len; y++) {
-            int *pos = dsp_stream_get_position(stream, x);
-            int *mat = dsp_stream_get_position(box, y);
+        dsp_stream_get_position_r(box, 0, mat);
+        for(y = 0; y < box->len; y++, dsp_stream_position_next(box, mat)) {
             for(dim = 0; dim < stream->dims; dim++) {
-                pos[dim] += mat[dim] - size / 2;
+                pos[dim] = cur[dim] + mat[dim] - size / 2;
             }
             idx = dsp_stream_set_position(stream, pos);
             if(idx >= 0 && idx < in->len) {
                 buf[y] = in->buf[idx];
             }
-            free(pos);
-            free(mat);
         }
         stream->buf[x] = dsp_stats_stddev(buf, len);
     }
+    free(pos);
+    free(mat);
+    free(cur);
     dsp_stream_free_buffer(box);
     dsp_stream_free(box);
     free(sigma);
@@ -24,16 +24,17 @@ void dsp_convolution_convolution(dsp_stream_p stream, dsp_stream_p matrix) {
     dsp_t mn = dsp_stats_min(stream->buf, stream->len);
     dsp_t mx = dsp_stats_max(stream->buf, stream->len);
     int* d_pos = (int*)malloc(sizeof(int)*stream->dims);
-    for(y = 0; y < matrix->len; y++) {
-        int* pos = dsp_stream_get_position(matrix, y);
+    int* pos = (int*)malloc(sizeof(int)*matrix->dims);
+    dsp_stream_get_position_r(matrix, 0, pos);
+    for(y = 0; y < matrix->len; y++, dsp_stream_position_next(matrix, pos)) {
         for(d = 0; d < stream->dims; d++) {
             d_pos[d] = stream->sizes[d]/2+pos[d]-matrix->sizes[d]/2;
         }
         x = dsp_stream_set_position(stream, d_pos);
-        free(pos);
         if(x >= 0 && x < stream->magnitude->len)
             stream->magnitude->buf[x] *= sqrt(matrix->magnitude->buf[y]);
     }
+    free(pos);
     free(d_pos);
     dsp_fourier_idft(stream);
     dsp_buffer_stretch(stream->buf, stream->len, mn, mx);
@@ -45,16 +46,17 @@ void dsp_convolution_correlation(dsp_stream_p stream, dsp_stream_p matrix) {
     dsp_t mx = dsp_stats_max(stream->buf, stream->len);
     int* d_pos = (int*)malloc(sizeof(int)*stream->dims);
     dsp_buffer_shift(matrix->magnitude);
-    for(y = 0; y < matrix->len; y++) {
-        int* pos = dsp_stream_get_position(matrix, y);
+    int* pos = (int*)malloc(sizeof(int)*matrix->dims);
+    dsp_stream_get_position_r(matrix, 0, pos);
+    for(y = 0; y < matrix->len; y++, dsp_stream_position_next(matrix, pos)) {
         for(d = 0; d < stream->dims; d++) {
             d_pos[d] = stream->sizes[d]/2+pos[d]-matrix->sizes[d]/2;
         }
         x = dsp_stream_set_position(stream, d_pos);
-        free(pos);
         stream->magnitude->buf[x] *= sqrt(matrix->magnitude->buf[y]);
     }
     dsp_buffer_shift(matrix->magnitude);
+    free(pos);
     free(d_pos);
     dsp_fourier_idft(stream);
     dsp_buffer_stretch(stream->buf, stream->len, mn, mx);
@@ -500,6 +500,35 @@ DLL_EXPORT double* dsp_fourier_complex_array_get_magnitude(dsp_complex in, int l
 */
 DLL_EXPORT double* dsp_fourier_complex_array_get_phase(dsp_complex in, int len);
 
+/**
+* \brief Destroy all the cached FFTW plans
+* \sa dsp_fourier_plans_count
+*/
+DLL_EXPORT void dsp_fourier_plans_clear(void);
+
+/**
+* \brief Obtain the number of FFTW plans currently cached
+* \return the number of cached plans, one for each dimensions, sizes and direction combination used so far
+* \sa dsp_fourier_plans_clear
+*/
+DLL_EXPORT int dsp_fourier_plans_count(void);
+
+/**
+* \brief Import FFTW wisdom from a file, so that newly created plans can reuse it
+* \param filename the wisdom file path.
+* \return non-zero on success
+* \sa dsp_fourier_wisdom_export
+*/
+DLL_EXPORT int dsp_fourier_wisdom_import(const char *filename);
+
+/**
+* \brief Export the FFTW wisdom accumulated so far to a file
+* \param filename the wisdom file path.
+* \return non-zero on success
+* \sa dsp_fourier_wisdom_import
+*/
+DLL_EXPORT int dsp_fourier_wisdom_export(const char *filename);
+
 /**\}*/
 /**
  * \defgroup dsp_Filters DSP API Linear buffer filtering functions
@@ -1252,6 +1281,24 @@ DLL_EXPORT int dsp_stream_set_position(dsp_stream_p stream, int *pos);
 */
 DLL_EXPORT int* dsp_stream_get_position(dsp_stream_p stream, int index);
 
+/**
+* \brief Fill a caller provided array with the multidimensional positional indexes of a linear index
+* \param stream the target DSP stream.
+* \param index the position of the index on a single dimension.
+* \param pos the array, of stream->dims elements, that will receive the position on each dimension.
+* \sa dsp_stream_get_position
+* \sa dsp_stream_position_next
+*/
+DLL_EXPORT void dsp_stream_get_position_r(dsp_stream_p stream, int index, int *pos);
+
+/**
+* \brief Advance multidimensional positional indexes to the next linear index without divisions or allocations
+* \param stream the target DSP stream.
+* \param pos the position on each dimension, updated in-place.
+* \sa dsp_stream_get_position_r
+*/
+DLL_EXPORT void dsp_stream_position_next(dsp_stream_p stream, int *pos);
+
 /**
 * \brief Execute the function callback pointed by the func field of the passed stream
 * \param stream the target DSP stream.
@@ -20,6 +20,96 @@
 #include "dsp.h"
 #include <fftw3.h>
 
+/**
+ * Plans are keyed by dimensions, sizes and direction. They are created with FFTW_UNALIGNED
+ * on scratch arrays and executed through the new-array interface, so one plan can serve
+ * every stream with the same geometry, including concurrent executions.
+ */
+typedef struct dsp_fourier_plan_t
+{
+    int dims;
+    int *sizes;
+    int direction;
+    fftw_plan plan;
+    struct dsp_fourier_plan_t *next;
+} dsp_fourier_plan;
+
+static dsp_fourier_plan *dsp_fourier_plans = NULL;
+static pthread_mutex_t dsp_fourier_plans_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static fftw_plan dsp_fourier_get_plan(int dims, int *sizes, int direction)
+{
+    int d;
+    size_t len = 1;
+    dsp_fourier_plan *cur;
+    pthread_mutex_lock(&dsp_fourier_plans_mutex);
+    for(cur = dsp_fourier_plans; cur != NULL; cur = cur->next) {
+        if(cur->dims == dims && cur->direction == direction && !memcmp(cur->sizes, sizes, sizeof(int) * dims)) {
+            pthread_mutex_unlock(&dsp_fourier_plans_mutex);
+            return cur->plan;
+        }
+    }
+    for(d = 0; d < dims; d++)
+        len *= sizes[d];
+    double *in = fftw_alloc_real(len);
+    fftw_complex *out = fftw_alloc_complex(len);
+    cur = (dsp_fourier_plan*)malloc(sizeof(dsp_fourier_plan));
+    cur->dims = dims;
+    cur->direction = direction;
+    cur->sizes = (int*)malloc(sizeof(int) * dims);
+    memcpy(cur->sizes, sizes, sizeof(int) * dims);
+    if(direction == FFTW_FORWARD)
+        cur->plan = fftw_plan_dft_r2c(dims, sizes, in, out, FFTW_ESTIMATE_PATIENT | FFTW_UNALIGNED);
+    else
+        cur->plan = fftw_plan_dft_c2r(dims, sizes, out, in, FFTW_ESTIMATE_PATIENT | FFTW_UNALIGNED);
+    fftw_free(in);
+    fftw_free(out);
+    cur->next = dsp_fourier_plans;
+    dsp_fourier_plans = cur;
+    pthread_mutex_unlock(&dsp_fourier_plans_mutex);
+    return cur->plan;
+}
+
+void dsp_fourier_plans_clear(void)
+{
+    pthread_mutex_lock(&dsp_fourier_plans_mutex);
+    while(dsp_fourier_plans != NULL) {
+        dsp_fourier_plan *next = dsp_fourier_plans->next;
+        fftw_destroy_plan(dsp_fourier_plans->plan);
+        free(dsp_fourier_plans->sizes);
+        free(dsp_fourier_plans);
+        dsp_fourier_plans = next;
+    }
+    pthread_mutex_unlock(&dsp_fourier_plans_mutex);
+}
+
+int dsp_fourier_plans_count(void)
+{
+    int count = 0;
+    dsp_fourier_plan *cur;
+    pthread_mutex_lock(&dsp_fourier_plans_mutex);
+    for(cur = dsp_fourier_plans; cur != NULL; cur = cur->next)
+        count++;
+    pthread_mutex_unlock(&dsp_fourier_plans_mutex);
+    return count;
+}
+
+int dsp_fourier_wisdom_import(const char *filename)
+{
+    pthread_mutex_lock(&dsp_fourier_plans_mutex);
+    int ret = fftw_import_wisdom_from_filename(filename);
+    pthread_mutex_unlock(&dsp_fourier_plans_mutex);
+    return ret;
+}
+
+int dsp_fourier_wisdom_export(const char *filename)
+{
+    pthread_mutex_lock(&dsp_fourier_plans_mutex);
+    int ret = fftw_export_wisdom_to_filename(filename);
+    pthread_mutex_unlock(&dsp_fourier_plans_mutex);
+    return ret;
+}
+
 static void dsp_fourier_dft_magnitude(dsp_stream_p stream)
 {
     if(stream->magnitude)
@@ -34,21 +124,23 @@ static void dsp_fourier_dft_phase(dsp_stream_p stream)
 
 void dsp_fourier_2dsp(dsp_stream_p stream)
 {
-    int x, y;
+    int x, y, pos;
     complex_t *dft = (complex_t*)malloc(sizeof(complex_t) * stream->len);
     memcpy(dft, stream->dft.pairs, sizeof(complex_t) * stream->len);
     y = 0;
+    pos = 0;
     for(x = 0; x < stream->len && y < stream->len; x++) {
-        int *pos = dsp_stream_get_position(stream, x);
-        if(pos[0] <= stream->sizes[0] / 2) {
+        if(pos <= stream->sizes[0] / 2) {
             stream->dft.pairs[x][0] = dft[y][0];
             stream->dft.pairs[x][1] = dft[y][1];
             stream->dft.pairs[stream->len-1-x][0] = dft[y][0];
             stream->dft.pairs[stream->len-1-x][1] = dft[y][1];
             y++;
         }
-        free(pos);
+        if(++pos == stream->sizes[0])
+            pos = 0;
     }
+    free(dft);
     dsp_fourier_dft_magnitude(stream);
     dsp_buffer_shift(stream->magnitude);
     dsp_fourier_dft_phase(stream);
@@ -57,7 +149,7 @@ void dsp_fourier_2dsp(dsp_stream_p stream)
 
 void dsp_fourier_2complex_t(dsp_stream_p stream)
 {
-    int x, y;
+    int x, y, pos;
     if(!stream->phase || !stream->magnitude) return;
     dsp_buffer_shift(stream->magnitude);
     dsp_buffer_shift(stream->phase);
@@ -66,14 +158,15 @@ void dsp_fourier_2complex_t(dsp_stream_p stream)
     memcpy(dft, stream->dft.pairs, sizeof(complex_t) * stream->len);
     dsp_buffer_set(stream->dft.buf, stream->len*2, 0);
     y = 0;
+    pos = 0;
     for(x = 0; x < stream->len; x++) {
-        int *pos = dsp_stream_get_position(stream, x);
-        if(pos[0] <= stream->sizes[0] / 2) {
+        if(pos <= stream->sizes[0] / 2) {
             stream->dft.pairs[y][0] = dft[x][0];
             stream->dft.pairs[y][1] = dft[x][1];
             y++;
         }
-        free(pos);
+        if(++pos == stream->sizes[0])
+            pos = 0;
     }
     free(dft);
 }
@@ -146,9 +239,8 @@ void dsp_fourier_dft(dsp_stream_p stream, int exp)
     int *sizes = (int*)malloc(sizeof(int)*stream->dims);
     dsp_buffer_copy(stream->sizes, sizes, stream->dims);
     dsp_buffer_reverse(sizes, stream->dims);
-    fftw_plan plan = fftw_plan_dft_r2c(stream->dims, sizes, buf, stream->dft.pairs, FFTW_ESTIMATE_PATIENT);
-    fftw_execute(plan);
-    fftw_free(plan);
+    fftw_plan plan = dsp_fourier_get_plan(stream->dims, sizes, FFTW_FORWARD);
+    fftw_execute_dft_r2c(plan, buf, stream->dft.pairs);
     free(sizes);
     free(buf);
     dsp_fourier_2dsp(stream);
@@ -180,9 +272,8 @@ void dsp_fourier_idft(dsp_stream_p stream)
     int *sizes = (int*)malloc(sizeof(int)*stream->dims);
     dsp_buffer_copy(stream->sizes, sizes, stream->dims);
     dsp_buffer_reverse(sizes, stream->dims);
-    fftw_plan plan = fftw_plan_dft_c2r(stream->dims, sizes, stream->dft.pairs, buf, FFTW_ESTIMATE_PATIENT);
-    fftw_execute(plan);
-    fftw_free(plan);
+    fftw_plan plan = dsp_fourier_get_plan(stream->dims, sizes, FFTW_BACKWARD);
+    fftw_execute_dft_c2r(plan, stream->dft.pairs, buf);
     free(sizes);
     dsp_buffer_stretch(buf, stream->len, mn, mx);
     dsp_buffer_copy(buf, stream->buf, stream->len);
@@ -449,17 +449,37 @@ void dsp_stream_del_triangle(dsp_stream_p stream, int index)
  * @return
  */
 int* dsp_stream_get_position(dsp_stream_p stream, int index) {
-    int dim = 0;
-    int y = 0;
-    int m = 1;
     int* pos = (int*)malloc(sizeof(int) * stream->dims);
+    dsp_stream_get_position_r(stream, index, pos);
+    return pos;
+}
+
+/**
+ * @brief dsp_stream_get_position_r
+ * @param stream
+ * @param index
+ * @param pos
+ */
+void dsp_stream_get_position_r(dsp_stream_p stream, int index, int* pos) {
+    int dim = 0;
     for (dim = 0; dim < stream->dims; dim++) {
-        y = index / m;
-        y %= stream->sizes[dim];
-        m *= stream->sizes[dim];
-        pos[dim] = y;
+        pos[dim] = index % stream->sizes[dim];
+        index /= stream->sizes[dim];
+    }
+}
+
+/**
+ * @brief dsp_stream_position_next
+ * @param stream
+ * @param pos
+ */
+void dsp_stream_position_next(dsp_stream_p stream, int* pos) {
+    int dim = 0;
+    for (dim = 0; dim < stream->dims; dim++) {
+        if(++pos[dim] < stream->sizes[dim])
+            return;
+        pos[dim] = 0;
     }
-    return pos;
 }
 
 /**
@@ -492,9 +512,12 @@ static void* dsp_stream_align_th(void* arg)
     int end = start + stream->len / dsp_max_threads(0);
     end = Min(stream->len, end);
     int y;
-    for(y = start; y < end; y++)
+    int *cur = (int*)malloc(sizeof(int) * stream->dims);
+    int *pos = (int*)malloc(sizeof(int) * stream->dims);
+    dsp_stream_get_position_r(stream, start, cur);
+    for(y = start; y < end; y++, dsp_stream_position_next(stream, cur))
     {
-        int *pos = dsp_stream_get_position(stream, y);
+        memcpy(pos, cur, sizeof(int) * stream->dims);
         int dim;
         for (dim = 1; dim < stream->dims; dim++) {
             pos[dim] -= stream->align_info.center[dim];
@@ -516,10 +539,11 @@ static void* dsp_stream_align_th(void* arg)
             pos[dim-1] += stream->align_info.center[dim-1];
         }
         int x = dsp_stream_set_position(in, pos);
-        free(pos);
         if(x >= 0 && x < in->len)
             stream->buf[y] = in->buf[x];
     }
+    free(pos);
+    free(cur);
     return NULL;
 }
 
@@ -565,9 +589,12 @@ static void* dsp_stream_crop_th(void* arg)
     int end = start + stream->len / dsp_max_threads(0);
     end = Min(stream->len, end);
     int y;
-    for(y = start; y < end; y++)
+    int *cur = (int*)malloc(sizeof(int) * stream->dims);
+    int *pos = (int*)malloc(sizeof(int) * stream->dims);
+    dsp_stream_get_position_r(stream, start, cur);
+    for(y = start; y < end; y++, dsp_stream_position_next(stream, cur))
     {
-        int *pos = dsp_stream_get_position(stream, y);
+        memcpy(pos, cur, sizeof(int) * stream->dims);
         int dim;
         int allow = 1;
         for (dim = 0; dim < stream->dims; dim++) {
@@ -581,8 +608,9 @@ static void* dsp_stream_crop_th(void* arg)
         }
         else
             stream->buf[y] = 0;
-        free(pos);
     }
+    free(pos);
+    free(cur);
     return NULL;
 }
 
@@ -647,9 +675,12 @@ static void* dsp_stream_scale_th(void* arg)
     int end = start + stream->len / dsp_max_threads(0);
     end = Min(stream->len, end);
     int y, d;
-    for(y = start; y < end; y++)
+    int *cur = (int*)malloc(sizeof(int) * stream->dims);
+    int *pos = (int*)malloc(sizeof(int) * stream->dims);
+    dsp_stream_get_position_r(stream, start, cur);
+    for(y = start; y < end; y++, dsp_stream_position_next(stream, cur))
     {
-        int* pos = dsp_stream_get_position(stream, y);
+        memcpy(pos, cur, sizeof(int) * stream->dims);
         double factor = 0.0;
         for(d = 0; d < stream->dims; d++) {
             pos[d] -= stream->align_info.center[d];
@@ -661,8 +692,9 @@ static void* dsp_stream_scale_th(void* arg)
         int x = dsp_stream_set_position(in, pos);
         if(x >= 0 && x < in->len)
             stream->buf[y] += in->buf[x]/(factor*stream->dims);
-        free(pos);
     }
+    free(pos);
+    free(cur);
     return NULL;
 }
 
@@ -703,9 +735,12 @@ static void* dsp_stream_rotate_th(void* arg)
     int end = start + stream->len / dsp_max_threads(0);
     end = Min(stream->len, end);
     int y;
-    for(y = start; y < end; y++)
+    int *cur = (int*)malloc(sizeof(int) * stream->dims);
+    int *pos = (int*)malloc(sizeof(int) * stream->dims);
+    dsp_stream_get_position_r(stream, start, cur);
+    for(y = start; y < end; y++, dsp_stream_position_next(stream, cur))
     {
-        int *pos = dsp_stream_get_position(stream, y);
+        memcpy(pos, cur, sizeof(int) * stream->dims);
         int dim;
         for (dim = 1; dim < stream->dims; dim++) {
             pos[dim] -= stream->align_info.center[dim];
@@ -721,10 +756,11 @@ static void* dsp_stream_rotate_th(void* arg)
             pos[dim-1] += stream->align_info.center[dim-1];
         }
         int x = dsp_stream_set_position(in, pos);
-        free(pos);
         if(x >= 0 && x < in->len)
             stream->buf[y] = in->buf[x];
     }
+    free(pos);
+    free(cur);
     return NULL;
 }
 
@@ -782,14 +818,15 @@ static void* dsp_stream_stack_th(void* arg)
     int end = start + stream->len / dsp_max_threads(0);
     end = Min(stream->len, end);
     int y;
-    for(y = start; y < end; y++)
+    int *pos = (int*)malloc(sizeof(int) * stream->dims);
+    dsp_stream_get_position_r(stream, start, pos);
+    for(y = start; y < end; y++, dsp_stream_position_next(stream, pos))
     {
-        int *pos = dsp_stream_get_position(stream, y);
         int x = dsp_stream_set_position(in, pos);
-        free(pos);
         if(x >= 0 && x < in->len)
             stream->buf[y] = delegate(stream->buf[y], in->buf[x]);
     }
+    free(pos);
     return NULL;
 }
 
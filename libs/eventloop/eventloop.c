@@ -29,6 +29,9 @@
  * work procedures may be registered that are called when there is nothing
  *   else to do;
  *
+ * timers run on a clock that is either the monotonic clock of the system,
+ *   or a virtual one that runs faster or only moves when told to, see setClock();
+ *
  #define MAIN_TEST for a stand-alone test program.
  */
 
@@ -79,7 +82,16 @@ typedef struct TF
 static TF  timefunc_null = {0, 0, NULL, NULL, 0, NULL};
 static TF *timefunc = &timefunc_null;  /* list of timer functions */
 static int tid = 0;    /* source of unique timer ids */
-#define EPOCHDT(tp) /* ms from epoch to timeval *tp */ (((tp)->tv_usec) / 1000.0 + ((tp)->tv_sec) * 1000.0)
+
+/* the clock timers run on, ms.
+ * a virtual clock goes on from the time it had when it was set, so that timers already registered keep their
+ * trigger time. the stepped one is read from other threads by ElapsedTimer, it is accessed atomically.
+ */
+static int clockMode = EVENTLOOP_CLOCK_REALTIME;
+static double clockRate = 1;     /* virtual ms per real ms, 1 but when accelerated */
+static double clockRealBase = 0; /* real and clock time when the clock was set */
+static double clockBase = 0;
+static double clockStepped = 0;  /* stepped: time now */
 
 /* info about one registered work procedure.
  * the malloced array wproc is never shrunk, entries are reused. new id's are
@@ -96,7 +108,10 @@ static int nwproc;   /* n entries in wproc[] */
 static int nwpinuse; /* n entries in wproc[] marked in-use */
 static int lastwp;   /* wproc index of last workproc called*/
 
+static volatile int loopBreak; /* set to make eventLoop() return */
+
 static void runWorkProc(void);
+static double realNow(void);
 static void callCallback(fd_set *rfdp);
 static void checkTimer();
 static void oneLoop(void);
@@ -104,15 +119,22 @@ static void deferTO(void *p);
 static void runImmediates();
 
 /* inf loop to dispatch callbacks, work procs and timers as necessary.
- * never returns.
+ * only returns after breakEventLoop().
  */
 void eventLoop()
 {
-    /* run loop forever */
-    while (1)
+    /* run loop until told to stop */
+    loopBreak = 0;
+    while (!loopBreak)
         oneLoop();
 }
 
+/* make eventLoop() return once the callback, timer or work proc running now is done */
+void breakEventLoop()
+{
+    loopBreak = 1;
+}
+
 /* allow other timers/callbacks/workprocs to run until time out in maxms
  * or *flagp becomes non-0. wait forever if maxms is 0.
  * return 0 if flag did flip, else -1 if never changed and we timed out.
@@ -228,12 +250,8 @@ static void insertTimer(TF *node)
  */
 static int addTimerImpl(int delay, int interval, TCF *fp, void *ud)
 {
-    struct timeval t;
     TF *node;
 
-    /* get time now */
-    gettimeofday(&t, NULL);
-
     /* create entry */
     node = (TF*)malloc(sizeof(TF));
 
@@ -241,7 +259,7 @@ static int addTimerImpl(int delay, int interval, TCF *fp, void *ud)
     node->ud  = ud;
     node->fp  = fp;
     node->tid = ++tid; /* store new unique id */
-    node->tgo = EPOCHDT(&t) + delay;
+    node->tgo = clockNow() + delay;
     node->interval = interval;
 
     insertTimer(node);
@@ -304,9 +322,7 @@ void rmTimer(int timer_id)
 /* Returns the timer's remaining value in milliseconds left until the timeout. */
 static double remainingTimerNode(TF *node)
 {
-    struct timeval now;
-    gettimeofday(&now, NULL);
-    return (node->tgo - EPOCHDT(&now));
+    return (node->tgo - clockNow());
 }
 
 /* Returns the timer's remaining value in milliseconds left until the timeout.
@@ -466,7 +482,7 @@ static void oneLoop()
     /* determine timeout:
 	 * if there are work procs
 	 *   set delay = 0
-	 * else if there is at least one timer func
+	 * else if there is at least one timer func, and the clock runs or the timer is due
 	 *   set delay = time until soonest timer func expires
 	 * else
 	 *   set delay = forever
@@ -476,11 +492,13 @@ static void oneLoop()
         tvp         = &tv;
         tvp->tv_sec = tvp->tv_usec = 0;
     }
-    else if (timefunc->next != NULL)
+    else if (timefunc->next != NULL &&
+             (clockMode != EVENTLOOP_CLOCK_STEPPED || remainingTimerNode(timefunc->next) <= 0))
     {
         double late = remainingTimerNode(timefunc->next); /* ms late */
         if (late < 0)
             late = 0;
+        late /= clockRate; /* real ms late */
         late /= 1000.0; /* secs late */
         tvp          = &tv;
         tvp->tv_sec  = (long)floor(late);
@@ -507,6 +525,77 @@ static void oneLoop()
     runImmediates();
 }
 
+static double realNow(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+double clockNow(void)
+{
+    double now;
+
+    if (clockMode == EVENTLOOP_CLOCK_STEPPED)
+    {
+        __atomic_load(&clockStepped, &now, __ATOMIC_RELAXED);
+        return now;
+    }
+
+    /* back on the clock of the system, the time goes on from where a virtual clock left it */
+    return clockBase + (realNow() - clockRealBase) * clockRate;
+}
+
+int getClockMode(void)
+{
+    return clockMode;
+}
+
+void setClock(int mode, double rate)
+{
+    double now = clockNow();
+
+    clockRealBase = realNow();
+    clockBase     = now;
+    __atomic_store(&clockStepped, &now, __ATOMIC_RELAXED);
+    clockRate = mode == EVENTLOOP_CLOCK_ACCELERATED && rate > 0 ? rate : 1;
+    clockMode = mode;
+}
+
+/* fire the timers due until ms from now in the order they are due, the clock reading the time each is due,
+ * then leave the clock at ms from now.
+ */
+void advanceClock(double ms)
+{
+    double target;
+    TF *node;
+
+    if (ms <= 0)
+        return;
+
+    switch (clockMode)
+    {
+        case EVENTLOOP_CLOCK_ACCELERATED:
+            clockBase += ms;
+            break;
+
+        case EVENTLOOP_CLOCK_STEPPED:
+            target = clockNow() + ms;
+            while ((node = timefunc->next) != NULL && node->tgo <= target)
+            {
+                if (node->tgo > clockNow())
+                    __atomic_store(&clockStepped, &node->tgo, __ATOMIC_RELAXED);
+                checkTimer();
+                runImmediates();
+            }
+            __atomic_store(&clockStepped, &target, __ATOMIC_RELAXED);
+            break;
+
+        default:
+            break;
+    }
+}
+
 /* timer callback used to implement deferLoop().
  * arg is pointer to int which we set to 1
  */
@@ -572,6 +661,7 @@ void runImmediates() {
 typedef void(IE_CBF)(int readfiledes, void *userpointer);
 typedef void(IE_TCF)(void *userpointer);
 typedef void(IE_WPF)(void *userpointer);
+typedef enum { IE_CLOCK_REALTIME, IE_CLOCK_ACCELERATED, IE_CLOCK_STEPPED } IEClockMode;
 
 int IEAddCallback(int readfiledes, IE_CBF *fp, void *p)
 {
@@ -628,6 +718,26 @@ int IEDeferLoop0(int maxms, int *flagp)
     return (deferLoop0(maxms, flagp));
 }
 
+void IESetClock(IEClockMode mode, double rate)
+{
+    setClock(mode, rate);
+}
+
+IEClockMode IEGetClockMode(void)
+{
+    return ((IEClockMode)getClockMode());
+}
+
+double IEClockNow(void)
+{
+    return (clockNow());
+}
+
+void IEAdvanceClock(double ms)
+{
+    advanceClock(ms);
+}
+
 #if defined(MAIN_TEST)
 /* make a small stand-alone test program.
  */
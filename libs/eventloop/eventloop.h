@@ -56,6 +56,11 @@ extern "C" {
 */
 extern void eventLoop();
 
+/** \fn void breakEventLoop()
+    \brief Make eventLoop() return once the current callback, timer or work procedure is done.
+*/
+extern void breakEventLoop();
+
 /** Register a new callback, \e fp, to be called with \e ud as argument when \e fd is ready.
 *
 * \param fd file descriptor.
@@ -123,6 +128,36 @@ extern int nsecRemainingTimer(int tid);
 */
 extern void rmTimer(int tid);
 
+/** Clocks the timers can run on, see setClock(). */
+enum
+{
+    EVENTLOOP_CLOCK_REALTIME,    /**< the monotonic clock of the system */
+    EVENTLOOP_CLOCK_ACCELERATED, /**< runs faster than the clock of the system by a constant factor */
+    EVENTLOOP_CLOCK_STEPPED      /**< only moves when advanceClock() is called */
+};
+
+/** Select the clock timers run on, and that clockNow() reads. The time goes on from where the clock was, timers
+ * already registered keep their trigger time.
+ *
+ * \param mode one of EVENTLOOP_CLOCK_REALTIME, EVENTLOOP_CLOCK_ACCELERATED or EVENTLOOP_CLOCK_STEPPED.
+ * \param rate how many times faster than real time the accelerated clock runs, ignored by the other clocks.
+ */
+extern void setClock(int mode, double rate);
+
+/** \return the clock selected by setClock(), EVENTLOOP_CLOCK_REALTIME unless set. */
+extern int getClockMode(void);
+
+/** \return the time on the clock timers run on, in milliseconds from an arbitrary origin. */
+extern double clockNow(void);
+
+/** Move a virtual clock forward. The stepped clock stops at the time each timer due meanwhile is due and runs it,
+ * in order, before this returns. The accelerated clock jumps forward, the timers due run in the event loop. The
+ * clock of the system is not changed.
+ *
+ * \param ms milliseconds to move the clock forward by.
+ */
+extern void advanceClock(double ms);
+
 /** Register a given function to be called once after the current loop
  * \param fp a pointer to the callback function.
  * \param ud a pointer to be passed to the callback function when called.
@@ -220,13 +220,42 @@ int AbstractBaseClientPrivate::messageCmd(const LilXmlElement &root, char *errms
     return 0;
 }
 
+void AbstractBaseClientPrivate::userIoGetProperties(const char *dev, const char *name)
+{
+    MessageScope message(this);
+    if (compressedTransport.empty())
+    {
+        IUUserIOGetProperties(&io, this, dev, name);
+    }
+    else
+    {
+        // Same as IUUserIOGetProperties, plus the compression request
+        userio_printf    (&io, this, "<getProperties version='%g' compression='%s'", INDIV, compressedTransport.c_str());
+        compressedTransport.clear();
+        if (dev && dev[0])
+        {
+            userio_prints    (&io, this, " device='");
+            userio_xml_escape(&io, this, dev);
+            userio_prints    (&io, this, "'");
+        }
+        if (name && name[0])
+        {
+            userio_prints    (&io, this, " name='");
+            userio_xml_escape(&io, this, name);
+            userio_prints    (&io, this, "'");
+        }
+        userio_prints    (&io, this, "/>\n");
+    }
+
+    if (verbose)
+        IUUserIOGetProperties(userio_file(), stderr, dev, name);
+}
+
 void AbstractBaseClientPrivate::userIoGetProperties()
 {
     if (watchDevice.isEmpty())
     {
-        IUUserIOGetProperties(&io, this, nullptr, nullptr);
-        if (verbose)
-            IUUserIOGetProperties(userio_file(), stderr, nullptr, nullptr);
+        userIoGetProperties(nullptr, nullptr);
     }
     else
     {
@@ -235,17 +264,13 @@ void AbstractBaseClientPrivate::userIoGetProperties()
             // If there are no specific properties to watch, we watch the complete device
             if (deviceInfo.second.properties.size() == 0)
             {
-                IUUserIOGetProperties(&io, this, deviceInfo.first.c_str(), nullptr);
-                if (verbose)
-                    IUUserIOGetProperties(userio_file(), stderr, deviceInfo.first.c_str(), nullptr);
+                userIoGetProperties(deviceInfo.first.c_str(), nullptr);
             }
             else
             {
                 for (const auto &oneProperty : deviceInfo.second.properties)
                 {
-                    IUUserIOGetProperties(&io, this, deviceInfo.first.c_str(), oneProperty.c_str());
-                    if (verbose)
-                        IUUserIOGetProperties(userio_file(), stderr, deviceInfo.first.c_str(), oneProperty.c_str());
+                    userIoGetProperties(deviceInfo.first.c_str(), oneProperty.c_str());
                 }
             }
         }
@@ -441,6 +466,7 @@ void AbstractBaseClient::setBLOBMode(BLOBHandling blobH, const char *dev, const
         bMode->blobMode = blobH;
     }
 
+    MessageScope message(d);
     IUUserIOEnableBLOB(&d->io, d, dev, prop, blobH);
 }
 
@@ -461,6 +487,7 @@ void AbstractBaseClient::sendNewProperty(INDI::Property pp)
 {
     D_PTR(AbstractBaseClient);
     pp.setState(IPS_BUSY);
+    MessageScope message(d);
     // #PS: TODO more generic
     switch (pp.getType())
     {
@@ -491,6 +518,7 @@ void AbstractBaseClient::sendNewText(INDI::Property pp)
     AutoCNumeric locale;
 
     pp.setState(IPS_BUSY);
+    MessageScope message(d);
     IUUserIONewText(&d->io, d, pp.getText()->cast());
 }
 
@@ -517,6 +545,7 @@ void AbstractBaseClient::sendNewNumber(INDI::Property pp)
     D_PTR(AbstractBaseClient);
     AutoCNumeric locale;
     pp.setState(IPS_BUSY);
+    MessageScope message(d);
     IUUserIONewNumber(&d->io, d, pp.getNumber()->cast());
 }
 
@@ -542,6 +571,7 @@ void AbstractBaseClient::sendNewSwitch(INDI::Property pp)
 {
     D_PTR(AbstractBaseClient);
     pp.setState(IPS_BUSY);
+    MessageScope message(d);
     IUUserIONewSwitch(&d->io, d, pp.getSwitch()->cast());
 }
 
@@ -565,6 +595,8 @@ void AbstractBaseClient::sendNewSwitch(const char *deviceName, const char *prope
 void AbstractBaseClient::startBlob(const char *devName, const char *propName, const char *timestamp)
 {
     D_PTR(AbstractBaseClient);
+    // Held until finishBlob()
+    d->beginMessage();
     IUUserIONewBLOBStart(&d->io, d, devName, propName, timestamp);
 }
 
@@ -596,17 +628,20 @@ void AbstractBaseClient::finishBlob()
 {
     D_PTR(AbstractBaseClient);
     IUUserIONewBLOBFinish(&d->io, d);
+    d->endMessage();
 }
 
 void AbstractBaseClient::sendPingRequest(const char * uuid)
 {
     D_PTR(AbstractBaseClient);
+    MessageScope message(d);
     IUUserIOPingRequest(&d->io, d, uuid);
 }
 
 void AbstractBaseClient::sendPingReply(const char * uuid)
 {
     D_PTR(AbstractBaseClient);
+    MessageScope message(d);
     IUUserIOPingReply(&d->io, d, uuid);
 }
 
@@ -51,6 +51,10 @@ class AbstractBaseClientPrivate
     public:
         virtual ssize_t sendData(const void *data, size_t size) = 0;
 
+        /** @brief Bracket the writes of one message, sendData() may hold them until the outermost end */
+        virtual void beginMessage() {}
+        virtual void endMessage() {}
+
     public:
         void clear();
 
@@ -70,6 +74,10 @@ class AbstractBaseClientPrivate
     public:
         void userIoGetProperties();
 
+    protected:
+        /** @brief Send one getProperties, asking for compressedTransport on the first one */
+        void userIoGetProperties(const char *dev, const char *name);
+
     public:
         /** @brief Connect/Disconnect to INDI driver
             @param status If true, the client will attempt to turn on CONNECTION property within the driver (i.e. turn on the device).
@@ -97,7 +105,27 @@ class AbstractBaseClientPrivate
 
         WatchDeviceProperty watchDevice;
 
+        /** Transport compression asked in the next getProperties, empty for none */
+        std::string compressedTransport;
+
         static userio io;
 };
 
+/** @brief All the writes during its lifetime form one message */
+class MessageScope
+{
+    public:
+        explicit MessageScope(AbstractBaseClientPrivate *d) : d(d)
+        {
+            d->beginMessage();
+        }
+        ~MessageScope()
+        {
+            d->endMessage();
+        }
+
+    private:
+        AbstractBaseClientPrivate *d;
+};
+
 }
@@ -0,0 +1,181 @@
+/*******************************************************************************
+ Command scheduler for serial and TCP connections
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+#include "commandscheduler.h"
+
+#include "indicom.h"
+
+#include <chrono>
+
+#include <unistd.h>
+
+#ifndef _WIN32
+#include <termios.h>
+#endif
+
+// A response longer than this without its terminator is garbage
+#define MAX_RESPONSE_LEN 4096
+
+namespace Connection
+{
+
+CommandScheduler::CommandScheduler(std::function<int()> portFD) : m_PortFD(std::move(portFD))
+{
+}
+
+void CommandScheduler::setPipelineDepth(size_t depth)
+{
+    m_Depth = depth > 0 ? depth : 1;
+}
+
+bool CommandScheduler::execute(Command &command)
+{
+    std::vector<Command> commands { command };
+    bool result = execute(commands);
+    command = commands.front();
+    return result;
+}
+
+bool CommandScheduler::execute(std::vector<Command> &commands)
+{
+    std::lock_guard<std::mutex> lock(m_Lock);
+
+    int fd = m_PortFD();
+    if (fd < 0)
+    {
+        for (auto &command : commands)
+            command.error = TTY_PORT_FAILURE;
+        return false;
+    }
+
+#ifndef _WIN32
+    tcflush(fd, TCIFLUSH);
+#endif
+    m_Pending.clear();
+
+    // A depth changed meanwhile applies to the next batch
+    const size_t depth = m_Depth;
+    std::vector<std::chrono::steady_clock::time_point> sent(commands.size());
+    size_t written = 0, done = 0;
+    int error = TTY_OK;
+
+    while (done < commands.size())
+    {
+        // Keep the pipeline full
+        while (written < commands.size() && written - done < depth)
+        {
+            const std::string &request = commands[written].request;
+            int nbytes = 0;
+            sent[written] = std::chrono::steady_clock::now();
+            if ((error = tty_write(fd, request.data(), static_cast<int>(request.size()), &nbytes)) != TTY_OK)
+                break;
+            written++;
+        }
+        if (error != TTY_OK)
+            break;
+
+        Command &command = commands[done];
+        command.error = readResponse(fd, command);
+        command.latency = std::chrono::duration<double>(std::chrono::steady_clock::now() - sent[done]).count();
+        record(command);
+        if ((error = command.error) != TTY_OK)
+            break;
+        done++;
+    }
+
+    for (size_t i = done; i < commands.size(); i++)
+        commands[i].error = error;
+
+    return error == TTY_OK;
+}
+
+int CommandScheduler::readResponse(int fd, Command &command)
+{
+    command.response.clear();
+    if (command.terminator == 0 && command.length == 0)
+        return TTY_OK;
+
+    for (;;)
+    {
+        if (command.terminator != 0)
+        {
+            size_t end = m_Pending.find(command.terminator);
+            if (end != std::string::npos)
+            {
+                command.response = m_Pending.substr(0, end);
+                m_Pending.erase(0, end + 1);
+                return TTY_OK;
+            }
+        }
+        else if (m_Pending.size() >= command.length)
+        {
+            command.response = m_Pending.substr(0, command.length);
+            m_Pending.erase(0, command.length);
+            return TTY_OK;
+        }
+
+        if (m_Pending.size() > MAX_RESPONSE_LEN)
+            return TTY_OVERFLOW;
+
+        int error = tty_timeout(fd, m_Timeout);
+        if (error != TTY_OK)
+            return error;
+
+        // Read whatever arrived, it may hold the responses of the next commands too
+        char buffer[256];
+        ssize_t nbytes = ::read(fd, buffer, sizeof(buffer));
+        if (nbytes <= 0)
+            return TTY_READ_ERROR;
+        m_Pending.append(buffer, nbytes);
+    }
+}
+
+void CommandScheduler::record(const Command &command)
+{
+    std::lock_guard<std::mutex> lock(m_StatisticsLock);
+    auto it = m_Statistics.find(command.request);
+    if (it == m_Statistics.end())
+        it = m_Statistics.emplace(m_Statistics.size() < MaxStatistics ? command.request : std::string(), Statistics()).first;
+    Statistics &statistics = it->second;
+    if (command.error != TTY_OK)
+    {
+        statistics.errors++;
+        return;
+    }
+
+    if (statistics.count == 0 || command.latency < statistics.min)
+        statistics.min = command.latency;
+    if (command.latency > statistics.max)
+        statistics.max = command.latency;
+    statistics.total += command.latency;
+    statistics.count++;
+}
+
+std::map<std::string, CommandScheduler::Statistics> CommandScheduler::statistics() const
+{
+    std::lock_guard<std::mutex> lock(m_StatisticsLock);
+    return m_Statistics;
+}
+
+void CommandScheduler::resetStatistics()
+{
+    std::lock_guard<std::mutex> lock(m_StatisticsLock);
+    m_Statistics.clear();
+}
+
+}
@@ -0,0 +1,142 @@
+/*******************************************************************************
+ Command scheduler for serial and TCP connections
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Connection
+{
+/**
+ * @brief The CommandScheduler class exchanges batches of request/response commands with a device.
+ *
+ * Instead of writing one command and waiting for its answer before writing the next one, up to
+ * pipelineDepth() requests are written ahead, so a batch of N commands costs about one link
+ * round-trip instead of N. Responses are matched to requests in order, each one ending with the
+ * terminator of its command or having its fixed length. Only use a depth above 1 with devices that
+ * answer commands strictly in order and buffer the requests they did not process yet.
+ *
+ * Calls from several threads are serialized, a batch is never interleaved with another one.
+ * The latency of every request string is accumulated in statistics(), up to MaxStatistics
+ * different requests. The others, typically commands carrying a parameter, are accumulated
+ * under an empty request.
+ */
+class CommandScheduler
+{
+    public:
+        struct Command
+        {
+            Command(const std::string &request, char terminator = '#') : request(request), terminator(terminator) {}
+            /** A literal 0 or 1 could mean a terminator or a length, use withLength() for the latter */
+            Command(const std::string &request, int) = delete;
+
+            /** @brief Command whose response has a fixed length, 0 for no response at all */
+            static Command withLength(const std::string &request, size_t length)
+            {
+                Command command(request, '\0');
+                command.length = length;
+                return command;
+            }
+
+            std::string request;
+            /** Last byte of the response, 0 when the response has a fixed length */
+            char terminator {'#'};
+            /** Length of the response when there is no terminator, 0 for commands without response */
+            size_t length {0};
+
+            /** Response, without its terminator */
+            std::string response;
+            /** TTY_OK or the TTY error of the command */
+            int error {0};
+            /** Seconds from the write of the request to the end of its response */
+            double latency {0};
+        };
+
+        struct Statistics
+        {
+            uint64_t count {0};
+            uint64_t errors {0};
+            double total {0};
+            double min {0};
+            double max {0};
+
+            double average() const
+            {
+                return count ? total / count : 0;
+            }
+        };
+
+    public:
+        static constexpr size_t MaxStatistics = 256;
+
+    public:
+        /**
+         * @param portFD returns the file descriptor of the connection when a batch starts, -1 if disconnected
+         */
+        explicit CommandScheduler(std::function<int()> portFD);
+
+        /** @brief Maximum number of requests written ahead of their response, 1 for lock-step */
+        void setPipelineDepth(size_t depth);
+        size_t pipelineDepth() const
+        {
+            return m_Depth.load();
+        }
+
+        /** @brief Seconds to wait for a response */
+        void setTimeout(int seconds)
+        {
+            m_Timeout = seconds;
+        }
+
+        /**
+         * @brief Send the commands and collect their responses. Input not read yet is discarded first.
+         * @return true if every command got its response. After an error, the remaining commands
+         * fail with the same error.
+         */
+        bool execute(std::vector<Command> &commands);
+        bool execute(Command &command);
+
+        /** @brief Latency per request string */
+        std::map<std::string, Statistics> statistics() const;
+        void resetStatistics();
+
+    private:
+        int readResponse(int fd, Command &command);
+        void record(const Command &command);
+
+    private:
+        std::function<int()> m_PortFD;
+        std::atomic<size_t> m_Depth {1};
+        int m_Timeout {5};
+
+        // Bytes read past the end of the previous response
+        std::string m_Pending;
+
+        mutable std::mutex m_Lock;
+        mutable std::mutex m_StatisticsLock;
+        std::map<std::string, Statistics> m_Statistics;
+};
+
+}
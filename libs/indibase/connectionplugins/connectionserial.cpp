@@ -23,17 +23,61 @@
 
 #include <dirent.h>
 #include <cerrno>
+#include <climits>
+#include <cstdlib>
 #include <cstring>
 #include <algorithm>
 #include <thread>
 #include <chrono>
+#include <fstream>
+#include <map>
+#include <mutex>
 #include <regex>
 #include <random>
 
+#include <sys/file.h>
+#include <unistd.h>
+
 namespace Connection
 {
 extern const char *CONNECTION_TAB;
 
+// Stable names of USB serial adapters, they survive renumbering of /dev/ttyUSBx
+static const std::string USB_ID_PATH = "/dev/serial/by-id/";
+
+static std::string resolvedPath(const std::string &port)
+{
+    char path[PATH_MAX];
+    return realpath(port.c_str(), path) ? std::string(path) : port;
+}
+
+// Ports opened by several drivers at once on purpose, same rule as tty_connect()
+static bool isSharedPort(const char *port)
+{
+    return strstr(port, "rfcomm") || strstr(port, "Bluetooth") || strstr(port, "virtualcom");
+}
+
+// Ports where devices were found, by device name
+static std::string bindingsFile()
+{
+    const char *home = getenv("HOME");
+    return std::string(home ? home : "") + "/.indi/SerialPortBindings.txt";
+}
+
+static std::map<std::string, std::string> loadBindings()
+{
+    std::map<std::string, std::string> bindings;
+    std::ifstream file(bindingsFile());
+    std::string line;
+    while (std::getline(file, line))
+    {
+        size_t tab = line.find('\t');
+        if (tab != std::string::npos)
+            bindings[line.substr(0, tab)] = line.substr(tab + 1);
+    }
+    return bindings;
+}
+
 Serial::Serial(INDI::DefaultDevice *dev, IPerm permission) : Interface(dev, CONNECTION_SERIAL), m_Permission(permission)
 {
     char configPort[256] = {0};
@@ -187,7 +231,10 @@ bool Serial::Connect()
 {
     uint32_t baud = atoi(IUFindOnSwitch(&BaudRateSP)->name);
     if (Connect(PortT[0].text, baud) && processHandshake())
+    {
+        rememberPort(PortT[0].text);
         return true;
+    }
 
     // Important, disconnect from port immediately
     // to release the lock, otherwise another driver will find it busy.
@@ -217,19 +264,43 @@ bool Serial::Connect()
         std::minstd_rand g(rd());
         std::shuffle(systemPorts.begin(), systemPorts.end(), g);
 
+        // The port where the device was found before goes first
+        std::string known = knownPort();
+        if (!known.empty() && resolvedPath(known) != resolvedPath(PortT[0].text))
+        {
+            std::string target = resolvedPath(known);
+            systemPorts.erase(std::remove_if(systemPorts.begin(), systemPorts.end(), [&target](const std::string & port)
+            {
+                return resolvedPath(port) == target;
+            }), systemPorts.end());
+            systemPorts.insert(systemPorts.begin(), known);
+        }
+
         std::vector<std::string> doubleSearch = systemPorts;
 
         // Try the current port as LAST port again
         systemPorts.push_back(PortT[0].text);
 
-        // Double search just in case some items were BUSY in the first pass
-        systemPorts.insert(systemPorts.end(), doubleSearch.begin(), doubleSearch.end());
+        if (m_Probe)
+        {
+            // Only handshake the port that answered the probe
+            std::string port = probePorts(systemPorts, baud);
+            systemPorts.clear();
+            if (!port.empty())
+                systemPorts.push_back(port);
+        }
+        else
+        {
+            // Double search just in case some items were BUSY in the first pass
+            systemPorts.insert(systemPorts.end(), doubleSearch.begin(), doubleSearch.end());
+        }
 
         for (const auto &port : systemPorts)
         {
             LOGF_INFO("Trying connecting to %s @ %d ...", port.c_str(), baud);
             if (Connect(port.c_str(), baud) && processHandshake())
             {
+                rememberPort(port);
                 IUSaveText(&PortT[0], port.c_str());
                 IDSetText(&PortTP, nullptr);
 
@@ -271,6 +342,150 @@ bool Serial::Connect()
     return false;
 }
 
+std::string Serial::probePorts(const std::vector<std::string> &ports, uint32_t baud)
+{
+    enum { PROBE_FAILED, PROBE_BUSY, PROBE_FOUND };
+
+    // The same device may be listed under several names
+    std::vector<std::string> candidates, resolved;
+    for (const auto &port : ports)
+    {
+        std::string target = resolvedPath(port);
+        if (std::find(resolved.begin(), resolved.end(), target) == resolved.end())
+        {
+            candidates.push_back(port);
+            resolved.push_back(target);
+        }
+    }
+
+    // Busy ports get a second chance, like the sequential double search
+    for (int pass = 0; pass < 2 && !candidates.empty(); pass++)
+    {
+        LOGF_INFO("Probing %d port(s) @ %d ...", static_cast<int>(candidates.size()), baud);
+
+        std::vector<int> results(candidates.size(), PROBE_FAILED);
+        std::vector<std::thread> probes;
+        for (size_t i = 0; i < candidates.size(); i++)
+        {
+            probes.emplace_back([this, &candidates, &results, i, baud]()
+            {
+                const char *port = candidates[i].c_str();
+                int fd = -1;
+                int rc = tty_connect(port, baud, wordSize, parity, stopBits, &fd);
+                if (rc != TTY_OK)
+                {
+                    results[i] = (rc == TTY_PORT_BUSY) ? PROBE_BUSY : PROBE_FAILED;
+                    return;
+                }
+
+                if (!lockPort(port, fd))
+                    results[i] = PROBE_BUSY;
+                else if (m_Probe(fd))
+                    results[i] = PROBE_FOUND;
+                tty_disconnect(fd);
+            });
+        }
+        for (auto &probe : probes)
+            probe.join();
+
+        std::vector<std::string> busy;
+        for (size_t i = 0; i < candidates.size(); i++)
+        {
+            if (results[i] == PROBE_FOUND)
+            {
+                LOGF_DEBUG("Device answered on %s", candidates[i].c_str());
+                return candidates[i];
+            }
+            if (results[i] == PROBE_BUSY)
+                busy.push_back(candidates[i]);
+        }
+
+        candidates = busy;
+        if (!candidates.empty())
+            std::this_thread::sleep_for(std::chrono::milliseconds(500 + (rand() % 1000)));
+    }
+
+    return std::string();
+}
+
+// Advisory lock, released when the port is closed
+bool Serial::lockPort(const char *port, int fd) const
+{
+    return !m_PortLock || isSharedPort(port) || flock(fd, LOCK_EX | LOCK_NB) == 0;
+}
+
+std::string Serial::knownPort() const
+{
+    auto bindings = loadBindings();
+    auto binding = bindings.find(m_Device->getDeviceName());
+    if (binding == bindings.end() || access(binding->second.c_str(), F_OK) != 0)
+        return std::string();
+    return binding->second;
+}
+
+void Serial::rememberPort(const std::string &port) const
+{
+    if (m_Device->isSimulation())
+        return;
+
+    std::string stable = stablePortName(port);
+    if (stable.empty())
+        return;
+
+    static std::mutex bindingsLock;
+    std::lock_guard<std::mutex> lock(bindingsLock);
+
+    auto bindings = loadBindings();
+    std::string &binding = bindings[m_Device->getDeviceName()];
+    if (binding == stable)
+        return;
+    binding = stable;
+
+    // Write a copy and rename it, other drivers may be reading the file
+    std::string fileName = bindingsFile();
+    std::string temporary = fileName + "." + std::to_string(getpid());
+    {
+        std::ofstream file(temporary);
+        for (const auto &one : bindings)
+            file << one.first << '\t' << one.second << '\n';
+        if (!file)
+        {
+            unlink(temporary.c_str());
+            return;
+        }
+    }
+    if (rename(temporary.c_str(), fileName.c_str()) != 0)
+        unlink(temporary.c_str());
+}
+
+std::string Serial::stablePortName(const std::string &port) const
+{
+#ifdef __linux__
+    if (port.compare(0, USB_ID_PATH.size(), USB_ID_PATH) == 0)
+        return port;
+
+    // Only USB adapters have a name that outlives a power cycle
+    std::string target = resolvedPath(port);
+    std::string stable;
+    if (DIR *dir = opendir(USB_ID_PATH.c_str()))
+    {
+        while (struct dirent *entry = readdir(dir))
+        {
+            std::string candidate = USB_ID_PATH + entry->d_name;
+            if (entry->d_name[0] != '.' && resolvedPath(candidate) == target)
+            {
+                stable = candidate;
+                break;
+            }
+        }
+        closedir(dir);
+    }
+    return stable;
+#else
+    return port;
+#endif
+}
+
 bool Serial::processHandshake()
 {
     LOG_DEBUG("Connection successful, attempting handshake...");
@@ -313,6 +528,14 @@ bool Serial::Connect(const char *port, uint32_t baud)
         return false;
     }
 
+    if (!lockPort(port, PortFD))
+    {
+        LOGF_WARN("Port %s is already used by another driver or process.", port);
+        tty_disconnect(PortFD);
+        PortFD = -1;
+        return false;
+    }
+
     LOGF_DEBUG("Port FD %d", PortFD);
 
     return true;
@@ -21,7 +21,9 @@
 #pragma once
 
 #include "connectioninterface.h"
+#include "commandscheduler.h"
 
+#include <functional>
 #include <string>
 #include <vector>
 #include <cstdint>
@@ -103,6 +105,14 @@ class Serial : public Interface
             return PortFD;
         }
 
+        /**
+         * @brief Scheduler of request/response exchanges over this connection, see CommandScheduler
+         */
+        CommandScheduler &scheduler()
+        {
+            return m_Scheduler;
+        }
+
         virtual bool ISNewText(const char *dev, const char *name, char *texts[], char *names[], int n) override;
         virtual bool ISNewSwitch(const char *dev, const char *name, ISState *states, char *names[], int n) override;
         virtual bool saveConfigItems(FILE *fp) override;
@@ -112,6 +122,34 @@ class Serial : public Interface
          */
         bool Refresh(bool silent = false);
 
+        /**
+         * @brief registerProbe Register a function to search system ports in parallel.
+         * When the connection fails and auto search is enabled, the probe is called concurrently on every
+         * candidate port, already opened at the current baud rate. It must only talk through the file
+         * descriptor it is given and return true if the expected device answered. The regular handshake
+         * then runs on the port found. Without a probe, ports are tried one after the other.
+         * @param callback Probe function callback, nullptr to search sequentially
+         */
+        void registerProbe(std::function<bool(int fd)> callback)
+        {
+            m_Probe = callback;
+        }
+
+        /**
+         * @brief setPortLock Hold an advisory flock on the port while it is probed or connected, so that two
+         * drivers never talk to the same port, even as root where TIOCEXCL is ignored. Bluetooth and virtual
+         * ports are never locked. Disabled by default.
+         * @param enable true to lock the port
+         */
+        void setPortLock(bool enable)
+        {
+            m_PortLock = enable;
+        }
+        bool getPortLock() const
+        {
+            return m_PortLock;
+        }
+
         uint8_t getWordSize() const
         {
             return wordSize;
@@ -162,6 +200,27 @@ class Serial : public Interface
 
         virtual bool processHandshake();
 
+        /**
+         * @brief probePorts Probe the ports in parallel with the registered probe.
+         * @return the first port of the list where the device answered, empty if none did
+         */
+        std::string probePorts(const std::vector<std::string> &ports, uint32_t baud);
+
+        /** @brief Port where this device was found before, empty if unknown */
+        std::string knownPort() const;
+
+        /** @brief Remember the port this device answered on, by its stable USB path when there is one */
+        void rememberPort(const std::string &port) const;
+
+        /**
+         * @brief stablePortName Name of the port that outlives a power cycle of the device.
+         * @return the /dev/serial/by-id name of the port on Linux, empty if it has none. The port itself elsewhere.
+         */
+        virtual std::string stablePortName(const std::string &port) const;
+
+        /** @return true if the port could be locked, or needs no lock */
+        bool lockPort(const char *port, int fd) const;
+
         enum
         {
             SERIAL_DEV,
@@ -197,5 +256,8 @@ class Serial : public Interface
         std::string m_ConfigPort;
         int m_ConfigBaudRate {-1};
         std::vector<std::string> m_SystemPorts;
+        std::function<bool(int fd)> m_Probe;
+        bool m_PortLock {false};
+        CommandScheduler m_Scheduler {[this] { return PortFD; }};
 };
 }
@@ -21,6 +21,7 @@
 #pragma once
 
 #include "connectioninterface.h"
+#include "commandscheduler.h"
 
 #include <stdint.h>
 #include <cstdlib>
@@ -85,6 +86,15 @@ class TCP : public Interface
         {
             return PortFD;
         }
+
+        /**
+         * @brief Scheduler of request/response exchanges over this connection, see CommandScheduler
+         */
+        CommandScheduler &scheduler()
+        {
+            return m_Scheduler;
+        }
+
         void setDefaultHost(const char *addressHost);
         void setDefaultPort(uint32_t addressPort);
         void setConnectionType(int type);
@@ -121,6 +131,7 @@ class TCP : public Interface
         int m_ConfigConnectionType {-1};
         int m_SockFD {-1};
         int PortFD = -1;
+        CommandScheduler m_Scheduler {[this] { return PortFD; }};
         static constexpr uint8_t SOCKET_TIMEOUT {5};
 };
 }
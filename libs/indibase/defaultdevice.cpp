@@ -162,6 +162,13 @@ void timerfunc(void *t)
 namespace INDI
 {
 
+void DefaultDevicePrivate::snoopPropertyHandler(XMLEle *root, void *context)
+{
+    // The handler may replace or remove itself, keep it alive until it returns
+    auto handler = *static_cast<std::shared_ptr<std::function<void (XMLEle *)>> *>(context);
+    (*handler)(root);
+}
+
 DefaultDevicePrivate::DefaultDevicePrivate(DefaultDevice *defaultDevice)
     : defaultDevice(defaultDevice)
 {
@@ -173,6 +180,14 @@ DefaultDevicePrivate::~DefaultDevicePrivate()
 {
     const std::unique_lock<std::recursive_mutex> lock(DefaultDevicePrivate::devicesLock);
     devices.remove(this);
+
+    for (auto &it : snoopHandlers)
+        IDUnsnoopProperty(it.first.first.c_str(), it.first.second.c_str(), snoopPropertyHandler, &it.second);
+
+    // Do not lose single property saves still waiting to be written
+    char errmsg[MAXRBUF];
+    if (IUFlushConfig(nullptr, deviceName.c_str(), errmsg) < 0)
+        IDLog("%s\n", errmsg);
 }
 
 DefaultDevice::DefaultDevice()
@@ -184,6 +199,25 @@ DefaultDevice::DefaultDevice()
     d->m_MainLoopTimer.callOnTimeout(std::bind(&DefaultDevice::TimerHit, this));
 }
 
+void DefaultDevicePrivate::updateOutputQueue()
+{
+    IDOutputQueueStats stats;
+    IDOutputQueueGetStats(&stats);
+
+    // Nothing was queued since the last update but the update itself
+    if (stats.messages <= outputQueueMessages + 1)
+        return;
+
+    OutputQueueNP[0].setValue(stats.messages);
+    OutputQueueNP[1].setValue(stats.coalesced);
+    OutputQueueNP[2].setValue(stats.peakBytes);
+    OutputQueueNP[3].setValue(stats.writerSeconds);
+    OutputQueueNP[4].setValue(stats.stallSeconds);
+    OutputQueueNP.setState(IPS_OK);
+    OutputQueueNP.apply();
+    outputQueueMessages = stats.messages;
+}
+
 bool DefaultDevice::loadConfig(INDI::Property &property)
 {
     return loadConfig(true, property.getName());
@@ -276,11 +310,11 @@ bool DefaultDevice::saveConfig(bool silent, const char *property)
     silent = false;
     char errmsg[MAXRBUF] = {0};
 
-    FILE *fp = nullptr;
-
     if (property == nullptr)
     {
-        fp = IUGetConfigFP(nullptr, getDeviceName(), "w", errmsg);
+        // Write to a temporary file first, readers never see a half written configuration
+        char tempname[MAXRBUF] = {0};
+        FILE *fp = IUGetConfigTempFP(nullptr, getDeviceName(), tempname, errmsg);
 
         if (fp == nullptr)
         {
@@ -295,8 +329,12 @@ bool DefaultDevice::saveConfig(bool silent, const char *property)
 
         IUSaveConfigTag(fp, 1, getDeviceName(), silent ? 1 : 0);
 
-        fflush(fp);
-        fclose(fp);
+        if (IUCommitConfigFP(fp, tempname, nullptr, getDeviceName(), errmsg) < 0)
+        {
+            if (!silent)
+                LOGF_WARN("Failed to save configuration. %s", errmsg);
+            return false;
+        }
 
         if (d->isDefaultConfigLoaded == false)
         {
@@ -304,134 +342,93 @@ bool DefaultDevice::saveConfig(bool silent, const char *property)
         }
 
         LOG_DEBUG("Configuration successfully saved.");
+        return true;
     }
-    else
-    {
-        fp = IUGetConfigFP(nullptr, getDeviceName(), "r", errmsg);
 
-        if (fp == nullptr)
-        {
-            //if (!silent)
-            //   LOGF_ERROR("Error saving configuration. %s", errmsg);
-            //return false;
-            // If we don't have an existing file pointer, save all properties.
-            return saveConfig(silent);
-        }
+    // Edit the cached configuration in place, it is written back once the property stops changing.
+    XMLEle *ep = IULockConfigProperty(nullptr, getDeviceName(), property, errmsg);
 
-        LilXML *lp   = newLilXML();
-        XMLEle *root = readXMLFile(fp, lp, errmsg);
+    // If the file or the property does not exist yet, save all properties.
+    if (ep == nullptr)
+        return saveConfig(silent);
 
-        fclose(fp);
-        delLilXML(lp);
+    const char *tagName = tagXMLEle(ep);
+    bool propertySaved  = false;
+    bool propertyFailed = false;
 
-        if (root == nullptr)
-            return false;
-
-        XMLEle *ep         = nullptr;
-        bool propertySaved = false;
+    if (!strcmp(tagName, "newSwitchVector"))
+    {
+        auto svp = getSwitch(property);
+        propertyFailed = !svp;
 
-        for (ep = nextXMLEle(root, 1); ep != nullptr; ep = nextXMLEle(root, 0))
+        XMLEle *sw = nullptr;
+        for (sw = propertyFailed ? nullptr : nextXMLEle(ep, 1); sw != nullptr; sw = nextXMLEle(ep, 0))
         {
-            const char *elemName = findXMLAttValu(ep, "name");
-            const char *tagName  = tagXMLEle(ep);
-
-            if (strcmp(elemName, property))
-                continue;
-
-            if (!strcmp(tagName, "newSwitchVector"))
+            auto oneSwitch = svp.findWidgetByName(findXMLAttValu(sw, "name"));
+            if (!oneSwitch)
             {
-                auto svp = getSwitch(elemName);
-                if (!svp)
-                {
-                    delXMLEle(root);
-                    return false;
-                }
-
-                XMLEle *sw = nullptr;
-                for (sw = nextXMLEle(ep, 1); sw != nullptr; sw = nextXMLEle(ep, 0))
-                {
-                    auto oneSwitch = svp.findWidgetByName(findXMLAttValu(sw, "name"));
-                    if (!oneSwitch)
-                    {
-                        delXMLEle(root);
-                        return false;
-                    }
-                    char formatString[MAXRBUF];
-                    snprintf(formatString, MAXRBUF, "      %s\n", oneSwitch->getStateAsString());
-                    editXMLEle(sw, formatString);
-                }
-
-                propertySaved = true;
+                propertyFailed = true;
                 break;
             }
-            else if (!strcmp(tagName, "newNumberVector"))
-            {
-                auto nvp = getNumber(elemName);
-                if (!nvp)
-                {
-                    delXMLEle(root);
-                    return false;
-                }
-
-                XMLEle *np = nullptr;
-                for (np = nextXMLEle(ep, 1); np != nullptr; np = nextXMLEle(ep, 0))
-                {
-                    auto oneNumber = nvp.findWidgetByName(findXMLAttValu(np, "name"));
-                    if (!oneNumber)
-                        return false;
-
-                    char formatString[MAXRBUF];
-                    snprintf(formatString, MAXRBUF, "      %.20g\n", oneNumber->getValue());
-                    editXMLEle(np, formatString);
-                }
+            char formatString[MAXRBUF];
+            snprintf(formatString, MAXRBUF, "      %s\n", oneSwitch->getStateAsString());
+            editXMLEle(sw, formatString);
+            propertySaved = true;
+        }
+    }
+    else if (!strcmp(tagName, "newNumberVector"))
+    {
+        auto nvp = getNumber(property);
+        propertyFailed = !nvp;
 
-                propertySaved = true;
+        XMLEle *np = nullptr;
+        for (np = propertyFailed ? nullptr : nextXMLEle(ep, 1); np != nullptr; np = nextXMLEle(ep, 0))
+        {
+            auto oneNumber = nvp.findWidgetByName(findXMLAttValu(np, "name"));
+            if (!oneNumber)
+            {
+                propertyFailed = true;
                 break;
             }
-            else if (!strcmp(tagName, "newTextVector"))
-            {
-                auto tvp = getText(elemName);
-                if (!tvp)
-                {
-                    delXMLEle(root);
-                    return false;
-                }
-
-                XMLEle *tp = nullptr;
-                for (tp = nextXMLEle(ep, 1); tp != nullptr; tp = nextXMLEle(ep, 0))
-                {
-                    auto oneText = tvp.findWidgetByName(findXMLAttValu(tp, "name"));
-                    if (!oneText)
-                        return false;
 
-                    char formatString[MAXRBUF];
-                    snprintf(formatString, MAXRBUF, "      %s\n", oneText->getText() ? oneText->getText() : "");
-                    editXMLEle(tp, formatString);
-                }
+            char formatString[MAXRBUF];
+            snprintf(formatString, MAXRBUF, "      %.20g\n", oneNumber->getValue());
+            editXMLEle(np, formatString);
+            propertySaved = true;
+        }
+    }
+    else if (!strcmp(tagName, "newTextVector"))
+    {
+        auto tvp = getText(property);
+        propertyFailed = !tvp;
 
-                propertySaved = true;
+        XMLEle *tp = nullptr;
+        for (tp = propertyFailed ? nullptr : nextXMLEle(ep, 1); tp != nullptr; tp = nextXMLEle(ep, 0))
+        {
+            auto oneText = tvp.findWidgetByName(findXMLAttValu(tp, "name"));
+            if (!oneText)
+            {
+                propertyFailed = true;
                 break;
             }
-        }
 
-        if (propertySaved)
-        {
-            fp = IUGetConfigFP(nullptr, getDeviceName(), "w", errmsg);
-            prXMLEle(fp, root, 0);
-            fflush(fp);
-            fclose(fp);
-            delXMLEle(root);
-            LOGF_DEBUG("Configuration successfully saved for %s.", property);
-            return true;
-        }
-        else
-        {
-            delXMLEle(root);
-            // If property does not exist, save the whole thing
-            return saveConfig(silent);
+            char formatString[MAXRBUF];
+            snprintf(formatString, MAXRBUF, "      %s\n", oneText->getText() ? oneText->getText() : "");
+            editXMLEle(tp, formatString);
+            propertySaved = true;
         }
     }
 
+    IUUnlockConfigProperty(nullptr, getDeviceName(), propertySaved ? 1 : 0);
+
+    if (propertyFailed)
+        return false;
+
+    // If the property cannot be edited in place, save the whole thing
+    if (!propertySaved)
+        return saveConfig(silent);
+
+    LOGF_DEBUG("Configuration successfully saved for %s.", property);
     return true;
 }
 
@@ -574,6 +571,27 @@ void DefaultDevice::watchDevice(const char *name, const std::function<void (Base
     IDSnoopDevice(name, nullptr);
 }
 
+void DefaultDevice::snoopProperty(const char *deviceName, const char *propertyName,
+                                  const std::function<void (XMLEle *)> &handler)
+{
+    D_PTR(DefaultDevice);
+    // Map nodes do not move, the handler is registered with its address
+    auto &stored = d->snoopHandlers[std::make_pair(std::string(deviceName), std::string(propertyName ? propertyName : ""))];
+    stored = std::make_shared<std::function<void (XMLEle *)>>(handler);
+    IDSnoopProperty(deviceName, propertyName, DefaultDevicePrivate::snoopPropertyHandler, &stored);
+}
+
+void DefaultDevice::unsnoopProperty(const char *deviceName, const char *propertyName)
+{
+    D_PTR(DefaultDevice);
+    auto it = d->snoopHandlers.find(std::make_pair(std::string(deviceName), std::string(propertyName ? propertyName : "")));
+    if (it == d->snoopHandlers.end())
+        return;
+
+    IDUnsnoopProperty(deviceName, propertyName, DefaultDevicePrivate::snoopPropertyHandler, &it->second);
+    d->snoopHandlers.erase(it);
+}
+
 void DefaultDevice::addDebugControl()
 {
     D_PTR(DefaultDevice);
@@ -1012,6 +1030,33 @@ bool DefaultDevice::initProperties()
         d->PollPeriodNP.apply();
     });
 
+    // Virtual Clock, tests move it forward instead of waiting
+    d->ClockAdvanceNP[0].fill("ADVANCE_MS", "Advance (ms)", "%.f", 0, 86400000, 1000, 0);
+    d->ClockAdvanceNP.fill(getDeviceName(), "CLOCK_ADVANCE", "Virtual Clock", "Options", IP_RW, 0, IPS_IDLE);
+    d->ClockAdvanceNP.onUpdate([d]()
+    {
+        IEAdvanceClock(d->ClockAdvanceNP[0].getValue());
+        d->ClockAdvanceNP.setState(IPS_OK);
+        d->ClockAdvanceNP.apply();
+    });
+    if (IEGetClockMode() != IE_CLOCK_REALTIME)
+        registerProperty(d->ClockAdvanceNP);
+
+    // Output Queue counters, shared by all the devices of the driver
+    d->OutputQueueNP[0].fill("MESSAGES", "Messages", "%.f", 0, 0, 0, 0);
+    d->OutputQueueNP[1].fill("COALESCED", "Coalesced", "%.f", 0, 0, 0, 0);
+    d->OutputQueueNP[2].fill("PEAK_BYTES", "Peak (bytes)", "%.f", 0, 0, 0, 0);
+    d->OutputQueueNP[3].fill("WRITER_S", "Writer (s)", "%.3f", 0, 0, 0, 0);
+    d->OutputQueueNP[4].fill("STALL_S", "Stalled (s)", "%.3f", 0, 0, 0, 0);
+    d->OutputQueueNP.fill(getDeviceName(), "OUTPUT_QUEUE", "Output Queue", "Options", IP_RO, 0, IPS_IDLE);
+    if (IDOutputQueueEnabled())
+    {
+        registerProperty(d->OutputQueueNP);
+        d->m_OutputQueueTimer.setInterval(5000);
+        d->m_OutputQueueTimer.callOnTimeout(std::bind(&DefaultDevicePrivate::updateOutputQueue, d));
+        d->m_OutputQueueTimer.start();
+    }
+
     INDI::Logger::initProperties(this);
 
     // Ready the logger
@@ -327,6 +327,19 @@ class DefaultDevice : public ParentDevice
          */
         void watchDevice(const char *deviceName, const std::function<void (INDI::BaseDevice)> &callback);
 
+        /** @brief Snoop a property of another device and pass its messages to handler directly, so a class
+         *  does not have to search for them in its ISSnoopDevice(). They still reach ISSnoopDevice() for
+         *  derived classes. Calling it again for the same property replaces the handler.
+         *  @param deviceName name of the snooped device.
+         *  @param propertyName name of the snooped property, empty for every message of the device.
+         *  @param handler called with each message of the property, on the thread of the event loop.
+         */
+        void snoopProperty(const char *deviceName, const char *propertyName,
+                           const std::function<void (XMLEle *)> &handler);
+
+        /** @brief Stop passing the messages of a property given to snoopProperty() to its handler. */
+        void unsnoopProperty(const char *deviceName, const char *propertyName);
+
     protected:
         /**
          * @brief setDynamicPropertiesBehavior controls handling of dynamic properties. Dynamic properties
@@ -23,8 +23,12 @@
 #include "watchdeviceproperty.h"
 
 #include <cstring>
+#include <functional>
 #include <list>
+#include <map>
+#include <memory>
 #include <mutex>
+#include <string>
 
 #include "indipropertyswitch.h"
 #include "indipropertynumber.h"
@@ -56,6 +60,8 @@ class DefaultDevicePrivate: public ParentDevicePrivate
         PropertySwitch ConfigProcessSP  { 4 };
         PropertySwitch ConnectionSP     { 2 };
         PropertyNumber PollPeriodNP     { 1 };
+        PropertyNumber ClockAdvanceNP   { 1 };
+        PropertyNumber OutputQueueNP    { 5 };
         PropertyText   DriverInfoTP     { 4 };
         PropertySwitch ConnectionModeSP { 0 }; // dynamic count of switches
 
@@ -73,11 +79,22 @@ class DefaultDevicePrivate: public ParentDevicePrivate
         // TimerHit timer
         INDI::Timer m_MainLoopTimer;
 
+        // Refreshes OutputQueueNP, and the messages queued when it last did
+        INDI::Timer m_OutputQueueTimer;
+        unsigned long outputQueueMessages = 0;
+        void updateOutputQueue();
+
     public:
         static std::list<DefaultDevicePrivate*> devices;
         static std::recursive_mutex             devicesLock;
 
+        // Passes a snooped message to the std::function registered by snoopProperty()
+        static void snoopPropertyHandler(XMLEle *root, void *context);
+
         WatchDeviceProperty watchDevice;
+
+        // Handlers given to snoopProperty(), by device and property, shared with the call running them
+        std::map<std::pair<std::string, std::string>, std::shared_ptr<std::function<void (XMLEle *)>>> snoopHandlers;
 };
 
 }
@@ -81,6 +81,7 @@ bool Convolution::ISNewBLOB(const char *dev, const char *name, int sizes[], int
             {
                 LOGF_INFO("Matrix for %s loaded", getDeviceName());
                 matrix_loaded = true;
+                matrix_changed = true;
                 return true;
             }
         }
@@ -88,14 +89,32 @@ bool Convolution::ISNewBLOB(const char *dev, const char *name, int sizes[], int
     return false;
 }
 
+bool Convolution::prepare()
+{
+    if(!Interface::prepare()) return false;
+    if(!matrix_loaded || matrix == nullptr) return false;
+    // ISNewBLOB frees the matrix it replaces, so the worker convolves with a copy of its own
+    if(matrix_changed)
+    {
+        if(runMatrix != nullptr)
+        {
+            dsp_stream_free_buffer(runMatrix);
+            dsp_stream_free(runMatrix);
+        }
+        runMatrix = dsp_stream_copy(matrix);
+        matrix_changed = false;
+    }
+    return true;
+}
+
 bool Convolution::processBLOB(uint8_t *buf, uint32_t dims, int *sizes, int bits_per_sample)
 {
-    if(!PluginActive) return false;
-    if(!matrix_loaded) return false;
+    if(!runActive) return false;
+    if(runMatrix == nullptr) return false;
     setStream(buf, dims, sizes, bits_per_sample);
     dsp_fourier_dft(stream, 1);
-    dsp_fourier_dft(matrix, 1);
-    dsp_convolution_convolution(stream, matrix);
+    dsp_fourier_dft(runMatrix, 1);
+    dsp_convolution_convolution(stream, runMatrix);
     return Interface::processBLOB(getStream(), stream->dims, stream->sizes, bits_per_sample);
 }
 
@@ -139,14 +158,21 @@ bool Wavelets::ISNewNumber(const char *dev, const char *name, double *values, ch
     return true;
 }
 
+bool Wavelets::prepare()
+{
+    for (int i = 0; i < N_WAVELETS; i++)
+        runWavelets[i] = WaveletsN[i].value;
+    return Interface::prepare();
+}
+
 bool Wavelets::processBLOB(uint8_t *buf, uint32_t dims, int *sizes, int bits_per_sample)
 {
-    if(!PluginActive) return false;
+    if(!runActive) return false;
     setStream(buf, dims, sizes, bits_per_sample);
     double min = dsp_stats_min(stream->buf, stream->len);
     double max = dsp_stats_max(stream->buf, stream->len);
     dsp_stream_p out = dsp_stream_copy(stream);
-    for (int i = 0; i < WaveletsNP.nnp; i++)
+    for (int i = 0; i < N_WAVELETS; i++)
     {
         int size = (i + 1) * 3;
         dsp_stream_p tmp = dsp_stream_copy(stream);
@@ -166,7 +192,7 @@ bool Wavelets::processBLOB(uint8_t *buf, uint32_t dims, int *sizes, int bits_per
         dsp_fourier_dft(matrix, 1);
         dsp_convolution_convolution(tmp, matrix);
         dsp_buffer_sub(tmp, matrix->buf, matrix->len);
-        dsp_buffer_mul1(tmp, WaveletsNP.np[i].value / 8.0);
+        dsp_buffer_mul1(tmp, runWavelets[i] / 8.0);
         dsp_buffer_sum(out, tmp->buf, tmp->len);
         dsp_buffer_normalize(tmp->buf, min, max, tmp->len);
         dsp_stream_free_buffer(matrix);
@@ -35,6 +35,7 @@ class Convolution : public Interface
         bool ISNewBLOB(const char *dev, const char *name, int sizes[], int blobsizes[], char *blobs[], char *formats[],
                        char *names[], int n) override;
         virtual bool processBLOB(uint8_t *out, uint32_t dims, int *sizes, int bits_per_sample) override;
+        bool prepare() override;
 
     protected:
         ~Convolution();
@@ -45,8 +46,11 @@ class Convolution : public Interface
         IBLOBVectorProperty DownloadBP;
         IBLOB DownloadB;
 
-        dsp_stream_p matrix;
+        dsp_stream_p matrix { nullptr };
         bool matrix_loaded { false };
+        bool matrix_changed { false };
+        // copy of matrix used by processBLOB
+        dsp_stream_p runMatrix { nullptr };
 };
 
 class Wavelets : public Interface
@@ -55,6 +59,7 @@ class Wavelets : public Interface
         Wavelets(INDI::DefaultDevice *dev);
         bool ISNewNumber(const char *dev, const char *name, double values[], char *names[], int n) override;
         virtual bool processBLOB(uint8_t *out, uint32_t dims, int *sizes, int bits_per_sample) override;
+        bool prepare() override;
 
     protected:
         ~Wavelets();
@@ -62,10 +67,12 @@ class Wavelets : public Interface
         void Deactivated() override;
 
     private:
-        dsp_stream_p matrix;
+        dsp_stream_p matrix { nullptr };
 
         INumberVectorProperty WaveletsNP;
         INumber WaveletsN[N_WAVELETS];
+        // copy of the WaveletsN values used by processBLOB
+        double runWavelets[N_WAVELETS] {};
 
         bool matrix_loaded { false };
         void Convolute();
@@ -194,14 +194,9 @@ uint8_t* Interface::Callback(uint8_t* buf, uint32_t ndims, int* dims, int bits_p
 bool Interface::processBLOB(uint8_t* buffer, uint32_t ndims, int* dims, int bits_per_sample)
 {
     bool success = false;
-    if(PluginActive)
+    if(runActive)
     {
-        bool sendCapture = (m_Device->getSwitch("UPLOAD_MODE")[0].getState() == ISS_ON
-                            || m_Device->getSwitch("UPLOAD_MODE")[2].getState() == ISS_ON);
-        bool saveCapture = (m_Device->getSwitch("UPLOAD_MODE")[1].getState() == ISS_ON
-                            || m_Device->getSwitch("UPLOAD_MODE")[2].getState() == ISS_ON);
-
-        if (sendCapture || saveCapture)
+        if (runSendCapture || runSaveCapture)
         {
             if (buffer)
             {
@@ -214,13 +209,13 @@ bool Interface::processBLOB(uint8_t* buffer, uint32_t ndims, int* dims, int bits
                 for (len = 1, i = 0; i < BufferSizesQty; len *= BufferSizes[i++]);
                 len *= getBPS() / 8;
 
-                if (!strcmp(captureExtention, "fits"))
+                if (!strcmp(runCaptureExtension, "fits"))
                 {
-                    success = sendFITS(buffer, sendCapture, saveCapture);
+                    success = sendFITS(buffer, runSendCapture, runSaveCapture);
                 }
                 else
                 {
-                    success = uploadFile(buffer, len, sendCapture, saveCapture, captureExtention);
+                    success = uploadFile(buffer, len, runSendCapture, runSaveCapture, runCaptureExtension);
                 }
             }
         }
@@ -228,6 +223,25 @@ bool Interface::processBLOB(uint8_t* buffer, uint32_t ndims, int* dims, int bits
     return success;
 }
 
+bool Interface::prepare()
+{
+    runActive = PluginActive;
+    runSendCapture = sendCapture;
+    runSaveCapture = saveCapture;
+    snprintf(runCaptureExtension, MAXINDIBLOBFMT, "%s", captureExtention);
+    // The worker uploads through its own copy, FitsBP may be defined again meanwhile
+    runFitsBP = FitsBP;
+    runFitsB = FitsB;
+    runFitsBP.bp = &runFitsB;
+    return runActive;
+}
+
+void Interface::setUploadMode(bool send, bool save)
+{
+    sendCapture = send;
+    saveCapture = save;
+}
+
 void Interface::Activated()
 {
     m_Device->defineProperty(&FitsBP);
@@ -477,7 +491,7 @@ bool Interface::sendFITS(uint8_t *buf, bool sendCapture, bool saveCapture)
     }
     fits_close_file(fptr, &status);
 
-    uploadFile(memptr, memsize, sendCapture, saveCapture, captureExtention);
+    uploadFile(memptr, memsize, sendCapture, saveCapture, runCaptureExtension);
 
     free(memptr);
     return true;
@@ -489,12 +503,12 @@ bool Interface::uploadFile(const void *fitsData, size_t totalBytes, bool sendCap
     DEBUGF(INDI::Logger::DBG_DEBUG, "Uploading file. Ext: %s, Size: %d, sendCapture? %s, saveCapture? %s",
            format, totalBytes, sendCapture ? "Yes" : "No", saveCapture ? "Yes" : "No");
 
-    FitsB.blob = const_cast<void*>(fitsData);
-    FitsB.bloblen = static_cast<int>(totalBytes);
-    FitsB.size = totalBytes;
-    FitsBP.s   = IPS_BUSY;
+    runFitsB.blob = const_cast<void*>(fitsData);
+    runFitsB.bloblen = static_cast<int>(totalBytes);
+    runFitsB.size = totalBytes;
+    runFitsBP.s   = IPS_BUSY;
 
-    snprintf(FitsB.format, MAXINDIBLOBFMT, ".%s", captureExtention);
+    snprintf(runFitsB.format, MAXINDIBLOBFMT, ".%s", format);
 
     if (saveCapture)
     {
@@ -544,8 +558,8 @@ bool Interface::uploadFile(const void *fitsData, size_t totalBytes, bool sendCap
         }
 
         int n = 0;
-        for (int nr = 0; nr < static_cast<int>(FitsB.bloblen); nr += n)
-            n = fwrite((static_cast<char *>(FitsB.blob) + nr), 1, FitsB.bloblen - nr, fp);
+        for (int nr = 0; nr < static_cast<int>(runFitsB.bloblen); nr += n)
+            n = fwrite((static_cast<char *>(runFitsB.blob) + nr), 1, runFitsB.bloblen - nr, fp);
 
         fclose(fp);
         LOGF_INFO("File saved in %s.", processedFileName);
@@ -555,13 +569,13 @@ bool Interface::uploadFile(const void *fitsData, size_t totalBytes, bool sendCap
     {
 
         auto start = std::chrono::high_resolution_clock::now();
-        IDSetBLOB(&FitsBP, nullptr);
+        IDSetBLOB(&runFitsBP, nullptr);
         auto end = std::chrono::high_resolution_clock::now();
         std::chrono::duration<double> diff = end - start;
         LOGF_DEBUG("BLOB transfer took %g seconds", diff.count());
     }
 
-    FitsBP.s   = IPS_OK;
+    runFitsBP.s   = IPS_OK;
 
     DEBUG(INDI::Logger::DBG_DEBUG, "Upload complete");
 
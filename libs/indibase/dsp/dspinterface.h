@@ -99,6 +99,20 @@ class Interface
          */
         virtual bool processBLOB(uint8_t* buf, uint32_t ndims, int* dims, int bits_per_sample);
 
+        /**
+         * @brief prepare Copy the parameters processBLOB reads, so that it can run while the event loop changes them.
+         * DSP::Manager calls it with its plugins locked, right before processBLOB.
+         * @return True if the plugin is active and has what it needs to run, false otherwise.
+         */
+        virtual bool prepare();
+
+        /**
+         * @brief setUploadMode Set whether the results are sent to the client, saved locally or both, after UPLOAD_MODE.
+         * @param send Send the results to the client.
+         * @param save Save the results in the upload directory.
+         */
+        void setUploadMode(bool send, bool save);
+
         /**
          * @brief setSizes Set the returned file dimensions and corresponding sizes.
          * @param num Number of dimensions.
@@ -176,6 +190,8 @@ class Interface
         dsp_stream_p loadFITS(char* buf, int len);
 
         bool PluginActive;
+        // PluginActive as copied by prepare(), processBLOB checks this one
+        bool runActive { false };
 
         IBLOBVectorProperty FitsBP;
         IBLOB FitsB;
@@ -214,6 +230,15 @@ class Interface
 
     private:
         char captureExtention[MAXINDIBLOBFMT] { "fits" };
+        bool sendCapture { true };
+        bool saveCapture { false };
+
+        // Copies taken by prepare() for the worker, the event loop keeps the originals
+        char runCaptureExtension[MAXINDIBLOBFMT] { "fits" };
+        bool runSendCapture { true };
+        bool runSaveCapture { false };
+        IBLOBVectorProperty runFitsBP;
+        IBLOB runFitsB;
         void *buffer { nullptr };
         uint32_t BufferSizesQty {0 };
         int *BufferSizes { nullptr };
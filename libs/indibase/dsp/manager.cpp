@@ -17,6 +17,7 @@
 *******************************************************************************/
 
 #include "manager.h"
+#include "defaultdevice.h"
 #include "indistandardproperty.h"
 #include "indicom.h"
 #include "indilogger.h"
@@ -31,7 +32,7 @@
 
 namespace DSP
 {
-Manager::Manager(INDI::DefaultDevice *dev)
+Manager::Manager(INDI::DefaultDevice *dev) : m_Device(dev)
 {
     convolution = new Convolution(dev);
     dft = new FourierTransform(dev);
@@ -39,14 +40,26 @@ Manager::Manager(INDI::DefaultDevice *dev)
     spectrum = new Spectrum(dev);
     histogram = new Histogram(dev);
     wavelets = new Wavelets(dev);
+
+    framesThread = std::thread(&Manager::asyncProcessThread, this);
 }
 
 Manager::~Manager()
 {
+    if (framesThread.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(framesLock);
+            framesThreadTerminate = true;
+        }
+        framesChanged.notify_all();
+        framesThread.join();
+    }
 }
 
 void Manager::ISGetProperties(const char *dev)
 {
+    std::lock_guard<std::mutex> lock(pluginsLock);
     convolution->ISGetProperties(dev);
     dft->ISGetProperties(dev);
     idft->ISGetProperties(dev);
@@ -57,6 +70,7 @@ void Manager::ISGetProperties(const char *dev)
 
 bool Manager::updateProperties()
 {
+    std::lock_guard<std::mutex> lock(pluginsLock);
     bool r = false;
     r |= convolution->updateProperties();
     r |= dft->updateProperties();
@@ -69,6 +83,7 @@ bool Manager::updateProperties()
 
 bool Manager::ISNewSwitch(const char *dev, const char *name, ISState *states, char *names[], int num)
 {
+    std::lock_guard<std::mutex> lock(pluginsLock);
     bool r = false;
     r |= convolution->ISNewSwitch(dev, name, states, names, num);
     r |= dft->ISNewSwitch(dev, name, states, names, num);
@@ -81,6 +96,7 @@ bool Manager::ISNewSwitch(const char *dev, const char *name, ISState *states, ch
 
 bool Manager::ISNewText(const char *dev, const char *name, char *texts[], char *names[], int num)
 {
+    std::lock_guard<std::mutex> lock(pluginsLock);
     bool r = false;
     r |= convolution->ISNewText(dev, name, texts, names, num);
     r |= dft->ISNewText(dev, name, texts, names, num);
@@ -93,6 +109,7 @@ bool Manager::ISNewText(const char *dev, const char *name, char *texts[], char *
 
 bool Manager::ISNewNumber(const char *dev, const char *name, double values[], char *names[], int num)
 {
+    std::lock_guard<std::mutex> lock(pluginsLock);
     bool r = false;
     r |= convolution->ISNewNumber(dev, name, values, names, num);
     r |= dft->ISNewNumber(dev, name, values, names, num);
@@ -106,6 +123,7 @@ bool Manager::ISNewNumber(const char *dev, const char *name, double values[], ch
 bool Manager::ISNewBLOB(const char *dev, const char *name, int sizes[], int blobsizes[], char *blobs[], char *formats[],
                         char *names[], int num)
 {
+    std::lock_guard<std::mutex> lock(pluginsLock);
     bool r = false;
     r |= convolution->ISNewBLOB(dev, name, sizes, blobsizes, blobs, formats, names, num);
     r |= dft->ISNewBLOB(dev, name, sizes, blobsizes, blobs, formats, names, num);
@@ -118,6 +136,7 @@ bool Manager::ISNewBLOB(const char *dev, const char *name, int sizes[], int blob
 
 bool Manager::saveConfigItems(FILE *fp)
 {
+    std::lock_guard<std::mutex> lock(pluginsLock);
     bool r = false;
     r |= convolution->saveConfigItems(fp);
     r |= dft->saveConfigItems(fp);
@@ -130,17 +149,98 @@ bool Manager::saveConfigItems(FILE *fp)
 
 bool Manager::processBLOB(uint8_t* buf, uint32_t ndims, int* dims, int bits_per_sample)
 {
+    std::lock_guard<std::mutex> processGuard(processLock);
+    Interface *plugins[] = { convolution, dft, idft, spectrum, histogram, wavelets };
+    bool ready[6] = { false };
+    {
+        std::lock_guard<std::mutex> lock(pluginsLock);
+        for (int i = 0; i < 6; i++)
+            ready[i] = plugins[i]->prepare();
+    }
+
+    // The plugins run on their copies, so the event loop is free to update their properties meanwhile
     bool r = false;
-    r |= convolution->processBLOB(buf, ndims, dims, bits_per_sample);
-    r |= dft->processBLOB(buf, ndims, dims, bits_per_sample);
-    r |= idft->processBLOB(buf, ndims, dims, bits_per_sample);
-    r |= spectrum->processBLOB(buf, ndims, dims, bits_per_sample);
-    r |= histogram->processBLOB(buf, ndims, dims, bits_per_sample);
-    r |= wavelets->processBLOB(buf, ndims, dims, bits_per_sample);
+    for (int i = 0; i < 6; i++)
+        if (ready[i])
+            r |= plugins[i]->processBLOB(buf, ndims, dims, bits_per_sample);
     return r;
 }
+
+bool Manager::processBLOBAsync(const uint8_t* buf, size_t len, uint32_t ndims, const int* dims, int bits_per_sample)
+{
+    if (buf == nullptr || len == 0)
+        return false;
+
+    Frame frame;
+    {
+        std::lock_guard<std::mutex> lock(framesLock);
+        if (!framesFree.empty())
+        {
+            frame = std::move(framesFree.back());
+            framesFree.pop_back();
+        }
+    }
+
+    // assign() keeps the capacity of a recycled buffer, so steady state runs without allocations
+    frame.buffer.assign(buf, buf + len);
+    frame.sizes.assign(dims, dims + ndims);
+    frame.bps = bits_per_sample;
+
+    std::unique_lock<std::mutex> lock(framesLock);
+    // Drop the oldest pending frames, the most recent one is the most relevant for analysis
+    while (!framesIncoming.empty() && framesIncoming.size() >= maxQueuedFrames)
+    {
+        droppedFrames++;
+        DEBUGFDEVICE(m_Device->getDeviceName(), INDI::Logger::DBG_DEBUG,
+                     "DSP queue is full, dropping oldest frame (%llu dropped so far).",
+                     static_cast<unsigned long long>(droppedFrames.load()));
+        if (framesFree.size() < maxQueuedFrames)
+            framesFree.push_back(std::move(framesIncoming.front()));
+        framesIncoming.pop_front();
+    }
+    framesIncoming.push_back(std::move(frame));
+    lock.unlock();
+
+    framesChanged.notify_one();
+    return true;
+}
+
+void Manager::recycleFrame(Frame &&frame)
+{
+    std::lock_guard<std::mutex> lock(framesLock);
+    if (framesFree.size() < maxQueuedFrames)
+        framesFree.push_back(std::move(frame));
+}
+
+void Manager::asyncProcessThread()
+{
+    Frame frame;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(framesLock);
+            framesChanged.wait(lock, [this]()
+            {
+                return framesThreadTerminate || !framesIncoming.empty();
+            });
+            if (framesThreadTerminate)
+                return;
+            frame = std::move(framesIncoming.front());
+            framesIncoming.pop_front();
+        }
+
+        processBLOB(frame.buffer.data(), static_cast<uint32_t>(frame.sizes.size()), frame.sizes.data(), frame.bps);
+
+        // plugins keep a pointer to the sizes until their next run, so only the pixel buffer goes back to the pool
+        Frame spare;
+        spare.buffer.swap(frame.buffer);
+        recycleFrame(std::move(spare));
+    }
+}
+
 void Manager::setCaptureFileExtension(const char *ext)
 {
+    std::lock_guard<std::mutex> lock(pluginsLock);
     convolution->setCaptureFileExtension(ext);
     dft->setCaptureFileExtension(ext);
     idft->setCaptureFileExtension(ext);
@@ -148,4 +248,15 @@ void Manager::setCaptureFileExtension(const char *ext)
     histogram->setCaptureFileExtension(ext);
     wavelets->setCaptureFileExtension(ext);
 }
+
+void Manager::setUploadMode(bool sendCapture, bool saveCapture)
+{
+    std::lock_guard<std::mutex> lock(pluginsLock);
+    convolution->setUploadMode(sendCapture, saveCapture);
+    dft->setUploadMode(sendCapture, saveCapture);
+    idft->setUploadMode(sendCapture, saveCapture);
+    spectrum->setUploadMode(sendCapture, saveCapture);
+    histogram->setUploadMode(sendCapture, saveCapture);
+    wavelets->setUploadMode(sendCapture, saveCapture);
+}
 }
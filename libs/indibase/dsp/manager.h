@@ -25,8 +25,16 @@
 #include "transforms.h"
 
 #include <fitsio.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
 #include <functional>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
 namespace INDI
 {
@@ -52,15 +60,36 @@ class Manager
 
         bool processBLOB(uint8_t* buf, uint32_t ndims, int* dims, int bits_per_sample);
 
-        inline void setSizes(uint32_t num, int* sizes)
+        /**
+         * @brief processBLOBAsync Copy the buffer into a recycled frame and queue it for the DSP worker thread.
+         * The caller does not wait for the plugins to run. When maxQueuedFrames frames are already pending,
+         * the oldest one is dropped so analysis products never hold back the primary image.
+         * @return true if the frame was queued.
+         */
+        bool processBLOBAsync(const uint8_t* buf, size_t len, uint32_t ndims, const int* dims, int bits_per_sample);
+
+        inline void setMaxQueuedFrames(size_t count)
+        {
+            maxQueuedFrames = std::max<size_t>(1, count);
+        }
+        inline size_t getMaxQueuedFrames() const
+        {
+            return maxQueuedFrames;
+        }
+        /** @return number of frames dropped because the queue was full. */
+        inline uint64_t getDroppedFrames() const
+        {
+            return droppedFrames;
+        }
+
+        inline void setSizes(uint32_t num, const int* sizes)
         {
-            BufferSizes = sizes;
-            BufferSizesQty = num;
+            BufferSizes.assign(sizes, sizes + num);
         }
         inline void getSizes(uint32_t *num, int** sizes)
         {
-            *sizes = BufferSizes;
-            *num = BufferSizesQty;
+            *sizes = BufferSizes.data();
+            *num = static_cast<uint32_t>(BufferSizes.size());
         }
 
         inline void setBPS(int bps)
@@ -74,15 +103,48 @@ class Manager
 
         void setCaptureFileExtension(const char *ext);
 
+        /**
+         * @brief setUploadMode Pass UPLOAD_MODE of the device on to the plugins, the worker never reads the property itself.
+         * @param sendCapture Send the results to the client.
+         * @param saveCapture Save the results in the upload directory.
+         */
+        void setUploadMode(bool sendCapture, bool saveCapture);
+
     private:
+        struct Frame
+        {
+            std::vector<uint8_t> buffer;
+            std::vector<int> sizes;
+            int bps {0};
+        };
+
+        void asyncProcessThread();
+        void recycleFrame(Frame &&frame);
+
+        INDI::DefaultDevice *m_Device {nullptr};
+
+        std::thread              framesThread;
+        std::mutex               framesLock;      // guards the frames and framesThreadTerminate
+        std::condition_variable  framesChanged;
+        bool                     framesThreadTerminate {false};
+        std::deque<Frame>        framesIncoming;
+        std::vector<Frame>       framesFree;      // buffers kept for reuse by the next frames
+        std::atomic<size_t>      maxQueuedFrames {2};
+        std::atomic<uint64_t>    droppedFrames {0};
+
+        // Guards the plugin properties, which change on the event loop. processBLOB only holds it
+        // while the plugins copy their parameters, never for the run itself.
+        std::mutex               pluginsLock;
+        // Serializes the runs, a plugin keeps its working stream between them
+        std::mutex               processLock;
+
         Convolution *convolution;
         FourierTransform *dft;
         InverseFourierTransform *idft;
         Spectrum *spectrum;
         Histogram *histogram;
         Wavelets *wavelets;
-        uint32_t BufferSizesQty;
-        int *BufferSizes;
+        std::vector<int> BufferSizes;
         int BPS;
 };
 }
@@ -42,7 +42,7 @@ FourierTransform::~FourierTransform()
 
 bool FourierTransform::processBLOB(uint8_t *buf, uint32_t dims, int *sizes, int bits_per_sample)
 {
-    if(!PluginActive) return false;
+    if(!runActive) return false;
     setStream(buf, dims, sizes, bits_per_sample);
 
     dsp_fourier_dft(stream, 1);
@@ -71,17 +71,36 @@ void InverseFourierTransform::Deactivated()
     Interface::Deactivated();
 }
 
+bool InverseFourierTransform::prepare()
+{
+    if(!Interface::prepare()) return false;
+    if(!phase_loaded || phase == nullptr) return false;
+    // ISNewBLOB frees the phase it replaces, so the worker keeps a copy of its own
+    if(phase_changed)
+    {
+        if(runPhase != nullptr)
+        {
+            dsp_stream_free_buffer(runPhase);
+            dsp_stream_free(runPhase);
+        }
+        runPhase = dsp_stream_copy(phase);
+        phase_changed = false;
+    }
+    return true;
+}
+
 bool InverseFourierTransform::processBLOB(uint8_t *buf, uint32_t dims, int *sizes, int bits_per_sample)
 {
-    if(!PluginActive) return false;
-    if(!phase_loaded) return false;
+    if(!runActive) return false;
+    if(runPhase == nullptr) return false;
     setStream(buf, dims, sizes, bits_per_sample);
-    if (phase->dims != stream->dims) return false;
+    if (runPhase->dims != stream->dims) return false;
     for (int d = 0; d < stream->dims; d++)
-        if (phase->sizes[d] != stream->sizes[d])
+        if (runPhase->sizes[d] != stream->sizes[d])
             return false;
     setMagnitude(buf, dims, sizes, bits_per_sample);
-    stream->phase = phase;
+    // the stream frees its phase with itself on the next setStream()
+    stream->phase = dsp_stream_copy(runPhase);
     dsp_buffer_set(stream->buf, stream->len, 0);
     dsp_fourier_idft(stream);
     return Interface::processBLOB(getStream(), stream->dims, stream->sizes, bits_per_sample);
@@ -106,6 +125,7 @@ bool InverseFourierTransform::ISNewBLOB(const char *dev, const char *name, int s
             {
                 LOGF_INFO("Phase for %s loaded", getDeviceName());
                 phase_loaded = true;
+                phase_changed = true;
                 return true;
             }
         }
@@ -123,7 +143,7 @@ Spectrum::~Spectrum()
 
 bool Spectrum::processBLOB(uint8_t *buf, uint32_t dims, int *sizes, int bits_per_sample)
 {
-    if(!PluginActive) return false;
+    if(!runActive) return false;
     setStream(buf, dims, sizes, bits_per_sample);
 
     dsp_fourier_dft(stream, 1);
@@ -142,7 +162,7 @@ Histogram::~Histogram()
 
 bool Histogram::processBLOB(uint8_t *buf, uint32_t dims, int *sizes, int bits_per_sample)
 {
-    if(!PluginActive) return false;
+    if(!runActive) return false;
     setStream(buf, dims, sizes, bits_per_sample);
 
     double *histo = dsp_stats_histogram(stream, 4096);
@@ -44,6 +44,7 @@ class InverseFourierTransform : public Interface
         bool ISNewBLOB(const char *dev, const char *name, int sizes[], int blobsizes[], char *blobs[], char *formats[],
                        char *names[], int n) override;
         virtual bool processBLOB(uint8_t *out, uint32_t dims, int *sizes, int bits_per_sample) override;
+        bool prepare() override;
 
     protected:
         ~InverseFourierTransform();
@@ -54,8 +55,11 @@ class InverseFourierTransform : public Interface
         IBLOBVectorProperty DownloadBP;
         IBLOB DownloadB;
 
-        dsp_stream_p phase;
+        dsp_stream_p phase { nullptr };
         bool phase_loaded { false };
+        bool phase_changed { false };
+        // copy of phase used by processBLOB
+        dsp_stream_p runPhase { nullptr };
 };
 
 class Spectrum : public Interface
@@ -0,0 +1,359 @@
+/**  INDI LIB
+ *   Native FITS writer
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Lesser General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2.1 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "fitswriter.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+// FITS files are made of blocks of 36 cards of 80 characters
+#define FITS_BLOCK 2880
+#define FITS_CARD 80
+
+// Pixels converted per inner loop, a fixed count lets the compiler vectorize it
+#define ENCODE_CHUNK 64
+
+namespace INDI
+{
+
+static size_t padded(size_t size)
+{
+    return (size + FITS_BLOCK - 1) / FITS_BLOCK * FITS_BLOCK;
+}
+
+// The keywords fits_update_key_*() writes as is: 8 characters at most, upper case, digits, '-' and '_'
+static bool normalizeKey(const std::string &key, std::string &normalized)
+{
+    if (key.empty() || key.size() > 8)
+        return false;
+
+    normalized.clear();
+    for (char c : key)
+    {
+        c = static_cast<char>(toupper(static_cast<unsigned char>(c)));
+        if (!isupper(static_cast<unsigned char>(c)) && !isdigit(static_cast<unsigned char>(c)) && c != '-' && c != '_')
+            return false;
+        normalized += c;
+    }
+
+    // Structural keywords belong to the writer
+    static const char *reserved[] = { "SIMPLE", "BITPIX", "EXTEND", "BZERO", "BSCALE", "END", "COMMENT", "HISTORY" };
+    for (auto word : reserved)
+        if (normalized == word)
+            return false;
+    return normalized.compare(0, 5, "NAXIS") != 0;
+}
+
+static bool printable(const std::string &text)
+{
+    return std::all_of(text.begin(), text.end(), [](char c)
+    {
+        return c >= 32 && c <= 126;
+    });
+}
+
+// Quoted the way ffs2c() does: quotes doubled, at least 8 characters, 68 at most
+static std::string quote(const std::string &value)
+{
+    std::string quoted = "'";
+    for (char c : value)
+    {
+        size_t needed = (c == '\'') ? 2 : 1;
+        if (quoted.size() - 1 + needed > 68)
+            break;
+        quoted += c;
+        if (c == '\'')
+            quoted += c;
+    }
+    if (quoted.size() < 9)
+        quoted.resize(9, ' ');
+    return quoted + "'";
+}
+
+// Formatted the way ffd2e() does
+static std::string formatDouble(double value, int decimal)
+{
+    char buffer[72];
+    if (decimal < 0)
+    {
+        snprintf(buffer, sizeof(buffer), "%.*G", -decimal, value);
+        char *exponent = strchr(buffer, 'E');
+        if (exponent != nullptr && strchr(buffer, '.') == nullptr && strchr(buffer, ',') == nullptr)
+        {
+            std::string fixed(buffer, exponent);
+            return fixed + ".0" + exponent;
+        }
+    }
+    else
+        snprintf(buffer, sizeof(buffer), "%.*E", decimal, value);
+
+    // Whatever the locale
+    char *comma = strchr(buffer, ',');
+    if (comma != nullptr)
+        *comma = '.';
+    if (strchr(buffer, '.') == nullptr && strchr(buffer, 'E') == nullptr)
+        strcat(buffer, ".");
+    return buffer;
+}
+
+FITSWriter::FITSWriter(int bpp, int naxis, const long naxes[]) : m_BPP(bpp), m_Axes(naxes, naxes + naxis)
+{
+    // What fits_create_img() writes
+    addCard("SIMPLE", "T", "file does conform to FITS standard");
+    addCard("BITPIX", std::to_string(bpp), "number of bits per data pixel");
+    addCard("NAXIS", std::to_string(naxis), "number of data axes");
+    for (int i = 0; i < naxis; i++)
+        addCard("NAXIS" + std::to_string(i + 1), std::to_string(naxes[i]), "length of data axis " + std::to_string(i + 1));
+    addCard("EXTEND", "T", "FITS dataset may contain extensions");
+    for (auto comment :
+            {
+                "  FITS (Flexible Image Transport System) format is defined in 'Astronomy",
+                "  and Astrophysics', volume 376, page 359; bibcode: 2001A&A...376..359H"
+            })
+    {
+        std::string card = std::string("COMMENT ") + comment;
+        card.resize(FITS_CARD, ' ');
+        m_Cards.push_back(card);
+    }
+    if (bpp == 16)
+    {
+        addCard("BZERO", "32768", "offset data range to that of unsigned short");
+        addCard("BSCALE", "1", "default scaling factor");
+    }
+    else if (bpp == 32)
+    {
+        addCard("BZERO", "2147483648", "offset data range to that of unsigned long");
+        addCard("BSCALE", "1", "default scaling factor");
+    }
+}
+
+void FITSWriter::addCard(const std::string &key, const std::string &value, const std::string &comment)
+{
+    std::string card = key;
+    card.resize(8, ' ');
+    card += "= ";
+    // Strings start in column 11, other values end in column 30
+    if (value[0] != '\'' && value.size() < 20)
+        card.append(20 - value.size(), ' ');
+    card += value;
+    if (!comment.empty())
+        card += " / " + comment;
+    card.resize(FITS_CARD, ' ');
+
+    // fits_update_key_*() replaces the card of a keyword already written
+    for (auto &existing : m_Cards)
+    {
+        if (existing.compare(0, 10, card, 0, 10) == 0)
+        {
+            existing = card;
+            return;
+        }
+    }
+    m_Cards.push_back(card);
+}
+
+bool FITSWriter::setRecords(const std::vector<FITSRecord> &records)
+{
+    if (m_BPP != 8 && m_BPP != 16 && m_BPP != 32)
+        return false;
+
+    std::string key;
+    for (auto &record : records)
+    {
+        if (record.type() == FITSRecord::VOID)
+            continue;
+
+        if (!printable(record.comment()))
+            return false;
+
+        if (record.type() == FITSRecord::COMMENT)
+        {
+            // fits_write_comment() splits long comments over several cards
+            size_t offset = 0;
+            do
+            {
+                std::string card = "COMMENT " + record.comment().substr(offset, FITS_CARD - 8);
+                card.resize(FITS_CARD, ' ');
+                m_Cards.push_back(card);
+                offset += FITS_CARD - 8;
+            }
+            while (offset < record.comment().size());
+            continue;
+        }
+
+        if (!normalizeKey(record.key(), key))
+            return false;
+
+        switch (record.type())
+        {
+            case FITSRecord::STRING:
+                if (!printable(record.valueString()))
+                    return false;
+                addCard(key, quote(record.valueString()), record.comment());
+                break;
+            case FITSRecord::LONGLONG:
+                addCard(key, std::to_string(record.valueInt()), record.comment());
+                break;
+            case FITSRecord::DOUBLE:
+                // CFITSIO reports an error for these
+                if (!std::isfinite(record.valueDouble()))
+                    return false;
+                addCard(key, formatDouble(record.valueDouble(), record.decimal()), record.comment());
+                break;
+            default:
+                return false;
+        }
+    }
+
+    m_Header.clear();
+    m_Header.reserve(padded((m_Cards.size() + 1) * FITS_CARD));
+    for (auto &card : m_Cards)
+        m_Header += card;
+    m_Header += "END";
+    m_Header.resize(padded(m_Header.size()), ' ');
+    return true;
+}
+
+size_t FITSWriter::size() const
+{
+    size_t pixels = 1;
+    for (auto axis : m_Axes)
+        pixels *= axis;
+    return m_Header.size() + padded(pixels * (m_BPP / 8));
+}
+
+void FITSWriter::write(void *out, const void *pixels) const
+{
+    auto bytes = static_cast<uint8_t *>(out);
+    memcpy(bytes, m_Header.data(), m_Header.size());
+    bytes += m_Header.size();
+
+    size_t count = 1;
+    for (auto axis : m_Axes)
+        count *= axis;
+    encodePixels(bytes, pixels, count, m_BPP);
+
+    size_t dataSize = count * (m_BPP / 8);
+    memset(bytes + dataSize, 0, padded(dataSize) - dataSize);
+}
+
+int FITSWriter::writeWithCFITSIO(fitsfile *fptr, int bpp, int naxis, long naxes[], const std::vector<FITSRecord> &records,
+                                 const void *pixels, long nelements, const std::function<void(const FITSRecord &, int)> &keyError)
+{
+    int imgType, dataType;
+    switch (bpp)
+    {
+        case 8:
+            imgType  = BYTE_IMG;
+            dataType = TBYTE;
+            break;
+        case 16:
+            imgType  = USHORT_IMG;
+            dataType = TUSHORT;
+            break;
+        case 32:
+            imgType  = ULONG_IMG;
+            dataType = TULONG;
+            break;
+        default:
+            return BAD_BITPIX;
+    }
+
+    int status = 0;
+    fits_create_img(fptr, imgType, naxis, naxes, &status);
+    if (status)
+        return status;
+
+    for (auto &record : records)
+    {
+        int keyStatus = 0;
+        switch (record.type())
+        {
+            case FITSRecord::VOID:
+                break;
+            case FITSRecord::COMMENT:
+                fits_write_comment(fptr, record.comment().c_str(), &keyStatus);
+                break;
+            case FITSRecord::STRING:
+                fits_update_key_str(fptr, record.key().c_str(), record.valueString().c_str(), record.comment().c_str(), &keyStatus);
+                break;
+            case FITSRecord::LONGLONG:
+                fits_update_key_lng(fptr, record.key().c_str(), record.valueInt(), record.comment().c_str(), &keyStatus);
+                break;
+            case FITSRecord::DOUBLE:
+                fits_update_key_dbl(fptr, record.key().c_str(), record.valueDouble(), record.decimal(), record.comment().c_str(),
+                                    &keyStatus);
+                break;
+        }
+        if (keyStatus && keyError)
+            keyError(record, keyStatus);
+    }
+
+    fits_write_img(fptr, dataType, 1, nelements, const_cast<void *>(pixels), &status);
+    return status;
+}
+
+// Shifts rather than bswap builtins so 16 bits pixels vectorize with baseline SSE2 and NEON
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define TO_BIG_ENDIAN16(x) (x)
+#define TO_BIG_ENDIAN32(x) (x)
+#else
+#define TO_BIG_ENDIAN16(x) static_cast<uint16_t>(static_cast<uint16_t>((x) << 8) | static_cast<uint16_t>((x) >> 8))
+#define TO_BIG_ENDIAN32(x) (((x) << 24) | (((x) << 8) & 0xff0000u) | (((x) >> 8) & 0xff00u) | ((x) >> 24))
+#endif
+
+template <typename T, typename Encode>
+static void encode(T * __restrict dst, const T * __restrict src, size_t count, Encode convert)
+{
+    size_t i = 0;
+    for (; i + ENCODE_CHUNK <= count; i += ENCODE_CHUNK)
+        for (size_t j = 0; j < ENCODE_CHUNK; j++)
+            dst[i + j] = convert(src[i + j]);
+    for (; i < count; i++)
+        dst[i] = convert(src[i]);
+}
+
+void FITSWriter::encodePixels(void *out, const void *pixels, size_t count, int bpp)
+{
+    // Subtracting BZERO from an unsigned value flips its top bit
+    switch (bpp)
+    {
+        case 8:
+            memcpy(out, pixels, count);
+            break;
+        case 16:
+            encode(static_cast<uint16_t *>(out), static_cast<const uint16_t *>(pixels), count, [](uint16_t value)
+            {
+                uint16_t offset = value ^ 0x8000;
+                return TO_BIG_ENDIAN16(offset);
+            });
+            break;
+        case 32:
+            encode(static_cast<uint32_t *>(out), static_cast<const uint32_t *>(pixels), count, [](uint32_t value)
+            {
+                uint32_t offset = value ^ 0x80000000u;
+                return TO_BIG_ENDIAN32(offset);
+            });
+            break;
+    }
+}
+
+}
@@ -0,0 +1,89 @@
+/**  INDI LIB
+ *   Native FITS writer
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Lesser General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2.1 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#pragma once
+
+#include "fitskeyword.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace INDI
+{
+
+/**
+ * @brief The FITSWriter class serializes an unsigned 8, 16 or 32 bits image to a single HDU FITS file
+ * without CFITSIO.
+ *
+ * The header is rendered the way fits_create_img() and fits_update_key_*() would, the pixels are
+ * offset by BZERO and converted to big endian in one pass straight into the output buffer.
+ * setRecords() refuses records CFITSIO would write differently (HIERARCH keywords, NaN values),
+ * the caller then falls back to CFITSIO.
+ */
+class FITSWriter
+{
+    public:
+        /**
+         * @param bpp bits per pixel, 8, 16 or 32.
+         * @param naxis 2, or 3 for color images.
+         * @param naxes length of each axis.
+         */
+        FITSWriter(int bpp, int naxis, const long naxes[]);
+
+        /** @brief Render the header. Later records update earlier records with the same key. */
+        bool setRecords(const std::vector<FITSRecord> &records);
+
+        /** @brief Size of the whole file, header and data padded to 2880 bytes */
+        size_t size() const;
+
+        /** @brief Write the file to out, which holds size() bytes. pixels are in host order. */
+        void write(void *out, const void *pixels) const;
+
+        const std::string &header() const
+        {
+            return m_Header;
+        }
+
+        /** @brief Subtract the BZERO offset from count pixels and store them big endian */
+        static void encodePixels(void *out, const void *pixels, size_t count, int bpp);
+
+        /**
+         * @brief Write the image with CFITSIO instead, for the records setRecords() refuses.
+         * @param fptr empty file to create the image in.
+         * @param keyError called with the CFITSIO status of each record that could not be written,
+         * the other records are still written.
+         * @return CFITSIO status of the image.
+         */
+        static int writeWithCFITSIO(fitsfile *fptr, int bpp, int naxis, long naxes[], const std::vector<FITSRecord> &records,
+                                    const void *pixels, long nelements,
+                                    const std::function<void(const FITSRecord &, int)> &keyError = nullptr);
+
+    private:
+        void addCard(const std::string &key, const std::string &value, const std::string &comment);
+
+    private:
+        int m_BPP;
+        std::vector<long> m_Axes;
+        std::vector<std::string> m_Cards;
+        std::string m_Header;
+};
+
+}
@@ -30,13 +30,12 @@
 #include "indiccd.h"
 
 #include "fpack/fpack.h"
+#include "fitswriter.h"
+#include "xisfwriter.h"
 #include "indicom.h"
 #include "locale_compat.h"
 #include "indiutility.h"
-
-#ifdef HAVE_XISF
-#include <libxisf.h>
-#endif
+#include "sharedblob.h"
 
 #include <fitsio.h>
 
@@ -125,12 +124,21 @@ CCD::CCD() : GI(this)
     m_TemperatureCheckTimer.setInterval(5000);
     m_TemperatureCheckTimer.callOnTimeout(std::bind(&CCD::checkTemperatureTarget, this));
 
+#ifdef HAVE_WEBSOCKET
+    // Websocket clients statistics every second, frames may come much faster
+    m_WebSocketClientsTimer.setInterval(1000);
+    m_WebSocketClientsTimer.callOnTimeout(std::bind(&CCD::updateWebSocketClients, this));
+#endif
+
     exposureStartTime[0] = 0;
     exposureDuration = 0.0;
 }
 
 CCD::~CCD()
 {
+    // Uploads still running use the chips and properties
+    m_ExposureTasks.quit();
+
     // Only update if index is different.
     if (m_ConfigFastExposureIndex != FastExposureToggleSP.findOnSwitchIndex())
         saveConfig(FastExposureToggleSP);
@@ -397,10 +405,8 @@ bool CCD::initProperties()
                                      m_ConfigEncodeFormatIndex == FORMAT_FITS ? ISS_ON : ISS_OFF);
     EncodeFormatSP[FORMAT_NATIVE].fill("FORMAT_NATIVE", "Native",
                                        m_ConfigEncodeFormatIndex == FORMAT_NATIVE ? ISS_ON : ISS_OFF);
-#ifdef HAVE_XISF
     EncodeFormatSP[FORMAT_XISF].fill("FORMAT_XISF", "XISF",
                                      m_ConfigEncodeFormatIndex == FORMAT_XISF ? ISS_ON : ISS_OFF);
-#endif
     EncodeFormatSP.fill(getDeviceName(), "CCD_TRANSFER_FORMAT", "Encode", IMAGE_SETTINGS_TAB, IP_RW, ISR_1OFMANY, 60,
                         IPS_IDLE);
 
@@ -470,6 +476,10 @@ bool CCD::initProperties()
                              OPTIONS_TAB, IP_RW,
                              60, IPS_IDLE);
 
+    // One element per connected client, defined while there are clients
+    WebSocketClientsTP.fill(getDeviceName(), "CCD_WEBSOCKET_CLIENTS", "WS Clients",
+                            OPTIONS_TAB, IP_RO, 60, IPS_IDLE);
+
     /**********************************************/
     /**************** Snooping ********************/
     /**********************************************/
@@ -496,30 +506,9 @@ bool CCD::initProperties()
                    "Main Control", IP_RW,
                    60, IPS_IDLE);
 
-    // Snoop properties of interest
-
-    // Snoop mount
-    IDSnoopDevice(mount, "EQUATORIAL_EOD_COORD");
-    IDSnoopDevice(mount, "EQUATORIAL_COORD");
-    IDSnoopDevice(mount, "TELESCOPE_INFO");
-    IDSnoopDevice(mount, "GEOGRAPHIC_COORD");
-    IDSnoopDevice(mount, "TELESCOPE_PIER_SIDE");
-
-    // Snoop Rotator
-    IDSnoopDevice(ActiveDeviceTP[ACTIVE_ROTATOR].getText(), "ABS_ROTATOR_ANGLE");
-
-    // JJ ed 2019-12-10
-    // Snoop Focuser
-    IDSnoopDevice(ActiveDeviceTP[ACTIVE_FOCUSER].getText(), "ABS_FOCUS_POSITION");
-    IDSnoopDevice(ActiveDeviceTP[ACTIVE_FOCUSER].getText(), "FOCUS_TEMPERATURE");
-    //
-
-    // Snoop Filter Wheel
-    IDSnoopDevice(ActiveDeviceTP[ACTIVE_FILTER].getText(), "FILTER_SLOT");
-    IDSnoopDevice(ActiveDeviceTP[ACTIVE_FILTER].getText(), "FILTER_NAME");
-
-    // Snoop Sky Quality Meter
-    IDSnoopDevice(ActiveDeviceTP[ACTIVE_SKYQUALITY].getText(), "SKY_QUALITY");
+    // Snoop properties of interest of the mount, rotator, focuser, filter wheel and sky quality meter
+    for (int i = ACTIVE_TELESCOPE; i <= ACTIVE_SKYQUALITY; i++)
+        snoopActiveDevice(i, nullptr);
 
     // Guider Interface
     GI::initProperties(GUIDE_CONTROL_TAB);
@@ -730,6 +719,7 @@ bool CCD::updateProperties()
         {
             deleteProperty(WebSocketSP);
             deleteProperty(WebSocketSettingsNP);
+            deleteProperty(WebSocketClientsTP);
         }
 #endif
         deleteProperty(FastExposureToggleSP);
@@ -752,166 +742,182 @@ bool CCD::updateProperties()
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 bool CCD::ISSnoopDevice(XMLEle * root)
 {
-    XMLEle * ep           = nullptr;
-    auto propName = findXMLAttValu(root, "name");
-    auto deviceName = std::string(findXMLAttValu(root, "device"));
-
-    if ((EqNP.snoop(root)))
-    {
-        double newra, newdec;
-        newra  = EqNP[Ra].getValue();
-        newdec = EqNP[DEC].getValue();
-        if ((newra != RA) || (newdec != Dec))
-        {
-            //IDLog("RA %4.2f  Dec %4.2f Snooped RA %4.2f  Dec %4.2f\n",RA,Dec,newra,newdec);
-            RA  = newra;
-            Dec = newdec;
-        }
-    }
-    else if (J2000EqNP.snoop(root))
-    {
-        float newra, newdec;
-        newra  = J2000EqNP[Ra].getValue();
-        newdec = J2000EqNP[DEC].getValue();
-        if ((newra != J2000RA) || (newdec != J2000DE))
-        {
-            //    	    IDLog("J2000 RA %4.2f  Dec %4.2f Snooped RA %4.2f  Dec %4.2f\n",J2000RA,J2000DE,newra,newdec);
-            J2000RA = newra;
-            J2000DE = newdec;
-        }
-        J2000Valid = true;
-    }
-    else if (!strcmp("TELESCOPE_PIER_SIDE", propName) && deviceName == ActiveDeviceTP[ACTIVE_TELESCOPE].getText())
-    {
-        // set default to say we have no valid information from mount
-        pierSide = -1;
-        //  crack the message
-        for (ep = nextXMLEle(root, 1); ep != nullptr; ep = nextXMLEle(root, 0))
-        {
-            const char * elemName = findXMLAttValu(ep, "name");
+    // The properties of the active devices go to the handlers of snoopActiveDevice()
+    return DefaultDevice::ISSnoopDevice(root);
+}
 
-            if (!strcmp(elemName, "PIER_EAST") && !strcmp(pcdataXMLEle(ep), "On"))
-                pierSide = 1;
-            else if (!strcmp(elemName, "PIER_WEST") && !strcmp(pcdataXMLEle(ep), "On"))
-                pierSide = 0;
-        }
-    }
-    // Deprecated
-    else if (!strcmp(propName, "TELESCOPE_INFO") && deviceName == ActiveDeviceTP[ACTIVE_TELESCOPE].getText())
-    {
-        for (ep = nextXMLEle(root, 1); ep != nullptr; ep = nextXMLEle(root, 0))
-        {
-            const char * name = findXMLAttValu(ep, "name");
+// Text of the element of a snooped property, nullptr if it is not there
+static const char *snoopedValue(XMLEle * root, const char * name)
+{
+    for (XMLEle * ep = nextXMLEle(root, 1); ep != nullptr; ep = nextXMLEle(root, 0))
+        if (!strcmp(findXMLAttValu(ep, "name"), name))
+            return pcdataXMLEle(ep);
+    return nullptr;
+}
 
-            if (!strcmp(name, "TELESCOPE_APERTURE"))
-            {
-                snoopedAperture = atof(pcdataXMLEle(ep));
-            }
-            else if (!strcmp(name, "TELESCOPE_FOCAL_LENGTH"))
-            {
-                snoopedFocalLength = atof(pcdataXMLEle(ep));
-            }
-        }
-    }
-    else if (!strcmp(propName, "FILTER_NAME") && deviceName == ActiveDeviceTP[ACTIVE_FILTER].getText())
-    {
-        auto newFilterNames = std::vector<std::string>();
-        for (ep = nextXMLEle(root, 1); ep != nullptr; ep = nextXMLEle(root, 0))
-            newFilterNames.push_back(pcdataXMLEle(ep));
-        if (newFilterNames != FilterNames)
-        {
-            FilterNames = newFilterNames;
-            LOGF_DEBUG("SNOOP: FILTER_NAME -> %s", join(FilterNames, ", ").c_str());
-        }
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void CCD::snoopActiveDevice(int index, const char * previous)
+{
+    // Properties of interest of each active device, each with its own handler
+    std::vector<std::pair<const char *, std::function<void (XMLEle *)>>> handlers;
 
-    }
-    else if (!strcmp(propName, "FILTER_SLOT") && deviceName == ActiveDeviceTP[ACTIVE_FILTER].getText())
+    switch (index)
     {
-        auto newFilterSlot = -1;
-        for (ep = nextXMLEle(root, 1); ep != nullptr; ep = nextXMLEle(root, 0))
-            newFilterSlot = atoi(pcdataXMLEle(ep));
-        if (newFilterSlot != CurrentFilterSlot)
-        {
-            CurrentFilterSlot = newFilterSlot;
-            LOGF_DEBUG("SNOOP: FILTER_SLOT is %d", CurrentFilterSlot);
-        }
-    }
-    else if (!strcmp(propName, "SKY_QUALITY") && deviceName == ActiveDeviceTP[ACTIVE_SKYQUALITY].getText())
-    {
-        for (ep = nextXMLEle(root, 1); ep != nullptr; ep = nextXMLEle(root, 0))
-        {
-            const char * name = findXMLAttValu(ep, "name");
-
-            if (!strcmp(name, "SKY_BRIGHTNESS"))
+        case ACTIVE_TELESCOPE:
+            handlers =
             {
-                MPSAS = atof(pcdataXMLEle(ep));
-                break;
-            }
-        }
-    }
-    else if (!strcmp(propName, "ABS_ROTATOR_ANGLE") && deviceName == ActiveDeviceTP[ACTIVE_ROTATOR].getText())
-    {
-        for (ep = nextXMLEle(root, 1); ep != nullptr; ep = nextXMLEle(root, 0))
-        {
-            const char * name = findXMLAttValu(ep, "name");
+                {
+                    "EQUATORIAL_EOD_COORD", [this](XMLEle * root)
+                    {
+                        if (EqNP.snoop(root))
+                        {
+                            RA  = EqNP[Ra].getValue();
+                            Dec = EqNP[DEC].getValue();
+                        }
+                    }
+                },
+                {
+                    "EQUATORIAL_COORD", [this](XMLEle * root)
+                    {
+                        if (J2000EqNP.snoop(root))
+                        {
+                            J2000RA = J2000EqNP[Ra].getValue();
+                            J2000DE = J2000EqNP[DEC].getValue();
+                            J2000Valid = true;
+                        }
+                    }
+                },
+                {
+                    "TELESCOPE_PIER_SIDE", [this](XMLEle * root)
+                    {
+                        // set default to say we have no valid information from mount
+                        pierSide = -1;
+                        auto east = snoopedValue(root, "PIER_EAST");
+                        auto west = snoopedValue(root, "PIER_WEST");
+                        if (east && !strcmp(east, "On"))
+                            pierSide = 1;
+                        else if (west && !strcmp(west, "On"))
+                            pierSide = 0;
+                    }
+                },
+                // Deprecated
+                {
+                    "TELESCOPE_INFO", [this](XMLEle * root)
+                    {
+                        if (auto aperture = snoopedValue(root, "TELESCOPE_APERTURE"))
+                            snoopedAperture = atof(aperture);
+                        if (auto focalLength = snoopedValue(root, "TELESCOPE_FOCAL_LENGTH"))
+                            snoopedFocalLength = atof(focalLength);
+                    }
+                },
+                {
+                    "GEOGRAPHIC_COORD", [this](XMLEle * root)
+                    {
+                        if (auto longitude = snoopedValue(root, "LONG"))
+                        {
+                            Longitude = atof(longitude);
+                            if (Longitude > 180)
+                                Longitude -= 360;
+                        }
+                        if (auto latitude = snoopedValue(root, "LAT"))
+                            Latitude = atof(latitude);
+                    }
+                },
+            };
+            break;
 
-            if (!strcmp(name, "ANGLE"))
+        case ACTIVE_ROTATOR:
+            handlers =
             {
-                RotatorAngle = atof(pcdataXMLEle(ep));
-                break;
-            }
-        }
-    }
+                {
+                    "ABS_ROTATOR_ANGLE", [this](XMLEle * root)
+                    {
+                        if (auto angle = snoopedValue(root, "ANGLE"))
+                            RotatorAngle = atof(angle);
+                    }
+                },
+            };
+            break;
 
-    // JJ ed 2019-12-10
-    else if (!strcmp(propName, "ABS_FOCUS_POSITION") && deviceName == ActiveDeviceTP[ACTIVE_FOCUSER].getText())
-    {
-        for (ep = nextXMLEle(root, 1); ep != nullptr; ep = nextXMLEle(root, 0))
-        {
-            const char * name = findXMLAttValu(ep, "name");
+        // JJ ed 2019-12-10
+        case ACTIVE_FOCUSER:
+            handlers =
+            {
+                {
+                    "ABS_FOCUS_POSITION", [this](XMLEle * root)
+                    {
+                        if (auto position = snoopedValue(root, "FOCUS_ABSOLUTE_POSITION"))
+                            FocuserPos = atol(position);
+                    }
+                },
+                {
+                    "FOCUS_TEMPERATURE", [this](XMLEle * root)
+                    {
+                        if (auto temperature = snoopedValue(root, "TEMPERATURE"))
+                            FocuserTemp = atof(temperature);
+                    }
+                },
+            };
+            break;
 
-            if (!strcmp(name, "FOCUS_ABSOLUTE_POSITION"))
+        case ACTIVE_FILTER:
+            handlers =
             {
-                FocuserPos = atol(pcdataXMLEle(ep));
-                break;
-            }
-        }
-    }
-    else if (!strcmp(propName, "FOCUS_TEMPERATURE") && deviceName == ActiveDeviceTP[ACTIVE_FOCUSER].getText())
-    {
-        for (ep = nextXMLEle(root, 1); ep != nullptr; ep = nextXMLEle(root, 0))
-        {
-            const char * name = findXMLAttValu(ep, "name");
+                {
+                    "FILTER_SLOT", [this](XMLEle * root)
+                    {
+                        auto newFilterSlot = -1;
+                        for (XMLEle * ep = nextXMLEle(root, 1); ep != nullptr; ep = nextXMLEle(root, 0))
+                            newFilterSlot = atoi(pcdataXMLEle(ep));
+                        if (newFilterSlot != CurrentFilterSlot)
+                        {
+                            CurrentFilterSlot = newFilterSlot;
+                            LOGF_DEBUG("SNOOP: FILTER_SLOT is %d", CurrentFilterSlot);
+                        }
+                    }
+                },
+                {
+                    "FILTER_NAME", [this](XMLEle * root)
+                    {
+                        auto newFilterNames = std::vector<std::string>();
+                        for (XMLEle * ep = nextXMLEle(root, 1); ep != nullptr; ep = nextXMLEle(root, 0))
+                            newFilterNames.push_back(pcdataXMLEle(ep));
+                        if (newFilterNames != FilterNames)
+                        {
+                            FilterNames = newFilterNames;
+                            LOGF_DEBUG("SNOOP: FILTER_NAME -> %s", join(FilterNames, ", ").c_str());
+                        }
+                    }
+                },
+            };
+            break;
 
-            if (!strcmp(name, "TEMPERATURE"))
+        case ACTIVE_SKYQUALITY:
+            handlers =
             {
-                FocuserTemp = atof(pcdataXMLEle(ep));
-                break;
-            }
-        }
+                {
+                    "SKY_QUALITY", [this](XMLEle * root)
+                    {
+                        if (auto brightness = snoopedValue(root, "SKY_BRIGHTNESS"))
+                            MPSAS = atof(brightness);
+                    }
+                },
+            };
+            break;
     }
-    //
 
-    else if (!strcmp(propName, "GEOGRAPHIC_COORD") && deviceName == ActiveDeviceTP[ACTIVE_TELESCOPE].getText())
-    {
-        for (ep = nextXMLEle(root, 1); ep != nullptr; ep = nextXMLEle(root, 0))
-        {
-            const char * name = findXMLAttValu(ep, "name");
+    if (previous != nullptr && previous[0] != '\0')
+        for (auto &it : handlers)
+            unsnoopProperty(previous, it.first);
 
-            if (!strcmp(name, "LONG"))
-            {
-                Longitude = atof(pcdataXMLEle(ep));
-                if (Longitude > 180)
-                    Longitude -= 360;
-            }
-            else if (!strcmp(name, "LAT"))
-            {
-                Latitude = atof(pcdataXMLEle(ep));
-            }
-        }
-    }
+    auto device = ActiveDeviceTP[index].getText();
+    if (device == nullptr || device[0] == '\0')
+        return;
 
-    return DefaultDevice::ISSnoopDevice(root);
+    for (auto &it : handlers)
+        snoopProperty(device, it.first, it.second);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -961,13 +967,10 @@ bool CCD::ISNewText(const char * dev, const char * name, char * texts[], char *
             {
                 EqNP.setDeviceName(newMount);
                 J2000EqNP.setDeviceName(newMount);
+                snoopActiveDevice(ACTIVE_TELESCOPE, prevValues[ACTIVE_TELESCOPE].c_str());
                 if (strlen(newMount) > 0)
                 {
                     LOGF_DEBUG("Snopping on Mount %s", newMount);
-                    IDSnoopDevice(newMount, "EQUATORIAL_EOD_COORD");
-                    IDSnoopDevice(newMount, "EQUATORIAL_COORD");
-                    IDSnoopDevice(newMount, "TELESCOPE_INFO");
-                    IDSnoopDevice(newMount, "GEOGRAPHIC_COORD");
                 }
                 else if (!std::isnan(RA))
                 {
@@ -980,10 +983,10 @@ bool CCD::ISNewText(const char * dev, const char * name, char * texts[], char *
             auto newRotator = ActiveDeviceTP[ACTIVE_ROTATOR].getText();
             if (newRotator != prevValues[ACTIVE_ROTATOR])
             {
+                snoopActiveDevice(ACTIVE_ROTATOR, prevValues[ACTIVE_ROTATOR].c_str());
                 if (strlen(newRotator) > 0)
                 {
                     LOGF_DEBUG("Snopping on Rotator %s", newRotator);
-                    IDSnoopDevice(newRotator, "ABS_ROTATOR_ANGLE");
                 }
                 else if (!std::isnan(MPSAS))
                 {
@@ -996,11 +999,10 @@ bool CCD::ISNewText(const char * dev, const char * name, char * texts[], char *
             auto newFocuser = ActiveDeviceTP[ACTIVE_FOCUSER].getText();
             if (newFocuser != prevValues[ACTIVE_FOCUSER])
             {
+                snoopActiveDevice(ACTIVE_FOCUSER, prevValues[ACTIVE_FOCUSER].c_str());
                 if (strlen(newFocuser) > 0)
                 {
                     LOGF_DEBUG("Snopping on Focuser %s", newFocuser);
-                    IDSnoopDevice(newFocuser, "ABS_FOCUS_POSITION");
-                    IDSnoopDevice(newFocuser, "FOCUS_TEMPERATURE");
                 }
                 else if (!std::isnan(FocuserTemp))
                 {
@@ -1014,11 +1016,10 @@ bool CCD::ISNewText(const char * dev, const char * name, char * texts[], char *
             auto newFilterWheel = ActiveDeviceTP[ACTIVE_FILTER].getText();
             if (newFilterWheel != prevValues[ACTIVE_FILTER])
             {
+                snoopActiveDevice(ACTIVE_FILTER, prevValues[ACTIVE_FILTER].c_str());
                 if (strlen(newFilterWheel) > 0)
                 {
                     LOGF_DEBUG("Snopping on Filter Wheel %s", newFilterWheel);
-                    IDSnoopDevice(newFilterWheel, "FILTER_SLOT");
-                    IDSnoopDevice(newFilterWheel, "FILTER_NAME");
                 }
                 else if (CurrentFilterSlot != -1)
                 {
@@ -1029,8 +1030,8 @@ bool CCD::ISNewText(const char * dev, const char * name, char * texts[], char *
 
             // Sky Quality
             auto newSkyQuality = ActiveDeviceTP[ACTIVE_SKYQUALITY].getText();
-            if (newSkyQuality != prevValues[ACTIVE_SKYQUALITY] && strlen(newSkyQuality) > 0)
-                IDSnoopDevice(newSkyQuality, "SKY_QUALITY");
+            if (newSkyQuality != prevValues[ACTIVE_SKYQUALITY])
+                snoopActiveDevice(ACTIVE_SKYQUALITY, prevValues[ACTIVE_SKYQUALITY].c_str());
 
             activeDevicesUpdated();
             saveConfig(ActiveDeviceTP);
@@ -1589,6 +1590,10 @@ bool CCD::ISNewSwitch(const char * dev, const char * name, ISState * states, cha
 
             UploadSP.apply();
 
+            if (HasDSP())
+                DSP->setUploadMode(UploadSP[UPLOAD_CLIENT].getState() == ISS_ON || UploadSP[UPLOAD_BOTH].getState() == ISS_ON,
+                                   UploadSP[UPLOAD_LOCAL].getState() == ISS_ON || UploadSP[UPLOAD_BOTH].getState() == ISS_ON);
+
             return true;
         }
 
@@ -1629,12 +1634,15 @@ bool CCD::ISNewSwitch(const char * dev, const char * name, ISState * states, cha
                 WebSocketSettingsNP[WS_SETTINGS_PORT].setValue(wsServer.generatePort());
                 WebSocketSettingsNP.setState(IPS_OK);
                 defineProperty(WebSocketSettingsNP);
+                m_WebSocketClientsTimer.start();
             }
             else if (wsServer.is_running())
             {
                 wsServer.stop();
                 wsThread.join();
                 deleteProperty(WebSocketSettingsNP);
+                m_WebSocketClientsTimer.stop();
+                updateWebSocketClients();
             }
 
             WebSocketSP.apply();
@@ -2039,7 +2047,10 @@ bool CCD::UpdateCCDBin(int hor, int ver)
 
     // DSP
     if (HasDSP())
-        DSP->setSizes(2, new int[2] { PrimaryCCD.getSubW() / hor, PrimaryCCD.getSubH() / ver });
+    {
+        int sizes[2] = { PrimaryCCD.getSubW() / hor, PrimaryCCD.getSubH() / ver };
+        DSP->setSizes(2, sizes);
+    }
 
     return true;
 }
@@ -2379,7 +2390,10 @@ bool CCD::ExposureComplete(CCDChip * targetChip)
     setCurrentPollingPeriod(getPollingPeriod());
 
     // Run async
-    std::thread(&CCD::ExposureCompletePrivate, this, targetChip).detach();
+    m_ExposureTasks.start([this, targetChip](const std::atomic_bool &)
+    {
+        ExposureCompletePrivate(targetChip);
+    }, INDI::ThreadPool::PRIORITY_HIGH);
 
     return true;
 }
@@ -2395,13 +2409,11 @@ bool CCD::ExposureCompletePrivate(CCDChip * targetChip)
     exposureDuration = targetChip->getExposureDuration();
     strncpy(exposureStartTime, targetChip->getExposureStartTime(), MAXINDINAME);
 
+    // DSP plugins run on their own worker, the image upload below does not wait for them
     if(HasDSP())
     {
-        uint8_t* buf = static_cast<uint8_t*>(malloc(targetChip->getFrameBufferSize()));
-        memcpy(buf, targetChip->getFrameBuffer(), targetChip->getFrameBufferSize());
-        DSP->processBLOB(buf, 2, new int[2] { targetChip->getXRes() / targetChip->getBinX(), targetChip->getYRes() / targetChip->getBinY() },
-                         targetChip->getBPP());
-        free(buf);
+        int sizes[2] = { targetChip->getXRes() / targetChip->getBinX(), targetChip->getYRes() / targetChip->getBinY() };
+        DSP->processBLOBAsync(targetChip->getFrameBuffer(), targetChip->getFrameBufferSize(), 2, sizes, targetChip->getBPP());
     }
 
     if (processFastExposure(targetChip) == false)
@@ -2420,8 +2432,6 @@ bool CCD::ExposureCompletePrivate(CCDChip * targetChip)
         {
             targetChip->setImageExtension("fits");
 
-            int img_type  = 0;
-            int byte_type = 0;
             int status    = 0;
             long naxis    = targetChip->getNAxis();
             long naxes[3];
@@ -2434,18 +2444,8 @@ bool CCD::ExposureCompletePrivate(CCDChip * targetChip)
             switch (targetChip->getBPP())
             {
                 case 8:
-                    byte_type = TBYTE;
-                    img_type  = BYTE_IMG;
-                    break;
-
                 case 16:
-                    byte_type = TUSHORT;
-                    img_type  = USHORT_IMG;
-                    break;
-
                 case 32:
-                    byte_type = TULONG;
-                    img_type  = ULONG_IMG;
                     break;
 
                 default:
@@ -2465,30 +2465,6 @@ bool CCD::ExposureCompletePrivate(CCDChip * targetChip)
 
             std::unique_lock<std::mutex> guard(ccdBufferLock);
 
-            // 8640 = 2880 * 3 which is sufficient for most cases.
-            uint32_t size = 8640 + nelements * (targetChip->getBPP() / 8);
-            //  Initialize FITS file.
-            if (targetChip->openFITSFile(size, status) == false)
-            {
-                fits_report_error(stderr, status); /* print out any error messages */
-                fits_get_errstatus(status, error_status);
-                LOGF_ERROR("FITS Error: %s", error_status);
-                return false;
-            }
-
-            auto fptr = *targetChip->fitsFilePointer();
-
-            fits_create_img(fptr, img_type, naxis, naxes, &status);
-
-            if (status)
-            {
-                fits_report_error(stderr, status); /* print out any error messages */
-                fits_get_errstatus(status, error_status);
-                LOGF_ERROR("FITS Error: %s", error_status);
-                targetChip->closeFITSFile();
-                return false;
-            }
-
             std::vector<FITSRecord> fitsKeywords;
 
             addFITSKeywords(targetChip, fitsKeywords);
@@ -2497,46 +2473,50 @@ bool CCD::ExposureCompletePrivate(CCDChip * targetChip)
             for (auto &record : m_CustomFITSKeywords)
                 fitsKeywords.push_back(record.second);
 
-            for (auto &keyword : fitsKeywords)
+            // Plain images are serialized straight into the shared BLOB, CFITSIO handles what the writer does not
+            FITSWriter writer(targetChip->getBPP(), naxis, naxes);
+            if (writer.setRecords(fitsKeywords))
             {
-                int key_status = 0;
-                switch(keyword.type())
+                if (targetChip->openFITSBuffer(writer.size()) == false)
                 {
-                    case INDI::FITSRecord::VOID:
-                        break;
-                    case INDI::FITSRecord::COMMENT:
-                        fits_write_comment(fptr, keyword.comment().c_str(), &key_status);
-                        break;
-                    case INDI::FITSRecord::STRING:
-                        fits_update_key_str(fptr, keyword.key().c_str(), keyword.valueString().c_str(), keyword.comment().c_str(), &key_status);
-                        break;
-                    case INDI::FITSRecord::LONGLONG:
-                        fits_update_key_lng(fptr, keyword.key().c_str(), keyword.valueInt(), keyword.comment().c_str(), &key_status);
-                        break;
-                    case INDI::FITSRecord::DOUBLE:
-                        fits_update_key_dbl(fptr, keyword.key().c_str(), keyword.valueDouble(), keyword.decimal(), keyword.comment().c_str(),
-                                            &key_status);
-                        break;
+                    LOG_ERROR("Failed to allocate memory for FITS file.");
+                    return false;
                 }
-                if (key_status)
+                writer.write(*targetChip->fitsMemoryBlockPointer(), targetChip->getFrameBuffer());
+            }
+            else
+            {
+                // 8640 = 2880 * 3 which is sufficient for most cases.
+                uint32_t size = 8640 + nelements * (targetChip->getBPP() / 8);
+                //  Initialize FITS file.
+                if (targetChip->openFITSFile(size, status) == false)
+                {
+                    fits_report_error(stderr, status); /* print out any error messages */
+                    fits_get_errstatus(status, error_status);
+                    LOGF_ERROR("FITS Error: %s", error_status);
+                    return false;
+                }
+
+                auto fptr = *targetChip->fitsFilePointer();
+
+                status = FITSWriter::writeWithCFITSIO(fptr, targetChip->getBPP(), naxis, naxes, fitsKeywords,
+                                                      targetChip->getFrameBuffer(), nelements,
+                                                      [&](const FITSRecord & keyword, int key_status)
                 {
                     fits_get_errstatus(key_status, error_status);
                     LOGF_ERROR("FITS key %s Error: %s", keyword.key().c_str(), error_status);
+                });
+                targetChip->finishFITSFile(status);
+                if (status)
+                {
+                    fits_report_error(stderr, status); /* print out any error messages */
+                    fits_get_errstatus(status, error_status);
+                    LOGF_ERROR("FITS Error: %s", error_status);
+                    targetChip->closeFITSFile();
+                    return false;
                 }
             }
 
-            fits_write_img(fptr, byte_type, 1, nelements, targetChip->getFrameBuffer(), &status);
-            targetChip->finishFITSFile(status);
-            if (status)
-            {
-                fits_report_error(stderr, status); /* print out any error messages */
-                fits_get_errstatus(status, error_status);
-                LOGF_ERROR("FITS Error: %s", error_status);
-                targetChip->closeFITSFile();
-                return false;
-            }
-
-
             bool rc = uploadFile(targetChip, *(targetChip->fitsMemoryBlockPointer()), *(targetChip->fitsMemorySizePointer()), sendImage,
                                  saveImage);
 
@@ -2550,97 +2530,56 @@ bool CCD::ExposureCompletePrivate(CCDChip * targetChip)
                 return false;
             }
         }
-#ifdef HAVE_XISF
         else if (EncodeFormatSP[FORMAT_XISF].getState() == ISS_ON)
         {
             std::vector<FITSRecord> fitsKeywords;
             addFITSKeywords(targetChip, fitsKeywords);
             targetChip->setImageExtension("xisf");
 
-            try
-            {
-                AutoCNumeric locale;
-                LibXISF::Image image;
-                LibXISF::XISFWriter xisfWriter;
-
-                for (auto &keyword : fitsKeywords)
-                {
-                    image.addFITSKeyword({keyword.key().c_str(), keyword.valueString().c_str(), keyword.comment().c_str()});
-                    image.addFITSKeywordAsProperty(keyword.key().c_str(), keyword.valueString());
-                }
+            long naxes[3] = { targetChip->getSubW() / targetChip->getBinX(), targetChip->getSubH() / targetChip->getBinY(), 3 };
+            XISFWriter writer(targetChip->getBPP(), targetChip->getNAxis(), naxes);
+            writer.setRecords(fitsKeywords);
 
-                image.setGeometry(targetChip->getSubW() / targetChip->getBinX(),
-                                  targetChip->getSubH() / targetChip->getBinY(),
-                                  targetChip->getNAxis() == 2 ? 1 : 3);
-                switch(targetChip->getBPP())
-                {
-                    case 8:
-                        image.setSampleFormat(LibXISF::Image::UInt8);
-                        break;
-                    case 16:
-                        image.setSampleFormat(LibXISF::Image::UInt16);
-                        break;
-                    case 32:
-                        image.setSampleFormat(LibXISF::Image::UInt32);
-                        break;
-                    default:
-                        LOGF_ERROR("Unsupported bits per pixel value %d", targetChip->getBPP());
-                        return false;
-                }
-
-                switch(targetChip->getFrameType())
-                {
-                    case CCDChip::LIGHT_FRAME:
-                        image.setImageType(LibXISF::Image::Light);
-                        break;
-                    case CCDChip::BIAS_FRAME:
-                        image.setImageType(LibXISF::Image::Bias);
-                        break;
-                    case CCDChip::DARK_FRAME:
-                        image.setImageType(LibXISF::Image::Dark);
-                        break;
-                    case CCDChip::FLAT_FRAME:
-                        image.setImageType(LibXISF::Image::Flat);
-                        break;
-                }
-
-                if (targetChip->SendCompressed)
-                {
-                    if(LibXISF::DataBlock::CompressionCodecSupported(LibXISF::DataBlock::ZSTD))
-                        image.setCompression(LibXISF::DataBlock::ZSTD);
-                    else
-                        image.setCompression(LibXISF::DataBlock::LZ4);
-                    image.setByteshuffling(targetChip->getBPP() / 8);
-                }
-
-                if (HasBayer())
-                    image.setColorFilterArray({2, 2, BayerTP[2].getText()});
+            switch(targetChip->getFrameType())
+            {
+                case CCDChip::LIGHT_FRAME:
+                    writer.setImageType("Light");
+                    break;
+                case CCDChip::BIAS_FRAME:
+                    writer.setImageType("Bias");
+                    break;
+                case CCDChip::DARK_FRAME:
+                    writer.setImageType("Dark");
+                    break;
+                case CCDChip::FLAT_FRAME:
+                    writer.setImageType("Flat");
+                    break;
+            }
 
-                if (targetChip->getNAxis() == 3)
-                {
-                    image.setColorSpace(LibXISF::Image::RGB);
-                }
+            writer.setCompression(targetChip->SendCompressed);
 
-                std::unique_lock<std::mutex> guard(ccdBufferLock);
-                std::memcpy(image.imageData(), targetChip->getFrameBuffer(), image.imageDataSize());
-                xisfWriter.writeImage(image);
+            if (HasBayer())
+                writer.setColorFilterArray(BayerTP[2].getText(), 2, 2);
 
-                LibXISF::ByteArray xisfFile;
-                xisfWriter.save(xisfFile);
-                bool rc = uploadFile(targetChip, xisfFile.data(), xisfFile.size(), sendImage, saveImage);
-                if (rc == false)
-                {
-                    targetChip->setExposureFailed();
-                    return false;
-                }
+            // Written straight from the frame buffer, the file is the only other copy of the image
+            std::unique_lock<std::mutex> guard(ccdBufferLock);
+            void *xisfFile = nullptr;
+            size_t xisfSize = 0;
+            std::string error;
+            if (writer.writeToBlob(targetChip->getFrameBuffer(), xisfFile, xisfSize, error) == false)
+            {
+                LOGF_ERROR("XISF Error: %s", error.c_str());
+                return false;
             }
-            catch (LibXISF::Error &error)
+
+            bool rc = uploadFile(targetChip, xisfFile, xisfSize, sendImage, saveImage);
+            IDSharedBlobFree(xisfFile);
+            if (rc == false)
             {
-                LOGF_ERROR("XISF Error: %s", error.what());
+                targetChip->setExposureFailed();
                 return false;
             }
         }
-#endif
         else
         {
             // If image extension was set to fits (default), change if bin if not already set to another format by the driver.
@@ -2814,15 +2753,9 @@ bool CCD::uploadFile(CCDChip * targetChip, const void * fitsData, size_t totalBy
 #ifdef HAVE_WEBSOCKET
         if (HasWebSocket() && WebSocketSP[WEBSOCKET_ENABLED].getState() == ISS_ON)
         {
-            auto start = std::chrono::high_resolution_clock::now();
-
-            // Send format/size/..etc first later
-            wsServer.send_text(std::string(targetChip->FitsBP[0].getFormat()));
-            wsServer.send_binary(targetChip->FitsBP[0].getBlob(), targetChip->FitsBP[0].getBlobLen());
-
-            auto end = std::chrono::high_resolution_clock::now();
-            std::chrono::duration<double> diff = end - start;
-            LOGF_DEBUG("Websocket transfer took %g seconds", diff.count());
+            // Queued for each client, the transfer happens on the websocket thread
+            wsServer.send_frame(targetChip->FitsBP[0].getFormat(), targetChip->FitsBP[0].getBlob(),
+                                targetChip->FitsBP[0].getBlobLen(), false);
         }
         else
 #endif
@@ -3217,6 +3150,39 @@ void CCD::wsThreadEntry()
 {
     wsServer.run();
 }
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void CCD::updateWebSocketClients()
+{
+    auto clients = wsServer.statistics();
+    if (WebSocketSP[WEBSOCKET_ENABLED].getState() != ISS_ON || !isConnected())
+        clients.clear();
+
+    bool redefine = clients.size() != WebSocketClientsTP.size();
+    if (redefine)
+    {
+        deleteProperty(WebSocketClientsTP);
+        WebSocketClientsTP.resize(clients.size());
+    }
+
+    for (size_t i = 0; i < clients.size(); i++)
+    {
+        const auto &client = clients[i];
+        char name[MAXINDINAME], text[MAXINDILABEL];
+        snprintf(name, sizeof(name), "CLIENT_%zu", i + 1);
+        snprintf(text, sizeof(text), "%.2f MB/s, %llu frames, %llu dropped, %zu queued", client.throughput / 1e6,
+                 static_cast<unsigned long long>(client.frames), static_cast<unsigned long long>(client.dropped), client.queued);
+        WebSocketClientsTP[i].fill(name, client.endpoint.c_str(), text);
+    }
+    WebSocketClientsTP.setState(IPS_OK);
+
+    if (!redefine)
+        WebSocketClientsTP.apply();
+    else if (!clients.empty())
+        defineProperty(WebSocketClientsTP);
+}
 #endif
 
 /////////////////////////////////////////////////////////////////////////////////////////
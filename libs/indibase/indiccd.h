@@ -33,6 +33,7 @@
 #include "indipropertyswitch.h"
 #include "inditimer.h"
 #include "indielapsedtimer.h"
+#include "indithreadpool.h"
 #include "fitskeyword.h"
 #include "dsp/manager.h"
 #include "stream/streammanager.h"
@@ -748,6 +749,9 @@ class CCD : public DefaultDevice, GuiderInterface
             WS_SETTINGS_PORT,
         };
 
+        // Websocket clients: throughput, frames and drops of each connection
+        INDI::PropertyText WebSocketClientsTP {0};
+
         // WCS
         INDI::PropertySwitch WorldCoordSP{2};
         enum
@@ -791,12 +795,19 @@ class CCD : public DefaultDevice, GuiderInterface
         void getMinMax(double * min, double * max, CCDChip * targetChip);
         int getFileIndex(const std::string & dir, const std::string & prefix, const std::string & ext);
         bool ExposureCompletePrivate(CCDChip * targetChip);
+        // Uploads of completed exposures, on the shared thread pool
+        INDI::TaskGroup m_ExposureTasks;
+        // Pass the properties of interest of an ActiveDeviceTP device to their handlers, instead of previous
+        void snoopActiveDevice(int index, const char * previous);
 
         // Threading for Websocket
 #ifdef HAVE_WEBSOCKET
         std::thread wsThread;
         void wsThreadEntry();
+        // Refresh WebSocketClientsTP, on the main thread
+        void updateWebSocketClients();
         INDIWSServer wsServer;
+        INDI::Timer m_WebSocketClientsTimer;
 #endif
 
         /////////////////////////////////////////////////////////////////////////////
@@ -59,6 +59,19 @@ bool CCDChip::openFITSFile(uint32_t size, int &status)
     return (status == 0);
 }
 
+bool CCDChip::openFITSBuffer(size_t size)
+{
+    m_FITSMemoryBlock = IDSharedBlobAlloc(size);
+    if (m_FITSMemoryBlock == nullptr)
+    {
+        IDLog("Failed to allocate memory for FITS file.");
+        return false;
+    }
+
+    m_FITSMemorySize = size;
+    return true;
+}
+
 bool CCDChip::finishFITSFile(int &status)
 {
     fits_flush_file(m_FITSFilePointer, &status);
@@ -63,6 +63,13 @@ class CCDChip
         bool openFITSFile(uint32_t size, int &status);
 
 
+        /**
+         * @brief openFITSBuffer Allocate a Shared BLOB of size bytes to write a FITS file into without CFITSIO.
+         * closeFITSFile() releases it.
+         * @return True if successful, false otherwise.
+         */
+        bool openFITSBuffer(size_t size);
+
         /**
          * @brief Finish any pending write to fits file.
          * @return True if successful, false otherwise.
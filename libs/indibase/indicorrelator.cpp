@@ -48,6 +48,7 @@ Correlator::Correlator()
 
 Correlator::~Correlator()
 {
+    stopAcquisition();
 }
 
 bool Correlator::initProperties()
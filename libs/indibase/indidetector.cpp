@@ -49,6 +49,7 @@ Detector::Detector()
 
 Detector::~Detector()
 {
+    stopAcquisition();
 }
 
 bool Detector::initProperties()
@@ -29,6 +29,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110 - 1301  USA
 #include "base64.h"
 #include "indicom.h"
 #include "indidevapi.h"
+#include "indiutility.h"
 #include "locale_compat.h"
 
 #include <errno.h>
@@ -137,6 +138,195 @@ void IDDelete(const char *dev, const char *name, const char *fmt, ...)
     va_end(ap);
 }
 
+/* snoop registry: the device/property pairs snooped with IDSnoopProperty(), hashed,
+ *   each with the handlers its messages go to before ISSnoopDevice(). a base class
+ *   registering handlers so skips searching its own properties, while drivers that
+ *   override ISSnoopDevice() still see every message.
+ * handlers may snoop or unsnoop while they run, so removed handlers and the
+ *   entries left without any are only freed once no dispatch is running.
+ */
+typedef struct
+{
+    IDSnoopHandler *fn; /* NULL once removed, until snoop_purge() */
+    void *context;
+} SnoopHandler;
+
+typedef struct SnoopEntry
+{
+    struct SnoopEntry *next;        /* next in bucket */
+    unsigned int hash;
+    char devName[MAXINDIDEVICE];
+    char propName[MAXINDINAME];     /* empty for the whole device */
+    SnoopHandler *handlers;
+    int nHandlers;
+} SnoopEntry;
+
+static pthread_once_t snoop_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t snoop_mutex; /* recursive, handlers may snoop more */
+
+static SnoopEntry **snoopBuckets = NULL;
+static unsigned int nSnoopBuckets = 0; /* power of 2 */
+static unsigned int nSnoopEntries = 0;
+static int snoopDispatching       = 0; /* nested snoop_dispatch() calls */
+static int snoopRemoved           = 0; /* handlers removed since snoop_purge() */
+
+static void snoop_init()
+{
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&snoop_mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+/* FNV-1a of device and property, NULL property same as empty */
+static unsigned int snoop_hash(const char *devName, const char *propName)
+{
+    unsigned int h = 2166136261u;
+
+    for (const char *c = devName; *c; c++)
+        h = (h ^ (unsigned char)*c) * 16777619u;
+    h = (h ^ 0xff) * 16777619u;
+    for (const char *c = propName ? propName : ""; *c; c++)
+        h = (h ^ (unsigned char)*c) * 16777619u;
+
+    return h;
+}
+
+/* Return entry of device/property if registered, NULL otherwise. call with snoop_mutex */
+static SnoopEntry *snoop_find(const char *devName, const char *propName)
+{
+    unsigned int h;
+
+    if (nSnoopEntries == 0)
+        return NULL;
+
+    h = snoop_hash(devName, propName);
+    for (SnoopEntry *e = snoopBuckets[h & (nSnoopBuckets - 1)]; e; e = e->next)
+        if (e->hash == h && !strcmp(e->propName, propName ? propName : "") && !strcmp(e->devName, devName))
+            return e;
+
+    return NULL;
+}
+
+/* Return entry of device/property, added if new. call with snoop_mutex */
+static SnoopEntry *snoop_get(const char *devName, const char *propName)
+{
+    SnoopEntry *e = snoop_find(devName, propName);
+    if (e)
+        return e;
+
+    /* keep about one entry per bucket */
+    if (nSnoopEntries >= nSnoopBuckets)
+    {
+        unsigned int n = nSnoopBuckets ? 2 * nSnoopBuckets : 16;
+        SnoopEntry **buckets;
+
+        assert_mem(buckets = (SnoopEntry **)calloc(n, sizeof *buckets));
+        for (unsigned int i = 0; i < nSnoopBuckets; i++)
+        {
+            while (snoopBuckets[i])
+            {
+                SnoopEntry *next = snoopBuckets[i]->next;
+                snoopBuckets[i]->next = buckets[snoopBuckets[i]->hash & (n - 1)];
+                buckets[snoopBuckets[i]->hash & (n - 1)] = snoopBuckets[i];
+                snoopBuckets[i] = next;
+            }
+        }
+        free(snoopBuckets);
+        snoopBuckets  = buckets;
+        nSnoopBuckets = n;
+    }
+
+    assert_mem(e = (SnoopEntry *)calloc(1, sizeof *e));
+    indi_strlcpy(e->devName, devName, sizeof(e->devName));
+    indi_strlcpy(e->propName, propName ? propName : "", sizeof(e->propName));
+    e->hash = snoop_hash(devName, propName);
+    e->next = snoopBuckets[e->hash & (nSnoopBuckets - 1)];
+    snoopBuckets[e->hash & (nSnoopBuckets - 1)] = e;
+    nSnoopEntries++;
+
+    return e;
+}
+
+/* drop the removed handlers of the entry *ep links to, free it and unlink it
+ *   if it has no handlers left.
+ * return 1 if freed, else 0. call with snoop_mutex, not while dispatching.
+ */
+static int snoop_compact(SnoopEntry **ep)
+{
+    SnoopEntry *e = *ep;
+    int n = 0;
+
+    for (int i = 0; i < e->nHandlers; i++)
+        if (e->handlers[i].fn)
+            e->handlers[n++] = e->handlers[i];
+    e->nHandlers = n;
+
+    if (n > 0)
+        return 0;
+
+    *ep = e->next;
+    free(e->handlers);
+    free(e);
+    nSnoopEntries--;
+    return 1;
+}
+
+/* compact every entry once the dispatch that removed handlers is over. call with snoop_mutex */
+static void snoop_purge()
+{
+    for (unsigned int i = 0; i < nSnoopBuckets; i++)
+        for (SnoopEntry **ep = &snoopBuckets[i]; *ep;)
+            if (!snoop_compact(ep))
+                ep = &(*ep)->next;
+    snoopRemoved = 0;
+}
+
+/* pass root to the handlers of its device/property and of its whole device */
+static void snoop_dispatch(XMLEle *root)
+{
+    const char *devName  = findXMLAttValu(root, "device");
+    const char *propName = findXMLAttValu(root, "name");
+    SnoopEntry *entries[2];
+
+    pthread_once(&snoop_once, snoop_init);
+    pthread_mutex_lock(&snoop_mutex);
+
+    snoopDispatching++;
+    entries[0] = propName[0] ? snoop_find(devName, propName) : NULL;
+    entries[1] = snoop_find(devName, NULL);
+    for (int i = 0; i < 2; i++)
+    {
+        if (entries[i] == NULL)
+            continue;
+
+        /* handlers may register more, do not keep pointers to the array */
+        for (int j = 0; j < entries[i]->nHandlers; j++)
+        {
+            SnoopHandler h = entries[i]->handlers[j];
+            if (h.fn)
+                h.fn(root, h.context);
+        }
+    }
+    if (--snoopDispatching == 0 && snoopRemoved)
+        snoop_purge();
+
+    pthread_mutex_unlock(&snoop_mutex);
+}
+
+/* ask indiserver for the given device/property */
+static void snoop_request(const char *snooped_device, const char *snooped_property)
+{
+    driverio io;
+    driverio_init(&io);
+
+    userio_xmlv1(&io.userio, io.user);
+    IUUserIOGetProperties(&io.userio, io.user, snooped_device, snooped_property);
+
+    driverio_finish(&io);
+}
+
 /* tell indiserver we want to snoop on the given device/property.
  * name ignored if NULL or empty.
  */
@@ -144,15 +334,79 @@ void IDSnoopDevice(const char *snooped_device, const char *snooped_property)
 {
     // Ignore empty snooped device
     if (snooped_device && snooped_device[0])
+        snoop_request(snooped_device, snooped_property);
+}
+
+/* tell indiserver we want to snoop on the given device/property, its messages
+ *   go to handler, then to ISSnoopDevice() as usual.
+ * name ignored if NULL or empty.
+ */
+void IDSnoopProperty(const char *snooped_device, const char *snooped_property, IDSnoopHandler *handler,
+                     void *context)
+{
+    if (snooped_device && snooped_device[0] && handler)
     {
-        driverio io;
-        driverio_init(&io);
+        SnoopEntry *e;
+        int i, slot = -1;
 
-        userio_xmlv1(&io.userio, io.user);
-        IUUserIOGetProperties(&io.userio, io.user, snooped_device, snooped_property);
+        pthread_once(&snoop_once, snoop_init);
+        pthread_mutex_lock(&snoop_mutex);
 
-        driverio_finish(&io);
+        e = snoop_get(snooped_device, snooped_property);
+        for (i = 0; i < e->nHandlers; i++)
+        {
+            if (e->handlers[i].fn == handler && e->handlers[i].context == context)
+                break;
+            if (e->handlers[i].fn == NULL && slot < 0)
+                slot = i;
+        }
+        if (i == e->nHandlers)
+        {
+            if (slot < 0)
+            {
+                assert_mem(e->handlers = (SnoopHandler *)realloc(e->handlers, (e->nHandlers + 1) * sizeof *e->handlers));
+                slot = e->nHandlers++;
+            }
+            e->handlers[slot].fn      = handler;
+            e->handlers[slot].context = context;
+        }
+
+        pthread_mutex_unlock(&snoop_mutex);
+
+        snoop_request(snooped_device, snooped_property);
+    }
+}
+
+/* stop passing the messages of the given device/property to handler.
+ * indiserver keeps sending them, they still go to ISSnoopDevice().
+ * safe from within a handler, the slot is freed once the dispatch is over.
+ */
+void IDUnsnoopProperty(const char *snooped_device, const char *snooped_property, IDSnoopHandler *handler,
+                       void *context)
+{
+    SnoopEntry *e;
+
+    if (!snooped_device || !snooped_device[0])
+        return;
+
+    pthread_once(&snoop_once, snoop_init);
+    pthread_mutex_lock(&snoop_mutex);
+
+    e = snoop_find(snooped_device, snooped_property);
+    for (int i = 0; e && i < e->nHandlers; i++)
+        if (e->handlers[i].fn == handler && e->handlers[i].context == context)
+            e->handlers[i].fn = NULL;
+    if (e && snoopDispatching)
+        snoopRemoved = 1;
+    else if (e)
+    {
+        SnoopEntry **ep = &snoopBuckets[e->hash & (nSnoopBuckets - 1)];
+        while (*ep != e)
+            ep = &(*ep)->next;
+        snoop_compact(ep);
     }
+
+    pthread_mutex_unlock(&snoop_mutex);
 }
 
 /* tell indiserver whether we want BLOBs from the given snooped device.
@@ -175,7 +429,7 @@ void IDSnoopBLOBs(const char *snooped_device, const char *snooped_property, BLOB
 /* crack the given INDI XML element and call driver's IS* entry points as they
  *   are recognized.
  * return 0 if ok else -1 with reason in msg[].
- * N.B. exit if getProperties does not proclaim a compatible version.
+ * N.B. stop the driver if getProperties does not proclaim a compatible version.
  */
 int dispatch(XMLEle *root, char msg[])
 {
@@ -195,14 +449,18 @@ int dispatch(XMLEle *root, char msg[])
         ap = findXMLAtt(root, "version");
         if (!ap)
         {
-            fprintf(stderr, "%s: getProperties missing version\n", me);
-            exit(1);
+            snprintf(msg, MAXRBUF, "getProperties missing version");
+            fprintf(stderr, "%s: %s\n", me, msg);
+            driverio_abort();
+            return -1;
         }
         v = atof(valuXMLAtt(ap));
         if (v > INDIV)
         {
-            fprintf(stderr, "%s: client version %g > %g\n", me, v, INDIV);
-            exit(1);
+            snprintf(msg, MAXRBUF, "client version %g > %g", v, INDIV);
+            fprintf(stderr, "%s: %s\n", me, msg);
+            driverio_abort();
+            return -1;
         }
 
         // Get device
@@ -252,15 +510,26 @@ int dispatch(XMLEle *root, char msg[])
         return (0);
     }
 
+    /* indiserver pings after getProperties, the reply tells it our properties are all defined */
+    if (!strcmp(rtag, "pingRequest"))
+    {
+        driverio io;
+        driverio_init(&io);
+        IUUserIOPingReply(&io.userio, io.user, findXMLAttValu(root, "uid"));
+        driverio_finish(&io);
+        return (0);
+    }
+
     /* other commands might be from a snooped device.
-         * we don't know here which devices are being snooped so we send
-         * all remaining valid messages
+         * those of properties with handlers go to them first, we
+         * send all valid messages to ISSnoopDevice()
          */
     if (!strcmp(rtag, "setNumberVector") || !strcmp(rtag, "setTextVector") || !strcmp(rtag, "setLightVector") ||
             !strcmp(rtag, "setSwitchVector") || !strcmp(rtag, "setBLOBVector") || !strcmp(rtag, "defNumberVector") ||
             !strcmp(rtag, "defTextVector") || !strcmp(rtag, "defLightVector") || !strcmp(rtag, "defSwitchVector") ||
             !strcmp(rtag, "defBLOBVector") || !strcmp(rtag, "message") || !strcmp(rtag, "delProperty"))
     {
+        snoop_dispatch(root);
         ISSnoopDevice(root);
         return (0);
     }
@@ -482,488 +751,771 @@ int dispatch(XMLEle *root, char msg[])
     return (1);
 }
 
-int IUReadConfig(const char *filename, const char *dev, const char *property, int silent, char errmsg[])
+/* Configuration cache
+ *
+ * Drivers read many single properties from their configuration file while they connect and save single
+ * properties while users drag sliders. The parsed document of each configuration file is kept in memory,
+ * indexed by device and property name, and checked against the file with a stat() on every access.
+ * Single property updates are written back by a background thread once the document did not change for
+ * CONFIG_FLUSH_DELAY_MS, to a temporary file that is then renamed over the configuration file.
+ */
+
+#define CONFIG_FLUSH_DELAY_MS 1000
+
+typedef struct
 {
-    char *rname, *rdev;
-    XMLEle *root = NULL, *fproot = NULL;
-    LilXML *lp = newLilXML();
+    const char *dev;
+    const char *name;
+    int order;
+    XMLEle *ele;
+} ConfigIndexEntry;
 
-    FILE *fp = IUGetConfigFP(filename, dev, "r", errmsg);
+typedef struct ConfigCacheEntry
+{
+    char path[MAXRBUF];
+    XMLEle *root;
+    ConfigIndexEntry *index;
+    int nindex;
+    /* signature of the file the document was read from or last written to */
+    ino_t ino;
+    off_t size;
+    time_t mtime;
+    /* pending single property updates and when to write them */
+    int dirty;
+    struct timespec deadline;
+    struct ConfigCacheEntry *next;
+} ConfigCacheEntry;
+
+static ConfigCacheEntry *config_cache = NULL;
+static pthread_mutex_t config_mutex;
+static pthread_cond_t config_cond = PTHREAD_COND_INITIALIZER;
+static pthread_once_t config_once = PTHREAD_ONCE_INIT;
+static int config_thread_started = 0;
+
+
+static void configInit(void)
+{
+    /* recursive, drivers may read their configuration while handling a dispatched value */
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&config_mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    atexit(IUFlushAllConfig);
+}
 
-    if (fp == NULL)
-        return -1;
+static void configLock(void)
+{
+    pthread_once(&config_once, configInit);
+    pthread_mutex_lock(&config_mutex);
+}
 
-    char whynot[MAXRBUF];
-    fproot = readXMLFile(fp, lp, whynot);
+static void configUnlock(void)
+{
+    pthread_mutex_unlock(&config_mutex);
+}
 
-    delLilXML(lp);
+static void configFilePath(const char *filename, const char *dev, char path[MAXRBUF])
+{
+    if (filename)
+        snprintf(path, MAXRBUF, "%s", filename);
+    else if (getenv("INDICONFIG"))
+        snprintf(path, MAXRBUF, "%s", getenv("INDICONFIG"));
+    else
+        snprintf(path, MAXRBUF, "%s/.indi/%s_config.xml", getenv("HOME"), dev);
+}
 
-    if (fproot == NULL)
-    {
-        snprintf(errmsg, MAXRBUF, "Unable to parse config XML: %s", whynot);
-        fclose(fp);
-        return -1;
-    }
+static int configMakeDir(char errmsg[])
+{
+    char configDir[MAXRBUF];
+    struct stat st;
 
-    if (nXMLEle(fproot) > 0 && silent != 1)
-        IDMessage(dev, "[INFO] Loading device configuration...");
+    snprintf(configDir, MAXRBUF, "%s/.indi/", getenv("HOME"));
 
-    for (root = nextXMLEle(fproot, 1); root != NULL; root = nextXMLEle(fproot, 0))
+    if (stat(configDir, &st) != 0)
     {
-        /* pull out device and name */
-        if (crackDN(root, &rdev, &rname, errmsg) < 0)
+        if (mkdir(configDir, S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH) < 0)
         {
-            fclose(fp);
-            delXMLEle(fproot);
+            snprintf(errmsg, MAXRBUF, "Unable to create config directory. Error %s: %s", configDir, strerror(errno));
             return -1;
         }
+    }
 
-        // It doesn't belong to our device??
-        if (strcmp(dev, rdev))
-            continue;
+    return 0;
+}
 
-        if ((property && !strcmp(property, rname)) || property == NULL)
-        {
-            dispatch(root, errmsg);
-            if (property)
-                break;
-        }
+static int configCheckOwner(const char *path, char errmsg[])
+{
+    struct stat st;
+
+    /* If file is owned by root and current user is NOT root then abort */
+    if (stat(path, &st) == 0 && ((st.st_uid == 0 && getuid() != 0) || (st.st_gid == 0 && getgid() != 0)))
+    {
+        strncpy(errmsg,
+                "Config file is owned by root! This will lead to serious errors. To fix this, run: sudo chown -R $USER:$USER ~/.indi",
+                MAXRBUF);
+        return -1;
     }
 
-    if (nXMLEle(fproot) > 0 && silent != 1)
-        IDMessage(dev, "[INFO] Device configuration applied.");
+    return 0;
+}
 
-    fclose(fp);
-    delXMLEle(fproot);
+static int configIndexCompare(const void *a, const void *b)
+{
+    const ConfigIndexEntry *ia = (const ConfigIndexEntry *)a;
+    const ConfigIndexEntry *ib = (const ConfigIndexEntry *)b;
+    int result = strcmp(ia->dev, ib->dev);
+    if (result == 0)
+        result = strcmp(ia->name, ib->name);
+    return result;
+}
 
-    return (0);
+static int configIndexOrder(const void *a, const void *b)
+{
+    int result = configIndexCompare(a, b);
+    /* keep duplicates in document order, lookups return the first one like a linear scan */
+    return result ? result : ((const ConfigIndexEntry *)a)->order - ((const ConfigIndexEntry *)b)->order;
 }
 
-int IUSaveDefaultConfig(const char *source_config, const char *dest_config, const char *dev)
+static void configCacheClear(ConfigCacheEntry *entry)
 {
-    char configFileName[MAXRBUF], configDefaultFileName[MAXRBUF];
+    delXMLEle(entry->root);
+    free(entry->index);
+    entry->root   = NULL;
+    entry->index  = NULL;
+    entry->nindex = 0;
+    entry->dirty  = 0;
+}
 
-    if (source_config)
-        strncpy(configFileName, source_config, MAXRBUF);
-    else
-    {
-        if (getenv("INDICONFIG"))
-            strncpy(configFileName, getenv("INDICONFIG"), MAXRBUF);
-        else
-            snprintf(configFileName, MAXRBUF, "%s/.indi/%s_config.xml", getenv("HOME"), dev);
-    }
+static void configCacheSign(ConfigCacheEntry *entry, const struct stat *st)
+{
+    entry->ino   = st->st_ino;
+    entry->size  = st->st_size;
+    entry->mtime = st->st_mtime;
+}
 
-    if (dest_config)
-        strncpy(configDefaultFileName, dest_config, MAXRBUF);
-    else if (getenv("INDICONFIG"))
-        snprintf(configDefaultFileName, MAXRBUF, "%s.default", getenv("INDICONFIG"));
-    else
-        snprintf(configDefaultFileName, MAXRBUF, "%s/.indi/%s_config.xml.default", getenv("HOME"), dev);
+static ConfigCacheEntry *configCacheEntry(const char *path, int create)
+{
+    ConfigCacheEntry *entry;
 
-    // If the default doesn't exist, create it.
-    if (access(configDefaultFileName, F_OK))
+    for (entry = config_cache; entry != NULL; entry = entry->next)
     {
-        FILE *fpin = fopen(configFileName, "r");
-        if (fpin != NULL)
-        {
-            FILE *fpout = fopen(configDefaultFileName, "w");
-            if (fpout != NULL)
-            {
-                int ch = 0;
-                while ((ch = getc(fpin)) != EOF)
-                    putc(ch, fpout);
-
-                fflush(fpout);
-                fclose(fpout);
-            }
-            fclose(fpin);
-
-            return 0;
-        }
+        if (!strcmp(entry->path, path))
+            return entry;
     }
-    // If default config file exists already, then no need to modify it
-    else
-        return 0;
 
+    if (!create)
+        return NULL;
 
-    return -1;
+    assert_mem(entry = (ConfigCacheEntry *)calloc(1, sizeof(ConfigCacheEntry)));
+    snprintf(entry->path, MAXRBUF, "%s", path);
+    entry->next  = config_cache;
+    config_cache = entry;
+    return entry;
 }
 
-int IUGetConfigOnSwitch(const ISwitchVectorProperty *property, int *index)
+/* Return the cached document of path, reading it again if the file changed since. Must be called locked. */
+static ConfigCacheEntry *configCacheGet(const char *path, char errmsg[])
 {
-    char *rname, *rdev;
-    XMLEle *root = NULL, *fproot = NULL;
-    char errmsg[MAXRBUF];
-    LilXML *lp = newLilXML();
-    int propertyFound = 0;
-    *index = -1;
+    ConfigCacheEntry *entry = configCacheEntry(path, 1);
+    struct stat st;
+    XMLEle *ep;
+    int n = 0;
+
+    /* the document in memory is newer than the file until it is flushed */
+    if (entry->dirty)
+        return entry;
+
+    if (stat(path, &st) != 0)
+    {
+        snprintf(errmsg, MAXRBUF, "Unable to open config file. Error loading file %s: %s", path, strerror(errno));
+        configCacheClear(entry);
+        return NULL;
+    }
+
+    if (entry->root != NULL && entry->ino == st.st_ino && entry->size == st.st_size && entry->mtime == st.st_mtime)
+        return entry;
 
-    FILE *fp = IUGetConfigFP(NULL, property->device, "r", errmsg);
+    configCacheClear(entry);
 
+    if (configCheckOwner(path, errmsg) < 0)
+        return NULL;
+
+    FILE *fp = fopen(path, "r");
     if (fp == NULL)
     {
-        delLilXML(lp);
-        return -1;
+        snprintf(errmsg, MAXRBUF, "Unable to open config file. Error loading file %s: %s", path, strerror(errno));
+        return NULL;
     }
 
-    fproot = readXMLFile(fp, lp, errmsg);
+    char whynot[MAXRBUF] = {0};
+    LilXML *lp = newLilXML();
+    entry->root = readXMLFile(fp, lp, whynot);
+    delLilXML(lp);
+    fclose(fp);
 
-    if (fproot == NULL)
+    if (entry->root == NULL)
     {
-        delLilXML(lp);
-        fclose(fp);
-        return -1;
+        snprintf(errmsg, MAXRBUF, "Unable to parse config XML: %s", whynot);
+        return NULL;
     }
 
-    for (root = nextXMLEle(fproot, 1); root != NULL; root = nextXMLEle(fproot, 0))
+    assert_mem(entry->index = (ConfigIndexEntry *)malloc((nXMLEle(entry->root) + 1) * sizeof(ConfigIndexEntry)));
+    for (ep = nextXMLEle(entry->root, 1); ep != NULL; ep = nextXMLEle(entry->root, 0), n++)
     {
-        /* pull out device and name */
-        if (crackDN(root, &rdev, &rname, errmsg) < 0)
-        {
-            fclose(fp);
-            delXMLEle(fproot);
-            return -1;
-        }
+        entry->index[entry->nindex].dev   = findXMLAttValu(ep, "device");
+        entry->index[entry->nindex].name  = findXMLAttValu(ep, "name");
+        entry->index[entry->nindex].order = n;
+        entry->index[entry->nindex].ele   = ep;
+        entry->nindex++;
+    }
+    qsort(entry->index, entry->nindex, sizeof(ConfigIndexEntry), configIndexOrder);
 
-        // It doesn't belong to our device??
-        if (strcmp(property->device, rdev))
-            continue;
+    /* signed with the state before reading, a concurrent change makes the next access read it again */
+    configCacheSign(entry, &st);
+    return entry;
+}
 
-        if (!strcmp(property->name, rname))
+/* Find the property of dev in a cached document, or its first property if property is NULL */
+static XMLEle *configCacheFind(ConfigCacheEntry *entry, const char *dev, const char *property)
+{
+    ConfigIndexEntry key, *found;
+    XMLEle *ep;
+
+    if (property == NULL)
+    {
+        for (ep = nextXMLEle(entry->root, 1); ep != NULL; ep = nextXMLEle(entry->root, 0))
         {
-            propertyFound = 1;
-            XMLEle *oneSwitch = NULL;
-            int oneSwitchIndex = 0;
-            ISState oneSwitchState;
-            for (oneSwitch = nextXMLEle(root, 1); oneSwitch != NULL; oneSwitch = nextXMLEle(root, 0), oneSwitchIndex++)
-            {
-                if (crackISState(pcdataXMLEle(oneSwitch), &oneSwitchState) == 0 && oneSwitchState == ISS_ON)
-                {
-                    *index = oneSwitchIndex;
-                    break;
-                }
-            }
-            break;
+            if (!strcmp(dev, findXMLAttValu(ep, "device")))
+                return ep;
         }
+        return NULL;
     }
 
-    fclose(fp);
-    delXMLEle(fproot);
-    delLilXML(lp);
+    key.dev  = dev;
+    key.name = property;
+    found = (ConfigIndexEntry *)bsearch(&key, entry->index, entry->nindex, sizeof(ConfigIndexEntry), configIndexCompare);
+    if (found == NULL)
+        return NULL;
 
-    return (propertyFound ? 0 : -1);
+    while (found > entry->index && configIndexCompare(found - 1, &key) == 0)
+        found--;
+
+    return found->ele;
 }
 
-int IUGetConfigSwitch(const char *dev, const char *property, const char *member, ISState *value)
+/* Open a temporary file next to path that replaces it once committed */
+static FILE *configTempFP(const char *path, char tempname[MAXRBUF], char errmsg[])
 {
-    char *rname, *rdev;
-    XMLEle *root = NULL, *fproot = NULL;
-    char errmsg[MAXRBUF];
-    LilXML *lp = newLilXML();
-    int valueFound = 0;
+    struct stat st;
+    mode_t mode = S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH;
+    FILE *fp;
+    int fd;
+
+    if (configMakeDir(errmsg) < 0 || configCheckOwner(path, errmsg) < 0)
+        return NULL;
+
+    /* keep the permissions of the file we replace */
+    if (stat(path, &st) == 0)
+        mode = st.st_mode & (S_IRWXU | S_IRWXG | S_IRWXO);
+
+    snprintf(tempname, MAXRBUF, "%s.XXXXXX", path);
+    fd = mkstemp(tempname);
+    if (fd < 0)
+    {
+        snprintf(errmsg, MAXRBUF, "Unable to create temporary config file %s: %s", tempname, strerror(errno));
+        return NULL;
+    }
 
-    FILE *fp = IUGetConfigFP(NULL, dev, "r", errmsg);
+    fchmod(fd, mode);
 
+    fp = fdopen(fd, "w");
     if (fp == NULL)
     {
-        delLilXML(lp);
-        return -1;
+        snprintf(errmsg, MAXRBUF, "Unable to open temporary config file %s: %s", tempname, strerror(errno));
+        close(fd);
+        unlink(tempname);
     }
 
-    fproot = readXMLFile(fp, lp, errmsg);
+    return fp;
+}
+
+static int configCommitTemp(FILE *fp, const char *tempname, const char *path, char errmsg[])
+{
+    int result = 0;
+
+    if (fflush(fp) != 0 || fsync(fileno(fp)) != 0)
+        result = -1;
+    if (fclose(fp) != 0)
+        result = -1;
+    if (result == 0 && rename(tempname, path) != 0)
+        result = -1;
 
-    if (fproot == NULL)
+    if (result != 0)
     {
-        fclose(fp);
-        delLilXML(lp);
+        snprintf(errmsg, MAXRBUF, "Unable to write config file %s: %s", path, strerror(errno));
+        unlink(tempname);
+    }
+
+    return result;
+}
+
+/* Write a cached document back to its file. Must be called locked. */
+static int configCacheWrite(ConfigCacheEntry *entry, char errmsg[])
+{
+    char tempname[MAXRBUF];
+    struct stat st;
+    FILE *fp = configTempFP(entry->path, tempname, errmsg);
+
+    if (fp == NULL)
         return -1;
+
+    prXMLEle(fp, entry->root, 0);
+
+    if (configCommitTemp(fp, tempname, entry->path, errmsg) < 0)
+        return -1;
+
+    entry->dirty = 0;
+    if (stat(entry->path, &st) == 0)
+        configCacheSign(entry, &st);
+
+    return 0;
+}
+
+void IUFlushAllConfig(void)
+{
+    char errmsg[MAXRBUF];
+    ConfigCacheEntry *entry;
+
+    configLock();
+    for (entry = config_cache; entry != NULL; entry = entry->next)
+    {
+        if (entry->dirty && configCacheWrite(entry, errmsg) < 0)
+            fprintf(stderr, "%s\n", errmsg);
     }
+    configUnlock();
+}
 
-    for (root = nextXMLEle(fproot, 1); root != NULL; root = nextXMLEle(fproot, 0))
+static void *configFlushThread(void *arg)
+{
+    char errmsg[MAXRBUF];
+    struct timespec now;
+    ConfigCacheEntry *entry, *next;
+
+    (void)arg;
+
+    configLock();
+    for (;;)
     {
-        /* pull out device and name */
-        if (crackDN(root, &rdev, &rname, errmsg) < 0)
+        next = NULL;
+        for (entry = config_cache; entry != NULL; entry = entry->next)
         {
-            fclose(fp);
-            delXMLEle(fproot);
-            return -1;
+            if (entry->dirty && (next == NULL || entry->deadline.tv_sec < next->deadline.tv_sec ||
+                                 (entry->deadline.tv_sec == next->deadline.tv_sec && entry->deadline.tv_nsec < next->deadline.tv_nsec)))
+                next = entry;
         }
 
-        // It doesn't belong to our device??
-        if (strcmp(dev, rdev))
+        if (next == NULL)
+        {
+            pthread_cond_wait(&config_cond, &config_mutex);
             continue;
+        }
 
-        if ((property && !strcmp(property, rname)) || property == NULL)
+        clock_gettime(CLOCK_REALTIME, &now);
+        if (now.tv_sec < next->deadline.tv_sec ||
+                (now.tv_sec == next->deadline.tv_sec && now.tv_nsec < next->deadline.tv_nsec))
         {
-            XMLEle *oneSwitch = NULL;
-            for (oneSwitch = nextXMLEle(root, 1); oneSwitch != NULL; oneSwitch = nextXMLEle(root, 0))
-            {
-                if (!strcmp(member, findXMLAttValu(oneSwitch, "name")))
-                {
-                    if (crackISState(pcdataXMLEle(oneSwitch), value) == 0)
-                        valueFound = 1;
-                    break;
-                }
-            }
-            break;
+            pthread_cond_timedwait(&config_cond, &config_mutex, &next->deadline);
+            continue;
+        }
+
+        if (configCacheWrite(next, errmsg) < 0)
+        {
+            fprintf(stderr, "%s\n", errmsg);
+            /* try again later, the document stays dirty */
+            next->deadline.tv_sec = now.tv_sec + CONFIG_FLUSH_DELAY_MS / 1000;
+            next->deadline.tv_nsec = now.tv_nsec;
         }
     }
 
-    fclose(fp);
-    delXMLEle(fproot);
-    delLilXML(lp);
+    return NULL;
+}
 
-    return (valueFound == 1 ? 0 : -1);
+static void configScheduleFlush(ConfigCacheEntry *entry)
+{
+    clock_gettime(CLOCK_REALTIME, &entry->deadline);
+    entry->deadline.tv_sec  += CONFIG_FLUSH_DELAY_MS / 1000;
+    entry->deadline.tv_nsec += (CONFIG_FLUSH_DELAY_MS % 1000) * 1000000L;
+    if (entry->deadline.tv_nsec >= 1000000000L)
+    {
+        entry->deadline.tv_sec++;
+        entry->deadline.tv_nsec -= 1000000000L;
+    }
+    entry->dirty = 1;
+
+    if (!config_thread_started)
+    {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, configFlushThread, NULL) == 0)
+        {
+            pthread_detach(thread);
+            config_thread_started = 1;
+        }
+    }
+
+    pthread_cond_signal(&config_cond);
 }
 
-int IUGetConfigOnSwitchIndex(const char *dev, const char *property, int *index)
+XMLEle *IULockConfigProperty(const char *filename, const char *dev, const char *property, char errmsg[])
 {
-    char *rname, *rdev;
-    XMLEle *root = NULL, *fproot = NULL;
-    char errmsg[MAXRBUF];
-    LilXML *lp = newLilXML();
-    int valueFound = 0;
+    char path[MAXRBUF];
+    ConfigCacheEntry *entry;
+    XMLEle *ep = NULL;
 
-    FILE *fp = IUGetConfigFP(NULL, dev, "r", errmsg);
+    configFilePath(filename, dev, path);
 
-    if (fp == NULL)
+    configLock();
+    entry = configCacheGet(path, errmsg);
+    if (entry != NULL)
     {
-        delLilXML(lp);
-        return -1;
+        ep = configCacheFind(entry, dev, property);
+        if (ep == NULL)
+            snprintf(errmsg, MAXRBUF, "Property %s is not in config file %s", property ? property : "", path);
     }
 
-    fproot = readXMLFile(fp, lp, errmsg);
+    if (ep == NULL)
+        configUnlock();
 
-    if (fproot == NULL)
+    return ep;
+}
+
+void IUUnlockConfigProperty(const char *filename, const char *dev, int modified)
+{
+    char path[MAXRBUF];
+    ConfigCacheEntry *entry;
+
+    if (modified)
     {
-        delLilXML(lp);
-        fclose(fp);
-        return -1;
+        configFilePath(filename, dev, path);
+        entry = configCacheEntry(path, 0);
+        if (entry != NULL && entry->root != NULL)
+            configScheduleFlush(entry);
     }
 
-    for (root = nextXMLEle(fproot, 1); root != NULL; root = nextXMLEle(fproot, 0))
-    {
-        /* pull out device and name */
-        if (crackDN(root, &rdev, &rname, errmsg) < 0)
-        {
-            fclose(fp);
-            delXMLEle(fproot);
-            return -1;
-        }
+    configUnlock();
+}
 
-        // It doesn't belong to our device??
-        if (strcmp(dev, rdev))
-            continue;
+int IUFlushConfig(const char *filename, const char *dev, char errmsg[])
+{
+    char path[MAXRBUF];
+    ConfigCacheEntry *entry;
+    int result = 0;
 
-        if ((property && !strcmp(property, rname)) || property == NULL)
-        {
-            XMLEle *oneSwitch = NULL;
-            int currentIndex = 0;
-            for (oneSwitch = nextXMLEle(root, 1); oneSwitch != NULL; oneSwitch = nextXMLEle(root, 0), currentIndex++)
-            {
-                ISState s = ISS_OFF;
-                if (crackISState(pcdataXMLEle(oneSwitch), &s) == 0 && s == ISS_ON)
-                {
-                    *index = currentIndex;
-                    valueFound = 1;
-                    break;
-                }
-            }
-            break;
-        }
-    }
+    configFilePath(filename, dev, path);
 
-    fclose(fp);
-    delXMLEle(fproot);
-    delLilXML(lp);
+    configLock();
+    entry = configCacheEntry(path, 0);
+    if (entry != NULL && entry->dirty)
+        result = configCacheWrite(entry, errmsg);
+    configUnlock();
 
-    return (valueFound == 1 ? 0 : -1);
+    return result;
 }
 
-int IUGetConfigOnSwitchName(const char *dev, const char *property, char *name, size_t size)
+FILE *IUGetConfigTempFP(const char *filename, const char *dev, char tempname[], char errmsg[])
+{
+    char path[MAXRBUF];
+
+    configFilePath(filename, dev, path);
+    return configTempFP(path, tempname, errmsg);
+}
+
+int IUCommitConfigFP(FILE *fp, const char *tempname, const char *filename, const char *dev, char errmsg[])
 {
-    char *rname, *rdev;
+    char path[MAXRBUF];
+    ConfigCacheEntry *entry;
+    int result;
+
+    configFilePath(filename, dev, path);
+
+    configLock();
+    result = configCommitTemp(fp, tempname, path, errmsg);
+    /* the new file supersedes pending single property updates, it is read again on next access */
+    entry = configCacheEntry(path, 0);
+    if (entry != NULL)
+        configCacheClear(entry);
+    configUnlock();
+
+    return result;
+}
+
+int IUReadConfig(const char *filename, const char *dev, const char *property, int silent, char errmsg[])
+{
+    char path[MAXRBUF];
+    ConfigCacheEntry *entry;
     XMLEle *root = NULL, *fproot = NULL;
-    char errmsg[MAXRBUF];
-    LilXML *lp = newLilXML();
-    int found = -1;
+    int nelements;
 
-    FILE *fp = IUGetConfigFP(NULL, dev, "r", errmsg);
+    configFilePath(filename, dev, path);
 
-    if (fp == NULL)
+    configLock();
+    entry = configCacheGet(path, errmsg);
+    if (entry == NULL)
     {
-        delLilXML(lp);
+        configUnlock();
         return -1;
     }
 
-    fproot = readXMLFile(fp, lp, errmsg);
-
-    if (fproot == NULL)
+    /* dispatch a copy, the driver may read or save its configuration while it handles the values */
+    if (property)
     {
-        delLilXML(lp);
-        fclose(fp);
-        return -1;
+        root = configCacheFind(entry, dev, property);
+        fproot = root ? cloneXMLEle(root, NULL, NULL) : NULL;
     }
+    else
+        fproot = cloneXMLEle(entry->root, NULL, NULL);
+    nelements = nXMLEle(entry->root);
+    configUnlock();
+
+    if (nelements > 0 && silent != 1)
+        IDMessage(dev, "[INFO] Loading device configuration...");
 
-    for (root = nextXMLEle(fproot, 1); root != NULL; root = nextXMLEle(fproot, 0))
+    if (property)
     {
-        /* pull out device and name */
-        if (crackDN(root, &rdev, &rname, errmsg) < 0)
+        if (fproot)
+            dispatch(fproot, errmsg);
+    }
+    else
+    {
+        for (root = nextXMLEle(fproot, 1); root != NULL; root = nextXMLEle(fproot, 0))
         {
-            fclose(fp);
-            delXMLEle(fproot);
-            return -1;
+            // It doesn't belong to our device??
+            if (strcmp(dev, findXMLAttValu(root, "device")))
+                continue;
+
+            dispatch(root, errmsg);
         }
+    }
 
-        // It doesn't belong to our device??
-        if (strcmp(dev, rdev))
-            continue;
+    if (nelements > 0 && silent != 1)
+        IDMessage(dev, "[INFO] Device configuration applied.");
+
+    delXMLEle(fproot);
+
+    return (0);
+}
 
-        if ((property && !strcmp(property, rname)) || property == NULL)
+int IUSaveDefaultConfig(const char *source_config, const char *dest_config, const char *dev)
+{
+    char configFileName[MAXRBUF], configDefaultFileName[MAXRBUF];
+
+    if (source_config)
+        strncpy(configFileName, source_config, MAXRBUF);
+    else
+    {
+        if (getenv("INDICONFIG"))
+            strncpy(configFileName, getenv("INDICONFIG"), MAXRBUF);
+        else
+            snprintf(configFileName, MAXRBUF, "%s/.indi/%s_config.xml", getenv("HOME"), dev);
+    }
+
+    if (dest_config)
+        strncpy(configDefaultFileName, dest_config, MAXRBUF);
+    else if (getenv("INDICONFIG"))
+        snprintf(configDefaultFileName, MAXRBUF, "%s.default", getenv("INDICONFIG"));
+    else
+        snprintf(configDefaultFileName, MAXRBUF, "%s/.indi/%s_config.xml.default", getenv("HOME"), dev);
+
+    // If the default doesn't exist, create it.
+    if (access(configDefaultFileName, F_OK))
+    {
+        char errmsg[MAXRBUF];
+        // Copy what the driver saved last, not what was flushed last
+        IUFlushConfig(configFileName, dev, errmsg);
+
+        FILE *fpin = fopen(configFileName, "r");
+        if (fpin != NULL)
         {
-            XMLEle *oneSwitch = NULL;
-            int currentIndex = 0;
-            for (oneSwitch = nextXMLEle(root, 1); oneSwitch != NULL; oneSwitch = nextXMLEle(root, 0), currentIndex++)
+            FILE *fpout = fopen(configDefaultFileName, "w");
+            if (fpout != NULL)
             {
-                ISState s = ISS_OFF;
-                if (crackISState(pcdataXMLEle(oneSwitch), &s) == 0 && s == ISS_ON)
-                {
-                    found = 0;
-                    strncpy(name, findXMLAttValu(oneSwitch, "name"), size);
-                    break;
-                }
+                int ch = 0;
+                while ((ch = getc(fpin)) != EOF)
+                    putc(ch, fpout);
+
+                fflush(fpout);
+                fclose(fpout);
             }
-            break;
+            fclose(fpin);
+
+            return 0;
         }
     }
+    // If default config file exists already, then no need to modify it
+    else
+        return 0;
 
-    fclose(fp);
-    delXMLEle(fproot);
-    delLilXML(lp);
 
-    return found;
+    return -1;
 }
 
-int IUGetConfigNumber(const char *dev, const char *property, const char *member, double *value)
+int IUGetConfigOnSwitch(const ISwitchVectorProperty *property, int *index)
 {
-    char *rname, *rdev;
-    XMLEle *root = NULL, *fproot = NULL;
     char errmsg[MAXRBUF];
-    LilXML *lp = newLilXML();
-    int valueFound = 0;
+    XMLEle *root = NULL;
+    XMLEle *oneSwitch = NULL;
+    int oneSwitchIndex = 0;
+    ISState oneSwitchState;
+    *index = -1;
 
-    FILE *fp = IUGetConfigFP(NULL, dev, "r", errmsg);
+    root = IULockConfigProperty(NULL, property->device, property->name, errmsg);
+    if (root == NULL)
+        return -1;
 
-    if (fp == NULL)
+    for (oneSwitch = nextXMLEle(root, 1); oneSwitch != NULL; oneSwitch = nextXMLEle(root, 0), oneSwitchIndex++)
     {
-        delLilXML(lp);
-        return -1;
+        if (crackISState(pcdataXMLEle(oneSwitch), &oneSwitchState) == 0 && oneSwitchState == ISS_ON)
+        {
+            *index = oneSwitchIndex;
+            break;
+        }
     }
 
-    fproot = readXMLFile(fp, lp, errmsg);
+    IUUnlockConfigProperty(NULL, property->device, 0);
 
-    if (fproot == NULL)
-    {
-        fclose(fp);
-        delLilXML(lp);
+    return (0);
+}
+
+int IUGetConfigSwitch(const char *dev, const char *property, const char *member, ISState *value)
+{
+    char errmsg[MAXRBUF];
+    XMLEle *root = NULL;
+    XMLEle *oneSwitch = NULL;
+    int valueFound = 0;
+
+    root = IULockConfigProperty(NULL, dev, property, errmsg);
+    if (root == NULL)
         return -1;
-    }
 
-    for (root = nextXMLEle(fproot, 1); root != NULL; root = nextXMLEle(fproot, 0))
+    for (oneSwitch = nextXMLEle(root, 1); oneSwitch != NULL; oneSwitch = nextXMLEle(root, 0))
     {
-        /* pull out device and name */
-        if (crackDN(root, &rdev, &rname, errmsg) < 0)
+        if (!strcmp(member, findXMLAttValu(oneSwitch, "name")))
         {
-            fclose(fp);
-            delXMLEle(fproot);
-            return -1;
+            if (crackISState(pcdataXMLEle(oneSwitch), value) == 0)
+                valueFound = 1;
+            break;
         }
+    }
 
-        // It doesn't belong to our device??
-        if (strcmp(dev, rdev))
-            continue;
+    IUUnlockConfigProperty(NULL, dev, 0);
+
+    return (valueFound == 1 ? 0 : -1);
+}
+
+int IUGetConfigOnSwitchIndex(const char *dev, const char *property, int *index)
+{
+    char errmsg[MAXRBUF];
+    XMLEle *root = NULL;
+    XMLEle *oneSwitch = NULL;
+    int currentIndex = 0;
+    int valueFound = 0;
+
+    root = IULockConfigProperty(NULL, dev, property, errmsg);
+    if (root == NULL)
+        return -1;
 
-        if ((property && !strcmp(property, rname)) || property == NULL)
+    for (oneSwitch = nextXMLEle(root, 1); oneSwitch != NULL; oneSwitch = nextXMLEle(root, 0), currentIndex++)
+    {
+        ISState s = ISS_OFF;
+        if (crackISState(pcdataXMLEle(oneSwitch), &s) == 0 && s == ISS_ON)
         {
-            XMLEle *oneNumber = NULL;
-            for (oneNumber = nextXMLEle(root, 1); oneNumber != NULL; oneNumber = nextXMLEle(root, 0))
-            {
-                if (!strcmp(member, findXMLAttValu(oneNumber, "name")))
-                {
-                    *value = atof(pcdataXMLEle(oneNumber));
-                    valueFound = 1;
-                    break;
-                }
-            }
+            *index = currentIndex;
+            valueFound = 1;
             break;
         }
     }
 
-    fclose(fp);
-    delXMLEle(fproot);
-    delLilXML(lp);
+    IUUnlockConfigProperty(NULL, dev, 0);
 
     return (valueFound == 1 ? 0 : -1);
 }
 
-int IUGetConfigText(const char *dev, const char *property, const char *member, char *value, int len)
+int IUGetConfigOnSwitchName(const char *dev, const char *property, char *name, size_t size)
 {
-    char *rname, *rdev;
-    XMLEle *root = NULL, *fproot = NULL;
     char errmsg[MAXRBUF];
-    LilXML *lp = newLilXML();
-    int valueFound = 0;
+    XMLEle *root = NULL;
+    XMLEle *oneSwitch = NULL;
+    int found = -1;
 
-    FILE *fp = IUGetConfigFP(NULL, dev, "r", errmsg);
+    root = IULockConfigProperty(NULL, dev, property, errmsg);
+    if (root == NULL)
+        return -1;
 
-    if (fp == NULL)
+    for (oneSwitch = nextXMLEle(root, 1); oneSwitch != NULL; oneSwitch = nextXMLEle(root, 0))
     {
-        delLilXML(lp);
-        return -1;
+        ISState s = ISS_OFF;
+        if (crackISState(pcdataXMLEle(oneSwitch), &s) == 0 && s == ISS_ON)
+        {
+            found = 0;
+            strncpy(name, findXMLAttValu(oneSwitch, "name"), size);
+            break;
+        }
     }
 
-    fproot = readXMLFile(fp, lp, errmsg);
+    IUUnlockConfigProperty(NULL, dev, 0);
 
-    if (fproot == NULL)
-    {
-        delLilXML(lp);
-        fclose(fp);
+    return found;
+}
+
+int IUGetConfigNumber(const char *dev, const char *property, const char *member, double *value)
+{
+    char errmsg[MAXRBUF];
+    XMLEle *root = NULL;
+    XMLEle *oneNumber = NULL;
+    int valueFound = 0;
+
+    root = IULockConfigProperty(NULL, dev, property, errmsg);
+    if (root == NULL)
         return -1;
-    }
 
-    for (root = nextXMLEle(fproot, 1); root != NULL; root = nextXMLEle(fproot, 0))
+    for (oneNumber = nextXMLEle(root, 1); oneNumber != NULL; oneNumber = nextXMLEle(root, 0))
     {
-        /* pull out device and name */
-        if (crackDN(root, &rdev, &rname, errmsg) < 0)
+        if (!strcmp(member, findXMLAttValu(oneNumber, "name")))
         {
-            fclose(fp);
-            delXMLEle(fproot);
-            return -1;
+            *value = atof(pcdataXMLEle(oneNumber));
+            valueFound = 1;
+            break;
         }
+    }
 
-        // It doesn't belong to our device??
-        if (strcmp(dev, rdev))
-            continue;
+    IUUnlockConfigProperty(NULL, dev, 0);
+
+    return (valueFound == 1 ? 0 : -1);
+}
 
-        if ((property && !strcmp(property, rname)) || property == NULL)
+int IUGetConfigText(const char *dev, const char *property, const char *member, char *value, int len)
+{
+    char errmsg[MAXRBUF];
+    XMLEle *root = NULL;
+    XMLEle *oneText = NULL;
+    int valueFound = 0;
+
+    root = IULockConfigProperty(NULL, dev, property, errmsg);
+    if (root == NULL)
+        return -1;
+
+    for (oneText = nextXMLEle(root, 1); oneText != NULL; oneText = nextXMLEle(root, 0))
+    {
+        if (!strcmp(member, findXMLAttValu(oneText, "name")))
         {
-            XMLEle *oneText = NULL;
-            for (oneText = nextXMLEle(root, 1); oneText != NULL; oneText = nextXMLEle(root, 0))
-            {
-                if (!strcmp(member, findXMLAttValu(oneText, "name")))
-                {
-                    strncpy(value, pcdataXMLEle(oneText), len);
-                    valueFound = 1;
-                    break;
-                }
-            }
+            strncpy(value, pcdataXMLEle(oneText), len);
+            valueFound = 1;
             break;
         }
     }
 
-    fclose(fp);
-    delXMLEle(fproot);
-    delLilXML(lp);
+    IUUnlockConfigProperty(NULL, dev, 0);
 
     return (valueFound == 1 ? 0 : -1);
 }
@@ -992,66 +1544,36 @@ void IDMessage(const char *dev, const char *fmt, ...)
 int IUPurgeConfig(const char *filename, const char *dev, char errmsg[])
 {
     char configFileName[MAXRBUF];
-    char configDir[MAXRBUF];
+    ConfigCacheEntry *entry;
+    int result = 0;
 
-    snprintf(configDir, MAXRBUF, "%s/.indi/", getenv("HOME"));
+    configFilePath(filename, dev, configFileName);
 
-    if (filename)
-        strncpy(configFileName, filename, MAXRBUF);
-    else
-    {
-        if (getenv("INDICONFIG"))
-            strncpy(configFileName, getenv("INDICONFIG"), MAXRBUF);
-        else
-            snprintf(configFileName, MAXRBUF, "%s%s_config.xml", configDir, dev);
-    }
+    configLock();
+    /* drop pending updates too, they would bring the file back */
+    entry = configCacheEntry(configFileName, 0);
+    if (entry != NULL)
+        configCacheClear(entry);
 
     if (remove(configFileName) != 0)
     {
         snprintf(errmsg, MAXRBUF, "Unable to purge configuration file %s. Error %s", configFileName, strerror(errno));
-        return -1;
+        result = -1;
     }
+    configUnlock();
 
-    return 0;
+    return result;
 }
 
 FILE *IUGetConfigFP(const char *filename, const char *dev, const char *mode, char errmsg[])
 {
     char configFileName[MAXRBUF];
-    char configDir[MAXRBUF];
-    struct stat st;
     FILE *fp = NULL;
 
-    snprintf(configDir, MAXRBUF, "%s/.indi/", getenv("HOME"));
-
-    if (filename)
-        strncpy(configFileName, filename, MAXRBUF);
-    else
-    {
-        if (getenv("INDICONFIG"))
-            strncpy(configFileName, getenv("INDICONFIG"), MAXRBUF);
-        else
-            snprintf(configFileName, MAXRBUF, "%s%s_config.xml", configDir, dev);
-    }
-
-    if (stat(configDir, &st) != 0)
-    {
-        if (mkdir(configDir, S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH) < 0)
-        {
-            snprintf(errmsg, MAXRBUF, "Unable to create config directory. Error %s: %s", configDir, strerror(errno));
-            return NULL;
-        }
-    }
+    configFilePath(filename, dev, configFileName);
 
-    stat(configFileName, &st);
-    /* If file is owned by root and current user is NOT root then abort */
-    if ( (st.st_uid == 0 && getuid() != 0) || (st.st_gid == 0 && getgid() != 0) )
-    {
-        strncpy(errmsg,
-                "Config file is owned by root! This will lead to serious errors. To fix this, run: sudo chown -R $USER:$USER ~/.indi",
-                MAXRBUF);
+    if (configMakeDir(errmsg) < 0 || configCheckOwner(configFileName, errmsg) < 0)
         return NULL;
-    }
 
     fp = fopen(configFileName, mode);
     if (fp == NULL)
@@ -40,6 +40,55 @@ extern char *me;       /* a.out name */
 extern int dispatch(XMLEle *root, char msg[]);
 //extern void clientMsgCB(int fd, void *arg);
 
+/** @brief Entry point of a driver built as a module, called by indiserver on a thread of its own.
+ *  The module is loaded in a namespace of its own, so it has its own copy of libindidriver and libc.
+ *  @param fd socket connected to indiserver, used in place of stdin and stdout.
+ *  @param name driver name, used for me.
+ *  @param env environment of the driver, NULL terminated.
+ *  @return 0 once indiserver closed the connection.
+ */
+extern int indiDriverModuleMain(int fd, const char *name, char *const env[]);
+
+/** @brief Counters of the output queue, see IDOutputQueueEnable(). */
+typedef struct IDOutputQueueStats
+{
+    /** Messages queued so far */
+    unsigned long messages;
+    /** set*Vector messages replaced by a newer one for the same property before they were sent */
+    unsigned long coalesced;
+    /** sendmsg() or writev() calls of the writer thread */
+    unsigned long sends;
+    /** Bytes queued or being sent now */
+    size_t queuedBytes;
+    /** Most bytes ever queued at once */
+    size_t peakBytes;
+    /** Seconds the writer thread spent blocked sending to indiserver */
+    double writerSeconds;
+    /** Seconds the threads sending messages waited for room in a full queue */
+    double stallSeconds;
+} IDOutputQueueStats;
+
+/** @brief Queue the messages of the driver for a writer thread instead of sending them on the calling thread.
+ *  A thread sending a message then only waits for indiserver when maxBytes are already queued. A set*Vector
+ *  without a message replaces the one still queued for the same property, so a slow connection gets the
+ *  latest values rather than every one of them. The writer sends whatever is queued with few sendmsg() calls.
+ *  Setting INDI_OUTPUT_QUEUE in the environment of the driver enables it with that many bytes, or the default
+ *  for a value that is not a number.
+ *  @param maxBytes bytes queued before senders wait, 0 for 16 MiB.
+ *  @note Call it before the driver sends anything. It stays enabled.
+ *  @return 0 on success, -1 if the writer thread could not be started.
+ */
+extern int IDOutputQueueEnable(size_t maxBytes);
+
+/** @brief Wait until everything queued so far was sent, or the connection failed. Does nothing without a queue. */
+extern void IDOutputQueueFlush(void);
+
+/** @brief Copy the counters of the output queue, all zero without a queue. */
+extern void IDOutputQueueGetStats(IDOutputQueueStats *stats);
+
+/** @return 1 if the messages of the driver go through the output queue, 0 otherwise. */
+extern int IDOutputQueueEnabled(void);
+
 /**
  * @defgroup configFunctions Configuration Functions: Functions drivers call to save and load configuration options.
  * 
@@ -103,6 +152,59 @@ extern int IUPurgeConfig(const char *filename, const char *dev, char errmsg[]);
  */
 extern int IUReadConfig(const char *filename, const char *dev, const char *property, int silent, char errmsg[]);
 
+/** @brief Find a property in the cached configuration document and keep the cache locked.
+ *  Configuration files are parsed once and kept in memory, all the configuration functions read from that copy
+ *  as long as the file on disk does not change. The returned element may be read or edited in place until
+ *  IUUnlockConfigProperty() is called, which must be called once for every non-NULL return.
+ *  @param filename full path of the configuration file. If set to NULL, it will attempt to generate the filename as described in the <b>Detailed Description</b> introduction.
+ *  @param dev device name.
+ *  @param property Property name, if NULL the first property of the device is returned.
+ *  @param errmsg In case of errors, store the error message in this buffer. The size of the buffer must be at least MAXRBUF.
+ *  @return the cached element of the property, or NULL if the file or the property do not exist. The cache is not locked on NULL.
+ */
+extern XMLEle *IULockConfigProperty(const char *filename, const char *dev, const char *property, char errmsg[]);
+
+/** @brief Release the cache locked by IULockConfigProperty().
+ *  @param filename full path of the configuration file, as passed to IULockConfigProperty().
+ *  @param dev device name, as passed to IULockConfigProperty().
+ *  @param modified If 1, the element was edited. The document is written back to disk once it stays unchanged for a second.
+ */
+extern void IUUnlockConfigProperty(const char *filename, const char *dev, int modified);
+
+/** @brief Write pending edits of the cached configuration document to disk immediately.
+ *  @param filename full path of the configuration file. If set to NULL, it will attempt to generate the filename as described in the <b>Detailed Description</b> introduction.
+ *  @param dev device name.
+ *  @param errmsg In case of errors, store the error message in this buffer. The size of the buffer must be at least MAXRBUF.
+ *  @return 0 on success or if there was nothing to write, -1 on failure.
+ */
+extern int IUFlushConfig(const char *filename, const char *dev, char errmsg[]);
+
+/** @brief Write pending edits of every cached configuration document to disk immediately.
+ *  Called when the driver stops.
+ */
+extern void IUFlushAllConfig(void);
+
+/** @brief Open a temporary file to write a complete configuration to.
+ *  The configuration file is only replaced once IUCommitConfigFP() is called, so readers never see a partially written file.
+ *  @param filename full path of the configuration file. If set to NULL, it will attempt to generate the filename as described in the <b>Detailed Description</b> introduction.
+ *  @param dev device name.
+ *  @param tempname Receives the name of the temporary file. The size of the buffer must be at least MAXRBUF.
+ *  @param errmsg In case of errors, store the error message in this buffer. The size of the buffer must be at least MAXRBUF.
+ *  @return pointer to FILE if the temporary file was created, otherwise NULL and errmsg is set.
+ */
+extern FILE *IUGetConfigTempFP(const char *filename, const char *dev, char tempname[], char errmsg[]);
+
+/** @brief Close a file opened with IUGetConfigTempFP() and atomically rename it over the configuration file.
+ *  Pending edits of the cached document are discarded.
+ *  @param fp file returned by IUGetConfigTempFP(), it is closed in all cases.
+ *  @param tempname temporary file name returned by IUGetConfigTempFP().
+ *  @param filename full path of the configuration file, as passed to IUGetConfigTempFP().
+ *  @param dev device name, as passed to IUGetConfigTempFP().
+ *  @param errmsg In case of errors, store the error message in this buffer. The size of the buffer must be at least MAXRBUF.
+ *  @return 0 on success, -1 on failure.
+ */
+extern int IUCommitConfigFP(FILE *fp, const char *tempname, const char *filename, const char *dev, char errmsg[]);
+
 /** @brief Copies an existing configuration file into a default configuration file.
  *  If no <i>default</i> configuration file for the supplied <i>dev</i> exists, it gets created and its contentes copied from an exiting source configuration file.
  *  Usually, when the user saves the configuration file of a driver for the first time, IUSaveDefaultConfig is called to create the default
@@ -31,8 +31,10 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110 - 1301  USA
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/un.h>
+#include <sys/uio.h>
 #include <errno.h>
 #include <pthread.h>
+#include <time.h>
 
 #include "indidriver.h"
 #include "sharedblob.h"
@@ -54,6 +56,21 @@ static void driverio_flush(driverio * dio, const void * additional, size_t add_s
 
 static pthread_mutex_t stdout_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+/* Where messages go, see driverio_set_fd() */
+static int driverio_fd = 1;
+static FILE *driverio_file = NULL;
+static int driverio_hosted = 0;
+static int driverio_is_unix = -1;
+
+/* The connection to indiserver is broken. A driver process just exits, a driver module
+ * shuts the connection down so its event loop reads EOF and returns. */
+void driverio_abort(void)
+{
+    if (!driverio_hosted)
+        exit(1);
+    shutdown(driverio_fd, SHUT_RDWR);
+}
+
 /* Return the buffer size required for storage (rounded to next OUTPUTBUFF_ALLOC) */
 static unsigned int outBuffRequired(unsigned int storage)
 {
@@ -79,7 +96,7 @@ static ssize_t driverio_write(void *user, const void * ptr, size_t count)
 {
     struct driverio * dio = (struct driverio*) user;
 
-    if (dio->outPos + count > OUTPUTBUFF_FLUSH_THRESOLD)
+    if (!dio->queued && dio->outPos + count > OUTPUTBUFF_FLUSH_THRESOLD)
     {
         driverio_flush(dio, ptr, count);
     }
@@ -158,7 +175,8 @@ static void driverio_flush(driverio * dio, const void * additional, size_t add_s
             {
                 errno = EMSGSIZE;
                 perror("sendmsg");
-                exit(1);
+                driverio_abort();
+                fdCount = MAXFD_PER_MESSAGE;
             }
 
             cmsghdrlength = CMSG_SPACE((fdCount * sizeof(int)));
@@ -221,18 +239,18 @@ static void driverio_flush(driverio * dio, const void * additional, size_t add_s
             dio->locked = 1;
         }
 
-        ret = sendmsg(1, &msgh, 0);
+        ret = sendmsg(driverio_fd, &msgh, 0);
         if (ret == -1)
         {
             perror("sendmsg");
             // FIXME: exiting the driver seems abrupt. Is this the right thing to do ? what about cleanup ?
-            exit(1);
+            driverio_abort();
         }
         else if ((unsigned)ret != dio->outPos + add_size)
         {
             // This is not expected on blocking socket
             fprintf(stderr, "short write\n");
-            exit(1);
+            driverio_abort();
         }
 
         if (fdCount > 0)
@@ -270,8 +288,6 @@ static void driverio_flush(driverio * dio, const void * additional, size_t add_s
 }
 
 
-static int driverio_is_unix = -1;
-
 static int is_unix_io()
 {
 #ifndef ENABLE_INDI_SHARED_MEMORY
@@ -286,7 +302,7 @@ static int is_unix_io()
     int domain;
     socklen_t result = sizeof(domain);
 
-    if (getsockopt(1, SOL_SOCKET, SO_DOMAIN, (void*)&domain, &result) == -1)
+    if (getsockopt(driverio_fd, SOL_SOCKET, SO_DOMAIN, (void*)&domain, &result) == -1)
     {
         driverio_is_unix = 0;
     }
@@ -302,7 +318,7 @@ static int is_unix_io()
     struct sockaddr_un sockName;
     socklen_t sockNameLen = sizeof(sockName);
 
-    if (getsockname(1, (struct sockaddr*)&sockName, &sockNameLen) == -1)
+    if (getsockname(driverio_fd, (struct sockaddr*)&sockName, &sockNameLen) == -1)
     {
         driverio_is_unix = 0;
     }
@@ -328,6 +344,7 @@ static void driverio_init_unix(driverio * dio)
     dio->joins = NULL;
     dio->joinSizes = NULL;
     dio->locked = 0;
+    dio->queued = 0;
     dio->joinCount = 0;
     dio->outBuff = NULL;
     dio->outPos = 0;
@@ -346,20 +363,578 @@ static void driverio_finish_unix(driverio * dio)
 static void driverio_init_stdout(driverio * dio)
 {
     dio->userio = *userio_file();
-    dio->user = stdout;
+    dio->queued = 0;
     pthread_mutex_lock(&stdout_mutex);
+    dio->user = driverio_file ? driverio_file : stdout;
 }
 
 static void driverio_finish_stdout(driverio * dio)
 {
-    (void)dio;
-    fflush(stdout);
+    if (fflush((FILE *)dio->user) != 0 && driverio_hosted)
+        driverio_abort();
+    pthread_mutex_unlock(&stdout_mutex);
+}
+
+/* Optional output queue, see IDOutputQueueEnable(). Messages are serialized by the thread sending them,
+ * then a writer thread sends them to indiserver in the order they were queued. */
+
+/* Bytes queued before senders wait, unless given */
+#define OUTPUTQUEUE_DEFAULT_BYTES (16 * 1024 * 1024)
+
+/* Buckets of the index of the set*Vector messages a newer one can replace */
+#define OUTPUTQUEUE_BUCKETS 256
+
+/* Messages sent with one sendmsg() */
+#define OUTPUTQUEUE_IOV 64
+
+typedef struct OutputMessage
+{
+    struct OutputMessage * prev;
+    struct OutputMessage * next;
+    /* next in its bucket of the index */
+    struct OutputMessage * hnext;
+    char * xml;
+    size_t len;
+    /* duplicates of the descriptors of the attached BLOBs, closed once sent */
+    int * fds;
+    int fdCount;
+    /* property of a set*Vector that a newer one replaces, in xml, or NULL */
+    const char * device;
+    size_t deviceLen;
+    const char * name;
+    size_t nameLen;
+    unsigned int hash;
+} OutputMessage;
+
+static struct
+{
+    pthread_mutex_t mutex;
+    /* the writer waits for messages, the senders for room */
+    pthread_cond_t queued;
+    pthread_cond_t sent;
+    /* waiting to be sent, oldest first */
+    OutputMessage * first;
+    OutputMessage * last;
+    OutputMessage * index[OUTPUTQUEUE_BUCKETS];
+    /* bytes of the messages waiting, senders wait once they would exceed maxBytes */
+    size_t waitingBytes;
+    size_t maxBytes;
+    int enabled;
+    /* the connection failed, nothing more is sent */
+    int broken;
+    pthread_t writer;
+    IDOutputQueueStats stats;
+} output_queue =
+{
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .queued = PTHREAD_COND_INITIALIZER,
+    .sent = PTHREAD_COND_INITIALIZER
+};
+
+static pthread_once_t output_queue_once = PTHREAD_ONCE_INIT;
+
+static int output_queue_enabled(void)
+{
+    return __atomic_load_n(&output_queue.enabled, __ATOMIC_ACQUIRE);
+}
+
+static double output_queue_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void output_message_free(OutputMessage * m)
+{
+    for (int i = 0; i < m->fdCount; ++i)
+    {
+        close(m->fds[i]);
+    }
+    free(m->fds);
+    free(m->xml);
+    free(m);
+}
+
+/* Find the value of the attribute attr=' in the start tag [p, end) */
+static const char * output_attribute(const char * p, const char * end, const char * attr, size_t * len)
+{
+    size_t n = strlen(attr);
+
+    for (p++; p + n <= end; p++)
+    {
+        if ((p[-1] == ' ' || p[-1] == '\n' || p[-1] == '\t') && memcmp(p, attr, n) == 0)
+        {
+            const char * value = p + n;
+            const char * quote = memchr(value, '\'', end - value);
+            if (quote == NULL)
+                return NULL;
+            *len = quote - value;
+            return value;
+        }
+    }
+    return NULL;
+}
+
+/* Index a set*Vector a newer one can replace: one that neither attaches a BLOB nor carries a message */
+static void output_message_index(OutputMessage * m)
+{
+    static const char * const tags[] = { "<setNumberVector", "<setSwitchVector", "<setTextVector", "<setLightVector" };
+    const char * p = m->xml;
+    const char * end = m->xml + m->len;
+    size_t i, n;
+
+    /* skip <?xml version='1.0'?> */
+    if (m->len > 1 && p[0] == '<' && p[1] == '?')
+    {
+        p = memchr(p, '>', end - p);
+        if (p == NULL)
+            return;
+        while (p < end && *p != '<')
+            p++;
+    }
+
+    for (i = 0; i < sizeof(tags) / sizeof(tags[0]); i++)
+    {
+        n = strlen(tags[i]);
+        if ((size_t)(end - p) > n && memcmp(p, tags[i], n) == 0 && (p[n] == ' ' || p[n] == '\n' || p[n] == '\t'))
+            break;
+    }
+    if (i == sizeof(tags) / sizeof(tags[0]))
+        return;
+
+    /* and nothing follows it, like the pingRequest of a BLOB */
+    while (end > p && (end[-1] == '\n' || end[-1] == ' ' || end[-1] == '\t'))
+        end--;
+    if ((size_t)(end - p) < 2 * n + 2 || memcmp(end - n - 2, "</", 2) != 0 || memcmp(end - n, tags[i] + 1, n - 1) != 0 ||
+            end[-1] != '>')
+        return;
+
+    /* values are escaped, the first > ends the start tag */
+    end = memchr(p, '>', end - p);
+    if (end == NULL || output_attribute(p, end, "message='", &n) != NULL)
+        return;
+
+    m->device = output_attribute(p, end, "device='", &m->deviceLen);
+    m->name = output_attribute(p, end, "name='", &m->nameLen);
+    if (m->device == NULL || m->name == NULL)
+    {
+        m->name = NULL;
+        return;
+    }
+
+    /* FNV-1a */
+    m->hash = 2166136261u;
+    for (i = 0; i < m->deviceLen; i++)
+        m->hash = (m->hash ^ (unsigned char)m->device[i]) * 16777619u;
+    m->hash = (m->hash ^ '\'') * 16777619u;
+    for (i = 0; i < m->nameLen; i++)
+        m->hash = (m->hash ^ (unsigned char)m->name[i]) * 16777619u;
+}
+
+/* Where the waiting message for the property of m is linked in the index, NULL if none. Under the mutex */
+static OutputMessage ** output_queue_find(const OutputMessage * m)
+{
+    OutputMessage ** pp;
+
+    for (pp = &output_queue.index[m->hash % OUTPUTQUEUE_BUCKETS]; *pp != NULL; pp = &(*pp)->hnext)
+    {
+        const OutputMessage * o = *pp;
+        if (o->hash == m->hash && o->deviceLen == m->deviceLen && o->nameLen == m->nameLen &&
+                memcmp(o->device, m->device, m->deviceLen) == 0 && memcmp(o->name, m->name, m->nameLen) == 0)
+            return pp;
+    }
+    return NULL;
+}
+
+/* Take the message serialized in dio, wait only if the queue is full */
+static void output_queue_push(driverio * dio)
+{
+    OutputMessage * m = (OutputMessage *)calloc(1, sizeof(OutputMessage));
+    OutputMessage ** older = NULL;
+    double stalled = 0;
+
+    if (m == NULL)
+    {
+        perror("malloc");
+        _exit(1);
+    }
+    m->xml = dio->outBuff;
+    m->len = dio->outPos;
+    dio->outBuff = NULL;
+    dio->outPos = 0;
+
+    if (dio->joinCount > 0)
+    {
+        m->fds = (int *)malloc(sizeof(int) * dio->joinCount);
+        m->fdCount = dio->joinCount;
+        for (int i = 0; i < dio->joinCount; ++i)
+        {
+            int fd = IDSharedBlobGetFd(dio->joins[i]);
+            if (fd == -1)
+            {
+                // Can't avoid a copy here, the driver may reuse its buffer once this returns
+                void * copy = IDSharedBlobAlloc(dio->joinSizes[i]);
+                memcpy(copy, dio->joins[i], dio->joinSizes[i]);
+                m->fds[i] = dup(IDSharedBlobGetFd(copy));
+                IDSharedBlobFree(copy);
+            }
+            else
+            {
+                // The driver may free the blob once this returns
+                m->fds[i] = dup(fd);
+            }
+        }
+    }
+    else
+    {
+        output_message_index(m);
+    }
+
+    free(dio->joins);
+    dio->joins = NULL;
+    free(dio->joinSizes);
+    dio->joinSizes = NULL;
+    dio->joinCount = 0;
+
+    if (m->len == 0)
+    {
+        output_message_free(m);
+        return;
+    }
+
+    pthread_mutex_lock(&output_queue.mutex);
+    while (!output_queue.broken)
+    {
+        size_t waiting = output_queue.waitingBytes;
+
+        older = m->name != NULL ? output_queue_find(m) : NULL;
+        if (older != NULL)
+            waiting -= (*older)->len;
+
+        /* one message larger than the queue still goes */
+        if (waiting == 0 || waiting + m->len <= output_queue.maxBytes)
+            break;
+
+        if (stalled == 0)
+            stalled = output_queue_now();
+        pthread_cond_wait(&output_queue.sent, &output_queue.mutex);
+    }
+    if (stalled != 0)
+        output_queue.stats.stallSeconds += output_queue_now() - stalled;
+
+    if (output_queue.broken)
+    {
+        pthread_mutex_unlock(&output_queue.mutex);
+        output_message_free(m);
+        return;
+    }
+
+    /* the newer value goes after what was sent since the older one, like the older one would have */
+    if (older != NULL)
+    {
+        OutputMessage * o = *older;
+        *older = o->hnext;
+        if (o->prev)
+            o->prev->next = o->next;
+        else
+            output_queue.first = o->next;
+        if (o->next)
+            o->next->prev = o->prev;
+        else
+            output_queue.last = o->prev;
+        output_queue.waitingBytes -= o->len;
+        output_queue.stats.queuedBytes -= o->len;
+        output_queue.stats.coalesced++;
+        output_message_free(o);
+    }
+
+    m->prev = output_queue.last;
+    if (output_queue.last)
+        output_queue.last->next = m;
+    else
+        output_queue.first = m;
+    output_queue.last = m;
+    if (m->name != NULL)
+    {
+        OutputMessage ** bucket = &output_queue.index[m->hash % OUTPUTQUEUE_BUCKETS];
+        m->hnext = *bucket;
+        *bucket = m;
+    }
+
+    output_queue.stats.messages++;
+    output_queue.waitingBytes += m->len;
+    output_queue.stats.queuedBytes += m->len;
+    if (output_queue.stats.queuedBytes > output_queue.stats.peakBytes)
+        output_queue.stats.peakBytes = output_queue.stats.queuedBytes;
+
+    pthread_cond_signal(&output_queue.queued);
+    pthread_mutex_unlock(&output_queue.mutex);
+}
+
+/* Send the first messages of *batch with one sendmsg(), as many as fit in OUTPUTQUEUE_IOV and
+ * MAXFD_PER_MESSAGE descriptors, and free them. Return 0 if the connection failed. */
+static int output_queue_send(OutputMessage ** batch, size_t * bytes, double * seconds)
+{
+    struct iovec iov[OUTPUTQUEUE_IOV];
+    union
+    {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(MAXFD_PER_MESSAGE * sizeof(int))];
+    } control;
+    int fds[MAXFD_PER_MESSAGE];
+    struct msghdr msgh;
+    OutputMessage * m;
+    int iovCount = 0, fdCount = 0, ok = 1;
+    size_t len = 0, sent = 0;
+    double start;
+
+    for (m = *batch; m != NULL && iovCount < OUTPUTQUEUE_IOV; m = m->next)
+    {
+        if (fdCount + m->fdCount > MAXFD_PER_MESSAGE)
+        {
+            if (iovCount > 0)
+                break;
+            errno = EMSGSIZE;
+            perror("sendmsg");
+            ok = 0;
+            break;
+        }
+        memcpy(fds + fdCount, m->fds, sizeof(int) * m->fdCount);
+        fdCount += m->fdCount;
+        iov[iovCount].iov_base = m->xml;
+        iov[iovCount].iov_len = m->len;
+        iovCount++;
+        len += m->len;
+    }
+
+    memset(&msgh, 0, sizeof(msgh));
+    msgh.msg_iov = iov;
+    msgh.msg_iovlen = iovCount;
+    if (fdCount > 0)
+    {
+        struct cmsghdr * cmsgh;
+
+        msgh.msg_control = control.buf;
+        msgh.msg_controllen = CMSG_SPACE(fdCount * sizeof(int));
+        cmsgh = CMSG_FIRSTHDR(&msgh);
+        cmsgh->cmsg_len = CMSG_LEN(fdCount * sizeof(int));
+        cmsgh->cmsg_level = SOL_SOCKET;
+        cmsgh->cmsg_type = SCM_RIGHTS;
+        memcpy(CMSG_DATA(cmsgh), fds, sizeof(int) * fdCount);
+    }
+
+    pthread_mutex_lock(&stdout_mutex);
+    start = output_queue_now();
+    while (ok && sent < len)
+    {
+        ssize_t ret = is_unix_io() ? sendmsg(driverio_fd, &msgh, 0) : writev(driverio_fd, msgh.msg_iov, msgh.msg_iovlen);
+        if (ret == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            perror(is_unix_io() ? "sendmsg" : "writev");
+            ok = 0;
+            break;
+        }
+
+        /* the descriptors went with the first bytes, carry on with the rest */
+        msgh.msg_control = NULL;
+        msgh.msg_controllen = 0;
+        sent += ret;
+        while (ret > 0)
+        {
+            if ((size_t)ret >= msgh.msg_iov->iov_len)
+            {
+                ret -= msgh.msg_iov->iov_len;
+                msgh.msg_iov++;
+                msgh.msg_iovlen--;
+            }
+            else
+            {
+                msgh.msg_iov->iov_base = (char *)msgh.msg_iov->iov_base + ret;
+                msgh.msg_iov->iov_len -= ret;
+                ret = 0;
+            }
+        }
+    }
+    *seconds = output_queue_now() - start;
+    pthread_mutex_unlock(&stdout_mutex);
+
+    while (*batch != m)
+    {
+        OutputMessage * next = (*batch)->next;
+        output_message_free(*batch);
+        *batch = next;
+    }
+    *bytes = len;
+    return ok;
+}
+
+static void * output_queue_writer(void * arg)
+{
+    (void)arg;
+
+    pthread_mutex_lock(&output_queue.mutex);
+    while (!output_queue.broken)
+    {
+        OutputMessage * batch = output_queue.first;
+
+        if (batch == NULL)
+        {
+            pthread_cond_wait(&output_queue.queued, &output_queue.mutex);
+            continue;
+        }
+
+        /* take all of them, a newer message only replaces one that is still waiting */
+        output_queue.first = NULL;
+        output_queue.last = NULL;
+        output_queue.waitingBytes = 0;
+        memset(output_queue.index, 0, sizeof(output_queue.index));
+        pthread_cond_broadcast(&output_queue.sent);
+
+        while (batch != NULL)
+        {
+            size_t bytes;
+            double seconds;
+            int ok;
+
+            pthread_mutex_unlock(&output_queue.mutex);
+            ok = output_queue_send(&batch, &bytes, &seconds);
+            pthread_mutex_lock(&output_queue.mutex);
+
+            output_queue.stats.queuedBytes -= bytes;
+            output_queue.stats.sends++;
+            output_queue.stats.writerSeconds += seconds;
+            if (!ok)
+            {
+                output_queue.broken = 1;
+                pthread_cond_broadcast(&output_queue.sent);
+                pthread_mutex_unlock(&output_queue.mutex);
+                driverio_abort();
+                pthread_mutex_lock(&output_queue.mutex);
+                break;
+            }
+            pthread_cond_broadcast(&output_queue.sent);
+        }
+
+        while (batch != NULL)
+        {
+            OutputMessage * next = batch->next;
+            output_message_free(batch);
+            batch = next;
+        }
+    }
+
+    /* drop what is left, senders do not wait for it */
+    while (output_queue.first != NULL)
+    {
+        OutputMessage * next = output_queue.first->next;
+        output_message_free(output_queue.first);
+        output_queue.first = next;
+    }
+    output_queue.last = NULL;
+    output_queue.waitingBytes = 0;
+    output_queue.stats.queuedBytes = 0;
+    pthread_cond_broadcast(&output_queue.sent);
+    pthread_mutex_unlock(&output_queue.mutex);
+    return NULL;
+}
+
+static void output_queue_init(void)
+{
+    const char * value = getenv("INDI_OUTPUT_QUEUE");
+
+    if (value != NULL)
+        IDOutputQueueEnable(strtoul(value, NULL, 10));
+}
+
+int IDOutputQueueEnable(size_t maxBytes)
+{
+    int ret = 0;
+
+    pthread_mutex_lock(&output_queue.mutex);
+    if (!output_queue.enabled)
+    {
+        output_queue.maxBytes = maxBytes > 0 ? maxBytes : OUTPUTQUEUE_DEFAULT_BYTES;
+
+        /* what the driver printed before goes first */
+        pthread_mutex_lock(&stdout_mutex);
+        fflush(driverio_file ? driverio_file : stdout);
+        pthread_mutex_unlock(&stdout_mutex);
+
+        ret = pthread_create(&output_queue.writer, NULL, output_queue_writer, NULL);
+        if (ret != 0)
+        {
+            errno = ret;
+            perror("pthread_create");
+            ret = -1;
+        }
+        else
+        {
+            pthread_detach(output_queue.writer);
+            atexit(IDOutputQueueFlush);
+            __atomic_store_n(&output_queue.enabled, 1, __ATOMIC_RELEASE);
+        }
+    }
+    pthread_mutex_unlock(&output_queue.mutex);
+    return ret;
+}
+
+void IDOutputQueueFlush(void)
+{
+    pthread_mutex_lock(&output_queue.mutex);
+    /* the writer exits the driver when the connection fails */
+    if (output_queue.enabled && !pthread_equal(pthread_self(), output_queue.writer))
+    {
+        while (output_queue.stats.queuedBytes > 0 && !output_queue.broken)
+            pthread_cond_wait(&output_queue.sent, &output_queue.mutex);
+    }
+    pthread_mutex_unlock(&output_queue.mutex);
+}
+
+void IDOutputQueueGetStats(IDOutputQueueStats * stats)
+{
+    pthread_mutex_lock(&output_queue.mutex);
+    *stats = output_queue.stats;
+    pthread_mutex_unlock(&output_queue.mutex);
+}
+
+int IDOutputQueueEnabled(void)
+{
+    pthread_once(&output_queue_once, output_queue_init);
+    return output_queue_enabled();
+}
+
+/* Serialized in a buffer of its own that the queue takes over */
+static void driverio_init_queued(driverio * dio)
+{
+    driverio_init_unix(dio);
+    if (!is_unix_io())
+    {
+        dio->userio.joinbuff = NULL;
+    }
+    dio->queued = 1;
+}
+
+void driverio_set_fd(int fd)
+{
+    pthread_mutex_lock(&stdout_mutex);
+    driverio_fd = fd;
+    driverio_file = fdopen(dup(fd), "w");
+    driverio_hosted = 1;
+    driverio_is_unix = -1;
     pthread_mutex_unlock(&stdout_mutex);
 }
 
 void driverio_init(driverio * dio)
 {
-    if (is_unix_io())
+    pthread_once(&output_queue_once, output_queue_init);
+    if (output_queue_enabled())
+    {
+        driverio_init_queued(dio);
+    }
+    else if (is_unix_io())
     {
         driverio_init_unix(dio);
     }
@@ -371,7 +946,11 @@ void driverio_init(driverio * dio)
 
 void driverio_finish(driverio * dio)
 {
-    if (is_unix_io())
+    if (dio->queued)
+    {
+        output_queue_push(dio);
+    }
+    else if (is_unix_io())
     {
         driverio_finish_unix(dio);
     }
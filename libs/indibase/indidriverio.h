@@ -32,9 +32,17 @@ typedef struct driverio
     size_t * joinSizes;
     int joinCount;
     int locked;
+    int queued;
     char * outBuff;
     unsigned int outPos;
 } driverio;
 
 void driverio_init(driverio * dio);
 void driverio_finish(driverio * dio);
+
+/* Send messages to fd instead of stdout. Used by driver modules, that run on a thread of indiserver */
+void driverio_set_fd(int fd);
+
+/* Give up on indiserver: a driver process exits, a driver module shuts its connection down
+ * so that its event loop returns without taking indiserver down with it */
+void driverio_abort(void);
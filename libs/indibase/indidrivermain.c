@@ -26,6 +26,8 @@
  * Drivers call IE*() functions to build an event-driver program.
  * Drivers call IU*() functions to perform various common utility tasks.
  * Troubles are reported on stderr then we exit.
+ * indiDriverModuleMain() does the same for a driver built as a module of indiserver,
+ * on a socket given by indiserver, and returns instead of exiting.
  *
  * This requires liblilxml.
  */
@@ -34,9 +36,12 @@
 #include "eventloop.h"
 #include "indidevapi.h"
 #include "indidriver.h"
+#include "userio.h"
+#include "indidriverio.h"
 #include "lilxml.h"
 
 #include <errno.h>
+#include <locale.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -54,6 +59,7 @@
 #define MAXRBUF 2048
 
 static void usage(void);
+static void setClockFromEnvironment(void);
 static void deferMessage(XMLEle * root);
 static void handlePingReply(XMLEle * root);
 
@@ -63,6 +69,31 @@ static LilXML *clixml = NULL;
 #define PROCEED_DEFERRED 0
 static int messageHandling = PROCEED_IMMEDIATE;
 
+/* set when running as a module of indiserver, see indiDriverModuleMain() */
+static int hosted = 0;
+static int clientFd = 0;
+static int clientCallback = -1;
+static volatile int clientGone = 0;
+
+static pthread_t eventLoopThread;
+
+/* indiserver closed the connection or it failed. A driver process exits,
+ * a driver module stops its event loop so indiDriverModuleMain() returns.
+ */
+static void clientLost(void)
+{
+    if (!hosted)
+        exit(1);
+
+    clientGone = 1;
+    /* from another thread, the event loop reads EOF as well */
+    if (pthread_equal(pthread_self(), eventLoopThread))
+    {
+        rmCallback(clientCallback);
+        breakEventLoop();
+    }
+}
+
 
 /* callback when INDI client message arrives on stdin.
  * collect and dispatch when see outer element closure.
@@ -88,12 +119,14 @@ static void clientMsgCB(int fd, void *arg)
             return;
         }
         fprintf(stderr, "%s: %s\n", me, strerror(errno));
-        exit(1);
+        clientLost();
+        return;
     }
     if (nr == 0)
     {
         fprintf(stderr, "%s: EOF\n", me);
-        exit(1);
+        clientLost();
+        return;
     }
 
     /* crack and dispatch when complete */
@@ -184,7 +217,6 @@ typedef struct PingReply
     char uid[MAX_PING_UID_LEN + 1];
 } PingReply;
 
-static pthread_t eventLoopThread;
 static PingReply * firstReceivedPing = NULL;
 static PingReply * lastReceivedPing = NULL;
 static pthread_mutex_t pingReplyMutex = PTHREAD_MUTEX_INITIALIZER;
@@ -254,12 +286,12 @@ static void waitPingReplyFromEventLoopThread(const char * uid) {
 }
 
 static void waitPingReplyFromOtherThread(const char * uid) {
-    int fd = 0;
+    int fd = clientFd;
     fd_set rfd;
 
     messageHandling = PROCEED_DEFERRED;
     pthread_mutex_lock(&pingReplyMutex);
-    while(!consumePingReply(uid))
+    while(!consumePingReply(uid) && !clientGone)
     {
 
         pthread_mutex_unlock(&pingReplyMutex);
@@ -271,10 +303,11 @@ static void waitPingReplyFromOtherThread(const char * uid) {
         if (ns < 0)
         {
             perror("select");
-            exit(1);
+            /* a driver module must not exit indiserver, it gives up waiting instead */
+            clientLost();
         }
-
-        clientMsgCB(0, NULL);
+        else
+            clientMsgCB(fd, NULL);
 
         pthread_mutex_lock(&pingReplyMutex);
     }
@@ -333,8 +366,9 @@ int main(int ac, char *av[])
         usage();
 
     /* init */
+    setClockFromEnvironment();
     clixml = newLilXML();
-    addCallback(0, clientMsgCB, clixml);
+    clientCallback = addCallback(0, clientMsgCB, clixml);
 
     /* service client */
     eventLoop();
@@ -344,6 +378,92 @@ int main(int ac, char *av[])
     return (1);
 }
 
+int indiDriverModuleMain(int fd, const char *name, char *const env[])
+{
+    int i;
+
+    /* the globals of the driver were only initialized when indiserver loaded it, which
+     * starts a restarted driver as a process instead */
+    if (hosted)
+    {
+        fprintf(stderr, "%s: driver module already ran\n", name);
+        return 1;
+    }
+
+    /* the libc of the module is ours alone. It did not set up this thread,
+     * which indiserver created: give it the locale tables ctype.h reads. */
+    uselocale(LC_GLOBAL_LOCALE);
+
+    /* and its environment is ours too */
+    clearenv();
+    for (i = 0; env[i] != NULL; i++)
+        putenv(strdup(env[i]));
+
+    hosted = 1;
+    clientFd = fd;
+    eventLoopThread = pthread_self();
+    me = strdup(name);
+    driverio_set_fd(fd);
+
+    /* init */
+    setClockFromEnvironment();
+    clixml = newLilXML();
+    clientCallback = addCallback(fd, clientMsgCB, clixml);
+
+    /* service client until indiserver closes the connection */
+    eventLoop();
+
+    IDOutputQueueFlush();
+    IUFlushAllConfig();
+    return 0;
+}
+
+/* run the timers on the clock INDI_CLOCK selects for this driver, see IESetClock() */
+static void setClockFromEnvironment(void)
+{
+    const char *entry = getenv("INDI_CLOCK");
+    char mode[32] = "";
+    int named = 0;
+
+    if (entry == NULL)
+        return;
+
+    /* a mode for this driver by name wins over one for every driver */
+    while (*entry)
+    {
+        size_t len = strcspn(entry, ",");
+        const char *equal = memchr(entry, '=', len);
+
+        if (equal == NULL && !named)
+            snprintf(mode, sizeof(mode), "%.*s", (int)len, entry);
+        else if (equal != NULL && (size_t)(equal - entry) == strlen(me) && !strncmp(entry, me, equal - entry))
+        {
+            snprintf(mode, sizeof(mode), "%.*s", (int)(len - (equal + 1 - entry)), equal + 1);
+            named = 1;
+        }
+
+        entry += len;
+        if (*entry == ',')
+            entry++;
+    }
+
+    if (mode[0] == '\0' || !strcmp(mode, "realtime"))
+        return;
+
+    if (!strcmp(mode, "stepped"))
+    {
+        IESetClock(IE_CLOCK_STEPPED, 1);
+        fprintf(stderr, "%s: timers run on a stepped clock\n", me);
+    }
+    else if (mode[0] == 'x' && atof(mode + 1) > 0)
+    {
+        IESetClock(IE_CLOCK_ACCELERATED, atof(mode + 1));
+        fprintf(stderr, "%s: timers run on a clock %g times faster than real time\n", me, atof(mode + 1));
+    }
+    else
+        fprintf(stderr, "%s: unknown clock '%s' in INDI_CLOCK, using the clock of the system\n", me, mode);
+}
+
 /* print usage message and exit (1) */
 static void usage(void)
 {
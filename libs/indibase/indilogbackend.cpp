@@ -0,0 +1,296 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+#include "indilogbackend.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+// Longest time a message waits when the wake up of the writer was missed
+#define WRITER_IDLE_MS 100
+// Bytes formatted without a second attempt
+#define FORMAT_RESERVE 256
+
+namespace INDI
+{
+
+LogBackend::LogBackend(Sink *sink, size_t capacity) : m_Sink(sink)
+{
+    size_t size = 2;
+    while (size < capacity)
+        size *= 2;
+    m_Slots.reset(new Slot[size]);
+    m_Mask = size - 1;
+    for (size_t i = 0; i < size; i++)
+        m_Slots[i].sequence.store(i, std::memory_order_relaxed);
+
+    m_LastRefill = std::chrono::steady_clock::now();
+    m_Thread = std::thread(&LogBackend::writerLoop, this);
+}
+
+LogBackend::~LogBackend()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Lock);
+        m_Stop = true;
+        m_Wake.notify_one();
+    }
+    m_Thread.join();
+}
+
+void LogBackend::push(const char *device, unsigned int level, bool file, bool screen, const char *format, va_list ap)
+{
+    // Bounded MPMC queue from Dmitry Vyukov, a slot is ours once its sequence matches the position claimed
+    uint64_t position = m_Head.load(std::memory_order_relaxed);
+    Slot *slot;
+    for (;;)
+    {
+        slot = &m_Slots[position & m_Mask];
+        uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+        int64_t difference = static_cast<int64_t>(sequence - position);
+        if (difference == 0)
+        {
+            if (m_Head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (difference < 0)
+        {
+            // Full, the caller must not wait for the log
+            m_Dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        else
+            position = m_Head.load(std::memory_order_relaxed);
+    }
+
+    Record &record = slot->record;
+    gettimeofday(&record.time, nullptr);
+    record.level  = level;
+    record.file   = file;
+    record.screen = screen;
+    strncpy(record.device, device ? device : "", MAXINDIDEVICE - 1);
+    record.device[MAXINDIDEVICE - 1] = '\0';
+
+    // The string keeps the capacity of earlier messages, only longer ones allocate
+    va_list copy;
+    va_copy(copy, ap);
+    size_t capacity = std::max<size_t>(record.text.capacity(), FORMAT_RESERVE);
+    record.text.resize(capacity);
+    int length = vsnprintf(&record.text[0], capacity + 1, format, ap);
+    if (length > static_cast<int>(capacity))
+    {
+        record.text.resize(length);
+        vsnprintf(&record.text[0], length + 1, format, copy);
+    }
+    va_end(copy);
+    record.text.resize(std::max(length, 0));
+
+    slot->sequence.store(position + 1, std::memory_order_release);
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_Sleeping.load(std::memory_order_relaxed))
+    {
+        std::lock_guard<std::mutex> lock(m_Lock);
+        m_Wake.notify_one();
+    }
+
+    if (m_Synchronous)
+        flush();
+}
+
+void LogBackend::flush()
+{
+    // The sink may log from the writer thread, which must not wait for itself
+    if (std::this_thread::get_id() == m_Thread.get_id())
+        return;
+
+    uint64_t target = m_Head.load(std::memory_order_acquire);
+    std::unique_lock<std::mutex> lock(m_Lock);
+    m_FlushRequested = true;
+    m_Wake.notify_one();
+    m_Flushed.wait(lock, [&] { return (m_Processed >= target && !m_FlushRequested) || m_Stop; });
+}
+
+void LogBackend::setRateLimit(double perSecond, unsigned int burst, unsigned int exemptLevels)
+{
+    std::lock_guard<std::mutex> lock(m_Lock);
+    m_NewLimits.rate = perSecond;
+    m_NewLimits.burst = burst;
+    m_NewLimits.exemptLevels = exemptLevels;
+}
+
+void LogBackend::setCoalesceWindow(std::chrono::milliseconds window)
+{
+    std::lock_guard<std::mutex> lock(m_Lock);
+    m_NewLimits.coalesceWindow = window;
+}
+
+LogBackend::Statistics LogBackend::statistics() const
+{
+    std::lock_guard<std::mutex> lock(m_Lock);
+    Statistics statistics = m_Statistics;
+    statistics.dropped = m_Dropped.load(std::memory_order_relaxed);
+    return statistics;
+}
+
+bool LogBackend::empty() const
+{
+    return m_Slots[m_Tail & m_Mask].sequence.load(std::memory_order_acquire) != m_Tail + 1;
+}
+
+void LogBackend::writerLoop()
+{
+    std::unique_lock<std::mutex> lock(m_Lock);
+    for (;;)
+    {
+        bool force = m_FlushRequested;
+        if (m_Limits.rate != m_NewLimits.rate || m_Limits.burst != m_NewLimits.burst)
+            m_Tokens = m_NewLimits.burst;
+        m_Limits = m_NewLimits;
+        lock.unlock();
+
+        uint64_t count = 0;
+        while (!empty())
+        {
+            Slot &slot = m_Slots[m_Tail & m_Mask];
+            process(slot.record);
+            slot.sequence.store(m_Tail + m_Mask + 1, std::memory_order_release);
+            m_Tail++;
+            count++;
+        }
+        m_Counters.messages += count;
+        summarize(force);
+        if (count > 0 || force)
+            m_Sink->flush();
+
+        lock.lock();
+        m_Processed += count;
+        m_Statistics = m_Counters;
+        if (force)
+            m_FlushRequested = false;
+        m_Flushed.notify_all();
+
+        if (m_Stop && empty())
+            break;
+
+        if (!m_FlushRequested && !m_Stop)
+        {
+            m_Sleeping.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (empty())
+                m_Wake.wait_for(lock, std::chrono::milliseconds(WRITER_IDLE_MS));
+            m_Sleeping.store(false, std::memory_order_relaxed);
+        }
+    }
+}
+
+void LogBackend::process(const Record &record)
+{
+    if (record.file)
+        m_Sink->write(record);
+
+    if (!record.screen)
+        return;
+
+    // Identical to the previous message, only counted
+    if (record.level == m_LastLevel && m_LastDevice == record.device && m_LastText == record.text)
+    {
+        m_Repeats++;
+        m_LastRepeat = std::chrono::steady_clock::now();
+        m_Counters.coalesced++;
+        return;
+    }
+
+    reportRepeats(true);
+
+    if ((record.level & m_Limits.exemptLevels) == 0 && !takeToken())
+    {
+        m_Limited++;
+        m_LimitedDevice = record.device;
+        m_LimitedLevel = record.level;
+        m_Counters.limited++;
+        return;
+    }
+
+    reportLimited();
+    m_LastDevice = record.device;
+    m_LastLevel  = record.level;
+    m_LastText   = record.text;
+    m_Sink->message(record.device, record.level, record.text.c_str());
+}
+
+bool LogBackend::takeToken()
+{
+    if (m_Limits.rate <= 0)
+        return true;
+
+    auto now = std::chrono::steady_clock::now();
+    m_Tokens = std::min(m_Limits.burst, m_Tokens + std::chrono::duration<double>(now - m_LastRefill).count() * m_Limits.rate);
+    m_LastRefill = now;
+    if (m_Tokens < 1)
+        return false;
+    m_Tokens -= 1;
+    return true;
+}
+
+void LogBackend::reportRepeats(bool force)
+{
+    if (m_Repeats == 0 || (!force && std::chrono::steady_clock::now() - m_LastRepeat < m_Limits.coalesceWindow))
+        return;
+
+    std::string summary = "last message repeated " + std::to_string(m_Repeats) + " times";
+    m_Repeats = 0;
+    m_Sink->message(m_LastDevice.c_str(), m_LastLevel, summary.c_str());
+    // So the next copy is sent again
+    m_LastText.clear();
+}
+
+void LogBackend::reportLimited()
+{
+    if (m_Limited == 0)
+        return;
+
+    std::string summary = std::to_string(m_Limited) +
+                          " messages were not sent to the client to limit the rate, see the log file";
+    m_Limited = 0;
+    m_Sink->message(m_LimitedDevice.c_str(), m_LimitedLevel, summary.c_str());
+}
+
+void LogBackend::summarize(bool force)
+{
+    reportRepeats(force);
+
+    // Once the rate allows it again
+    if (m_Limited > 0 && (force || takeToken()))
+        reportLimited();
+
+    uint64_t dropped = m_Dropped.load(std::memory_order_relaxed);
+    if (dropped != m_DroppedReported)
+    {
+        Record record;
+        gettimeofday(&record.time, nullptr);
+        record.level = m_LastLevel;
+        record.file = record.screen = true;
+        strncpy(record.device, m_LastDevice.c_str(), MAXINDIDEVICE - 1);
+        record.text = std::to_string(dropped - m_DroppedReported) + " log messages were dropped, the log queue was full";
+        m_DroppedReported = dropped;
+        m_Sink->write(record);
+        m_Sink->message(record.device, record.level, record.text.c_str());
+    }
+}
+
+}
@@ -0,0 +1,179 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+#pragma once
+
+#include "indiapi.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/time.h>
+
+namespace INDI
+{
+
+/**
+ * @brief The LogBackend class takes log messages from any thread without locking and hands them
+ * to a Sink from a dedicated writer thread.
+ *
+ * Messages are formatted straight into the slots of a bounded ring, whose strings keep their
+ * capacity so a steady stream of messages does not allocate. When the ring is full, messages are
+ * dropped and counted rather than blocking the caller. The writer flushes the file once per batch.
+ * Before reaching the client, identical consecutive messages are coalesced and messages of levels
+ * not exempted by setRateLimit() are rate limited; the file gets every message.
+ */
+class LogBackend
+{
+    public:
+        struct Record
+        {
+            struct timeval time;
+            unsigned int level {0};
+            bool file {false};
+            bool screen {false};
+            char device[MAXINDIDEVICE] {""};
+            std::string text;
+        };
+
+        class Sink
+        {
+            public:
+                virtual ~Sink() = default;
+                /** @brief Append a record to the log file */
+                virtual void write(const Record &record) = 0;
+                /** @brief End of a batch of records */
+                virtual void flush() = 0;
+                /** @brief Send a message to the client */
+                virtual void message(const char *device, unsigned int level, const char *text) = 0;
+        };
+
+        struct Statistics
+        {
+            uint64_t messages {0};
+            /** Dropped because the ring was full */
+            uint64_t dropped {0};
+            /** Not sent to the client because identical to the previous message */
+            uint64_t coalesced {0};
+            /** Not sent to the client because of the rate limit */
+            uint64_t limited {0};
+        };
+
+    public:
+        /** @param capacity number of slots, rounded up to a power of two */
+        explicit LogBackend(Sink *sink, size_t capacity = 4096);
+        ~LogBackend();
+
+        LogBackend(const LogBackend &) = delete;
+        LogBackend &operator=(const LogBackend &) = delete;
+
+        /** @brief Queue a message, never blocks unless synchronous. */
+        void push(const char *device, unsigned int level, bool file, bool screen, const char *format, va_list ap);
+
+        /** @brief Wait until every message queued so far reached the sink. */
+        void flush();
+
+        /** @brief Make push() wait for the message to be written, e.g. to debug a crash */
+        void setSynchronous(bool enabled)
+        {
+            m_Synchronous = enabled;
+        }
+
+        /**
+         * @brief Limit the messages sent to the client.
+         * @param perSecond sustained rate, 0 for no limit.
+         * @param burst messages allowed at once.
+         * @param exemptLevels levels that are never limited.
+         */
+        void setRateLimit(double perSecond, unsigned int burst, unsigned int exemptLevels);
+
+        /** @brief A run of identical messages is summarized once it is that old */
+        void setCoalesceWindow(std::chrono::milliseconds window);
+
+        Statistics statistics() const;
+
+    private:
+        struct Limits
+        {
+            double rate {0};
+            double burst {0};
+            unsigned int exemptLevels {0};
+            std::chrono::milliseconds coalesceWindow {1000};
+        };
+
+        struct Slot
+        {
+            std::atomic<uint64_t> sequence {0};
+            Record record;
+        };
+
+        void writerLoop();
+        bool empty() const;
+        void process(const Record &record);
+        bool takeToken();
+        void reportRepeats(bool force);
+        void reportLimited();
+        void summarize(bool force);
+
+    private:
+        Sink *m_Sink;
+        std::unique_ptr<Slot[]> m_Slots;
+        size_t m_Mask;
+
+        // Claimed by producers, the writer owns m_Tail
+        alignas(64) std::atomic<uint64_t> m_Head {0};
+        alignas(64) uint64_t m_Tail {0};
+        std::atomic<uint64_t> m_Dropped {0};
+        std::atomic<bool> m_Sleeping {false};
+        std::atomic<bool> m_Synchronous {false};
+
+        // Guards the wake ups and everything below
+        mutable std::mutex m_Lock;
+        std::condition_variable m_Wake;
+        std::condition_variable m_Flushed;
+        uint64_t m_Processed {0};
+        bool m_FlushRequested {false};
+        bool m_Stop {false};
+        Statistics m_Statistics;
+        Limits m_NewLimits;
+
+        // Writer thread only
+        std::string m_LastDevice;
+        unsigned int m_LastLevel {0};
+        std::string m_LastText;
+        uint64_t m_Repeats {0};
+        std::chrono::steady_clock::time_point m_LastRepeat;
+        uint64_t m_DroppedReported {0};
+        uint64_t m_Limited {0};
+        std::string m_LimitedDevice;
+        unsigned int m_LimitedLevel {0};
+        Statistics m_Counters;
+        Limits m_Limits;
+        double m_Tokens {0};
+        std::chrono::steady_clock::time_point m_LastRefill;
+
+        std::thread m_Thread;
+};
+
+}
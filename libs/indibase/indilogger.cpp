@@ -19,8 +19,11 @@
 *******************************************************************************/
 
 #include "indilogger.h"
+#include "indilogbackend.h"
 #include "indiutility.h"
+#include "indidriver.h"
 
+#include <algorithm>
 #include <dirent.h>
 #include <cerrno>
 #include <iostream>
@@ -28,6 +31,10 @@
 #include <cstring>
 #include <sys/stat.h>
 
+// Messages sent to the client per second once the burst is spent, errors and warnings are always sent
+#define SCREEN_RATE  100
+#define SCREEN_BURST 200
+
 namespace INDI
 {
 char Logger::Tags[Logger::nlevels][MAXINDINAME] = { "ERROR",       "WARNING",     "INFO",        "DEBUG",
@@ -275,9 +282,51 @@ void Logger::unlock()
 }
 #endif
 
+class Logger::Sink : public LogBackend::Sink
+{
+    public:
+        explicit Sink(Logger *logger) : m_Logger(logger) {}
+
+        void write(const LogBackend::Record &record) override
+        {
+            std::lock_guard<std::mutex> lock(m_Logger->fileLock_);
+            if (!m_Logger->out_.is_open())
+                return;
+
+            struct timeval resTime;
+            char prefix[MAXINDINAME + 64];
+            timersub(&record.time, &m_Logger->initialTime_, &resTime);
+            snprintf(prefix, sizeof(prefix), "%s\t%ld.%06ld sec\t: ", Tags[rank(record.level)],
+                     static_cast<long>(resTime.tv_sec), static_cast<long>(resTime.tv_usec));
+            m_Logger->out_ << prefix;
+            if (nDevices != 1)
+                m_Logger->out_ << "[" << record.device << "] ";
+            m_Logger->out_ << record.text << '\n';
+        }
+
+        void flush() override
+        {
+            std::lock_guard<std::mutex> lock(m_Logger->fileLock_);
+            m_Logger->out_.flush();
+        }
+
+        void message(const char *device, unsigned int level, const char *text) override
+        {
+            IDMessage(device, "[%s] %s", Tags[rank(level)], text);
+        }
+
+    private:
+        Logger *m_Logger;
+};
+
 Logger::Logger() : configured_(false)
 {
     gettimeofday(&initialTime_, nullptr);
+
+    sink_.reset(new Sink(this));
+    backend_.reset(new LogBackend(sink_.get()));
+    backend_->setRateLimit(SCREEN_RATE, SCREEN_BURST, DBG_ERROR | DBG_WARNING);
+    backend_->setSynchronous(getenv("INDI_LOG_SYNC") != nullptr);
 }
 
 void Logger::configure(const std::string &outputFile, const loggerConf configuration, const int fileVerbosityLevel,
@@ -285,6 +334,10 @@ void Logger::configure(const std::string &outputFile, const loggerConf configura
 {
     Logger::lock();
 
+    // Messages printed so far go to the old file
+    backend_->flush();
+    std::lock_guard<std::mutex> fileLock(fileLock_);
+
     fileVerbosityLevel_   = fileVerbosityLevel;
     screenVerbosityLevel_ = screenVerbosityLevel;
     rememberscreenlevel_  = screenVerbosityLevel_;
@@ -329,6 +382,8 @@ void Logger::configure(const std::string &outputFile, const loggerConf configura
 Logger::~Logger()
 {
     Logger::lock();
+    // Writes what is left
+    backend_.reset();
     if (configuration_ & file_on)
         out_.close();
 
@@ -340,11 +395,26 @@ Logger &Logger::getInstance()
 {
     Logger::lock();
     if (m_ == nullptr)
+    {
         m_ = new Logger;
+        // The logger is never deleted, write the queued messages before the driver exits. The output queue
+        // registers its own flush later, which then runs first, so drain it again after what the logger sent.
+        atexit([]()
+        {
+            if (m_ != nullptr)
+                m_->flush();
+            IDOutputQueueFlush();
+        });
+    }
     Logger::unlock();
     return *m_;
 }
 
+void Logger::flush()
+{
+    backend_->flush();
+}
+
 unsigned int Logger::rank(unsigned int l)
 {
     switch (l)
@@ -379,48 +449,27 @@ void Logger::print(const char *devicename, const unsigned int verbosityLevel, co
 
     INDI_UNUSED(file);
     INDI_UNUSED(line);
-    bool filelog   = (verbosityLevel & fileVerbosityLevel_) != 0;
-    bool screenlog = (verbosityLevel & screenVerbosityLevel_) != 0;
+    bool filelog   = (verbosityLevel & fileVerbosityLevel_) != 0 && (configuration_ & file_on);
+    bool screenlog = (verbosityLevel & screenVerbosityLevel_) != 0 && (configuration_ & screen_on);
 
     va_list ap;
-    char msg[257];
-    char usec[7];
-
-    msg[256] = '\0';
     va_start(ap, message);
-    vsnprintf(msg, 257, message, ap);
-    va_end(ap);
 
     if (!configured_)
     {
         //std::cerr << "Warning! Logger not configured!" << std::endl;
+        std::string msg(std::max(vsnprintf(nullptr, 0, message, ap), 0), '\0');
+        va_end(ap);
+        va_start(ap, message);
+        vsnprintf(&msg[0], msg.size() + 1, message, ap);
+        va_end(ap);
         std::cerr << msg << std::endl;
         return;
     }
-    struct timeval currentTime, resTime;
-    usec[6] = '\0';
-    gettimeofday(&currentTime, nullptr);
-    timersub(&currentTime, &initialTime_, &resTime);
-#if defined(__APPLE__)
-    snprintf(usec, 7, "%06d", resTime.tv_usec);
-#else
-    snprintf(usec, 7, "%06ld", resTime.tv_usec);
-#endif
-    Logger::lock();
-
-    if ((configuration_ & file_on) && filelog)
-    {
-        if (nDevices == 1)
-            out_ << Tags[rank(verbosityLevel)] << "\t" << (resTime.tv_sec) << "." << (usec) << " sec"
-                 << "\t: " << msg << std::endl;
-        else
-            out_ << Tags[rank(verbosityLevel)] << "\t" << (resTime.tv_sec) << "." << (usec) << " sec"
-                 << "\t: [" << devicename << "] " << msg << std::endl;
-    }
-
-    if ((configuration_ & screen_on) && screenlog)
-        IDMessage(devicename, "[%s] %s", Tags[rank(verbosityLevel)], msg);
 
-    Logger::unlock();
+    // Nothing is formatted for messages filtered out
+    if (filelog || screenlog)
+        backend_->push(devicename, verbosityLevel, filelog, screenlog, message, ap);
+    va_end(ap);
 }
 }
@@ -25,6 +25,8 @@
 
 #include <stdarg.h>
 #include <fstream>
+#include <memory>
+#include <mutex>
 #include <ostream>
 #include <string>
 #include <sstream>
@@ -88,6 +90,8 @@
 
 namespace INDI
 {
+class LogBackend;
+
 /**
  * @class INDI::Logger
  * @brief The Logger class is a simple logger to log messages to file and INDI clients. This is the implementation of a simple
@@ -153,6 +157,12 @@ class Logger
 
         /// Stream used when logging on a file
         std::ofstream out_;
+        /// Held by the writer thread while writing out_ and by configure() while reopening it
+        std::mutex fileLock_;
+        /// Writes the messages queued by print() to out_ and to the client
+        class Sink;
+        std::unique_ptr<Sink> sink_;
+        std::unique_ptr<LogBackend> backend_;
         /// Initial time (used to print relative times)
         struct timeval initialTime_;
         /// Verbosity threshold for files
@@ -250,11 +260,18 @@ class Logger
          */
         int addDebugLevel(const char *debugLevelName, const char *LoggingLevelName);
 
+        /**
+         * @brief Queue a message for the log file and the client. The message is written by a background
+         * thread in the order it was printed, set INDI_LOG_SYNC in the environment to wait for it instead.
+         */
         void print(const char *devicename, const unsigned int verbosityLevel, const std::string &sourceFile,
                    const int codeLine,
                    //const std::string& 	message,
                    const char *message, ...);
 
+        /** @brief Wait until every message printed so far was written */
+        void flush();
+
         /**
          * @brief Method to configure the logger. Called by the DEBUG_CONF() macro. To make implementation
          * easier, the old stream is always closed.
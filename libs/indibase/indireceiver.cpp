@@ -48,6 +48,7 @@ Receiver::Receiver()
 
 Receiver::~Receiver()
 {
+    stopAcquisition();
 }
 
 bool Receiver::initProperties()
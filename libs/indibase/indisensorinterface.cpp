@@ -78,6 +78,9 @@ SensorInterface::SensorInterface()
 
 SensorInterface::~SensorInterface()
 {
+    // Derived classes stop the worker before their overrides are gone, this only keeps the thread from outliving us
+    stopAcquisition();
+
     free(Buffer);
     BufferSize = 0;
     Buffer = nullptr;
@@ -325,6 +328,9 @@ bool SensorInterface::processSwitch(const char *dev, const char *name, ISState *
                 DEBUG(Logger::DBG_SESSION, "Upload settings set to client and local.");
                 defineProperty(&FileNameTP);
             }
+
+            if (HasDSP())
+                DSP->setUploadMode(UploadS[0].s == ISS_ON || UploadS[2].s == ISS_ON, UploadS[1].s == ISS_ON || UploadS[2].s == ISS_ON);
             return true;
         }
 
@@ -533,7 +539,7 @@ void SensorInterface::setMinMaxStep(const char *property, const char *element, d
 
 void SensorInterface::setBufferSize(int nbuf, bool allocMem)
 {
-    if (nbuf == BufferSize)
+    if (nbuf == BufferSize && (allocMem == false || Buffer != nullptr))
         return;
 
     BufferSize = nbuf;
@@ -547,12 +553,95 @@ void SensorInterface::setBufferSize(int nbuf, bool allocMem)
 
     // DSP
     if (HasDSP())
-        DSP->setSizes(1, new int[1] { BufferSize * 8 / getBPS() });
+    {
+        int sizes[1] = { BufferSize * 8 / getBPS() };
+        DSP->setSizes(1, sizes);
+    }
 
     if (allocMem == false)
+    {
+        // The driver provides the buffer, ours would be smaller than BufferSize
+        if (BufferOwned)
+        {
+            free(Buffer);
+            Buffer = nullptr;
+            BufferOwned = false;
+        }
         return;
+    }
 
     Buffer = static_cast<uint8_t *>(realloc(Buffer, nbuf * sizeof(uint8_t)));
+    BufferOwned = true;
+}
+
+void SensorInterface::setAcquisitionRing(int frameSize, int frames)
+{
+    if (acquisitionThread.joinable())
+    {
+        if (acquisitionRing.frameSize() == static_cast<size_t>(frameSize) &&
+                acquisitionRing.capacity() == static_cast<size_t>(frames))
+            return;
+
+        // The worker reads frames in place, they can only move once it released all of them
+        while (!acquisitionRing.waitForEmpty(1000))
+            DEBUG(Logger::DBG_DEBUG, "Waiting for pending frames before resizing the acquisition ring...");
+
+        // Nor may it wait on the ring while it is reallocated
+        stopAcquisition();
+    }
+
+    acquisitionRing.resize(frameSize, frames);
+    acquisitionTerminate = false;
+    acquisitionThread = std::thread(&SensorInterface::acquisitionWorker, this);
+}
+
+void SensorInterface::stopAcquisition()
+{
+    acquisitionTerminate = true;
+    acquisitionRing.abort();
+    if (acquisitionThread.joinable())
+        acquisitionThread.join();
+}
+
+uint8_t *SensorInterface::acquireFrame(uint32_t msecs)
+{
+    return acquisitionRing.acquire(msecs);
+}
+
+void SensorInterface::commitFrame(int nbytes, bool streaming)
+{
+    // Reset POLLMS to default value
+    if (!streaming)
+        setCurrentPollingPeriod(getPollingPeriod());
+
+    acquisitionRing.commit(nbytes, streaming ? FRAME_STREAM : FRAME_INTEGRATION);
+}
+
+void SensorInterface::acquisitionWorker()
+{
+    FrameRing::Frame frame;
+    while (!acquisitionTerminate)
+    {
+        if (!acquisitionRing.peek(frame, 500))
+            continue;
+
+        if (frame.tag == FRAME_STREAM)
+        {
+            if (HasStreaming())
+                Streamer->newFrame(frame.data, frame.size);
+        }
+        else
+        {
+            if (HasDSP())
+            {
+                int sizes[1] = { static_cast<int>(frame.size) * 8 / abs(getBPS()) };
+                DSP->processBLOBAsync(frame.data, frame.size, 1, sizes, getBPS());
+            }
+            IntegrationCompletePrivate(frame.data, frame.size);
+        }
+
+        acquisitionRing.release();
+    }
 }
 
 bool SensorInterface::StartIntegration(double duration)
@@ -873,23 +962,33 @@ void* SensorInterface::sendFITS(uint8_t *buf, int len)
 
 bool SensorInterface::IntegrationComplete()
 {
-    // Reset POLLMS to default value
-    setCurrentPollingPeriod(getPollingPeriod());
+    // Keep the ring a driver may have set up as long as the buffer fits in it
+    if (acquisitionRing.frameSize() < static_cast<size_t>(getBufferSize()))
+        setAcquisitionRing(getBufferSize());
+    else
+        setAcquisitionRing(acquisitionRing.frameSize(), acquisitionRing.capacity());
 
-    if(HasDSP())
+    // Snapshot the buffer, the upload runs on the acquisition worker
+    uint8_t *frame = acquireFrame();
+    if (frame == nullptr)
     {
-        uint8_t* buf = (uint8_t*)malloc(getBufferSize());
-        memcpy(buf, getBuffer(), getBufferSize());
-        DSP->processBLOB(buf, 1, new int[1] { getBufferSize() * 8 / getBPS() }, getBPS());
-        free(buf);
+        DEBUG(Logger::DBG_ERROR, "Timed out waiting for the previous integration upload, integration dropped.");
+        return false;
     }
-    // Run async
-    std::thread(&SensorInterface::IntegrationCompletePrivate, this).detach();
+
+    if (getBuffer() == nullptr)
+    {
+        DEBUG(Logger::DBG_ERROR, "No integration buffer, the driver must call setBuffer() when it allocates it.");
+        return false;
+    }
+
+    memcpy(frame, getBuffer(), getBufferSize());
+    commitFrame(getBufferSize());
 
     return true;
 }
 
-bool SensorInterface::IntegrationCompletePrivate()
+bool SensorInterface::IntegrationCompletePrivate(uint8_t *buf, int len)
 {
     bool sendIntegration = (UploadS[0].s == ISS_ON || UploadS[2].s == ISS_ON);
     bool saveIntegration = (UploadS[1].s == ISS_ON || UploadS[2].s == ISS_ON);
@@ -900,11 +999,11 @@ bool SensorInterface::IntegrationCompletePrivate()
         void* blob = nullptr;
         if (!strcmp(getIntegrationFileExtension(), "fits"))
         {
-            blob = sendFITS(getBuffer(), getBufferSize() * 8 / abs(getBPS()));
+            blob = sendFITS(buf, len * 8 / abs(getBPS()));
         }
         else
         {
-            uploadFile(getBuffer(), getBufferSize(), sendIntegration,
+            uploadFile(buf, len, sendIntegration,
                        saveIntegration);
         }
 
@@ -1238,7 +1337,10 @@ void SensorInterface::setBPS(int bps)
 
     // DSP
     if (HasDSP())
-        DSP->setSizes(1, new int[1] { getBufferSize() * 8 / BPS });
+    {
+        int sizes[1] = { getBufferSize() * 8 / BPS };
+        DSP->setSizes(1, sizes);
+    }
 
 }
 
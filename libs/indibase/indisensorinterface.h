@@ -22,6 +22,7 @@
 #include "dsp.h"
 #include "dsp/manager.h"
 #include "stream/streammanager.h"
+#include "stream/framering.h"
 #include <fitsio.h>
 
 #ifdef HAVE_WEBSOCKET
@@ -34,6 +35,7 @@
 #include <cstring>
 #include <chrono>
 #include <stdint.h>
+#include <atomic>
 #include <mutex>
 #include <thread>
 #include <stream/streammanager.h>
@@ -161,6 +163,7 @@ class SensorInterface : public DefaultDevice
         inline void setBuffer(uint8_t *buffer)
         {
             Buffer = buffer;
+            BufferOwned = false;
         }
 
         /**
@@ -191,10 +194,48 @@ class SensorInterface : public DefaultDevice
          * sample depth of the Sensor device (bps). You must set the frame size any time any of
          * the prior parameters gets updated.
          * @param nbuf size of buffer in bytes.
-         * @param allocMem if True, it will allocate memory of nbut size bytes.
+         * @param allocMem if True, it will allocate memory of nbut size bytes. If False, the buffer
+         * allocated so far is released and getBuffer() returns nullptr until setBuffer() is called.
          */
         void setBufferSize(int nbuf, bool allocMem = true);
 
+        /**
+         * @brief setAcquisitionRing Allocate the acquisition ring used by acquireFrame() and commitFrame().
+         * Drivers that read samples on their own thread fill ring frames in place, while a single
+         * worker owned by the Sensor uploads, streams and analyzes the committed ones. No frame is
+         * written while it is being read, so the driver never has to wait for an upload to finish
+         * before it starts the next integration.
+         * @param frameSize size of a frame in bytes.
+         * @param frames number of frames in the ring, 2 is enough for integrations, streaming
+         * drivers should use more to absorb jitter of the clients.
+         * @note Waits for pending frames to be consumed when the ring geometry changes. Must be called
+         * by the thread filling the frames, or while it does not use the ring.
+         */
+        void setAcquisitionRing(int frameSize, int frames = 2);
+
+        /**
+         * @brief stopAcquisition Stop the worker started by setAcquisitionRing(), frames not uploaded yet
+         * are discarded. The worker calls virtual functions, so a driver using the ring calls this in its
+         * destructor once it stopped producing frames. The next setAcquisitionRing() starts it again.
+         */
+        void stopAcquisition();
+
+        /**
+         * @brief acquireFrame Get the next free frame of the acquisition ring. The frame stays the
+         * same until commitFrame() is called, so it can be filled in several reads.
+         * @param msecs how long to wait for the consumer to release a frame.
+         * @return pointer to a frame of the size passed to setAcquisitionRing(), or nullptr on timeout.
+         */
+        uint8_t *acquireFrame(uint32_t msecs = 1000);
+
+        /**
+         * @brief commitFrame Hand the frame returned by acquireFrame() over to the consumer.
+         * @param nbytes number of valid bytes in the frame.
+         * @param streaming if true the frame is sent to the streamer, otherwise it completes
+         * the current integration like IntegrationComplete() does.
+         */
+        void commitFrame(int nbytes, bool streaming = false);
+
         /**
          * @brief setBPP Set depth of Sensor device.
          * @param bpp bits per pixel
@@ -294,7 +335,8 @@ class SensorInterface : public DefaultDevice
 
         /**
          * \brief Uploads target Device exposed buffer as FITS to the client. Derived classes should class
-         * this function when an Integration is complete.
+         * this function when an Integration is complete. The buffer is copied to the acquisition ring,
+         * so the driver may refill it as soon as this function returns.
          * @param targetDevice device that contains upload integration data
          * \note This function is not implemented in Sensor, it must be implemented in the child class
          */
@@ -548,6 +590,8 @@ class SensorInterface : public DefaultDevice
         /// Bytes per Sample
         uint8_t *Buffer;
         int BufferSize;
+        // Buffer was allocated by setBufferSize(), not given by setBuffer()
+        bool BufferOwned {true};
         double integrationTime;
         double startIntegrationTime;
         char integrationExtention[MAXINDIBLOBFMT];
@@ -556,7 +600,19 @@ class SensorInterface : public DefaultDevice
         void getMinMax(double *min, double *max, uint8_t *buf, int len, int bpp);
         int getFileIndex(const char *dir, const char *prefix, const char *ext);
 
-        bool IntegrationCompletePrivate();
+        bool IntegrationCompletePrivate(uint8_t *buf, int len);
         void* sendFITS(uint8_t* buf, int len);
+
+        enum
+        {
+            FRAME_INTEGRATION = 0,
+            FRAME_STREAM
+        };
+
+        void acquisitionWorker();
+
+        FrameRing acquisitionRing;
+        std::thread acquisitionThread;
+        std::atomic<bool> acquisitionTerminate {false};
 };
 }
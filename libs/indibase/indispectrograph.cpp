@@ -48,6 +48,7 @@ Spectrograph::Spectrograph()
 
 Spectrograph::~Spectrograph()
 {
+    stopAcquisition();
 }
 
 bool Spectrograph::initProperties()
@@ -0,0 +1,202 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief The INDIWSQueue class holds the frames waiting for one WebSocket client, whatever the transport.
+ *
+ * The queue keeps at most limit() frames. When it is full, its oldest stream frame is dropped. A captured
+ * image is only dropped when the queue holds nothing else, and never to make room for a stream frame.
+ *
+ * Clients of the /framed resource get one binary message per frame, starting with a header of
+ * FRAME_HEADER_SIZE bytes: the format (e.g. ".fits" or ".stream_jpg") NUL padded to FRAME_FORMAT_SIZE
+ * bytes, then the payload size as a 64 bits little endian integer. Other clients get the format as a
+ * text message followed by the payload as a binary message, for every frame.
+ */
+class INDIWSQueue
+{
+    public:
+        static constexpr size_t FRAME_HEADER_SIZE = 24;
+        static constexpr size_t FRAME_FORMAT_SIZE = 16;
+
+        struct Frame
+        {
+            std::string format;
+            bool stream {false};
+            // Header followed by the payload
+            std::string message;
+
+            const char *payload() const
+            {
+                return message.data() + FRAME_HEADER_SIZE;
+            }
+            size_t payloadSize() const
+            {
+                return message.size() - FRAME_HEADER_SIZE;
+            }
+        };
+
+        /** A message to hand to the transport, valid until pop() */
+        struct Message
+        {
+            bool text;
+            const char *data;
+            size_t size;
+        };
+
+        /**
+         * @brief Build a frame that the queues of all clients share. The payload is copied.
+         * @param format file extension of the payload, e.g. ".fits"
+         * @param stream true for stream frames, which are dropped first when a client falls behind
+         */
+        static std::shared_ptr<const Frame> makeFrame(const std::string &format, const void *payload, size_t len, bool stream)
+        {
+            auto frame = std::make_shared<Frame>();
+            frame->format = format;
+            frame->stream = stream;
+            frame->message.resize(FRAME_HEADER_SIZE + len);
+
+            char *header = &frame->message[0];
+            std::memset(header, 0, FRAME_HEADER_SIZE);
+            std::memcpy(header, format.data(), std::min(format.size(), FRAME_FORMAT_SIZE));
+            uint64_t size = len;
+            for (size_t i = 0; i < 8; i++)
+                header[FRAME_FORMAT_SIZE + i] = static_cast<char>((size >> (8 * i)) & 0xff);
+            if (len > 0)
+                std::memcpy(header + FRAME_HEADER_SIZE, payload, len);
+            return frame;
+        }
+
+        explicit INDIWSQueue(bool framed = false, size_t limit = 4) : m_framed(framed)
+        {
+            setLimit(limit);
+        }
+
+        /** @brief Maximum number of frames waiting */
+        void setLimit(size_t limit)
+        {
+            m_limit = limit > 0 ? limit : 1;
+        }
+        size_t limit() const
+        {
+            return m_limit;
+        }
+
+        /** @return true if the client gets the frames with their header in a single message */
+        bool framed() const
+        {
+            return m_framed;
+        }
+
+        void push(const std::shared_ptr<const Frame> &frame)
+        {
+            if (m_frames.size() >= m_limit)
+            {
+                auto oldest = std::find_if(m_frames.begin(), m_frames.end(), [](const std::shared_ptr<const Frame> &queued)
+                {
+                    return queued->stream;
+                });
+
+                if (oldest != m_frames.end())
+                    m_frames.erase(oldest);
+                else if (frame->stream)
+                {
+                    // Never replace a captured image with a stream frame
+                    m_dropped++;
+                    return;
+                }
+                else
+                    m_frames.pop_front();
+                m_dropped++;
+            }
+            m_frames.push_back(frame);
+        }
+
+        /** @brief The messages to send for the oldest frame, which stays queued until pop() */
+        std::vector<Message> messages() const
+        {
+            std::vector<Message> result;
+            if (m_frames.empty())
+                return result;
+
+            const Frame &frame = *m_frames.front();
+            if (m_framed)
+                result.push_back({ false, frame.message.data(), frame.message.size() });
+            else
+            {
+                result.push_back({ true, frame.format.data(), frame.format.size() });
+                result.push_back({ false, frame.payload(), frame.payloadSize() });
+            }
+            return result;
+        }
+
+        /** @brief Forget the oldest frame once its messages were sent */
+        void pop()
+        {
+            if (m_frames.empty())
+                return;
+            m_sent++;
+            m_bytes += m_frames.front()->payloadSize();
+            m_frames.pop_front();
+        }
+
+        void clear()
+        {
+            m_frames.clear();
+        }
+
+        bool empty() const
+        {
+            return m_frames.empty();
+        }
+        size_t size() const
+        {
+            return m_frames.size();
+        }
+
+        /** @return frames sent */
+        uint64_t frames() const
+        {
+            return m_sent;
+        }
+        /** @return payload bytes sent */
+        uint64_t bytes() const
+        {
+            return m_bytes;
+        }
+        /** @return frames dropped because the queue was full */
+        uint64_t dropped() const
+        {
+            return m_dropped;
+        }
+
+    private:
+        std::deque<std::shared_ptr<const Frame>> m_frames;
+        bool m_framed {false};
+        size_t m_limit {4};
+        uint64_t m_sent {0};
+        uint64_t m_bytes {0};
+        uint64_t m_dropped {0};
+};
@@ -18,7 +18,16 @@
 
 #pragma once
 
-#include <set>
+#include "indiwsqueue.h"
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
 #include <websocketpp/config/asio_no_tls.hpp>
 #include <websocketpp/server.hpp>
 #include <websocketpp/extensions/permessage_deflate/enabled.hpp>
@@ -43,8 +52,29 @@ using websocketpp::lib::placeholders::_1;
 using websocketpp::lib::placeholders::_2;
 using websocketpp::lib::bind;
 
+/**
+ * @brief The INDIWSServer class delivers BLOBs to WebSocket clients.
+ *
+ * send_frame() only queues the frame, the sends happen on the thread running the server. Every
+ * connection has its own INDIWSQueue of at most queueLimit() frames, so a slow client only loses
+ * its own frames and never delays the caller or the other clients. A frame is handed to the socket
+ * once less than 1MB of the previous ones is still buffered. Clients connecting to the /framed
+ * resource get each frame as a single message, see INDIWSQueue.
+ */
 class INDIWSServer
 {
+    public:
+        struct ConnectionStatistics
+        {
+            std::string endpoint;
+            uint64_t frames {0};
+            uint64_t bytes {0};
+            uint64_t dropped {0};
+            size_t queued {0};
+            /** Bytes per second sent since the previous call to statistics() */
+            double throughput {0};
+        };
+
     public:
         INDIWSServer()  {}
 
@@ -55,13 +85,40 @@ class INDIWSServer
             return m_port ;
         }
 
+        /** @brief Maximum number of frames waiting for each connection */
+        void setQueueLimit(size_t limit)
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            m_queueLimit = limit > 0 ? limit : 1;
+            for (auto &it : m_connections)
+                it.second.queue.setLimit(m_queueLimit);
+        }
+        size_t queueLimit() const
+        {
+            return m_queueLimit;
+        }
+
         void on_open(connection_hdl hdl)
         {
-            m_connections.insert(hdl);
+            std::lock_guard<std::mutex> lock(m_lock);
+            Client &client = m_connections[hdl];
+            client.lastStatistics = std::chrono::steady_clock::now();
+            client.queue.setLimit(m_queueLimit);
+            try
+            {
+                server::connection_ptr con = m_server->get_con_from_hdl(hdl);
+                client.queue = INDIWSQueue(con->get_resource() == "/framed", m_queueLimit);
+                client.endpoint = con->get_remote_endpoint();
+            }
+            catch (websocketpp::exception const &e)
+            {
+                std::cerr << e.what() << std::endl;
+            }
         }
 
         void on_close(connection_hdl hdl)
         {
+            std::lock_guard<std::mutex> lock(m_lock);
             m_connections.erase(hdl);
         }
 
@@ -73,13 +130,34 @@ class INDIWSServer
         //        }
         //    }
 
+        /**
+         * @brief Queue a frame for every connected client. The payload is copied, the caller may reuse it
+         * once this returns.
+         * @param format file extension of the payload, e.g. ".fits"
+         * @param stream true for stream frames, which are dropped first when a client falls behind
+         */
+        void send_frame(const std::string &format, void const * payload, size_t len, bool stream)
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            if (m_connections.empty())
+                return;
+
+            auto frame = INDIWSQueue::makeFrame(format, payload, len, stream);
+            for (auto &it : m_connections)
+                it.second.queue.push(frame);
+
+            schedulePump(0);
+        }
+
+        /** @brief Send the payload to every client right away, from the calling thread */
         void send_binary(void const * payload, size_t len)
         {
-            for (auto it : m_connections)
+            std::lock_guard<std::mutex> lock(m_lock);
+            for (auto &it : m_connections)
             {
                 try
                 {
-                    m_server->send(it, payload, len, websocketpp::frame::opcode::binary);
+                    m_server->send(it.first, payload, len, websocketpp::frame::opcode::binary);
                 }
                 catch (websocketpp::exception const &e)
                 {
@@ -93,13 +171,15 @@ class INDIWSServer
             }
         }
 
+        /** @brief Send the text to every client right away, from the calling thread */
         void send_text(const std::string &payload)
         {
-            for (auto it : m_connections)
+            std::lock_guard<std::mutex> lock(m_lock);
+            for (auto &it : m_connections)
             {
                 try
                 {
-                    m_server->send(it, payload, websocketpp::frame::opcode::text);
+                    m_server->send(it.first, payload, websocketpp::frame::opcode::text);
                 }
                 catch (websocketpp::exception const &e)
                 {
@@ -113,13 +193,42 @@ class INDIWSServer
             }
         }
 
+        /** @brief Statistics of every connected client */
+        std::vector<ConnectionStatistics> statistics()
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            auto now = std::chrono::steady_clock::now();
+            std::vector<ConnectionStatistics> result;
+            for (auto &it : m_connections)
+            {
+                Client &client = it.second;
+                ConnectionStatistics stats;
+                stats.endpoint = client.endpoint;
+                stats.frames = client.queue.frames();
+                stats.bytes = client.queue.bytes();
+                stats.dropped = client.queue.dropped();
+                stats.queued = client.queue.size();
+
+                std::chrono::duration<double> elapsed = now - client.lastStatistics;
+                if (elapsed.count() > 0)
+                    stats.throughput = (stats.bytes - client.lastBytes) / elapsed.count();
+                client.lastBytes = stats.bytes;
+                client.lastStatistics = now;
+                result.push_back(stats);
+            }
+            return result;
+        }
+
         void stop()
         {
-            for (auto it : m_connections)
-                m_server->close(it, websocketpp::close::status::normal, "Switched off by user.");
+            std::lock_guard<std::mutex> lock(m_lock);
+            for (auto &it : m_connections)
+                m_server->close(it.first, websocketpp::close::status::normal, "Switched off by user.");
 
             m_connections.clear();
             m_server->stop();
+            // Pumps still pending are dropped with the io service
+            m_pumpScheduled = false;
         }
 
         bool is_running()
@@ -131,7 +240,12 @@ class INDIWSServer
         {
             try
             {
-                m_server.reset(new server());
+                {
+                    // The server is reused after stop(), send_frame() may run meanwhile
+                    std::lock_guard<std::mutex> lock(m_lock);
+                    m_server.reset(new server());
+                    m_pumpScheduled = false;
+                }
 
                 m_server->init_asio();
                 m_server->set_reuse_addr(true);
@@ -158,11 +272,97 @@ class INDIWSServer
         }
 
     private:
-        typedef std::set<connection_hdl, std::owner_less<connection_hdl>> con_list;
+        struct Client
+        {
+            INDIWSQueue queue;
+            std::string endpoint;
+            uint64_t lastBytes {0};
+            std::chrono::steady_clock::time_point lastStatistics;
+        };
+
+        // A client keeps at most this many bytes in its socket buffers
+        static constexpr size_t MAX_BUFFERED = 1024 * 1024;
+
+        // Lock held. Run pump() on the server thread, now or after delay milliseconds.
+        void schedulePump(long delay)
+        {
+            if (!m_server || m_pumpScheduled.exchange(true))
+                return;
+
+            if (delay == 0)
+                m_server->get_io_service().post(bind(&INDIWSServer::pump, this));
+            else
+                m_server->set_timer(delay, [this](websocketpp::lib::error_code const & ec)
+                {
+                    // Cancelled when the server stops
+                    if (ec)
+                    {
+                        std::lock_guard<std::mutex> lock(m_lock);
+                        m_pumpScheduled = false;
+                        return;
+                    }
+                    pump();
+                });
+        }
+
+        // Hand the queued frames of every client to its socket while it does not buffer too much
+        void pump()
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            m_pumpScheduled = false;
+
+            bool backlog = false;
+            for (auto &it : m_connections)
+            {
+                Client &client = it.second;
+                server::connection_ptr con;
+                try
+                {
+                    con = m_server->get_con_from_hdl(it.first);
+                }
+                catch (websocketpp::exception const &)
+                {
+                    client.queue.clear();
+                    continue;
+                }
+
+                while (!client.queue.empty() && con->get_buffered_amount() < MAX_BUFFERED)
+                {
+                    websocketpp::lib::error_code ec;
+                    for (const auto &message : client.queue.messages())
+                    {
+                        ec = con->send(message.data, message.size,
+                                       message.text ? websocketpp::frame::opcode::text : websocketpp::frame::opcode::binary);
+                        if (ec)
+                            break;
+                    }
+
+                    if (ec)
+                    {
+                        std::cerr << ec.message() << std::endl;
+                        client.queue.clear();
+                        break;
+                    }
+
+                    client.queue.pop();
+                }
+
+                backlog = backlog || !client.queue.empty();
+            }
+
+            // Come back when the sockets had some time to drain
+            if (backlog)
+                schedulePump(5);
+        }
+
+    private:
+        typedef std::map<connection_hdl, Client, std::owner_less<connection_hdl>> con_list;
 
         std::unique_ptr<server> m_server;
         con_list m_connections;
+        std::mutex m_lock;
+        std::atomic<bool> m_pumpScheduled {false};
+        size_t m_queueLimit {4};
         uint16_t m_port;
         static uint16_t m_global_port;
 };
-
@@ -0,0 +1,257 @@
+/*
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace INDI
+{
+
+/**
+ * \class FrameRing
+ * \brief The FrameRing class is a single producer, single consumer ring of fixed size frames.
+ *
+ * The producer fills a slot in place and commits it, the consumer reads the committed slot in place
+ * and releases it, so samples are never copied between the two sides and a slot is never written
+ * while it is being read. Both fast paths are lock free. A side only takes the internal mutex to sleep
+ * when the ring is full or empty, and the other side only takes it to wake a sleeper.
+ */
+class FrameRing
+{
+    public:
+        struct Frame
+        {
+            uint8_t *data {nullptr};
+            size_t size {0};
+            uint32_t tag {0};
+        };
+
+    public:
+        /**
+         * @brief Reallocate the ring, all pending frames are discarded
+         * @note Must not run concurrently with the producer or the consumer
+         */
+        void resize(size_t frameSize, size_t frames);
+
+        size_t frameSize() const
+        {
+            return m_FrameSize;
+        }
+
+        size_t capacity() const
+        {
+            return m_Slots;
+        }
+
+        /**
+         * @brief Number of committed frames not yet released by the consumer
+         */
+        size_t size() const;
+
+        /**
+         * @brief Producer side, get the next free slot
+         * @return frameSize() writable bytes or nullptr if the ring is full
+         * @note The slot stays owned by the producer until commit(), calling acquire() again returns the same slot
+         */
+        uint8_t *acquire();
+
+        /**
+         * @brief Producer side, wait for a free slot
+         * @param msecs timeout in milliseconds
+         * @return returns nullptr if timeout or the abort function was called while waiting
+         */
+        uint8_t *acquire(uint32_t msecs);
+
+        /**
+         * @brief Producer side, publish the slot returned by acquire()
+         * @param size number of valid bytes in the slot
+         * @param tag value handed back to the consumer along with the frame
+         */
+        void commit(size_t size, uint32_t tag = 0);
+
+        /**
+         * @brief Consumer side, get the oldest committed frame without removing it
+         * @return returns false if the ring is empty
+         */
+        bool peek(Frame &frame);
+
+        /**
+         * @brief Consumer side, wait for a committed frame
+         * @param msecs timeout in milliseconds
+         * @return returns false if timeout or the abort function was called while waiting
+         */
+        bool peek(Frame &frame, uint32_t msecs);
+
+        /**
+         * @brief Consumer side, hand the frame returned by peek() back to the producer
+         */
+        void release();
+
+        /**
+         * @brief Wait until the consumer has released every committed frame
+         * @param msecs timeout in milliseconds
+         * @return returns false if timeout or the abort function was called while waiting
+         */
+        bool waitForEmpty(uint32_t msecs);
+
+        /**
+         * @brief Wake up and fail every waiting call until resize() is called again
+         */
+        void abort();
+
+    private:
+        template <typename Predicate>
+        bool wait(uint32_t msecs, Predicate predicate);
+        void notify();
+
+    private:
+        std::vector<uint8_t> m_Buffer;
+        std::vector<Frame> m_Frames;
+        size_t m_FrameSize {0};
+        size_t m_Slots {0};
+
+        // Monotonic counters, the slot is the counter modulo m_Slots
+        alignas(64) std::atomic<size_t> m_Head {0};
+        alignas(64) std::atomic<size_t> m_Tail {0};
+
+        std::atomic<bool> m_Abort {false};
+        std::atomic<int> m_Waiters {0};
+        std::mutex m_Mutex;
+        std::condition_variable m_Condition;
+};
+
+inline void FrameRing::resize(size_t frameSize, size_t frames)
+{
+    m_FrameSize = frameSize;
+    m_Slots = frames;
+    m_Buffer.assign(frameSize * frames, 0);
+    m_Buffer.shrink_to_fit();
+    m_Frames.assign(frames, Frame());
+    for (size_t i = 0; i < frames; ++i)
+        m_Frames[i].data = m_Buffer.data() + i * frameSize;
+
+    m_Head = 0;
+    m_Tail = 0;
+    m_Abort = false;
+}
+
+inline size_t FrameRing::size() const
+{
+    return m_Head.load() - m_Tail.load();
+}
+
+inline uint8_t *FrameRing::acquire()
+{
+    size_t head = m_Head.load(std::memory_order_relaxed);
+    if (m_Slots == 0 || head - m_Tail.load(std::memory_order_acquire) >= m_Slots)
+        return nullptr;
+
+    return m_Frames[head % m_Slots].data;
+}
+
+inline uint8_t *FrameRing::acquire(uint32_t msecs)
+{
+    uint8_t *data = acquire();
+    if (data != nullptr)
+        return data;
+
+    if (!wait(msecs, [this] { return m_Slots > 0 && m_Head.load() - m_Tail.load() < m_Slots; }))
+        return nullptr;
+
+    return acquire();
+}
+
+inline void FrameRing::commit(size_t size, uint32_t tag)
+{
+    size_t head = m_Head.load(std::memory_order_relaxed);
+    Frame &frame = m_Frames[head % m_Slots];
+    frame.size = size < m_FrameSize ? size : m_FrameSize;
+    frame.tag  = tag;
+    m_Head.store(head + 1);
+    notify();
+}
+
+inline bool FrameRing::peek(Frame &frame)
+{
+    size_t tail = m_Tail.load(std::memory_order_relaxed);
+    if (m_Head.load(std::memory_order_acquire) == tail)
+        return false;
+
+    frame = m_Frames[tail % m_Slots];
+    return true;
+}
+
+inline bool FrameRing::peek(Frame &frame, uint32_t msecs)
+{
+    if (peek(frame))
+        return true;
+
+    if (!wait(msecs, [this] { return m_Head.load() != m_Tail.load(); }))
+        return false;
+
+    return peek(frame);
+}
+
+inline void FrameRing::release()
+{
+    m_Tail.store(m_Tail.load(std::memory_order_relaxed) + 1);
+    notify();
+}
+
+inline bool FrameRing::waitForEmpty(uint32_t msecs)
+{
+    if (m_Head.load() == m_Tail.load())
+        return true;
+
+    return wait(msecs, [this] { return m_Head.load() == m_Tail.load(); });
+}
+
+inline void FrameRing::abort()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Abort = true;
+    m_Condition.notify_all();
+}
+
+template <typename Predicate>
+inline bool FrameRing::wait(uint32_t msecs, Predicate predicate)
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    // Announce the sleeper before checking the predicate again, notify() reads the counter
+    // after publishing its counter so either we see the new value or it sees the waiter
+    ++m_Waiters;
+    bool result = m_Condition.wait_for(lock, std::chrono::milliseconds(msecs), [&]
+    {
+        return m_Abort.load() || predicate();
+    });
+    --m_Waiters;
+    return result && !m_Abort.load();
+}
+
+inline void FrameRing::notify()
+{
+    if (m_Waiters.load() == 0)
+        return;
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Condition.notify_all();
+}
+
+}
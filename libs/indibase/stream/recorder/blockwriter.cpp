@@ -0,0 +1,306 @@
+/*
+    Block Writer
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+#include "blockwriter.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+// O_DIRECT transfers must be aligned in memory, offset and size
+#define BLOCK_ALIGNMENT 4096
+// The file is extended by at least this much at a time
+#define PREALLOCATE_STEP (256 * 1024 * 1024ULL)
+
+namespace INDI
+{
+
+BlockWriter::~BlockWriter()
+{
+    if (isOpen())
+        close();
+}
+
+void BlockWriter::setBuffer(size_t blockSize, size_t blocks)
+{
+    m_BlockSize  = std::max<size_t>(1, (blockSize + BLOCK_ALIGNMENT - 1) / BLOCK_ALIGNMENT) * BLOCK_ALIGNMENT;
+    m_BlockCount = std::max<size_t>(2, blocks);
+}
+
+bool BlockWriter::open(const char *filename, std::string &error)
+{
+    if (isOpen())
+    {
+        error = "file already open";
+        return false;
+    }
+
+    int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+    m_Direct = false;
+#ifdef O_DIRECT
+    if (m_UseDirect)
+    {
+        m_FD = ::open(filename, flags | O_DIRECT, 0666);
+        m_Direct = m_FD >= 0;
+    }
+#endif
+    if (m_FD < 0)
+        m_FD = ::open(filename, flags, 0666);
+    if (m_FD < 0)
+    {
+        error = "recorder open error " + std::to_string(errno) + ", " + strerror(errno);
+        return false;
+    }
+
+    m_Blocks.resize(m_BlockCount);
+    for (auto &block : m_Blocks)
+    {
+        void *data = nullptr;
+        if (posix_memalign(&data, BLOCK_ALIGNMENT, m_BlockSize) != 0)
+        {
+            freeBlocks();
+            ::close(m_FD);
+            m_FD = -1;
+            error = "recorder cannot allocate " + std::to_string(m_BlockCount * m_BlockSize / 1024 / 1024) + "MB";
+            return false;
+        }
+        block.data = static_cast<uint8_t *>(data);
+        block.used = 0;
+    }
+
+    m_Size = 0;
+    m_Allocated = 0;
+    m_Current = nullptr;
+    m_Free.clear();
+    m_Full.clear();
+    for (auto &block : m_Blocks)
+        m_Free.push_back(&block);
+    m_WriteOffset = 0;
+    m_Stop = false;
+    m_Failed = false;
+    m_Error.clear();
+    m_Statistics = Statistics();
+    m_Statistics.direct = m_Direct;
+
+    m_Thread = std::thread(&BlockWriter::writerLoop, this);
+    return true;
+}
+
+bool BlockWriter::write(const void *data, size_t len)
+{
+    auto bytes = static_cast<const uint8_t *>(data);
+
+    while (len > 0)
+    {
+        if (m_Current == nullptr)
+        {
+            std::unique_lock<std::mutex> lock(m_Lock);
+            if (m_Free.empty() && !m_Failed)
+            {
+                auto start = std::chrono::steady_clock::now();
+                m_Cond.wait(lock, [this] { return !m_Free.empty() || m_Failed; });
+                m_Statistics.stalls++;
+                m_Statistics.stallSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            }
+            if (m_Failed)
+                return false;
+
+            m_Current = m_Free.front();
+            m_Free.pop_front();
+        }
+
+        size_t chunk = std::min(len, m_BlockSize - m_Current->used);
+        memcpy(m_Current->data + m_Current->used, bytes, chunk);
+        m_Current->used += chunk;
+        m_Size += chunk;
+        bytes += chunk;
+        len -= chunk;
+
+        if (m_Current->used == m_BlockSize)
+        {
+            std::lock_guard<std::mutex> lock(m_Lock);
+            m_Full.push_back(m_Current);
+            m_Current = nullptr;
+            m_Cond.notify_all();
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_Lock);
+    return !m_Failed;
+}
+
+void BlockWriter::writerLoop()
+{
+    std::unique_lock<std::mutex> lock(m_Lock);
+    for (;;)
+    {
+        m_Cond.wait(lock, [this] { return !m_Full.empty() || m_Stop; });
+        if (m_Full.empty())
+            return;
+
+        Block *block = m_Full.front();
+        m_Full.pop_front();
+        uint64_t offset = m_WriteOffset;
+        m_WriteOffset += block->used;
+        bool failed = m_Failed;
+        lock.unlock();
+
+        // Once a write failed, the rest of the file is worthless
+        auto start = std::chrono::steady_clock::now();
+        bool ok = failed || writeBlock(block, offset);
+        int error = errno;
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        lock.lock();
+        m_Statistics.direct = m_Direct;
+        if (!ok)
+        {
+            m_Failed = true;
+            m_Error = "recorder write error " + std::to_string(error) + ", " + strerror(error);
+        }
+        else if (!failed)
+        {
+            m_Statistics.bytes += block->used;
+            m_Statistics.writeSeconds += seconds;
+        }
+        block->used = 0;
+        m_Free.push_back(block);
+        m_Cond.notify_all();
+    }
+}
+
+bool BlockWriter::writeBlock(Block *block, uint64_t offset)
+{
+    size_t len = block->used;
+    if (m_Direct && len % BLOCK_ALIGNMENT)
+    {
+        // Last block, close() truncates the padding
+        size_t padded = (len + BLOCK_ALIGNMENT - 1) / BLOCK_ALIGNMENT * BLOCK_ALIGNMENT;
+        memset(block->data + len, 0, padded - len);
+        len = padded;
+    }
+
+    preallocate(offset + len);
+
+    size_t done = 0;
+    while (done < len)
+    {
+        ssize_t written = ::pwrite(m_FD, block->data + done, len - done, offset + done);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+#ifdef O_DIRECT
+            // Some filesystems accept O_DIRECT at open and refuse it on write
+            if (errno == EINVAL && m_Direct)
+            {
+                fcntl(m_FD, F_SETFL, fcntl(m_FD, F_GETFL) & ~O_DIRECT);
+                m_Direct = false;
+                continue;
+            }
+#endif
+            return false;
+        }
+        done += written;
+    }
+    return true;
+}
+
+void BlockWriter::preallocate(uint64_t end)
+{
+    if (end <= m_Allocated)
+        return;
+
+#ifdef __linux__
+    uint64_t target = end + std::max<uint64_t>(PREALLOCATE_STEP, 4 * m_BlockSize);
+    if (fallocate(m_FD, 0, m_Allocated, target - m_Allocated) == 0)
+    {
+        m_Allocated = target;
+        return;
+    }
+#endif
+    // Not supported by the filesystem, do not try again
+    m_Allocated = UINT64_MAX;
+}
+
+bool BlockWriter::close(const void *header, size_t headerLen)
+{
+    if (!isOpen())
+        return false;
+
+    {
+        std::lock_guard<std::mutex> lock(m_Lock);
+        if (m_Current != nullptr && m_Current->used > 0)
+            m_Full.push_back(m_Current);
+        m_Current = nullptr;
+        m_Stop = true;
+        m_Cond.notify_all();
+    }
+    m_Thread.join();
+
+    bool ok = !m_Failed;
+
+#ifdef O_DIRECT
+    if (m_Direct)
+    {
+        fcntl(m_FD, F_SETFL, fcntl(m_FD, F_GETFL) & ~O_DIRECT);
+        m_Direct = false;
+    }
+#endif
+
+    // Drop the preallocated space and the padding of the last block
+    if (ftruncate(m_FD, m_Size) != 0 && ok)
+    {
+        ok = false;
+        m_Error = "recorder truncate error " + std::to_string(errno) + ", " + strerror(errno);
+    }
+
+    if (ok && header != nullptr && ::pwrite(m_FD, header, headerLen, 0) != static_cast<ssize_t>(headerLen))
+    {
+        ok = false;
+        m_Error = "recorder write error " + std::to_string(errno) + ", " + strerror(errno);
+    }
+
+    ::close(m_FD);
+    m_FD = -1;
+    freeBlocks();
+    return ok;
+}
+
+BlockWriter::Statistics BlockWriter::statistics() const
+{
+    std::lock_guard<std::mutex> lock(m_Lock);
+    return m_Statistics;
+}
+
+void BlockWriter::freeBlocks()
+{
+    for (auto &block : m_Blocks)
+        free(block.data);
+    m_Blocks.clear();
+    m_Free.clear();
+    m_Full.clear();
+}
+
+}
@@ -0,0 +1,145 @@
+/*
+    Block Writer
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace INDI
+{
+
+/**
+ * @brief The BlockWriter class writes a file sequentially from a dedicated thread.
+ *
+ * write() copies the data into large aligned blocks, full blocks are written by the writer thread
+ * so the caller only waits when every block is still queued. The file is preallocated ahead of the
+ * written data and opened with O_DIRECT when the filesystem supports it, so long recordings neither
+ * fragment nor flood the page cache. close() writes what is left and truncates the file to the size
+ * of the data.
+ */
+class BlockWriter
+{
+    public:
+        struct Statistics
+        {
+            uint64_t bytes {0};
+            /** Number of times write() had to wait for a free block */
+            uint64_t stalls {0};
+            double stallSeconds {0};
+            double writeSeconds {0};
+            /** Whether the writes bypassed the page cache */
+            bool direct {false};
+        };
+
+    public:
+        BlockWriter() = default;
+        ~BlockWriter();
+
+        BlockWriter(const BlockWriter &) = delete;
+        BlockWriter &operator=(const BlockWriter &) = delete;
+
+        /**
+         * @brief Set the staging memory, used by the next open().
+         * @param blockSize bytes per write, rounded up to a multiple of 4096
+         * @param blocks number of blocks, at least 2
+         */
+        void setBuffer(size_t blockSize, size_t blocks);
+
+        /** @brief Try O_DIRECT on the next open(), on by default */
+        void setDirect(bool enabled)
+        {
+            m_UseDirect = enabled;
+        }
+
+        bool open(const char *filename, std::string &error);
+        bool isOpen() const
+        {
+            return m_FD >= 0;
+        }
+
+        /** @brief Append len bytes. Only fails when an earlier write to the file failed. */
+        bool write(const void *data, size_t len);
+
+        /** @brief Bytes appended since open() */
+        uint64_t size() const
+        {
+            return m_Size;
+        }
+
+        /**
+         * @brief Write everything still queued, overwrite the start of the file with header and close it.
+         * @return false if any write failed, error() tells why.
+         */
+        bool close(const void *header = nullptr, size_t headerLen = 0);
+
+        const std::string &error() const
+        {
+            return m_Error;
+        }
+
+        Statistics statistics() const;
+
+    private:
+        struct Block
+        {
+            uint8_t *data {nullptr};
+            size_t used {0};
+        };
+
+        void writerLoop();
+        bool writeBlock(Block *block, uint64_t offset);
+        void preallocate(uint64_t end);
+        void freeBlocks();
+
+    private:
+        size_t m_BlockSize {4 * 1024 * 1024};
+        size_t m_BlockCount {16};
+        bool m_UseDirect {true};
+
+        int m_FD {-1};
+        std::atomic<bool> m_Direct {false};
+        uint64_t m_Size {0};
+        uint64_t m_Allocated {0};
+
+        std::vector<Block> m_Blocks;
+        Block *m_Current {nullptr};
+
+        // Guards everything below, shared with the writer thread
+        mutable std::mutex m_Lock;
+        std::condition_variable m_Cond;
+        std::deque<Block *> m_Free;
+        std::deque<Block *> m_Full;
+        uint64_t m_WriteOffset {0};
+        bool m_Stop {false};
+        bool m_Failed {false};
+        std::string m_Error;
+        Statistics m_Statistics;
+
+        std::thread m_Thread;
+};
+
+}
@@ -35,6 +35,8 @@
 
 
 #define ERRMSGSIZ 1024
+// Timestamps kept in memory before they are spilled to a temporary file
+#define STAMPS_PER_SPILL 65536
 
 namespace INDI
 {
@@ -53,66 +55,63 @@ SER_Recorder::SER_Recorder()
     // always default to. LITTLE_ENDIAN appears to be ignored by them leading to garbled data.
     serh.LittleEndian = SER_BIG_ENDIAN;
     isRecordingActive = false;
-    f = nullptr;
 
     jpegBuffer = static_cast<uint8_t*>(malloc(1));
 }
 
 SER_Recorder::~SER_Recorder()
 {
+    close();
     free(jpegBuffer);
 }
 
-bool SER_Recorder::is_little_endian()
+// SER integers are little endian whatever the host is
+static uint8_t *put_le32(uint8_t *out, uint32_t value)
 {
-    unsigned int magic        = 0x00000001;
-    unsigned char black_magic = *(unsigned char *)&magic;
-    return black_magic == 0x01;
+    for (int i = 0; i < 4; i++)
+        *out++ = static_cast<uint8_t>(value >> (8 * i));
+    return out;
 }
 
-void SER_Recorder::write_int_le(uint32_t *i)
+static uint8_t *put_le64(uint8_t *out, uint64_t value)
 {
-    if (is_little_endian())
-        fwrite((i), sizeof(uint32_t), 1, f);
-    else
-    {
-        unsigned char *c = (unsigned char *)i;
-        fwrite((c + 3), sizeof(char), 1, f);
-        fwrite((c + 2), sizeof(char), 1, f);
-        fwrite((c + 1), sizeof(char), 1, f);
-        fwrite((c), sizeof(char), 1, f);
-    }
+    for (int i = 0; i < 8; i++)
+        *out++ = static_cast<uint8_t>(value >> (8 * i));
+    return out;
 }
 
-void SER_Recorder::write_long_int_le(uint64_t *i)
+void SER_Recorder::encode_header(const ser_header *s, uint8_t *out)
 {
-    if (is_little_endian())
-    {
-        fwrite(((uint32_t *)i), sizeof(int), 1, f);
-        fwrite(((uint32_t *)(i) + 1), sizeof(int), 1, f);
-    }
-    else
-    {
-        write_int_le((uint32_t *)(i) + 1);
-        write_int_le((uint32_t *)(i));
-    }
+    memcpy(out, s->FileID, 14);
+    out = put_le32(out + 14, s->LuID);
+    out = put_le32(out, s->ColorID);
+    out = put_le32(out, s->LittleEndian);
+    out = put_le32(out, s->ImageWidth);
+    out = put_le32(out, s->ImageHeight);
+    out = put_le32(out, s->PixelDepth);
+    out = put_le32(out, s->FrameCount);
+    memcpy(out, s->Observer, 40);
+    memcpy(out + 40, s->Instrume, 40);
+    memcpy(out + 80, s->Telescope, 40);
+    out = put_le64(out + 120, s->DateTime);
+    put_le64(out, s->DateTime_UTC);
 }
 
-void SER_Recorder::write_header(ser_header *s)
+bool SER_Recorder::spill_timestamps()
 {
-    fwrite((s->FileID), sizeof(char), 14, f);
-    write_int_le(&(s->LuID));
-    write_int_le(&(s->ColorID));
-    write_int_le(&(s->LittleEndian));
-    write_int_le(&(s->ImageWidth));
-    write_int_le(&(s->ImageHeight));
-    write_int_le(&(s->PixelDepth));
-    write_int_le(&(s->FrameCount));
-    fwrite((s->Observer), sizeof(char), 40, f);
-    fwrite((s->Instrume), sizeof(char), 40, f);
-    fwrite((s->Telescope), sizeof(char), 40, f);
-    write_long_int_le(&(s->DateTime));
-    write_long_int_le(&(s->DateTime_UTC));
+    if (stampsFile == nullptr && (stampsFile = tmpfile()) == nullptr)
+        return false;
+
+    std::vector<uint8_t> buffer(frameStamps.size() * sizeof(uint64_t));
+    uint8_t *out = buffer.data();
+    for (auto value : frameStamps)
+        out = put_le64(out, value);
+
+    if (fwrite(buffer.data(), 1, buffer.size(), stampsFile) != buffer.size())
+        return false;
+
+    frameStamps.clear();
+    return true;
 }
 
 bool SER_Recorder::setPixelFormat(INDI_PIXEL_FORMAT pixelFormat, uint8_t pixelDepth)
@@ -175,41 +174,63 @@ bool SER_Recorder::open(const char *filename, char *errmsg)
     if (isRecordingActive)
         return false;
     serh.FrameCount = 0;
-    if ((f = fopen(filename, "w")) == nullptr)
+    std::string error;
+    if (!writer.open(filename, error))
     {
-        snprintf(errmsg, ERRMSGSIZ, "recorder open error %d, %s\n", errno, strerror(errno));
+        snprintf(errmsg, ERRMSGSIZ, "%s\n", error.c_str());
         return false;
     }
 
     serh.DateTime     = getLocalTimeStamp();
     serh.DateTime_UTC = getUTCTimeStamp();
-    write_header(&serh);
+    // Rewritten with the frame count on close
+    uint8_t header[SER_HEADER_SIZE];
+    encode_header(&serh, header);
+    writer.write(header, sizeof(header));
     frame_size        = serh.ImageWidth * serh.ImageHeight * (serh.PixelDepth <= 8 ? 1 : 2) * number_of_planes;
     isRecordingActive = true;
 
     frameStamps.clear();
+    frameStamps.reserve(STAMPS_PER_SPILL);
 
     return true;
 }
 
 bool SER_Recorder::close()
 {
-    if (f)
+    bool rc = true;
+    if (writer.isOpen())
     {
-        // Write all timestamps
-        for (auto value : frameStamps)
-            write_long_int_le(&value);
+        // Trailer: the timestamps spilled to the temporary file, then the others
+        if (stampsFile != nullptr)
+        {
+            uint8_t buffer[64 * 1024];
+            size_t nbytes;
+            rewind(stampsFile);
+            while ((nbytes = fread(buffer, 1, sizeof(buffer), stampsFile)) > 0)
+                writer.write(buffer, nbytes);
+        }
 
+        std::vector<uint8_t> trailer(frameStamps.size() * sizeof(uint64_t));
+        uint8_t *out = trailer.data();
+        for (auto value : frameStamps)
+            out = put_le64(out, value);
+        writer.write(trailer.data(), trailer.size());
         frameStamps.clear();
 
-        fseek(f, 0L, SEEK_SET);
-        write_header(&serh);
-        fclose(f);
-        f = nullptr;
+        uint8_t header[SER_HEADER_SIZE];
+        encode_header(&serh, header);
+        rc = writer.close(header, sizeof(header));
+    }
+
+    if (stampsFile != nullptr)
+    {
+        fclose(stampsFile);
+        stampsFile = nullptr;
     }
 
     isRecordingActive = false;
-    return true;
+    return rc;
 }
 
 bool SER_Recorder::writeFrame(const uint8_t *frame, uint32_t nbytes, uint64_t timestamp)
@@ -258,6 +279,10 @@ bool SER_Recorder::writeFrame(const uint8_t *frame, uint32_t nbytes, uint64_t ti
     else
         frameStamps.push_back(getUTCTimeStamp());
 
+    // Keep the memory used by timestamps bounded, however long the recording is
+    if (frameStamps.size() >= STAMPS_PER_SPILL)
+        spill_timestamps();
+
     // Not technically pixel format, but let's use this for now.
     if (m_PixelFormat == INDI_JPG)
     {
@@ -269,10 +294,11 @@ bool SER_Recorder::writeFrame(const uint8_t *frame, uint32_t nbytes, uint64_t ti
         serh.ImageWidth = w;
         serh.ImageHeight = h;
         serh.ColorID = (naxis == 3) ? SER_RGB : SER_MONO;
-        fwrite(jpegBuffer, 1, memsize, f);
+        if (!writer.write(jpegBuffer, memsize))
+            return false;
     }
-    else
-        fwrite(frame, 1, nbytes, f);
+    else if (!writer.write(frame, nbytes))
+        return false;
     serh.FrameCount += 1;
     return true;
 }
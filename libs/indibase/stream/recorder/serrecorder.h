@@ -22,6 +22,7 @@
 #pragma once
 
 #include "recorderinterface.h"
+#include "blockwriter.h"
 
 #include <cstdint>
 #include <stdio.h>
@@ -61,11 +62,18 @@ enum ser_color_id
 #define SER_BIG_ENDIAN    0
 #define SER_LITTLE_ENDIAN 1
 
+// Size of the header in the file
+#define SER_HEADER_SIZE 178
+
 namespace INDI
 {
 
 /**
  * @brief The SER_Recorder class implements recording of video streams in SER format.
+ *
+ * Frames are written by a BlockWriter thread, so writeFrame() only copies the frame unless the disk
+ * falls behind for longer than the writer buffer lasts. Frame timestamps are kept in memory in
+ * batches and spilled to a temporary file, they are appended to the recording when it is closed.
  */
 class SER_Recorder : public RecorderInterface
 {
@@ -88,22 +96,28 @@ class SER_Recorder : public RecorderInterface
             isStreamingActive = enable;
         }
 
+        /** @brief Statistics of the writer thread for the current or last recording */
+        BlockWriter::Statistics getWriterStatistics() const
+        {
+            return writer.statistics();
+        }
+
         // Public constants
         static const uint64_t C_SEPASECONDS_PER_SECOND = 10000000;
 
     protected:
         uint64_t utcTo64BitTS();
-        bool is_little_endian();
-        void write_int_le(uint32_t *i);
-        void write_long_int_le(uint64_t *i);
-        void write_header(ser_header *s);
+        void encode_header(const ser_header *s, uint8_t *out);
+        bool spill_timestamps();
         ser_header serh;
         bool isRecordingActive = false, isStreamingActive = false;
-        FILE *f;
+        BlockWriter writer;
         uint32_t frame_size;
         uint32_t number_of_planes;
         uint16_t rawWidth = 0, rawHeight = 0;
+        // Timestamps not spilled yet, and the temporary file holding the others
         std::vector<uint64_t> frameStamps;
+        FILE *stampsFile = nullptr;
 
     private:
         // From pipp_timestamp.h
@@ -28,7 +28,7 @@
 #include "indisensorinterface.h"
 #include "indilogger.h"
 #include "indiutility.h"
-#include "indisinglethreadpool.h"
+#include "indithreadpool.h"
 #include "indielapsedtimer.h"
 
 #include <cerrno>
@@ -296,11 +296,14 @@ void StreamManagerPrivate::newFrame(const uint8_t * buffer, uint32_t nbytes, uin
     {
         FpsNP[0].setValue(FPSFast.framesPerSecond());
         if (fastFPSUpdate.try_lock()) // don't block stream thread / record thread
-            std::thread([&]()
         {
-            FpsNP.apply();
-            fastFPSUpdate.unlock();
-        }).detach();
+            if (!fastFPSTasks.tryStart([this](const std::atomic_bool &)
+            {
+                FpsNP.apply();
+                fastFPSUpdate.unlock();
+            }, ThreadPool::PRIORITY_LOW))
+                fastFPSUpdate.unlock();
+        }
     }
 
     if (isStreaming || (isRecording && !isRecordingAboutToClose))
@@ -422,8 +425,9 @@ void StreamManagerPrivate::asyncStreamThread()
     std::vector<uint8_t> subframeBuffer;  // Subframe buffer for recording/streaming
     std::vector<uint8_t> downscaleBuffer; // Downscale buffer for streaming
 
-    INDI::SingleThreadPool previewThreadPool;
+    // Uploads of the preview, a frame that comes while one is sent replaces the one waiting
     INDI::ElapsedTimer previewElapsed;
+    INDI::TaskGroup previewTasks;
 
     while(!framesThreadTerminate)
     {
@@ -491,7 +495,7 @@ void StreamManagerPrivate::asyncStreamThread()
             }
 
             //uploadStream(sourceBuffer->data(), sourceBuffer->size());
-            previewThreadPool.start(std::bind([this, &previewElapsed](const std::atomic_bool & isAboutToQuit,
+            previewTasks.startLatest(std::bind([this, &previewElapsed](const std::atomic_bool & isAboutToQuit,
                                               std::vector<uint8_t> frame)
             {
                 INDI_UNUSED(isAboutToQuit);
@@ -835,7 +839,6 @@ bool StreamManagerPrivate::ISNewSwitch(const char * dev, const char * name, ISSt
         else
         {
             RecordStreamSP.setState(IPS_IDLE);
-            Format.clear();
             FpsNP[FPS_INSTANT].setValue(0);
             FpsNP[FPS_AVERAGE].setValue(0);
             if (isRecording)
@@ -1075,7 +1078,6 @@ bool StreamManagerPrivate::setStream(bool enable)
                 }
             }
             isStreaming = true;
-            Format.clear();
             FpsNP[FPS_INSTANT].setValue(0);
             FpsNP[FPS_AVERAGE].setValue(0);
             StreamSP.reset();
@@ -1086,7 +1088,6 @@ bool StreamManagerPrivate::setStream(bool enable)
     else
     {
         StreamSP.setState(IPS_IDLE);
-        Format.clear();
         FpsNP[FPS_INSTANT].setValue(0);
         FpsNP[FPS_AVERAGE].setValue(0);
         if (isStreaming)
@@ -1118,7 +1119,6 @@ bool StreamManagerPrivate::setStream(bool enable)
             StreamSP.reset();
             StreamSP[1].setState(ISS_ON);
             isStreaming = false;
-            Format.clear();
             FpsNP[FPS_INSTANT].setValue(0);
             FpsNP[FPS_AVERAGE].setValue(0);
 
@@ -1184,13 +1184,7 @@ bool StreamManagerPrivate::uploadStream(const uint8_t * buffer, uint32_t nbytes)
         if (dynamic_cast<INDI::CCD*>(currentDevice)->HasWebSocket()
                 && dynamic_cast<INDI::CCD*>(currentDevice)->WebSocketSP[CCD::WEBSOCKET_ENABLED].getState() == ISS_ON)
         {
-            if (Format != ".streajpg")
-            {
-                Format = ".streajpg";
-                dynamic_cast<INDI::CCD*>(currentDevice)->wsServer.send_text(Format);
-            }
-
-            dynamic_cast<INDI::CCD*>(currentDevice)->wsServer.send_binary(buffer, nbytes);
+            dynamic_cast<INDI::CCD*>(currentDevice)->wsServer.send_frame(".streajpg", buffer, nbytes, true);
             return true;
         }
 #endif
@@ -1221,13 +1215,7 @@ bool StreamManagerPrivate::uploadStream(const uint8_t * buffer, uint32_t nbytes)
             if (dynamic_cast<INDI::CCD*>(currentDevice)->HasWebSocket()
                     && dynamic_cast<INDI::CCD*>(currentDevice)->WebSocketSP[CCD::WEBSOCKET_ENABLED].getState() == ISS_ON)
             {
-                if (Format != ".stream")
-                {
-                    Format = ".stream";
-                    dynamic_cast<INDI::CCD*>(currentDevice)->wsServer.send_text(Format);
-                }
-
-                dynamic_cast<INDI::CCD*>(currentDevice)->wsServer.send_binary(buffer, nbytes);
+                dynamic_cast<INDI::CCD*>(currentDevice)->wsServer.send_frame(".stream", buffer, nbytes, true);
                 return true;
             }
 #endif
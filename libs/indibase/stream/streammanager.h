@@ -114,6 +114,8 @@ class StreamManager
     public:
         /**
          * @brief newFrame CCD drivers call this function when a new frame is received. It is then streamed, or recorded, or both according to the settings in the streamer.
+         * @param timestamp time the frame was captured, in microseconds since Jan 1, 1 AD as SER files store it.
+         * If zero, the frame is stamped when it is recorded.
          */
         void newFrame(const uint8_t *buffer, uint32_t nbytes, uint64_t timestamp = 0);
 
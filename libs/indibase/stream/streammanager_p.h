@@ -29,6 +29,7 @@
 #include "fpsmeter.h"
 #include "uniquequeue.h"
 #include "gammalut16.h"
+#include "indithreadpool.h"
 
 #include <atomic>
 #include <string>
@@ -242,7 +243,6 @@ class StreamManagerPrivate
         INDI_PIXEL_FORMAT PixelFormat = INDI_MONO;
         uint8_t PixelDepth = 8;
         uint16_t rawWidth = 0, rawHeight = 0;
-        std::string Format;
 
         // Processing for streaming
         typedef struct
@@ -257,6 +257,7 @@ class StreamManagerPrivate
         UniqueQueue<TimeFrame>   framesIncoming;
 
         std::mutex               fastFPSUpdate;
+        TaskGroup                fastFPSTasks;   // FPS updates sent off the stream thread
         std::mutex               recordMutex;
 
         GammaLut16               gammaLut16;
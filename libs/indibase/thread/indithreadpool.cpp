@@ -0,0 +1,468 @@
+/*
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "indithreadpool.h"
+#include "indithreadpool_p.h"
+
+#include <algorithm>
+
+namespace INDI
+{
+
+// The pool, thread and group of the function running on this thread
+static thread_local ThreadPoolPrivate *currentPool = nullptr;
+static thread_local size_t currentWorker = 0;
+static thread_local TaskGroupPrivate *currentGroup = nullptr;
+
+ThreadPoolPrivate::ThreadPoolPrivate(size_t threads, size_t maxQueued)
+    : threadCount(threads > 0 ? threads : std::max(2u, std::thread::hardware_concurrency()))
+    , maxQueued(std::max<size_t>(maxQueued, 1))
+    , isAboutToClose(std::make_shared<std::atomic_bool>(false))
+{
+    for (size_t i = 0; i < threadCount; i++)
+        workers.emplace_back(new Worker);
+}
+
+ThreadPoolPrivate::~ThreadPoolPrivate()
+{
+    quit();
+}
+
+void ThreadPoolPrivate::startThreads()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    if (isStarted || isThreadAboutToQuit)
+        return;
+
+    for (size_t i = 0; i < workers.size(); i++)
+        workers[i]->thread = std::thread(&ThreadPoolPrivate::workerLoop, this, i);
+    isStarted = true;
+}
+
+bool ThreadPoolPrivate::push(PoolTask &&task, int priority, bool wait)
+{
+    if (isThreadAboutToQuit)
+        return false;
+
+    if (!isStarted)
+        startThreads();
+
+    // Reserve room in the queues
+    size_t count = queued;
+    for (;;)
+    {
+        if (count < maxQueued)
+        {
+            if (queued.compare_exchange_weak(count, count + 1))
+                break;
+            continue;
+        }
+
+        if (!wait)
+            return false;
+
+        // Every thread may be waiting for room, run it here
+        if (currentPool == this)
+        {
+            run(currentWorker, task);
+            return true;
+        }
+
+        waited++;
+        std::unique_lock<std::mutex> guard(lock);
+        room.wait(guard, [this] { return queued < maxQueued || isThreadAboutToQuit; });
+        if (isThreadAboutToQuit)
+            return false;
+        count = queued;
+    }
+
+    size_t peak = queuedPeak;
+    while (count + 1 > peak && !queuedPeak.compare_exchange_weak(peak, count + 1));
+
+    // A function queued from a thread of the pool is likely to work on the same data, keep it on that thread
+    size_t index = currentPool == this ? currentWorker : next++ % workers.size();
+    {
+        std::lock_guard<std::mutex> guard(workers[index]->lock);
+        workers[index]->queues[priority].push_back(std::move(task));
+        queuedByPriority[priority]++;
+    }
+
+    if (idle > 0)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        work.notify_one();
+    }
+
+    // Queued while the pool quit, no thread will take it
+    if (isThreadAboutToQuit)
+        drop(nullptr);
+
+    return true;
+}
+
+// Takes the first function of the highest priority, from the queues of this thread first
+bool ThreadPoolPrivate::take(size_t index, PoolTask &task)
+{
+    for (int priority = 0; priority < ThreadPool::PRIORITY_COUNT; priority++)
+    {
+        if (queuedByPriority[priority] == 0)
+            continue;
+
+        for (size_t i = 0; i < workers.size(); i++)
+        {
+            Worker &worker = *workers[(index + i) % workers.size()];
+            std::unique_lock<std::mutex> guard(worker.lock);
+            auto &queue = worker.queues[priority];
+            if (queue.empty())
+                continue;
+
+            task = std::move(queue.front());
+            queue.pop_front();
+            queuedByPriority[priority]--;
+            guard.unlock();
+
+            if (i > 0)
+                stolen++;
+
+            if (queued.fetch_sub(1) >= maxQueued)
+            {
+                std::lock_guard<std::mutex> roomGuard(lock);
+                room.notify_all();
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPoolPrivate::run(size_t index, PoolTask &task)
+{
+    ThreadPool::Function function = std::move(task.function);
+
+    if (task.latest)
+    {
+        std::lock_guard<std::mutex> guard(task.group->lock);
+        // Otherwise the group quit since, the function was dropped
+        if (task.isAboutToClose == task.group->isAboutToClose)
+        {
+            function = std::move(task.group->latest);
+            task.group->latest = nullptr;
+            task.group->isLatestQueued = false;
+        }
+    }
+
+    if (function == nullptr || *task.isAboutToClose)
+        canceled++;
+    else
+    {
+        // quit() sets the flag of the running functions
+        std::shared_ptr<std::atomic_bool> previous;
+        {
+            std::lock_guard<std::mutex> guard(workers[index]->lock);
+            previous = workers[index]->isAboutToClose;
+            workers[index]->isAboutToClose = task.isAboutToClose;
+        }
+        TaskGroupPrivate *previousGroup = currentGroup;
+        currentGroup = task.group.get();
+
+        running++;
+        function(*task.isAboutToClose);
+        running--;
+        completed++;
+
+        currentGroup = previousGroup;
+        {
+            std::lock_guard<std::mutex> guard(workers[index]->lock);
+            workers[index]->isAboutToClose = previous;
+        }
+    }
+
+    if (task.group)
+        task.group->finished();
+}
+
+void ThreadPoolPrivate::workerLoop(size_t index)
+{
+    currentPool = this;
+    currentWorker = index;
+
+    for (;;)
+    {
+        PoolTask task;
+        if (take(index, task))
+        {
+            run(index, task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> guard(lock);
+        idle++;
+        work.wait(guard, [this] { return queued > 0 || isThreadAboutToQuit; });
+        idle--;
+        if (isThreadAboutToQuit)
+            break;
+    }
+}
+
+void ThreadPoolPrivate::drop(const std::shared_ptr<std::atomic_bool> &isAboutToClose)
+{
+    std::vector<PoolTask> dropped;
+
+    for (auto &worker : workers)
+    {
+        std::lock_guard<std::mutex> guard(worker->lock);
+        for (int priority = 0; priority < ThreadPool::PRIORITY_COUNT; priority++)
+        {
+            auto &queue = worker->queues[priority];
+            for (auto it = queue.begin(); it != queue.end();)
+            {
+                if (isAboutToClose != nullptr && it->isAboutToClose != isAboutToClose)
+                {
+                    ++it;
+                    continue;
+                }
+                dropped.push_back(std::move(*it));
+                it = queue.erase(it);
+                queuedByPriority[priority]--;
+            }
+        }
+    }
+
+    if (dropped.empty())
+        return;
+
+    queued -= dropped.size();
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        room.notify_all();
+    }
+
+    for (auto &task : dropped)
+    {
+        canceled++;
+        if (task.group == nullptr)
+            continue;
+
+        if (task.latest)
+        {
+            std::lock_guard<std::mutex> guard(task.group->lock);
+            if (task.isAboutToClose == task.group->isAboutToClose)
+            {
+                task.group->latest = nullptr;
+                task.group->isLatestQueued = false;
+            }
+        }
+        task.group->finished();
+    }
+}
+
+void ThreadPoolPrivate::quit()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        isThreadAboutToQuit = true;
+        work.notify_all();
+        room.notify_all();
+    }
+
+    *isAboutToClose = true;
+    for (auto &worker : workers)
+    {
+        std::lock_guard<std::mutex> guard(worker->lock);
+        if (worker->isAboutToClose)
+            *worker->isAboutToClose = true;
+    }
+
+    drop(nullptr);
+
+    for (auto &worker : workers)
+    {
+        if (!worker->thread.joinable())
+            continue;
+        // Quit from a function of the pool, the thread ends when the function returns
+        if (worker->thread.get_id() == std::this_thread::get_id())
+            worker->thread.detach();
+        else
+            worker->thread.join();
+    }
+
+    drop(nullptr);
+}
+
+ThreadPool::ThreadPool(size_t threads, size_t maxQueued)
+    : d_ptr(new ThreadPoolPrivate(threads, maxQueued))
+{ }
+
+ThreadPool::~ThreadPool()
+{
+    quit();
+}
+
+ThreadPool &ThreadPool::instance()
+{
+    // Never destroyed: drivers call exit() from any thread, possibly holding a lock a function of the pool waits for
+    static ThreadPool *pool = new ThreadPool();
+    return *pool;
+}
+
+bool ThreadPool::start(const Function &functionToRun, Priority priority)
+{
+    D_PTR(ThreadPool);
+    return d->push(PoolTask{functionToRun, d->isAboutToClose, nullptr, false}, priority, true);
+}
+
+bool ThreadPool::tryStart(const Function &functionToRun, Priority priority)
+{
+    D_PTR(ThreadPool);
+    return d->push(PoolTask{functionToRun, d->isAboutToClose, nullptr, false}, priority, false);
+}
+
+ThreadPool::Stats ThreadPool::stats() const
+{
+    D_PTR(const ThreadPool);
+    Stats stats;
+    stats.threads = d->isStarted ? d->threadCount : 0;
+    stats.running = d->running;
+    for (int priority = 0; priority < PRIORITY_COUNT; priority++)
+        stats.queued[priority] = d->queuedByPriority[priority];
+    stats.queuedPeak = d->queuedPeak;
+    stats.completed = d->completed;
+    stats.canceled = d->canceled;
+    stats.stolen = d->stolen;
+    stats.waited = d->waited;
+    return stats;
+}
+
+void ThreadPool::quit()
+{
+    D_PTR(ThreadPool);
+    d->quit();
+}
+
+TaskGroupPrivate::TaskGroupPrivate(const std::shared_ptr<ThreadPoolPrivate> &pool)
+    : pool(pool)
+    , isAboutToClose(std::make_shared<std::atomic_bool>(false))
+{ }
+
+bool TaskGroupPrivate::start(const std::shared_ptr<TaskGroupPrivate> &self, const ThreadPool::Function &functionToRun,
+                             int priority, bool wait, bool isLatest)
+{
+    PoolTask task;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (isLatest && isLatestQueued)
+        {
+            // The one replaced never runs
+            latest = functionToRun;
+            pool->canceled++;
+            return true;
+        }
+
+        pending++;
+        task.isAboutToClose = isAboutToClose;
+        if (isLatest)
+        {
+            latest = functionToRun;
+            isLatestQueued = true;
+        }
+        else
+            task.function = functionToRun;
+    }
+    task.group = self;
+    task.latest = isLatest;
+
+    if (pool->push(std::move(task), priority, wait))
+        return true;
+
+    std::lock_guard<std::mutex> guard(lock);
+    if (isLatest)
+    {
+        latest = nullptr;
+        isLatestQueued = false;
+    }
+    pending--;
+    done.notify_all();
+    return false;
+}
+
+void TaskGroupPrivate::finished()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    pending--;
+    done.notify_all();
+}
+
+TaskGroup::TaskGroup(ThreadPool &pool)
+    : d_ptr(new TaskGroupPrivate(pool.d_ptr))
+{ }
+
+TaskGroup::~TaskGroup()
+{
+    quit();
+}
+
+bool TaskGroup::start(const ThreadPool::Function &functionToRun, ThreadPool::Priority priority)
+{
+    D_PTR(TaskGroup);
+    return d->start(d_ptr, functionToRun, priority, true, false);
+}
+
+bool TaskGroup::tryStart(const ThreadPool::Function &functionToRun, ThreadPool::Priority priority)
+{
+    D_PTR(TaskGroup);
+    return d->start(d_ptr, functionToRun, priority, false, false);
+}
+
+bool TaskGroup::startLatest(const ThreadPool::Function &functionToRun, ThreadPool::Priority priority)
+{
+    D_PTR(TaskGroup);
+    return d->start(d_ptr, functionToRun, priority, true, true);
+}
+
+size_t TaskGroup::pending() const
+{
+    D_PTR(const TaskGroup);
+    std::lock_guard<std::mutex> guard(d->lock);
+    return d->pending;
+}
+
+void TaskGroup::wait()
+{
+    D_PTR(TaskGroup);
+    // A function of the group may wait for the others
+    size_t self = currentGroup == d ? 1 : 0;
+    std::unique_lock<std::mutex> guard(d->lock);
+    d->done.wait(guard, [d, self] { return d->pending <= self; });
+}
+
+void TaskGroup::quit()
+{
+    D_PTR(TaskGroup);
+    std::shared_ptr<std::atomic_bool> isAboutToClose;
+    {
+        std::lock_guard<std::mutex> guard(d->lock);
+        isAboutToClose = d->isAboutToClose;
+        d->isAboutToClose = std::make_shared<std::atomic_bool>(false);
+        d->latest = nullptr;
+        d->isLatestQueued = false;
+    }
+
+    *isAboutToClose = true;
+    d->pool->drop(isAboutToClose);
+    wait();
+}
+
+}
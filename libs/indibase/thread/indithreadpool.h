@@ -0,0 +1,136 @@
+/*
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#pragma once
+
+#include "indimacros.h"
+#include <memory>
+#include <functional>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace INDI
+{
+
+class ThreadPoolPrivate;
+/**
+ * @brief A bounded pool of threads for the background work of every driver of a process.
+ *
+ * Each thread has its own queues and takes functions from the queues of the other threads once its own are
+ * empty. Functions of a higher priority are taken first. The number of functions waiting for a thread is
+ * bounded, start() waits for room when the pool is full.
+ *
+ * As with SingleThreadPool, a running function can check the 'isAboutToClose' flag and decide whether to end
+ * the work. Use a TaskGroup to cancel the functions working on one object together.
+ */
+class ThreadPool
+{
+        DECLARE_PRIVATE(ThreadPool)
+        friend class TaskGroup;
+    public:
+        typedef std::function<void(const std::atomic_bool &isAboutToClose)> Function;
+
+        enum Priority
+        {
+            PRIORITY_HIGH,
+            PRIORITY_NORMAL,
+            PRIORITY_LOW,
+            PRIORITY_COUNT
+        };
+
+        /** @brief Queue depth and counters of the pool. */
+        struct Stats
+        {
+            size_t threads;                 /**< threads of the pool, 0 until first used */
+            size_t running;                 /**< functions running now */
+            size_t queued[PRIORITY_COUNT];  /**< functions waiting for a thread, by priority */
+            size_t queuedPeak;              /**< most functions that waited at once */
+            uint64_t completed;             /**< functions that ran */
+            uint64_t canceled;              /**< functions dropped before they ran */
+            uint64_t stolen;                /**< functions run by another thread than the one they were queued on */
+            uint64_t waited;                /**< calls of start() that waited for room */
+        };
+
+    public:
+        /** @brief threads 0 for one per processor, at least two. maxQueued bounds the functions waiting for a thread. */
+        explicit ThreadPool(size_t threads = 0, size_t maxQueued = 1024);
+        ~ThreadPool();
+
+        /** @return the pool shared by the drivers of the process. Its threads start when first used and are not
+         *  joined when the process exits. */
+        static ThreadPool &instance();
+
+    public:
+        /** @brief Queues functionToRun, waiting for room when the pool is full. On a thread of the pool, a full pool runs
+         *  functionToRun right away instead, so that functions queueing others never wait for each other.
+         *  @return false if the pool quit. */
+        bool start(const Function &functionToRun, Priority priority = PRIORITY_NORMAL);
+
+        /** @brief If the pool is full at the time of calling, then this function does nothing and returns false.
+         *  Otherwise, functionToRun is queued and this function returns true. */
+        bool tryStart(const Function &functionToRun, Priority priority = PRIORITY_NORMAL);
+
+        /** @return the queue depth and counters of the pool. */
+        Stats stats() const;
+
+    public:
+        /** @brief Drops the functions waiting, sets the 'isAboutToClose' flag of the running ones and waits for them. */
+        void quit();
+
+    protected:
+        std::shared_ptr<ThreadPoolPrivate> d_ptr;
+};
+
+class TaskGroupPrivate;
+/**
+ * @brief Functions working on one object, run on a ThreadPool, that are canceled and waited for together.
+ * The group quits when destroyed, it can be a member of the object its functions work on.
+ */
+class TaskGroup
+{
+        DECLARE_PRIVATE(TaskGroup)
+    public:
+        explicit TaskGroup(ThreadPool &pool = ThreadPool::instance());
+        ~TaskGroup();
+
+    public:
+        /** @brief As ThreadPool::start(), for a function of the group. */
+        bool start(const ThreadPool::Function &functionToRun, ThreadPool::Priority priority = ThreadPool::PRIORITY_NORMAL);
+
+        /** @brief As ThreadPool::tryStart(), for a function of the group. */
+        bool tryStart(const ThreadPool::Function &functionToRun, ThreadPool::Priority priority = ThreadPool::PRIORITY_NORMAL);
+
+        /** @brief As start(), but a function given to startLatest() that still waits for a thread is replaced by functionToRun,
+         *  so that a slow function is given the most recent of the data that came while it ran. */
+        bool startLatest(const ThreadPool::Function &functionToRun,
+                         ThreadPool::Priority priority = ThreadPool::PRIORITY_NORMAL);
+
+        /** @return the functions of the group waiting or running. */
+        size_t pending() const;
+
+        /** @brief Waits until no function of the group waits or runs. */
+        void wait();
+
+    public:
+        /** @brief Drops the functions of the group waiting, sets the 'isAboutToClose' flag of the running ones and waits for them.
+         *  Functions started after run as usual. */
+        void quit();
+
+    protected:
+        std::shared_ptr<TaskGroupPrivate> d_ptr;
+};
+
+}
@@ -0,0 +1,112 @@
+/*
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#pragma once
+
+#include "indithreadpool.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <deque>
+#include <vector>
+
+namespace INDI
+{
+
+class TaskGroupPrivate;
+
+// A function waiting for a thread
+struct PoolTask
+{
+    ThreadPool::Function function;
+    std::shared_ptr<std::atomic_bool> isAboutToClose;
+    std::shared_ptr<TaskGroupPrivate> group;  // nullptr for ThreadPool::start()
+    bool latest {false};                      // the function is the one TaskGroup::startLatest() gave last
+};
+
+class ThreadPoolPrivate
+{
+    public:
+        ThreadPoolPrivate(size_t threads, size_t maxQueued);
+        virtual ~ThreadPoolPrivate();
+
+        // Queues task, waiting for room if wait is set. Returns false if it could not
+        bool push(PoolTask &&task, int priority, bool wait);
+        // Drops the tasks waiting that are canceled with isAboutToClose, or all of them if nullptr
+        void drop(const std::shared_ptr<std::atomic_bool> &isAboutToClose);
+        void quit();
+
+        struct Worker
+        {
+            std::mutex lock;
+            std::deque<PoolTask> queues[ThreadPool::PRIORITY_COUNT];
+            std::shared_ptr<std::atomic_bool> isAboutToClose;  // of the function running
+            std::thread thread;
+        };
+
+        void startThreads();
+        void workerLoop(size_t index);
+        bool take(size_t index, PoolTask &task);
+        void run(size_t index, PoolTask &task);
+
+        size_t threadCount;
+        size_t maxQueued;
+        std::vector<std::unique_ptr<Worker>> workers;
+        std::atomic_bool isStarted {false};
+        std::atomic_bool isThreadAboutToQuit {false};
+        std::shared_ptr<std::atomic_bool> isAboutToClose;  // of the functions given to ThreadPool::start()
+
+        // Counted without the lock, the lock is taken only to sleep and wake up
+        std::atomic<size_t> queued {0};
+        std::atomic<size_t> queuedByPriority[ThreadPool::PRIORITY_COUNT] {};
+        std::atomic<size_t> queuedPeak {0};
+        std::atomic<size_t> running {0};
+        std::atomic<size_t> idle {0};
+        std::atomic<size_t> next {0};
+        std::atomic<uint64_t> completed {0};
+        std::atomic<uint64_t> canceled {0};
+        std::atomic<uint64_t> stolen {0};
+        std::atomic<uint64_t> waited {0};
+
+        std::mutex lock;
+        std::condition_variable work;
+        std::condition_variable room;
+};
+
+class TaskGroupPrivate
+{
+    public:
+        explicit TaskGroupPrivate(const std::shared_ptr<ThreadPoolPrivate> &pool);
+        virtual ~TaskGroupPrivate() = default;
+
+        bool start(const std::shared_ptr<TaskGroupPrivate> &self, const ThreadPool::Function &functionToRun, int priority,
+                   bool wait, bool isLatest);
+        // A function of the group ran or was dropped
+        void finished();
+
+        std::shared_ptr<ThreadPoolPrivate> pool;
+
+        mutable std::mutex lock;
+        std::condition_variable done;
+        size_t pending {0};
+        std::shared_ptr<std::atomic_bool> isAboutToClose;
+        ThreadPool::Function latest;
+        bool isLatestQueued {false};
+};
+
+}
@@ -19,6 +19,8 @@
 #include "indielapsedtimer.h"
 #include "indielapsedtimer_p.h"
 
+#include "eventloop.h"
+
 namespace INDI
 {
 
@@ -40,14 +42,14 @@ ElapsedTimer::~ElapsedTimer()
 void ElapsedTimer::start()
 {
     D_PTR(ElapsedTimer);
-    d->start = std::chrono::steady_clock::now();
+    d->start = clockNow();
 }
 
 int64_t ElapsedTimer::restart()
 {
     D_PTR(ElapsedTimer);
-    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
-    int64_t result = std::chrono::duration_cast<std::chrono::milliseconds>(now - d->start).count();
+    double now = clockNow();
+    int64_t result = static_cast<int64_t>(now - d->start);
     d->start = now;
     return result;
 }
@@ -55,15 +57,13 @@ int64_t ElapsedTimer::restart()
 int64_t ElapsedTimer::elapsed() const
 {
     D_PTR(const ElapsedTimer);
-    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
-    return std::chrono::duration_cast<std::chrono::milliseconds>(now - d->start).count();
+    return static_cast<int64_t>(clockNow() - d->start);
 }
 
 int64_t ElapsedTimer::nsecsElapsed() const
 {
     D_PTR(const ElapsedTimer);
-    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
-    return std::chrono::duration_cast<std::chrono::nanoseconds>(now - d->start).count();
+    return static_cast<int64_t>((clockNow() - d->start) * 1000000.0);
 }
 
 bool ElapsedTimer::hasExpired(int64_t timeout) const
@@ -74,7 +74,7 @@ bool ElapsedTimer::hasExpired(int64_t timeout) const
 void ElapsedTimer::nsecsRewind(int64_t nsecs)
 {
     D_PTR(ElapsedTimer);
-    d->start += std::chrono::nanoseconds(nsecs);
+    d->start += nsecs / 1000000.0;
 }
 
 }
@@ -31,6 +31,8 @@ class ElapsedTimerPrivate;
  * @brief The ElapsedTimer class provides a fast way to calculate elapsed times.
  *
  * The ElapsedTimer class is usually used to quickly calculate how much time has elapsed between two events.
+ * Time is read from the clock of the event loop, which runs faster or in steps when the driver is run on a
+ * virtual clock, see IESetClock().
  */
 class ElapsedTimer
 {
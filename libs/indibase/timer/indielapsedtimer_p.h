@@ -18,15 +18,14 @@
 
 #pragma once
 
-#include <chrono>
-
 namespace INDI
 {
 
 class ElapsedTimerPrivate
 {
     public:
-        std::chrono::steady_clock::time_point start;
+        /* milliseconds on the clock of the event loop, see clockNow() */
+        double start;
 };
 
 }
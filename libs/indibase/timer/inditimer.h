@@ -36,6 +36,8 @@ class TimerPrivate;
  *
  * You can set a timer to time out only once by calling setSingleShot(true).
  * You can also use the static Timer::singleShot() function to call a function after a specified interval.
+ *
+ * Intervals are measured on the clock of the event loop, see IESetClock().
  */
 class Timer
 {
@@ -37,6 +37,7 @@
 #include <sys/stat.h>
 #include <assert.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <unistd.h>
 #include <stdio.h>
 #include <cerrno>
@@ -184,6 +185,7 @@ V4L2_Base::V4L2_Base()
 
 V4L2_Base::~V4L2_Base()
 {
+    stopCaptureThread();
     delete v4l2_decode;
 }
 
@@ -390,6 +392,7 @@ void V4L2_Base::disconnectCam(bool stopcapture)
 {
     if (selectCallBackID != -1)
         rmCallback(selectCallBackID);
+    stopCaptureThread();
 
     if (stopcapture)
     {
@@ -546,8 +549,15 @@ int V4L2_Base::read_frame(char * errmsg)
             DEBUGFDEVICE(deviceName, INDI::Logger::DBG_DEBUG, "%s: buffer #%d dequeued from fd:%d\n", __FUNCTION__,
                          buf.index, fd);
 
+            /* The kernel numbers every frame, including those it had no free buffer for */
+            if (lastSequence >= 0 && buf.sequence > lastSequence + 1)
+                droppedFrames += buf.sequence - lastSequence - 1;
+            lastSequence = buf.sequence;
+            capturedFrames++;
+
             if (buf.flags & V4L2_BUF_FLAG_ERROR)
             {
+                droppedFrames++;
                 DEBUGFDEVICE(deviceName, INDI::Logger::DBG_DEBUG,
                              "%s: recoverable error with DQBUF ioctl (BUF_FLAG_ERROR) - frame should be dropped",
                              __FUNCTION__);
@@ -562,6 +572,7 @@ int V4L2_Base::read_frame(char * errmsg)
                 DEBUGFDEVICE(deviceName, INDI::Logger::DBG_DEBUG,
                              "%s: frame is %d-byte long, expected %d - frame should be dropped", __FUNCTION__,
                              buf.bytesused, fmt.fmt.pix.sizeimage);
+                droppedFrames++;
 
                 if (false)
                 {
@@ -584,6 +595,12 @@ int V4L2_Base::read_frame(char * errmsg)
                 return 0;
             }
 
+            {
+                struct timeval now = { 0, 0 };
+                gettimeofday(&now, nullptr);
+                frameTimestamp = now.tv_sec * 1000000ULL + now.tv_usec;
+            }
+
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(3, 15, 0))
             /* TODO: the timestamp can be checked against the expected exposure to validate the frame - doesn't work, yet */
             switch (buf.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK)
@@ -616,6 +633,12 @@ int V4L2_Base::read_frame(char * errmsg)
                         DEBUGFDEVICE(deviceName, INDI::Logger::DBG_DEBUG, "%s: unsupported timestamp in frame",
                                      __FUNCTION__);
 
+                    /* Stamp the frame with the time of the wall clock that was that long ago */
+                    int64_t const age = (uptime.tv_sec - buf.timestamp.tv_sec) * 1000000LL + uptime.tv_nsec / 1000 -
+                                        buf.timestamp.tv_usec;
+                    if (age > 0 && static_cast<uint64_t>(age) < frameTimestamp)
+                        frameTimestamp -= age;
+
                     break;
                 }
 
@@ -727,6 +750,7 @@ int V4L2_Base::stop_capturing(char * errmsg)
                 IERmCallback(selectCallBackID);
                 selectCallBackID = -1;
             }
+            stopCaptureThread();
             streamactive = false;
             if (-1 == XIOCTL(fd, VIDIOC_STREAMOFF, &type))
                 return errno_exit("VIDIOC_STREAMOFF", errmsg);
@@ -771,8 +795,14 @@ int V4L2_Base::start_capturing(char * errmsg)
             if (-1 == XIOCTL(fd, VIDIOC_STREAMON, &type))
                 return errno_exit("VIDIOC_STREAMON", errmsg);
 
-            selectCallBackID = IEAddCallback(fd, newFrame, this);
-            streamactive     = true;
+            lastSequence   = -1;
+            capturedFrames = 0;
+            droppedFrames  = 0;
+            streamactive   = true;
+            if (useCaptureThread)
+                startCaptureThread();
+            else
+                selectCallBackID = IEAddCallback(fd, newFrame, this);
 
             break;
 
@@ -812,6 +842,134 @@ void V4L2_Base::newFrame(int /*fd*/, void * p)
     ((V4L2_Base *)(p))->read_frame(errmsg);
 }
 
+int V4L2_Base::setBufferCount(unsigned int count, char * errmsg)
+{
+    if (streamactive)
+    {
+        snprintf(errmsg, ERRMSGSIZ, "Cannot change the number of buffers while capturing");
+        return -1;
+    }
+
+    if (count == bufferCount)
+        return 0;
+
+    bufferCount = count;
+
+    /* The buffers are requested when capture starts first, after that the device must be reopened to free them */
+    if (streamedonce)
+    {
+        close_device();
+
+        if (open_device(path, errmsg))
+        {
+            DEBUGFDEVICE(deviceName, INDI::Logger::DBG_DEBUG, "%s: failed reopening device %s (%s)", __FUNCTION__, path,
+                         errmsg);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void V4L2_Base::setCaptureThread(bool enable)
+{
+    if (enable == useCaptureThread)
+        return;
+
+    useCaptureThread = enable;
+    if (!streamactive || io != IO_METHOD_MMAP)
+        return;
+
+    if (enable)
+    {
+        if (selectCallBackID != -1)
+        {
+            IERmCallback(selectCallBackID);
+            selectCallBackID = -1;
+        }
+        startCaptureThread();
+    }
+    else
+    {
+        stopCaptureThread();
+        selectCallBackID = IEAddCallback(fd, newFrame, this);
+    }
+}
+
+V4L2_Base::CaptureControl::~CaptureControl()
+{
+    if (wake[0] != -1)
+        close(wake[0]);
+    if (wake[1] != -1)
+        close(wake[1]);
+}
+
+void V4L2_Base::startCaptureThread()
+{
+    auto control = std::make_shared<CaptureControl>();
+    if (-1 == pipe(control->wake))
+    {
+        DEBUGFDEVICE(deviceName, INDI::Logger::DBG_WARNING, "Cannot start the capture thread, %s", strerror(errno));
+        selectCallBackID = IEAddCallback(fd, newFrame, this);
+        return;
+    }
+
+    captureControl  = control;
+    captureThread   = std::thread(&V4L2_Base::captureLoop, this, control);
+    captureThreadId = captureThread.get_id();
+}
+
+void V4L2_Base::stopCaptureThread()
+{
+    if (!captureThread.joinable())
+        return;
+
+    captureControl->stop = true;
+    if (write(captureControl->wake[1], "", 1) != 1)
+        DEBUGFDEVICE(deviceName, INDI::Logger::DBG_DEBUG, "%s: %s", __FUNCTION__, strerror(errno));
+
+    /* Stopped by the frame callback or an error while reading, the loop ends when read_frame() returns */
+    if (isCaptureThread())
+        captureThread.detach();
+    else
+        captureThread.join();
+    captureThreadId = std::thread::id();
+    captureControl.reset();
+}
+
+void V4L2_Base::captureLoop(std::shared_ptr<CaptureControl> control)
+{
+    char errmsg[ERRMSGSIZ];
+    struct pollfd fds[2];
+
+    captureThreadId = std::this_thread::get_id();
+
+    fds[0].fd     = fd;
+    fds[0].events = POLLIN;
+    fds[1].fd     = control->wake[0];
+    fds[1].events = POLLIN;
+
+    while (!control->stop)
+    {
+        if (-1 == poll(fds, 2, -1))
+        {
+            if (errno == EINTR)
+                continue;
+            DEBUGFDEVICE(deviceName, INDI::Logger::DBG_ERROR, "Capture thread stopped, %s", strerror(errno));
+            break;
+        }
+
+        if (fds[1].revents)
+            break;
+
+        if (fds[0].revents & (POLLIN | POLLERR))
+            read_frame(errmsg);
+
+        /* The device went away, or is no longer streaming */
+        if (fds[0].revents & (POLLERR | POLLHUP | POLLNVAL))
+            break;
+    }
+}
+
 int V4L2_Base::uninit_device(char * errmsg)
 {
     switch (io)
@@ -863,7 +1021,7 @@ int V4L2_Base::init_mmap(char * errmsg)
 
     CLEAR(req);
 
-    req.count = 4;
+    req.count = bufferCount;
     //req.count               = 1;
     req.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE;
     req.memory = V4L2_MEMORY_MMAP;
@@ -882,6 +1040,10 @@ int V4L2_Base::init_mmap(char * errmsg)
         }
     }
 
+    if (req.count != bufferCount)
+        DEBUGFDEVICE(deviceName, INDI::Logger::DBG_DEBUG, "%s: %d buffers requested, %d allocated", __FUNCTION__,
+                     bufferCount, req.count);
+
     if (req.count < 2)
     {
         fprintf(stderr, "Insufficient buffer memory on %.*s\n", (int)sizeof(dev_name), dev_name);
@@ -36,7 +36,10 @@
 
 #include <stdio.h>
 #include <cstdlib>
+#include <atomic>
 #include <map>
+#include <memory>
+#include <thread>
 
 #include <dirent.h>
 #ifdef __OpenBSD__
@@ -113,6 +116,41 @@ class V4L2_Base
         int stop_capturing(char *errmsg);
         static void newFrame(int fd, void *p);
 
+        /* Buffers the kernel fills while frames wait to be read, 4 by default. Used when capture next starts */
+        int setBufferCount(unsigned int count, char *errmsg);
+        unsigned int getBufferCount() const
+        {
+            return bufferCount;
+        }
+
+        /* Dequeue MMAP frames on a thread of their own instead of the event loop, the frame callback is then called
+         * on that thread. Switches a running capture over, call from the event loop */
+        void setCaptureThread(bool enable);
+        bool isCaptureThread() const
+        {
+            return captureThreadId.load() == std::this_thread::get_id();
+        }
+        /* Whether frames are being dequeued on the capture thread, the frame geometry and format must not change then */
+        bool isCaptureThreadRunning() const
+        {
+            return captureThreadId.load() != std::thread::id();
+        }
+
+        /* Time the kernel stamped the last frame with, microseconds since the Unix epoch */
+        uint64_t getFrameTimestamp() const
+        {
+            return frameTimestamp;
+        }
+        /* Frames since capture started, and those of them lost: skipped in the kernel sequence or corrupted */
+        uint32_t getCapturedFrames() const
+        {
+            return capturedFrames;
+        }
+        uint32_t getDroppedFrames() const
+        {
+            return droppedFrames;
+        }
+
         //void setDropFrameCount(unsigned int count) { dropFrameCount = count;}
         void enumerate_ctrl();
         void enumerate_menu();
@@ -175,6 +213,19 @@ class V4L2_Base
 
         void findMinMax();
 
+        /* Stop request and wake-up pipe of one capture thread. The thread keeps its own, so one that stopped itself
+         * still ends even if another starts meanwhile */
+        struct CaptureControl
+        {
+            std::atomic<bool> stop {false};
+            int wake[2] {-1, -1};
+            ~CaptureControl();
+        };
+
+        void startCaptureThread();
+        void stopCaptureThread();
+        void captureLoop(std::shared_ptr<CaptureControl> control);
+
         int enumeratedInputs;
         int enumeratedCaptureFormats;
 
@@ -221,6 +272,17 @@ class V4L2_Base
         struct v4l2_fract frameRate;
         int xmax, xmin, ymax, ymin;
         int selectCallBackID;
+
+        unsigned int bufferCount {4};
+        bool useCaptureThread {false};
+        std::thread captureThread;
+        std::atomic<std::thread::id> captureThreadId {std::thread::id()};
+        std::shared_ptr<CaptureControl> captureControl;
+
+        uint64_t frameTimestamp {0};
+        int64_t lastSequence {-1};
+        std::atomic<uint32_t> capturedFrames {0};
+        std::atomic<uint32_t> droppedFrames {0};
         //unsigned char * YBuf,*UBuf,*VBuf, *yuvBuffer, *colorBuffer, *rgb24_buffer, *cropbuf;
 
         V4L2_Decode *v4l2_decode;
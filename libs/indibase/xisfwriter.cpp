@@ -0,0 +1,372 @@
+/**  INDI LIB
+ *   Streaming XISF writer
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Lesser General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2.1 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "xisfwriter.h"
+#include "sharedblob.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+
+#include <unistd.h>
+#include <zlib.h>
+
+// Signature, header length and reserved field
+#define XISF_PREAMBLE 16
+// The attachment starts on a page boundary
+#define XISF_ALIGNMENT 4096
+
+namespace INDI
+{
+
+class XISFWriter::Output
+{
+    public:
+        virtual ~Output() = default;
+        virtual bool write(uint64_t offset, const void *data, size_t len) = 0;
+        /** @brief Expected size of the file */
+        virtual void reserve(size_t) {}
+
+        std::string error;
+};
+
+class XISFWriter::BlobOutput : public XISFWriter::Output
+{
+    public:
+        ~BlobOutput() override
+        {
+            IDSharedBlobFree(m_Blob);
+        }
+
+        bool write(uint64_t offset, const void *data, size_t len) override
+        {
+            if (offset + len > m_Capacity)
+            {
+                size_t capacity = std::max<size_t>(offset + len, m_Capacity + m_Capacity / 2);
+                void *blob = (m_Blob == nullptr) ? IDSharedBlobAlloc(capacity) : IDSharedBlobRealloc(m_Blob, capacity);
+                if (blob == nullptr)
+                {
+                    error = "cannot allocate " + std::to_string(capacity) + " bytes";
+                    return false;
+                }
+                m_Blob = blob;
+                m_Capacity = capacity;
+            }
+            memcpy(static_cast<uint8_t *>(m_Blob) + offset, data, len);
+            m_Size = std::max<size_t>(m_Size, offset + len);
+            return true;
+        }
+
+        void reserve(size_t capacity) override
+        {
+            if (m_Blob == nullptr)
+            {
+                m_Blob = IDSharedBlobAlloc(capacity);
+                m_Capacity = (m_Blob != nullptr) ? capacity : 0;
+            }
+        }
+
+        void release(void *&blob, size_t &size)
+        {
+            blob = m_Blob;
+            size = m_Size;
+            m_Blob = nullptr;
+        }
+
+    private:
+        void *m_Blob {nullptr};
+        size_t m_Capacity {0};
+        size_t m_Size {0};
+};
+
+class XISFWriter::FileOutput : public XISFWriter::Output
+{
+    public:
+        explicit FileOutput(int fd) : m_FD(fd) {}
+
+        bool write(uint64_t offset, const void *data, size_t len) override
+        {
+            auto bytes = static_cast<const uint8_t *>(data);
+            while (len > 0)
+            {
+                ssize_t written = ::pwrite(m_FD, bytes, len, offset);
+                if (written < 0)
+                {
+                    if (errno == EINTR)
+                        continue;
+                    error = "write error " + std::to_string(errno) + ", " + strerror(errno);
+                    return false;
+                }
+                bytes += written;
+                offset += written;
+                len -= written;
+            }
+            return true;
+        }
+
+    private:
+        int m_FD;
+};
+
+namespace
+{
+
+std::string escaped(const std::string &text)
+{
+    std::string result;
+    result.reserve(text.size());
+    for (char c : text)
+    {
+        switch (c)
+        {
+            case '&':
+                result += "&amp;";
+                break;
+            case '<':
+                result += "&lt;";
+                break;
+            case '>':
+                result += "&gt;";
+                break;
+            case '"':
+                result += "&quot;";
+                break;
+            case '\'':
+                result += "&apos;";
+                break;
+            default:
+                // Control characters are not allowed in XML 1.0
+                if (static_cast<unsigned char>(c) >= 32 || c == '\t')
+                    result += c;
+        }
+    }
+    return result;
+}
+
+uint64_t aligned(uint64_t offset)
+{
+    return (offset + XISF_ALIGNMENT - 1) / XISF_ALIGNMENT * XISF_ALIGNMENT;
+}
+
+// Bytes [start, start + len) of the byte shuffled image: every item's first byte, then every second byte...
+void shuffle(uint8_t *out, const uint8_t *in, size_t items, size_t itemSize, size_t start, size_t len)
+{
+    size_t end = start + len;
+    while (start < end)
+    {
+        size_t byte = start / items;
+        size_t item = start % items;
+        size_t run  = std::min(end - start, items - item);
+        const uint8_t *src = in + item * itemSize + byte;
+        for (size_t i = 0; i < run; i++)
+            out[i] = src[i * itemSize];
+        out += run;
+        start += run;
+    }
+}
+
+}
+
+XISFWriter::XISFWriter(int bpp, int naxis, const long naxes[]) : m_BPP(bpp), m_Axes(naxes, naxes + naxis)
+{
+    char timestamp[32];
+    time_t now = time(nullptr);
+    struct tm utc;
+    gmtime_r(&now, &utc);
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", &utc);
+    m_CreationTime = timestamp;
+}
+
+void XISFWriter::setColorFilterArray(const std::string &pattern, int width, int height)
+{
+    m_CFAPattern = pattern;
+    m_CFAWidth   = width;
+    m_CFAHeight  = height;
+}
+
+void XISFWriter::setCompression(bool enabled, size_t subblockSize)
+{
+    m_Compress = enabled;
+    m_SubblockSize = std::max<size_t>(subblockSize, 4096);
+}
+
+size_t XISFWriter::dataSize() const
+{
+    size_t pixels = 1;
+    for (auto axis : m_Axes)
+        pixels *= axis;
+    return pixels * (m_BPP / 8);
+}
+
+std::string XISFWriter::header(uint64_t position, uint64_t size, const std::string &subblocks) const
+{
+    bool color = m_Axes.size() == 3;
+    size_t itemSize = m_BPP / 8;
+
+    std::string xml = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                      "<xisf version=\"1.0\" xmlns=\"http://www.pixinsight.com/xisf\""
+                      " xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\""
+                      " xsi:schemaLocation=\"http://www.pixinsight.com/xisf http://pixinsight.com/xisf/xisf-1.0.xsd\">\n";
+
+    xml += "<Image geometry=\"" + std::to_string(m_Axes[0]) + ":" + std::to_string(m_Axes[1]) + ":" + (color ? "3" : "1") + "\"";
+    xml += " sampleFormat=\"UInt" + std::to_string(m_BPP) + "\"";
+    xml += std::string(" colorSpace=\"") + (color ? "RGB" : "Gray") + "\"";
+    xml += " imageType=\"" + escaped(m_ImageType) + "\"";
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    xml += " byteOrder=\"big\"";
+#endif
+    xml += " location=\"attachment:" + std::to_string(position) + ":" + std::to_string(size) + "\"";
+    if (m_Compress)
+    {
+        if (itemSize > 1)
+            xml += " compression=\"zlib+sh:" + std::to_string(dataSize()) + ":" + std::to_string(itemSize) + "\"";
+        else
+            xml += " compression=\"zlib:" + std::to_string(dataSize()) + "\"";
+        xml += " subblocks=\"" + subblocks + "\"";
+    }
+    xml += ">\n";
+
+    for (auto &record : m_Records)
+    {
+        if (record.type() == FITSRecord::VOID)
+            continue;
+        xml += "<FITSKeyword name=\"" + escaped(record.key()) + "\" value=\"" + escaped(record.valueString()) +
+               "\" comment=\"" + escaped(record.comment()) + "\"/>\n";
+    }
+
+    if (!m_CFAPattern.empty())
+        xml += "<ColorFilterArray pattern=\"" + escaped(m_CFAPattern) + "\" width=\"" + std::to_string(m_CFAWidth) +
+               "\" height=\"" + std::to_string(m_CFAHeight) + "\"/>\n";
+
+    xml += "</Image>\n"
+           "<Metadata>\n"
+           "<Property id=\"XISF:CreationTime\" type=\"TimePoint\" value=\"" + m_CreationTime + "\"/>\n"
+           "<Property id=\"XISF:CreatorApplication\" type=\"String\">INDI</Property>\n"
+           "</Metadata>\n"
+           "</xisf>";
+    return xml;
+}
+
+bool XISFWriter::writeToBlob(const void *pixels, void *&blob, size_t &size, std::string &error) const
+{
+    BlobOutput output;
+    if (!writeTo(output, pixels, error))
+        return false;
+    output.release(blob, size);
+    return true;
+}
+
+bool XISFWriter::writeToFile(int fd, const void *pixels, std::string &error) const
+{
+    FileOutput output(fd);
+    return writeTo(output, pixels, error);
+}
+
+bool XISFWriter::writeTo(Output &output, const void *pixels, std::string &error) const
+{
+    if ((m_BPP != 8 && m_BPP != 16 && m_BPP != 32) || m_Axes.size() < 2 || m_Axes.size() > 3)
+    {
+        error = "unsupported image format";
+        return false;
+    }
+
+    // Room for the header with the widest numbers it may hold
+    std::string subblocks;
+    if (m_Compress)
+    {
+        size_t count = (dataSize() + m_SubblockSize - 1) / m_SubblockSize;
+        std::string widest = std::to_string(UINT64_MAX) + "," + std::to_string(UINT64_MAX);
+        for (size_t i = 0; i < count; i++)
+            subblocks += (i ? ":" : "") + widest;
+    }
+    uint64_t position = aligned(XISF_PREAMBLE + header(UINT64_MAX, UINT64_MAX, subblocks).size());
+    // Compressed frames usually take less than half, the output grows if not
+    output.reserve(position + (m_Compress ? dataSize() / 2 : dataSize()));
+
+    uint64_t size = dataSize();
+    if (m_Compress)
+    {
+        if (!writeCompressed(output, position, pixels, subblocks, size, error))
+            return false;
+    }
+    else if (!output.write(position, pixels, size))
+    {
+        error = output.error;
+        return false;
+    }
+
+    std::string xml = header(position, size, subblocks);
+    std::vector<uint8_t> head(position, 0);
+    uint32_t length = xml.size();
+    memcpy(head.data(), "XISF0100", 8);
+    // Little endian whatever the host
+    for (int i = 0; i < 4; i++)
+        head[8 + i] = static_cast<uint8_t>(length >> (8 * i));
+    memcpy(head.data() + XISF_PREAMBLE, xml.data(), xml.size());
+    if (!output.write(0, head.data(), head.size()))
+    {
+        error = output.error;
+        return false;
+    }
+    return true;
+}
+
+bool XISFWriter::writeCompressed(Output &output, uint64_t position, const void *pixels, std::string &subblocks,
+                                 uint64_t &size, std::string &error) const
+{
+    auto in = static_cast<const uint8_t *>(pixels);
+    size_t total = dataSize();
+    size_t itemSize = m_BPP / 8;
+    std::vector<uint8_t> shuffled(itemSize > 1 ? m_SubblockSize : 0);
+    std::vector<uint8_t> compressed(compressBound(m_SubblockSize));
+
+    subblocks.clear();
+    size = 0;
+    for (size_t start = 0; start < total; start += m_SubblockSize)
+    {
+        size_t len = std::min(m_SubblockSize, total - start);
+        const uint8_t *block = in + start;
+        if (itemSize > 1)
+        {
+            shuffle(shuffled.data(), in, total / itemSize, itemSize, start, len);
+            block = shuffled.data();
+        }
+
+        // Fastest level, this runs while the camera waits for the next exposure
+        uLongf compressedLen = compressed.size();
+        int rc = compress2(compressed.data(), &compressedLen, block, len, Z_BEST_SPEED);
+        if (rc != Z_OK)
+        {
+            error = "zlib error " + std::to_string(rc);
+            return false;
+        }
+
+        if (!output.write(position + size, compressed.data(), compressedLen))
+        {
+            error = output.error;
+            return false;
+        }
+
+        subblocks += (subblocks.empty() ? "" : ":") + std::to_string(compressedLen) + "," + std::to_string(len);
+        size += compressedLen;
+    }
+    return true;
+}
+
+}
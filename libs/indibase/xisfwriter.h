@@ -0,0 +1,103 @@
+/**  INDI LIB
+ *   Streaming XISF writer
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Lesser General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2.1 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#pragma once
+
+#include "fitskeyword.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace INDI
+{
+
+/**
+ * @brief The XISFWriter class serializes an unsigned 8, 16 or 32 bits image to a monolithic XISF file
+ * straight from the frame buffer.
+ *
+ * The pixels are copied once into the output, or byte shuffled and zlib compressed one subblock at a
+ * time, so the only full size buffer besides the frame is the output itself. The header is written
+ * last, in space reserved ahead of the attachment.
+ */
+class XISFWriter
+{
+    public:
+        /**
+         * @param bpp bits per pixel, 8, 16 or 32.
+         * @param naxis 2, or 3 for color images.
+         * @param naxes length of each axis.
+         */
+        XISFWriter(int bpp, int naxis, const long naxes[]);
+
+        /** @brief Light, Bias, Dark or Flat */
+        void setImageType(const std::string &type)
+        {
+            m_ImageType = type;
+        }
+
+        void setColorFilterArray(const std::string &pattern, int width, int height);
+
+        /** @brief Stored as FITSKeyword elements of the image */
+        void setRecords(const std::vector<FITSRecord> &records)
+        {
+            m_Records = records;
+        }
+
+        /**
+         * @brief Compress the attachment with zlib, byte shuffled, in independent subblocks.
+         * @param subblockSize uncompressed bytes per subblock, the scratch memory used while writing.
+         */
+        void setCompression(bool enabled, size_t subblockSize = 1024 * 1024);
+
+        /**
+         * @brief Write the file to a buffer allocated with IDSharedBlobAlloc().
+         * @param blob set to the buffer, the caller frees it with IDSharedBlobFree().
+         * @param size set to the size of the file.
+         */
+        bool writeToBlob(const void *pixels, void *&blob, size_t &size, std::string &error) const;
+
+        /** @brief Write the file at the start of fd, which must be open for writing and empty. */
+        bool writeToFile(int fd, const void *pixels, std::string &error) const;
+
+    private:
+        class Output;
+        class BlobOutput;
+        class FileOutput;
+
+        bool writeTo(Output &output, const void *pixels, std::string &error) const;
+        bool writeCompressed(Output &output, uint64_t position, const void *pixels, std::string &subblocks,
+                             uint64_t &size, std::string &error) const;
+        std::string header(uint64_t position, uint64_t size, const std::string &subblocks) const;
+        size_t dataSize() const;
+
+    private:
+        int m_BPP;
+        std::vector<long> m_Axes;
+        std::string m_ImageType {"Light"};
+        std::string m_CFAPattern;
+        int m_CFAWidth {0};
+        int m_CFAHeight {0};
+        std::vector<FITSRecord> m_Records;
+        bool m_Compress {false};
+        size_t m_SubblockSize {1024 * 1024};
+        std::string m_CreationTime;
+};
+
+}
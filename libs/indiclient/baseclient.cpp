@@ -222,7 +222,7 @@ BaseClientPrivate::BaseClientPrivate(BaseClient *parent)
     clientSocket.onData([this](const char *data, size_t size)
     {
         char msg[MAXRBUF];
-        auto documents = xmlParser.parseChunk(data, size);
+        auto documents = awaitCompression || inflater ? parseCompressed(data, size) : xmlParser.parseChunk(data, size);
 
         if (documents.size() == 0)
         {
@@ -280,7 +280,98 @@ BaseClientPrivate::~BaseClientPrivate()
 
 ssize_t BaseClientPrivate::sendData(const void *data, size_t size)
 {
-    return clientSocket.write(static_cast<const char *>(data), size);
+    std::lock_guard<std::mutex> lock(sendMutex);
+    if (!deflater)
+        return clientSocket.write(static_cast<const char *>(data), size);
+
+    // Every flush costs a few bytes, so compress whole messages, large BLOBs by chunks
+    pendingData.append(static_cast<const char *>(data), size);
+    if ((messageDepth == 0 || pendingData.size() >= MAXINDIBUF) && !flushPending())
+        return -1;
+    return size;
+}
+
+void BaseClientPrivate::beginMessage()
+{
+    std::lock_guard<std::mutex> lock(sendMutex);
+    ++messageDepth;
+}
+
+void BaseClientPrivate::endMessage()
+{
+    std::lock_guard<std::mutex> lock(sendMutex);
+    if (messageDepth > 0 && --messageDepth == 0 && deflater)
+        flushPending();
+}
+
+bool BaseClientPrivate::flushPending()
+{
+    if (pendingData.empty())
+        return true;
+
+    std::string compressed;
+    bool ok = deflater->compress(pendingData.data(), pendingData.size(), compressed);
+    pendingData.clear();
+    if (!ok)
+        return false;
+
+    for (size_t done = 0; done < compressed.size();)
+    {
+        ssize_t written = clientSocket.write(compressed.data() + done, compressed.size() - done);
+        if (written <= 0)
+            return false;
+        done += written;
+    }
+    return true;
+}
+
+std::list<LilXmlDocument> BaseClientPrivate::parseCompressed(const char *data, size_t size)
+{
+    std::list<LilXmlDocument> documents;
+    size_t pos = 0;
+
+    // Until the server answered, parse byte per byte to find where its compressed stream starts
+    while (awaitCompression && pos < size)
+    {
+        auto some = xmlParser.parseChunk(data + pos++, 1);
+        if (some.empty())
+            continue;
+
+        awaitCompression = false;
+        LilXmlElement root = some.front().root();
+        if (root.tagName() == "compression" && root.getAttribute("format").toString() == TransportCompression)
+        {
+            // Everything we send after our own marker is compressed
+            std::string marker = std::string("<compression format='") + TransportCompression + "'/>\n";
+            std::lock_guard<std::mutex> lock(sendMutex);
+            inflater.reset(new Inflater());
+            clientSocket.write(marker);
+            deflater.reset(new Deflater());
+        }
+        else
+        {
+            // Server without compression support
+            documents.splice(documents.end(), some);
+        }
+    }
+
+    if (pos == size)
+        return documents;
+
+    if (!inflater)
+    {
+        documents.splice(documents.end(), xmlParser.parseChunk(data + pos, size - pos));
+        return documents;
+    }
+
+    std::string plain;
+    if (!inflater->decompress(data + pos, size - pos, plain))
+    {
+        IDLog("Corrupted compressed data from %s/%d\n", cServer.c_str(), cPort);
+        return documents;
+    }
+    documents.splice(documents.end(), xmlParser.parseChunk(plain.data(), plain.size()));
+    return documents;
 }
 
 // BaseClient
@@ -301,6 +392,7 @@ bool BaseClientPrivate::connectToHostAndWait(std::string hostname, unsigned shor
     {
         hostname = "localhost:/tmp/indiserver";
     }
+    localConnection = hostname.compare(0, 10, "localhost:") == 0;
     clientSocket.connectToHost(hostname, port);
     return clientSocket.waitForConnected(timeout_sec * 1000 + timeout_us / 1000);
 }
@@ -331,6 +423,16 @@ bool BaseClient::connectServer()
 
     d->clear();
 
+    {
+        std::lock_guard<std::mutex> lock(d->sendMutex);
+        d->inflater.reset();
+        d->deflater.reset();
+        d->pendingData.clear();
+    }
+    // Local connections are not worth the CPU
+    d->awaitCompression = d->compression && !d->localConnection;
+    d->compressedTransport = d->awaitCompression ? TransportCompression : "";
+
     d->sConnected = true;
 
     serverConnected();
@@ -340,6 +442,12 @@ bool BaseClient::connectServer()
     return true;
 }
 
+void BaseClient::setCompression(bool enable)
+{
+    D_PTR(BaseClient);
+    d->compression = enable;
+}
+
 bool BaseClient::disconnectServer(int exit_code)
 {
     D_PTR(BaseClient);
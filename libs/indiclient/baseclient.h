@@ -81,4 +81,11 @@ class INDI::BaseClient : public INDI::AbstractBaseClient
          *  @param prop property name, can be NULL to activate for all property of dev
          */
         void enableDirectBlobAccess(const char * dev = nullptr, const char * prop = nullptr);
+
+        /** @brief Ask the server to compress the connection, from the next connectServer() on.
+         *  Only used over TCP, local connections stay uncompressed. Servers without compression
+         *  support keep sending plain XML.
+         *  @param enable true to compress the traffic in both directions
+         */
+        void setCompression(bool enable);
 };
@@ -2,9 +2,13 @@
 
 #include "abstractbaseclient_p.h"
 #include "indililxml.h"
+#include "indicompression.h"
 
 #include <tcpsocket.h>
 
+#include <memory>
+#include <mutex>
+
 namespace INDI
 {
 
@@ -60,6 +64,14 @@ class BaseClientPrivate : public AbstractBaseClientPrivate
 
     public:
         ssize_t sendData(const void *data, size_t size) override;
+        void beginMessage() override;
+        void endMessage() override;
+
+        /** @brief Compress and write pendingData at once, sendMutex held */
+        bool flushPending();
+
+        /** @brief Parse data from a connection that asked for compression */
+        std::list<LilXmlDocument> parseCompressed(const char *data, size_t size);
 
 #ifdef ENABLE_INDI_SHARED_MEMORY
         TcpSocketSharedBlobs clientSocket;
@@ -67,6 +79,15 @@ class BaseClientPrivate : public AbstractBaseClientPrivate
         TcpSocket clientSocket;
 #endif
         LilXmlParser xmlParser;
+
+        bool compression {false};        // ask TCP servers for a compressed connection
+        bool localConnection {false};
+        bool awaitCompression {false};   // until the server answered the request
+        std::unique_ptr<Inflater> inflater;
+        std::unique_ptr<Deflater> deflater;
+        std::string pendingData;         // plain writes of the current message, compressed with one flush
+        int messageDepth {0};
+        std::mutex sendMutex;
 };
 
 }
@@ -0,0 +1,185 @@
+/*
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#pragma once
+
+#include <zlib.h>
+
+#include <cctype>
+#include <cstdint>
+#include <ctime>
+#include <string>
+
+/**
+ * Compressed transport of an INDI connection.
+ *
+ * A client asks for it with a compression attribute in its first getProperties, e.g.
+ * <getProperties version='1.7' compression='zlib'/>. A server supporting it answers with
+ * <compression format='zlib'/> and compresses everything it writes after that element.
+ * The client then writes the same element and compresses from there on. Peers that do not
+ * know the attribute ignore it, the connection then stays plain XML. Line breaks between the
+ * element and the compressed stream are ignored.
+ */
+namespace INDI
+{
+
+static constexpr const char *TransportCompression = "zlib";
+
+/** @brief Data through a compression stream and the CPU time spent on it */
+struct CompressionStatistics
+{
+    uint64_t plainBytes {0};
+    uint64_t compressedBytes {0};
+    double cpuSeconds {0};
+
+    double ratio() const
+    {
+        return compressedBytes ? double(plainBytes) / compressedBytes : 0;
+    }
+
+    /** @brief CPU time used by the calling thread, in seconds */
+    static double cpuTime()
+    {
+#ifdef CLOCK_THREAD_CPUTIME_ID
+        struct timespec ts;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        return ts.tv_sec + ts.tv_nsec * 1e-9;
+#else
+        return double(std::clock()) / CLOCKS_PER_SEC;
+#endif
+    }
+};
+
+/**
+ * @brief Streaming compressor, every call is flushed so the peer can decode all of it at once.
+ */
+class Deflater
+{
+    public:
+        Deflater()
+        {
+            stream.zalloc = Z_NULL;
+            stream.zfree  = Z_NULL;
+            stream.opaque = Z_NULL;
+            deflateInit(&stream, Z_DEFAULT_COMPRESSION);
+        }
+
+        ~Deflater()
+        {
+            deflateEnd(&stream);
+        }
+
+        Deflater(const Deflater &) = delete;
+        Deflater &operator=(const Deflater &) = delete;
+
+        /** @brief Compress size bytes of data and append the result to out */
+        bool compress(const void *data, size_t size, std::string &out)
+        {
+            double start = CompressionStatistics::cpuTime();
+            size_t initial = out.size();
+
+            stream.next_in  = static_cast<Bytef *>(const_cast<void *>(data));
+            stream.avail_in = static_cast<uInt>(size);
+            int ret;
+            do
+            {
+                size_t offset = out.size();
+                size_t room   = size + 64;
+                out.resize(offset + room);
+                stream.next_out  = reinterpret_cast<Bytef *>(&out[offset]);
+                stream.avail_out = static_cast<uInt>(room);
+                ret = deflate(&stream, Z_SYNC_FLUSH);
+                out.resize(offset + room - stream.avail_out);
+            }
+            while (ret == Z_OK && stream.avail_out == 0);
+
+            statistics.plainBytes += size;
+            statistics.compressedBytes += out.size() - initial;
+            statistics.cpuSeconds += CompressionStatistics::cpuTime() - start;
+            return ret == Z_OK || ret == Z_BUF_ERROR;
+        }
+
+        CompressionStatistics statistics;
+
+    private:
+        z_stream stream;
+};
+
+/**
+ * @brief Streaming decompressor for the output of Deflater
+ */
+class Inflater
+{
+    public:
+        Inflater()
+        {
+            stream.zalloc   = Z_NULL;
+            stream.zfree    = Z_NULL;
+            stream.opaque   = Z_NULL;
+            stream.next_in  = Z_NULL;
+            stream.avail_in = 0;
+            inflateInit(&stream);
+        }
+
+        ~Inflater()
+        {
+            inflateEnd(&stream);
+        }
+
+        Inflater(const Inflater &) = delete;
+        Inflater &operator=(const Inflater &) = delete;
+
+        /** @brief Decompress size bytes of data and append the result to out */
+        bool decompress(const void *data, size_t size, std::string &out)
+        {
+            double start = CompressionStatistics::cpuTime();
+            size_t initial = out.size();
+            size_t skipped = 0;
+
+            // What ends the <compression> element is not part of the stream
+            auto bytes = static_cast<const unsigned char *>(data);
+            while (!started && skipped < size && isspace(bytes[skipped]))
+                skipped++;
+            started = started || skipped < size;
+
+            stream.next_in  = static_cast<Bytef *>(const_cast<void *>(data)) + skipped;
+            stream.avail_in = static_cast<uInt>(size - skipped);
+            int ret;
+            do
+            {
+                size_t offset = out.size();
+                size_t room   = 4 * size + 4096;
+                out.resize(offset + room);
+                stream.next_out  = reinterpret_cast<Bytef *>(&out[offset]);
+                stream.avail_out = static_cast<uInt>(room);
+                ret = inflate(&stream, Z_NO_FLUSH);
+                out.resize(offset + room - stream.avail_out);
+            }
+            while (ret == Z_OK && (stream.avail_in > 0 || stream.avail_out == 0));
+
+            statistics.plainBytes += out.size() - initial;
+            statistics.compressedBytes += size;
+            statistics.cpuSeconds += CompressionStatistics::cpuTime() - start;
+            return ret == Z_OK || ret == Z_BUF_ERROR;
+        }
+
+        CompressionStatistics statistics;
+
+    private:
+        z_stream stream;
+        bool started {false};
+};
+
+}
@@ -276,6 +276,35 @@ typedef enum
  */
 extern void IDSnoopDevice(const char *snooped_device, const char *snooped_property);
 
+/** @typedef IDSnoopHandler
+ *  @brief Function called with each message of a property snooped with IDSnoopProperty().
+ *  @param root the full message exactly as it was sent by the snooped driver.
+ *  @param context the context given to IDSnoopProperty().
+ */
+typedef void (IDSnoopHandler)(XMLEle *root, void *context);
+
+/** @brief Function a Driver calls to snoop on a property of another Device and have its messages passed to
+ *  handler directly, before they arrive via ISSnoopDevice() like those of IDSnoopDevice().
+ *  @param snooped_device name of the device to snoop.
+ *  @param snooped_property name of the snooped property in the device. If NULL or empty, handler gets every
+ *  message of the device.
+ *  @param handler function called with each def, set, del and message of the property.
+ *  @param context passed to handler.
+ */
+extern void IDSnoopProperty(const char *snooped_device, const char *snooped_property, IDSnoopHandler *handler,
+                            void *context);
+
+/** @brief Function a Driver calls to stop passing the messages of a property to a handler given to IDSnoopProperty().
+ *  @param snooped_device name of the snooped device.
+ *  @param snooped_property name of the snooped property in the device.
+ *  @param handler function given to IDSnoopProperty().
+ *  @param context context given to IDSnoopProperty().
+ *  @note indiserver keeps sending the messages, they still arrive via ISSnoopDevice().
+ *  @note A handler may call it for itself, it is not called again once it returns.
+ */
+extern void IDUnsnoopProperty(const char *snooped_device, const char *snooped_property, IDSnoopHandler *handler,
+                              void *context);
+
 /** @brief Function a Driver calls to control whether they will receive BLOBs from snooped devices.
  *  @param snooped_device name of the device to snoop.
  *  @param snooped_property name of property to snoop. If NULL, then all BLOBs from the given device are snooped.
@@ -373,6 +402,36 @@ extern void IERmWorkProc(int workprocid);
 extern int IEDeferLoop(int maxms, int *flagp);
 extern int IEDeferLoop0(int maxms, int *flagp);
 
+/** @typedef IEClockMode
+ *  @brief Clocks the timers of the event loop can run on.
+ */
+typedef enum
+{
+    IE_CLOCK_REALTIME,    /*!< The monotonic clock of the system */
+    IE_CLOCK_ACCELERATED, /*!< Runs faster than the clock of the system by a constant factor */
+    IE_CLOCK_STEPPED      /*!< Only moves when IEAdvanceClock() is called */
+} IEClockMode;
+
+/** @brief Select the clock timers, INDI::Timer and INDI::ElapsedTimer run on.
+ *  Drivers run on the clock the INDI_CLOCK environment variable selects: a comma separated list of
+ *  modes, each either for every driver or, as name=mode, for the driver with that executable name.
+ *  A mode is "realtime", "stepped", or the factor to speed the clock up by, as in "x60".
+ *  @param mode the clock.
+ *  @param rate how many times faster than real time the accelerated clock runs.
+ */
+extern void IESetClock(IEClockMode mode, double rate);
+
+/** @return the clock selected by IESetClock(). */
+extern IEClockMode IEGetClockMode(void);
+
+/** @return the time on the clock of the event loop, in milliseconds from an arbitrary origin. */
+extern double IEClockNow(void);
+
+/** @brief Move a virtual clock forward by \e ms milliseconds. On the stepped clock, the timers due meanwhile
+ *  run in order, each at the time it is due, before this returns.
+ */
+extern void IEAdvanceClock(double ms);
+
 /* @} */
 
 /** @defgroup dutilFunctions IU Functions: Functions drivers call to perform handy utility routines.
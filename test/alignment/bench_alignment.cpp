@@ -0,0 +1,79 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+ .
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+ .
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+/*
+ * Time the alignment transforms of a mount tracking across the sky, alternating sky to telescope and
+ * telescope to sky, with 4 to 256 sync points spread over the sky. Prints transforms per second on stderr.
+ *
+ * usage: bench_alignment [transforms]
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include <indilogger.h>
+
+#include "alignment_scope.h"
+
+// Sync points spread evenly over the sky above declination -60
+static void SyncFibonacciSphere(Scope &s, int count, double raOffset)
+{
+    const double goldenAngle = M_PI * (3.0 - std::sqrt(5.0));
+    for (int i = 0; i < count; i++)
+    {
+        double z = 1.0 - (i + 0.5) * (1.0 + std::sin(60.0 * M_PI / 180.0)) / count;
+        double dec = std::asin(z) * 180.0 / M_PI;
+        double ra = range24(i * goldenAngle * 12.0 / M_PI);
+        s.AddAlignmentEntryEquatorial(ra, dec, range24(ra + raOffset), dec);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int transforms = argc > 1 ? atoi(argv[1]) : 20000;
+
+    INDI::Logger::getInstance().configure("", INDI::Logger::file_off,
+                                          INDI::Logger::DBG_ERROR, INDI::Logger::DBG_ERROR);
+
+    for (int syncPoints : {4, 16, 64, 256})
+    {
+        Scope s(INDI::AlignmentSubsystem::MathPluginManagement::EQUATORIAL);
+        if (!s.updateLocation(29.05, 48.15, 0))
+            return 1;
+        s.Handshake();
+        SyncFibonacciSphere(s, syncPoints, 0.1);
+
+        double mountRA, mountDec, skyRA, skyDec;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < transforms / 2; i++)
+        {
+            double ra = range24(i * 24.0 / (transforms / 2));
+            double dec = 20.0 * std::sin(i * 0.001);
+            s.SkyToTelescopeEquatorial(ra, dec, mountRA, mountDec);
+            s.TelescopeEquatorialToSky(mountRA, mountDec, skyRA, skyDec);
+        }
+        auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        fprintf(stderr, "Alignment transforms with %d sync points: %.0f per second\n", syncPoints, transforms / elapsed);
+    }
+
+    return 0;
+}
@@ -21,14 +21,18 @@
 #include "config.h"
 #endif
 
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
+#include <random>
 #include <stdio.h>
 
 #include <indilogger.h>
 
 #include "alignment_scope.h"
 
+#include <alignment/DirectionVectorIndex.h>
+
 double round(double value, int decimal_places)
 {
     const double multiplier = std::pow(10.0, decimal_places);
@@ -151,6 +155,86 @@ TEST(ALIGNMENT_TEST, Test_ThreeSyncPointsAltAz)
     ASSERT_DOUBLE_EQ(round(testPointAz, 1), round(roundTripAz, 1));
 }
 
+// Sync points spread evenly over the sky above declination -60
+static void SyncFibonacciSphere(Scope &s, int count, double raOffset)
+{
+    const double goldenAngle = M_PI * (3.0 - std::sqrt(5.0));
+    for (int i = 0; i < count; i++)
+    {
+        double z = 1.0 - (i + 0.5) * (1.0 + std::sin(60.0 * M_PI / 180.0)) / count;
+        double dec = std::asin(z) * 180.0 / M_PI;
+        double ra = range24(i * goldenAngle * 12.0 / M_PI);
+        s.AddAlignmentEntryEquatorial(ra, dec, range24(ra + raOffset), dec);
+    }
+}
+
+TEST(ALIGNMENT_TEST, Test_DirectionVectorIndexMatchesLinearScan)
+{
+    std::mt19937 generator(42);
+    std::normal_distribution<double> normal;
+    auto randomVector = [&]()
+    {
+        TelescopeDirectionVector vector(normal(generator), normal(generator), normal(generator));
+        vector.Normalise();
+        return vector;
+    };
+
+    std::vector<TelescopeDirectionVector> points;
+    for (int i = 0; i < 300; i++)
+        points.push_back(randomVector());
+
+    DirectionVectorIndex index;
+    ASSERT_EQ(index.Nearest(points[0]), -1);
+    index.Build(points);
+    ASSERT_EQ(index.Size(), points.size());
+
+    for (int i = 0; i < 500; i++)
+    {
+        TelescopeDirectionVector target = randomVector();
+
+        std::vector<std::pair<double, int>> expected;
+        for (size_t j = 0; j < points.size(); j++)
+        {
+            TelescopeDirectionVector delta = points[j] - target;
+            expected.emplace_back(delta ^ delta, j);
+        }
+        std::sort(expected.begin(), expected.end());
+
+        std::vector<int> nearest;
+        index.KNearest(target, 3, nearest);
+        ASSERT_EQ(nearest.size(), 3U);
+        for (int k = 0; k < 3; k++)
+            ASSERT_EQ(nearest[k], expected[k].second);
+        ASSERT_EQ(index.Nearest(target), expected[0].second);
+    }
+}
+
+TEST(ALIGNMENT_TEST, Test_ModelRebuiltWhenDatabaseChanges)
+{
+    Scope s(INDI::AlignmentSubsystem::MathPluginManagement::EQUATORIAL);
+    ASSERT_TRUE(s.updateLocation(29.05, 48.15, 0));
+    s.Handshake();
+
+    SyncFibonacciSphere(s, 12, 0);
+
+    double mountRA, mountDec;
+    ASSERT_TRUE(s.SkyToTelescopeEquatorial(10.0, 10.0, mountRA, mountDec));
+    ASSERT_NEAR(range24(mountRA), 10.0, 0.01);
+    ASSERT_NEAR(mountDec, 10.0, 0.01);
+
+    // Edit the sync points in place without reinitialising the math plugin, the mount is now one hour ahead
+    for (auto &entry : s.GetAlignmentDatabase())
+    {
+        INDI::IEquatorialCoordinates mount {range24(entry.RightAscension + 1.0), entry.Declination};
+        entry.TelescopeDirection = s.TelescopeDirectionVectorFromEquatorialCoordinates(mount);
+    }
+    s.IncrementRevision();
+
+    ASSERT_TRUE(s.SkyToTelescopeEquatorial(10.0, 10.0, mountRA, mountDec));
+    ASSERT_NEAR(range24(mountRA), 11.0, 0.01);
+    ASSERT_NEAR(mountDec, 10.0, 0.01);
+}
+
 int main(int argc, char **argv)
 {
     INDI::Logger::getInstance().configure("", INDI::Logger::file_off,
@@ -0,0 +1,111 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+ .
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+ .
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+/*
+ * Serialize a synthetic frame to FITS in memory, once the way CCD::ExposureCompletePrivate() does
+ * with CFITSIO and once with FITSWriter, both into shared BLOB memory. Prints the time per frame.
+ *
+ * usage: bench_fitswriter [width height [bpp [frames]]]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include <fitsio.h>
+
+#include "fitswriter.h"
+#include "sharedblob.h"
+
+static std::vector<INDI::FITSRecord> keywords()
+{
+    std::vector<INDI::FITSRecord> records;
+    records.emplace_back("ROWORDER", "TOP-DOWN", "Row Order");
+    records.emplace_back("INSTRUME", "CCD Simulator", "CCD Name");
+    records.emplace_back("TELESCOP", "Telescope Simulator", "Telescope name");
+    records.emplace_back("OBSERVER", "Unknown", "Observer name");
+    records.emplace_back("OBJECT", "Unknown", "Object name");
+    records.emplace_back("EXPTIME", 1.0, 6, "Total Exposure Time (s)");
+    records.emplace_back("CCD-TEMP", -10.0, 3, "CCD Temperature (Celsius)");
+    records.emplace_back("PIXSIZE1", 5.2, 6, "Pixel Size 1 (microns)");
+    records.emplace_back("PIXSIZE2", 5.2, 6, "Pixel Size 2 (microns)");
+    records.emplace_back("XBINNING", int64_t(1), "Binning factor in width");
+    records.emplace_back("YBINNING", int64_t(1), "Binning factor in height");
+    records.emplace_back("FRAME", "Light", "Frame Type");
+    records.emplace_back("DATE-OBS", "2024-03-01T21:04:12.125", "UTC start date of observation");
+    records.emplace_back("Generated by INDI");
+    return records;
+}
+
+int main(int argc, char **argv)
+{
+    long width  = argc > 2 ? atol(argv[1]) : 4144;
+    long height = argc > 2 ? atol(argv[2]) : 2822;
+    int bpp     = argc > 3 ? atoi(argv[3]) : 16;
+    int frames  = argc > 4 ? atoi(argv[4]) : 20;
+
+    if (bpp != 8 && bpp != 16 && bpp != 32)
+    {
+        fprintf(stderr, "bpp must be 8, 16 or 32\n");
+        return 1;
+    }
+
+    long naxes[2] = { width, height };
+    long nelements = width * height;
+    std::vector<uint8_t> pixels(nelements * (bpp / 8));
+    for (size_t i = 0; i < pixels.size(); i++)
+        pixels[i] = static_cast<uint8_t>(i * 31);
+    auto records = keywords();
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; i++)
+    {
+        size_t memorySize = 2880;
+        void *memory = IDSharedBlobAlloc(8640 + pixels.size());
+        fitsfile *fptr = nullptr;
+        int status = 0;
+        fits_create_memfile(&fptr, &memory, &memorySize, 2880, IDSharedBlobRealloc, &status);
+        if (status == 0)
+            status = INDI::FITSWriter::writeWithCFITSIO(fptr, bpp, 2, naxes, records, pixels.data(), nelements);
+        fits_flush_file(fptr, &status);
+        fits_close_file(fptr, &status);
+        IDSharedBlobFree(memory);
+        if (status)
+        {
+            fprintf(stderr, "CFITSIO error %d\n", status);
+            return 1;
+        }
+    }
+    double cfitsio = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / frames;
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; i++)
+    {
+        INDI::FITSWriter writer(bpp, 2, naxes);
+        writer.setRecords(records);
+        void *memory = IDSharedBlobAlloc(writer.size());
+        writer.write(memory, pixels.data());
+        IDSharedBlobFree(memory);
+    }
+    double native = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / frames;
+
+    double megabytes = pixels.size() / 1e6;
+    printf("%ldx%ld %d bits, %d frames\n", width, height, bpp, frames);
+    printf("cfitsio:    %7.2f ms/frame, %6.0f MB/s\n", cfitsio * 1e3, megabytes / cfitsio);
+    printf("fitswriter: %7.2f ms/frame, %6.0f MB/s\n", native * 1e3, megabytes / native);
+    return 0;
+}
@@ -0,0 +1,164 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+ .
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+ .
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+/*
+ * Time a debug message logged to a file from several threads at once, the way Logger::print() used
+ * to write it (formatted under a mutex, flushed with std::endl) and through LogBackend. Prints the
+ * average and worst cost of a call as seen by the caller.
+ *
+ * usage: bench_logger [messages per thread [max threads]]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "indilogbackend.h"
+
+class FileSink : public INDI::LogBackend::Sink
+{
+    public:
+        explicit FileSink(const std::string &path) : m_Out(path) {}
+
+        void write(const INDI::LogBackend::Record &record) override
+        {
+            m_Out << "DEBUG\t" << record.time.tv_sec << "." << record.time.tv_usec << " sec\t: " << record.text << '\n';
+        }
+        void flush() override
+        {
+            m_Out.flush();
+        }
+        void message(const char *, unsigned int, const char *) override {}
+
+    private:
+        std::ofstream m_Out;
+};
+
+// What the old Logger::print() did for each message
+class MutexLogger
+{
+    public:
+        explicit MutexLogger(const std::string &path) : m_Out(path) {}
+
+        void print(const char *format, ...)
+        {
+            char msg[257];
+            va_list ap;
+            va_start(ap, format);
+            vsnprintf(msg, sizeof(msg), format, ap);
+            va_end(ap);
+
+            struct timeval now;
+            gettimeofday(&now, nullptr);
+            std::lock_guard<std::mutex> lock(m_Lock);
+            m_Out << "DEBUG\t" << now.tv_sec << "." << now.tv_usec << " sec\t: " << msg << std::endl;
+        }
+
+    private:
+        std::mutex m_Lock;
+        std::ofstream m_Out;
+};
+
+static void backendPrint(INDI::LogBackend &backend, const char *format, ...)
+{
+    va_list ap;
+    va_start(ap, format);
+    backend.push("Bench", 8, true, false, format, ap);
+    va_end(ap);
+}
+
+static void run(const char *name, int threads, int messages, const std::function<void(int, int)> &print,
+                const std::function<void()> &finish)
+{
+    std::vector<double> average(threads), worst(threads);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++)
+        workers.emplace_back([&, t]()
+        {
+            double total = 0, max = 0;
+            for (int i = 0; i < messages; i++)
+            {
+                auto before = std::chrono::steady_clock::now();
+                print(t, i);
+                double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - before).count();
+                total += elapsed;
+                max = std::max(max, elapsed);
+            }
+            average[t] = total / messages;
+            worst[t] = max;
+        });
+    for (auto &worker : workers)
+        worker.join();
+    double callers = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    finish();
+    double written = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    double mean = 0, max = 0;
+    for (int t = 0; t < threads; t++)
+    {
+        mean += average[t] / threads;
+        max = std::max(max, worst[t]);
+    }
+    printf("%-8s %2d threads  %8.0f ns/call  %10.0f ns worst  %8.1f ms callers  %8.1f ms written\n", name, threads,
+           mean, max, callers, written);
+}
+
+int main(int argc, char **argv)
+{
+    int messages   = argc > 1 ? atoi(argv[1]) : 100000;
+    int maxThreads = argc > 2 ? atoi(argv[2]) : 8;
+    std::string path = std::string(getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp") + "/bench_logger_" + std::to_string(getpid());
+
+    for (int threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        {
+            MutexLogger logger(path);
+            run("mutex", threads, messages, [&](int t, int i)
+            {
+                logger.print("Thread %d sent command %d: <:GR#> response <12:34:56#>", t, i);
+            }, []() {});
+        }
+        {
+            FileSink sink(path);
+            // Large enough that nothing is dropped, as for a driver logging in bursts
+            INDI::LogBackend backend(&sink, threads * messages);
+            run("backend", threads, messages, [&](int t, int i)
+            {
+                backendPrint(backend, "Thread %d sent command %d: <:GR#> response <12:34:56#>", t, i);
+            }, [&]()
+            {
+                backend.flush();
+            });
+            auto statistics = backend.statistics();
+            if (statistics.dropped > 0)
+                printf("         %llu dropped\n", static_cast<unsigned long long>(statistics.dropped));
+        }
+    }
+
+    unlink(path.c_str());
+    return 0;
+}
@@ -0,0 +1,128 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+ .
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+ .
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+/*
+ * Record synthetic frames at a target rate the way StreamManager does: a camera thread queues
+ * frames, skipping them once the queue exceeds the buffer limit, and the stream thread writes
+ * them to a SER file. Prints how many frames were dropped.
+ *
+ * usage: bench_serrecorder [directory [width height [fps [seconds [bufferMB]]]]]
+ */
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "stream/recorder/serrecorder.h"
+
+int main(int argc, char **argv)
+{
+    std::string directory = argc > 1 ? argv[1] : ".";
+    uint16_t width  = argc > 3 ? atoi(argv[2]) : 1920;
+    uint16_t height = argc > 3 ? atoi(argv[3]) : 1080;
+    double fps      = argc > 4 ? atof(argv[4]) : 200;
+    double seconds  = argc > 5 ? atof(argv[5]) : 10;
+    size_t bufferMB = argc > 6 ? atoi(argv[6]) : 512;
+
+    size_t frameSize = size_t(width) * height * 2;
+    std::string path = directory + "/bench_serrecorder_" + std::to_string(getpid()) + ".ser";
+
+    INDI::SER_Recorder recorder;
+    recorder.setPixelFormat(INDI_MONO, 16);
+    recorder.setSize(width, height);
+    char errmsg[1024];
+    if (!recorder.open(path.c_str(), errmsg))
+    {
+        fprintf(stderr, "%s", errmsg);
+        return 1;
+    }
+
+    std::mutex lock;
+    std::condition_variable cond;
+    std::deque<std::vector<uint8_t>> queue;
+    bool done = false;
+    uint64_t produced = 0, dropped = 0, written = 0;
+
+    std::thread streamThread([&]
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        for (;;)
+        {
+            cond.wait(guard, [&] { return done || !queue.empty(); });
+            if (queue.empty())
+                return;
+            std::vector<uint8_t> frame = std::move(queue.front());
+            queue.pop_front();
+            guard.unlock();
+            if (recorder.writeFrame(frame.data(), frame.size(), 0))
+                written++;
+            guard.lock();
+        }
+    });
+
+    std::vector<uint8_t> pattern(frameSize);
+    for (size_t i = 0; i < frameSize; i++)
+        pattern[i] = static_cast<uint8_t>(i);
+
+    auto start = std::chrono::steady_clock::now();
+    auto period = std::chrono::duration<double>(1.0 / fps);
+    uint64_t total = static_cast<uint64_t>(fps * seconds);
+    for (uint64_t i = 0; i < total; i++)
+    {
+        std::this_thread::sleep_until(start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(period * i));
+        produced++;
+
+        std::lock_guard<std::mutex> guard(lock);
+        if (queue.size() * frameSize / 1024 / 1024 > bufferMB)
+        {
+            dropped++;
+            continue;
+        }
+        queue.emplace_back(pattern);
+        cond.notify_one();
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        done = true;
+        cond.notify_one();
+    }
+    streamThread.join();
+    double captureSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    recorder.close();
+    double totalSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    unlink(path.c_str());
+
+    auto statistics = recorder.getWriterStatistics();
+    printf("%ux%u 16 bits at %.0f fps for %.0f s into %s\n", width, height, fps, seconds, directory.c_str());
+    printf("frames: %llu produced, %llu written, %llu dropped\n", static_cast<unsigned long long>(produced),
+           static_cast<unsigned long long>(written), static_cast<unsigned long long>(dropped));
+    printf("throughput: %.1f MB/s, %.2f s to close, O_DIRECT %s\n", written * frameSize / 1e6 / totalSeconds,
+           totalSeconds - captureSeconds, statistics.direct ? "yes" : "no");
+    printf("writer: %.2f s writing, %llu stalls for %.2f s\n", statistics.writeSeconds,
+           static_cast<unsigned long long>(statistics.stalls), statistics.stallSeconds);
+
+    return dropped > 0 ? 2 : 0;
+}
@@ -0,0 +1,204 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+ .
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+ .
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+/*
+ * Time the dispatch of snooped messages the way a camera driver receives them: searched for in a chain
+ * of PropertyView::snoop() and strcmp() in ISSnoopDevice(), as INDI::CCD used to, and passed to the
+ * handlers given to snoopProperty(). Prints messages per second for the mount coordinates, which come
+ * first in the chain, and for the sky quality, which comes last, on stderr. stdout would get the
+ * getProperties requests of the snooping, it is discarded.
+ *
+ * usage: bench_snoop [messages]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "defaultdevice.h"
+#include "indidriver.h"
+#include "indipropertynumber.h"
+#include "lilxml.h"
+
+static const char *MOUNT = "Telescope Simulator";
+static const char *SQM   = "SQM";
+
+// Properties of the mount, rotator, focuser, filter wheel and sky quality meter a camera snoops
+static const std::vector<std::pair<const char *, const char *>> SNOOPED =
+{
+    {MOUNT, "EQUATORIAL_EOD_COORD"}, {MOUNT, "EQUATORIAL_COORD"}, {MOUNT, "TELESCOPE_PIER_SIDE"},
+    {MOUNT, "TELESCOPE_INFO"}, {"Rotator Simulator", "ABS_ROTATOR_ANGLE"}, {"Focuser Simulator", "ABS_FOCUS_POSITION"},
+    {"Focuser Simulator", "FOCUS_TEMPERATURE"}, {"Filter Simulator", "FILTER_SLOT"}, {"Filter Simulator", "FILTER_NAME"},
+    {MOUNT, "GEOGRAPHIC_COORD"}, {SQM, "SKY_QUALITY"}
+};
+
+class Camera : public INDI::DefaultDevice
+{
+    public:
+        Camera()
+        {
+            setDeviceName("Bench Camera");
+            EqNP[0].fill("RA", "RA", "%010.6m", 0, 24, 0, 0);
+            EqNP[1].fill("DEC", "DEC", "%010.6m", -90, 90, 0, 0);
+            EqNP.fill(MOUNT, "EQUATORIAL_EOD_COORD", "EQ Coord", "Main Control", IP_RW, 60, IPS_IDLE);
+            J2000EqNP[0].fill("RA", "RA", "%010.6m", 0, 24, 0, 0);
+            J2000EqNP[1].fill("DEC", "DEC", "%010.6m", -90, 90, 0, 0);
+            J2000EqNP.fill(MOUNT, "EQUATORIAL_COORD", "J2000 EQ Coord", "Main Control", IP_RW, 60, IPS_IDLE);
+        }
+
+        const char *getDefaultName() override
+        {
+            return "Bench Camera";
+        }
+
+        INDI::PropertyNumber EqNP {2};
+        INDI::PropertyNumber J2000EqNP {2};
+        double RA {0}, MPSAS {0};
+        long handled {0};
+};
+
+// Searches each message in ISSnoopDevice()
+class ChainCamera : public Camera
+{
+    public:
+        ChainCamera()
+        {
+            for (auto &it : SNOOPED)
+                IDSnoopDevice(it.first, it.second);
+        }
+
+        bool ISSnoopDevice(XMLEle *root) override
+        {
+            auto propName   = findXMLAttValu(root, "name");
+            auto deviceName = std::string(findXMLAttValu(root, "device"));
+
+            if (EqNP.snoop(root))
+            {
+                RA = EqNP[0].getValue();
+                handled++;
+            }
+            else if (J2000EqNP.snoop(root))
+                handled++;
+            else
+            {
+                for (size_t i = 2; i < SNOOPED.size(); i++)
+                {
+                    if (!strcmp(propName, SNOOPED[i].second) && deviceName == SNOOPED[i].first)
+                    {
+                        if (i == SNOOPED.size() - 1)
+                            MPSAS = atof(pcdataXMLEle(nextXMLEle(root, 1)));
+                        handled++;
+                        break;
+                    }
+                }
+            }
+
+            return INDI::DefaultDevice::ISSnoopDevice(root);
+        }
+};
+
+// Has its handlers called directly, then ISSnoopDevice() only passes the messages on
+class RegistryCamera : public Camera
+{
+    public:
+        RegistryCamera()
+        {
+            snoopProperty(MOUNT, "EQUATORIAL_EOD_COORD", [this](XMLEle * root)
+            {
+                if (EqNP.snoop(root))
+                    RA = EqNP[0].getValue();
+                handled++;
+            });
+            snoopProperty(MOUNT, "EQUATORIAL_COORD", [this](XMLEle * root)
+            {
+                J2000EqNP.snoop(root);
+                handled++;
+            });
+            for (size_t i = 2; i < SNOOPED.size() - 1; i++)
+                snoopProperty(SNOOPED[i].first, SNOOPED[i].second, [this](XMLEle *)
+                {
+                    handled++;
+                });
+            snoopProperty(SQM, "SKY_QUALITY", [this](XMLEle * root)
+            {
+                MPSAS = atof(pcdataXMLEle(nextXMLEle(root, 1)));
+                handled++;
+            });
+        }
+};
+
+static XMLEle *parse(const std::string &xml)
+{
+    char msg[MAXRBUF];
+    LilXML *parser = newLilXML();
+    XMLEle **nodes = parseXMLChunk(parser, const_cast<char *>(xml.c_str()), xml.size(), msg);
+    if (nodes == nullptr || nodes[0] == nullptr)
+    {
+        fprintf(stderr, "%s\n", msg);
+        exit(1);
+    }
+    XMLEle *root = nodes[0];
+    free(nodes);
+    delLilXML(parser);
+    return root;
+}
+
+static void run(const char *name, Camera &camera, XMLEle *root, int messages)
+{
+    char msg[MAXRBUF];
+    camera.handled = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < messages; i++)
+        dispatch(root, msg);
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (camera.handled != messages)
+        fprintf(stderr, "%s: %ld of %d messages handled\n", name, camera.handled, messages);
+    fprintf(stderr, "%-10s %-22s %10.0f messages/s  %6.0f ns/message\n", name, findXMLAttValu(root, "name"),
+            messages / elapsed, elapsed * 1e9 / messages);
+}
+
+int main(int argc, char **argv)
+{
+    int messages = argc > 1 ? atoi(argv[1]) : 200000;
+
+    if (freopen("/dev/null", "w", stdout) == nullptr)
+        return 1;
+
+    XMLEle *coordinates = parse(std::string("<setNumberVector device='") + MOUNT + "' name='EQUATORIAL_EOD_COORD' state='Ok'>"
+                                "<oneNumber name='RA'>5.5</oneNumber><oneNumber name='DEC'>22.1</oneNumber></setNumberVector>");
+    XMLEle *quality = parse(std::string("<setNumberVector device='") + SQM + "' name='SKY_QUALITY' state='Ok'>"
+                            "<oneNumber name='SKY_BRIGHTNESS'>20.1</oneNumber></setNumberVector>");
+
+    // One camera at a time, ISSnoopDevice() goes to every device
+    {
+        RegistryCamera camera;
+        run("registry", camera, coordinates, messages);
+        run("registry", camera, quality, messages);
+    }
+    {
+        ChainCamera camera;
+        run("chain", camera, coordinates, messages);
+        run("chain", camera, quality, messages);
+    }
+
+    delXMLEle(coordinates);
+    delXMLEle(quality);
+    return 0;
+}
@@ -0,0 +1,141 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+ .
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+ .
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+/*
+ * Serialize a synthetic frame to XISF with XISFWriter and, when built with libxisf, the way
+ * CCD::ExposureCompletePrivate() used to. Each run happens in a child process so its peak
+ * resident memory can be reported on top of the frame buffer.
+ *
+ * usage: bench_xisfwriter [width height [bpp]]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifdef HAVE_XISF
+#include <libxisf.h>
+#endif
+
+#include "xisfwriter.h"
+#include "sharedblob.h"
+
+static std::vector<INDI::FITSRecord> keywords()
+{
+    std::vector<INDI::FITSRecord> records;
+    records.emplace_back("INSTRUME", "CCD Simulator", "CCD Name");
+    records.emplace_back("EXPTIME", 1.0, 6, "Total Exposure Time (s)");
+    records.emplace_back("CCD-TEMP", -10.0, 3, "CCD Temperature (Celsius)");
+    records.emplace_back("FRAME", "Light", "Frame Type");
+    records.emplace_back("DATE-OBS", "2024-03-01T21:04:12.125", "UTC start date of observation");
+    return records;
+}
+
+static long maxRSS()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+// Runs serialize() in a child that already holds the frame, prints its time and the memory it added
+static void measure(const char *name, size_t frameSize, const std::function<size_t(const uint8_t *)> &serialize)
+{
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        std::vector<uint8_t> frame(frameSize);
+        for (size_t i = 0; i < frameSize; i++)
+            frame[i] = static_cast<uint8_t>((i * 7) ^ (i >> 11));
+        long baseline = maxRSS();
+
+        auto start = std::chrono::steady_clock::now();
+        size_t size = serialize(frame.data());
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        printf("%-28s %8.1f ms  %7.1f MB file  %7.1f MB peak above the frame\n", name, seconds * 1e3, size / 1e6,
+               (maxRSS() - baseline) / 1024.0);
+        fflush(stdout);
+        _exit(0);
+    }
+    waitpid(pid, nullptr, 0);
+}
+
+int main(int argc, char **argv)
+{
+    long width  = argc > 2 ? atol(argv[1]) : 4144;
+    long height = argc > 2 ? atol(argv[2]) : 2822;
+    int bpp     = argc > 3 ? atoi(argv[3]) : 16;
+
+    long naxes[2] = { width, height };
+    size_t frameSize = width * height * (bpp / 8);
+    auto records = keywords();
+
+    printf("%ldx%ld %d bits, %.1f MB frame\n", width, height, bpp, frameSize / 1e6);
+
+    for (bool compress : { false, true })
+    {
+        measure(compress ? "xisfwriter compressed" : "xisfwriter", frameSize, [&](const uint8_t * frame)
+        {
+            INDI::XISFWriter writer(bpp, 2, naxes);
+            writer.setRecords(records);
+            writer.setCompression(compress);
+            void *blob = nullptr;
+            size_t size = 0;
+            std::string error;
+            if (!writer.writeToBlob(frame, blob, size, error))
+                fprintf(stderr, "%s\n", error.c_str());
+            IDSharedBlobFree(blob);
+            return size;
+        });
+
+#ifdef HAVE_XISF
+        measure(compress ? "libxisf compressed" : "libxisf", frameSize, [&](const uint8_t * frame)
+        {
+            LibXISF::Image image;
+            LibXISF::XISFWriter xisfWriter;
+            for (auto &keyword : records)
+            {
+                image.addFITSKeyword({keyword.key().c_str(), keyword.valueString().c_str(), keyword.comment().c_str()});
+                image.addFITSKeywordAsProperty(keyword.key().c_str(), keyword.valueString());
+            }
+            image.setGeometry(width, height, 1);
+            image.setSampleFormat(bpp == 8 ? LibXISF::Image::UInt8 : (bpp == 16 ? LibXISF::Image::UInt16 : LibXISF::Image::UInt32));
+            if (compress)
+            {
+                image.setCompression(LibXISF::DataBlock::Zlib);
+                image.setByteshuffling(bpp / 8);
+            }
+            std::memcpy(image.imageData(), frame, image.imageDataSize());
+            xisfWriter.writeImage(image);
+            LibXISF::ByteArray xisfFile;
+            xisfWriter.save(xisfFile);
+            return static_cast<size_t>(xisfFile.size());
+        });
+#endif
+    }
+
+    return 0;
+}
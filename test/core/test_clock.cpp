@@ -0,0 +1,132 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+ .
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+ .
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "indidevapi.h"
+#include "indielapsedtimer.h"
+#include "inditimer.h"
+
+// Each test leaves the event loop on the clock of the system
+class ClockTest : public ::testing::Test
+{
+    protected:
+        void TearDown() override
+        {
+            IESetClock(IE_CLOCK_REALTIME, 1);
+        }
+};
+
+static void record(void *p)
+{
+    auto fired = static_cast<std::vector<std::string> *>(p);
+    fired->push_back(std::to_string(static_cast<long>(IEClockNow())));
+}
+
+TEST_F(ClockTest, SteppedClockOnlyMovesWhenAdvanced)
+{
+    IESetClock(IE_CLOCK_STEPPED, 1);
+    EXPECT_EQ(IEGetClockMode(), IE_CLOCK_STEPPED);
+
+    double start = IEClockNow();
+    INDI::ElapsedTimer elapsed;
+    EXPECT_EQ(elapsed.elapsed(), 0);
+
+    IEAdvanceClock(1500);
+    EXPECT_EQ(IEClockNow(), start + 1500);
+    EXPECT_EQ(elapsed.elapsed(), 1500);
+    EXPECT_TRUE(elapsed.hasExpired(1000));
+    EXPECT_FALSE(elapsed.hasExpired(2000));
+}
+
+TEST_F(ClockTest, SteppedClockFiresTimersInOrderAtTheirDeadline)
+{
+    IESetClock(IE_CLOCK_STEPPED, 1);
+    long start = static_cast<long>(IEClockNow());
+
+    std::vector<std::string> fired;
+    IEAddTimer(300, record, &fired);
+    IEAddTimer(100, record, &fired);
+    int late = IEAddTimer(5000, record, &fired);
+    IEAddTimer(200, record, &fired);
+
+    IEAdvanceClock(250);
+    EXPECT_EQ(fired, std::vector<std::string>({std::to_string(start + 100), std::to_string(start + 200)}));
+    EXPECT_EQ(IERemainingTimer(late), 4750);
+
+    IEAdvanceClock(250);
+    EXPECT_EQ(fired.size(), 3u);
+    EXPECT_EQ(fired.back(), std::to_string(start + 300));
+    IERmTimer(late);
+}
+
+TEST_F(ClockTest, RepeatingTimerFiresOncePerInterval)
+{
+    IESetClock(IE_CLOCK_STEPPED, 1);
+
+    int count = 0;
+    INDI::Timer timer;
+    timer.setInterval(1000);
+    timer.callOnTimeout([&count]()
+    {
+        count++;
+    });
+    timer.start();
+
+    // An hour of a driver polling each second, without waiting for it
+    IEAdvanceClock(3600 * 1000);
+    EXPECT_EQ(count, 3600);
+    EXPECT_EQ(timer.remainingTime(), 1000);
+    timer.stop();
+}
+
+TEST_F(ClockTest, AcceleratedClockRunsFaster)
+{
+    IESetClock(IE_CLOCK_ACCELERATED, 100);
+    EXPECT_EQ(IEGetClockMode(), IE_CLOCK_ACCELERATED);
+
+    // Five seconds of timers pass in much less time on the clock of the system
+    auto start = std::chrono::steady_clock::now();
+    int done = 0;
+    INDI::Timer::singleShot(5000, [&done]()
+    {
+        done = 1;
+    });
+
+    EXPECT_EQ(IEDeferLoop(60000, &done), 0);
+    EXPECT_EQ(done, 1);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(1));
+}
+
+TEST_F(ClockTest, ClockGoesOnWhenSwitched)
+{
+    IESetClock(IE_CLOCK_STEPPED, 1);
+    IEAdvanceClock(10000);
+    double stepped = IEClockNow();
+
+    // Never goes back, timers and elapsed timers stay valid
+    IESetClock(IE_CLOCK_ACCELERATED, 10);
+    EXPECT_GE(IEClockNow(), stepped);
+    IEAdvanceClock(1000);
+    EXPECT_GE(IEClockNow(), stepped + 1000);
+    double accelerated = IEClockNow();
+    IESetClock(IE_CLOCK_REALTIME, 1);
+    EXPECT_GE(IEClockNow(), accelerated);
+}
@@ -0,0 +1,246 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+ .
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+ .
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "indicom.h"
+#include "connectionplugins/commandscheduler.h"
+
+using Command = Connection::CommandScheduler::Command;
+
+// LX200 mount on the master side of a pty. Every burst of input costs one link latency,
+// then all the complete commands it holds are answered.
+class MountEmulator
+{
+    public:
+        explicit MountEmulator(int latencyMs) : latencyMs(latencyMs)
+        {
+            master = posix_openpt(O_RDWR | O_NOCTTY);
+            grantpt(master);
+            unlockpt(master);
+            slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+
+            struct termios tty;
+            tcgetattr(slave, &tty);
+            cfmakeraw(&tty);
+            tcsetattr(slave, TCSANOW, &tty);
+
+            thread = std::thread(&MountEmulator::run, this);
+        }
+
+        ~MountEmulator()
+        {
+            stop = true;
+            thread.join();
+            close(slave);
+            close(master);
+        }
+
+        int slave {-1};
+        std::atomic<int> largestBurst {0};
+
+    private:
+        void run()
+        {
+            std::string pending;
+            while (!stop)
+            {
+                struct pollfd pfd = { master, POLLIN, 0 };
+                if (poll(&pfd, 1, 50) <= 0)
+                    continue;
+
+                std::this_thread::sleep_for(std::chrono::milliseconds(latencyMs));
+
+                char buffer[256];
+                ssize_t nbytes = read(master, buffer, sizeof(buffer));
+                if (nbytes <= 0)
+                    continue;
+                pending.append(buffer, nbytes);
+
+                std::string reply;
+                int burst = 0;
+                size_t end;
+                while (!pending.empty())
+                {
+                    // ACK is a single byte
+                    if (pending[0] == '\x06')
+                        end = 0;
+                    else if ((end = pending.find('#')) == std::string::npos)
+                        break;
+                    reply += answer(pending.substr(0, end + 1));
+                    pending.erase(0, end + 1);
+                    burst++;
+                }
+                if (burst > largestBurst)
+                    largestBurst = burst;
+                if (!reply.empty() && write(master, reply.data(), reply.size()) < 0)
+                    return;
+            }
+        }
+
+        std::string answer(const std::string &command)
+        {
+            if (command == ":GR#")
+                return "12:34:56#";
+            if (command == ":GD#")
+                return "+45*30:00#";
+            if (command == ":GVP#")
+                return "LX200#";
+            if (command == "\x06")
+                return "P";
+            // Motion commands and unknown commands get no answer
+            return "";
+        }
+
+        int latencyMs;
+        int master {-1};
+        std::atomic<bool> stop {false};
+        std::thread thread;
+};
+
+static std::vector<Command> statusPoll(int count)
+{
+    std::vector<Command> commands;
+    for (int i = 0; i < count; i++)
+    {
+        commands.emplace_back(":GR#");
+        commands.emplace_back(":GD#");
+    }
+    return commands;
+}
+
+static double timeExecute(Connection::CommandScheduler &scheduler, std::vector<Command> &commands)
+{
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_TRUE(scheduler.execute(commands));
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+TEST(CORE_COMMANDSCHEDULER, Test_responses_match_requests)
+{
+    MountEmulator mount(1);
+    Connection::CommandScheduler scheduler([&mount] { return mount.slave; });
+
+    for (size_t depth : { 1, 3, 8 })
+    {
+        scheduler.setPipelineDepth(depth);
+        auto commands = statusPoll(10);
+        ASSERT_TRUE(scheduler.execute(commands)) << "depth " << depth;
+        for (size_t i = 0; i < commands.size(); i += 2)
+        {
+            EXPECT_EQ(commands[i].response, "12:34:56");
+            EXPECT_EQ(commands[i + 1].response, "+45*30:00");
+            EXPECT_EQ(commands[i].error, TTY_OK);
+        }
+
+        double ra = 0;
+        EXPECT_EQ(f_scansexa(commands[0].response.c_str(), &ra), 0);
+        EXPECT_NEAR(ra, 12 + 34 / 60.0 + 56 / 3600.0, 1e-6);
+    }
+}
+
+TEST(CORE_COMMANDSCHEDULER, Test_pipelining_saves_round_trips)
+{
+    MountEmulator mount(20);
+    Connection::CommandScheduler scheduler([&mount] { return mount.slave; });
+
+    auto lockStep = statusPoll(5);
+    double lockStepTime = timeExecute(scheduler, lockStep);
+    EXPECT_EQ(mount.largestBurst, 1);
+
+    scheduler.setPipelineDepth(10);
+    auto pipelined = statusPoll(5);
+    double pipelinedTime = timeExecute(scheduler, pipelined);
+
+    EXPECT_GT(mount.largestBurst, 1);
+    EXPECT_LT(pipelinedTime, lockStepTime / 2) << "lock step " << lockStepTime << "s, pipelined " << pipelinedTime << "s";
+}
+
+TEST(CORE_COMMANDSCHEDULER, Test_fixed_length_and_silent_commands)
+{
+    MountEmulator mount(1);
+    Connection::CommandScheduler scheduler([&mount] { return mount.slave; });
+    scheduler.setPipelineDepth(4);
+
+    std::vector<Command> commands { Command::withLength("\x06", 1), Command::withLength(":Me#", 0), {":GVP#"},
+                                    Command::withLength(":Q#", 0), {":GR#"} };
+    ASSERT_TRUE(scheduler.execute(commands));
+    EXPECT_EQ(commands[0].response, "P");
+    EXPECT_EQ(commands[1].response, "");
+    EXPECT_EQ(commands[2].response, "LX200");
+    EXPECT_EQ(commands[4].response, "12:34:56");
+}
+
+TEST(CORE_COMMANDSCHEDULER, Test_timeout_fails_the_rest_of_the_batch)
+{
+    MountEmulator mount(1);
+    Connection::CommandScheduler scheduler([&mount] { return mount.slave; });
+    scheduler.setTimeout(1);
+
+    std::vector<Command> commands { {":GR#"}, {":XX#"}, {":GD#"} };
+    EXPECT_FALSE(scheduler.execute(commands));
+    EXPECT_EQ(commands[0].error, TTY_OK);
+    EXPECT_EQ(commands[1].error, TTY_TIME_OUT);
+    EXPECT_EQ(commands[2].error, TTY_TIME_OUT);
+
+    // The next batch starts clean
+    Command command(":GD#");
+    EXPECT_TRUE(scheduler.execute(command));
+    EXPECT_EQ(command.response, "+45*30:00");
+
+    auto statistics = scheduler.statistics();
+    EXPECT_EQ(statistics[":GR#"].count, 1u);
+    EXPECT_EQ(statistics[":XX#"].errors, 1u);
+    EXPECT_EQ(statistics[":GD#"].count, 1u);
+    EXPECT_GT(statistics[":GD#"].average(), 0);
+    EXPECT_LE(statistics[":GD#"].min, statistics[":GD#"].max);
+}
+
+TEST(CORE_COMMANDSCHEDULER, Test_statistics_are_bounded)
+{
+    MountEmulator mount(1);
+    Connection::CommandScheduler scheduler([&mount] { return mount.slave; });
+
+    // Silent commands with a parameter, each one a different request string
+    std::vector<Command> commands;
+    for (size_t i = 0; i < 2 * Connection::CommandScheduler::MaxStatistics; i++)
+        commands.push_back(Command::withLength(":Sr" + std::to_string(i) + "#", 0));
+    ASSERT_TRUE(scheduler.execute(commands));
+
+    auto statistics = scheduler.statistics();
+    EXPECT_LE(statistics.size(), Connection::CommandScheduler::MaxStatistics + 1);
+    EXPECT_EQ(statistics[""].count, Connection::CommandScheduler::MaxStatistics);
+}
+
+TEST(CORE_COMMANDSCHEDULER, Test_disconnected_port)
+{
+    Connection::CommandScheduler scheduler([] { return -1; });
+    Command command(":GR#");
+    EXPECT_FALSE(scheduler.execute(command));
+    EXPECT_EQ(command.error, TTY_PORT_FAILURE);
+}
@@ -0,0 +1,257 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+ .
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+ .
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <dirent.h>
+#include <dlfcn.h>
+#include <unistd.h>
+
+#include "defaultdevice.h"
+#include "indidriver.h"
+
+// Count every fopen() of the configuration file, including those made by the driver library
+static char configPath[PATH_MAX] = {0};
+static std::atomic<int> configOpens {0};
+
+typedef FILE *(*fopen_t)(const char *, const char *);
+
+static FILE *countedOpen(const char *symbol, const char *path, const char *mode)
+{
+    fopen_t real = reinterpret_cast<fopen_t>(dlsym(RTLD_NEXT, symbol));
+    if (path != nullptr && configPath[0] != '\0' && !strcmp(path, configPath))
+        configOpens++;
+    return real(path, mode);
+}
+
+extern "C" FILE *fopen(const char *path, const char *mode)
+{
+    return countedOpen("fopen", path, mode);
+}
+
+extern "C" FILE *fopen64(const char *path, const char *mode)
+{
+    return countedOpen("fopen64", path, mode);
+}
+
+static const char *DEVICE_NAME = "Config Cache Test";
+static const int PROPERTY_COUNT = 20;
+
+class ConfigDevice : public INDI::DefaultDevice
+{
+    public:
+        ConfigDevice()
+        {
+            setDeviceName(DEVICE_NAME);
+        }
+
+        const char *getDefaultName() override
+        {
+            return DEVICE_NAME;
+        }
+
+        bool initProperties() override
+        {
+            INDI::DefaultDevice::initProperties();
+
+            for (int i = 0; i < PROPERTY_COUNT; i++)
+            {
+                Settings.emplace_back(1);
+                std::string name = "SETTING_" + std::to_string(i);
+                Settings[i][0].fill("VALUE", "Value", "%g", 0, 1000, 1, i);
+                Settings[i].fill(getDeviceName(), name.c_str(), name.c_str(), MAIN_CONTROL_TAB, IP_RW, 60, IPS_IDLE);
+                defineProperty(Settings[i]);
+            }
+            return true;
+        }
+
+        bool ISNewNumber(const char *dev, const char *name, double values[], char *names[], int n) override
+        {
+            for (auto &oneSetting : Settings)
+            {
+                if (oneSetting.isNameMatch(name))
+                {
+                    oneSetting.update(values, names, n);
+                    return true;
+                }
+            }
+            return INDI::DefaultDevice::ISNewNumber(dev, name, values, names, n);
+        }
+
+        // What a driver does in updateProperties() once it is connected
+        void connect()
+        {
+            for (auto &oneSetting : Settings)
+                loadConfig(oneSetting);
+
+            double value = 0;
+            IUGetConfigNumber(getDeviceName(), "SETTING_0", "VALUE", &value);
+        }
+
+        using INDI::DefaultDevice::loadConfig;
+        using INDI::DefaultDevice::saveConfig;
+
+        std::vector<INDI::PropertyNumber> Settings;
+
+    protected:
+        bool saveConfigItems(FILE *fp) override
+        {
+            INDI::DefaultDevice::saveConfigItems(fp);
+            for (auto &oneSetting : Settings)
+                oneSetting.save(fp);
+            return true;
+        }
+};
+
+class ConfigCacheTest : public ::testing::Test
+{
+    protected:
+        void SetUp() override
+        {
+            char dir[] = "/tmp/indi_config_XXXXXX";
+            ASSERT_NE(mkdtemp(dir), nullptr);
+            configDir = dir;
+            snprintf(configPath, sizeof(configPath), "%s/config.xml", dir);
+            setenv("INDICONFIG", configPath, 1);
+
+            device.ISGetProperties(DEVICE_NAME);
+            ASSERT_TRUE(device.saveConfig());
+        }
+
+        void TearDown() override
+        {
+            char errmsg[MAXRBUF];
+            IUFlushConfig(nullptr, DEVICE_NAME, errmsg);
+            for (const auto &name : files())
+                unlink((configDir + "/" + name).c_str());
+            rmdir(configDir.c_str());
+            unsetenv("INDICONFIG");
+            configPath[0] = '\0';
+        }
+
+        std::vector<std::string> files() const
+        {
+            std::vector<std::string> result;
+            DIR *dir = opendir(configDir.c_str());
+            while (dirent *entry = readdir(dir))
+            {
+                if (strcmp(entry->d_name, ".") && strcmp(entry->d_name, ".."))
+                    result.push_back(entry->d_name);
+            }
+            closedir(dir);
+            return result;
+        }
+
+        std::string savedText() const
+        {
+            std::ifstream file(configPath);
+            std::stringstream text;
+            text << file.rdbuf();
+            return text.str();
+        }
+
+        std::string configDir;
+        ConfigDevice device;
+};
+
+TEST_F(ConfigCacheTest, Test_connect_opens_config_once)
+{
+    configOpens = 0;
+    device.connect();
+    EXPECT_EQ(configOpens, 1);
+
+    // Nothing changed on disk, a second connection is served from memory
+    configOpens = 0;
+    device.connect();
+    EXPECT_EQ(configOpens, 0);
+}
+
+TEST_F(ConfigCacheTest, Test_load_applies_cached_values)
+{
+    device.Settings[3][0].setValue(999);
+    ASSERT_TRUE(device.loadConfig(device.Settings[3]));
+    EXPECT_EQ(device.Settings[3][0].getValue(), 3);
+}
+
+TEST_F(ConfigCacheTest, Test_external_change_is_reloaded)
+{
+    device.connect();
+
+    std::string text = savedText();
+    size_t position = text.find("SETTING_5");
+    ASSERT_NE(position, std::string::npos);
+    position = text.find("5\n", text.find("oneNumber", position));
+    ASSERT_NE(position, std::string::npos);
+    text.replace(position, 1, "77");
+    // A different size makes the change visible even within the same second
+    std::ofstream(configPath) << text;
+
+    configOpens = 0;
+    ASSERT_TRUE(device.loadConfig(device.Settings[5]));
+    EXPECT_EQ(configOpens, 1);
+    EXPECT_EQ(device.Settings[5][0].getValue(), 77);
+}
+
+TEST_F(ConfigCacheTest, Test_property_saves_are_debounced)
+{
+    std::string before = savedText();
+
+    configOpens = 0;
+    for (int i = 0; i < 100; i++)
+    {
+        device.Settings[7][0].setValue(100 + i);
+        ASSERT_TRUE(device.saveConfig(device.Settings[7]));
+    }
+
+    // Only the first save had to read the file, nothing was written yet
+    EXPECT_LE(configOpens, 1);
+    EXPECT_EQ(savedText(), before);
+
+    char errmsg[MAXRBUF];
+    ASSERT_EQ(IUFlushConfig(nullptr, DEVICE_NAME, errmsg), 0) << errmsg;
+    EXPECT_NE(savedText().find("199"), std::string::npos);
+
+    // The temporary file was renamed over the configuration
+    for (const auto &name : files())
+        EXPECT_TRUE(name == "config.xml" || name == "config.xml.default") << name;
+
+    device.Settings[7][0].setValue(0);
+    ASSERT_TRUE(device.loadConfig(device.Settings[7]));
+    EXPECT_EQ(device.Settings[7][0].getValue(), 199);
+}
+
+TEST_F(ConfigCacheTest, Test_property_save_is_written_in_background)
+{
+    device.Settings[9][0].setValue(321);
+    ASSERT_TRUE(device.saveConfig(device.Settings[9]));
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (savedText().find("321") == std::string::npos && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    EXPECT_NE(savedText().find("321"), std::string::npos);
+}
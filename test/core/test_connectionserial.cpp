@@ -0,0 +1,259 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+ .
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+ .
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "defaultdevice.h"
+#include "indicom.h"
+#include "connectionplugins/connectionserial.h"
+
+// Serial port on the slave side of a pty. A mount answers :GR# on the master side when asked to.
+class SerialPort
+{
+    public:
+        explicit SerialPort(bool answer) : answer(answer)
+        {
+            master = posix_openpt(O_RDWR | O_NOCTTY);
+            grantpt(master);
+            unlockpt(master);
+            path = ptsname(master);
+            thread = std::thread(&SerialPort::run, this);
+        }
+
+        ~SerialPort()
+        {
+            stop = true;
+            thread.join();
+            close(master);
+        }
+
+        std::string path;
+
+    private:
+        void run()
+        {
+            std::string pending;
+            while (!stop)
+            {
+                struct pollfd pfd = { master, POLLIN, 0 };
+                if (poll(&pfd, 1, 50) <= 0)
+                    continue;
+                // Nobody has the port open
+                if (!(pfd.revents & POLLIN))
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                    continue;
+                }
+
+                char buffer[256];
+                ssize_t nbytes = read(master, buffer, sizeof(buffer));
+                if (nbytes <= 0)
+                    continue;
+                pending.append(buffer, nbytes);
+
+                size_t end;
+                while ((end = pending.find('#')) != std::string::npos)
+                {
+                    if (answer && pending.compare(0, end + 1, ":GR#") == 0 && write(master, "12:34:56#", 9) < 0)
+                        return;
+                    pending.erase(0, end + 1);
+                }
+            }
+        }
+
+        bool answer;
+        int master {-1};
+        std::atomic<bool> stop {false};
+        std::thread thread;
+};
+
+class SerialDevice : public INDI::DefaultDevice
+{
+    public:
+        explicit SerialDevice(const char *name)
+        {
+            setDeviceName(name);
+        }
+
+        const char *getDefaultName() override
+        {
+            return "Serial Test";
+        }
+};
+
+class TestSerial : public Connection::Serial
+{
+    public:
+        explicit TestSerial(INDI::DefaultDevice *dev) : Connection::Serial(dev) {}
+
+        using Connection::Serial::Connect;
+        using Connection::Serial::probePorts;
+        using Connection::Serial::knownPort;
+        using Connection::Serial::rememberPort;
+
+        // Stable names of the ports, like /dev/serial/by-id holds for USB adapters
+        std::map<std::string, std::string> stableNames;
+
+    protected:
+        std::string stablePortName(const std::string &port) const override
+        {
+            auto stable = stableNames.find(port);
+            return stable == stableNames.end() ? std::string() : stable->second;
+        }
+};
+
+static bool probeMount(int fd)
+{
+    char response[32] = {0};
+    int nbytes = 0;
+    return tty_write_string(fd, ":GR#", &nbytes) == TTY_OK &&
+           tty_read_section(fd, response, '#', 1, &nbytes) == TTY_OK &&
+           std::string(response, nbytes) == "12:34:56#";
+}
+
+// The port bindings are saved in $HOME/.indi
+class ConnectionSerialTest : public ::testing::Test
+{
+    protected:
+        void SetUp() override
+        {
+            char dir[] = "/tmp/indi_serial_XXXXXX";
+            ASSERT_NE(mkdtemp(dir), nullptr);
+            home = dir;
+            mkdir((home + "/.indi").c_str(), 0755);
+
+            const char *previous = getenv("HOME");
+            previousHome = previous ? previous : "";
+            setenv("HOME", home.c_str(), 1);
+        }
+
+        void TearDown() override
+        {
+            unlink((home + "/.indi/SerialPortBindings.txt").c_str());
+            unlink((home + "/stable").c_str());
+            rmdir((home + "/.indi").c_str());
+            rmdir(home.c_str());
+            setenv("HOME", previousHome.c_str(), 1);
+        }
+
+        std::string home;
+        std::string previousHome;
+        SerialDevice device {"Serial Test"};
+        SerialDevice otherDevice {"Other Serial Test"};
+};
+
+TEST_F(ConnectionSerialTest, Test_probe_finds_the_answering_port)
+{
+    SerialPort silent(false), mount(true), otherSilent(false);
+    TestSerial serial(&device);
+    serial.registerProbe(probeMount);
+
+    EXPECT_EQ(serial.probePorts({ silent.path, mount.path, otherSilent.path }, 9600), mount.path);
+    EXPECT_EQ(serial.probePorts({ silent.path, otherSilent.path }, 9600), "");
+}
+
+TEST_F(ConnectionSerialTest, Test_probe_skips_locked_ports)
+{
+    SerialPort mount(true);
+    TestSerial serial(&device);
+    serial.registerProbe(probeMount);
+
+    // Another driver holds the port
+    int fd = open(mount.path.c_str(), O_RDWR | O_NOCTTY);
+    ASSERT_EQ(flock(fd, LOCK_EX | LOCK_NB), 0);
+
+    EXPECT_EQ(serial.probePorts({ mount.path }, 9600), mount.path);
+    serial.setPortLock(true);
+    EXPECT_EQ(serial.probePorts({ mount.path }, 9600), "");
+
+    close(fd);
+    EXPECT_EQ(serial.probePorts({ mount.path }, 9600), mount.path);
+}
+
+TEST_F(ConnectionSerialTest, Test_lock_contention)
+{
+    SerialPort mount(true);
+    TestSerial serial(&device), other(&otherDevice);
+
+    // Without lock, a port held by another process is shared
+    int fd = open(mount.path.c_str(), O_RDWR | O_NOCTTY);
+    ASSERT_EQ(flock(fd, LOCK_EX | LOCK_NB), 0);
+    ASSERT_TRUE(serial.Connect(mount.path.c_str(), 9600));
+    serial.Disconnect();
+
+    serial.setPortLock(true);
+    EXPECT_FALSE(serial.Connect(mount.path.c_str(), 9600));
+    EXPECT_EQ(serial.getPortFD(), -1);
+    close(fd);
+
+    // The lock is held while connected and released on disconnection
+    ASSERT_TRUE(serial.Connect(mount.path.c_str(), 9600));
+    fd = open(mount.path.c_str(), O_RDWR | O_NOCTTY);
+    if (fd >= 0)
+    {
+        EXPECT_EQ(flock(fd, LOCK_EX | LOCK_NB), -1);
+        close(fd);
+    }
+    serial.Disconnect();
+
+    other.setPortLock(true);
+    EXPECT_TRUE(other.Connect(mount.path.c_str(), 9600));
+    other.Disconnect();
+}
+
+TEST_F(ConnectionSerialTest, Test_remembered_port)
+{
+    SerialPort mount(true);
+    TestSerial serial(&device), other(&otherDevice);
+    std::string stable = home + "/stable";
+    ASSERT_EQ(symlink(mount.path.c_str(), stable.c_str()), 0);
+
+    EXPECT_EQ(serial.knownPort(), "");
+
+    // Ports without a stable name are not remembered
+    serial.rememberPort(mount.path);
+    EXPECT_EQ(serial.knownPort(), "");
+
+    serial.stableNames[mount.path] = stable;
+    serial.rememberPort(mount.path);
+    EXPECT_EQ(serial.knownPort(), stable);
+    EXPECT_EQ(other.knownPort(), "");
+
+    // Bindings of other devices are kept
+    other.stableNames[mount.path] = stable;
+    other.rememberPort(mount.path);
+    EXPECT_EQ(serial.knownPort(), stable);
+    EXPECT_EQ(other.knownPort(), stable);
+
+    // The device is unplugged
+    unlink(stable.c_str());
+    EXPECT_EQ(serial.knownPort(), "");
+}
@@ -0,0 +1,256 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+ .
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+ .
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fitsio.h>
+
+#include "fitswriter.h"
+
+using INDI::FITSRecord;
+using INDI::FITSWriter;
+
+static std::vector<FITSRecord> sampleRecords()
+{
+    std::vector<FITSRecord> records;
+    records.emplace_back("ROWORDER", "TOP-DOWN", "Row Order");
+    records.emplace_back("INSTRUME", "CCD Simulator", "CCD Name");
+    records.emplace_back("TELESCOP", "Telescope Simulator", "Telescope name");
+    records.emplace_back("OBSERVER", "O'Brien", "Observer name");
+    records.emplace_back("EXPTIME", 1.5, 6, "Total Exposure Time (s)");
+    records.emplace_back("CCD-TEMP", -10.25, 3, "CCD Temperature (Celsius)");
+    records.emplace_back("PIXSIZE1", 5.2, 6, "Pixel Size 1 (microns)");
+    records.emplace_back("XBINNING", int64_t(2), "Binning factor in width");
+    records.emplace_back("OFFSET", int64_t(-15), "Offset");
+    records.emplace_back("GAIN", 3.14159265, -5, "Gain");
+    records.emplace_back("FRAME", "Light", "Frame Type");
+    records.emplace_back("Generated by INDI");
+    records.emplace_back("A comment long enough to be split over several cards by fits_write_comment, like CFITSIO does");
+    records.emplace_back("EXPTIME", 2.0, 3, "Updated exposure time");
+    records.emplace_back("DATE-OBS", "2024-03-01T21:04:12.125", "UTC start date of observation");
+    return records;
+}
+
+// The file CFITSIO writes for the same image, through the path CCD::ExposureCompletePrivate() falls back to
+static std::vector<uint8_t> writeWithCFITSIO(int bpp, int naxis, long naxes[], const std::vector<FITSRecord> &records,
+        const void *pixels, long nelements)
+{
+    size_t memorySize = 2880;
+    void *memory = malloc(memorySize);
+    fitsfile *fptr = nullptr;
+    int status = 0;
+
+    fits_create_memfile(&fptr, &memory, &memorySize, 2880, realloc, &status);
+    EXPECT_EQ(status, 0);
+    status = FITSWriter::writeWithCFITSIO(fptr, bpp, naxis, naxes, records, pixels, nelements,
+                                          [](const FITSRecord & record, int keyStatus)
+    {
+        ADD_FAILURE() << "key " << record.key() << " failed with status " << keyStatus;
+    });
+    fits_close_file(fptr, &status);
+    EXPECT_EQ(status, 0);
+
+    std::vector<uint8_t> file(static_cast<uint8_t *>(memory), static_cast<uint8_t *>(memory) + memorySize);
+    free(memory);
+    return file;
+}
+
+template <typename T>
+static std::vector<T> testPattern(size_t count)
+{
+    std::vector<T> pixels(count);
+    uint64_t value = 0x0123456789abcdefULL;
+    for (auto &pixel : pixels)
+    {
+        value = value * 6364136223846793005ULL + 1442695040888963407ULL;
+        pixel = static_cast<T>(value >> 32);
+    }
+    // Both ends of the range
+    pixels[0] = 0;
+    pixels[1] = static_cast<T>(~T(0));
+    return pixels;
+}
+
+template <typename T>
+static void roundTrip(int bpp, int naxis)
+{
+    // Odd sizes so the pixel data does not fill the last block and the encoder tail runs
+    long naxes[3] = { 101, 37, 3 };
+    long nelements = naxes[0] * naxes[1] * (naxis == 3 ? 3 : 1);
+    auto pixels = testPattern<T>(nelements);
+    auto records = sampleRecords();
+
+    FITSWriter writer(bpp, naxis, naxes);
+    ASSERT_TRUE(writer.setRecords(records));
+    ASSERT_EQ(writer.header().size() % 2880, 0u);
+    ASSERT_EQ(writer.size() % 2880, 0u);
+
+    std::vector<uint8_t> file(writer.size());
+    writer.write(file.data(), pixels.data());
+
+    // Same bytes as CFITSIO
+    auto expected = writeWithCFITSIO(bpp, naxis, naxes, records, pixels.data(), nelements);
+    ASSERT_GE(expected.size(), file.size());
+    for (size_t i = 0; i < writer.header().size(); i += 80)
+        EXPECT_EQ(std::string(writer.header(), i, 80), std::string(reinterpret_cast<char *>(expected.data()) + i, 80));
+    EXPECT_EQ(memcmp(file.data(), expected.data(), file.size()), 0);
+
+    // And CFITSIO reads it back
+    void *memory = file.data();
+    size_t memorySize = file.size();
+    fitsfile *fptr = nullptr;
+    int status = 0;
+    fits_open_memfile(&fptr, "", READONLY, &memory, &memorySize, 0, nullptr, &status);
+    ASSERT_EQ(status, 0);
+
+    double exposure = 0;
+    fits_read_key(fptr, TDOUBLE, "EXPTIME", &exposure, nullptr, &status);
+    EXPECT_EQ(exposure, 2.0);
+    char observer[FLEN_VALUE] = {0};
+    fits_read_key(fptr, TSTRING, "OBSERVER", observer, nullptr, &status);
+    EXPECT_STREQ(observer, "O'Brien");
+    long binning = 0;
+    fits_read_key(fptr, TLONG, "XBINNING", &binning, nullptr, &status);
+    EXPECT_EQ(binning, 2);
+
+    std::vector<T> readBack(nelements);
+    int dataType = bpp == 8 ? TBYTE : (bpp == 16 ? TUSHORT : TUINT);
+    fits_read_img(fptr, dataType, 1, nelements, nullptr, readBack.data(), nullptr, &status);
+    EXPECT_EQ(status, 0);
+    EXPECT_EQ(readBack, pixels);
+
+    fits_close_file(fptr, &status);
+}
+
+TEST(FITSWriterTest, RoundTrip8)
+{
+    roundTrip<uint8_t>(8, 2);
+}
+
+TEST(FITSWriterTest, RoundTrip16)
+{
+    roundTrip<uint16_t>(16, 2);
+}
+
+TEST(FITSWriterTest, RoundTrip32)
+{
+    roundTrip<uint32_t>(32, 2);
+}
+
+TEST(FITSWriterTest, RoundTripColor)
+{
+    roundTrip<uint16_t>(16, 3);
+}
+
+TEST(FITSWriterTest, EncodePixels)
+{
+    const uint16_t pixels16[] = { 0x0000, 0x8000, 0xffff, 0x1234 };
+    uint8_t out16[sizeof(pixels16)];
+    FITSWriter::encodePixels(out16, pixels16, 4, 16);
+    const uint8_t expected16[] = { 0x80, 0x00, 0x00, 0x00, 0x7f, 0xff, 0x92, 0x34 };
+    EXPECT_EQ(memcmp(out16, expected16, sizeof(expected16)), 0);
+
+    const uint32_t pixels32[] = { 0x00000000, 0x80000000, 0x12345678 };
+    uint8_t out32[sizeof(pixels32)];
+    FITSWriter::encodePixels(out32, pixels32, 3, 32);
+    const uint8_t expected32[] = { 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x92, 0x34, 0x56, 0x78 };
+    EXPECT_EQ(memcmp(out32, expected32, sizeof(expected32)), 0);
+}
+
+TEST(FITSWriterTest, FallsBackToCFITSIO)
+{
+    long naxes[2] = { 16, 16 };
+
+    // Keywords CFITSIO writes with the HIERARCH convention
+    FITSWriter longKey(16, 2, naxes);
+    EXPECT_FALSE(longKey.setRecords({ FITSRecord("FOCUSPOSITION", int64_t(1000), "Focuser position") }));
+
+    FITSWriter notANumber(16, 2, naxes);
+    EXPECT_FALSE(notANumber.setRecords({ FITSRecord("CCD-TEMP", std::nan(""), 3, "CCD Temperature") }));
+
+    // Structural keywords belong to the writer
+    FITSWriter structural(16, 2, naxes);
+    EXPECT_FALSE(structural.setRecords({ FITSRecord("NAXIS1", int64_t(8), "Width") }));
+
+    // Signed or floating point images
+    FITSWriter floating(-32, 2, naxes);
+    EXPECT_FALSE(floating.setRecords({}));
+
+    FITSWriter lowerCase(16, 2, naxes);
+    EXPECT_TRUE(lowerCase.setRecords({ FITSRecord("filter", "Red", "Filter") }));
+    EXPECT_NE(lowerCase.header().find("FILTER  = 'Red     '"), std::string::npos);
+}
+
+TEST(FITSWriterTest, FallbackWritesRefusedRecords)
+{
+    long naxes[2] = { 4, 2 };
+    std::vector<uint16_t> pixels = { 0, 1, 2, 3, 32767, 32768, 40000, 65535 };
+    std::vector<FITSRecord> records = sampleRecords();
+    records.emplace_back("FOCUSPOSITION", int64_t(1000), "Focuser position");
+    records.emplace_back("CCD-TEMP", std::nan(""), 3, "CCD Temperature");
+
+    FITSWriter writer(16, 2, naxes);
+    ASSERT_FALSE(writer.setRecords(records));
+
+    auto file = writeWithCFITSIO(16, 2, naxes, records, pixels.data(), pixels.size());
+
+    void *memory = file.data();
+    size_t memorySize = file.size();
+    fitsfile *fptr = nullptr;
+    int status = 0;
+    fits_open_memfile(&fptr, "fallback", READONLY, &memory, &memorySize, 0, nullptr, &status);
+    ASSERT_EQ(status, 0);
+
+    long position = 0;
+    fits_read_key_lng(fptr, "FOCUSPOSITION", &position, nullptr, &status);
+    EXPECT_EQ(status, 0);
+    EXPECT_EQ(position, 1000);
+
+    char instrument[FLEN_VALUE] = {0};
+    fits_read_key_str(fptr, "INSTRUME", instrument, nullptr, &status);
+    EXPECT_EQ(status, 0);
+    EXPECT_STREQ(instrument, "CCD Simulator");
+
+    std::vector<uint16_t> readBack(pixels.size());
+    int anyNull = 0;
+    fits_read_img(fptr, TUSHORT, 1, readBack.size(), nullptr, readBack.data(), &anyNull, &status);
+    EXPECT_EQ(status, 0);
+    EXPECT_EQ(readBack, pixels);
+
+    fits_close_file(fptr, &status);
+}
+
+TEST(FITSWriterTest, FallbackRejectsUnsupportedDepth)
+{
+    long naxes[2] = { 1, 1 };
+    size_t memorySize = 2880;
+    void *memory = malloc(memorySize);
+    fitsfile *fptr = nullptr;
+    int status = 0;
+    float pixel = 0;
+
+    fits_create_memfile(&fptr, &memory, &memorySize, 2880, realloc, &status);
+    EXPECT_EQ(FITSWriter::writeWithCFITSIO(fptr, -32, 2, naxes, {}, &pixel, 1), BAD_BITPIX);
+    status = 0;
+    fits_close_file(fptr, &status);
+    free(memory);
+}
@@ -0,0 +1,120 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+ .
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+ .
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <thread>
+
+#include "stream/framering.h"
+
+TEST(CORE_FRAMERING, Test_acquire_until_full)
+{
+    INDI::FrameRing ring;
+    ring.resize(16, 2);
+
+    uint8_t *first = ring.acquire();
+    ASSERT_NE(first, nullptr);
+    // The slot belongs to the producer until it is committed
+    EXPECT_EQ(ring.acquire(), first);
+    ring.commit(16);
+
+    uint8_t *second = ring.acquire();
+    ASSERT_NE(second, nullptr);
+    EXPECT_NE(second, first);
+    ring.commit(8, 1);
+
+    EXPECT_EQ(ring.size(), 2u);
+    EXPECT_EQ(ring.acquire(), nullptr);
+    EXPECT_EQ(ring.acquire(10), nullptr);
+
+    INDI::FrameRing::Frame frame;
+    ASSERT_TRUE(ring.peek(frame));
+    EXPECT_EQ(frame.data, first);
+    EXPECT_EQ(frame.size, 16u);
+    EXPECT_EQ(frame.tag, 0u);
+    ring.release();
+
+    ASSERT_TRUE(ring.peek(frame));
+    EXPECT_EQ(frame.data, second);
+    EXPECT_EQ(frame.size, 8u);
+    EXPECT_EQ(frame.tag, 1u);
+    ring.release();
+
+    EXPECT_FALSE(ring.peek(frame));
+    EXPECT_TRUE(ring.waitForEmpty(0));
+    EXPECT_EQ(ring.acquire(), first);
+}
+
+TEST(CORE_FRAMERING, Test_abort_wakes_consumer)
+{
+    INDI::FrameRing ring;
+    ring.resize(16, 2);
+
+    std::thread aborter([&ring]
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        ring.abort();
+    });
+
+    INDI::FrameRing::Frame frame;
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_FALSE(ring.peek(frame, 10000));
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+    aborter.join();
+}
+
+TEST(CORE_FRAMERING, Test_frames_are_never_torn)
+{
+    const size_t frameSize = 4096;
+    const uint32_t frames = 20000;
+
+    INDI::FrameRing ring;
+    ring.resize(frameSize, 4);
+
+    std::thread producer([&]
+    {
+        for (uint32_t i = 0; i < frames; i++)
+        {
+            uint8_t *data;
+            while ((data = ring.acquire(1000)) == nullptr);
+            memset(data, i & 0xff, frameSize);
+            ring.commit(frameSize, i);
+        }
+    });
+
+    uint32_t expected = 0;
+    uint32_t torn = 0;
+    INDI::FrameRing::Frame frame;
+    while (expected < frames && ring.peek(frame, 1000))
+    {
+        EXPECT_EQ(frame.tag, expected);
+        for (size_t i = 0; i < frame.size; i++)
+        {
+            if (frame.data[i] != (expected & 0xff))
+            {
+                torn++;
+                break;
+            }
+        }
+        ring.release();
+        expected++;
+    }
+
+    producer.join();
+    EXPECT_EQ(expected, frames);
+    EXPECT_EQ(torn, 0u);
+}
@@ -0,0 +1,175 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+ .
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+ .
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "indilogbackend.h"
+
+using INDI::LogBackend;
+
+// Keeps everything the backend hands over
+class RecordingSink : public LogBackend::Sink
+{
+    public:
+        void write(const LogBackend::Record &record) override
+        {
+            std::lock_guard<std::mutex> lock(m_Lock);
+            // Blocks the writer thread while the test holds the gate
+            std::lock_guard<std::mutex> gate(gateLock);
+            file.push_back(record.text);
+        }
+
+        void flush() override
+        {
+            std::lock_guard<std::mutex> lock(m_Lock);
+            flushes++;
+        }
+
+        void message(const char *device, unsigned int, const char *text) override
+        {
+            std::lock_guard<std::mutex> lock(m_Lock);
+            screen.push_back(std::string(device) + ": " + text);
+        }
+
+        std::mutex gateLock;
+        std::vector<std::string> file;
+        std::vector<std::string> screen;
+        int flushes {0};
+
+    private:
+        std::mutex m_Lock;
+};
+
+static void log(LogBackend &backend, unsigned int level, bool file, bool screen, const char *format, ...)
+{
+    va_list ap;
+    va_start(ap, format);
+    backend.push("Dev", level, file, screen, format, ap);
+    va_end(ap);
+}
+
+TEST(LogBackendTest, OrderAndLongLines)
+{
+    RecordingSink sink;
+    LogBackend backend(&sink, 16);
+
+    std::string longLine(10000, 'x');
+    for (int i = 0; i < 10; i++)
+        log(backend, 1, true, false, "line %d", i);
+    log(backend, 1, true, true, "%s", longLine.c_str());
+    backend.flush();
+
+    ASSERT_EQ(sink.file.size(), 11u);
+    for (int i = 0; i < 10; i++)
+        EXPECT_EQ(sink.file[i], "line " + std::to_string(i));
+    EXPECT_EQ(sink.file[10], longLine);
+    ASSERT_EQ(sink.screen.size(), 1u);
+    EXPECT_EQ(sink.screen[0], "Dev: " + longLine);
+    EXPECT_GE(sink.flushes, 1);
+}
+
+TEST(LogBackendTest, CoalesceRepeatedMessages)
+{
+    RecordingSink sink;
+    LogBackend backend(&sink);
+
+    for (int i = 0; i < 5; i++)
+        log(backend, 1, true, true, "Timeout reading from port");
+    log(backend, 1, true, true, "Connected");
+    backend.flush();
+
+    // Every copy is in the file, the client gets one and a summary
+    EXPECT_EQ(sink.file.size(), 6u);
+    ASSERT_EQ(sink.screen.size(), 3u);
+    EXPECT_EQ(sink.screen[0], "Dev: Timeout reading from port");
+    EXPECT_EQ(sink.screen[1], "Dev: last message repeated 4 times");
+    EXPECT_EQ(sink.screen[2], "Dev: Connected");
+    EXPECT_EQ(backend.statistics().coalesced, 4u);
+}
+
+TEST(LogBackendTest, RateLimit)
+{
+    RecordingSink sink;
+    LogBackend backend(&sink);
+    // Practically no refill during the test
+    backend.setRateLimit(0.001, 10, 1);
+    backend.flush();
+
+    for (int i = 0; i < 50; i++)
+        log(backend, 8, true, true, "debug %d", i);
+    log(backend, 1, true, true, "error");
+    backend.flush();
+
+    EXPECT_EQ(sink.file.size(), 51u);
+    // The burst, the exempt error preceded by the summary of what was held back
+    ASSERT_EQ(sink.screen.size(), 12u);
+    EXPECT_EQ(sink.screen[9], "Dev: debug 9");
+    EXPECT_EQ(sink.screen[10], "Dev: 40 messages were not sent to the client to limit the rate, see the log file");
+    EXPECT_EQ(sink.screen[11], "Dev: error");
+    EXPECT_EQ(backend.statistics().limited, 40u);
+}
+
+TEST(LogBackendTest, DropWhenFull)
+{
+    RecordingSink sink;
+    LogBackend backend(&sink, 8);
+
+    {
+        // The writer blocks on the first message, the ring fills up behind it
+        std::lock_guard<std::mutex> gate(sink.gateLock);
+        for (int i = 0; i < 100; i++)
+            log(backend, 1, true, false, "message %d", i);
+    }
+    backend.flush();
+
+    auto statistics = backend.statistics();
+    EXPECT_GT(statistics.dropped, 0u);
+    EXPECT_EQ(statistics.messages + statistics.dropped, 100u);
+    ASSERT_EQ(sink.file.size(), statistics.messages + 1);
+    EXPECT_EQ(sink.file.back(), std::to_string(statistics.dropped) + " log messages were dropped, the log queue was full");
+}
+
+TEST(LogBackendTest, ConcurrentProducers)
+{
+    RecordingSink sink;
+    LogBackend backend(&sink, 1 << 16);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++)
+        threads.emplace_back([&backend, t]()
+        {
+            for (int i = 0; i < 5000; i++)
+                log(backend, 8, true, false, "%d %d", t, i);
+        });
+    for (auto &thread : threads)
+        thread.join();
+    backend.flush();
+
+    ASSERT_EQ(sink.file.size(), 20000u);
+    // Each thread's messages are in the order it printed them
+    std::vector<int> next(4, 0);
+    for (auto &line : sink.file)
+    {
+        int t, i;
+        ASSERT_EQ(sscanf(line.c_str(), "%d %d", &t, &i), 2);
+        EXPECT_EQ(i, next[t]++);
+    }
+}
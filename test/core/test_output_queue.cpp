@@ -0,0 +1,275 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+ .
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+ .
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "indibase.h"
+#include "indidevapi.h"
+#include "indidriver.h"
+#include "indilogger.h"
+#include "lilxml.h"
+#include "userio.h"
+
+extern "C" {
+#include "indidriverio.h"
+}
+
+#define DEVICE "Queue Test"
+
+// The driver side of the connection is given to the library, the test reads what indiserver would
+class ServerConnection
+{
+    public:
+        ServerConnection()
+        {
+            int fds[2];
+            EXPECT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+            driverFd = fds[0];
+            serverFd = fds[1];
+            driverio_set_fd(driverFd);
+            EXPECT_EQ(IDOutputQueueEnable(64 * 1024), 0);
+            parser = newLilXML();
+        }
+
+        ~ServerConnection()
+        {
+            IDOutputQueueFlush();
+            close(driverFd);
+            close(serverFd);
+            for (int fd : attached)
+                close(fd);
+            delLilXML(parser);
+        }
+
+        // Keeps the writer thread sending a message larger than what the connection buffers
+        void stall()
+        {
+            static std::string text(4 * 1024 * 1024, 'x');
+            static IText t;
+            static ITextVectorProperty tvp;
+            IUFillText(&t, "TEXT", "Text", text.c_str());
+            IUFillTextVector(&tvp, &t, 1, DEVICE, "LARGE", "Large", "Main", IP_RO, 0, IPS_OK);
+            IDSetText(&tvp, nullptr);
+
+            int available = 0;
+            while (available == 0)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                ASSERT_EQ(ioctl(serverFd, FIONREAD, &available), 0);
+            }
+        }
+
+        // Reads until the message with the given text, returns the set*Vector and messages that came before
+        // as "name=value" and "message"
+        std::vector<std::string> readUntil(const std::string &last)
+        {
+            std::vector<std::string> received;
+            char buf[65536], msg[MAXRBUF];
+
+            while (true)
+            {
+                char control[CMSG_SPACE(16 * sizeof(int))];
+                struct iovec iov = { buf, sizeof(buf) };
+                struct msghdr msgh;
+                memset(&msgh, 0, sizeof(msgh));
+                msgh.msg_iov = &iov;
+                msgh.msg_iovlen = 1;
+                msgh.msg_control = control;
+                msgh.msg_controllen = sizeof(control);
+
+                ssize_t nr = recvmsg(serverFd, &msgh, 0);
+                for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msgh); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msgh, cmsg))
+                {
+                    int *fds = reinterpret_cast<int *>(CMSG_DATA(cmsg));
+                    for (size_t i = 0; CMSG_LEN((i + 1) * sizeof(int)) <= cmsg->cmsg_len; i++)
+                        attached.push_back(fds[i]);
+                }
+                if (nr <= 0)
+                {
+                    ADD_FAILURE() << "connection closed";
+                    return received;
+                }
+                for (ssize_t i = 0; i < nr; i++)
+                {
+                    XMLEle *root = readXMLEle(parser, buf[i], msg);
+                    if (root == nullptr)
+                        continue;
+                    std::string entry;
+                    if (!strcmp(tagXMLEle(root), "message"))
+                        entry = findXMLAttValu(root, "message");
+                    else if (!strncmp(tagXMLEle(root), "set", 3) && strcmp(findXMLAttValu(root, "name"), "LARGE"))
+                    {
+                        XMLEle *element = nextXMLEle(root, 1);
+                        entry = std::string(findXMLAttValu(root, "name")) + "=" + (element ? pcdataXMLEle(element) : "");
+                    }
+                    delXMLEle(root);
+                    if (entry == last)
+                        return received;
+                    if (!entry.empty())
+                        received.push_back(entry);
+                }
+            }
+        }
+
+        int driverFd, serverFd;
+        LilXML *parser;
+        // Descriptors of the BLOBs received
+        std::vector<int> attached;
+};
+
+static void setNumber(const char *name, double value, const char *message = nullptr)
+{
+    INumber n;
+    INumberVectorProperty nvp;
+    IUFillNumber(&n, "VALUE", "Value", "%g", 0, 100, 1, value);
+    IUFillNumberVector(&nvp, &n, 1, DEVICE, name, name, "Main", IP_RO, 0, IPS_OK);
+    if (message)
+        IDSetNumber(&nvp, "%s", message);
+    else
+        IDSetNumber(&nvp, nullptr);
+}
+
+static IDOutputQueueStats stats()
+{
+    IDOutputQueueStats s;
+    IDOutputQueueGetStats(&s);
+    return s;
+}
+
+// What the logger only sends when the driver exits still reaches indiserver, here the stderr gtest reads
+TEST(OutputQueueDeathTest, SendsLogFlushedAtExit)
+{
+    EXPECT_EXIT(
+    {
+        INDI::Logger::getInstance().configure("", INDI::Logger::file_off | INDI::Logger::screen_on,
+                                              INDI::Logger::defaultlevel, INDI::Logger::defaultlevel);
+        driverio_set_fd(STDERR_FILENO);
+        IDOutputQueueEnable(0);
+        // The copy is counted, and reported when the logger is flushed
+        DEBUGDEVICE(DEVICE, INDI::Logger::DBG_SESSION, "exiting");
+        DEBUGDEVICE(DEVICE, INDI::Logger::DBG_SESSION, "exiting");
+        exit(0);
+    }, ::testing::ExitedWithCode(0), "last message repeated 1 times");
+}
+
+TEST(OutputQueueTest, KeepsOrder)
+{
+    ServerConnection connection;
+    for (int i = 0; i < 100; i++)
+        setNumber(("NUMBER_" + std::to_string(i)).c_str(), i);
+    IDMessage(DEVICE, "end");
+
+    auto received = connection.readUntil("end");
+    ASSERT_EQ(received.size(), 100u);
+    for (int i = 0; i < 100; i++)
+        EXPECT_EQ(received[i], "NUMBER_" + std::to_string(i) + "=" + std::to_string(i));
+}
+
+TEST(OutputQueueTest, ReplacesQueuedValues)
+{
+    ServerConnection connection;
+    connection.stall();
+
+    auto before = stats();
+    setNumber("A", 1);
+    setNumber("B", 1);
+    IDMessage(DEVICE, "between");
+    setNumber("A", 2);
+    // An update with a message is never replaced, nor does it replace anything
+    setNumber("A", 2.5, "with a message");
+    setNumber("A", 3);
+    IDMessage(DEVICE, "end");
+
+    // The newest value comes after what was sent since the older ones
+    EXPECT_EQ(connection.readUntil("end"), std::vector<std::string>({"B=1", "between", "A=2.5", "A=3"}));
+    EXPECT_EQ(stats().coalesced - before.coalesced, 2u);
+}
+
+TEST(OutputQueueTest, SenderDoesNotWaitForReader)
+{
+    ServerConnection connection;
+    connection.stall();
+
+    // Much more than the queue holds, but replacing each other
+    auto before = stats();
+    for (int i = 0; i < 100000; i++)
+        setNumber("EXPOSURE", i);
+    IDMessage(DEVICE, "end");
+    EXPECT_EQ(stats().stallSeconds, before.stallSeconds);
+
+    EXPECT_EQ(connection.readUntil("end"), std::vector<std::string>({"EXPOSURE=99999"}));
+}
+
+TEST(OutputQueueTest, SenderWaitsWhenFull)
+{
+    ServerConnection connection;
+    connection.stall();
+
+    auto before = stats();
+    std::thread sender([]()
+    {
+        for (int i = 0; i < 2000; i++)
+            IDMessage(DEVICE, "message %d, none of them is replaced", i);
+        IDMessage(DEVICE, "end");
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    auto received = connection.readUntil("end");
+    sender.join();
+
+    ASSERT_EQ(received.size(), 2000u);
+    for (int i = 0; i < 2000; i++)
+        EXPECT_EQ(received[i], "message " + std::to_string(i) + ", none of them is replaced");
+    EXPECT_GT(stats().stallSeconds, before.stallSeconds);
+}
+
+TEST(OutputQueueTest, AttachesBlobs)
+{
+    ServerConnection connection;
+    connection.stall();
+
+    // Sent after the driver reused its buffer
+    std::vector<char> data(1000, 'a');
+    IBLOB b;
+    IBLOBVectorProperty bvp;
+    IUFillBLOB(&b, "IMAGE", "Image", ".fits");
+    IUFillBLOBVector(&bvp, &b, 1, DEVICE, "CCD1", "Image", "Main", IP_RO, 0, IPS_OK);
+    b.blob = data.data();
+    b.bloblen = b.size = data.size();
+    IDSetBLOB(&bvp, nullptr);
+    std::fill(data.begin(), data.end(), 'b');
+    IDSetBLOB(&bvp, nullptr);
+    IDMessage(DEVICE, "end");
+
+    // Both of them, the same BLOB twice is not replaced
+    EXPECT_EQ(connection.readUntil("end"), std::vector<std::string>({"CCD1=", "CCD1="}));
+    ASSERT_EQ(connection.attached.size(), 2u);
+    char first = 0, second = 0;
+    EXPECT_EQ(pread(connection.attached[0], &first, 1, 0), 1);
+    EXPECT_EQ(pread(connection.attached[1], &second, 1, 0), 1);
+    EXPECT_EQ(first, 'a');
+    EXPECT_EQ(second, 'b');
+}
@@ -0,0 +1,69 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+ .
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+ .
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include "indireceiver.h"
+
+class TestReceiver : public INDI::Receiver
+{
+    public:
+        TestReceiver()
+        {
+            setDeviceName(getDefaultName());
+        }
+
+        ~TestReceiver() override
+        {
+            stopAcquisition();
+        }
+
+        const char *getDefaultName() override
+        {
+            return "Test Receiver";
+        }
+};
+
+// The worker is waiting for frames while the driver switches between integrations and streaming
+TEST(CORE_SENSORINTERFACE, Test_resize_ring_while_worker_waits)
+{
+    TestReceiver receiver;
+    for (int round = 0; round < 200; round++)
+    {
+        receiver.setAcquisitionRing(64, round % 2 ? 4 : 2);
+        for (int i = 0; i < 8; i++)
+        {
+            uint8_t *frame = receiver.acquireFrame(1000);
+            ASSERT_NE(frame, nullptr) << "round " << round << ", frame " << i;
+            receiver.commitFrame(64, true);
+        }
+    }
+}
+
+TEST(CORE_SENSORINTERFACE, Test_buffer_not_allocated)
+{
+    TestReceiver receiver;
+    receiver.setBufferSize(4096);
+    ASSERT_NE(receiver.getBuffer(), nullptr);
+
+    // The driver fills ring frames or a buffer of its own, the old one would be too small
+    receiver.setBufferSize(1 << 20, false);
+    EXPECT_EQ(receiver.getBuffer(), nullptr);
+    EXPECT_FALSE(receiver.IntegrationComplete());
+
+    receiver.setBufferSize(1 << 20);
+    EXPECT_NE(receiver.getBuffer(), nullptr);
+}
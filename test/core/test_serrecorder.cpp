@@ -0,0 +1,147 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+ .
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+ .
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "stream/recorder/serrecorder.h"
+#include "stream/recorder/blockwriter.h"
+
+static std::string tempPath(const char *name)
+{
+    const char *dir = getenv("TMPDIR");
+    return std::string(dir ? dir : "/tmp") + "/" + name + "_" + std::to_string(getpid());
+}
+
+static std::vector<uint8_t> readFile(const std::string &path)
+{
+    std::ifstream in(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+static uint64_t getLE(const std::vector<uint8_t> &data, size_t offset, int size)
+{
+    uint64_t value = 0;
+    for (int i = size - 1; i >= 0; i--)
+        value = (value << 8) | data[offset + i];
+    return value;
+}
+
+static void recordAndCheck(uint16_t width, uint16_t height, uint32_t frames)
+{
+    std::string path = tempPath("test_serrecorder.ser");
+    size_t frameSize = size_t(width) * height * 2;
+
+    INDI::SER_Recorder recorder;
+    ASSERT_TRUE(recorder.setPixelFormat(INDI_MONO, 16));
+    ASSERT_TRUE(recorder.setSize(width, height));
+
+    char errmsg[1024];
+    ASSERT_TRUE(recorder.open(path.c_str(), errmsg)) << errmsg;
+
+    std::vector<uint8_t> frame(frameSize);
+    for (uint32_t i = 0; i < frames; i++)
+    {
+        for (size_t j = 0; j < frameSize; j++)
+            frame[j] = static_cast<uint8_t>(i * 7 + j);
+        ASSERT_TRUE(recorder.writeFrame(frame.data(), frameSize, 1000000 + i));
+    }
+    ASSERT_TRUE(recorder.close());
+
+    auto data = readFile(path);
+    unlink(path.c_str());
+
+    ASSERT_EQ(data.size(), SER_HEADER_SIZE + frames * (frameSize + 8));
+    EXPECT_EQ(std::string(reinterpret_cast<char *>(data.data()), 13), "INDI-RECORDER");
+    EXPECT_EQ(getLE(data, 26, 4), width);
+    EXPECT_EQ(getLE(data, 30, 4), height);
+    EXPECT_EQ(getLE(data, 34, 4), 16u);
+    EXPECT_EQ(getLE(data, 38, 4), frames);
+
+    for (uint32_t i = 0; i < frames; i += frames / 10 + 1)
+    {
+        size_t offset = SER_HEADER_SIZE + i * frameSize;
+        EXPECT_EQ(data[offset], static_cast<uint8_t>(i * 7));
+        EXPECT_EQ(data[offset + frameSize - 1], static_cast<uint8_t>(i * 7 + frameSize - 1));
+    }
+
+    // Timestamps in 100ns units, in frame order
+    size_t trailer = SER_HEADER_SIZE + size_t(frames) * frameSize;
+    for (uint32_t i = 0; i < frames; i++)
+        ASSERT_EQ(getLE(data, trailer + i * 8, 8), (1000000 + i) * 10ULL) << "frame " << i;
+}
+
+TEST(CORE_SERRECORDER, Test_frames_span_writer_blocks)
+{
+    // 1.2MB frames against 4MB blocks
+    recordAndCheck(800, 750, 20);
+}
+
+TEST(CORE_SERRECORDER, Test_timestamps_spill_in_order)
+{
+    // More frames than timestamps kept in memory
+    recordAndCheck(2, 2, 70000);
+}
+
+TEST(CORE_SERRECORDER, Test_empty_recording)
+{
+    recordAndCheck(10, 10, 0);
+}
+
+TEST(CORE_BLOCKWRITER, Test_small_blocks_and_header)
+{
+    std::string path = tempPath("test_blockwriter.bin");
+
+    INDI::BlockWriter writer;
+    writer.setBuffer(4096, 2);
+    std::string error;
+    ASSERT_TRUE(writer.open(path.c_str(), error)) << error;
+
+    std::string expected;
+    for (int i = 0; i < 5000; i++)
+    {
+        std::string chunk = std::to_string(i) + ",";
+        expected += chunk;
+        ASSERT_TRUE(writer.write(chunk.data(), chunk.size()));
+    }
+    EXPECT_EQ(writer.size(), expected.size());
+
+    expected.replace(0, 4, "HEAD");
+    ASSERT_TRUE(writer.close("HEAD", 4)) << writer.error();
+    EXPECT_FALSE(writer.isOpen());
+
+    auto data = readFile(path);
+    unlink(path.c_str());
+    EXPECT_EQ(std::string(data.begin(), data.end()), expected);
+    EXPECT_EQ(writer.statistics().bytes, expected.size());
+}
+
+TEST(CORE_BLOCKWRITER, Test_open_failure)
+{
+    INDI::BlockWriter writer;
+    std::string error;
+    EXPECT_FALSE(writer.open("/nonexistent/dir/file.ser", error));
+    EXPECT_FALSE(error.empty());
+    EXPECT_FALSE(writer.close());
+}
@@ -0,0 +1,245 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+ .
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+ .
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "defaultdevice.h"
+#include "indidriver.h"
+#include "lilxml.h"
+
+// Records what reaches ISSnoopDevice()
+class SnoopingDevice : public INDI::DefaultDevice
+{
+    public:
+        explicit SnoopingDevice(const char *name)
+        {
+            setDeviceName(name);
+        }
+
+        const char *getDefaultName() override
+        {
+            return "Snooping Device";
+        }
+
+        bool ISSnoopDevice(XMLEle *root) override
+        {
+            snooped.push_back(std::string(findXMLAttValu(root, "device")) + "." + findXMLAttValu(root, "name"));
+            return INDI::DefaultDevice::ISSnoopDevice(root);
+        }
+
+        std::vector<std::string> snooped;
+};
+
+// Parses a message as if indiserver had sent it, and dispatches it
+static void receive(const std::string &xml)
+{
+    char msg[MAXRBUF];
+    std::unique_ptr<LilXML, void (*)(LilXML *)> parser(newLilXML(), delLilXML);
+    XMLEle **nodes = parseXMLChunk(parser.get(), const_cast<char *>(xml.c_str()), xml.size(), msg);
+    ASSERT_NE(nodes, nullptr) << msg;
+    for (int i = 0; nodes[i] != nullptr; i++)
+    {
+        EXPECT_EQ(dispatch(nodes[i], msg), 0) << msg;
+        delXMLEle(nodes[i]);
+    }
+    free(nodes);
+}
+
+static std::string setNumber(const char *device, const char *name)
+{
+    return std::string("<setNumberVector device='") + device + "' name='" + name + "' state='Ok'>"
+           "<oneNumber name='VALUE'>1</oneNumber></setNumberVector>";
+}
+
+static void countHandler(XMLEle *, void *context)
+{
+    ++*static_cast<int *>(context);
+}
+
+TEST(SnoopTest, HandlerGetsOnlyItsProperty)
+{
+    SnoopingDevice device("Snoop Test 1");
+    int count = 0;
+    IDSnoopProperty("Mount 1", "EQUATORIAL_EOD_COORD", countHandler, &count);
+    IDSnoopDevice("Mount 1", "TELESCOPE_INFO");
+
+    receive(setNumber("Mount 1", "EQUATORIAL_EOD_COORD"));
+    receive(setNumber("Mount 1", "TELESCOPE_INFO"));
+    receive(setNumber("Mount 1", "EQUATORIAL_EOD_COORD"));
+
+    EXPECT_EQ(count, 2);
+    // A driver overriding ISSnoopDevice() still sees all of them
+    EXPECT_EQ(device.snooped, std::vector<std::string>({"Mount 1.EQUATORIAL_EOD_COORD", "Mount 1.TELESCOPE_INFO",
+                                                        "Mount 1.EQUATORIAL_EOD_COORD"}));
+
+    IDUnsnoopProperty("Mount 1", "EQUATORIAL_EOD_COORD", countHandler, &count);
+}
+
+TEST(SnoopTest, HandlerBeforeISSnoopDevice)
+{
+    SnoopingDevice device("Snoop Test 2");
+    std::vector<std::string> seen;
+    // As a base class does, the driver deriving from it did not snoop the property itself
+    device.snoopProperty("Mount 2", "EQUATORIAL_EOD_COORD", [&](XMLEle *)
+    {
+        seen.push_back("handler, " + std::to_string(device.snooped.size()) + " in ISSnoopDevice()");
+    });
+
+    receive(setNumber("Mount 2", "EQUATORIAL_EOD_COORD"));
+
+    EXPECT_EQ(seen, std::vector<std::string>({"handler, 0 in ISSnoopDevice()"}));
+    EXPECT_EQ(device.snooped, std::vector<std::string>({"Mount 2.EQUATORIAL_EOD_COORD"}));
+}
+
+TEST(SnoopTest, WholeDeviceHandler)
+{
+    SnoopingDevice device("Snoop Test 3");
+    int count = 0;
+    IDSnoopProperty("Mount 3", nullptr, countHandler, &count);
+
+    receive(setNumber("Mount 3", "EQUATORIAL_EOD_COORD"));
+    receive("<message device='Mount 3' timestamp='2024-01-01T00:00:00' message='Slewing'/>");
+    receive("<delProperty device='Mount 3' name='TELESCOPE_INFO'/>");
+    receive(setNumber("Mount 4", "EQUATORIAL_EOD_COORD"));
+
+    EXPECT_EQ(count, 3);
+    EXPECT_EQ(device.snooped.size(), 4u);
+
+    IDUnsnoopProperty("Mount 3", nullptr, countHandler, &count);
+}
+
+TEST(SnoopTest, Unsnoop)
+{
+    SnoopingDevice device("Snoop Test 4");
+    int count = 0;
+    IDSnoopProperty("Mount 5", "EQUATORIAL_EOD_COORD", countHandler, &count);
+    // Registering twice does not call it twice
+    IDSnoopProperty("Mount 5", "EQUATORIAL_EOD_COORD", countHandler, &count);
+
+    receive(setNumber("Mount 5", "EQUATORIAL_EOD_COORD"));
+    IDUnsnoopProperty("Mount 5", "EQUATORIAL_EOD_COORD", countHandler, &count);
+    receive(setNumber("Mount 5", "EQUATORIAL_EOD_COORD"));
+
+    EXPECT_EQ(count, 1);
+    EXPECT_EQ(device.snooped, std::vector<std::string>({"Mount 5.EQUATORIAL_EOD_COORD", "Mount 5.EQUATORIAL_EOD_COORD"}));
+}
+
+TEST(SnoopTest, DefaultDeviceSnoopProperty)
+{
+    auto device = std::make_unique<SnoopingDevice>("Snoop Test 5");
+    std::vector<std::string> values;
+    device->snoopProperty("Mount 6", "EQUATORIAL_EOD_COORD", [&values](XMLEle * root)
+    {
+        values.push_back(std::string("first ") + pcdataXMLEle(nextXMLEle(root, 1)));
+    });
+    // Replaces the first handler
+    device->snoopProperty("Mount 6", "EQUATORIAL_EOD_COORD", [&values](XMLEle * root)
+    {
+        values.push_back(std::string("second ") + pcdataXMLEle(nextXMLEle(root, 1)));
+    });
+
+    receive(setNumber("Mount 6", "EQUATORIAL_EOD_COORD"));
+    EXPECT_EQ(values, std::vector<std::string>({"second 1"}));
+    EXPECT_EQ(device->snooped, std::vector<std::string>({"Mount 6.EQUATORIAL_EOD_COORD"}));
+
+    // Nothing is left registered once the device is gone
+    device.reset();
+    receive(setNumber("Mount 6", "EQUATORIAL_EOD_COORD"));
+    EXPECT_EQ(values.size(), 1u);
+}
+
+static void unsnoopSelfHandler(XMLEle *, void *context)
+{
+    ++*static_cast<int *>(context);
+    IDUnsnoopProperty("Mount 7", "EQUATORIAL_EOD_COORD", unsnoopSelfHandler, context);
+    // Registering another one meanwhile reuses no slot still in use
+    IDSnoopProperty("Mount 7", "TELESCOPE_INFO", countHandler, context);
+}
+
+TEST(SnoopTest, HandlerUnsnoopsItself)
+{
+    SnoopingDevice device("Snoop Test 7");
+    int count = 0, other = 0;
+    IDSnoopProperty("Mount 7", "EQUATORIAL_EOD_COORD", unsnoopSelfHandler, &count);
+    IDSnoopProperty("Mount 7", "EQUATORIAL_EOD_COORD", countHandler, &other);
+
+    receive(setNumber("Mount 7", "EQUATORIAL_EOD_COORD"));
+    receive(setNumber("Mount 7", "EQUATORIAL_EOD_COORD"));
+    receive(setNumber("Mount 7", "TELESCOPE_INFO"));
+
+    EXPECT_EQ(count, 2);
+    EXPECT_EQ(other, 2);
+
+    // Once every handler is gone its messages only go to ISSnoopDevice()
+    IDUnsnoopProperty("Mount 7", "EQUATORIAL_EOD_COORD", countHandler, &other);
+    IDUnsnoopProperty("Mount 7", "TELESCOPE_INFO", countHandler, &count);
+    receive(setNumber("Mount 7", "EQUATORIAL_EOD_COORD"));
+    receive(setNumber("Mount 7", "TELESCOPE_INFO"));
+    EXPECT_EQ(count, 2);
+    EXPECT_EQ(other, 2);
+    EXPECT_EQ(device.snooped.size(), 5u);
+}
+
+TEST(SnoopTest, DefaultDeviceHandlerReplacesItself)
+{
+    SnoopingDevice device("Snoop Test 8");
+    std::vector<std::string> values;
+    std::string first = "first";
+    device.snoopProperty("Mount 8", "EQUATORIAL_EOD_COORD", [&device, &values, first](XMLEle *)
+    {
+        device.snoopProperty("Mount 8", "EQUATORIAL_EOD_COORD", [&device, &values](XMLEle *)
+        {
+            values.push_back("second");
+            device.unsnoopProperty("Mount 8", "EQUATORIAL_EOD_COORD");
+            values.push_back("after unsnoop");
+        });
+        // Its captures are still there after being replaced
+        values.push_back(first);
+    });
+
+    receive(setNumber("Mount 8", "EQUATORIAL_EOD_COORD"));
+    receive(setNumber("Mount 8", "EQUATORIAL_EOD_COORD"));
+    receive(setNumber("Mount 8", "EQUATORIAL_EOD_COORD"));
+
+    EXPECT_EQ(values, std::vector<std::string>({"first", "second", "after unsnoop"}));
+    EXPECT_EQ(device.snooped.size(), 3u);
+}
+
+// Many snooped properties, the index finds each one
+TEST(SnoopTest, ManyProperties)
+{
+    SnoopingDevice device("Snoop Test 6");
+    std::vector<int> counts(200, 0);
+    for (int i = 0; i < 200; i++)
+        IDSnoopProperty(("Device " + std::to_string(i % 10)).c_str(), ("PROPERTY_" + std::to_string(i)).c_str(),
+                        countHandler, &counts[i]);
+
+    for (int i = 0; i < 200; i++)
+        receive(setNumber(("Device " + std::to_string(i % 10)).c_str(), ("PROPERTY_" + std::to_string(i)).c_str()));
+
+    for (int i = 0; i < 200; i++)
+    {
+        EXPECT_EQ(counts[i], 1) << i;
+        IDUnsnoopProperty(("Device " + std::to_string(i % 10)).c_str(), ("PROPERTY_" + std::to_string(i)).c_str(),
+                          countHandler, &counts[i]);
+    }
+    EXPECT_EQ(device.snooped.size(), 200u);
+}
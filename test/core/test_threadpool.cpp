@@ -0,0 +1,389 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+ .
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+ .
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "indithreadpool.h"
+
+using INDI::ThreadPool;
+using INDI::TaskGroup;
+
+// Keeps threads of a pool busy until opened
+class Gate
+{
+    public:
+        void wait()
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            waiting++;
+            changed.notify_all();
+            changed.wait(guard, [this] { return isOpen; });
+        }
+
+        void waitFor(int count)
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            changed.wait(guard, [this, count] { return waiting >= count; });
+        }
+
+        void open()
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            isOpen = true;
+            changed.notify_all();
+        }
+
+    private:
+        std::mutex lock;
+        std::condition_variable changed;
+        int waiting {0};
+        bool isOpen {false};
+};
+
+TEST(ThreadPoolTest, RunsEveryFunction)
+{
+    ThreadPool pool(4, 256);
+    std::atomic<int> count {0};
+
+    // More functions than the pool holds, from several threads
+    std::vector<std::thread> producers;
+    for (int i = 0; i < 4; i++)
+        producers.emplace_back([&pool, &count]()
+        {
+            for (int j = 0; j < 25000; j++)
+                EXPECT_TRUE(pool.start([&count](const std::atomic_bool &)
+                {
+                    count++;
+                }));
+        });
+    for (auto &producer : producers)
+        producer.join();
+
+    while (pool.stats().completed < 100000)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    auto stats = pool.stats();
+    EXPECT_EQ(count, 100000);
+    EXPECT_EQ(stats.threads, 4u);
+    EXPECT_EQ(stats.canceled, 0u);
+    EXPECT_LE(stats.queuedPeak, 256u);
+    EXPECT_EQ(stats.queued[ThreadPool::PRIORITY_NORMAL], 0u);
+}
+
+TEST(ThreadPoolTest, HigherPriorityFirst)
+{
+    ThreadPool pool(1);
+    Gate gate;
+    pool.start([&gate](const std::atomic_bool &)
+    {
+        gate.wait();
+    });
+    gate.waitFor(1);
+
+    std::mutex lock;
+    std::vector<int> order;
+    auto record = [&lock, &order](int value)
+    {
+        return [&lock, &order, value](const std::atomic_bool &)
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            order.push_back(value);
+        };
+    };
+    pool.start(record(3), ThreadPool::PRIORITY_LOW);
+    pool.start(record(2), ThreadPool::PRIORITY_NORMAL);
+    pool.start(record(1), ThreadPool::PRIORITY_HIGH);
+    pool.start(record(4), ThreadPool::PRIORITY_LOW);
+
+    auto stats = pool.stats();
+    EXPECT_EQ(stats.queued[ThreadPool::PRIORITY_HIGH], 1u);
+    EXPECT_EQ(stats.queued[ThreadPool::PRIORITY_NORMAL], 1u);
+    EXPECT_EQ(stats.queued[ThreadPool::PRIORITY_LOW], 2u);
+    EXPECT_EQ(stats.running, 1u);
+
+    TaskGroup group(pool);
+    gate.open();
+    group.start([](const std::atomic_bool &) {}, ThreadPool::PRIORITY_LOW);
+    group.wait();
+    EXPECT_EQ(order, std::vector<int>({1, 2, 3, 4}));
+}
+
+TEST(ThreadPoolTest, BoundedQueue)
+{
+    ThreadPool pool(1, 4);
+    Gate gate;
+    pool.start([&gate](const std::atomic_bool &)
+    {
+        gate.wait();
+    });
+    gate.waitFor(1);
+
+    std::atomic<int> count {0};
+    auto function = [&count](const std::atomic_bool &)
+    {
+        count++;
+    };
+    for (int i = 0; i < 4; i++)
+        EXPECT_TRUE(pool.tryStart(function));
+    EXPECT_FALSE(pool.tryStart(function));
+
+    // Waits for the thread to take one
+    std::thread producer([&pool, &function]()
+    {
+        EXPECT_TRUE(pool.start(function));
+    });
+    while (pool.stats().waited == 0)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    gate.open();
+    producer.join();
+
+    TaskGroup group(pool);
+    group.start([](const std::atomic_bool &) {});
+    group.wait();
+    EXPECT_EQ(count, 5);
+    EXPECT_EQ(pool.stats().queuedPeak, 4u);
+}
+
+TEST(ThreadPoolTest, FullPoolRunsFunctionsOfItsThreadsRightAway)
+{
+    ThreadPool pool(1, 1);
+    TaskGroup group(pool);
+    std::atomic<int> count {0};
+
+    group.start([&group, &count](const std::atomic_bool &)
+    {
+        for (int i = 0; i < 10; i++)
+            group.start([&count](const std::atomic_bool &)
+            {
+                count++;
+            });
+    });
+    group.wait();
+    EXPECT_EQ(count, 10);
+}
+
+TEST(ThreadPoolTest, IdleThreadsTakeQueuedFunctions)
+{
+    ThreadPool pool(2);
+    TaskGroup group(pool);
+    std::atomic<int> count {0};
+
+    // Queued on the thread running this function, which waits for them
+    group.start([&](const std::atomic_bool &)
+    {
+        for (int i = 0; i < 4; i++)
+            group.start([&count](const std::atomic_bool &)
+            {
+                count++;
+            });
+        while (count < 4)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    });
+    group.wait();
+
+    EXPECT_EQ(count, 4);
+    // The four the waiting thread queued, and the first one too when the other thread happened to take it
+    EXPECT_GE(pool.stats().stolen, 4u);
+    EXPECT_LE(pool.stats().stolen, 5u);
+}
+
+TEST(ThreadPoolTest, QuitCancelsGroup)
+{
+    ThreadPool pool(1);
+    TaskGroup other(pool);
+    std::atomic<bool> closed {false};
+    std::atomic<int> count {0};
+
+    {
+        TaskGroup group(pool);
+        Gate gate;
+        group.start([&](const std::atomic_bool & isAboutToClose)
+        {
+            gate.wait();
+            while (!isAboutToClose)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            closed = true;
+        });
+        gate.waitFor(1);
+        for (int i = 0; i < 10; i++)
+            group.start([&count](const std::atomic_bool &)
+            {
+                count++;
+            });
+        other.start([&count](const std::atomic_bool &)
+        {
+            count += 100;
+        });
+        EXPECT_EQ(group.pending(), 11u);
+
+        gate.open();
+        group.quit();
+        EXPECT_TRUE(closed);
+        EXPECT_EQ(group.pending(), 0u);
+        EXPECT_EQ(pool.stats().canceled, 10u);
+
+        // Usable again
+        group.start([&count](const std::atomic_bool &)
+        {
+            count += 1000;
+        });
+        group.wait();
+    }
+
+    other.wait();
+    EXPECT_EQ(count, 1100);
+}
+
+TEST(ThreadPoolTest, StartLatestReplacesWaitingFunction)
+{
+    ThreadPool pool(1);
+    TaskGroup group(pool);
+    Gate gate;
+    pool.start([&gate](const std::atomic_bool &)
+    {
+        gate.wait();
+    });
+    gate.waitFor(1);
+
+    std::vector<int> values;
+    for (int i = 0; i < 100; i++)
+        group.startLatest([&values, i](const std::atomic_bool &)
+        {
+            values.push_back(i);
+        });
+    EXPECT_EQ(group.pending(), 1u);
+
+    gate.open();
+    group.wait();
+    EXPECT_EQ(values, std::vector<int>({99}));
+
+    group.startLatest([&values](const std::atomic_bool &)
+    {
+        values.push_back(100);
+    });
+    group.wait();
+    EXPECT_EQ(values, std::vector<int>({99, 100}));
+}
+
+TEST(ThreadPoolTest, QuitPool)
+{
+    std::atomic<bool> closed {false};
+    ThreadPool pool(2);
+    TaskGroup group(pool);
+    Gate gate;
+
+    group.start([&](const std::atomic_bool & isAboutToClose)
+    {
+        gate.wait();
+        while (!isAboutToClose)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        closed = true;
+    });
+    gate.waitFor(1);
+    gate.open();
+
+    pool.quit();
+    EXPECT_TRUE(closed);
+    EXPECT_FALSE(pool.start([](const std::atomic_bool &) {}));
+    EXPECT_FALSE(group.start([](const std::atomic_bool &) {}));
+    EXPECT_EQ(group.pending(), 0u);
+}
+
+// A driver exits while a function of the shared pool waits for a lock it holds, as driverio_abort() does
+TEST(ThreadPoolDeathTest, ExitWhileSharedPoolFunctionWaits)
+{
+    EXPECT_EXIT(
+    {
+        std::mutex lock;
+        Gate gate;
+        std::unique_lock<std::mutex> guard(lock);
+        ThreadPool::instance().start([&](const std::atomic_bool &)
+        {
+            gate.wait();
+            std::lock_guard<std::mutex> waiting(lock);
+        });
+        gate.waitFor(1);
+        gate.open();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        exit(1);
+    }, ::testing::ExitedWithCode(1), "");
+}
+
+// Groups of objects that come and go while others queue functions from several threads
+TEST(ThreadPoolTest, Stress)
+{
+    ThreadPool pool(4, 64);
+    std::atomic<uint64_t> started {0}, ran {0};
+
+    std::vector<std::thread> producers;
+    for (int i = 0; i < 4; i++)
+        producers.emplace_back([&pool, &started, &ran, i]()
+        {
+            std::mt19937 random(i);
+            for (int round = 0; round < 200; round++)
+            {
+                TaskGroup group(pool);
+                int count = random() % 50;
+                for (int j = 0; j < count; j++)
+                {
+                    auto priority = static_cast<ThreadPool::Priority>(random() % ThreadPool::PRIORITY_COUNT);
+                    int work = random() % 1000;
+                    auto function = [&ran, work](const std::atomic_bool & isAboutToClose)
+                    {
+                        volatile int sum = 0;
+                        for (int k = 0; k < work && !isAboutToClose; k++)
+                            sum += k;
+                        ran++;
+                    };
+                    bool queued = false;
+                    switch (random() % 3)
+                    {
+                        case 0:
+                            queued = group.start(function, priority);
+                            break;
+                        case 1:
+                            queued = group.tryStart(function, priority);
+                            break;
+                        default:
+                            queued = group.startLatest(function, priority);
+                            break;
+                    }
+                    if (queued)
+                        started++;
+                }
+                if (random() % 2)
+                    group.wait();
+                // The others quit with the group
+            }
+        });
+    for (auto &producer : producers)
+        producer.join();
+
+    auto stats = pool.stats();
+    EXPECT_EQ(stats.running, 0u);
+    EXPECT_EQ(stats.queued[0] + stats.queued[1] + stats.queued[2], 0u);
+    EXPECT_EQ(stats.completed, ran);
+    EXPECT_EQ(stats.completed + stats.canceled, started);
+    EXPECT_LE(stats.queuedPeak, 64u);
+}
@@ -0,0 +1,139 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+ .
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+ .
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "indiwsqueue.h"
+
+static std::shared_ptr<const INDIWSQueue::Frame> frame(const std::string &payload, bool stream)
+{
+    return INDIWSQueue::makeFrame(stream ? ".stream" : ".fits", payload.data(), payload.size(), stream);
+}
+
+// Payloads of the queued frames, oldest first
+static std::string contents(INDIWSQueue queue)
+{
+    std::string result;
+    while (!queue.empty())
+    {
+        auto messages = queue.messages();
+        result += std::string(messages.back().data, messages.back().size);
+        queue.pop();
+    }
+    return result;
+}
+
+TEST(CORE_WSQUEUE, Test_frame_header)
+{
+    auto f = INDIWSQueue::makeFrame(".stream_jpg", "abc", 3, true);
+    ASSERT_EQ(f->message.size(), INDIWSQueue::FRAME_HEADER_SIZE + 3);
+
+    EXPECT_EQ(std::string(f->message.data()), ".stream_jpg");
+    for (size_t i = 11; i < INDIWSQueue::FRAME_FORMAT_SIZE; i++)
+        EXPECT_EQ(f->message[i], '\0');
+    // Size as a 64 bits little endian integer
+    EXPECT_EQ(f->message[INDIWSQueue::FRAME_FORMAT_SIZE], 3);
+    for (size_t i = INDIWSQueue::FRAME_FORMAT_SIZE + 1; i < INDIWSQueue::FRAME_HEADER_SIZE; i++)
+        EXPECT_EQ(f->message[i], '\0');
+    EXPECT_EQ(std::string(f->payload(), f->payloadSize()), "abc");
+}
+
+TEST(CORE_WSQUEUE, Test_framed_messages)
+{
+    INDIWSQueue queue(true);
+    queue.push(frame("abc", false));
+
+    auto messages = queue.messages();
+    ASSERT_EQ(messages.size(), 1u);
+    EXPECT_FALSE(messages[0].text);
+    EXPECT_EQ(messages[0].size, INDIWSQueue::FRAME_HEADER_SIZE + 3);
+    EXPECT_EQ(std::string(messages[0].data), ".fits");
+}
+
+TEST(CORE_WSQUEUE, Test_legacy_messages_carry_the_format_of_every_frame)
+{
+    INDIWSQueue queue(false);
+    queue.push(frame("a", false));
+    queue.push(frame("b", false));
+
+    for (auto payload : { "a", "b" })
+    {
+        auto messages = queue.messages();
+        ASSERT_EQ(messages.size(), 2u);
+        EXPECT_TRUE(messages[0].text);
+        EXPECT_EQ(std::string(messages[0].data, messages[0].size), ".fits");
+        EXPECT_FALSE(messages[1].text);
+        EXPECT_EQ(std::string(messages[1].data, messages[1].size), payload);
+        queue.pop();
+    }
+    EXPECT_TRUE(queue.messages().empty());
+}
+
+TEST(CORE_WSQUEUE, Test_full_queue_drops_oldest_stream_frame)
+{
+    INDIWSQueue queue(false, 3);
+    queue.push(frame("I", false));
+    queue.push(frame("1", true));
+    queue.push(frame("2", true));
+    queue.push(frame("3", true));
+
+    EXPECT_EQ(queue.size(), 3u);
+    EXPECT_EQ(queue.dropped(), 1u);
+    EXPECT_EQ(contents(queue), "I23");
+
+    // A captured image also takes the place of a stream frame
+    queue.push(frame("J", false));
+    EXPECT_EQ(contents(queue), "I3J");
+    EXPECT_EQ(queue.dropped(), 2u);
+}
+
+TEST(CORE_WSQUEUE, Test_stream_frame_never_replaces_an_image)
+{
+    INDIWSQueue queue(false, 2);
+    queue.push(frame("I", false));
+    queue.push(frame("J", false));
+    queue.push(frame("1", true));
+
+    EXPECT_EQ(contents(queue), "IJ");
+    EXPECT_EQ(queue.dropped(), 1u);
+
+    // Only images queued, the oldest one goes
+    queue.push(frame("K", false));
+    EXPECT_EQ(contents(queue), "JK");
+    EXPECT_EQ(queue.dropped(), 2u);
+}
+
+TEST(CORE_WSQUEUE, Test_statistics)
+{
+    INDIWSQueue queue(true, 1);
+    queue.setLimit(0);
+    EXPECT_EQ(queue.limit(), 1u);
+
+    queue.push(frame("abcd", true));
+    queue.pop();
+    queue.push(frame("ef", true));
+    queue.push(frame("gh", true));
+    queue.pop();
+    // Nothing left to forget
+    queue.pop();
+
+    EXPECT_EQ(queue.frames(), 2u);
+    EXPECT_EQ(queue.bytes(), 6u);
+    EXPECT_EQ(queue.dropped(), 1u);
+    EXPECT_TRUE(queue.empty());
+}
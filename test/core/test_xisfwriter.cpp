@@ -0,0 +1,199 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+ .
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+ .
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#ifdef HAVE_XISF
+#include <libxisf.h>
+#endif
+
+#include "xisfwriter.h"
+#include "sharedblob.h"
+
+using INDI::FITSRecord;
+using INDI::XISFWriter;
+
+static std::string tempPath(const char *name)
+{
+    const char *dir = getenv("TMPDIR");
+    return std::string(dir ? dir : "/tmp") + "/" + name + "_" + std::to_string(getpid());
+}
+
+static std::vector<uint8_t> testPattern(size_t size)
+{
+    std::vector<uint8_t> pixels(size);
+    for (size_t i = 0; i < size; i++)
+        pixels[i] = static_cast<uint8_t>((i * 7) ^ (i >> 9));
+    return pixels;
+}
+
+static std::string attribute(const std::string &xml, const std::string &name)
+{
+    size_t start = xml.find(" " + name + "=\"");
+    if (start == std::string::npos)
+        return "";
+    start += name.size() + 3;
+    return xml.substr(start, xml.find('"', start) - start);
+}
+
+static std::vector<uint64_t> numbers(const std::string &text)
+{
+    std::vector<uint64_t> result;
+    const char *p = text.c_str();
+    while (*p)
+    {
+        if (isdigit(static_cast<unsigned char>(*p)))
+        {
+            char *end;
+            result.push_back(strtoull(p, &end, 10));
+            p = end;
+        }
+        else
+            p++;
+    }
+    return result;
+}
+
+// Decode what the writer produced the way an XISF reader does
+static std::vector<uint8_t> decode(const std::vector<uint8_t> &file, std::string &xml)
+{
+    EXPECT_EQ(memcmp(file.data(), "XISF0100", 8), 0);
+    uint32_t length = file[8] | (file[9] << 8) | (file[10] << 16) | (uint32_t(file[11]) << 24);
+    xml.assign(reinterpret_cast<const char *>(file.data()) + 16, length);
+
+    auto location = numbers(attribute(xml, "location"));
+    EXPECT_EQ(location.size(), 2u);
+    EXPECT_EQ(location[0] + location[1], file.size());
+    std::vector<uint8_t> data(file.begin() + location[0], file.begin() + location[0] + location[1]);
+
+    std::string compression = attribute(xml, "compression");
+    if (compression.empty())
+        return data;
+
+    auto codec = numbers(compression);
+    auto subblocks = numbers(attribute(xml, "subblocks"));
+    std::vector<uint8_t> inflated(codec[0]);
+    size_t in = 0, out = 0;
+    for (size_t i = 0; i + 1 < subblocks.size(); i += 2)
+    {
+        uLongf len = subblocks[i + 1];
+        EXPECT_EQ(uncompress(inflated.data() + out, &len, data.data() + in, subblocks[i]), Z_OK);
+        EXPECT_EQ(len, subblocks[i + 1]);
+        in += subblocks[i];
+        out += len;
+    }
+    EXPECT_EQ(in, data.size());
+    EXPECT_EQ(out, inflated.size());
+
+    if (compression.compare(0, 7, "zlib+sh") != 0)
+        return inflated;
+
+    size_t itemSize = codec[1];
+    size_t items = inflated.size() / itemSize;
+    std::vector<uint8_t> unshuffled(inflated.size());
+    for (size_t i = 0; i < items; i++)
+        for (size_t j = 0; j < itemSize; j++)
+            unshuffled[i * itemSize + j] = inflated[j * items + i];
+    return unshuffled;
+}
+
+static void roundTrip(int bpp, int naxis, bool compress)
+{
+    long naxes[3] = { 301, 97, 3 };
+    auto pixels = testPattern(naxes[0] * naxes[1] * (naxis == 3 ? 3 : 1) * (bpp / 8));
+
+    XISFWriter writer(bpp, naxis, naxes);
+    writer.setRecords({ FITSRecord("EXPTIME", 1.5, 6, "Total Exposure Time (s)"), FITSRecord("OBJECT", "M 31 <core>", "Object name") });
+    writer.setImageType("Dark");
+    writer.setColorFilterArray("RGGB", 2, 2);
+    // Small subblocks so the frame spans several of them and the last one is short
+    writer.setCompression(compress, 5000);
+
+    void *blob = nullptr;
+    size_t size = 0;
+    std::string error;
+    ASSERT_TRUE(writer.writeToBlob(pixels.data(), blob, size, error)) << error;
+    std::vector<uint8_t> file(static_cast<uint8_t *>(blob), static_cast<uint8_t *>(blob) + size);
+    IDSharedBlobFree(blob);
+
+    std::string xml;
+    EXPECT_EQ(decode(file, xml), pixels);
+    EXPECT_EQ(attribute(xml, "geometry"), "301:97:" + std::string(naxis == 3 ? "3" : "1"));
+    EXPECT_EQ(attribute(xml, "sampleFormat"), "UInt" + std::to_string(bpp));
+    EXPECT_EQ(attribute(xml, "colorSpace"), naxis == 3 ? "RGB" : "Gray");
+    EXPECT_EQ(attribute(xml, "imageType"), "Dark");
+    EXPECT_NE(xml.find("<FITSKeyword name=\"OBJECT\" value=\"M 31 &lt;core&gt;\" comment=\"Object name\"/>"), std::string::npos);
+    EXPECT_NE(xml.find("<ColorFilterArray pattern=\"RGGB\" width=\"2\" height=\"2\"/>"), std::string::npos);
+
+    // The same file through a file descriptor
+    std::string path = tempPath("test_xisfwriter");
+    int fd = open(path.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0644);
+    ASSERT_GE(fd, 0);
+    ASSERT_TRUE(writer.writeToFile(fd, pixels.data(), error)) << error;
+    close(fd);
+    std::ifstream in(path, std::ios::binary);
+    std::vector<uint8_t> written((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    unlink(path.c_str());
+    EXPECT_EQ(written, file);
+
+#ifdef HAVE_XISF
+    LibXISF::XISFReader reader;
+    reader.open(LibXISF::ByteArray(reinterpret_cast<const char *>(file.data()), file.size()));
+    ASSERT_EQ(reader.imagesCount(), 1);
+    const LibXISF::Image &image = reader.getImage(0);
+    ASSERT_EQ(image.imageDataSize(), pixels.size());
+    EXPECT_EQ(memcmp(image.imageData(), pixels.data(), pixels.size()), 0);
+#endif
+}
+
+TEST(XISFWriterTest, Uncompressed)
+{
+    roundTrip(8, 2, false);
+    roundTrip(16, 2, false);
+    roundTrip(32, 2, false);
+    roundTrip(16, 3, false);
+}
+
+TEST(XISFWriterTest, Compressed)
+{
+    roundTrip(8, 2, true);
+    roundTrip(16, 2, true);
+    roundTrip(32, 2, true);
+    roundTrip(16, 3, true);
+}
+
+TEST(XISFWriterTest, UnsupportedFormat)
+{
+    long naxes[2] = { 16, 16 };
+    std::vector<uint8_t> pixels(16 * 16 * 8);
+    XISFWriter writer(64, 2, naxes);
+    void *blob = nullptr;
+    size_t size = 0;
+    std::string error;
+    EXPECT_FALSE(writer.writeToBlob(pixels.data(), blob, size, error));
+    EXPECT_FALSE(error.empty());
+}
@@ -194,6 +194,43 @@ class MockCCDSimDriver: public CCDSim
             std::cout << "[          ] DrawStarImage - randomized no-noise no-skyglow benchmark: " << duration << "ns per call" <<
                       std::endl;
         }
+
+        void testSteppedExposure()
+        {
+            // A small frame, it is sent when the exposure completes
+            auto p = getNumber("SIMULATOR_SETTINGS");
+            ASSERT_NE(p, nullptr);
+            p.findWidgetByName("SIM_XRES")->setValue(64);
+            p.findWidgetByName("SIM_YRES")->setValue(64);
+            ASSERT_TRUE(setupParameters());
+
+            // Time only moves when the test advances the clock
+            IESetClock(IE_CLOCK_STEPPED, 1);
+            ASSERT_TRUE(Connect());
+            setConnected(true);
+
+            auto const before = std::chrono::steady_clock::now();
+            ASSERT_TRUE(StartExposure(600));
+            ASSERT_TRUE(InExposure);
+
+            // The polling timer fires every second of the clock, the last one at 598s
+            IEAdvanceClock(598500);
+            EXPECT_TRUE(InExposure);
+            EXPECT_NEAR(PrimaryCCD.getExposureLeft(), 2, 0.01);
+
+            IEAdvanceClock(2000);
+            EXPECT_FALSE(InExposure);
+            EXPECT_EQ(PrimaryCCD.getExposureLeft(), 0);
+
+            // Ten minutes of exposure took no real time
+            auto const after = std::chrono::steady_clock::now();
+            EXPECT_LT(std::chrono::duration_cast<std::chrono::seconds>(after - before).count(), 5);
+
+            setConnected(false);
+            Disconnect();
+            pthread_join(primary_thread, nullptr);
+            IESetClock(IE_CLOCK_REALTIME, 1);
+        }
 };
 
 TEST(CCDSimulatorDriverTest, test_properties)
@@ -211,6 +248,11 @@ TEST(CCDSimulatorDriverTest, test_draw_star)
     MockCCDSimDriver().testDrawStar();
 }
 
+TEST(CCDSimulatorDriverTest, test_stepped_exposure)
+{
+    MockCCDSimDriver().testSteppedExposure();
+}
+
 int main(int argc, char **argv)
 {
     INDI::Logger::getInstance().configure("", INDI::Logger::file_off,
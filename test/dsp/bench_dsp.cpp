@@ -0,0 +1,72 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+ .
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+ .
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+/*
+ * Time the steps of the INDI::DSP Convolution plugin on synthetic frames: forward transform of the
+ * frame, then convolution with a 15x15 matrix transformed once. Prints the time per frame on stderr.
+ *
+ * usage: bench_dsp [frames] [width] [height]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "dsp.h"
+
+static dsp_stream_p createStream(const std::vector<int> &sizes)
+{
+    dsp_stream_p stream = dsp_stream_new();
+    for (int size : sizes)
+        dsp_stream_add_dim(stream, size);
+    dsp_stream_alloc_buffer(stream, stream->len);
+    for (int i = 0; i < stream->len; i++)
+        stream->buf[i] = rand() % 256;
+    return stream;
+}
+
+static void destroyStream(dsp_stream_p stream)
+{
+    dsp_stream_free_buffer(stream);
+    dsp_stream_free(stream);
+}
+
+int main(int argc, char **argv)
+{
+    int frames = argc > 1 ? atoi(argv[1]) : 5;
+    int width  = argc > 2 ? atoi(argv[2]) : 1024;
+    int height = argc > 3 ? atoi(argv[3]) : 768;
+
+    dsp_stream_p matrix = createStream({15, 15});
+    dsp_fourier_dft(matrix, 1);
+
+    // The first frame creates the plans the next ones reuse
+    for (int i = 0; i <= frames; i++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        dsp_stream_p stream = createStream({width, height});
+        dsp_fourier_dft(stream, 1);
+        dsp_convolution_convolution(stream, matrix);
+        destroyStream(stream);
+        auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        fprintf(stderr, "Convolution chain %dx%d, %s: %.2f ms\n", width, height, i == 0 ? "first frame" : "next frame", elapsed);
+    }
+
+    destroyStream(matrix);
+    dsp_fourier_plans_clear();
+    return 0;
+}
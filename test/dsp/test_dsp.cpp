@@ -0,0 +1,85 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+ .
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+ .
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <vector>
+
+#include "dsp.h"
+
+static dsp_stream_p createStream(const std::vector<int> &sizes)
+{
+    dsp_stream_p stream = dsp_stream_new();
+    for (int size : sizes)
+        dsp_stream_add_dim(stream, size);
+    dsp_stream_alloc_buffer(stream, stream->len);
+    for (int i = 0; i < stream->len; i++)
+        stream->buf[i] = rand() % 256;
+    return stream;
+}
+
+static void destroyStream(dsp_stream_p stream)
+{
+    dsp_stream_free_buffer(stream);
+    dsp_stream_free(stream);
+}
+
+TEST(DSP_STREAM, Test_position_iteration)
+{
+    dsp_stream_p stream = createStream({7, 5, 3});
+    std::vector<int> cur(stream->dims), pos(stream->dims);
+
+    dsp_stream_get_position_r(stream, 0, cur.data());
+    for (int i = 0; i < stream->len; i++)
+    {
+        int *expected = dsp_stream_get_position(stream, i);
+        dsp_stream_get_position_r(stream, i, pos.data());
+        for (int d = 0; d < stream->dims; d++)
+        {
+            ASSERT_EQ(expected[d], pos[d]);
+            ASSERT_EQ(expected[d], cur[d]);
+        }
+        ASSERT_EQ(i, dsp_stream_set_position(stream, cur.data()));
+        free(expected);
+        dsp_stream_position_next(stream, cur.data());
+    }
+    destroyStream(stream);
+}
+
+TEST(DSP_FOURIER, Test_plan_cache)
+{
+    dsp_fourier_plans_clear();
+    ASSERT_EQ(0, dsp_fourier_plans_count());
+
+    for (int i = 0; i < 3; i++)
+    {
+        dsp_stream_p stream = createStream({64, 32});
+        dsp_fourier_dft(stream, 1);
+        dsp_fourier_idft(stream);
+        destroyStream(stream);
+    }
+    // one forward and one backward plan for a single geometry
+    ASSERT_EQ(2, dsp_fourier_plans_count());
+
+    dsp_stream_p stream = createStream({32, 32});
+    dsp_fourier_dft(stream, 1);
+    destroyStream(stream);
+    ASSERT_EQ(3, dsp_fourier_plans_count());
+
+    dsp_fourier_plans_clear();
+    ASSERT_EQ(0, dsp_fourier_plans_count());
+}
@@ -8,6 +8,8 @@
  * watch for messages until get initial values of each operand
  * evaluate expression, repeat if -w each time an op arrives until true
  * exit val==0
+ * with -c, evaluate each line of a file in turn over one connection,
+ * operands seen by earlier ones are remembered and kept up to date.
  */
 
 #define _GNU_SOURCE // needed for fdopen
@@ -15,19 +17,15 @@
 #include "indiapi.h"
 #include "indidevapi.h"
 #include "lilxml.h"
+#include "serverio.h"
 
 #include <errno.h>
 #include <math.h>
-#include <netdb.h>
-#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
-#include <netinet/in.h>
-#include <sys/types.h>
-#include <sys/socket.h>
 
 extern int compileExpr(char *expr, char *errmsg);
 extern int evalExpr(double *vp, char *errmsg);
@@ -39,17 +37,18 @@ extern int setOperand(char *name, double valu);
 
 static void usage();
 static void compileINDI(char *expr);
-static FILE *openINDIServer();
 static void getProps(FILE *fp);
-static void initProps(FILE *fp);
+static int initProps();
 static int pstatestr(char *state);
 static time_t timestampINDI(char *ts);
 static int devcmp(char *op1, char *op2);
-static int runEval(FILE *fp);
+static int runEval(double *vp);
+static int runBatch(char *fn, FILE *fp);
 static int setOp(XMLEle *root);
-static XMLEle *nxtEle(FILE *fp);
-static int readServerChar(FILE *fp);
-static void onAlarm(int dummy);
+static int setValue(char *prop, double v);
+static void useKnown();
+static XMLEle *nxtEle(double deadline);
+static void timedOut();
 
 static char *me;
 static char host_def[] = "localhost"; /* default host name */
@@ -58,7 +57,7 @@ static char *host      = host_def;    /* working host name */
 static int port = INDIPORT;           /* working port number */
 #define TIMEOUT 2                     /* default timeout, secs */
 static int timeout = TIMEOUT;         /* working timeout, secs */
-static LilXML *lillp;                 /* XML parser context */
+static ServerIO *svr;                 /* connection to server */
 static int directfd = -1;             /* direct filedes to server, if >= 0 */
 static int verbose;                   /* more tracing */
 static int eflag;                     /* print each updated expression value*/
@@ -67,6 +66,12 @@ static int iflag;                     /* read expression from stdin */
 static int oflag;                     /* print operands as they change */
 static int wflag;                     /* wait for expression to be true */
 static int bflag;                     /* beep when true */
+static char *batchfn;                 /* file of expressions, if -c */
+static char **asked;                  /* devices sent getProperties, if -c */
+static int nasked;
+static char **knames;                 /* every operand value seen, if -c */
+static double *kvalues;
+static int nknown;
 
 int main(int ac, char *av[])
 {
@@ -86,6 +91,15 @@ int main(int ac, char *av[])
                 case 'b': /* beep when true */
                     bflag++;
                     break;
+                case 'c':
+                    if (ac < 2)
+                    {
+                        fprintf(stderr, "-c requires file name\n");
+                        usage();
+                    }
+                    batchfn = *++av;
+                    ac--;
+                    break;
                 case 'd':
                     if (ac < 2)
                     {
@@ -160,7 +174,12 @@ int main(int ac, char *av[])
     /* now there are ac args starting with av[0] */
 
     /* compile expression from av[0] or stdin */
-    if (ac == 0)
+    if (batchfn)
+    {
+        if (ac > 0 || iflag)
+            usage();
+    }
+    else if (ac == 0)
         compileINDI(NULL);
     else if (ac == 1)
         compileINDI(av[0]);
@@ -170,37 +189,30 @@ int main(int ac, char *av[])
     /* open connection */
     if (directfd >= 0)
     {
-        fp = fdopen(directfd, "r+");
-        setbuf(fp, NULL); /* don't absorb next guy's stuff */
-        if (!fp)
-        {
-            fprintf(stderr, "Direct fd %d: %s\n", directfd, strerror(errno));
-            exit(1);
-        }
+        svr = serverOpenFd(directfd); /* don't absorb next guy's stuff */
         if (verbose)
             fprintf(stderr, "Using direct fd %d\n", directfd);
     }
     else
     {
-        fp = openINDIServer();
+        svr = serverOpen(host, port);
         if (verbose)
             fprintf(stderr, "Connected to %s on port %d\n", host, port);
     }
+    fp = serverWriter(svr);
 
-    /* build a parser context for cracking XML responses */
-    lillp = newLilXML();
-
-    /* set up to catch an io timeout function */
-    signal(SIGALRM, onAlarm);
+    if (batchfn)
+        return (runBatch(batchfn, fp));
 
     /* send getProperties */
     getProps(fp);
 
     /* initialize all properties */
-    initProps(fp);
+    if (initProps() < 0)
+        return (2);
 
     /* evaluate expression, return depending on flags */
-    return (runEval(fp));
+    return (runEval(NULL));
 }
 
 static void usage()
@@ -210,6 +222,8 @@ static void usage()
     fprintf(stderr, "Version: $Revision: 1.5 $\n");
     fprintf(stderr, "Options:\n");
     fprintf(stderr, "   -b   : beep when expression evaluates as true\n");
+    fprintf(stderr, "   -c f : evaluate the expressions of file f, one per line, over one connection,\n");
+    fprintf(stderr, "          print each value and report the time each took on stderr, \"-\" is stdin\n");
     fprintf(stderr, "   -d f : use file descriptor f already open to server\n");
 
     fprintf(stderr, "   -e   : print each updated expression value\n");
@@ -273,45 +287,6 @@ static void compileINDI(char *expr)
         free(exp);
 }
 
-/* open a connection to the given host and port or die.
- * return FILE pointer to socket.
- */
-static FILE *openINDIServer()
-{
-    struct sockaddr_in serv_addr;
-    struct hostent *hp;
-    int sockfd;
-
-    /* lookup host address */
-    hp = gethostbyname(host);
-    if (!hp)
-    {
-        perror("gethostbyname");
-        exit(2);
-    }
-
-    /* create a socket to the INDI server */
-    (void)memset((char *)&serv_addr, 0, sizeof(serv_addr));
-    serv_addr.sin_family      = AF_INET;
-    serv_addr.sin_addr.s_addr = ((struct in_addr *)(hp->h_addr_list[0]))->s_addr;
-    serv_addr.sin_port        = htons(port);
-    if ((sockfd = socket(AF_INET, SOCK_STREAM, 0)) < 0)
-    {
-        perror("socket");
-        exit(2);
-    }
-
-    /* connect */
-    if (connect(sockfd, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0)
-    {
-        perror("connect");
-        exit(2);
-    }
-
-    /* prepare for line-oriented i/o with client */
-    return (fdopen(sockfd, "r+"));
-}
-
 /* invite each device referenced in the expression to report its properties.
  */
 static void getProps(FILE *fp)
@@ -331,26 +306,48 @@ static void getProps(FILE *fp)
                 break;
         if (j < i)
             continue;
+        if (batchfn)
+        {
+            /* already asked, and kept up to date since */
+            int len = strchr(ops[i], '.') - ops[i];
+            for (j = 0; j < nasked; j++)
+                if ((int)strlen(asked[j]) == len && !strncmp(asked[j], ops[i], len))
+                    break;
+            if (j < nasked)
+                continue;
+            asked          = (char **)realloc(asked, (nasked + 1) * sizeof(char *));
+            asked[nasked++] = strndup(ops[i], len);
+        }
         if (verbose)
             fprintf(stderr, "sending getProperties for %.*s\n", (int)(strchr(ops[i], '.') - ops[i]), ops[i]);
         fprintf(fp, "<getProperties version='%g' device='%.*s'/>\n", INDIV, (int)(strchr(ops[i], '.') - ops[i]),
                 ops[i]);
     }
+    fflush(fp);
+    free(ops);
 }
 
 /* wait for defXXX or setXXX for each property in the expression.
- * return when find all operands are found or
- * exit(2) if time out waiting for all known operands.
+ * return 0 when find all operands are found or
+ * -1 if time out waiting for all known operands.
  */
-static void initProps(FILE *fp)
+static int initProps()
 {
-    alarm(timeout);
+    double deadline = timeout > 0 ? serverNow() + timeout : -1;
+
     while (allOperandsSet() < 0)
     {
-        if (setOp(nxtEle(fp)) == 0)
-            alarm(timeout);
+        XMLEle *root = nxtEle(deadline);
+        if (!root)
+        {
+            timedOut();
+            return (-1);
+        }
+        if (setOp(root) == 0 && timeout > 0)
+            deadline = serverNow() + timeout;
+        delXMLEle(root);
     }
-    alarm(0);
+    return (0);
 }
 
 /* pull apart the name and value from the given message, and set operand value.
@@ -377,12 +374,8 @@ static int setOp(XMLEle *root)
             {
                 sprintf(prop, "%s.%s.%s", d, n, findXMLAttValu(ep, "name"));
                 v = atof(pcdataXMLEle(ep));
-                if (setOperand(prop, v) == 0)
-                {
+                if (setValue(prop, v) == 0)
                     nset++;
-                    if (oflag)
-                        fprintf(stderr, "%s=%g\n", prop, v);
-                }
             }
         }
     }
@@ -396,12 +389,8 @@ static int setOp(XMLEle *root)
             {
                 sprintf(prop, "%s.%s.%s", d, n, findXMLAttValu(ep, "name"));
                 v = (double)!strncmp(pcdataXMLEle(ep), "On", 2);
-                if (setOperand(prop, v) == 0)
-                {
+                if (setValue(prop, v) == 0)
                     nset++;
-                    if (oflag)
-                        fprintf(stderr, "%s=%g\n", prop, v);
-                }
             }
         }
     }
@@ -414,12 +403,8 @@ static int setOp(XMLEle *root)
             {
                 sprintf(prop, "%s.%s.%s", d, n, findXMLAttValu(ep, "name"));
                 v = (double)pstatestr(pcdataXMLEle(ep));
-                if (setOperand(prop, v) == 0)
-                {
+                if (setValue(prop, v) == 0)
                     nset++;
-                    if (oflag)
-                        fprintf(stderr, "%s=%g\n", prop, v);
-                }
             }
         }
     }
@@ -430,46 +415,88 @@ static int setOp(XMLEle *root)
     {
         sprintf(prop, "%s.%s._STATE", d, n);
         v = (double)pstatestr(t);
-        if (setOperand(prop, v) == 0)
-        {
+        if (setValue(prop, v) == 0)
             nset++;
-            if (oflag)
-                fprintf(stderr, "%s=%g\n", prop, v);
-        }
     }
     t = (char *)findXMLAttValu(root, "timestamp");
     if (t[0])
     {
         sprintf(prop, "%s.%s._TS", d, n);
         v = (double)timestampINDI(t);
-        if (setOperand(prop, v) == 0)
-        {
+        if (setValue(prop, v) == 0)
             nset++;
-            if (oflag)
-                fprintf(stderr, "%s=%g\n", prop, v);
-        }
     }
 
     /* return whether any were set */
     return (nset > 0 ? 0 : -1);
 }
 
+/* set the operand prop to v, remembering it if -c.
+ * return 0 if it is an operand of the expression, else -1.
+ */
+static int setValue(char *prop, double v)
+{
+    int i;
+
+    if (batchfn)
+    {
+        for (i = 0; i < nknown; i++)
+            if (!strcmp(knames[i], prop))
+                break;
+        if (i == nknown)
+        {
+            knames  = (char **)realloc(knames, (nknown + 1) * sizeof(char *));
+            kvalues = (double *)realloc(kvalues, (nknown + 1) * sizeof(double));
+            knames[nknown++] = strdup(prop);
+        }
+        kvalues[i] = v;
+    }
+
+    if (setOperand(prop, v) < 0)
+        return (-1);
+    if (oflag)
+        fprintf(stderr, "%s=%g\n", prop, v);
+    return (0);
+}
+
+/* set the operands of the expression seen for earlier ones */
+static void useKnown()
+{
+    XMLEle *root;
+    char **ops;
+    int nops, i, j;
+
+    /* catch up with what arrived since */
+    while ((root = nxtEle(0)) != NULL)
+    {
+        setOp(root);
+        delXMLEle(root);
+    }
+
+    nops = getAllOperands(&ops);
+    for (i = 0; i < nops; i++)
+        for (j = 0; j < nknown; j++)
+            if (!strcmp(ops[i], knames[j]))
+                setOperand(ops[i], kvalues[j]);
+    free(ops);
+}
+
 /* evaluate the expression after seeing any operand change.
- * return whether expression evaluated to 0.
- * exit(2) is trouble or timeout waiting for operands we expect.
+ * return whether expression evaluated to 0, 2 if trouble or time out
+ * waiting for operands we expect. the value is left in *vp if not NULL.
  */
-static int runEval(FILE *fp)
+static int runEval(double *vp)
 {
     char errmsg[1024];
+    double deadline = timeout > 0 ? serverNow() + timeout : -1;
     double v;
 
-    alarm(timeout);
     while (1)
     {
         if (evalExpr(&v, errmsg) < 0)
         {
             fprintf(stderr, "Eval: %s\n", errmsg);
-            exit(2);
+            return (2);
         }
         if (bflag && v)
             fprintf(stderr, "\a");
@@ -477,18 +504,80 @@ static int runEval(FILE *fp)
             fprintf(stderr, "%g\n", v);
         if (!wflag || v != 0)
             break;
-        while (setOp(nxtEle(fp)) < 0)
-            continue;
-        alarm(timeout);
+        /* wait for an operand to change */
+        while (1)
+        {
+            XMLEle *root = nxtEle(deadline);
+            int changed;
+
+            if (!root)
+            {
+                timedOut();
+                return (2);
+            }
+            changed = setOp(root) == 0;
+            delXMLEle(root);
+            if (changed)
+                break;
+        }
+        if (timeout > 0)
+            deadline = serverNow() + timeout;
     }
-    alarm(0);
 
     if (!eflag && fflag)
         fprintf(stderr, "%g\n", v);
 
+    if (vp)
+        *vp = v;
     return (v == 0);
 }
 
+/* evaluate each expression of fn, one per line, and print its value.
+ * return the worst exit status.
+ */
+static int runBatch(char *fn, FILE *fp)
+{
+    FILE *bfp = strcmp(fn, "-") ? fopen(fn, "r") : stdin;
+    int status = 0;
+    char *line;
+
+    if (!bfp)
+    {
+        fprintf(stderr, "%s: %s\n", fn, strerror(errno));
+        return (2);
+    }
+
+    while ((line = readBatchLine(bfp)) != NULL)
+    {
+        char errmsg[1024];
+        double start = serverNow();
+        double v = NAN;
+        int rc = 2;
+
+        if (verbose)
+            fprintf(stderr, "Compiling: %s\n", line);
+        if (compileExpr(line, errmsg) < 0)
+            fprintf(stderr, "Compile err: %s\n", errmsg);
+        else
+        {
+            getProps(fp);
+            useKnown();
+            if (initProps() == 0)
+                rc = runEval(&v);
+        }
+        printf("%g\n", rc == 2 ? NAN : v);
+        fflush(stdout);
+        fprintf(stderr, "%s: %.1f ms\n", line, (serverNow() - start) * 1e3);
+
+        if (rc > status)
+            status = rc;
+    }
+
+    if (bfp != stdin)
+        fclose(bfp);
+    return (status);
+}
+
 /* return 0|1|2|3 depending on whether state is Idle|Ok|Busy|<other>.
  */
 static int pstatestr(char *state)
@@ -528,63 +617,27 @@ static int devcmp(char *op1, char *op2)
     return (n1 != n2 || strncmp(op1, op2, n1));
 }
 
-/* monitor server and return the next complete XML message.
- * exit(2) if time out.
+/* monitor server and return the next complete XML message,
+ * NULL if none before the given serverNow() time, < 0 to wait forever.
  * N.B. caller must call delXMLEle()
  */
-static XMLEle *nxtEle(FILE *fp)
-{
-    char msg[1024];
-
-    /* read from server, exit if trouble or see malformed XML */
-    while (1)
-    {
-        XMLEle *root = readXMLEle(lillp, readServerChar(fp), msg);
-        if (root)
-        {
-            /* found a complete XML element */
-            if (verbose > 1)
-                prXMLEle(stderr, root, 0);
-            return (root);
-        }
-        else if (msg[0])
-        {
-            fprintf(stderr, "Bad XML from %s/%d: %s\n", host, port, msg);
-            exit(2);
-        }
-    }
-}
-
-/* read next char from the INDI server connected by fp */
-static int readServerChar(FILE *fp)
+static XMLEle *nxtEle(double deadline)
 {
-    int c = fgetc(fp);
+    XMLEle *root = serverNext(svr, deadline);
 
-    if (c == EOF)
-    {
-        if (ferror(fp))
-            perror("read");
-        else
-            fprintf(stderr, "INDI server %s/%d disconnected\n", host, port);
-        exit(2);
-    }
-
-    if (verbose > 2)
-        fprintf(stderr, "Read %c\n", c);
-
-    return (c);
+    if (root && verbose > 1)
+        prXMLEle(stderr, root, 0);
+    return (root);
 }
 
 /* called after timeout seconds waiting to hear from server.
- * print reason for trouble and exit(2).
+ * print reason for trouble.
  */
-static void onAlarm(int dummy)
+static void timedOut()
 {
     char **ops;
     int nops;
 
-    INDI_UNUSED(dummy);
-
     /* report any unseen operands if any, else just say timed out */
     if ((nops = getUnsetOperands(&ops)) > 0)
     {
@@ -595,6 +648,5 @@ static void onAlarm(int dummy)
     }
     else
         fprintf(stderr, "Timed out waiting for new values\n");
-
-    exit(2);
+    free(ops);
 }
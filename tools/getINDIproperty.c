@@ -3,26 +3,27 @@
  * All types but BLOBs are handled from their defXXX messages. Receipt of a
  *   defBLOB sends enableBLOB then uses setBLOBVector for the value. BLOBs
  *   are stored in a file dev.nam.elem.format. only .z compression is handled.
+ * The server answers a pingRequest itself, before its drivers had a chance to
+ *   answer getProperties, so definitions are only known to be complete once
+ *   it answered one without more of them and none followed for QUIET secs.
+ *   Wild cards then need not wait for -t.
+ * With -c, each line of a file is a query, all run over one connection.
  * exit status: 0 at least some found, 1 some not found, 2 real trouble.
  */
 
 #include "base64.h"
 #include "indiapi.h"
 #include "lilxml.h"
+#include "serverio.h"
 #include "zlib.h"
 
 #include <errno.h>
 #include <math.h>
-#include <netdb.h>
-#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
-#include <netinet/in.h>
-#include <sys/types.h>
-#include <sys/socket.h>
 
 /* table of INDI definition elements, plus setBLOB.
  * we also look for set* if -m
@@ -59,19 +60,21 @@ typedef struct
     char *e;    /* element to seek */
     char wc; /* whether pattern uses wild cards */
     char ok; /* something matched this query */
+    char dseen; /* d sent a definition */
 } SearchDef;
 static SearchDef *srchs; /* properties to look for */
 static int nsrchs;
 
 static void usage(void);
-static void crackDPE(char *spec);
+static int crackDPE(char *spec);
 static void addSearchDef(char *dev, char *prop, char *ele);
-static void openINDIServer(void);
+static void clearSearchDefs(void);
 static void getprops(void);
-static void listenINDI(void);
+static int listenINDI(void);
 static int finished(void);
-static void onAlarm(int dummy);
-static int readServerChar(void);
+static void settled(XMLEle *root);
+static int report(void);
+static int runBatch(char *fn);
 static void findDPE(XMLEle *root);
 static void findEle(XMLEle *root, char *dev, char *nam, char *defone, SearchDef *sp);
 static void enableBLOBs(char *dev, char *nam);
@@ -84,16 +87,22 @@ static char *host      = host_def;    /* working host name */
 static int port = INDIPORT;           /* working port number */
 #define TIMEOUT 2                     /* default timeout, secs */
 static int timeout = TIMEOUT;         /* working timeout, secs */
+#define QUIET 0.5                     /* no definitions for this long after a pingReply, secs */
+static double deadline;               /* when to give up, serverNow() time */
 static int verbose;                   /* report extra info */
-static LilXML *lillp;                 /* XML parser context */
 #define WILDCARD '*'                  /* show all in this category */
 static int onematch;                  /* only one possible match */
 static int justvalue;                 /* if just one match show only value */
 static int monitor;                   /* keep watching even after seen def */
 static int directfd = -1;             /* direct filedes to server, if >= 0 */
+static ServerIO *svr;                 /* connection to server */
 static FILE *svrwfp;                  /* FILE * to talk to server */
-static FILE *svrrfp;                  /* FILE * to read from server */
 static int wflag;                     /* show wo properties too */
+static char *batchfn;                 /* file of queries, if -c */
+static int pinging;                   /* pingRequest outstanding */
+static int newdefs;                   /* definitions seen since it was sent */
+static int anydefs;                   /* definitions seen since getProperties */
+static double quietuntil;             /* serverNow() time definitions are complete, 0 if unknown */
 
 int main(int ac, char *av[])
 {
@@ -111,6 +120,15 @@ int main(int ac, char *av[])
                 case '1': /* just value */
                     justvalue++;
                     break;
+                case 'c':
+                    if (ac < 2)
+                    {
+                        fprintf(stderr, "-c requires file name\n");
+                        usage();
+                    }
+                    batchfn = *++av;
+                    ac--;
+                    break;
                 case 'd':
                     if (ac < 2)
                     {
@@ -175,45 +193,43 @@ int main(int ac, char *av[])
     }
 
     /* now ac args starting with av[0] */
+    if (batchfn && (ac > 0 || monitor))
+    {
+        fprintf(stderr, "Can not combine -c with -m or queries\n");
+        usage();
+    }
     if (ac == 0)
         av[ac++] = "*.*.*"; /* default is get everything */
 
     /* crack each d.p.e */
-    while (ac--)
-        crackDPE(*av++);
+    while (!batchfn && ac--)
+        if (crackDPE(*av++) < 0)
+            usage();
     onematch = nsrchs == 1 && !srchs[0].wc;
 
     /* open connection */
     if (directfd >= 0)
     {
-        svrwfp = fdopen(directfd, "w");
-        svrrfp = fdopen(directfd, "r");
-        if (!svrwfp || !svrrfp)
-        {
-            fprintf(stderr, "Direct fd %d: %s\n", directfd, strerror(errno));
-            exit(1);
-        }
-        setbuf(svrrfp, NULL); /* don't absorb next guy's stuff */
+        svr = serverOpenFd(directfd); /* don't absorb next guy's stuff */
         if (verbose)
             fprintf(stderr, "Using direct fd %d\n", directfd);
     }
     else
     {
-        openINDIServer();
+        svr = serverOpen(host, port);
         if (verbose)
             fprintf(stderr, "Connected to %s on port %d\n", host, port);
     }
+    svrwfp = serverWriter(svr);
 
-    /* build a parser context for cracking XML responses */
-    lillp = newLilXML();
+    if (batchfn)
+        return (runBatch(batchfn));
 
     /* issue getProperties */
     getprops();
 
     /* listen for responses, looking for d.p.e or timeout */
-    listenINDI();
-
-    return (0);
+    return (listenINDI());
 }
 
 static void usage()
@@ -232,11 +248,14 @@ static void usage()
     fprintf(stderr, "  or just value if -1 and exactly one query without wildcards.\n");
     fprintf(stderr, "Options:\n");
     fprintf(stderr, "  -1    : print just value if expecting exactly one response\n");
+    fprintf(stderr, "  -c f  : run the queries of file f, one per line, over one connection\n");
+    fprintf(stderr, "          and report the time each took on stderr, \"-\" is stdin\n");
     fprintf(stderr, "  -d f  : use file descriptor f already open to server\n");
     fprintf(stderr, "  -h h  : alternate host, default is %s\n", host_def);
     fprintf(stderr, "  -m    : keep monitoring for more updates\n");
     fprintf(stderr, "  -p p  : alternate port, default is %d\n", INDIPORT);
-    fprintf(stderr, "  -t t  : max time to wait, default is %d secs\n", TIMEOUT);
+    fprintf(stderr, "  -t t  : max time to wait for a server that does not answer pingRequest,\n");
+    fprintf(stderr, "          for a missing device or after the last definition, default is %d secs\n", TIMEOUT);
     fprintf(stderr, "  -v    : verbose (cumulative)\n");
     fprintf(stderr, "  -w    : show write-only properties too\n");
     fprintf(stderr, "Exit status:\n");
@@ -247,20 +266,21 @@ static void usage()
     exit(2);
 }
 
-/* crack spec and add to srchs[], else exit */
-static void crackDPE(char *spec)
+/* crack spec and add to srchs[], return -1 if bad format */
+static int crackDPE(char *spec)
 {
     char d[1024], p[1024], e[1024];
 
     if (verbose)
         fprintf(stderr, "looking for %s\n", spec);
-    if (sscanf(spec, "%[^.].%[^.].%[^.]", d, p, e) != 3)
+    if (strlen(spec) >= sizeof(d) || sscanf(spec, "%[^.].%[^.].%[^.]", d, p, e) != 3)
     {
         fprintf(stderr, "Unknown format for property spec: %s\n", spec);
-        usage();
+        return (-1);
     }
 
     addSearchDef(d, p, e);
+    return (0);
 }
 
 /* grow srchs[] with the new search */
@@ -272,47 +292,20 @@ static void addSearchDef(char *dev, char *prop, char *ele)
     srchs[nsrchs].e  = strdup(ele);
     srchs[nsrchs].wc = *dev == WILDCARD || *prop == WILDCARD || *ele == WILDCARD;
     srchs[nsrchs].ok = 0;
+    srchs[nsrchs].dseen = 0;
     nsrchs++;
 }
 
-/* open a connection to the given host and port.
- * set svrwfp and svrrfp or die.
- */
-static void openINDIServer(void)
+/* forget the last query */
+static void clearSearchDefs(void)
 {
-    struct sockaddr_in serv_addr;
-    struct hostent *hp;
-    int sockfd;
-
-    /* lookup host address */
-    hp = gethostbyname(host);
-    if (!hp)
-    {
-        herror("gethostbyname");
-        exit(2);
-    }
-
-    /* create a socket to the INDI server */
-    (void)memset((char *)&serv_addr, 0, sizeof(serv_addr));
-    serv_addr.sin_family      = AF_INET;
-    serv_addr.sin_addr.s_addr = ((struct in_addr *)(hp->h_addr_list[0]))->s_addr;
-    serv_addr.sin_port        = htons(port);
-    if ((sockfd = socket(AF_INET, SOCK_STREAM, 0)) < 0)
-    {
-        perror("socket");
-        exit(2);
-    }
-
-    /* connect */
-    if (connect(sockfd, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0)
+    for (int i = 0; i < nsrchs; i++)
     {
-        perror("connect");
-        exit(2);
+        free(srchs[i].d);
+        free(srchs[i].p);
+        free(srchs[i].e);
     }
-
-    /* prepare for line-oriented i/o with client */
-    svrwfp = fdopen(sockfd, "w");
-    svrrfp = fdopen(sockfd, "r");
+    nsrchs = 0;
 }
 
 /* issue getProperties to svrwfp, possibly constrained to one device */
@@ -342,39 +335,47 @@ static void getprops()
 
     if (verbose)
         fprintf(stderr, "Queried properties from %s\n", onedev ? onedev : "*");
+
+    /* the reply tells when the server sent what it had */
+    newdefs = anydefs = 0;
+    quietuntil        = 0;
+    pinging = !monitor;
+    if (pinging)
+        serverPing(svr);
 }
 
-/* listen for INDI traffic on svrrfp.
- * print matching srchs[] and return when see all.
- * timeout and exit if any trouble.
+/* listen for INDI traffic on svr.
+ * print matching srchs[] and return when see all or the server has no more.
+ * return exit status, 1 if something was not found after timeout.
  */
-static void listenINDI()
+static int listenINDI()
 {
-    char msg[1024];
+    deadline = timeout > 0 ? serverNow() + timeout : -1;
 
-    /* arrange to call onAlarm() if not seeing any more defXXX */
-    signal(SIGALRM, onAlarm);
-    alarm(timeout);
-
-    /* read from server, exit if find all requested properties */
+    /* read from server, return if find all requested properties */
     while (1)
     {
-        XMLEle *root = readXMLEle(lillp, readServerChar(), msg);
-        if (root)
-        {
-            /* found a complete XML element */
-            if (verbose > 1)
-                prXMLEle(stderr, root, 0);
-            findDPE(root);
-            if (finished() == 0)
-                exit(0);     /* found all we want */
-            delXMLEle(root); /* not yet, delete and continue */
-        }
-        else if (msg[0])
+        double until = deadline;
+        if (quietuntil > 0 && (until < 0 || quietuntil < until))
+            until = quietuntil;
+
+        XMLEle *root = serverNext(svr, until);
+        if (!root)
         {
-            fprintf(stderr, "Bad XML from %s/%d: %s\n", host, port, msg);
-            exit(2);
+            /* timed out, or the server stayed quiet long enough */
+            if (verbose && quietuntil > 0 && serverNow() >= quietuntil)
+                fprintf(stderr, "All definitions received\n");
+            return (report());
         }
+
+        /* found a complete XML element */
+        if (verbose > 1)
+            prXMLEle(stderr, root, 0);
+        findDPE(root);
+        settled(root);
+        delXMLEle(root);
+        if (finished() == 0)
+            return (report()); /* found all we want */
     }
 }
 
@@ -392,12 +393,51 @@ static int finished()
     return (0);
 }
 
-/* called after timeout seconds either because we are matching wild cards or
- * there is something still not found
+/* track whether the server sent every definition it has.
+ * it may have when it answers our pingRequest without more definitions in
+ * between, as long as every device we name had time to define itself.
+ * drivers answer getProperties after that, so also wait for QUIET secs,
+ * bounded by -t, without a new definition before trusting it.
  */
-static void onAlarm(int dummy)
+static void settled(XMLEle *root)
+{
+    int i;
+
+    if (monitor)
+        return;
+
+    if (!strncmp(tagXMLEle(root), "def", 3))
+    {
+        newdefs++;
+        anydefs++;
+        quietuntil = 0;
+    }
+    else if (serverIsPong(svr, root) == 0)
+    {
+        pinging = 0;
+        if (!newdefs)
+        {
+            /* a wild card device needs at least one, drivers may still be defining */
+            for (i = 0; i < nsrchs; i++)
+                if (srchs[i].d[0] == WILDCARD ? !anydefs : !srchs[i].dseen)
+                    break;
+            if (i == nsrchs)
+                quietuntil = serverNow() + (timeout > 0 && timeout < QUIET ? timeout : QUIET);
+        }
+    }
+
+    /* ask again once definitions stop arriving */
+    if (!pinging && newdefs)
+    {
+        newdefs = 0;
+        pinging = 1;
+        serverPing(svr);
+    }
+}
+
+/* report srchs[] not found, return 1 if any, else 0 */
+static int report()
 {
-    (void)dummy;
     int trouble = 0;
 
     for (int i = 0; i < nsrchs; i++)
@@ -409,27 +449,54 @@ static void onAlarm(int dummy)
         }
     }
 
-    exit(trouble ? 1 : 0);
+    return (trouble);
 }
 
-/* read one char from svrrfp */
-static int readServerChar()
+/* run each query in fn, one per line, over the connection.
+ * return the worst exit status.
+ */
+static int runBatch(char *fn)
 {
-    int c = fgetc(svrrfp);
+    FILE *fp = strcmp(fn, "-") ? fopen(fn, "r") : stdin;
+    int status = 0;
+    char *line;
 
-    if (c == EOF)
+    if (!fp)
     {
-        if (ferror(svrrfp))
-            perror("read");
-        else
-            fprintf(stderr, "INDI server %s/%d disconnected\n", host, port);
-        exit(2);
+        fprintf(stderr, "%s: %s\n", fn, strerror(errno));
+        return (2);
     }
 
-    if (verbose > 2)
-        fprintf(stderr, "Read %c\n", c);
+    while ((line = readBatchLine(fp)) != NULL)
+    {
+        char *query = strdup(line);
+        char *spec, *last;
+        double start;
+        int rc = 0;
+
+        clearSearchDefs();
+        for (spec = strtok_r(line, " \t", &last); spec; spec = strtok_r(NULL, " \t", &last))
+            if (crackDPE(spec) < 0)
+                rc = 2;
+        onematch = nsrchs == 1 && !srchs[0].wc;
+
+        start = serverNow();
+        if (rc == 0)
+        {
+            getprops();
+            rc = listenINDI();
+        }
+        fflush(stdout);
+        fprintf(stderr, "%s: %.1f ms\n", query, (serverNow() - start) * 1e3);
+
+        if (rc > status)
+            status = rc;
+        free(query);
+    }
 
-    return (c);
+    if (fp != stdin)
+        fclose(fp);
+    return (status);
 }
 
 /* print value if root is any srchs[] we are looking for*/
@@ -450,6 +517,9 @@ static void findDPE(XMLEle *root)
                 char *idev = srchs[i].d;
                 if (idev[0] == WILDCARD || !strcmp(dev, idev))
                 {
+                    if (!strncmp(defs[j].vec, "def", 3))
+                        srchs[i].dseen = 1;
+
                     /* found device, check name */
                     char *nam   = (char *)findXMLAttValu(root, "name");
                     char *iprop = srchs[i].p;
@@ -471,8 +541,8 @@ static void findDPE(XMLEle *root)
                                 findEle(root, dev, nam, defs[j].one, &srchs[i]);
                             if (onematch)
                                 return; /* only one can match */
-                            if (!strncmp(defs[j].vec, "def", 3))
-                                alarm(timeout); /* reset timer if def */
+                            if (!strncmp(defs[j].vec, "def", 3) && timeout > 0)
+                                deadline = serverNow() + timeout; /* reset timer if def */
                         }
                     }
                 }
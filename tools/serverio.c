@@ -0,0 +1,226 @@
+/* buffered connection to an INDI server shared by the command line tools.
+ * replies are read in large chunks and cracked with parseXMLChunk() instead
+ * of one fgetc() and readXMLEle() per character.
+ */
+
+#define _GNU_SOURCE // needed for fdopen
+
+#include "serverio.h"
+
+#include <errno.h>
+#include <math.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#define READ_CHUNK 32768 /* bytes read at once from a connection we own */
+
+struct ServerIO
+{
+    int fd;            /* connection to the server */
+    int shared;        /* fd is not ours alone, do not read ahead */
+    FILE *wfp;         /* FILE * to talk to the server */
+    LilXML *lillp;     /* XML parser context */
+    XMLEle **nodes;    /* elements of the last chunk, NULL terminated */
+    int inode;         /* next one to return */
+    char name[300];    /* host:port for messages */
+    int npings;        /* pingRequests sent */
+    char pinguid[64];  /* uid of the last one */
+};
+
+static ServerIO *newServerIO(int fd, int shared, const char *name)
+{
+    ServerIO *sp = (ServerIO *)calloc(1, sizeof(ServerIO));
+
+    sp->fd     = fd;
+    sp->shared = shared;
+    sp->wfp    = fdopen(fd, "w");
+    sp->lillp  = newLilXML();
+    if (!sp->wfp)
+    {
+        fprintf(stderr, "%s: %s\n", name, strerror(errno));
+        exit(2);
+    }
+    snprintf(sp->name, sizeof(sp->name), "%s", name);
+    return (sp);
+}
+
+ServerIO *serverOpen(const char *host, int port)
+{
+    struct sockaddr_in serv_addr;
+    struct hostent *hp;
+    char name[300];
+    int sockfd;
+
+    /* lookup host address */
+    hp = gethostbyname(host);
+    if (!hp)
+    {
+        herror("gethostbyname");
+        exit(2);
+    }
+
+    /* create a socket to the INDI server */
+    (void)memset((char *)&serv_addr, 0, sizeof(serv_addr));
+    serv_addr.sin_family      = AF_INET;
+    serv_addr.sin_addr.s_addr = ((struct in_addr *)(hp->h_addr_list[0]))->s_addr;
+    serv_addr.sin_port        = htons(port);
+    if ((sockfd = socket(AF_INET, SOCK_STREAM, 0)) < 0)
+    {
+        perror("socket");
+        exit(2);
+    }
+
+    /* connect */
+    if (connect(sockfd, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0)
+    {
+        perror("connect");
+        exit(2);
+    }
+
+    /* short requests wait for their reply, do not hold them back */
+    int one = 1;
+    setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    snprintf(name, sizeof(name), "%s:%d", host, port);
+    return (newServerIO(sockfd, 0, name));
+}
+
+ServerIO *serverOpenFd(int fd)
+{
+    char name[32];
+
+    snprintf(name, sizeof(name), "fd %d", fd);
+    return (newServerIO(fd, 1, name));
+}
+
+FILE *serverWriter(ServerIO *sp)
+{
+    return (sp->wfp);
+}
+
+XMLEle *serverNext(ServerIO *sp, double deadline)
+{
+    char buf[READ_CHUNK];
+    char msg[1024];
+
+    while (1)
+    {
+        struct pollfd pfd;
+        int ms = -1;
+        ssize_t nr;
+        int n;
+
+        /* elements left from the last chunk first */
+        if (sp->nodes)
+        {
+            if (sp->nodes[sp->inode])
+                return (sp->nodes[sp->inode++]);
+            free(sp->nodes);
+            sp->nodes = NULL;
+        }
+
+        if (deadline >= 0)
+        {
+            double left = deadline - serverNow();
+            ms          = left > 0 ? (int)ceil(left * 1000) : 0;
+        }
+        pfd.fd     = sp->fd;
+        pfd.events = POLLIN;
+        n          = poll(&pfd, 1, ms);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("poll");
+            exit(2);
+        }
+        if (n == 0)
+            return (NULL);
+
+        nr = read(sp->fd, buf, sp->shared ? 1 : sizeof(buf));
+        if (nr < 0)
+        {
+            if (errno == EINTR || errno == EAGAIN)
+                continue;
+            perror("read");
+            exit(2);
+        }
+        if (nr == 0)
+        {
+            fprintf(stderr, "INDI server %s disconnected\n", sp->name);
+            exit(2);
+        }
+
+#ifdef TCP_QUICKACK
+        /* the server may hold a short reply until we acknowledge what it sent before */
+        if (!sp->shared)
+        {
+            int one = 1;
+            setsockopt(sp->fd, IPPROTO_TCP, TCP_QUICKACK, &one, sizeof(one));
+        }
+#endif
+
+        sp->nodes = parseXMLChunk(sp->lillp, buf, (int)nr, msg);
+        sp->inode = 0;
+        if (!sp->nodes)
+        {
+            fprintf(stderr, "Bad XML from %s: %s\n", sp->name, msg);
+            exit(2);
+        }
+    }
+}
+
+void serverPing(ServerIO *sp)
+{
+    snprintf(sp->pinguid, sizeof(sp->pinguid), "indi_tools_%d_%d", (int)getpid(), ++sp->npings);
+    fprintf(sp->wfp, "<pingRequest uid='%s'/>\n", sp->pinguid);
+    fflush(sp->wfp);
+}
+
+int serverIsPong(ServerIO *sp, XMLEle *root)
+{
+    if (strcmp(tagXMLEle(root), "pingReply") || !sp->pinguid[0])
+        return (-1);
+    return (strcmp(findXMLAttValu(root, "uid"), sp->pinguid) ? -1 : 0);
+}
+
+double serverNow(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec + ts.tv_nsec * 1e-9);
+}
+
+char *readBatchLine(FILE *fp)
+{
+    static char *line;
+    static size_t len;
+
+    while (getline(&line, &len, fp) >= 0)
+    {
+        char *s = line;
+        char *e;
+
+        /* trim */
+        while (*s == ' ' || *s == '\t')
+            s++;
+        e = s + strlen(s);
+        while (e > s && (e[-1] == '\n' || e[-1] == '\r' || e[-1] == ' ' || e[-1] == '\t'))
+            *--e = '\0';
+
+        if (*s && *s != '#')
+            return (s);
+    }
+
+    return (NULL);
+}
@@ -0,0 +1,43 @@
+/* buffered connection to an INDI server shared by the command line tools.
+ */
+
+#pragma once
+
+#include "lilxml.h"
+
+#include <stdio.h>
+
+typedef struct ServerIO ServerIO;
+
+/* connect to host:port, exit(2) if trouble */
+extern ServerIO *serverOpen(const char *host, int port);
+
+/* use fd, already connected to a server.
+ * the fd may be shared with other processes so it is read one byte at a time.
+ */
+extern ServerIO *serverOpenFd(int fd);
+
+/* FILE * to talk to the server */
+extern FILE *serverWriter(ServerIO *sp);
+
+/* return the next complete XML element from the server, waiting until the
+ *   given serverNow() time, forever if < 0. return NULL once it passed.
+ * exit(2) if the server disconnects or sends bad XML.
+ * N.B. caller must call delXMLEle()
+ */
+extern XMLEle *serverNext(ServerIO *sp, double deadline);
+
+/* send a pingRequest, the server answers it with a pingReply after everything
+ *   it queued for us before. return 0 if root is the reply to the last one.
+ */
+extern void serverPing(ServerIO *sp);
+extern int serverIsPong(ServerIO *sp, XMLEle *root);
+
+/* monotonic time in seconds */
+extern double serverNow(void);
+
+/* return the next line of a batch file without its newline, skipping blank
+ *   lines and # comments, NULL at the end.
+ * N.B. the line is overwritten by the next call.
+ */
+extern char *readBatchLine(FILE *fp);
@@ -1,4 +1,5 @@
 /* connect to an INDI server and set one or more device.property.element.
+ * With -c, each line of a file is set in turn over one connection.
  */
 
 #define _GNU_SOURCE // needed for fdopen
@@ -6,18 +7,15 @@
 #include "indiapi.h"
 #include "indidevapi.h"
 #include "lilxml.h"
+#include "serverio.h"
 
 #include <errno.h>
 #include <math.h>
-#include <netdb.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <signal.h>
 #include <time.h>
 #include <unistd.h>
-#include <netinet/in.h>
-#include <sys/types.h>
 #include <sys/socket.h>
 
 /* table of INDI definition elements we can set
@@ -47,7 +45,11 @@ static int verbose;           /* report extra info */
 static int directfd = -1;     /* direct filedes to server, if >= 0 */
 #define TIMEOUT 2             /* default timeout, secs */
 static int timeout = TIMEOUT; /* working timeout, secs */
-static LilXML *lillp;         /* XML parser context */
+static double deadline;       /* when to give up, serverNow() time */
+static ServerIO *svr;         /* connection to server */
+static char *batchfn;         /* file of settings, if -c */
+static XMLEle **known;        /* definitions seen in batch mode */
+static int nknown;
 
 typedef struct
 {
@@ -62,6 +64,7 @@ typedef struct
     SetEV *ev;   /* elements */
     int nev;     /* n elements */
     INDIDef *dp; /* one of defs if known, else NULL */
+    int sent;    /* new values sent */
 } SetSpec;
 
 static SetSpec *sets; /* set of properties to set */
@@ -69,12 +72,14 @@ static int nsets;
 
 static void usage(void);
 static int crackSpec(int *acp, char **avp[]);
-static void openINDIServer(FILE **rfpp, FILE **wfpp);
-static void listenINDI(FILE *rfp, FILE *wfp);
+static void clearSpecs(void);
+static int listenINDI(FILE *wfp);
 static int finished(void);
-static void onAlarm(int dummy);
-static int readServerChar(FILE *fp);
-static void findSet(XMLEle *root, FILE *fp);
+static int report(void);
+static int runBatch(char *fn, FILE *wfp);
+static int findKnown(SetSpec *sp);
+static void addKnown(XMLEle *root);
+static int findSet(XMLEle *root, FILE *fp);
 static void scanEV(SetSpec *specp, char ev[]);
 static void scanEEVV(SetSpec *specp, char *ep, char ev[]);
 static void scanEVEV(SetSpec *specp, char ev[]);
@@ -83,7 +88,7 @@ static void sendSpecs(FILE *wfp);
 
 int main(int ac, char *av[])
 {
-    FILE *rfp, *wfp;
+    FILE *wfp;
     int stop = 0;
     int allspeced;
 
@@ -98,6 +103,16 @@ int main(int ac, char *av[])
         {
             switch (*s)
             {
+                case 'c':
+                    if (ac < 2)
+                    {
+                        fprintf(stderr, "-c requires file name\n");
+                        usage();
+                    }
+                    batchfn = *++av;
+                    ac--;
+                    break;
+
                 case 'd':
                     if (ac < 2)
                     {
@@ -167,40 +182,38 @@ int main(int ac, char *av[])
     }
 
     /* now ac args starting at av[0] */
-    if (ac < 1)
+    if (batchfn ? ac > 0 : ac < 1)
         usage();
 
     /* crack each property, add to sets[]  */
     allspeced = 1;
-    do
+    while (ac > 0)
     {
         if (!crackSpec(&ac, &av))
             allspeced = 0;
-    } while (ac > 0);
+    }
 
     /* open connection */
     if (directfd >= 0)
     {
-        wfp = fdopen(directfd, "w");
-        rfp = fdopen(directfd, "r");
-        setbuf(rfp, NULL); /* don't absorb next guy's stuff */
-        if (!rfp || !wfp)
-        {
-            fprintf(stderr, "Direct fd %d: %s\n", directfd, strerror(errno));
-            exit(1);
-        }
+        svr = serverOpenFd(directfd); /* don't absorb next guy's stuff */
         if (verbose)
             fprintf(stderr, "Using direct fd %d\n", directfd);
     }
     else
     {
-        openINDIServer(&rfp, &wfp);
+        svr = serverOpen(host, port);
         if (verbose)
             fprintf(stderr, "Connected to %s on port %d\n", host, port);
     }
+    wfp = serverWriter(svr);
 
-    /* build a parser context for cracking XML responses */
-    lillp = newLilXML();
+    if (batchfn)
+    {
+        int status = runBatch(batchfn, wfp);
+        shutdown(fileno(wfp), SHUT_WR); /* insure flush */
+        return (status);
+    }
 
     /* just send it all speced, else check with server */
     if (allspeced)
@@ -209,6 +222,8 @@ int main(int ac, char *av[])
     }
     else
     {
+        int status;
+
         /* issue getProperties */
         if (verbose)
             fprintf(stderr, "Querying for properties\n");
@@ -216,7 +231,9 @@ int main(int ac, char *av[])
         fflush(wfp);
 
         /* listen for properties, set when see any we recognize */
-        listenINDI(rfp, wfp);
+        status = listenINDI(wfp);
+        shutdown(fileno(wfp), SHUT_WR); /* insure flush */
+        return (status);
     }
 
     return (0);
@@ -228,6 +245,8 @@ static void usage()
     fprintf(stderr, "%s\n", GIT_TAG_STRING);
     fprintf(stderr, "Usage: %s [options] {[type] spec} ...\n", me);
     fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  -c f  : set the specs of file f, one per line, over one connection\n");
+    fprintf(stderr, "          and report the time each took on stderr, \"-\" is stdin\n");
     fprintf(stderr, "  -d f  : use file descriptor f already open to server\n");
     fprintf(stderr, "  -h h  : alternate host, default is %s\n", host_def);
     fprintf(stderr, "  -p p  : alternate port, default is %d\n", INDIPORT);
@@ -303,6 +322,7 @@ static int crackSpec(int *acp, char **avp[])
     sets[nsets].dp  = dp;
     sets[nsets].ev  = NULL;
     sets[nsets].nev = 0;
+    sets[nsets].sent = 0;
     scanEV(&sets[nsets++], ev);
 
     /* update caller's pointers */
@@ -313,77 +333,50 @@ static int crackSpec(int *acp, char **avp[])
     return (dp ? 1 : 0);
 }
 
-/* open a read and write connection to host and port or die.
- * exit if trouble.
- */
-static void openINDIServer(FILE **rfpp, FILE **wfpp)
+/* forget the last settings */
+static void clearSpecs(void)
 {
-    struct sockaddr_in serv_addr;
-    struct hostent *hp;
-    int sockfd;
-
-    /* lookup host address */
-    hp = gethostbyname(host);
-    if (!hp)
-    {
-        perror("gethostbyname");
-        exit(2);
-    }
-
-    /* create a socket to the INDI server */
-    (void)memset((char *)&serv_addr, 0, sizeof(serv_addr));
-    serv_addr.sin_family      = AF_INET;
-    serv_addr.sin_addr.s_addr = ((struct in_addr *)(hp->h_addr_list[0]))->s_addr;
-    serv_addr.sin_port        = htons(port);
-    if ((sockfd = socket(AF_INET, SOCK_STREAM, 0)) < 0)
-    {
-        perror("socket");
-        exit(2);
-    }
-
-    /* connect */
-    if (connect(sockfd, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0)
+    for (int i = 0; i < nsets; i++)
     {
-        perror("connect");
-        exit(2);
+        for (int j = 0; j < sets[i].nev; j++)
+        {
+            free(sets[i].ev[j].e);
+            free(sets[i].ev[j].v);
+        }
+        free(sets[i].ev);
+        free(sets[i].d);
+        free(sets[i].p);
     }
-
-    /* prepare for line-oriented i/o to client */
-    *rfpp = fdopen(sockfd, "r");
-    *wfpp = fdopen(sockfd, "w");
+    nsets = 0;
 }
 
-/* listen for property reports, send new sets if match */
-static void listenINDI(FILE *rfp, FILE *wfp)
+/* listen for property reports, send new sets if match.
+ * return exit status, 1 if something could not be set.
+ */
+static int listenINDI(FILE *wfp)
 {
-    char msg[1024];
+    int status = 0;
 
-    /* arrange to call onAlarm() if not seeing any more defXXX */
-    signal(SIGALRM, onAlarm);
-    alarm(timeout);
+    deadline = timeout > 0 ? serverNow() + timeout : -1;
 
-    /* read from server, exit if find all properties */
+    /* read from server, return if find all properties */
     while (1)
     {
-        XMLEle *root = readXMLEle(lillp, readServerChar(rfp), msg);
-        if (root)
-        {
-            /* found a complete XML element */
-            if (verbose > 1)
-                prXMLEle(stderr, root, 0);
-            findSet(root, wfp);
-            if (finished() == 0)
-            {
-                shutdown(fileno(wfp), SHUT_WR); /* insure flush */
-                exit(0);                        /* found all we want */
-            }
-            delXMLEle(root); /* not yet, delete and continue */
-        }
-        else if (msg[0])
-        {
-            fprintf(stderr, "Bad XML from %s/%d: %s\n", host, port, msg);
-            exit(2);
-        }
+        XMLEle *root = serverNext(svr, deadline);
+        if (!root)
+            return (report()); /* timed out */
+
+        /* found a complete XML element */
+        if (verbose > 1)
+            prXMLEle(stderr, root, 0);
+        if (findSet(root, wfp) < 0)
+            status = 1;
+        if (batchfn)
+            addKnown(root);
+        else
+            delXMLEle(root);
+        if (status || finished() == 0)
+            return (status); /* found all we want */
     }
 }
 
@@ -399,12 +392,9 @@ static int finished()
     return (0);
 }
 
-/* called after timeout seconds because we did not find something we trying
- * to set.
- */
-static void onAlarm(int dummy)
+/* report what we did not find, return 1 */
+static int report()
 {
-    INDI_UNUSED(dummy);
     int i, j;
 
     for (i = 0; i < nsets; i++)
@@ -412,30 +402,115 @@ static void onAlarm(int dummy)
             if (!sets[i].ev[j].ok)
                 fprintf(stderr, "No %s.%s.%s from %s:%d\n", sets[i].d, sets[i].p, sets[i].ev[j].e, host, port);
 
-    exit(1);
+    return (1);
 }
 
-static int readServerChar(FILE *fp)
+/* set each line of fn in turn, its definition is asked for just once.
+ * return the worst exit status.
+ */
+static int runBatch(char *fn, FILE *wfp)
 {
-    int c = fgetc(fp);
+    FILE *fp = strcmp(fn, "-") ? fopen(fn, "r") : stdin;
+    int status = 0;
+    char *line;
 
-    if (c == EOF)
+    if (!fp)
     {
-        if (ferror(fp))
-            perror("read");
-        else
-            fprintf(stderr, "INDI server %s:%d disconnected\n", host, port);
-        exit(2);
+        fprintf(stderr, "%s: %s\n", fn, strerror(errno));
+        return (2);
     }
 
-    if (verbose > 2)
-        fprintf(stderr, "Read %c\n", c);
+    while ((line = readBatchLine(fp)) != NULL)
+    {
+        char *args[2];
+        char **av = args;
+        int ac    = 0;
+        double start = serverNow();
+        int rc = 0;
+        int i;
+
+        /* an optional type, then the spec which may contain blanks */
+        clearSpecs();
+        if (line[0] == '-')
+        {
+            args[ac++] = strtok(line, " \t");
+            line       = strtok(NULL, "");
+            while (line && (*line == ' ' || *line == '\t'))
+                line++;
+        }
+        if (line)
+            args[ac++] = line;
+        crackSpec(&ac, &av);
+
+        if (sets[0].dp)
+            sendSpecs(wfp);
+        else if (findKnown(&sets[0]) < 0)
+            rc = 1;
+        else if (finished() < 0)
+        {
+            /* not seen yet, ask for just this one */
+            fprintf(wfp, "<getProperties version='%g' device='%s' name='%s'/>\n", INDIV, sets[0].d, sets[0].p);
+            fflush(wfp);
+            rc = listenINDI(wfp);
+        }
+        fprintf(stderr, "%s.%s: %.1f ms\n", sets[0].d, sets[0].p, (serverNow() - start) * 1e3);
+
+        for (i = 0; i < nsets; i++)
+            if (!sets[i].sent)
+                rc = 1;
+        if (rc > status)
+            status = rc;
+    }
 
-    return (c);
+    if (fp != stdin)
+        fclose(fp);
+    return (status);
 }
 
-/* issue a set command if it matches the given property */
-static void findSet(XMLEle *root, FILE *fp)
+/* send sp if its definition was already seen.
+ * return -1 if it can not be set.
+ */
+static int findKnown(SetSpec *sp)
+{
+    for (int i = 0; i < nknown; i++)
+        if (!strcmp(findXMLAttValu(known[i], "device"), sp->d) && !strcmp(findXMLAttValu(known[i], "name"), sp->p))
+            return (findSet(known[i], serverWriter(svr)));
+    return (0);
+}
+
+/* keep the definition in root, replacing the previous one, else delete it */
+static void addKnown(XMLEle *root)
+{
+    const char *dev = findXMLAttValu(root, "device");
+    const char *nam = findXMLAttValu(root, "name");
+    int i;
+
+    for (i = 0; i < (int)NDEFS; i++)
+        if (!strcmp(tagXMLEle(root), defs[i].defType))
+            break;
+    if (i == NDEFS)
+    {
+        delXMLEle(root);
+        return;
+    }
+
+    for (i = 0; i < nknown; i++)
+    {
+        if (!strcmp(findXMLAttValu(known[i], "device"), dev) && !strcmp(findXMLAttValu(known[i], "name"), nam))
+        {
+            delXMLEle(known[i]);
+            known[i] = root;
+            return;
+        }
+    }
+    known           = (XMLEle **)realloc(known, (nknown + 1) * sizeof(XMLEle *));
+    known[nknown++] = root;
+}
+
+/* issue a set command if it matches the given property.
+ * return -1 if it is read-only, else 0.
+ */
+static int findSet(XMLEle *root, FILE *fp)
 {
     char *rtype, *rdev, *rprop;
     XMLEle *ep;
@@ -449,9 +524,10 @@ static void findSet(XMLEle *root, FILE *fp)
             break;
     }
     if (t == NDEFS)
-        return;
+        return (0);
 
-    alarm(timeout); /* reset timeout */
+    if (timeout > 0)
+        deadline = serverNow() + timeout; /* reset timeout */
 
     /* check each set for matching device and property name, send if ok */
     rdev  = (char *)findXMLAttValu(root, "device");
@@ -461,14 +537,14 @@ static void findSet(XMLEle *root, FILE *fp)
 
     for (s = 0; s < nsets; s++)
     {
-        if (!strcmp(rdev, sets[s].d) && !strcmp(rprop, sets[s].p))
+        if (!sets[s].sent && !strcmp(rdev, sets[s].d) && !strcmp(rprop, sets[s].p))
         {
             /* found device and name,  check perm */
             if (!strchr(findXMLAttValu(root, "perm"), 'w'))
             {
                 if (verbose)
                     fprintf(stderr, "%s.%s is read-only\n", rdev, rprop);
-                exit(1);
+                return (-1);
             }
             /* check matching elements */
             for (i = 0; i < sets[s].nev; i++)
@@ -482,12 +558,14 @@ static void findSet(XMLEle *root, FILE *fp)
                     }
                 }
                 if (!ep)
-                    return; /* not in this msg, maybe later */
+                    return (0); /* not in this msg, maybe later */
             }
             /* all element names found, send new values */
             sendNew(fp, &defs[t], &sets[s]);
         }
     }
+
+    return (0);
 }
 
 /* send the given set specification of the given INDI type to channel on fp */
@@ -504,6 +582,7 @@ static void sendNew(FILE *fp, INDIDef *dp, SetSpec *sp)
     }
     fprintf(fp, "</%s>\n", dp->newType);
     fflush(fp);
+    sp->sent = 1;
     if (feof(fp) || ferror(fp))
     {
         fprintf(stderr, "Send error\n");
@@ -572,6 +651,7 @@ static void scanEEVV(SetSpec *sp, char *v, char *e)
         sp->ev            = (SetEV *)realloc(sp->ev, (sp->nev + 1) * sizeof(SetEV));
         sp->ev[sp->nev].e = strdup(e0);
         sp->ev[sp->nev].v = strdup(v0);
+        sp->ev[sp->nev].ok = 0;
         if (verbose > 1)
             fprintf(stderr, "Found assignment %s=%s\n", sp->ev[sp->nev].e, sp->ev[sp->nev].v);
         sp->nev++;
@@ -612,6 +692,7 @@ static void scanEVEV(SetSpec *sp, char ev[])
         sp->ev            = (SetEV *)realloc(sp->ev, (sp->nev + 1) * sizeof(SetEV));
         sp->ev[sp->nev].e = strdup(ev);
         sp->ev[sp->nev].v = strdup(e);
+        sp->ev[sp->nev].ok = 0;
         if (verbose > 1)
             fprintf(stderr, "Found assignment %s=%s\n", sp->ev[sp->nev].e, sp->ev[sp->nev].v);
         sp->nev++;